@@ -0,0 +1,135 @@
+/**
+ * Nullifier Set Benchmarks
+ *
+ * Repeat checks against set size, on sets filled with random (timestamp,
+ * nullifier) keys and sealed into tables of PARTITION keys, as a gateway
+ * reaches them after a few epochs:
+ *
+ *   edgechain-nullifier-bench --benchmark_counters_tabular=true
+ *
+ * The argument is the number of keys already in the set. Sets are built
+ * once per size in a temporary directory, which is removed at exit.
+ */
+
+#include "nullifier_set.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+const size_t PARTITION = 1 << 20;
+const size_t SAMPLES = 4096;
+
+struct KeySource {
+  uint64_t state;
+  explicit KeySource(uint64_t seed) : state(seed) {}
+  uint64_t next() {
+    uint64_t x = (state += 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+  void key(uint8_t* out) {
+    for (size_t i = 0; i < gw::NullifierSet::KEY_SIZE; i += 8) {
+      uint64_t v = next();
+      memcpy(out + i, &v, std::min<size_t>(8, gw::NullifierSet::KEY_SIZE - i));
+    }
+  }
+};
+
+struct Filled {
+  std::string dir;
+  gw::NullifierSet set;
+  std::vector<gw::NullifierSet::Key> present;   // A sample of the keys inside
+  KeySource fresh{0xF00D};
+
+  explicit Filled(size_t keys) {
+    char path[] = "/tmp/nullifier-bench-XXXXXX";
+    dir = mkdtemp(path);
+    set.open(dir, 1, PARTITION);
+    KeySource source(keys);
+    gw::NullifierSet::Key key;
+    for (size_t i = 0; i < keys; i++) {
+      source.key(key.data());
+      set.insert(key.data());
+      if (i % (keys / SAMPLES) == 0 && present.size() < SAMPLES) present.push_back(key);
+    }
+    set.flush();
+    set.drain();
+  }
+
+  ~Filled() {
+    std::string command = "rm -rf " + dir;
+    if (system(command.c_str()) != 0) {
+      // Left behind in /tmp
+    }
+  }
+};
+
+Filled& filled(size_t keys) {
+  static std::map<size_t, std::unique_ptr<Filled>> sets;
+  std::unique_ptr<Filled>& set = sets[keys];
+  if (!set) set.reset(new Filled(keys));
+  return *set;
+}
+
+void report(benchmark::State& state, const gw::NullifierSet& set, uint64_t falsePositives) {
+  gw::NullifierSetStats stats = set.stats();
+  state.SetItemsProcessed((int64_t)state.iterations());
+  state.counters["tables"] = (double)stats.tables;
+  // Table keys scanned for nothing, per lookup
+  state.counters["false_pos"] = benchmark::Counter((double)(stats.falsePositives - falsePositives),
+                                                   benchmark::Counter::kAvgIterations);
+}
+
+// A reading never seen: the common case at ingest
+void BM_ContainsNew(benchmark::State& state) {
+  Filled& f = filled((size_t)state.range(0));
+  uint64_t falsePositives = f.set.stats().falsePositives;
+  gw::NullifierSet::Key key;
+  for (auto _ : state) {
+    f.fresh.key(key.data());
+    benchmark::DoNotOptimize(f.set.contains(key.data()));
+  }
+  report(state, f.set, falsePositives);
+}
+
+// A replay of a reading sealed into a table
+void BM_ContainsRepeat(benchmark::State& state) {
+  Filled& f = filled((size_t)state.range(0));
+  uint64_t falsePositives = f.set.stats().falsePositives;
+  size_t i = 0;
+  for (auto _ : state) {
+    bool found = f.set.contains(f.present[i].data());
+    if (!found) state.SkipWithError("key missing");
+    benchmark::DoNotOptimize(found);
+    i = (i + 1) % f.present.size();
+  }
+  report(state, f.set, falsePositives);
+}
+
+// What forwarding a reading costs: check, add, log
+void BM_Insert(benchmark::State& state) {
+  Filled& f = filled((size_t)state.range(0));
+  uint64_t falsePositives = f.set.stats().falsePositives;
+  gw::NullifierSet::Key key;
+  for (auto _ : state) {
+    f.fresh.key(key.data());
+    benchmark::DoNotOptimize(f.set.insert(key.data()));
+  }
+  f.set.flush();
+  report(state, f.set, falsePositives);
+}
+
+} // namespace
+
+BENCHMARK(BM_ContainsNew)->Arg(1 << 20)->Arg(1 << 22)->Arg(1 << 24);
+BENCHMARK(BM_ContainsRepeat)->Arg(1 << 20)->Arg(1 << 22)->Arg(1 << 24);
+BENCHMARK(BM_Insert)->Arg(1 << 20)->Arg(1 << 22)->Arg(1 << 24);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,156 @@
+/**
+ * Signature Verification Benchmarks
+ *
+ * Verifications per second against worker count, on packets built and
+ * signed exactly as the firmware does (wire::serializeDataPacket, ECDSA
+ * P-256 over SHA-256 of the first DATA_PACKET_SIGNED_SIZE bytes).
+ *
+ *   edgechain-verify-bench --benchmark_counters_tabular=true
+ *
+ * items_per_second is verifications per second. Worker threads are not
+ * visible to the CPU timer, so every case reports real time.
+ */
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "batch_verifier.h"
+#include "probe_protocol.h"
+#include "wire_codec.h"
+#include <benchmark/benchmark.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+namespace {
+
+const size_t DEVICES = 1000;
+const size_t PACKETS = 4096;
+const size_t BATCH = 1024;
+
+// A fleet of signed packets and the key file that goes with it
+struct Fleet {
+  gw::KeyCache keys{DEVICES};
+  std::vector<std::array<uint8_t, 64>> rawKeys;
+  std::vector<std::array<uint8_t, probe::PACKET_MAX>> packets;   // No probes: zeros
+  std::vector<const uint8_t*> pointers;
+
+  Fleet() {
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+    std::vector<EC_KEY*> devices(DEVICES);
+    std::vector<gw::Commitment> commitments(DEVICES);
+    rawKeys.resize(DEVICES);
+    for (size_t d = 0; d < DEVICES; d++) {
+      devices[d] = EC_KEY_new();
+      EC_KEY_set_group(devices[d], group);
+      EC_KEY_generate_key(devices[d]);
+      uint8_t encoded[65];
+      EC_POINT_point2oct(group, EC_KEY_get0_public_key(devices[d]),
+                         POINT_CONVERSION_UNCOMPRESSED, encoded, sizeof(encoded), nullptr);
+      memcpy(rawKeys[d].data(), encoded + 1, 64);
+      RAND_bytes(commitments[d].data(), 32);
+      keys.add(commitments[d].data(), rawKeys[d].data());
+    }
+
+    packets.resize(PACKETS);
+    for (size_t i = 0; i < PACKETS; i++) {
+      size_t d = i % DEVICES;
+      DataPacket packet;
+      memset(&packet, 0, sizeof(packet));
+      memcpy(packet.commitment, commitments[d].data(), 32);
+      packet.temperature = 20.0f + (float)(i % 100) / 10.0f;
+      packet.humidity = 55.0f;
+      packet.soilMoisture = 31.5f;
+      packet.timestamp = (uint32_t)(i * 1800000);
+      RAND_bytes(packet.nullifier, 32);
+      wire::serializeDataPacket(packet, packets[i].data());
+
+      uint8_t hash[32];
+      SHA256(packets[i].data(), wire::DATA_PACKET_SIGNED_SIZE, hash);
+      ECDSA_SIG* sig = ECDSA_do_sign(hash, 32, devices[d]);
+      const BIGNUM* r = nullptr;
+      const BIGNUM* s = nullptr;
+      ECDSA_SIG_get0(sig, &r, &s);
+      BN_bn2binpad(r, packets[i].data() + wire::DATA_PACKET_SIGNED_SIZE, 32);
+      BN_bn2binpad(s, packets[i].data() + wire::DATA_PACKET_SIGNED_SIZE + 32, 32);
+      ECDSA_SIG_free(sig);
+      pointers.push_back(packets[i].data());
+    }
+
+    for (EC_KEY* key : devices) EC_KEY_free(key);
+    EC_GROUP_free(group);
+  }
+};
+
+Fleet& fleet() {
+  static Fleet instance;
+  return instance;
+}
+
+void BM_VerifyBatch(benchmark::State& state) {
+  Fleet& f = fleet();
+  gw::BatchVerifier verifier(f.keys, (size_t)state.range(0));
+  std::vector<gw::VerifyResult> results(BATCH);
+  size_t offset = 0;
+  for (auto _ : state) {
+    verifier.verify(f.pointers.data() + offset, BATCH, results.data());
+    offset = (offset + BATCH) % PACKETS;
+  }
+  if (verifier.stats().invalid + verifier.stats().unknownKey > 0) {
+    state.SkipWithError("packet did not verify");
+  }
+  state.SetItemsProcessed((int64_t)state.iterations() * BATCH);
+  state.counters["threads"] = (double)verifier.threads();
+}
+
+// One key, one packet, no pool: the per-verification floor
+void BM_VerifySingle(benchmark::State& state) {
+  Fleet& f = fleet();
+  std::shared_ptr<const gw::PublicKey> key = f.keys.find(f.pointers[0]);
+  for (auto _ : state) {
+    bool ok = key->verify(f.pointers[0], wire::DATA_PACKET_SIGNED_SIZE,
+                          f.pointers[0] + wire::DATA_PACKET_SIGNED_SIZE);
+    benchmark::DoNotOptimize(ok);
+  }
+  state.SetItemsProcessed((int64_t)state.iterations());
+}
+
+// What the cache saves per packet: decoding and checking the point
+void BM_KeyDecode(benchmark::State& state) {
+  Fleet& f = fleet();
+  size_t d = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(gw::PublicKey::parse(f.rawKeys[d].data()));
+    d = (d + 1) % DEVICES;
+  }
+}
+
+void BM_KeyCacheHit(benchmark::State& state) {
+  Fleet& f = fleet();
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.keys.find(f.pointers[i]));
+    i = (i + 1) % DEVICES;
+  }
+}
+
+void threadCounts(benchmark::internal::Benchmark* b) {
+  size_t cores = std::thread::hardware_concurrency();
+  if (cores == 0) cores = 1;
+  for (size_t t = 1; t <= 2 * cores && t <= 64; t *= 2) b->Arg((int64_t)t);
+  if ((cores & (cores - 1)) != 0) b->Arg((int64_t)cores);
+}
+
+} // namespace
+
+BENCHMARK(BM_VerifyBatch)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_VerifySingle)->UseRealTime();
+BENCHMARK(BM_KeyDecode)->UseRealTime();
+BENCHMARK(BM_KeyCacheHit)->UseRealTime();
+
+BENCHMARK_MAIN();
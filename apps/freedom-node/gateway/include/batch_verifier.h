@@ -0,0 +1,78 @@
+/**
+ * Batch Verifier Header
+ *
+ * Checks DataPacket signatures on a thread pool. Each packet is taken in
+ * its wire form (wire::serializeDataPacket) followed by a sensor hub's
+ * probes item, or zeros, up to probe::PACKET_MAX bytes: the key is found
+ * by the commitment in the first 32 bytes, and the signature at offset 80
+ * covers the first wire::DATA_PACKET_SIGNED_SIZE bytes and the probes
+ * item (probe::signedMessage).
+ *
+ * A batch is split into one chunk per worker so queue traffic stays at a
+ * few tasks per batch however large it is.
+ */
+
+#ifndef BATCH_VERIFIER_H
+#define BATCH_VERIFIER_H
+
+#include "key_cache.h"
+#include "thread_pool.h"
+#include <functional>
+
+namespace gw {
+
+enum class VerifyResult : uint8_t {
+  Valid,
+  Invalid,      // Known key, bad signature
+  UnknownKey,   // Commitment not in the key file
+};
+
+struct VerifierStats {
+  uint64_t valid = 0;
+  uint64_t invalid = 0;
+  uint64_t unknownKey = 0;
+  uint64_t batches = 0;
+};
+
+class BatchVerifier {
+public:
+  static const size_t MIN_CHUNK = 8;   // Smaller chunks cost more in hand-off than they save
+
+  /**
+   * @param keys Key cache, used only from the submitting thread
+   * @param threads Worker count; 0 = one per hardware thread
+   */
+  BatchVerifier(KeyCache& keys, size_t threads);
+
+  /**
+   * Verify a batch and return when all results are in
+   * @param packets Wire-form packets (probe::PACKET_MAX bytes each)
+   * @param count Number of packets
+   * @param results Output, one per packet
+   */
+  void verify(const uint8_t* const* packets, size_t count, VerifyResult* results);
+
+  /**
+   * Verify a batch in the background. packets and results must stay valid
+   * until done runs; done runs once, on a worker thread (or inline when
+   * count is 0).
+   */
+  void verifyAsync(const uint8_t* const* packets, size_t count, VerifyResult* results,
+                   std::function<void()> done);
+
+  size_t threads() const { return _pool.size(); }
+
+  /** Counters; only up to date for batches whose done has run */
+  VerifierStats stats() const;
+
+private:
+  KeyCache& _keys;
+  ThreadPool _pool;
+
+  mutable std::mutex _statsMutex;
+  VerifierStats _stats;
+};
+
+} // namespace gw
+
+#endif // BATCH_VERIFIER_H
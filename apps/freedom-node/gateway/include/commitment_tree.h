@@ -0,0 +1,137 @@
+/**
+ * Commitment Tree Header
+ *
+ * Incremental Merkle tree of registered device commitments in a
+ * memory-mapped file, hashed as the device hashes (merkle_tree.h), so
+ * authentication paths for every device can be taken once per epoch.
+ *
+ * - Node store: one file, a header page then every node in in-order
+ *   position (node l, p at 2^(l+1) * p + 2^l - 1), so n leaves need under
+ *   3n slots and the file grows at the end as the tree does. Nodes above
+ *   the smallest subtree holding every leaf are not stored: the root is
+ *   climbed from there with zero subtrees.
+ * - append() only writes the leaf. commit() hashes the nodes above every
+ *   leaf appended since the last commit, one pass per level (about two
+ *   hashes per new leaf plus DEPTH), msyncs them, then the header with
+ *   the new leaf count, epoch and root.
+ * - Paths and path deltas are read from the committed tree; leaves
+ *   appended since are not in it yet.
+ * - On open, leaves written after the last commit are picked up again up
+ *   to the first empty slot, so a restart only loses what the kernel had
+ *   not written back.
+ *
+ * Single-threaded: runs on the caller's (loop) thread.
+ */
+
+#ifndef COMMITMENT_TREE_H
+#define COMMITMENT_TREE_H
+
+#include "key_cache.h"
+#include "merkle_tree.h"
+#include <string>
+#include <unordered_map>
+
+namespace gw {
+
+struct CommitmentTreeStats {
+  uint64_t appended = 0;
+  uint64_t duplicates = 0;    // Commitments already in the tree
+  uint64_t commits = 0;
+  uint64_t hashes = 0;        // Node hashes computed by commits
+};
+
+class CommitmentTree {
+public:
+  static const size_t HEADER_SIZE = 4096;   // Header page
+  static const size_t GROW_NODES = 65536;   // Smallest file growth, in nodes
+
+  CommitmentTree() {}
+  ~CommitmentTree();
+  CommitmentTree(const CommitmentTree&) = delete;
+  CommitmentTree& operator=(const CommitmentTree&) = delete;
+
+  /**
+   * Open or create a tree file
+   * @param path File path
+   * @return false on I/O error or a file that is not a tree of this DEPTH
+   */
+  bool open(const std::string& path);
+
+  /**
+   * Add a commitment (not in the root until commit())
+   * @param commitment Device commitment
+   * @param index Output (optional): its leaf index, new or existing
+   * @return false if the tree is full or the file could not grow
+   */
+  bool append(const uint8_t commitment[32], uint32_t* index = nullptr);
+
+  /**
+   * Leaf index of a commitment
+   * @return false if it was never appended
+   */
+  bool find(const uint8_t commitment[32], uint32_t* index) const;
+
+  /**
+   * Hash everything appended since the last commit and make it durable
+   * @param epoch Epoch the new root belongs to
+   * @return false on I/O error (the file keeps the previous root)
+   */
+  bool commit(uint32_t epoch);
+
+  /**
+   * Authentication path of a committed leaf
+   * @param index Leaf index, below leaves()
+   * @param path Output: DEPTH siblings, leaf level first
+   * @return false if the leaf is not committed
+   */
+  bool path(uint32_t index, uint8_t path[][merkle::HASH_SIZE]) const;
+
+  /**
+   * Siblings of a committed leaf that changed since an earlier commit
+   * @param index Leaf index, below leaves()
+   * @param fromLeaves leaves() at the commit the device's path is from
+   * @param out Output (up to merkle::DELTA_MAX_SIZE bytes)
+   * @return Bytes written, 0 if the leaf is not committed
+   */
+  size_t pathDelta(uint32_t index, uint32_t fromLeaves, uint8_t* out) const;
+
+  /** Committed root */
+  const uint8_t* root() const { return _root; }
+
+  /** Leaves in the committed root */
+  uint32_t leaves() const { return _leaves; }
+
+  /** Leaves at the commit before the last one: deltas since the previous epoch */
+  uint32_t previousLeaves() const { return _previousLeaves; }
+
+  /** Leaves appended, committed or not */
+  uint32_t size() const { return _size; }
+
+  uint32_t epoch() const { return _epoch; }
+
+  const CommitmentTreeStats& stats() const { return _stats; }
+
+private:
+  uint8_t* node(size_t level, uint64_t position) const;
+  bool reserve(uint64_t slots);
+  void rehash(uint64_t from, uint64_t to);
+  void climb(uint64_t leaves, uint8_t* root) const;
+  bool writeHeader();
+
+  std::string _path;
+  int _fd = -1;
+  uint8_t* _map = nullptr;
+  size_t _bytes = 0;
+
+  uint32_t _leaves = 0;
+  uint32_t _previousLeaves = 0;
+  uint32_t _size = 0;
+  uint32_t _epoch = 0;
+  uint8_t _root[merkle::HASH_SIZE];
+  std::unordered_map<Commitment, uint32_t, CommitmentHash> _index;
+  CommitmentTreeStats _stats;
+};
+
+} // namespace gw
+
+#endif // COMMITMENT_TREE_H
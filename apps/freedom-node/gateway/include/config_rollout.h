@@ -0,0 +1,91 @@
+/**
+ * Config Rollout Header
+ *
+ * Gateway side of remote device settings (firmware config_protocol.h).
+ * Takes one config message, compiled and signed by edgechain-config-pack
+ * (the gateway never holds the release key), and
+ * - broadcasts it (address 0) on every module when loaded or reloaded
+ * - reads the version report in each reading's trailer, and sends the
+ *   message again to a device that has not heard it, at most once per
+ *   RESEND_INTERVAL_MS
+ * - logs and counts what each device made of it
+ */
+
+#ifndef CONFIG_ROLLOUT_H
+#define CONFIG_ROLLOUT_H
+
+#include "config_protocol.h"
+#include "wire_codec.h"
+#include <functional>
+#include <unordered_map>
+
+namespace gw {
+
+struct ConfigStats {
+  uint64_t broadcasts = 0;
+  uint64_t resends = 0;
+  uint64_t applied = 0;         // Devices running this version
+  uint64_t rejected = 0;        // Invalid, unsupported, stale or not stored
+  uint64_t notAddressed = 0;    // Outside the message's groups
+};
+
+class ConfigRollout {
+public:
+  static const uint32_t RESEND_INTERVAL_MS = 600000;
+
+  typedef std::function<void(uint16_t address, const uint8_t* frame, size_t length)> Send;
+
+  /**
+   * Read a signed config file; on success the previous rollout and its
+   * per-device state are replaced
+   * @param path File written by edgechain-config-pack
+   * @return false if it cannot be read or is not a config message
+   */
+  bool load(const char* path);
+
+  /**
+   * Config message to broadcast
+   */
+  const uint8_t* message() const { return _message; }
+  size_t messageLength() const { return _length; }
+  uint16_t version() const { return _version; }
+
+  /**
+   * Note a broadcast of message(); devices are not sent it again for
+   * RESEND_INTERVAL_MS
+   */
+  void broadcastSent(uint64_t nowMs) {
+    _broadcastMs = nowMs;
+    _stats.broadcasts++;
+  }
+
+  /**
+   * A reading from a device: record its report, resend if it is behind
+   * @param address Device address
+   * @param message Reading (DataPacket + trailer)
+   * @param length Reading length
+   * @param nowMs Current time
+   * @param send Unicast downlink
+   */
+  void onReading(uint16_t address, const uint8_t* message, size_t length, uint64_t nowMs,
+                 const Send& send);
+
+  const ConfigStats& stats() const { return _stats; }
+
+private:
+  struct Device {
+    rcfg::Result result = rcfg::Result::None;
+    uint64_t sentMs = 0;
+  };
+
+  uint8_t _message[wire::MAX_FRAME_BYTES];
+  size_t _length = 0;
+  uint16_t _version = 0;
+  uint64_t _broadcastMs = 0;
+  std::unordered_map<uint16_t, Device> _devices;
+  ConfigStats _stats;
+};
+
+} // namespace gw
+
+#endif // CONFIG_ROLLOUT_H
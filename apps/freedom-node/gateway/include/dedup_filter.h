@@ -0,0 +1,68 @@
+/**
+ * Dedup Filter Header
+ *
+ * The same uplink can arrive more than once: several modules on one
+ * gateway hear it, or the device repeats it. Fragmented messages carry a
+ * sequence number and are matched on (address, sequence); short
+ * unfragmented frames are matched on a hash of their content within a
+ * short window, so that a device deliberately retrying (e.g. a
+ * registration whose ACK was lost) still gets through.
+ */
+
+#ifndef DEDUP_FILTER_H
+#define DEDUP_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+namespace gw {
+
+class DedupFilter {
+public:
+  static const size_t SEQUENCE_HISTORY = 16;   // Per address
+  static const size_t PAYLOAD_HISTORY = 256;   // All addresses
+
+  explicit DedupFilter(uint32_t windowMs = 2000) : _windowMs(windowMs) {}
+
+  /**
+   * Check and record a sequenced message
+   * @param address Sender address
+   * @param seq Fragment sequence number of the message
+   * @return true if the message was seen before (drop it)
+   */
+  bool seenSequence(uint16_t address, uint16_t seq);
+
+  /**
+   * Check and record an unsequenced frame by content
+   * @param address Sender address
+   * @param data Frame bytes
+   * @param length Frame length
+   * @param nowMs Receive time
+   * @return true if the same frame arrived within the window (drop it)
+   */
+  bool seenPayload(uint16_t address, const uint8_t* data, size_t length, uint64_t nowMs);
+
+  uint64_t duplicates() const { return _duplicates; }
+
+private:
+  struct SequenceRing {
+    uint16_t seqs[SEQUENCE_HISTORY];
+    uint8_t count = 0;
+    uint8_t next = 0;
+  };
+  struct PayloadEntry {
+    uint64_t hash = 0;
+    uint64_t atMs = 0;
+  };
+
+  uint32_t _windowMs;
+  std::unordered_map<uint16_t, SequenceRing> _sequences;
+  PayloadEntry _payloads[PAYLOAD_HISTORY];
+  size_t _nextPayload = 0;
+  uint64_t _duplicates = 0;
+};
+
+} // namespace gw
+
+#endif // DEDUP_FILTER_H
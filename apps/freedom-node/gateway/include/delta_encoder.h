@@ -0,0 +1,40 @@
+/**
+ * Delta Encoder Header
+ *
+ * Host side of the OTA patch format (firmware ota_protocol.h):
+ * - encodeDelta: bsdiff-style delta of two firmware images. Exact matches
+ *   are found through a hash index of the base image and then extended
+ *   approximately, so code that only moved (shifted addresses) becomes
+ *   runs of small byte differences that compress well.
+ * - compressLzss: heatshrink-compatible LZSS (window 2^10, lookahead 2^8),
+ *   the format ota::LzssDecoder reads on the device.
+ */
+
+#ifndef DELTA_ENCODER_H
+#define DELTA_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace gw {
+
+/**
+ * Delta that turns base into target
+ * @param base Image running on the devices
+ * @param target New image
+ * @return Uncompressed patch ("EDP1" records)
+ */
+std::vector<uint8_t> encodeDelta(const std::vector<uint8_t>& base,
+                                 const std::vector<uint8_t>& target);
+
+/**
+ * Compress for ota::LzssDecoder
+ * @param data Input
+ * @return Compressed bytes, the last one zero-padded
+ */
+std::vector<uint8_t> compressLzss(const std::vector<uint8_t>& data);
+
+} // namespace gw
+
+#endif // DELTA_ENCODER_H
@@ -0,0 +1,120 @@
+/**
+ * Forwarder Header
+ *
+ * Delivers decoded records to the proof server over a local Unix stream
+ * socket as newline-delimited JSON. A HOST:PORT address (no '/') connects
+ * over TCP instead, to an edgechain-merge on another machine. Records are batched into one write
+ * when enough accumulate or the flush interval passes. While the server
+ * is away records are kept in a bounded buffer (oldest kept, newest
+ * dropped and counted) and the connection is retried with backoff.
+ *
+ * The server sends requests back on the same socket:
+ *   {"type":"downlink","address":N,"payload":"<hex>"}
+ *   {"type":"ack","next":N}   journal records below offset N are done
+ *
+ * Records carrying an "offset" come from the journal: they are not kept
+ * across a disconnect, since the journal replays them from the last ack.
+ */
+
+#ifndef FORWARDER_H
+#define FORWARDER_H
+
+#include "line_buffer.h"
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+namespace gw {
+
+struct ForwarderStats {
+  uint64_t records = 0;        // Accepted into the buffer
+  uint64_t dropped = 0;        // Buffer full
+  uint64_t batches = 0;        // Writes that completed a batch
+  uint64_t connects = 0;
+  uint64_t downlinks = 0;      // Requests received from the server
+  uint64_t acks = 0;
+  uint64_t badRequests = 0;
+};
+
+class Forwarder {
+public:
+  typedef std::function<void(uint16_t address, const uint8_t* payload, size_t length)>
+      DownlinkHandler;
+  typedef std::function<void(uint64_t next)> AckHandler;
+  typedef std::function<void()> ConnectHandler;
+
+  static const uint32_t BACKOFF_MIN_MS = 100;
+  static const uint32_t BACKOFF_MAX_MS = 5000;
+
+  /**
+   * @param socketPath Proof-server socket, or HOST:PORT
+   * @param batchRecords Flush once this many records are waiting
+   * @param flushMs Flush records older than this
+   * @param maxPendingBytes Buffer bound while the server is slow or away
+   */
+  Forwarder(const std::string& socketPath, size_t batchRecords, uint32_t flushMs,
+            size_t maxPendingBytes);
+  ~Forwarder();
+
+  /**
+   * Queue one JSON record (no trailing newline)
+   * @param record Record text
+   * @param length Record length
+   * @param nowMs Current time
+   */
+  void push(const char* record, size_t length, uint64_t nowMs);
+
+  /**
+   * Reconnect when due and flush if the batch is full or old enough
+   * @param nowMs Current time
+   * @param force Flush whatever is waiting
+   */
+  void service(uint64_t nowMs, bool force = false);
+
+  /** Socket writable again after a partial write */
+  void onWritable(uint64_t nowMs);
+
+  /** Read downlink requests from the server */
+  void onReadable(uint64_t nowMs);
+
+  void setDownlinkHandler(DownlinkHandler handler) { _downlinkHandler = handler; }
+  void setAckHandler(AckHandler handler) { _ackHandler = handler; }
+  void setConnectHandler(ConnectHandler handler) { _connectHandler = handler; }
+
+  int fd() const { return _fd; }
+  bool isConnected() const { return _fd >= 0; }
+  bool wantsWrite() const { return _fd >= 0 && _blocked; }
+  size_t pendingBytes() const { return _pending.size() - _sent; }
+  const ForwarderStats& stats() const { return _stats; }
+
+private:
+  bool connect(uint64_t nowMs);
+  void disconnect(uint64_t nowMs);
+  void write(uint64_t nowMs);
+  void handleRequest(const char* line, size_t length);
+
+  std::string _socketPath;
+  size_t _batchRecords;
+  uint32_t _flushMs;
+  size_t _maxPendingBytes;
+
+  int _fd = -1;
+  std::string _pending;          // Records, each newline-terminated
+  size_t _sent = 0;              // Bytes of _pending already written
+  size_t _waitingRecords = 0;    // Records not yet handed to write()
+  uint64_t _oldestMs = 0;        // Arrival of the oldest waiting record
+  bool _blocked = false;         // Last write hit EAGAIN
+
+  uint32_t _backoffMs = BACKOFF_MIN_MS;
+  uint64_t _retryAtMs = 0;
+
+  LineBuffer _rx;
+  DownlinkHandler _downlinkHandler;
+  AckHandler _ackHandler;
+  ConnectHandler _connectHandler;
+  ForwarderStats _stats;
+};
+
+} // namespace gw
+
+#endif // FORWARDER_H
@@ -0,0 +1,195 @@
+/**
+ * Frame Merger Header
+ *
+ * When several gateways hear one uplink, each forwards its own record of
+ * it. The merger holds the first copy for a short window, collects the
+ * others and then emits one record: the best copy (valid signature first,
+ * then SNR, then RSSI) with a "gateway" field naming who heard it best and
+ * "receptions" listing every gateway's RSSI and SNR, for the server's data
+ * rate decisions.
+ *
+ * Copies match on (address, sequence, hash of the record). The hash skips
+ * the fields that differ between gateways: "offset", "port", "rssi",
+ * "snr" and "verified". A copy arriving after its record was emitted, but
+ * within rememberMs, is dropped as late. Alert readings are emitted on
+ * their first copy rather than waiting for the window.
+ *
+ * Journal records: a record merged from copies that carry an "offset"
+ * gets the merger's own offset in its place and is held, not emitted,
+ * until the server acks it: held() gives it to send (again, after a
+ * reconnect) and acked() releases it. Only then are the copies it covers
+ * done, as is a late copy once its record has been acked; ackNext() gives
+ * what a gateway may be acked up to. Records from gateways without a
+ * journal still go to the emit handler.
+ *
+ * Single-threaded: runs on the caller's (loop) thread.
+ */
+
+#ifndef FRAME_MERGER_H
+#define FRAME_MERGER_H
+
+#include <deque>
+#include <functional>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gw {
+
+struct FrameMergerStats {
+  uint64_t copies = 0;        // Records offered
+  uint64_t emitted = 0;       // Records forwarded
+  uint64_t merged = 0;        // Copies folded into another gateway's record
+  uint64_t late = 0;          // Copies after their record went out
+  uint64_t malformed = 0;     // Not a JSON object; passed through as they are
+};
+
+class FrameMerger {
+public:
+  typedef std::function<void(const char* record, size_t length)> EmitHandler;
+
+  /**
+   * @param windowMs How long the first copy waits for the others
+   * @param rememberMs How long an emitted record still absorbs late copies
+   * @param firstOffset Offset of the first held record; above any the
+   *        server may have seen from an earlier run
+   */
+  FrameMerger(uint32_t windowMs, uint32_t rememberMs, uint64_t firstOffset = 0)
+      : _windowMs(windowMs), _rememberMs(rememberMs), _heldBegin(firstOffset) {}
+
+  void setEmitHandler(EmitHandler handler) { _emit = handler; }
+
+  /**
+   * Take one record from a gateway
+   * @param peer Gateway connection
+   * @param gateway Gateway name, as it appears in "receptions"
+   * @param record Record text (no newline)
+   * @param length Record length
+   * @param nowMs Arrival time
+   */
+  void offer(uint32_t peer, const std::string& gateway, const char* record, size_t length,
+             uint64_t nowMs);
+
+  /**
+   * Emit the records whose window has closed and forget old ones
+   * @param nowMs Current time
+   */
+  void expire(uint64_t nowMs);
+
+  /** Emit everything still waiting (at shutdown) */
+  void flush();
+
+  /**
+   * Gateway that heard a device best in its last routine record: where its
+   * downlinks should go
+   * @param address Device address
+   * @param peer Output: gateway connection
+   * @return false if no record from the device was emitted yet
+   */
+  bool route(uint16_t address, uint32_t* peer) const;
+
+  /**
+   * A held record, with its "offset"
+   * @param offset Between heldBegin() and heldEnd()
+   * @return nullptr if it is not held
+   */
+  const std::string* held(uint64_t offset) const;
+
+  /** Oldest held record: the server has acked everything below it */
+  uint64_t heldBegin() const { return _heldBegin; }
+
+  /** Offset the next held record will get */
+  uint64_t heldEnd() const { return _heldBegin + _held.size(); }
+
+  /**
+   * The server is done with held records below an offset: release them and
+   * the copies they cover
+   * @param next The server's {"type":"ack","next":N}
+   */
+  void acked(uint64_t next);
+
+  /**
+   * Journal offset a gateway may be acked up to
+   * @param peer Gateway connection
+   * @param next Output: every offset below it is done
+   * @return false if the gateway sent no journal records
+   */
+  bool ackNext(uint32_t peer, uint64_t* next) const;
+
+  /** Forget a gateway's routes and offsets once its connection is gone */
+  void removePeer(uint32_t peer);
+
+  size_t pending() const { return _groups.size(); }
+  const FrameMergerStats& stats() const { return _stats; }
+
+private:
+  struct Key {
+    uint16_t address;
+    uint16_t seq;
+    uint64_t hash;
+    bool operator==(const Key& other) const {
+      return address == other.address && seq == other.seq && hash == other.hash;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return (size_t)(key.hash ^ ((uint64_t)key.address << 16 | key.seq));
+    }
+  };
+  struct Copy {
+    uint32_t peer;
+    std::string gateway;
+    int rssi;
+    int snr;
+    bool verified;
+    bool hasOffset;
+    uint64_t offset;
+  };
+  struct Group {
+    std::vector<Copy> copies;
+    size_t best = 0;
+    std::string record;       // The best copy, without its offset
+    bool radio = false;       // Carries rssi/snr: receptions apply
+    bool alert = false;       // May come on another spreading factor: not a route
+  };
+  struct Due {
+    uint64_t atMs;
+    Key key;
+  };
+  struct Emitted {
+    uint64_t forgetAtMs;
+    bool held;                // Has a merged offset
+    uint64_t offset;
+  };
+  struct Held {
+    std::string record;
+    std::vector<Copy> copies; // Done once the server acks the record
+  };
+  struct Offsets {
+    std::set<uint64_t> open;  // Offered, not done
+    uint64_t next = 0;        // Past the highest offered
+  };
+
+  void emit(const Key& key, Group& group, uint64_t nowMs);
+  void finish(const Copy& copy);
+
+  uint32_t _windowMs;
+  uint32_t _rememberMs;
+  std::unordered_map<Key, Group, KeyHash> _groups;
+  std::deque<Due> _due;                                   // Window closes, oldest first
+  std::unordered_map<Key, Emitted, KeyHash> _emitted;
+  std::deque<Due> _forget;
+  std::unordered_map<uint16_t, uint32_t> _routes;         // Address -> best gateway
+  std::unordered_map<uint32_t, Offsets> _offsets;         // Peer -> journal offsets
+  std::deque<Held> _held;                                 // Not acked, from _heldBegin
+  uint64_t _heldBegin;
+  EmitHandler _emit;
+  FrameMergerStats _stats;
+};
+
+} // namespace gw
+
+#endif // FRAME_MERGER_H
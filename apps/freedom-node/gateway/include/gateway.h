@@ -0,0 +1,249 @@
+/**
+ * Gateway Header
+ *
+ * The ingest daemon: one epoll loop over all module ports, the
+ * proof-server socket, a flush timer and the termination signals.
+ *
+ * Per received frame: hex-decode, reassemble fragments (per port), drop
+ * duplicates, then
+ * - echo requests (0x04) are answered locally from the same port
+ * - registrations over registrationsPerMin are answered locally with a
+ *   retry-after (0x10) naming the device's slot (registration_protocol.h),
+ *   so a site-wide power cut drains at that rate instead of colliding
+ * - registrations (0x00), data packets, history responses (0x0D) and
+ *   federated learning updates (0x0F) are forwarded as JSON records
+ * With a key file, data packet signatures are checked on a worker pool
+ * first: invalid ones are dropped, the rest are forwarded with "verified".
+ * Downlinks from the server go out through the port that last heard the
+ * destination address. Unicast ones wait in a per-device queue for the
+ * device's predicted receive window, short ones bundled into one frame,
+ * within the gateway's duty cycle (downlink_protocol.h); broadcasts and
+ * the local answers to a frame just heard go out at once.
+ *
+ * With an OTA campaign, devices that are heard are offered the update and
+ * their status reports (0x09) are answered with patch chunks.
+ *
+ * With a device config, the settings message is broadcast on every module
+ * at start and on SIGHUP, and sent again to devices whose readings report
+ * an older version.
+ *
+ * Time beacons are broadcast on every module at start and every
+ * timeBeaconS, and sent by unicast to devices whose readings carry no
+ * recent time report; readings with one are forwarded with "timeSynced".
+ *
+ * Alert readings (a tripped rule in the trailer, see alert_rules.h) are
+ * logged, verified without waiting for the batch to fill and flushed to
+ * the server at once. They may arrive on a module kept at the alert
+ * spreading factor, so they do not change where downlinks go.
+ *
+ * With a journal directory, readings are appended to the journal instead
+ * and forwarded from it once durable, at most forwardWindow records ahead
+ * of the proof server's last ack; after a reconnect (or a restart) delivery
+ * resumes from that ack.
+ *
+ * With a commitment tree file, forwarded registrations are appended to the
+ * tree (commitment_tree.h), and each new epoch the server broadcasts (0x02)
+ * commits its root, forwarded as a "commitment_root" record for the server
+ * to check against its own.
+ *
+ * With a nullifier directory, a reading whose (timestamp, nullifier) was
+ * already forwarded in the last nullifierEpochs epochs is dropped as a
+ * replay (nullifier_set.h). Only readings with a valid signature, or all of
+ * them without keys, are added: an unknown-key reading is checked but
+ * cannot claim a key a genuine one would then lose.
+ */
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "batch_verifier.h"
+#include "commitment_tree.h"
+#include "config_rollout.h"
+#include "dedup_filter.h"
+#include "downlink_protocol.h"
+#include "forwarder.h"
+#include "journal.h"
+#include "nullifier_set.h"
+#include "ota_campaign.h"
+#include "registration_protocol.h"
+#include "rylr_port.h"
+#include "time_beacon.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gw {
+
+struct GatewayOptions {
+  std::vector<std::string> ports;
+  RadioConfig radio;
+  bool configureRadio = true;
+  std::string socketPath = "/run/edgechain/gateway.sock";
+  size_t batchRecords = 32;
+  uint32_t flushMs = 50;
+  size_t maxPendingBytes = 4 * 1024 * 1024;
+  uint32_t statsIntervalS = 60;
+  std::string keysPath;          // Bound-device keys; empty = forward unverified
+  size_t verifyThreads = 0;      // 0 = one per hardware thread
+  size_t verifyBatch = 64;
+  std::string journalDir;        // Empty = forward readings straight from memory
+  size_t journalSegmentRecords = 65536;
+  size_t journalMaxSegments = 64;
+  size_t forwardWindow = 1024;   // Journal records in flight before an ack
+  std::string otaCampaignPath;   // Empty = no firmware updates
+  std::string deviceConfigPath;  // Empty = devices keep their settings
+  uint32_t timeBeaconS = 21600;  // 0 = no beacons, timestamps count from boot
+  uint32_t registrationsPerMin = reg::PACE_PER_MIN;   // 0 = forward every registration
+  uint32_t registrationBurst = reg::PACE_BURST;
+  bool scheduleDownlinks = true;   // false = send downlinks as they come
+  uint32_t downlinkDutyPermille = dl::DUTY_PERMILLE;   // 0 = no limit
+  std::string commitmentTreePath;   // Empty = no commitment tree
+  std::string nullifierDir;      // Empty = no replay check beyond the dedup window
+  uint32_t nullifierEpochs = 2;  // Epochs of nullifiers kept, the current one included
+  size_t nullifierPartition = 1 << 20;   // Keys per sealed table
+};
+
+struct GatewayStats {
+  uint64_t badFrames = 0;       // Not hex, or empty
+  uint64_t registrations = 0;
+  uint64_t registrationsDeferred = 0;   // Answered with a retry-after, not forwarded
+  uint64_t readings = 0;
+  uint64_t alerts = 0;          // Readings that tripped an alert rule
+  uint64_t echoes = 0;
+  uint64_t history = 0;         // History response frames
+  uint64_t flUpdates = 0;       // Federated learning updates
+  uint64_t unknown = 0;         // Message types the gateway does not handle
+  uint64_t downlinksSent = 0;
+  uint64_t downlinksFailed = 0;
+  uint64_t badSignatures = 0;   // Dropped after verification
+  uint64_t journalFailures = 0; // Readings the journal could not take or return
+  uint64_t treeFailures = 0;    // Commitments the tree could not take, failed commits
+  uint64_t replays = 0;         // Readings dropped by the nullifier set
+};
+
+class Gateway {
+public:
+  static const uint32_t PORT_RETRY_MS = 2000;
+  static const uint32_t FRAGMENT_MAX_AGE_MS = 30000;
+  static const uint32_t COMPACT_INTERVAL_MS = 10000;
+
+  explicit Gateway(const GatewayOptions& options);
+  ~Gateway();
+
+  /**
+   * Open the ports and set up the event loop
+   * @return false if no port could be opened or epoll setup failed
+   */
+  bool begin();
+
+  /**
+   * Run until SIGINT/SIGTERM
+   * @return Process exit code
+   */
+  int run();
+
+  const GatewayStats& stats() const { return _stats; }
+
+private:
+  struct PortState {
+    std::unique_ptr<RylrPort> port;
+    std::unique_ptr<wire::Reassembler> reassembler;
+    uint64_t retryAtMs = 0;
+  };
+
+  // A decoded data packet on its way to the forwarder
+  struct Reading {
+    size_t port;
+    uint16_t address;
+    int rssi;
+    int snr;
+    uint16_t seq;
+    uint8_t alerts;             // Rules tripped (alert_rules.h), 0 for routine readings
+    bool timeSynced;            // Timestamp is network time (time_sync.h)
+    bool hasAnalytics;          // Reading carried an analytics report (edge_analytics.h)
+    analytics::Report analyticsReport;
+    uint8_t packet[probe::PACKET_MAX];   // DataPacket, then its probes item or zeros
+    uint8_t extraLength;        // Bytes of the channels item (sensor_schema.h), 0 if none
+    uint8_t extra[schema::Extra::SIZE];
+  };
+
+  struct VerifyBatch {
+    std::vector<Reading> readings;
+    std::vector<const uint8_t*> packets;
+    std::vector<VerifyResult> results;
+  };
+
+  void onFrame(RylrPort& port, const wire::RcvFrame& frame);
+  void onMessage(RylrPort& port, const wire::RcvFrame& frame, const uint8_t* message,
+                 size_t length, bool sequenced, uint16_t seq);
+  void forwardRegistration(const RylrPort& port, const wire::RcvFrame& frame,
+                           const uint8_t* message);
+  void forwardReading(const Reading& reading, const char* verified);
+  void forwardHistory(const RylrPort& port, const wire::RcvFrame& frame,
+                      const uint8_t* message, size_t length);
+  void forwardFlUpdate(const RylrPort& port, const wire::RcvFrame& frame,
+                       const uint8_t* message, size_t length);
+  size_t formatReading(const Reading& reading, const char* verified, const uint64_t* offset,
+                       char* out, size_t size);
+  void pumpJournal();
+  void submitVerification();
+  void onVerified();
+  void finishVerification();
+  size_t downlinkPort(uint16_t address) const;
+  void onDownlink(uint16_t address, const uint8_t* payload, size_t length);
+  void sendDownlink(uint16_t address, const uint8_t* payload, size_t length);
+  void serviceDownlinks();
+  void sendTime(uint16_t address);
+  void broadcastConfig();
+  void broadcastTime();
+  void commitTree(uint32_t epoch);
+
+  void onTick();
+  bool openPort(size_t index);
+  void closePort(size_t index);
+  void updateSocketWatch();
+  void printStats();
+  void reloadKeys();
+  void reloadConfig();
+
+  GatewayOptions _options;
+  std::vector<PortState> _ports;
+  DedupFilter _dedup;
+  Forwarder _forwarder;
+  std::unordered_map<uint16_t, size_t> _lastHeard;   // Address -> port index
+  reg::Pacer _pacer;
+  dl::Scheduler _downlinks;
+  GatewayStats _stats;
+
+  int _epoll = -1;
+  int _signalFd = -1;
+  int _timerFd = -1;
+  int _verifyEventFd = -1;
+  int _watchedSocket = -1;
+  bool _watchingWrite = false;
+  uint64_t _nowMs = 0;
+  uint64_t _nextStatsMs = 0;
+
+  std::unique_ptr<Journal> _journal;
+  uint64_t _sendOffset = 0;          // Next journal offset to forward
+  uint64_t _nextCompactMs = 0;
+
+  std::unique_ptr<OtaCampaign> _ota;
+  std::unique_ptr<ConfigRollout> _config;
+  std::unique_ptr<TimeBeacon> _time;
+  std::unique_ptr<CommitmentTree> _tree;
+  std::unique_ptr<NullifierSet> _nullifiers;
+
+  // Verification: batches fill on the loop thread, complete on workers
+  std::unique_ptr<KeyCache> _keys;
+  std::unique_ptr<VerifyBatch> _filling;
+  size_t _verifyInFlight = 0;
+  std::mutex _doneMutex;
+  std::vector<VerifyBatch*> _done;
+  std::unique_ptr<BatchVerifier> _verifier;   // Last: joins its workers first
+};
+
+} // namespace gw
+
+#endif // GATEWAY_H
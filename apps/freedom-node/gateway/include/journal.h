@@ -0,0 +1,197 @@
+/**
+ * Journal Header
+ *
+ * Append-only, memory-mapped store of accepted readings, so that radio
+ * ingest never waits on the proof server and nothing is lost while it is
+ * down or slow.
+ *
+ * - Segments: preallocated files of fixed-size records, named by the
+ *   offset of their first record. Records carry a CRC; on open, the tail
+ *   of the last segment is scanned and a torn record ends the journal.
+ *   Segments written before records grew to hold a probes item
+ *   (LEGACY_RECORD_SIZE) still open and are appended to without one.
+ * - Group commit: append() only writes into the mapping; commit() hands
+ *   everything appended so far to a background thread that msyncs it
+ *   and the cursors together. durableEnd() tells how far that got.
+ * - Cursors: named consumer positions (next offset to deliver), persisted
+ *   with each commit.
+ * - Compaction: segments entirely below every cursor are deleted; past
+ *   maxSegments the oldest is deleted anyway and counted as lost.
+ * - Device index: offsets of each commitment's records, rebuilt on open.
+ *
+ * Everything except the committer runs on the caller's (loop) thread.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "edge_analytics.h"
+#include "key_cache.h"
+#include "probe_protocol.h"
+#include "sensor_schema.h"
+#include "wire_codec.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gw {
+
+// Record flags
+const uint8_t JOURNAL_CHECKED = 0x01;    // Signature verification ran
+const uint8_t JOURNAL_VERIFIED = 0x02;   // ... and the key was known
+const uint8_t JOURNAL_ALERT_SHIFT = 2;   // Bits 2-4: alert rules tripped (alert_rules.h)
+const uint8_t JOURNAL_TIME_SYNCED = 0x20; // Timestamp is network time (time_sync.h)
+const uint8_t JOURNAL_ANALYTICS = 0x40;  // Analytics report stored (edge_analytics.h)
+const uint8_t JOURNAL_PROBES = 0x80;     // Sensor hub probes item stored (probe_protocol.h)
+
+struct JournalRecord {
+  uint64_t offset = 0;        // Assigned by append()
+  uint64_t receivedMs = 0;    // Wall clock at the gateway
+  uint16_t address = 0;
+  uint16_t seq = 0;
+  int16_t rssi = 0;
+  int8_t snr = 0;
+  uint8_t port = 0;
+  uint8_t flags = 0;
+  uint8_t packet[wire::DATA_PACKET_SIZE];
+  uint8_t analytics[analytics::REPORT_SIZE] = {0};   // Encoded report, if JOURNAL_ANALYTICS
+  uint8_t probes[probe::ITEM_MAX] = {0};              // Trailer item, if JOURNAL_PROBES
+  uint8_t extraLength = 0;                            // Channels item value (sensor_schema.h)
+  uint8_t extra[schema::Extra::SIZE] = {0};
+};
+
+struct JournalStats {
+  uint64_t appended = 0;
+  uint64_t commits = 0;       // Completed group commits
+  uint64_t lost = 0;          // Records deleted before every cursor passed them
+  uint64_t torn = 0;          // Invalid tail records found on open
+  size_t segments = 0;
+};
+
+class Journal {
+public:
+  static const size_t RECORD_SIZE = 256;
+  static const size_t LEGACY_RECORD_SIZE = 192;   // Before JOURNAL_PROBES
+  static const size_t HEADER_SIZE = 4096;   // Segment header page
+  static const size_t CURSOR_MAX = 16;
+
+  Journal() {}
+  ~Journal();
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /**
+   * Open or create a journal
+   * @param dir Directory (created if missing)
+   * @param recordsPerSegment Segment capacity (fixed when the journal is created)
+   * @param maxSegments Retention bound; 0 = unbounded
+   * @return false on I/O error
+   */
+  bool open(const std::string& dir, size_t recordsPerSegment, size_t maxSegments);
+
+  /**
+   * Append a record (not yet durable)
+   * @param record Record; offset is filled in
+   * @return false if a new segment could not be created
+   */
+  bool append(JournalRecord& record);
+
+  /** Start a group commit of everything appended so far */
+  void commit();
+
+  /**
+   * Read one record
+   * @param offset Record offset, begin() <= offset < end()
+   * @param record Output
+   * @return false if out of range or the record fails its CRC
+   */
+  bool read(uint64_t offset, JournalRecord* record) const;
+
+  uint64_t begin() const { return _begin; }
+  uint64_t end() const { return _end; }
+  uint64_t durableEnd() const { return _durable.load(); }
+
+  /**
+   * Consumer position: next offset to deliver (begin() for a new name)
+   */
+  uint64_t cursor(const std::string& name) const;
+
+  /**
+   * Move a consumer forward; persisted with the next commit
+   * @param name Consumer name (up to 23 characters)
+   * @param offset Next offset to deliver
+   */
+  void setCursor(const std::string& name, uint64_t offset);
+
+  /**
+   * Delete segments behind every cursor (and beyond maxSegments)
+   * @return Segments deleted
+   */
+  size_t compact();
+
+  /**
+   * Offsets of one device's records
+   * @param commitment Device commitment
+   * @param from First offset of interest
+   * @param out Output offsets, ascending
+   * @param max Capacity of out
+   * @return Number written
+   */
+  size_t deviceOffsets(const uint8_t commitment[32], uint64_t from, uint64_t* out,
+                       size_t max) const;
+
+  JournalStats stats() const;
+
+private:
+  struct Segment {
+    uint64_t first = 0;
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t bytes = 0;
+    size_t recordSize = RECORD_SIZE;
+    std::string path;
+    ~Segment();
+  };
+  typedef std::shared_ptr<Segment> SegmentPtr;
+
+  SegmentPtr openSegment(const std::string& path, uint64_t first, bool create);
+  bool addSegment();
+  void recover(Segment& segment);
+  uint8_t* slot(uint64_t offset) const;
+  void indexRecord(const uint8_t* commitment, uint64_t offset);
+  void dropSegment();
+  bool loadCursors();
+  void commitLoop();
+
+  std::string _dir;
+  size_t _recordsPerSegment = 0;
+  size_t _maxSegments = 0;
+  uint64_t _begin = 0;
+  uint64_t _end = 0;
+  std::atomic<uint64_t> _durable{0};
+
+  std::vector<SegmentPtr> _segments;   // Ascending; shared with the committer
+  std::map<std::string, uint64_t> _cursors;
+  std::unordered_map<Commitment, std::vector<uint64_t>, CommitmentHash> _index;
+  JournalStats _stats;
+
+  // Committer
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::thread _committer;
+  uint64_t _commitTarget = 0;
+  bool _cursorsDirty = false;
+  bool _stopping = false;
+  int _cursorFd = -1;
+  int _dirFd = -1;
+};
+
+} // namespace gw
+
+#endif // JOURNAL_H
@@ -0,0 +1,84 @@
+/**
+ * Key Cache Header
+ *
+ * Public keys of bound devices, looked up by the commitment each
+ * DataPacket carries. All known keys are held raw (64 bytes each); the
+ * decoded form is kept for the most recently used ones.
+ *
+ * Key file, one device per line ('#' starts a comment):
+ *   <commitment, 64 hex> <public key X || Y, 128 hex>
+ *
+ * Not thread-safe: look keys up on the submitting thread and hand the
+ * shared pointers to the workers.
+ */
+
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include "public_key.h"
+#include <array>
+#include <list>
+#include <string.h>
+#include <unordered_map>
+
+namespace gw {
+
+typedef std::array<uint8_t, 32> Commitment;
+
+struct CommitmentHash {
+  size_t operator()(const Commitment& c) const {
+    // Commitments are SHA-256 outputs: any 8 bytes are already uniform
+    size_t h;
+    memcpy(&h, c.data(), sizeof(h));
+    return h;
+  }
+};
+
+class KeyCache {
+public:
+  explicit KeyCache(size_t capacity = 4096) : _capacity(capacity ? capacity : 1) {}
+
+  /**
+   * Replace the known keys with the contents of a key file
+   * @param path Key file
+   * @return false if the file could not be read (known keys unchanged)
+   */
+  bool load(const char* path);
+
+  /**
+   * Add or replace one device key
+   * @param commitment Device commitment
+   * @param publicKey Raw key, X || Y
+   */
+  void add(const uint8_t commitment[32], const uint8_t publicKey[64]);
+
+  /**
+   * Decoded key for a commitment
+   * @param commitment Commitment from the packet
+   * @return Key, or nullptr if unknown or not a valid point
+   */
+  std::shared_ptr<const PublicKey> find(const uint8_t commitment[32]);
+
+  size_t size() const { return _entries.size(); }
+  uint64_t hits() const { return _hits; }
+  uint64_t misses() const { return _misses; }   // Decoded on demand
+
+private:
+  struct Entry {
+    std::array<uint8_t, 64> raw;
+    std::shared_ptr<const PublicKey> decoded;
+    std::list<const Commitment*>::iterator lru;   // Valid while decoded
+  };
+
+  void evictOne();
+
+  size_t _capacity;
+  std::unordered_map<Commitment, Entry, CommitmentHash> _entries;
+  std::list<const Commitment*> _lru;   // Decoded entries, most recent first
+  uint64_t _hits = 0;
+  uint64_t _misses = 0;
+};
+
+} // namespace gw
+
+#endif // KEY_CACHE_H
@@ -0,0 +1,49 @@
+/**
+ * Line Buffer Header
+ *
+ * Fixed receive buffer that hands out complete lines in place. Used for
+ * the module UARTs and the proof-server socket alike.
+ */
+
+#ifndef LINE_BUFFER_H
+#define LINE_BUFFER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace gw {
+
+class LineBuffer {
+public:
+  static const size_t CAPACITY = 4096;
+
+  /**
+   * Read whatever the descriptor has available (one read() call)
+   * @param fd Non-blocking descriptor
+   * @return Bytes read, 0 at end of file, -1 on error (errno set; EAGAIN when drained)
+   */
+  ssize_t fill(int fd);
+
+  /**
+   * Take the next complete line, without CR/LF; empty lines are skipped
+   * @param line Output: points into the buffer, valid until the next fill()
+   * @param length Output: line length
+   * @return true if a line was available
+   */
+  bool next(const char** line, size_t* length);
+
+  /** Reset to empty (after the descriptor is reopened) */
+  void clear() { _start = _end = 0; }
+
+  size_t overflows() const { return _overflows; }   // Lines longer than CAPACITY
+
+private:
+  char _data[CAPACITY];
+  size_t _start = 0;
+  size_t _end = 0;
+  size_t _overflows = 0;
+};
+
+} // namespace gw
+
+#endif // LINE_BUFFER_H
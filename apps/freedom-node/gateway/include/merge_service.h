@@ -0,0 +1,117 @@
+/**
+ * Merge Service Header
+ *
+ * Sits between several gateways and the proof server so that a site can
+ * add gateways for coverage without the server seeing every uplink once
+ * per gateway. Gateways connect to it as they would to the server (a Unix
+ * socket, or TCP from other machines); records pass through a FrameMerger
+ * and one forwarder carries the merged stream to the server.
+ *
+ * - Acks: merged records carry the service's own offsets, and the server
+ *   acks those. A gateway is acked up to a journal offset only once the
+ *   server has acked every merged record covering its copies; records
+ *   not yet acked are sent again after a reconnect, so a crash of the
+ *   service or the server loses nothing the gateways' journals hold.
+ * - Downlinks: sent to the gateway that heard the device best in its last
+ *   merged record; broadcasts, and devices no gateway has been heard
+ *   from, go to every gateway.
+ * - A gateway is named by its peer address (TCP) or "local-N" (Unix).
+ */
+
+#ifndef MERGE_SERVICE_H
+#define MERGE_SERVICE_H
+
+#include "forwarder.h"
+#include "frame_merger.h"
+#include "line_buffer.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace gw {
+
+struct MergeOptions {
+  std::string listenPath = "/run/edgechain/merge.sock";   // Empty = no Unix listener
+  std::string listenTcp;          // [HOST:]PORT; empty = no TCP listener
+  std::string socketPath = "/run/edgechain/gateway.sock"; // Proof server
+  uint32_t windowMs = 300;        // Wait for other gateways' copies
+  uint32_t rememberS = 60;        // Drop copies later than the window for this long
+  size_t batchRecords = 32;
+  uint32_t flushMs = 50;
+  size_t maxPendingBytes = 4 * 1024 * 1024;
+  uint32_t statsIntervalS = 60;
+};
+
+struct MergeStats {
+  uint64_t connects = 0;          // Gateway connections accepted
+  uint64_t downlinks = 0;         // Downlink requests sent to gateways
+  uint64_t broadcasts = 0;        // ... of them to every gateway
+  uint64_t writeFailures = 0;     // Requests a gateway socket would not take
+  uint64_t overflows = 0;         // Gateway lines too long to merge
+};
+
+class MergeService {
+public:
+  static const size_t MAX_GATEWAYS = 64;
+
+  explicit MergeService(const MergeOptions& options);
+  ~MergeService();
+
+  /**
+   * Listen for gateways and set up the event loop
+   * @return false if no listener could be set up or epoll setup failed
+   */
+  bool begin();
+
+  /**
+   * Run until SIGINT/SIGTERM
+   * @return Process exit code
+   */
+  int run();
+
+private:
+  struct Peer {
+    int fd = -1;
+    std::string name;
+    LineBuffer rx;
+    uint64_t acked = 0;           // Last ack sent
+    bool hasAcked = false;
+    uint64_t records = 0;
+  };
+
+  int listenUnix();
+  int listenTcp();
+  void accept(int fd, bool tcp);
+  void onPeerReadable(uint32_t id);
+  void closePeer(uint32_t id);
+  bool sendLine(Peer& peer, const char* line, size_t length);
+  void sendAcks();
+  void pumpHeld();
+  void onDownlink(uint16_t address, const uint8_t* payload, size_t length);
+  void onTick();
+  void updateSocketWatch();
+  void printStats();
+
+  MergeOptions _options;
+  FrameMerger _merger;
+  Forwarder _forwarder;
+  MergeStats _stats;
+  std::map<uint32_t, std::unique_ptr<Peer>> _peers;
+  uint32_t _nextPeer = 1;
+  uint32_t _localPeers = 0;
+  uint64_t _sendOffset = 0;       // Next held record for the forwarder
+
+  int _epoll = -1;
+  int _signalFd = -1;
+  int _timerFd = -1;
+  int _unixFd = -1;
+  int _tcpFd = -1;
+  int _watchedSocket = -1;
+  bool _watchingWrite = false;
+  uint64_t _nowMs = 0;
+  uint64_t _nextStatsMs = 0;
+};
+
+} // namespace gw
+
+#endif // MERGE_SERVICE_H
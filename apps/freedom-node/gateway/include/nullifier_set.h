@@ -0,0 +1,190 @@
+/**
+ * Nullifier Set Header
+ *
+ * Readings already forwarded, by (timestamp, nullifier): the 36 bytes at
+ * KEY_OFFSET of the DataPacket, both covered by the signature. A device's
+ * nullifier is the same for every reading in an epoch, so the timestamp
+ * tells its readings apart; a repeat is a reading replayed or delivered
+ * twice (another module, a resend after a reset), which the short-window
+ * DedupFilter no longer sees.
+ *
+ * - Partitions: the live one is an in-memory hash set, its keys also
+ *   appended to a log file (written on flush(), not synced). It is sealed
+ *   when the epoch changes or it holds partitionEntries keys.
+ * - Sealing: a background thread writes the keys as a table file, which
+ *   is then memory-mapped (by flush()) and the log deleted. Until then
+ *   lookups use the set being sealed. Rotation does not wait for earlier
+ *   seals; only past SEALS_MAX in flight does it wait for the oldest. A
+ *   table holds a blocked Bloom filter (one 64-byte
+ *   block per key, BLOOM_BITS_PER_KEY bits a key), then the keys in hash
+ *   order behind a directory of buckets of about BUCKET_KEYS keys.
+ * - Lookups: the live set, then every table's Bloom block, all prefetched
+ *   together, and only on a hit the key's bucket. A new key costs a hash
+ *   probe and about one cache miss per table, overlapped; a repeat two or
+ *   three more.
+ * - Expiry: tables of epochs more than retainEpochs - 1 behind the current
+ *   one are deleted.
+ * - Recovery: on open the tables are mapped again; a log whose table is
+ *   missing is sealed then, except the newest, which becomes live again.
+ *
+ * Everything except the sealing thread runs on the caller's (loop) thread.
+ */
+
+#ifndef NULLIFIER_SET_H
+#define NULLIFIER_SET_H
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace gw {
+
+struct NullifierSetStats {
+  uint64_t inserted = 0;
+  uint64_t repeats = 0;          // Keys already present
+  uint64_t bloomHits = 0;        // Table Bloom filters that passed a key
+  uint64_t falsePositives = 0;   // ... whose table did not hold it
+  uint64_t sealed = 0;           // Partitions written as tables
+  uint64_t expired = 0;          // Tables deleted
+  size_t tables = 0;
+  uint64_t tableKeys = 0;        // Keys in tables
+  size_t liveKeys = 0;
+};
+
+class NullifierSet {
+public:
+  static const size_t KEY_SIZE = 36;            // Timestamp (u32) then nullifier
+  static const size_t KEY_OFFSET = 44;          // In the serialized DataPacket
+  static const size_t BLOOM_BITS_PER_KEY = 10;  // About 1% false positives
+  static const size_t BLOOM_HASHES = 7;
+  static const size_t BUCKET_KEYS = 8;          // Directory granularity
+  static const size_t SEALS_MAX = 4;            // Partitions being sealed at once
+
+  typedef std::array<uint8_t, KEY_SIZE> Key;
+
+  NullifierSet() {}
+  ~NullifierSet();
+  NullifierSet(const NullifierSet&) = delete;
+  NullifierSet& operator=(const NullifierSet&) = delete;
+
+  /**
+   * Open or create a nullifier set
+   * @param dir Directory (created if missing)
+   * @param retainEpochs Epochs kept, the current one included (at least 1)
+   * @param partitionEntries Keys in the live partition before it is sealed
+   * @return false on I/O error
+   */
+  bool open(const std::string& dir, uint32_t retainEpochs, size_t partitionEntries);
+
+  /**
+   * Add a key unless it is already present
+   * @param key KEY_SIZE bytes (packet + KEY_OFFSET)
+   * @return false if it was already present
+   */
+  bool insert(const uint8_t* key);
+
+  /**
+   * Add a key that contains() has just reported absent, without looking
+   * it up again
+   */
+  void add(const uint8_t* key);
+
+  /**
+   * Whether a key is present
+   */
+  bool contains(const uint8_t* key);
+
+  /**
+   * Start a new epoch: seal the live partition and expire old tables
+   * @param epoch New epoch (ignored unless it differs from epoch())
+   */
+  void setEpoch(uint32_t epoch);
+
+  /**
+   * Write logged keys out and pick up a finished table. Call from the
+   * loop's tick.
+   */
+  void flush();
+
+  /**
+   * Wait for the seals in progress to finish
+   */
+  void drain();
+
+  uint32_t epoch() const { return _epoch; }
+
+  NullifierSetStats stats() const;
+
+private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+  typedef std::unordered_set<Key, KeyHash> KeySet;
+
+  // A sealed partition on its way to a table; its keys stay readable here
+  struct Seal {
+    KeySet keys;
+    std::string log;
+    std::string path;
+    std::thread thread;
+    std::atomic<bool> done{false};
+    bool ok = false;
+  };
+
+  struct Table {
+    uint32_t epoch = 0;
+    uint32_t part = 0;
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t bytes = 0;
+    uint64_t count = 0;
+    unsigned blockBits = 0;     // log2 of the Bloom blocks
+    unsigned bucketBits = 0;    // log2 of the directory buckets
+    const uint8_t* bloom = nullptr;
+    const uint8_t* directory = nullptr;
+    const uint8_t* keys = nullptr;
+    std::string path;
+    ~Table();
+    const uint8_t* block(uint64_t h1) const;
+    bool contains(const uint8_t* key, uint64_t h1, uint64_t h2, NullifierSetStats& stats) const;
+  };
+
+  static bool writeTable(const KeySet& keys, uint32_t epoch, uint32_t part,
+                         const std::string& path);
+  std::shared_ptr<Table> openTable(const std::string& path);
+  uint32_t nextPart(uint32_t epoch) const;
+  std::string partitionPath(uint32_t epoch, uint32_t part, const char* suffix) const;
+  bool openLog();
+  bool loadLog(const std::string& path, KeySet* keys);
+  void writeLog();
+  void seal();
+  void rotate(uint32_t epoch);
+  void finishSeals(bool wait);
+  void finishSeal(Seal& seal);
+  void expire();
+
+  std::string _dir;
+  uint32_t _retainEpochs = 1;
+  size_t _partitionEntries = 0;
+  uint32_t _epoch = 0;
+  uint32_t _part = 0;
+
+  KeySet _live;
+  int _logFd = -1;
+  std::vector<uint8_t> _logBuffer;
+  std::vector<std::shared_ptr<Table>> _tables;
+
+  std::deque<std::unique_ptr<Seal>> _seals;   // Oldest first
+
+  NullifierSetStats _stats;
+};
+
+} // namespace gw
+
+#endif // NULLIFIER_SET_H
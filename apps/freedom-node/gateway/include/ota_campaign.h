@@ -0,0 +1,77 @@
+/**
+ * OTA Campaign Header
+ *
+ * Gateway side of delta firmware updates (firmware ota_protocol.h). Loads
+ * a campaign file from edgechain-ota-pack and drives every device it hears:
+ * - an offer when a device that has not finished is heard, at most once
+ *   per OFFER_INTERVAL_MS
+ * - on each status report, the next missing chunks from its bitmap window
+ *
+ * The device decides everything else (base image, signature, resume
+ * after a reset); its reports are the only state kept here.
+ */
+
+#ifndef OTA_CAMPAIGN_H
+#define OTA_CAMPAIGN_H
+
+#include "ota_protocol.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace gw {
+
+struct OtaStats {
+  uint64_t offers = 0;
+  uint64_t chunks = 0;
+  uint64_t statuses = 0;
+  uint64_t updated = 0;         // Devices that applied the image
+  uint64_t upToDate = 0;
+  uint64_t rejected = 0;        // Wrong base, bad signature or failed
+};
+
+class OtaCampaign {
+public:
+  static const uint32_t OFFER_INTERVAL_MS = 60000;
+  static const size_t CHUNKS_PER_STATUS = 16;
+
+  typedef std::function<void(uint16_t address, const uint8_t* frame, size_t length)> Send;
+
+  /**
+   * Read a campaign file
+   * @param path File written by edgechain-ota-pack
+   * @return false if it cannot be read or is malformed
+   */
+  bool load(const char* path);
+
+  /**
+   * Any uplink from a device: offer the update if it is due
+   */
+  void onHeard(uint16_t address, uint64_t nowMs, const Send& send);
+
+  /**
+   * A status report (MSG_OTA_STATUS) from a device
+   */
+  void onStatus(uint16_t address, const uint8_t* message, size_t length, uint64_t nowMs,
+                const Send& send);
+
+  const ota::Offer& offer() const { return _offer; }
+  const OtaStats& stats() const { return _stats; }
+
+private:
+  struct Device {
+    ota::State state = ota::State::Idle;
+    uint64_t offeredMs = 0;
+    bool offered = false;
+  };
+
+  std::vector<uint8_t> _file;
+  ota::Offer _offer;
+  const uint8_t* _patch = nullptr;
+  std::unordered_map<uint16_t, Device> _devices;
+  OtaStats _stats;
+};
+
+} // namespace gw
+
+#endif // OTA_CAMPAIGN_H
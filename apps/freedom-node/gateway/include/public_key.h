@@ -0,0 +1,49 @@
+/**
+ * Public Key Header
+ *
+ * A device's P-256 public key, decoded and checked once so repeated
+ * verifications skip point decoding. Verification matches
+ * SecureElement::sign(): ECDSA over SHA-256(data), signature as R || S.
+ */
+
+#ifndef PUBLIC_KEY_H
+#define PUBLIC_KEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+typedef struct ec_key_st EC_KEY;
+
+namespace gw {
+
+class PublicKey {
+public:
+  /**
+   * Decode a raw key as exported by SecureElement::getPublicKey()
+   * @param raw X || Y, 32 bytes each
+   * @return Key, or nullptr if the point is not on the curve
+   */
+  static std::shared_ptr<const PublicKey> parse(const uint8_t raw[64]);
+
+  ~PublicKey();
+  PublicKey(const PublicKey&) = delete;
+  PublicKey& operator=(const PublicKey&) = delete;
+
+  /**
+   * Verify a signature; safe to call from several threads at once
+   * @param data Signed bytes
+   * @param length Number of signed bytes
+   * @param signature R || S, 32 bytes each
+   * @return true if valid
+   */
+  bool verify(const uint8_t* data, size_t length, const uint8_t signature[64]) const;
+
+private:
+  explicit PublicKey(EC_KEY* key) : _key(key) {}
+  EC_KEY* _key;
+};
+
+} // namespace gw
+
+#endif // PUBLIC_KEY_H
@@ -0,0 +1,131 @@
+/**
+ * RYLR896 Port Header
+ *
+ * One LoRa module on one serial port. Received +RCV lines are parsed in
+ * place and handed to the frame handler; outgoing AT commands are queued
+ * and sent one at a time, each waiting for its +OK/+ERR.
+ */
+
+#ifndef RYLR_PORT_H
+#define RYLR_PORT_H
+
+#include "line_buffer.h"
+#include "wire_codec.h"
+#include <deque>
+#include <functional>
+#include <string>
+
+namespace gw {
+
+// Radio settings applied at startup (AT+NETWORKID/ADDRESS/BAND/PARAMETER/CRFOP)
+struct RadioConfig {
+  uint32_t baud = 115200;
+  uint8_t networkId = 6;
+  uint16_t address = 1;
+  uint32_t frequency = 915000000;
+  uint8_t spreadingFactor = 9;
+  uint16_t bandwidthKHz = 125;
+  uint8_t txPower = 20;
+};
+
+struct PortStats {
+  uint64_t frames = 0;          // Well-formed +RCV lines
+  uint64_t badLines = 0;        // +RCV lines that did not parse
+  uint64_t commandsOk = 0;
+  uint64_t commandsFailed = 0;  // +ERR or no reply in time
+  uint64_t commandsDropped = 0; // TX queue full
+};
+
+class RylrPort {
+public:
+  typedef std::function<void(RylrPort& port, const wire::RcvFrame& frame)> FrameHandler;
+
+  static const size_t TX_QUEUE_MAX = 64;
+  static const uint32_t COMMAND_TIMEOUT_MS = 2000;
+
+  RylrPort(const std::string& path, size_t index) : _path(path), _index(index) {}
+  ~RylrPort();
+
+  /**
+   * Open the serial device
+   * @param baud Baud rate
+   * @return true if opened
+   */
+  bool open(uint32_t baud);
+
+  /** Close after an I/O error; open() may be called again */
+  void close();
+
+  /**
+   * Queue the module configuration commands
+   * @param config Radio settings
+   * @param nowMs Current time
+   */
+  void configure(const RadioConfig& config, uint64_t nowMs);
+
+  /**
+   * Queue an AT+SEND
+   * @param address Destination address
+   * @param data Payload bytes (at most wire::MAX_FRAME_BYTES)
+   * @param length Payload length
+   * @param nowMs Current time
+   * @return true if queued
+   */
+  bool send(uint16_t address, const uint8_t* data, size_t length, uint64_t nowMs);
+
+  /**
+   * Queue a time beacon (time_sync.h). The wall clock is read when the
+   * command is written to the module, not when it is queued, so commands
+   * ahead of it do not make it late.
+   * @param address Destination address, 0 for every device
+   * @param nowMs Current time
+   * @return true if queued
+   */
+  bool sendTime(uint16_t address, uint64_t nowMs);
+
+  /**
+   * Read everything the module has sent and dispatch complete lines
+   * @param nowMs Current time
+   * @return false if the device has gone away
+   */
+  bool onReadable(uint64_t nowMs);
+
+  /**
+   * Time out a command that got no reply
+   * @param nowMs Current time
+   */
+  void poll(uint64_t nowMs);
+
+  void setFrameHandler(FrameHandler handler) { _handler = handler; }
+
+  int fd() const { return _fd; }
+  bool isOpen() const { return _fd >= 0; }
+  const std::string& path() const { return _path; }
+  size_t index() const { return _index; }
+  const PortStats& stats() const { return _stats; }
+
+private:
+  void handleLine(const char* line, size_t length, uint64_t nowMs);
+  struct Command {
+    std::string text;
+    int timeAddress = -1;         // >= 0: time beacon, formatted when sent
+  };
+
+  void enqueue(Command command, uint64_t nowMs);
+  void startNext(uint64_t nowMs);
+
+  std::string _path;
+  size_t _index;
+  int _fd = -1;
+  LineBuffer _rx;
+  FrameHandler _handler;
+  PortStats _stats;
+
+  std::deque<Command> _txQueue;       // Front is in flight when _awaitingReply
+  bool _awaitingReply = false;
+  uint64_t _replyDeadlineMs = 0;
+};
+
+} // namespace gw
+
+#endif // RYLR_PORT_H
@@ -0,0 +1,24 @@
+/**
+ * Serial Port Header
+ *
+ * Raw termios access to the USB-UART adapters the RYLR896 modules sit on.
+ */
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stdint.h>
+
+namespace gw {
+
+/**
+ * Open a serial device in raw 8N1 mode, non-blocking
+ * @param path Device path, e.g. /dev/ttyUSB0
+ * @param baud Baud rate (9600 - 921600)
+ * @return File descriptor, or -1 on error (errno set)
+ */
+int openSerial(const char* path, uint32_t baud);
+
+} // namespace gw
+
+#endif // SERIAL_PORT_H
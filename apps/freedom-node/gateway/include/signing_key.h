@@ -0,0 +1,47 @@
+/**
+ * Signing Key Header
+ *
+ * The release key's private half, for the offline packers
+ * (edgechain-ota-pack, edgechain-config-pack). Signatures are what
+ * SecureElement::verify() checks: ECDSA over SHA-256(data), as R || S.
+ */
+
+#ifndef SIGNING_KEY_H
+#define SIGNING_KEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+typedef struct ec_key_st EC_KEY;
+
+namespace gw {
+
+class SigningKey {
+public:
+  /**
+   * Read a P-256 private key
+   * @param pemPath PEM file (openssl ecparam -name prime256v1 -genkey)
+   * @return Key, or nullptr (reason printed) if unreadable or another curve
+   */
+  static std::unique_ptr<SigningKey> load(const char* pemPath);
+
+  ~SigningKey();
+  SigningKey(const SigningKey&) = delete;
+  SigningKey& operator=(const SigningKey&) = delete;
+
+  /**
+   * Sign data
+   * @param signature Output: R || S, 32 bytes each
+   * @return false if signing failed
+   */
+  bool sign(const uint8_t* data, size_t length, uint8_t signature[64]) const;
+
+private:
+  explicit SigningKey(EC_KEY* key) : _key(key) {}
+  EC_KEY* _key;
+};
+
+} // namespace gw
+
+#endif // SIGNING_KEY_H
@@ -0,0 +1,53 @@
+/**
+ * Thread Pool Header
+ *
+ * Fixed set of worker threads draining one FIFO of tasks.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gw {
+
+class ThreadPool {
+public:
+  /**
+   * @param threads Worker count; 0 = one per hardware thread
+   */
+  explicit ThreadPool(size_t threads);
+
+  /** Finishes queued tasks, then joins the workers */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Queue a task for any worker
+   * @param task Work to run
+   */
+  void submit(std::function<void()> task);
+
+  size_t size() const { return _workers.size(); }
+
+private:
+  void work();
+
+  std::vector<std::thread> _workers;
+  std::deque<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  bool _stopping = false;
+};
+
+} // namespace gw
+
+#endif // THREAD_POOL_H
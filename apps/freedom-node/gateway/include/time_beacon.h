@@ -0,0 +1,79 @@
+/**
+ * Time Beacon Header
+ *
+ * Gateway side of network time (firmware time_sync.h). Devices count
+ * from boot until they hear a beacon, so the gateway
+ * - broadcasts one (address 0) on every module at start and every
+ *   interval; the device's drift correction keeps it close in between
+ * - sends one by unicast to a device whose reading has no time report
+ *   (reset since the last beacon) or an old one (missed broadcasts), at
+ *   most once per RESEND_INTERVAL_MS
+ * The beacon's time is read as its AT+SEND is written (RylrPort::sendTime).
+ */
+
+#ifndef TIME_BEACON_H
+#define TIME_BEACON_H
+
+#include "time_sync.h"
+#include <functional>
+#include <unordered_map>
+
+namespace gw {
+
+struct TimeStats {
+  uint64_t broadcasts = 0;
+  uint64_t unicasts = 0;
+  uint64_t synced = 0;          // Readings stamped with network time
+  uint64_t unsynced = 0;        // Readings counting from boot
+};
+
+class TimeBeacon {
+public:
+  static const uint32_t RESEND_INTERVAL_MS = 600000;
+
+  typedef std::function<void(uint16_t address)> Send;
+
+  /**
+   * @param intervalS Broadcast period
+   */
+  explicit TimeBeacon(uint32_t intervalS) : _intervalMs((uint64_t)intervalS * 1000ULL) {}
+
+  /**
+   * Whether the next broadcast is due
+   */
+  bool broadcastDue(uint64_t nowMs) const {
+    return _broadcastMs == 0 || nowMs - _broadcastMs >= _intervalMs;
+  }
+
+  /**
+   * Note a broadcast
+   */
+  void broadcastSent(uint64_t nowMs) {
+    _broadcastMs = nowMs;
+    _stats.broadcasts++;
+  }
+
+  /**
+   * A reading from a device: count it, send a beacon if it needs one
+   * @param address Device address
+   * @param message Reading (DataPacket + trailer)
+   * @param length Reading length
+   * @param nowMs Current time
+   * @param send Unicast beacon
+   * @return Whether the reading's timestamp is network time
+   */
+  bool onReading(uint16_t address, const uint8_t* message, size_t length, uint64_t nowMs,
+                 const Send& send);
+
+  const TimeStats& stats() const { return _stats; }
+
+private:
+  uint64_t _intervalMs;
+  uint64_t _broadcastMs = 0;
+  std::unordered_map<uint16_t, uint64_t> _sentMs;   // Last unicast per device
+  TimeStats _stats;
+};
+
+} // namespace gw
+
+#endif // TIME_BEACON_H
@@ -0,0 +1,109 @@
+/**
+ * Batch Verifier Implementation
+ */
+
+#include "batch_verifier.h"
+#include "probe_protocol.h"
+#include "wire_codec.h"
+#include <atomic>
+#include <condition_variable>
+
+namespace gw {
+
+namespace {
+
+// Shared by the chunks of one batch; the last chunk to finish reports
+struct BatchState {
+  std::vector<const uint8_t*> packets;
+  std::vector<std::shared_ptr<const PublicKey>> keys;
+  VerifyResult* results;
+  std::atomic<size_t> chunksLeft;
+  std::function<void()> done;
+};
+
+const size_t SIGNATURE_OFFSET = wire::DATA_PACKET_SIGNED_SIZE;
+
+} // namespace
+
+BatchVerifier::BatchVerifier(KeyCache& keys, size_t threads) : _keys(keys), _pool(threads) {}
+
+void BatchVerifier::verify(const uint8_t* const* packets, size_t count, VerifyResult* results) {
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool complete = false;
+  verifyAsync(packets, count, results, [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    complete = true;
+    finished.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return complete; });
+}
+
+void BatchVerifier::verifyAsync(const uint8_t* const* packets, size_t count,
+                                VerifyResult* results, std::function<void()> done) {
+  if (count == 0) {
+    done();
+    return;
+  }
+
+  std::shared_ptr<BatchState> state = std::make_shared<BatchState>();
+  state->packets.assign(packets, packets + count);
+  state->keys.resize(count);
+  state->results = results;
+  state->done = std::move(done);
+  for (size_t i = 0; i < count; i++) state->keys[i] = _keys.find(packets[i]);
+
+  size_t chunks = _pool.size();
+  size_t chunkSize = (count + chunks - 1) / chunks;
+  if (chunkSize < MIN_CHUNK) chunkSize = MIN_CHUNK;
+  chunks = (count + chunkSize - 1) / chunkSize;
+  state->chunksLeft = chunks;
+
+  for (size_t c = 0; c < chunks; c++) {
+    size_t begin = c * chunkSize;
+    size_t end = begin + chunkSize < count ? begin + chunkSize : count;
+    _pool.submit([this, state, begin, end] {
+      VerifierStats local;
+      for (size_t i = begin; i < end; i++) {
+        const uint8_t* packet = state->packets[i];
+        const PublicKey* key = state->keys[i].get();
+        VerifyResult result;
+        uint8_t message[probe::SIGNED_MAX];
+        if (!key) {
+          result = VerifyResult::UnknownKey;
+          local.unknownKey++;
+        } else if (key->verify(message, probe::signedMessage(packet, probe::PACKET_MAX, message),
+                               packet + SIGNATURE_OFFSET)) {
+          result = VerifyResult::Valid;
+          local.valid++;
+        } else {
+          result = VerifyResult::Invalid;
+          local.invalid++;
+        }
+        state->results[i] = result;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.valid += local.valid;
+        _stats.invalid += local.invalid;
+        _stats.unknownKey += local.unknownKey;
+      }
+      if (--state->chunksLeft == 0) {
+        {
+          std::lock_guard<std::mutex> lock(_statsMutex);
+          _stats.batches++;
+        }
+        state->done();
+      }
+    });
+  }
+}
+
+VerifierStats BatchVerifier::stats() const {
+  std::lock_guard<std::mutex> lock(_statsMutex);
+  return _stats;
+}
+
+} // namespace gw
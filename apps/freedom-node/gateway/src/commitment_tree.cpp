@@ -0,0 +1,269 @@
+/**
+ * Commitment Tree Implementation
+ */
+
+#include "commitment_tree.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+const char TREE_MAGIC[8] = {'E', 'C', 'M', 'T', 'R', 'E', 'E', '1'};
+const size_t NODE = merkle::HASH_SIZE;
+
+// Header layout (little-endian):
+//   0 magic, 8 depth u32, 12 leaves u32, 16 previous leaves u32, 20 epoch u32,
+//   32 root (HASH_SIZE)
+const size_t ROOT_AT = 32;
+
+void putU32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t slotOf(size_t level, uint64_t position) {
+  return (position << (level + 1)) + (1ULL << level) - 1;
+}
+
+// Lowest level whose first node covers every leaf
+size_t topLevel(uint64_t leaves) {
+  size_t level = 0;
+  while ((1ULL << level) < leaves) level++;
+  return level;
+}
+
+// Slots a tree of this many leaves occupies
+uint64_t slotsFor(uint64_t leaves) {
+  if (leaves == 0) return 0;
+  uint64_t slots = 0;
+  for (size_t level = 0; level <= topLevel(leaves); level++) {
+    uint64_t slot = slotOf(level, (leaves - 1) >> level);
+    if (slot + 1 > slots) slots = slot + 1;
+  }
+  return slots;
+}
+
+bool isEmpty(const uint8_t* leaf) {
+  for (size_t i = 0; i < NODE; i++) {
+    if (leaf[i]) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+CommitmentTree::~CommitmentTree() {
+  if (_map) munmap(_map, _bytes);
+  if (_fd >= 0) close(_fd);
+}
+
+bool CommitmentTree::open(const std::string& path) {
+  _path = path;
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  struct stat st;
+  if (_fd < 0 || fstat(_fd, &st) != 0) {
+    perror(path.c_str());
+    return false;
+  }
+
+  bool create = st.st_size == 0;
+  if (create) {
+    if (!reserve(GROW_NODES)) return false;
+    memcpy(_map, TREE_MAGIC, 8);
+    putU32(_map + 8, (uint32_t)merkle::DEPTH);
+    memcpy(_root, merkle::zeroHash(merkle::DEPTH), NODE);
+    return writeHeader();
+  }
+
+  _bytes = (size_t)st.st_size;
+  void* map = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (_bytes < HEADER_SIZE || map == MAP_FAILED) {
+    if (map != MAP_FAILED) munmap(map, _bytes);
+    fprintf(stderr, "%s: not a commitment tree\n", path.c_str());
+    return false;
+  }
+  _map = (uint8_t*)map;
+  if (memcmp(_map, TREE_MAGIC, 8) != 0 || getU32(_map + 8) != merkle::DEPTH) {
+    fprintf(stderr, "%s: not a commitment tree of depth %zu\n", path.c_str(), merkle::DEPTH);
+    return false;
+  }
+  _leaves = _size = getU32(_map + 12);
+  _previousLeaves = getU32(_map + 16);
+  _epoch = getU32(_map + 20);
+  memcpy(_root, _map + ROOT_AT, NODE);
+  uint64_t capacity = (_bytes - HEADER_SIZE) / NODE;
+  if (slotsFor(_leaves) > capacity) {
+    fprintf(stderr, "%s: truncated\n", path.c_str());
+    return false;
+  }
+
+  for (uint32_t i = 0; i < _leaves; i++) {
+    Commitment c;
+    memcpy(c.data(), node(0, i), NODE);
+    _index.emplace(c, i);
+  }
+
+  // A commit cut short may have rewritten the right edge for leaves it
+  // never recorded: hash it again and check it against the root
+  if (_leaves > 0) {
+    rehash(_leaves - 1, _leaves);
+    uint8_t root[NODE];
+    climb(_leaves, root);
+    if (memcmp(root, _root, NODE) != 0) {
+      fprintf(stderr, "%s: nodes do not match the committed root\n", path.c_str());
+      return false;
+    }
+  }
+
+  // Leaves appended after the last commit, up to the first gap
+  while (_size < merkle::MAX_LEAVES && 2ULL * _size < capacity) {
+    const uint8_t* leaf = node(0, _size);
+    Commitment c;
+    memcpy(c.data(), leaf, NODE);
+    if (isEmpty(leaf) || !_index.emplace(c, _size).second) break;
+    _size++;
+  }
+  return true;
+}
+
+uint8_t* CommitmentTree::node(size_t level, uint64_t position) const {
+  return _map + HEADER_SIZE + slotOf(level, position) * NODE;
+}
+
+bool CommitmentTree::reserve(uint64_t slots) {
+  size_t bytes = HEADER_SIZE + (size_t)slots * NODE;
+  if (bytes <= _bytes) return true;
+  // Double, so appends remap O(log n) times
+  size_t grown = _bytes > HEADER_SIZE ? HEADER_SIZE + 2 * (_bytes - HEADER_SIZE) : 0;
+  if (grown < bytes) grown = bytes;
+  if (grown < HEADER_SIZE + GROW_NODES * NODE) grown = HEADER_SIZE + GROW_NODES * NODE;
+
+  // Allocate up front: a write into a hole on a full disk would be SIGBUS
+  int err = posix_fallocate(_fd, 0, (off_t)grown);
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", _path.c_str(), strerror(err));
+    return false;
+  }
+  void* map = mmap(nullptr, grown, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (map == MAP_FAILED) {
+    perror(_path.c_str());
+    return false;
+  }
+  if (_map) munmap(_map, _bytes);
+  _map = (uint8_t*)map;
+  _bytes = grown;
+  return true;
+}
+
+bool CommitmentTree::append(const uint8_t commitment[32], uint32_t* index) {
+  Commitment c;
+  memcpy(c.data(), commitment, NODE);
+  auto found = _index.find(c);
+  if (found != _index.end()) {
+    if (index) *index = found->second;
+    _stats.duplicates++;
+    return true;
+  }
+  // An all-zero leaf is the empty leaf
+  if (_size >= merkle::MAX_LEAVES || isEmpty(commitment) || !reserve(2ULL * _size + 1)) {
+    return false;
+  }
+
+  memcpy(node(0, _size), commitment, NODE);
+  _index.emplace(c, _size);
+  if (index) *index = _size;
+  _size++;
+  _stats.appended++;
+  return true;
+}
+
+bool CommitmentTree::find(const uint8_t commitment[32], uint32_t* index) const {
+  Commitment c;
+  memcpy(c.data(), commitment, NODE);
+  auto found = _index.find(c);
+  if (found == _index.end()) return false;
+  *index = found->second;
+  return true;
+}
+
+void CommitmentTree::rehash(uint64_t from, uint64_t to) {
+  for (size_t level = 1; level <= topLevel(to); level++) {
+    uint64_t last = (to - 1) >> level;
+    for (uint64_t p = from >> level; p <= last; p++) {
+      uint64_t right = 2 * p + 1;
+      const uint8_t* rightNode = (right << (level - 1)) < to ? node(level - 1, right)
+                                                               : merkle::zeroHash(level - 1);
+      merkle::hashNode(node(level - 1, 2 * p), rightNode, node(level, p));
+      _stats.hashes++;
+    }
+  }
+}
+
+void CommitmentTree::climb(uint64_t leaves, uint8_t* root) const {
+  if (leaves == 0) {
+    memcpy(root, merkle::zeroHash(merkle::DEPTH), NODE);
+    return;
+  }
+  size_t top = topLevel(leaves);
+  memcpy(root, node(top, 0), NODE);
+  for (size_t level = top; level < merkle::DEPTH; level++) {
+    merkle::hashNode(root, merkle::zeroHash(level), root);
+  }
+}
+
+bool CommitmentTree::commit(uint32_t epoch) {
+  if (!reserve(slotsFor(_size))) return false;
+  if (_size > _leaves) rehash(_leaves, _size);
+  climb(_size, _root);
+
+  _previousLeaves = _leaves;
+  _leaves = _size;
+  _epoch = epoch;
+  _stats.commits++;
+  // Nodes first: the header must never name a root its nodes do not hold
+  if (msync(_map, _bytes, MS_SYNC) != 0) {
+    perror(_path.c_str());
+    return false;
+  }
+  return writeHeader();
+}
+
+bool CommitmentTree::writeHeader() {
+  putU32(_map + 12, _leaves);
+  putU32(_map + 16, _previousLeaves);
+  putU32(_map + 20, _epoch);
+  memcpy(_map + ROOT_AT, _root, NODE);
+  if (msync(_map, HEADER_SIZE, MS_SYNC) != 0) {
+    perror(_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool CommitmentTree::path(uint32_t index, uint8_t path[][merkle::HASH_SIZE]) const {
+  if (index >= _leaves) return false;
+  for (size_t level = 0; level < merkle::DEPTH; level++) {
+    uint64_t sibling = ((uint64_t)index >> level) ^ 1;
+    if ((sibling << level) < _leaves) {
+      memcpy(path[level], node(level, sibling), NODE);
+    } else {
+      memcpy(path[level], merkle::zeroHash(level), NODE);
+    }
+  }
+  return true;
+}
+
+size_t CommitmentTree::pathDelta(uint32_t index, uint32_t fromLeaves, uint8_t* out) const {
+  uint8_t siblings[merkle::DEPTH][merkle::HASH_SIZE];
+  if (!path(index, siblings)) return 0;
+  return merkle::encodeDelta(merkle::deltaLevels(index, fromLeaves, _leaves), siblings, out);
+}
+
+} // namespace gw
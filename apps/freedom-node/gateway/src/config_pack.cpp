@@ -0,0 +1,97 @@
+/**
+ * Device Settings Packer
+ *
+ * Compiles a settings file (firmware config_protocol.h: "name value"
+ * lines, "version N" required) into the config message the gateway
+ * rolls out with --device-config, signed with the release key. Devices
+ * drop settings the release key did not sign, so the key stays on the
+ * signing machine and the gateway only relays the result.
+ *
+ * Usage: edgechain-config-pack --key RELEASE.pem --out CONFIG SETTINGS
+ */
+
+#include "config_protocol.h"
+#include "signing_key.h"
+#include "wire_codec.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace {
+
+void usage(const char* program) {
+  fprintf(stderr, "Usage: %s --key RELEASE.pem --out CONFIG SETTINGS\n", program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* keyPath = nullptr;
+  const char* outPath = nullptr;
+  const char* settingsPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--key") == 0 && value) {
+      keyPath = value;
+      i++;
+    } else if (strcmp(arg, "--out") == 0 && value) {
+      outPath = value;
+      i++;
+    } else if (arg[0] != '-' && !settingsPath) {
+      settingsPath = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!keyPath || !outPath || !settingsPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  FILE* f = fopen(settingsPath, "r");
+  if (!f) {
+    perror(settingsPath);
+    return 1;
+  }
+  std::string text;
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) text.append(buffer, n);
+  fclose(f);
+
+  uint8_t message[wire::MAX_FRAME_BYTES];
+  size_t length;
+  char error[128];
+  if (!rcfg::compileText(text.c_str(), message, &length, error, sizeof(error))) {
+    fprintf(stderr, "%s: %s\n", settingsPath, error);
+    return 1;
+  }
+
+  std::unique_ptr<gw::SigningKey> key = gw::SigningKey::load(keyPath);
+  if (!key) return 1;
+  if (!key->sign(message, length, message + length)) {
+    fprintf(stderr, "signing failed\n");
+    return 1;
+  }
+  length += rcfg::SIGNATURE_SIZE;
+
+  f = fopen(outPath, "wb");
+  if (!f) {
+    perror(outPath);
+    return 1;
+  }
+  bool written = fwrite(message, length, 1, f) == 1;
+  if (fclose(f) != 0 || !written) {
+    perror(outPath);
+    return 1;
+  }
+
+  rcfg::Config config;
+  rcfg::parseConfig(message, length, &config);
+  printf("settings v%u: %zu bytes of items, %zu-byte frame\n", config.version, config.itemsLen,
+         length);
+  return 0;
+}
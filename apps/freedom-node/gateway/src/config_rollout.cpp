@@ -0,0 +1,64 @@
+/**
+ * Config Rollout Implementation
+ */
+
+#include "config_rollout.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace gw {
+
+bool ConfigRollout::load(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  // One byte more than a frame holds, to tell a frame from a longer file
+  uint8_t message[wire::MAX_FRAME_BYTES + 1];
+  size_t length = fread(message, 1, sizeof(message), f);
+  fclose(f);
+
+  rcfg::Config config;
+  if (length > wire::MAX_FRAME_BYTES || !rcfg::parseConfig(message, length, &config)) {
+    fprintf(stderr, "%s: not a signed config file (edgechain-config-pack)\n", path);
+    return false;
+  }
+  memcpy(_message, message, length);
+  _length = length;
+  _version = config.version;
+  _broadcastMs = 0;
+  _devices.clear();
+  _stats = ConfigStats();
+  return true;
+}
+
+void ConfigRollout::onReading(uint16_t address, const uint8_t* message, size_t length,
+                              uint64_t nowMs, const Send& send) {
+  if (_length == 0) return;
+  Device& device = _devices[address];
+
+  rcfg::Report report;
+  if (rcfg::findReport(message, length, &report) && report.heard >= _version) {
+    rcfg::Result result = report.applied >= _version ? rcfg::Result::Applied : report.result;
+    if (result == device.result) return;
+    device.result = result;
+    switch (result) {
+      case rcfg::Result::Applied: _stats.applied++; break;
+      case rcfg::Result::NotAddressed: _stats.notAddressed++; break;
+      default: _stats.rejected++; break;
+    }
+    fprintf(stderr, "config: device %u %s v%u (running v%u)\n", address,
+            rcfg::resultName(result), report.heard, report.applied);
+    return;
+  }
+
+  // Missed the broadcast (asleep, out of range, collision): unicast it
+  uint64_t lastMs = device.sentMs > _broadcastMs ? device.sentMs : _broadcastMs;
+  if (lastMs != 0 && nowMs - lastMs < RESEND_INTERVAL_MS) return;
+  send(address, _message, _length);
+  device.sentMs = nowMs;
+  _stats.resends++;
+}
+
+} // namespace gw
@@ -0,0 +1,51 @@
+/**
+ * Dedup Filter Implementation
+ */
+
+#include "dedup_filter.h"
+
+namespace gw {
+
+namespace {
+
+// FNV-1a over the address and the bytes
+uint64_t frameHash(uint16_t address, const uint8_t* data, size_t length) {
+  uint64_t h = 14695981039346656037ULL;
+  auto mix = [&h](uint8_t b) { h = (h ^ b) * 1099511628211ULL; };
+  mix((uint8_t)address);
+  mix((uint8_t)(address >> 8));
+  for (size_t i = 0; i < length; i++) mix(data[i]);
+  return h;
+}
+
+} // namespace
+
+bool DedupFilter::seenSequence(uint16_t address, uint16_t seq) {
+  SequenceRing& ring = _sequences[address];
+  for (size_t i = 0; i < ring.count; i++) {
+    if (ring.seqs[i] == seq) {
+      _duplicates++;
+      return true;
+    }
+  }
+  ring.seqs[ring.next] = seq;
+  ring.next = (uint8_t)((ring.next + 1) % SEQUENCE_HISTORY);
+  if (ring.count < SEQUENCE_HISTORY) ring.count++;
+  return false;
+}
+
+bool DedupFilter::seenPayload(uint16_t address, const uint8_t* data, size_t length,
+                              uint64_t nowMs) {
+  uint64_t hash = frameHash(address, data, length);
+  for (const PayloadEntry& entry : _payloads) {
+    if (entry.atMs != 0 && entry.hash == hash && nowMs - entry.atMs <= _windowMs) {
+      _duplicates++;
+      return true;
+    }
+  }
+  _payloads[_nextPayload] = {hash, nowMs ? nowMs : 1};
+  _nextPayload = (_nextPayload + 1) % PAYLOAD_HISTORY;
+  return false;
+}
+
+} // namespace gw
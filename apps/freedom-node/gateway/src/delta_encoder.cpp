@@ -0,0 +1,235 @@
+/**
+ * Delta Encoder Implementation
+ */
+
+#include "delta_encoder.h"
+#include "ota_protocol.h"
+#include <algorithm>
+#include <string.h>
+
+namespace gw {
+
+namespace {
+
+// ============= DELTA =============
+
+const size_t HASH_BYTES = 8;          // Bytes hashed per index entry
+const size_t MIN_MATCH = 16;          // Shorter exact matches are not worth a new record
+const size_t MAX_PROBE = 1 << 16;     // Longest match measured per candidate
+const int INDEX_BITS = 20;
+const size_t INDEX_WAYS = 4;
+
+uint32_t hashAt(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - INDEX_BITS));
+}
+
+// Base positions by the hash of the bytes there, a few per bucket
+class BaseIndex {
+public:
+  explicit BaseIndex(const std::vector<uint8_t>& base)
+      : _base(base), _slots((size_t)INDEX_WAYS << INDEX_BITS, 0) {
+    for (size_t i = 0; i + HASH_BYTES <= base.size(); i++) {
+      uint32_t* bucket = &_slots[(size_t)hashAt(&base[i]) * INDEX_WAYS];
+      bucket[i % INDEX_WAYS] = (uint32_t)i + 1;
+    }
+  }
+
+  // Longest exact match for target[at..]; length 0 if none reaches MIN_MATCH
+  size_t longestMatch(const std::vector<uint8_t>& target, size_t at, size_t* pos) const {
+    if (at + HASH_BYTES > target.size()) return 0;
+    const uint32_t* bucket = &_slots[(size_t)hashAt(&target[at]) * INDEX_WAYS];
+    size_t best = 0;
+    for (size_t way = 0; way < INDEX_WAYS; way++) {
+      if (bucket[way] == 0) continue;
+      size_t candidate = bucket[way] - 1;
+      size_t limit = std::min(std::min(_base.size() - candidate, target.size() - at), MAX_PROBE);
+      size_t n = 0;
+      while (n < limit && _base[candidate + n] == target[at + n]) n++;
+      if (n > best) {
+        best = n;
+        *pos = candidate;
+      }
+    }
+    return best >= MIN_MATCH ? best : 0;
+  }
+
+private:
+  const std::vector<uint8_t>& _base;
+  std::vector<uint32_t> _slots;   // Position + 1, 0 = empty
+};
+
+void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t)v);
+}
+
+/**
+ * One record for target[from, to) aligned with base[basePos..]: the
+ * prefix that scores best as byte differences (bsdiff's forward
+ * extension), the rest as literal bytes, then the seek to nextPos
+ */
+void emitRecord(std::vector<uint8_t>& out, const std::vector<uint8_t>& base,
+                const std::vector<uint8_t>& target, size_t from, size_t to, int64_t basePos,
+                int64_t nextPos) {
+  size_t span = to - from;
+  size_t diffLen = 0;
+  int64_t score = 0, bestScore = 0;
+  for (size_t i = 0; i < span && basePos + (int64_t)i < (int64_t)base.size(); i++) {
+    score += base[basePos + i] == target[from + i] ? 1 : -1;
+    if (score > bestScore) {
+      bestScore = score;
+      diffLen = i + 1;
+    }
+  }
+
+  int64_t seek = nextPos - (basePos + (int64_t)diffLen);
+  putVarint(out, diffLen);
+  putVarint(out, span - diffLen);
+  putVarint(out, ((uint64_t)seek << 1) ^ (uint64_t)(seek >> 63));
+  for (size_t i = 0; i < diffLen; i++) {
+    out.push_back((uint8_t)(target[from + i] - base[basePos + i]));
+  }
+  out.insert(out.end(), target.begin() + from + diffLen, target.begin() + to);
+}
+
+// ============= LZSS =============
+
+const int WINDOW_BITS = ota::LzssDecoder::WINDOW_BITS;
+const int LOOKAHEAD_BITS = ota::LzssDecoder::LOOKAHEAD_BITS;
+const size_t WINDOW = (size_t)1 << WINDOW_BITS;
+const size_t MAX_LENGTH = (size_t)1 << LOOKAHEAD_BITS;
+const int CHAIN_BITS = 15;
+const size_t CHAIN_DEPTH = 64;
+
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<uint8_t>& out) : _out(out) {}
+
+  void put(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      _byte = (uint8_t)((_byte << 1) | ((value >> i) & 1));
+      if (++_bits == 8) {
+        _out.push_back(_byte);
+        _byte = 0;
+        _bits = 0;
+      }
+    }
+  }
+
+  void flush() {
+    if (_bits > 0) _out.push_back((uint8_t)(_byte << (8 - _bits)));
+    _bits = 0;
+  }
+
+private:
+  std::vector<uint8_t>& _out;
+  uint8_t _byte = 0;
+  int _bits = 0;
+};
+
+} // namespace
+
+std::vector<uint8_t> encodeDelta(const std::vector<uint8_t>& base,
+                                 const std::vector<uint8_t>& target) {
+  std::vector<uint8_t> out(ota::PATCH_MAGIC, ota::PATCH_MAGIC + sizeof(ota::PATCH_MAGIC));
+  BaseIndex index(base);
+
+  size_t scan = 0, lastScan = 0;
+  int64_t lastPos = 0;   // Base position aligned with lastScan
+  while (scan < target.size()) {
+    int64_t aligned = lastPos + (int64_t)(scan - lastScan);
+    if (aligned >= 0 && aligned < (int64_t)base.size() && base[aligned] == target[scan]) {
+      scan++;
+      continue;
+    }
+
+    size_t pos = 0;
+    size_t length = index.longestMatch(target, scan, &pos);
+    if (length == 0) {
+      scan++;
+      continue;
+    }
+
+    // Stay on the current alignment unless the new match clearly beats it
+    size_t stay = 0;
+    for (size_t k = 0; k < length && aligned + (int64_t)k < (int64_t)base.size(); k++) {
+      if (aligned + (int64_t)k >= 0 && base[aligned + k] == target[scan + k]) stay++;
+    }
+    if (length <= stay + 8) {
+      scan++;
+      continue;
+    }
+
+    emitRecord(out, base, target, lastScan, scan, lastPos, (int64_t)pos);
+    lastScan = scan;
+    lastPos = (int64_t)pos;
+    scan += length;
+  }
+  emitRecord(out, base, target, lastScan, target.size(), lastPos,
+             lastPos + (int64_t)(target.size() - lastScan));
+  return out;
+}
+
+std::vector<uint8_t> compressLzss(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> out;
+  BitWriter bits(out);
+  std::vector<int64_t> head((size_t)1 << CHAIN_BITS, -1);
+  std::vector<int64_t> prev(WINDOW, -1);
+
+  auto hash3 = [&](size_t i) {
+    return ((uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2]) *
+               2654435761u >> (32 - CHAIN_BITS);
+  };
+  auto insert = [&](size_t i) {
+    if (i + 3 > data.size()) return;
+    uint32_t h = hash3(i);
+    prev[i % WINDOW] = head[h];
+    head[h] = (int64_t)i;
+  };
+
+  size_t i = 0;
+  while (i < data.size()) {
+    size_t bestLength = 0, bestDistance = 0;
+    size_t limit = std::min(MAX_LENGTH, data.size() - i);
+    if (i + 3 <= data.size()) {
+      int64_t candidate = head[hash3(i)];
+      for (size_t depth = 0; candidate >= 0 && depth < CHAIN_DEPTH; depth++) {
+        size_t distance = i - (size_t)candidate;
+        if (distance > WINDOW) break;
+        size_t n = 0;
+        while (n < limit && data[candidate + n] == data[i + n]) n++;
+        if (n > bestLength) {
+          bestLength = n;
+          bestDistance = distance;
+          if (n == limit) break;
+        }
+        int64_t next = prev[(size_t)candidate % WINDOW];
+        if (next >= candidate) break;   // Slot reused by a newer position
+        candidate = next;
+      }
+    }
+
+    // A back-reference costs 1 + 10 + 8 bits, a literal 9
+    if (bestLength >= 3) {
+      bits.put(0, 1);
+      bits.put((uint32_t)(bestDistance - 1), WINDOW_BITS);
+      bits.put((uint32_t)(bestLength - 1), LOOKAHEAD_BITS);
+      for (size_t k = 0; k < bestLength; k++) insert(i + k);
+      i += bestLength;
+    } else {
+      bits.put(1, 1);
+      bits.put(data[i], 8);
+      insert(i);
+      i++;
+    }
+  }
+  bits.flush();
+  return out;
+}
+
+} // namespace gw
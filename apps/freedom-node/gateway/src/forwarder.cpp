@@ -0,0 +1,248 @@
+/**
+ * Forwarder Implementation
+ */
+
+#include "forwarder.h"
+#include "wire_codec.h"
+#include <algorithm>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+// Value after "key": in a flat JSON object; no unescaping needed for our keys
+const char* findValue(const char* line, size_t length, const char* key, size_t* remaining) {
+  char pattern[32];
+  int n = snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+  const char* end = line + length;
+  for (const char* p = line; p + n <= end; p++) {
+    if (memcmp(p, pattern, (size_t)n) != 0) continue;
+    p += n;
+    while (p < end && (*p == ' ' || *p == ':')) p++;
+    *remaining = (size_t)(end - p);
+    return p;
+  }
+  return nullptr;
+}
+
+// HOST:PORT: a non-blocking connect that completes (or fails) on the first write
+int connectTcp(const std::string& address) {
+  size_t colon = address.rfind(':');
+  std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+  if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+  struct addrinfo hints, *found = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+  int fd = -1;
+  for (struct addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 && errno != EINPROGRESS) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(found);
+  return fd;
+}
+
+} // namespace
+
+Forwarder::Forwarder(const std::string& socketPath, size_t batchRecords, uint32_t flushMs,
+                     size_t maxPendingBytes)
+    : _socketPath(socketPath),
+      _batchRecords(batchRecords ? batchRecords : 1),
+      _flushMs(flushMs),
+      _maxPendingBytes(maxPendingBytes) {}
+
+Forwarder::~Forwarder() {
+  if (_fd >= 0) close(_fd);
+}
+
+void Forwarder::push(const char* record, size_t length, uint64_t nowMs) {
+  if (pendingBytes() + length + 1 > _maxPendingBytes) {
+    _stats.dropped++;
+    return;
+  }
+  if (_waitingRecords == 0) _oldestMs = nowMs;
+  _pending.append(record, length);
+  _pending.push_back('\n');
+  _waitingRecords++;
+  _stats.records++;
+
+  if (_waitingRecords >= _batchRecords) service(nowMs);
+}
+
+void Forwarder::service(uint64_t nowMs, bool force) {
+  if (_fd < 0 && (nowMs < _retryAtMs || !connect(nowMs))) return;
+  if (_blocked) return;
+
+  bool due = _waitingRecords >= _batchRecords ||
+             (_waitingRecords > 0 && nowMs - _oldestMs >= _flushMs);
+  if (due || (force && pendingBytes() > 0)) write(nowMs);
+}
+
+void Forwarder::onWritable(uint64_t nowMs) {
+  _blocked = false;
+  write(nowMs);
+}
+
+void Forwarder::write(uint64_t nowMs) {
+  if (_waitingRecords > 0) {
+    _waitingRecords = 0;
+    _stats.batches++;
+  }
+  while (_sent < _pending.size()) {
+    ssize_t n = send(_fd, _pending.data() + _sent, _pending.size() - _sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        _blocked = true;
+        return;
+      }
+      fprintf(stderr, "forwarder: send failed: %s\n", strerror(errno));
+      disconnect(nowMs);
+      return;
+    }
+    _sent += (size_t)n;
+    // Only now is a TCP connection known to be up
+    _backoffMs = BACKOFF_MIN_MS;
+  }
+  _pending.clear();
+  _sent = 0;
+}
+
+bool Forwarder::connect(uint64_t nowMs) {
+  int fd;
+  if (_socketPath.find('/') == std::string::npos &&
+      _socketPath.find(':') != std::string::npos) {
+    fd = connectTcp(_socketPath);
+  } else {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (_socketPath.size() >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "forwarder: socket path too long\n");
+      _retryAtMs = UINT64_MAX;
+      return false;
+    }
+    memcpy(addr.sun_path, _socketPath.c_str(), _socketPath.size());
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (fd < 0) {
+    _retryAtMs = nowMs + _backoffMs;
+    _backoffMs = _backoffMs * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : _backoffMs * 2;
+    return false;
+  }
+
+  _fd = fd;
+  _blocked = false;
+  _rx.clear();
+  _stats.connects++;
+  fprintf(stderr, "forwarder: connected to %s (%zu bytes waiting)\n", _socketPath.c_str(),
+          pendingBytes());
+  if (_connectHandler) _connectHandler();
+
+  return true;
+}
+
+void Forwarder::disconnect(uint64_t nowMs) {
+  fprintf(stderr, "forwarder: disconnected from %s\n", _socketPath.c_str());
+  close(_fd);
+  _fd = -1;
+  _blocked = false;
+  _retryAtMs = nowMs + _backoffMs;
+
+  // Records fully written are gone; one cut off mid-write is resent whole
+  size_t cut = _sent > 0 ? _pending.rfind('\n', _sent - 1) : std::string::npos;
+  _pending.erase(0, cut == std::string::npos ? 0 : cut + 1);
+  _sent = 0;
+
+  // Journal records come back from the journal; keep only the others
+  std::string kept;
+  for (size_t start = 0; start < _pending.size();) {
+    size_t end = _pending.find('\n', start) + 1;
+    size_t remaining;
+    if (!findValue(_pending.data() + start, end - start, "offset", &remaining)) {
+      kept.append(_pending, start, end - start);
+    }
+    start = end;
+  }
+  _pending.swap(kept);
+  if (!_pending.empty()) {
+    // Flush as soon as the connection is back
+    _waitingRecords = (size_t)std::count(_pending.begin(), _pending.end(), '\n');
+    _oldestMs = nowMs - _flushMs;
+  }
+}
+
+void Forwarder::onReadable(uint64_t nowMs) {
+  for (;;) {
+    ssize_t n = _rx.fill(_fd);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      disconnect(nowMs);
+      return;
+    }
+    if (n < 0) return;
+
+    const char* line;
+    size_t length;
+    while (_rx.next(&line, &length)) handleRequest(line, length);
+  }
+}
+
+void Forwarder::handleRequest(const char* line, size_t length) {
+  size_t remaining;
+  const char* type = findValue(line, length, "type", &remaining);
+  if (type && remaining >= 5 && memcmp(type, "\"ack\"", 5) == 0) {
+    const char* next = findValue(line, length, "next", &remaining);
+    if (!next || *next < '0' || *next > '9') {
+      _stats.badRequests++;
+      return;
+    }
+    _stats.acks++;
+    if (_ackHandler) _ackHandler(strtoull(next, nullptr, 10));
+    return;
+  }
+  if (!type || remaining < 10 || memcmp(type, "\"downlink\"", 10) != 0) {
+    _stats.badRequests++;
+    return;
+  }
+
+  const char* address = findValue(line, length, "address", &remaining);
+  const char* payload = findValue(line, length, "payload", &remaining);
+  if (!address || !payload || *payload != '"') {
+    _stats.badRequests++;
+    return;
+  }
+  long addr = strtol(address, nullptr, 10);
+  const char* hex = payload + 1;
+  const char* quote = (const char*)memchr(hex, '"', remaining - 1);
+
+  uint8_t bytes[wire::MAX_FRAME_BYTES];
+  size_t n = quote ? wire::hexDecode(hex, (size_t)(quote - hex), bytes, sizeof(bytes)) : 0;
+  if (addr < 0 || addr > 65535 || n == 0 || 2 * n != (size_t)(quote - hex)) {
+    _stats.badRequests++;
+    return;
+  }
+  _stats.downlinks++;
+  if (_downlinkHandler) _downlinkHandler((uint16_t)addr, bytes, n);
+}
+
+} // namespace gw
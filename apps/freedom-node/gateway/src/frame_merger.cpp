@@ -0,0 +1,296 @@
+/**
+ * Frame Merger Implementation
+ */
+
+#include "frame_merger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace gw {
+
+namespace {
+
+// Fields each gateway fills in for itself
+const char* const LOCAL_FIELDS[] = {"offset", "port", "rssi", "snr", "verified"};
+
+struct Field {
+  const char* begin;          // Opening quote of the key
+  const char* end;            // Past the value
+  const char* key;
+  size_t keyLength;
+  const char* value;
+  size_t valueLength;
+};
+
+bool isKey(const Field& field, const char* key) {
+  return field.keyLength == strlen(key) && memcmp(field.key, key, field.keyLength) == 0;
+}
+
+const char* skipSpace(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t')) p++;
+  return p;
+}
+
+// Past a JSON value: a string, an object or array (nested), or a scalar
+const char* skipValue(const char* p, const char* end) {
+  int depth = 0;
+  bool string = false;
+  for (; p < end; p++) {
+    char c = *p;
+    if (string) {
+      if (c == '\\') {
+        p++;
+      } else if (c == '"') {
+        string = false;
+        if (depth == 0) return p + 1;
+      }
+    } else if (c == '"') {
+      string = true;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0) return p;
+      if (--depth == 0) return p + 1;
+    } else if (c == ',' && depth == 0) {
+      return p;
+    }
+  }
+  return string || depth ? nullptr : p;
+}
+
+// The top-level fields of a JSON object, in order
+bool parseFields(const char* record, size_t length, std::vector<Field>* fields) {
+  const char* end = record + length;
+  const char* p = skipSpace(record, end);
+  if (p == end || *p++ != '{') return false;
+  for (;;) {
+    p = skipSpace(p, end);
+    if (p == end) return false;
+    if (*p == '}') return true;
+    if (!fields->empty()) {
+      if (*p != ',') return false;
+      p = skipSpace(p + 1, end);
+    }
+    Field field;
+    field.begin = p;
+    if (p == end || *p != '"') return false;
+    field.key = ++p;
+    while (p < end && *p != '"') p++;
+    if (p == end) return false;
+    field.keyLength = (size_t)(p - field.key);
+    p = skipSpace(p + 1, end);
+    if (p == end || *p != ':') return false;
+    field.value = skipSpace(p + 1, end);
+    p = skipValue(field.value, end);
+    if (!p || p == field.value) return false;
+    field.end = p;
+    while (p > field.value && (p[-1] == ' ' || p[-1] == '\t')) p--;
+    field.valueLength = (size_t)(p - field.value);
+    fields->push_back(field);
+  }
+}
+
+// FNV-1a, continued over several spans
+void mix(uint64_t* h, const char* data, size_t length) {
+  for (size_t i = 0; i < length; i++) *h = (*h ^ (uint8_t)data[i]) * 1099511628211ULL;
+}
+
+long number(const Field& field) {
+  return strtol(std::string(field.value, field.valueLength).c_str(), nullptr, 10);
+}
+
+} // namespace
+
+void FrameMerger::offer(uint32_t peer, const std::string& gateway, const char* record,
+                        size_t length, uint64_t nowMs) {
+  _stats.copies++;
+  std::vector<Field> fields;
+  if (!parseFields(record, length, &fields)) {
+    // Not ours to judge: the server logs what it cannot parse
+    _stats.malformed++;
+    _stats.emitted++;
+    if (_emit) _emit(record, length);
+    return;
+  }
+
+  Key key = {0, 0, 14695981039346656037ULL};
+  Copy copy = {peer, gateway, 0, 0, false, false, 0};
+  bool radio = false, alert = false;
+  std::string stripped = "{";
+  for (const Field& field : fields) {
+    bool local = false;
+    for (const char* name : LOCAL_FIELDS) local = local || isKey(field, name);
+    if (isKey(field, "address")) key.address = (uint16_t)number(field);
+    if (isKey(field, "seq")) key.seq = (uint16_t)number(field);
+    if (isKey(field, "alerts")) alert = true;
+    if (isKey(field, "rssi")) {
+      copy.rssi = (int)number(field);
+      radio = true;
+    }
+    if (isKey(field, "snr")) copy.snr = (int)number(field);
+    if (isKey(field, "verified")) copy.verified = field.valueLength == 4;   // true
+    if (isKey(field, "offset")) {
+      copy.hasOffset = true;
+      copy.offset = strtoull(std::string(field.value, field.valueLength).c_str(), nullptr, 10);
+      continue;
+    }
+    if (!local) {
+      mix(&key.hash, field.key, field.keyLength);
+      mix(&key.hash, ":", 1);
+      mix(&key.hash, field.value, field.valueLength);
+    }
+    if (stripped.size() > 1) stripped += ',';
+    stripped.append(field.begin, (size_t)(field.end - field.begin));
+  }
+  stripped += '}';
+  if (copy.hasOffset) {
+    Offsets& offsets = _offsets[peer];
+    offsets.open.insert(copy.offset);
+    if (copy.offset >= offsets.next) offsets.next = copy.offset + 1;
+  }
+
+  auto done = _emitted.find(key);
+  if (done != _emitted.end()) {
+    _stats.late++;
+    // Not done before the record it duplicates
+    const Emitted& emitted = done->second;
+    if (copy.hasOffset && emitted.held && emitted.offset >= _heldBegin) {
+      _held[(size_t)(emitted.offset - _heldBegin)].copies.push_back(copy);
+    } else {
+      finish(copy);
+    }
+    return;
+  }
+
+  Group& group = _groups[key];
+  if (group.copies.empty()) {
+    group.radio = radio;
+    group.alert = alert;
+    group.record.swap(stripped);
+    _due.push_back(Due{nowMs + _windowMs, key});
+  } else {
+    _stats.merged++;
+    const Copy& best = group.copies[group.best];
+    bool better = copy.verified != best.verified ? copy.verified
+                  : copy.snr != best.snr         ? copy.snr > best.snr
+                                                 : copy.rssi > best.rssi;
+    if (better) {
+      group.best = group.copies.size();
+      group.record.swap(stripped);
+    }
+  }
+  group.copies.push_back(copy);
+
+  // An alert is flushed at once by the gateway; do not hold it here either
+  if (alert && group.copies.size() == 1) {
+    emit(key, group, nowMs);
+    _groups.erase(key);
+  }
+}
+
+void FrameMerger::expire(uint64_t nowMs) {
+  while (!_due.empty() && _due.front().atMs <= nowMs) {
+    auto it = _groups.find(_due.front().key);
+    if (it != _groups.end()) {
+      emit(it->first, it->second, nowMs);
+      _groups.erase(it);
+    }
+    _due.pop_front();
+  }
+  while (!_forget.empty() && _forget.front().atMs <= nowMs) {
+    auto it = _emitted.find(_forget.front().key);
+    if (it != _emitted.end() && it->second.forgetAtMs == _forget.front().atMs) {
+      _emitted.erase(it);
+    }
+    _forget.pop_front();
+  }
+}
+
+void FrameMerger::flush() {
+  for (auto& entry : _groups) emit(entry.first, entry.second, 0);
+  _groups.clear();
+  _due.clear();
+}
+
+bool FrameMerger::route(uint16_t address, uint32_t* peer) const {
+  auto it = _routes.find(address);
+  if (it == _routes.end()) return false;
+  *peer = it->second;
+  return true;
+}
+
+const std::string* FrameMerger::held(uint64_t offset) const {
+  if (offset < _heldBegin || offset >= heldEnd()) return nullptr;
+  return &_held[(size_t)(offset - _heldBegin)].record;
+}
+
+void FrameMerger::acked(uint64_t next) {
+  while (!_held.empty() && _heldBegin < next) {
+    for (const Copy& copy : _held.front().copies) finish(copy);
+    _held.pop_front();
+    _heldBegin++;
+  }
+}
+
+bool FrameMerger::ackNext(uint32_t peer, uint64_t* next) const {
+  auto it = _offsets.find(peer);
+  if (it == _offsets.end()) return false;
+  *next = it->second.open.empty() ? it->second.next : *it->second.open.begin();
+  return true;
+}
+
+void FrameMerger::removePeer(uint32_t peer) {
+  _offsets.erase(peer);
+  for (auto it = _routes.begin(); it != _routes.end();) {
+    it = it->second == peer ? _routes.erase(it) : std::next(it);
+  }
+}
+
+void FrameMerger::emit(const Key& key, Group& group, uint64_t nowMs) {
+  std::string& record = group.record;
+  if (group.radio) {
+    // "gateway" heard it best; "receptions" is everyone, best first
+    const Copy& best = group.copies[group.best];
+    char item[160];
+    record.pop_back();
+    record += ",\"gateway\":\"" + best.gateway + "\",\"receptions\":[";
+    for (size_t i = 0; i < group.copies.size(); i++) {
+      const Copy& copy = group.copies[i == 0 ? group.best : i <= group.best ? i - 1 : i];
+      snprintf(item, sizeof(item), "%s{\"gateway\":\"%s\",\"rssi\":%d,\"snr\":%d}", i ? "," : "",
+               copy.gateway.c_str(), copy.rssi, copy.snr);
+      record += item;
+    }
+    record += "]}";
+    if (key.address != 0 && !group.alert) _routes[key.address] = best.peer;
+  }
+  _stats.emitted++;
+
+  bool journaled = false;
+  for (const Copy& copy : group.copies) journaled = journaled || copy.hasOffset;
+  Emitted emitted = {nowMs + _rememberMs, journaled, heldEnd()};
+  if (journaled) {
+    // The merger's own offset, where a gateway puts its journal's
+    char field[32];
+    snprintf(field, sizeof(field), "\"offset\":%llu%s", (unsigned long long)emitted.offset,
+             record.size() > 2 ? "," : "");
+    record.insert(1, field);
+    _held.emplace_back();
+    _held.back().record.swap(record);
+    _held.back().copies.swap(group.copies);
+  } else {
+    if (_emit) _emit(record.data(), record.size());
+    for (const Copy& copy : group.copies) finish(copy);
+  }
+
+  _emitted[key] = emitted;
+  _forget.push_back(Due{emitted.forgetAtMs, key});
+}
+
+void FrameMerger::finish(const Copy& copy) {
+  if (!copy.hasOffset) return;
+  auto it = _offsets.find(copy.peer);
+  if (it != _offsets.end()) it->second.open.erase(copy.offset);
+}
+
+} // namespace gw
@@ -0,0 +1,1057 @@
+/**
+ * Gateway Implementation
+ */
+
+#include "gateway.h"
+#include "alert_rules.h"
+#include "edge_analytics.h"
+#include "fl_protocol.h"
+#include "history_protocol.h"
+#include "probe_protocol.h"
+#include "sensor_schema.h"
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+// epoll tags; port events carry the port index
+const uint64_t TAG_SIGNAL = UINT64_MAX;
+const uint64_t TAG_TIMER = UINT64_MAX - 1;
+const uint64_t TAG_SOCKET = UINT64_MAX - 2;
+const uint64_t TAG_VERIFY = UINT64_MAX - 3;
+
+const size_t RECORD_MAX = 1536;
+const char* const CONSUMER = "proof-server";
+
+uint64_t monotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+uint64_t wallClockMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+// JSON has no NaN: sensors that failed to read are reported as null
+int formatFloat(char* out, size_t size, float value) {
+  if (!isfinite(value)) return snprintf(out, size, "null");
+  return snprintf(out, size, "%.9g", value);
+}
+
+int8_t clampInt8(int v) {
+  return (int8_t)(v < -128 ? -128 : v > 127 ? 127 : v);
+}
+
+} // namespace
+
+Gateway::Gateway(const GatewayOptions& options)
+    : _options(options),
+      _forwarder(options.socketPath, options.batchRecords, options.flushMs,
+                 options.maxPendingBytes),
+      _pacer(options.registrationsPerMin, options.registrationBurst),
+      _downlinks(options.radio.spreadingFactor, options.radio.bandwidthKHz,
+                 options.downlinkDutyPermille) {}
+
+Gateway::~Gateway() {
+  _verifier.reset();
+  for (VerifyBatch* batch : _done) delete batch;
+  if (_verifyEventFd >= 0) close(_verifyEventFd);
+  if (_epoll >= 0) close(_epoll);
+  if (_signalFd >= 0) close(_signalFd);
+  if (_timerFd >= 0) close(_timerFd);
+}
+
+bool Gateway::begin() {
+  _nowMs = monotonicMs();
+
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+
+  // Signals arrive as readable events instead of interrupting the loop
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGHUP);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  _signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  // One periodic tick drives flushes, command timeouts and reconnects
+  _timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  uint32_t tickMs = _options.flushMs < 100 ? (_options.flushMs ? _options.flushMs : 1) : 100;
+  struct itimerspec tick;
+  tick.it_interval.tv_sec = tickMs / 1000;
+  tick.it_interval.tv_nsec = (long)(tickMs % 1000) * 1000000L;
+  tick.it_value = tick.it_interval;
+  if (_signalFd < 0 || _timerFd < 0 || timerfd_settime(_timerFd, 0, &tick, nullptr) != 0) {
+    perror("signalfd/timerfd");
+    return false;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = TAG_SIGNAL;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, _signalFd, &ev);
+  ev.data.u64 = TAG_TIMER;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, _timerFd, &ev);
+
+  if (!_options.keysPath.empty()) {
+    _keys.reset(new KeyCache());
+    if (!_keys->load(_options.keysPath.c_str())) return false;
+    _verifier.reset(new BatchVerifier(*_keys, _options.verifyThreads));
+    _verifyEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.data.u64 = TAG_VERIFY;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _verifyEventFd, &ev);
+    fprintf(stderr, "gateway: %zu device keys, %zu verify threads\n", _keys->size(),
+            _verifier->threads());
+  }
+
+  if (!_options.journalDir.empty()) {
+    _journal.reset(new Journal());
+    if (!_journal->open(_options.journalDir, _options.journalSegmentRecords,
+                        _options.journalMaxSegments)) {
+      return false;
+    }
+    _sendOffset = _journal->cursor(CONSUMER);
+    fprintf(stderr, "gateway: journal %s, offsets %llu-%llu, proof server at %llu\n",
+            _options.journalDir.c_str(), (unsigned long long)_journal->begin(),
+            (unsigned long long)_journal->end(), (unsigned long long)_sendOffset);
+    _forwarder.setAckHandler([this](uint64_t next) { _journal->setCursor(CONSUMER, next); });
+    // Whatever was in flight on the old connection may be lost: resend it
+    _forwarder.setConnectHandler([this] { _sendOffset = _journal->cursor(CONSUMER); });
+  }
+
+  if (!_options.otaCampaignPath.empty()) {
+    _ota.reset(new OtaCampaign());
+    if (!_ota->load(_options.otaCampaignPath.c_str())) return false;
+    fprintf(stderr, "gateway: OTA campaign %04x, %u byte image in %u chunks\n",
+            _ota->offer().session, _ota->offer().targetLength, _ota->offer().chunkCount);
+  }
+
+  if (!_options.deviceConfigPath.empty()) {
+    _config.reset(new ConfigRollout());
+    if (!_config->load(_options.deviceConfigPath.c_str())) return false;
+    fprintf(stderr, "gateway: device settings v%u (%zu byte message)\n", _config->version(),
+            _config->messageLength());
+  }
+
+  if (_options.timeBeaconS > 0) _time.reset(new TimeBeacon(_options.timeBeaconS));
+
+  if (!_options.commitmentTreePath.empty()) {
+    _tree.reset(new CommitmentTree());
+    if (!_tree->open(_options.commitmentTreePath)) return false;
+    fprintf(stderr, "gateway: commitment tree %s, %u leaves at epoch %u (%u appended since)\n",
+            _options.commitmentTreePath.c_str(), _tree->leaves(), _tree->epoch(),
+            _tree->size() - _tree->leaves());
+  }
+
+  if (!_options.nullifierDir.empty()) {
+    _nullifiers.reset(new NullifierSet());
+    if (!_nullifiers->open(_options.nullifierDir, _options.nullifierEpochs,
+                           _options.nullifierPartition)) {
+      return false;
+    }
+    NullifierSetStats nullifiers = _nullifiers->stats();
+    fprintf(stderr, "gateway: nullifiers %s, %llu in %zu tables and %zu live at epoch %u\n",
+            _options.nullifierDir.c_str(), (unsigned long long)nullifiers.tableKeys,
+            nullifiers.tables, nullifiers.liveKeys, _nullifiers->epoch());
+  }
+
+  size_t opened = 0;
+  for (size_t i = 0; i < _options.ports.size(); i++) {
+    PortState state;
+    state.port.reset(new RylrPort(_options.ports[i], i));
+    state.port->setFrameHandler(
+        [this](RylrPort& port, const wire::RcvFrame& frame) { onFrame(port, frame); });
+    state.reassembler.reset(new wire::Reassembler());
+    _ports.push_back(std::move(state));
+    if (openPort(i)) opened++;
+  }
+  if (opened == 0) {
+    fprintf(stderr, "gateway: no module port could be opened\n");
+    return false;
+  }
+
+  _forwarder.setDownlinkHandler(
+      [this](uint16_t address, const uint8_t* payload, size_t length) {
+        onDownlink(address, payload, length);
+      });
+  if (_config) broadcastConfig();
+  if (_time) broadcastTime();
+  _forwarder.service(_nowMs);
+  updateSocketWatch();
+  _nextStatsMs = _nowMs + (uint64_t)_options.statsIntervalS * 1000ULL;
+  return true;
+}
+
+int Gateway::run() {
+  struct epoll_event events[32];
+  for (;;) {
+    int n = epoll_wait(_epoll, events, 32, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      return 1;
+    }
+    _nowMs = monotonicMs();
+
+    for (int i = 0; i < n; i++) {
+      uint64_t tag = events[i].data.u64;
+      if (tag == TAG_SIGNAL) {
+        struct signalfd_siginfo info;
+        if (read(_signalFd, &info, sizeof(info)) != (ssize_t)sizeof(info)) continue;
+        if (info.ssi_signo == SIGHUP) {
+          reloadKeys();
+          reloadConfig();
+        } else {
+          fprintf(stderr, "gateway: signal %u, stopping\n", info.ssi_signo);
+          finishVerification();
+          pumpJournal();
+          _forwarder.service(_nowMs, true);
+          printStats();
+          return 0;
+        }
+      } else if (tag == TAG_VERIFY) {
+        onVerified();
+      } else if (tag == TAG_TIMER) {
+        uint64_t expirations;
+        if (read(_timerFd, &expirations, sizeof(expirations)) > 0) onTick();
+      } else if (tag == TAG_SOCKET) {
+        if (events[i].events & EPOLLOUT) _forwarder.onWritable(_nowMs);
+        if (_forwarder.isConnected() && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+          _forwarder.onReadable(_nowMs);
+        }
+        // An ack or a drained socket makes room for more journal records
+        pumpJournal();
+      } else if (tag < _ports.size()) {
+        PortState& state = _ports[tag];
+        if (state.port->isOpen() && !state.port->onReadable(_nowMs)) {
+          fprintf(stderr, "%s: device gone\n", state.port->path().c_str());
+          closePort(tag);
+        }
+      }
+    }
+    updateSocketWatch();
+  }
+}
+
+void Gateway::onFrame(RylrPort& port, const wire::RcvFrame& frame) {
+  uint8_t bytes[wire::MAX_FRAME_BYTES];
+  size_t length = wire::hexDecode(frame.data, frame.dataLen, bytes, sizeof(bytes));
+  if (length == 0 || 2 * length != frame.dataLen) {
+    _stats.badFrames++;
+    return;
+  }
+  // Every frame moves the device's receive window, fragments included
+  _downlinks.onUplink(frame.address, false, _nowMs);
+
+  if (bytes[0] != wire::MSG_FRAGMENT) {
+    onMessage(port, frame, bytes, length, false, 0);
+    return;
+  }
+
+  uint8_t message[wire::MESSAGE_MAX];
+  uint16_t seq;
+  wire::Reassembler& reassembler = *_ports[port.index()].reassembler;
+  size_t messageLen = reassembler.add(frame.address, bytes, length, (uint32_t)_nowMs,
+                                      message, &seq);
+  if (messageLen > 0) onMessage(port, frame, message, messageLen, true, seq);
+}
+
+void Gateway::onMessage(RylrPort& port, const wire::RcvFrame& frame, const uint8_t* message,
+                        size_t length, bool sequenced, uint16_t seq) {
+  bool reading = wire::isReading(message, length);
+  uint8_t alerts = reading ? alert::findAlerts(message, length) : 0;
+  // Alerts may use another spreading factor than the device listens on
+  if (!alerts) _lastHeard[frame.address] = port.index();
+
+  bool duplicate = sequenced ? _dedup.seenSequence(frame.address, seq)
+                             : _dedup.seenPayload(frame.address, message, length, _nowMs);
+  if (duplicate) return;
+  if (reading && !alerts) _downlinks.onUplink(frame.address, true, _nowMs);
+
+  uint8_t type = message[0];
+  OtaCampaign::Send sendOta = [this](uint16_t address, const uint8_t* frame, size_t frameLen) {
+    onDownlink(address, frame, frameLen);
+  };
+  if (_ota && type == wire::MSG_OTA_STATUS && length == ota::STATUS_SIZE) {
+    _ota->onStatus(frame.address, message, length, _nowMs, sendOta);
+    return;
+  }
+  if (_ota) _ota->onHeard(frame.address, _nowMs, sendOta);
+
+  if (type == wire::MSG_ECHO_REQUEST && length >= 2 && !reading) {
+    // Answer at once with what this port measured; the server is not involved
+    uint8_t reply[4] = {wire::MSG_ECHO_REPLY, message[1], (uint8_t)clampInt8(frame.rssi),
+                        (uint8_t)clampInt8(frame.snr)};
+    _stats.echoes++;
+    port.send(frame.address, reply, sizeof(reply), _nowMs);
+    _downlinks.onSent(sizeof(reply), _nowMs);
+  } else if (type == wire::MSG_REGISTRATION &&
+             (length == wire::REGISTRATION_SIZE || length == 33)) {
+    // Older firmware sends the commitment unsigned; over LoRa neither is checked
+    _stats.registrations++;
+    uint32_t retryS = _pacer.onRegistration(frame.address, _nowMs);
+    if (retryS > 0) {
+      // Over the admission rate: the device comes back in its slot
+      uint8_t reply[reg::RETRY_SIZE];
+      _stats.registrationsDeferred++;
+      port.send(frame.address, reply, reg::encodeRetry(retryS, reply), _nowMs);
+      _downlinks.onSent(reg::RETRY_SIZE, _nowMs);
+    } else {
+      forwardRegistration(port, frame, message);
+    }
+  } else if (type == wire::MSG_HISTORY && !reading) {
+    forwardHistory(port, frame, message, length);
+  } else if (type == wire::MSG_FL_UPDATE && !reading) {
+    forwardFlUpdate(port, frame, message, length);
+  } else if (reading) {
+    _stats.readings++;
+    if (_config) {
+      _config->onReading(frame.address, message, length, _nowMs,
+                         [this](uint16_t address, const uint8_t* data, size_t dataLen) {
+                           onDownlink(address, data, dataLen);
+                         });
+    }
+    if (alerts) {
+      char names[24];
+      alert::formatNames(alerts, names, sizeof(names));
+      fprintf(stderr, "alert: device %u %s (port %zu, rssi %d)\n", frame.address, names,
+              port.index(), frame.rssi);
+      _stats.alerts++;
+    }
+    tsync::Report timeReport;
+    bool timeSynced = _time ? _time->onReading(frame.address, message, length, _nowMs,
+                                               [this](uint16_t address) { sendTime(address); })
+                            : tsync::findReport(message, length, &timeReport);
+    Reading reading;
+    reading.port = port.index();
+    reading.address = frame.address;
+    reading.rssi = frame.rssi;
+    reading.snr = frame.snr;
+    reading.seq = seq;
+    reading.alerts = alerts;
+    reading.timeSynced = timeSynced;
+    reading.hasAnalytics = analytics::findReport(message, length, &reading.analyticsReport);
+    if (reading.hasAnalytics && reading.analyticsReport.events) {
+      char names[16];
+      analytics::formatEvents(reading.analyticsReport.events, names, sizeof(names));
+      fprintf(stderr, "event: device %u %s (port %zu, rssi %d)\n", frame.address, names,
+              port.index(), frame.rssi);
+    }
+    // A sensor hub's probes item stays with the packet: the signature covers it
+    probe::Reading probes;
+    size_t packetLen = wire::DATA_PACKET_SIZE;
+    if (probe::findReading(message, length, &probes)) {
+      packetLen += wire::TRAILER_ITEM_HEADER_SIZE + probes.count * probe::CHANNEL_SIZE;
+    }
+    memcpy(reading.packet, message, packetLen);
+    memset(reading.packet + packetLen, 0, sizeof(reading.packet) - packetLen);
+    // Channels beyond the DataPacket, as packed; more than this gateway knows is dropped
+    const uint8_t* extra;
+    size_t extraLen;
+    reading.extraLength = 0;
+    if (wire::findTrailerItem(message, length, wire::TRAILER_CHANNELS, &extra, &extraLen)) {
+      reading.extraLength = (uint8_t)std::min(extraLen, schema::Extra::SIZE);
+      memcpy(reading.extra, extra, reading.extraLength);
+    }
+    if (!_verifier) {
+      forwardReading(reading, nullptr);
+      return;
+    }
+    if (!_filling) _filling.reset(new VerifyBatch());
+    _filling->readings.push_back(reading);
+    // An alert does not wait for the batch to fill
+    if (alerts || _filling->readings.size() >= _options.verifyBatch) submitVerification();
+  } else {
+    _stats.unknown++;
+  }
+}
+
+void Gateway::forwardRegistration(const RylrPort& port, const wire::RcvFrame& frame,
+                                  const uint8_t* message) {
+  char commitment[65];
+  wire::hexEncode(message + 1, 32, commitment);
+
+  char record[RECORD_MAX];
+  int n = snprintf(record, sizeof(record),
+                   "{\"type\":\"registration\",\"address\":%u,\"port\":%zu,\"rssi\":%d,"
+                   "\"snr\":%d,\"commitment\":\"%s\"}",
+                   frame.address, port.index(), frame.rssi, frame.snr, commitment);
+  _forwarder.push(record, (size_t)n, _nowMs);
+
+  if (_tree && !_tree->append(message + 1)) _stats.treeFailures++;
+}
+
+void Gateway::forwardFlUpdate(const RylrPort& port, const wire::RcvFrame& frame,
+                              const uint8_t* message, size_t length) {
+  fl::Update update;
+  if (!fl::parseUpdate(message, length, &update)) {
+    _stats.unknown++;
+    return;
+  }
+  _stats.flUpdates++;
+
+  // Deltas as [parameter, change] pairs, already scaled; a full frame of
+  // them does not fit the usual record
+  char record[2 * RECORD_MAX];
+  size_t n = (size_t)snprintf(record, sizeof(record),
+                              "{\"type\":\"fl_update\",\"address\":%u,\"port\":%zu,\"round\":%u,"
+                              "\"samples\":%u,\"rmseBefore\":%.2f,\"rmseAfter\":%.2f,"
+                              "\"deltas\":[",
+                              frame.address, port.index(), update.round, update.samples,
+                              update.rmseBefore / 100.0, update.rmseAfter / 100.0);
+  for (size_t i = 0; i < update.count && n < sizeof(record); i++) {
+    n += (size_t)snprintf(record + n, sizeof(record) - n, "%s[%u,%.6g]", i ? "," : "",
+                          update.deltas[i].index,
+                          fl::dequantize(update.deltas[i].value, update.shift));
+  }
+  if (n < sizeof(record)) n += (size_t)snprintf(record + n, sizeof(record) - n, "]}");
+  if (n >= sizeof(record)) return;
+  _forwarder.push(record, n, _nowMs);
+}
+
+void Gateway::forwardHistory(const RylrPort& port, const wire::RcvFrame& frame,
+                             const uint8_t* message, size_t length) {
+  hist::ResponseHeader header;
+  if (!hist::parseResponse(message, length, &header)) {
+    _stats.unknown++;
+    return;
+  }
+  _stats.history++;
+
+  // Hundredths as decimals, null where the channel was not read
+  auto value = [](int16_t v, char* out, size_t size) {
+    if (v == hist::MISSING) {
+      snprintf(out, size, "null");
+    } else {
+      snprintf(out, size, "%.2f", v / 100.0);
+    }
+    return out;
+  };
+  static const char* const CHANNELS[hist::CHANNELS] = {"temperature", "humidity",
+                                                       "soilMoisture"};
+
+  // Fourteen raw samples or five summaries do not fit the usual record
+  char record[2 * RECORD_MAX];
+  size_t n = (size_t)snprintf(record, sizeof(record),
+                              "{\"type\":\"history\",\"address\":%u,\"port\":%zu,\"request\":%u,"
+                              "\"tier\":\"%s\",\"index\":%u,\"last\":%s,\"truncated\":%s,"
+                              "\"records\":[",
+                              frame.address, port.index(), header.id,
+                              hist::tierName(header.tier), header.index,
+                              header.flags & hist::FLAG_LAST ? "true" : "false",
+                              header.flags & hist::FLAG_TRUNCATED ? "true" : "false");
+  char a[16], b[16], c[16];
+  for (size_t i = 0; i < header.records && n < sizeof(record); i++) {
+    n += (size_t)snprintf(record + n, sizeof(record) - n, "%s{", i ? "," : "");
+    if (header.tier == hist::Tier::Raw) {
+      hist::Sample sample = hist::rawRecord(message, header, i);
+      n += (size_t)snprintf(record + n, sizeof(record) - n, "\"time\":%u", sample.time);
+      for (size_t ch = 0; ch < hist::CHANNELS && n < sizeof(record); ch++) {
+        n += (size_t)snprintf(record + n, sizeof(record) - n, ",\"%s\":%s", CHANNELS[ch],
+                              value(sample.value[ch], a, sizeof(a)));
+      }
+    } else {
+      hist::Summary summary = hist::summaryRecord(message, header, i);
+      n += (size_t)snprintf(record + n, sizeof(record) - n, "\"start\":%u,\"count\":%u",
+                            summary.start, summary.count);
+      for (size_t ch = 0; ch < hist::CHANNELS && n < sizeof(record); ch++) {
+        n += (size_t)snprintf(record + n, sizeof(record) - n, ",\"%s\":[%s,%s,%s]",
+                              CHANNELS[ch], value(summary.min[ch], a, sizeof(a)),
+                              value(summary.mean[ch], b, sizeof(b)),
+                              value(summary.max[ch], c, sizeof(c)));
+      }
+    }
+    if (n < sizeof(record)) n += (size_t)snprintf(record + n, sizeof(record) - n, "}");
+  }
+  if (n < sizeof(record)) n += (size_t)snprintf(record + n, sizeof(record) - n, "]}");
+  if (n >= sizeof(record)) return;
+  _forwarder.push(record, n, _nowMs);
+}
+
+void Gateway::forwardReading(const Reading& reading, const char* verified) {
+  // Only a trusted reading is recorded, and only once the journal holds
+  // it: one the journal could not take may come again
+  const uint8_t* key = _nullifiers ? reading.packet + NullifierSet::KEY_OFFSET : nullptr;
+  bool trusted = !verified || strcmp(verified, "true") == 0;
+  if (key && _nullifiers->contains(key)) {
+    _stats.replays++;
+    return;
+  }
+
+  if (_journal) {
+    JournalRecord record;
+    record.receivedMs = wallClockMs();
+    record.address = reading.address;
+    record.seq = reading.seq;
+    record.rssi = (int16_t)reading.rssi;
+    record.snr = clampInt8(reading.snr);
+    record.port = (uint8_t)reading.port;
+    record.flags = !verified ? 0
+                   : strcmp(verified, "true") == 0 ? (JOURNAL_CHECKED | JOURNAL_VERIFIED)
+                                                   : JOURNAL_CHECKED;
+    record.flags |= (uint8_t)(reading.alerts << JOURNAL_ALERT_SHIFT);
+    if (reading.timeSynced) record.flags |= JOURNAL_TIME_SYNCED;
+    if (reading.hasAnalytics) {
+      record.flags |= JOURNAL_ANALYTICS;
+      analytics::encodeReport(reading.analyticsReport, record.analytics);
+    }
+    memcpy(record.packet, reading.packet, wire::DATA_PACKET_SIZE);
+    if (reading.packet[wire::DATA_PACKET_SIZE] == wire::TRAILER_PROBES) {
+      record.flags |= JOURNAL_PROBES;
+      memcpy(record.probes, reading.packet + wire::DATA_PACKET_SIZE, probe::ITEM_MAX);
+    }
+    record.extraLength = reading.extraLength;
+    memcpy(record.extra, reading.extra, reading.extraLength);
+    if (!_journal->append(record)) {
+      _stats.journalFailures++;
+      return;
+    }
+    if (key && trusted) _nullifiers->add(key);
+    // An alert starts its commit now rather than at the next tick; once it
+    // is durable pumpJournal() flushes it without waiting for a batch
+    if (reading.alerts) _journal->commit();
+    return;
+  }
+
+  if (key && trusted) _nullifiers->add(key);
+  char record[RECORD_MAX];
+  size_t n = formatReading(reading, verified, nullptr, record, sizeof(record));
+  _forwarder.push(record, n, _nowMs);
+  if (reading.alerts) _forwarder.service(_nowMs, true);
+}
+
+size_t Gateway::formatReading(const Reading& reading, const char* verified,
+                              const uint64_t* offset, char* out, size_t size) {
+  DataPacket packet;
+  wire::parseDataPacket(reading.packet, wire::DATA_PACKET_SIZE, &packet);
+
+  char commitment[65], nullifier[65], signature[129];
+  char temperature[24], humidity[24], soil[24];
+  wire::hexEncode(packet.commitment, 32, commitment);
+  wire::hexEncode(packet.nullifier, 32, nullifier);
+  wire::hexEncode(packet.signature, 64, signature);
+  formatFloat(temperature, sizeof(temperature), packet.temperature);
+  formatFloat(humidity, sizeof(humidity), packet.humidity);
+  formatFloat(soil, sizeof(soil), packet.soilMoisture);
+
+  char offsetField[32] = "";
+  if (offset) snprintf(offsetField, sizeof(offsetField), "\"offset\":%llu,",
+                       (unsigned long long)*offset);
+  char alertsField[40] = "";
+  if (reading.alerts) {
+    char names[24];
+    alert::formatNames(reading.alerts, names, sizeof(names));
+    snprintf(alertsField, sizeof(alertsField), ",\"alerts\":\"%s\"", names);
+  }
+  char analyticsField[160] = "";
+  if (reading.hasAnalytics) {
+    const analytics::Report& report = reading.analyticsReport;
+    char vpd[24] = "null", dewPoint[24] = "null", events[40] = "";
+    if (report.vpdPa != analytics::VPD_MISSING) {
+      snprintf(vpd, sizeof(vpd), "%.3f", report.vpdPa / 1000.0);
+    }
+    if (report.dewPointCenti != analytics::DEW_POINT_MISSING) {
+      snprintf(dewPoint, sizeof(dewPoint), "%.2f", report.dewPointCenti / 100.0);
+    }
+    if (report.events) {
+      char names[16];
+      analytics::formatEvents(report.events, names, sizeof(names));
+      snprintf(events, sizeof(events), ",\"events\":\"%s\"", names);
+    }
+    snprintf(analyticsField, sizeof(analyticsField),
+             ",\"analytics\":{\"gdd\":%.1f,\"vpd\":%s,\"dewPoint\":%s,\"anomaly\":%.1f%s}",
+             report.gddDeci / 10.0, vpd, dewPoint, report.anomalyDeci / 10.0, events);
+  }
+  // "probes":[[kind, index, value], ...]
+  char probesField[640] = "";
+  probe::Reading probes;
+  if (probe::findReading(reading.packet, probe::PACKET_MAX, &probes)) {
+    size_t used = (size_t)snprintf(probesField, sizeof(probesField), ",\"probes\":[");
+    for (size_t i = 0; i < probes.count && used < sizeof(probesField); i++) {
+      const probe::Channel& c = probes.channels[i];
+      char value[16] = "null";
+      if (!isnan(c.value)) snprintf(value, sizeof(value), "%.2f", c.value);
+      used += (size_t)snprintf(probesField + used, sizeof(probesField) - used, "%s[\"%s\",%u,%s]",
+                               i ? "," : "", probe::kindName(c.kind), c.index, value);
+    }
+    if (used < sizeof(probesField)) snprintf(probesField + used, sizeof(probesField) - used, "]");
+  }
+  // "channels":{name: value, ...} for every channel of the schema the item reaches
+  char extraField[160] = "";
+  if (reading.extraLength > 0) {
+    float values[schema::Extra::COUNT];
+    schema::Extra::decode(reading.extra, reading.extraLength, values);
+    size_t used = (size_t)snprintf(extraField, sizeof(extraField), ",\"channels\":{");
+    for (size_t i = 0; i < schema::Extra::COUNT && used < sizeof(extraField); i++) {
+      char value[24] = "null";
+      if (!isnan(values[i])) {
+        snprintf(value, sizeof(value), "%.*f", schema::decimals(schema::EXTRA_CHANNELS[i]),
+                 values[i]);
+      }
+      used += (size_t)snprintf(extraField + used, sizeof(extraField) - used, "%s\"%s\":%s",
+                               i ? "," : "", schema::EXTRA_CHANNELS[i].name, value);
+    }
+    if (used < sizeof(extraField)) snprintf(extraField + used, sizeof(extraField) - used, "}");
+  }
+
+  int n = snprintf(out, size,
+                   "{\"type\":\"reading\",%s\"address\":%u,\"seq\":%u,\"port\":%zu,\"rssi\":%d,"
+                   "\"snr\":%d,\"commitment\":\"%s\",\"temperature\":%s,\"humidity\":%s,"
+                   "\"soilMoisture\":%s,\"timestamp\":%u,\"nullifier\":\"%s\","
+                   "\"signature\":\"%s\"%s%s%s%s%s%s%s}",
+                   offsetField, reading.address, reading.seq, reading.port, reading.rssi,
+                   reading.snr, commitment, temperature, humidity, soil, packet.timestamp,
+                   nullifier, signature, verified ? ",\"verified\":" : "",
+                   verified ? verified : "", reading.timeSynced ? ",\"timeSynced\":true" : "",
+                   alertsField, analyticsField, probesField, extraField);
+  return (size_t)n;
+}
+
+void Gateway::pumpJournal() {
+  if (!_journal || !_forwarder.isConnected()) return;
+
+  // Durable records only, a window past the ack, and no faster than the socket drains
+  uint64_t limit = std::min(_journal->durableEnd(),
+                            _journal->cursor(CONSUMER) + _options.forwardWindow);
+  if (_sendOffset < _journal->begin()) _sendOffset = _journal->begin();
+  bool alerts = false;
+  while (_sendOffset < limit && _forwarder.pendingBytes() < _options.maxPendingBytes / 2) {
+    JournalRecord stored;
+    if (_journal->read(_sendOffset, &stored)) {
+      Reading reading;
+      reading.port = stored.port;
+      reading.address = stored.address;
+      reading.rssi = stored.rssi;
+      reading.snr = stored.snr;
+      reading.seq = stored.seq;
+      reading.alerts = (uint8_t)(stored.flags >> JOURNAL_ALERT_SHIFT) & alert::ALL;
+      reading.timeSynced = (stored.flags & JOURNAL_TIME_SYNCED) != 0;
+      reading.hasAnalytics = (stored.flags & JOURNAL_ANALYTICS) != 0;
+      if (reading.hasAnalytics) reading.analyticsReport = analytics::decodeReport(stored.analytics);
+      memcpy(reading.packet, stored.packet, wire::DATA_PACKET_SIZE);
+      memcpy(reading.packet + wire::DATA_PACKET_SIZE, stored.probes, probe::ITEM_MAX);
+      reading.extraLength = stored.extraLength;
+      memcpy(reading.extra, stored.extra, stored.extraLength);
+      const char* verified = !(stored.flags & JOURNAL_CHECKED) ? nullptr
+                             : (stored.flags & JOURNAL_VERIFIED) ? "true" : "false";
+
+      char record[RECORD_MAX];
+      size_t n = formatReading(reading, verified, &_sendOffset, record, sizeof(record));
+      _forwarder.push(record, n, _nowMs);
+      if (reading.alerts) alerts = true;
+    } else {
+      _stats.journalFailures++;
+    }
+    _sendOffset++;
+  }
+  if (alerts) _forwarder.service(_nowMs, true);
+}
+
+void Gateway::submitVerification() {
+  if (!_filling || _filling->readings.empty()) return;
+
+  VerifyBatch* batch = _filling.release();
+  size_t count = batch->readings.size();
+  batch->packets.resize(count);
+  batch->results.resize(count);
+  for (size_t i = 0; i < count; i++) batch->packets[i] = batch->readings[i].packet;
+
+  _verifyInFlight++;
+  _verifier->verifyAsync(batch->packets.data(), count, batch->results.data(), [this, batch] {
+    {
+      std::lock_guard<std::mutex> lock(_doneMutex);
+      _done.push_back(batch);
+    }
+    uint64_t one = 1;
+    if (write(_verifyEventFd, &one, sizeof(one)) < 0) {
+      // Counter saturated: the loop is already due to wake
+    }
+  });
+}
+
+void Gateway::onVerified() {
+  uint64_t count;
+  if (read(_verifyEventFd, &count, sizeof(count)) < 0 && errno != EAGAIN) return;
+
+  std::vector<VerifyBatch*> done;
+  {
+    std::lock_guard<std::mutex> lock(_doneMutex);
+    done.swap(_done);
+  }
+  for (VerifyBatch* batch : done) {
+    for (size_t i = 0; i < batch->readings.size(); i++) {
+      switch (batch->results[i]) {
+        case VerifyResult::Valid:
+          forwardReading(batch->readings[i], "true");
+          break;
+        case VerifyResult::UnknownKey:
+          forwardReading(batch->readings[i], "false");
+          break;
+        case VerifyResult::Invalid:
+          _stats.badSignatures++;
+          break;
+      }
+    }
+    delete batch;
+    _verifyInFlight--;
+  }
+}
+
+void Gateway::finishVerification() {
+  if (!_verifier) return;
+  submitVerification();
+  while (_verifyInFlight > 0) {
+    struct pollfd pfd = {_verifyEventFd, POLLIN, 0};
+    poll(&pfd, 1, 1000);
+    onVerified();
+  }
+}
+
+void Gateway::reloadKeys() {
+  if (!_keys) return;
+  if (_keys->load(_options.keysPath.c_str())) {
+    fprintf(stderr, "gateway: reloaded %zu device keys\n", _keys->size());
+  }
+}
+
+size_t Gateway::downlinkPort(uint16_t address) const {
+  // The module that last heard the device, else the first open one
+  auto heard = _lastHeard.find(address);
+  if (heard != _lastHeard.end() && _ports[heard->second].port->isOpen()) return heard->second;
+  for (size_t i = 0; i < _ports.size(); i++) {
+    if (_ports[i].port->isOpen()) return i;
+  }
+  return _ports.size();
+}
+
+void Gateway::onDownlink(uint16_t address, const uint8_t* payload, size_t length) {
+  // A new epoch fixes the tree the devices will prove membership in, and
+  // starts a nullifier partition
+  if (length >= 5 && payload[0] == wire::MSG_EPOCH) {
+    uint32_t epoch = ((uint32_t)payload[1] << 24) | ((uint32_t)payload[2] << 16) |
+                     ((uint32_t)payload[3] << 8) | payload[4];
+    if (_tree && (epoch != _tree->epoch() || _tree->size() > _tree->leaves())) commitTree(epoch);
+    if (_nullifiers) _nullifiers->setEpoch(epoch);
+  }
+  if (_options.scheduleDownlinks && address != 0) {
+    // Held for the device's receive window
+    if (!_downlinks.enqueue(address, payload, length, _nowMs)) _stats.downlinksFailed++;
+    return;
+  }
+  _downlinks.onSent(length, _nowMs);
+  sendDownlink(address, payload, length);
+}
+
+void Gateway::sendDownlink(uint16_t address, const uint8_t* payload, size_t length) {
+  size_t index = downlinkPort(address);
+  if (index >= _ports.size()) {
+    _stats.downlinksFailed++;
+    return;
+  }
+  // A time beacon is stamped again when the module takes it
+  RylrPort& port = *_ports[index].port;
+  bool beacon = payload[0] == wire::MSG_TIME && length == tsync::BEACON_SIZE;
+  if (beacon ? port.sendTime(address, _nowMs) : port.send(address, payload, length, _nowMs)) {
+    _stats.downlinksSent++;
+  } else {
+    _stats.downlinksFailed++;
+  }
+}
+
+void Gateway::serviceDownlinks() {
+  uint8_t frame[wire::MAX_FRAME_BYTES];
+  uint16_t address;
+  size_t length;
+  while ((length = _downlinks.next(_nowMs, &address, frame)) > 0) {
+    sendDownlink(address, frame, length);
+  }
+}
+
+void Gateway::commitTree(uint32_t epoch) {
+  if (!_tree->commit(epoch)) {
+    _stats.treeFailures++;
+    return;
+  }
+  char root[2 * merkle::HASH_SIZE + 1];
+  wire::hexEncode(_tree->root(), merkle::HASH_SIZE, root);
+  fprintf(stderr, "gateway: epoch %u root %.16s..., %u leaves (%u new)\n", epoch, root,
+          _tree->leaves(), _tree->leaves() - _tree->previousLeaves());
+
+  char record[RECORD_MAX];
+  int n = snprintf(record, sizeof(record),
+                   "{\"type\":\"commitment_root\",\"epoch\":%u,\"leaves\":%u,\"root\":\"%s\"}",
+                   epoch, _tree->leaves(), root);
+  _forwarder.push(record, (size_t)n, _nowMs);
+}
+
+void Gateway::broadcastConfig() {
+  // Address 0 reaches every device on the network ID; each module may cover its own channel
+  size_t sent = 0;
+  for (PortState& state : _ports) {
+    if (state.port->isOpen() &&
+        state.port->send(0, _config->message(), _config->messageLength(), _nowMs)) {
+      _downlinks.onSent(_config->messageLength(), _nowMs);
+      sent++;
+    }
+  }
+  _stats.downlinksSent += sent;
+  if (sent > 0) _config->broadcastSent(_nowMs);
+}
+
+void Gateway::sendTime(uint16_t address) {
+  uint8_t beacon[tsync::BEACON_SIZE];
+  tsync::encodeBeacon(wallClockMs(), beacon);
+  onDownlink(address, beacon, sizeof(beacon));
+}
+
+void Gateway::broadcastTime() {
+  size_t sent = 0;
+  for (PortState& state : _ports) {
+    if (state.port->isOpen() && state.port->sendTime(0, _nowMs)) {
+      _downlinks.onSent(tsync::BEACON_SIZE, _nowMs);
+      sent++;
+    }
+  }
+  _stats.downlinksSent += sent;
+  if (sent > 0) _time->broadcastSent(_nowMs);
+}
+
+void Gateway::reloadConfig() {
+  if (!_config) return;
+  uint16_t previous = _config->version();
+  if (!_config->load(_options.deviceConfigPath.c_str())) return;
+  fprintf(stderr, "gateway: reloaded device settings v%u\n", _config->version());
+  if (_config->version() == previous) return;
+  broadcastConfig();
+}
+
+void Gateway::onTick() {
+  for (size_t i = 0; i < _ports.size(); i++) {
+    PortState& state = _ports[i];
+    if (state.port->isOpen()) {
+      state.port->poll(_nowMs);
+    } else if (_nowMs >= state.retryAtMs) {
+      openPort(i);
+    }
+    state.reassembler->expire((uint32_t)_nowMs, FRAGMENT_MAX_AGE_MS);
+  }
+
+  // A partial batch waits at most one tick
+  if (_verifier) submitVerification();
+
+  if (_journal) {
+    // Group commit: one msync per tick for everything appended since the last
+    _journal->commit();
+    pumpJournal();
+    if (_nowMs >= _nextCompactMs) {
+      _journal->compact();
+      _nextCompactMs = _nowMs + COMPACT_INTERVAL_MS;
+    }
+  }
+
+  // Log writes and table swaps stay off the reading path
+  if (_nullifiers) _nullifiers->flush();
+
+  _forwarder.service(_nowMs);
+
+  if (_time && _time->broadcastDue(_nowMs)) broadcastTime();
+  serviceDownlinks();
+
+  if (_options.statsIntervalS > 0 && _nowMs >= _nextStatsMs) {
+    printStats();
+    _nextStatsMs = _nowMs + (uint64_t)_options.statsIntervalS * 1000ULL;
+  }
+}
+
+bool Gateway::openPort(size_t index) {
+  PortState& state = _ports[index];
+  if (!state.port->open(_options.radio.baud)) {
+    state.retryAtMs = _nowMs + PORT_RETRY_MS;
+    return false;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = index;
+  if (epoll_ctl(_epoll, EPOLL_CTL_ADD, state.port->fd(), &ev) != 0) {
+    fprintf(stderr, "%s: epoll: %s\n", state.port->path().c_str(), strerror(errno));
+    state.port->close();
+    state.retryAtMs = _nowMs + PORT_RETRY_MS;
+    return false;
+  }
+
+  if (_options.configureRadio) state.port->configure(_options.radio, _nowMs);
+  fprintf(stderr, "%s: open\n", state.port->path().c_str());
+  return true;
+}
+
+void Gateway::closePort(size_t index) {
+  PortState& state = _ports[index];
+  epoll_ctl(_epoll, EPOLL_CTL_DEL, state.port->fd(), nullptr);
+  state.port->close();
+  state.retryAtMs = _nowMs + PORT_RETRY_MS;
+}
+
+void Gateway::updateSocketWatch() {
+  int fd = _forwarder.fd();
+  bool wantWrite = _forwarder.wantsWrite();
+  if (fd == _watchedSocket && wantWrite == _watchingWrite) return;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | (wantWrite ? (uint32_t)EPOLLOUT : 0u);
+  ev.data.u64 = TAG_SOCKET;
+  if (fd != _watchedSocket) {
+    // A closed descriptor has already left the epoll set
+    if (_watchedSocket >= 0) epoll_ctl(_epoll, EPOLL_CTL_DEL, _watchedSocket, nullptr);
+    if (fd >= 0) epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+  } else {
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev);
+  }
+  _watchedSocket = fd;
+  _watchingWrite = wantWrite;
+}
+
+void Gateway::printStats() {
+  uint64_t frames = 0, badLines = 0, commandsFailed = 0;
+  uint32_t completed = 0, discarded = 0, malformed = 0;
+  for (const PortState& state : _ports) {
+    frames += state.port->stats().frames;
+    badLines += state.port->stats().badLines;
+    commandsFailed += state.port->stats().commandsFailed;
+    completed += state.reassembler->completed();
+    discarded += state.reassembler->discarded();
+    malformed += state.reassembler->malformed();
+  }
+  const ForwarderStats& fwd = _forwarder.stats();
+  fprintf(stderr,
+          "stats: frames %llu (bad line %llu, bad frame %llu) | reassembled %u, discarded %u, "
+          "malformed %u | registrations %llu (deferred %llu, waiting %zu), readings %llu (alerts %llu), echoes %llu, "
+          "history %llu, fl updates %llu, unknown %llu, duplicates %llu | forwarded %llu in %llu batches, dropped %llu, pending %zu B, %s | "
+          "downlinks %llu (failed %llu), AT errors %llu\n",
+          (unsigned long long)frames, (unsigned long long)badLines,
+          (unsigned long long)_stats.badFrames, completed, discarded, malformed,
+          (unsigned long long)_stats.registrations,
+          (unsigned long long)_stats.registrationsDeferred, _pacer.waiting(),
+          (unsigned long long)_stats.readings,
+          (unsigned long long)_stats.alerts, (unsigned long long)_stats.echoes,
+          (unsigned long long)_stats.history, (unsigned long long)_stats.flUpdates,
+          (unsigned long long)_stats.unknown,
+          (unsigned long long)_dedup.duplicates(), (unsigned long long)fwd.records,
+          (unsigned long long)fwd.batches, (unsigned long long)fwd.dropped,
+          _forwarder.pendingBytes(), _forwarder.isConnected() ? "connected" : "disconnected",
+          (unsigned long long)_stats.downlinksSent, (unsigned long long)_stats.downlinksFailed,
+          (unsigned long long)commandsFailed);
+
+  if (_options.scheduleDownlinks) {
+    const dl::SchedulerStats& downlinks = _downlinks.stats();
+    fprintf(stderr,
+            "stats: downlinks queued %llu, pending %zu | released %llu in %llu frames (%llu "
+            "bundled) | superseded %llu, dropped %llu, expired %llu | waits for budget %llu, "
+            "for uplinks %llu | airtime %.1f s, %zu device periods known\n",
+            (unsigned long long)downlinks.queued, _downlinks.pending(),
+            (unsigned long long)downlinks.messages, (unsigned long long)downlinks.frames,
+            (unsigned long long)downlinks.bundled, (unsigned long long)downlinks.superseded,
+            (unsigned long long)downlinks.dropped, (unsigned long long)downlinks.expired,
+            (unsigned long long)downlinks.budgetWaits, (unsigned long long)downlinks.uplinkWaits,
+            downlinks.airtimeUs / 1e6, _downlinks.predicted());
+  }
+
+  if (_verifier) {
+    VerifierStats verify = _verifier->stats();
+    fprintf(stderr,
+            "stats: signatures valid %llu, invalid %llu (dropped), unknown key %llu | "
+            "%zu keys, cache hits %llu, misses %llu\n",
+            (unsigned long long)verify.valid, (unsigned long long)verify.invalid,
+            (unsigned long long)verify.unknownKey, _keys->size(),
+            (unsigned long long)_keys->hits(), (unsigned long long)_keys->misses());
+  }
+
+  if (_journal) {
+    JournalStats journal = _journal->stats();
+    fprintf(stderr,
+            "stats: journal %llu-%llu (durable %llu, %zu segments), proof server at %llu, "
+            "sent to %llu | appended %llu, commits %llu, lost %llu, torn %llu, failures %llu\n",
+            (unsigned long long)_journal->begin(), (unsigned long long)_journal->end(),
+            (unsigned long long)_journal->durableEnd(), journal.segments,
+            (unsigned long long)_journal->cursor(CONSUMER), (unsigned long long)_sendOffset,
+            (unsigned long long)journal.appended, (unsigned long long)journal.commits,
+            (unsigned long long)journal.lost, (unsigned long long)journal.torn,
+            (unsigned long long)_stats.journalFailures);
+  }
+
+  if (_tree) {
+    const CommitmentTreeStats& tree = _tree->stats();
+    fprintf(stderr,
+            "stats: commitment tree %u leaves at epoch %u, %u appended since | appended %llu, "
+            "duplicates %llu, commits %llu (%llu hashes), failures %llu\n",
+            _tree->leaves(), _tree->epoch(), _tree->size() - _tree->leaves(),
+            (unsigned long long)tree.appended, (unsigned long long)tree.duplicates,
+            (unsigned long long)tree.commits, (unsigned long long)tree.hashes,
+            (unsigned long long)_stats.treeFailures);
+  }
+
+  if (_nullifiers) {
+    NullifierSetStats nullifiers = _nullifiers->stats();
+    fprintf(stderr,
+            "stats: nullifiers epoch %u, %llu in %zu tables, %zu live | inserted %llu, "
+            "replays %llu | Bloom hits %llu (false %llu), sealed %llu, expired %llu\n",
+            _nullifiers->epoch(), (unsigned long long)nullifiers.tableKeys, nullifiers.tables,
+            nullifiers.liveKeys, (unsigned long long)nullifiers.inserted,
+            (unsigned long long)_stats.replays, (unsigned long long)nullifiers.bloomHits,
+            (unsigned long long)nullifiers.falsePositives, (unsigned long long)nullifiers.sealed,
+            (unsigned long long)nullifiers.expired);
+  }
+
+  if (_ota) {
+    const OtaStats& ota = _ota->stats();
+    fprintf(stderr,
+            "stats: ota offers %llu, chunks %llu, status reports %llu | updated %llu, "
+            "up to date %llu, rejected %llu\n",
+            (unsigned long long)ota.offers, (unsigned long long)ota.chunks,
+            (unsigned long long)ota.statuses, (unsigned long long)ota.updated,
+            (unsigned long long)ota.upToDate, (unsigned long long)ota.rejected);
+  }
+
+  if (_config) {
+    const ConfigStats& config = _config->stats();
+    fprintf(stderr,
+            "stats: settings v%u broadcasts %llu, resends %llu | applied %llu, rejected %llu, "
+            "not addressed %llu\n",
+            _config->version(), (unsigned long long)config.broadcasts,
+            (unsigned long long)config.resends, (unsigned long long)config.applied,
+            (unsigned long long)config.rejected, (unsigned long long)config.notAddressed);
+  }
+
+  if (_time) {
+    const TimeStats& time = _time->stats();
+    fprintf(stderr,
+            "stats: time beacons %llu, unicasts %llu | readings in network time %llu, "
+            "from boot %llu\n",
+            (unsigned long long)time.broadcasts, (unsigned long long)time.unicasts,
+            (unsigned long long)time.synced, (unsigned long long)time.unsynced);
+  }
+}
+
+} // namespace gw
@@ -0,0 +1,468 @@
+/**
+ * Journal Implementation
+ */
+
+#include "journal.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+const char SEGMENT_MAGIC[8] = {'E', 'C', 'J', 'S', 'E', 'G', '0', '1'};
+const uint32_t RECORD_MAGIC = 0x314A4345;   // "ECJ1"
+const size_t CURSOR_NAME_MAX = 24;
+const size_t CURSOR_SLOT = CURSOR_NAME_MAX + 8;
+
+// Record layout (little-endian):
+//   0 magic u32, 4 crc32 of bytes 8..RECORD_SIZE, 8 offset u64, 16 receivedMs u64,
+//   24 address u16, 26 seq u16, 28 rssi i16, 30 snr i8, 31 port u8, 32 flags u8,
+//   33 channels length u8, 40 packet (DATA_PACKET_SIZE), 184 analytics report
+//   (analytics::REPORT_SIZE), then in RECORD_SIZE segments only 192 probes item
+//   (probe::ITEM_MAX) and 242 packed channels (schema::Extra::SIZE)
+const size_t PACKET_AT = 40;
+const size_t ANALYTICS_AT = PACKET_AT + wire::DATA_PACKET_SIZE;
+const size_t PROBES_AT = ANALYTICS_AT + analytics::REPORT_SIZE;
+static_assert(PROBES_AT == Journal::LEGACY_RECORD_SIZE, "probes item follows the legacy record");
+const size_t EXTRA_AT = PROBES_AT + probe::ITEM_MAX;
+static_assert(EXTRA_AT + schema::Extra::SIZE <= Journal::RECORD_SIZE, "channels fit a record");
+
+struct CrcTable {
+  uint32_t value[256];
+  CrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      value[i] = c;
+    }
+  }
+};
+const CrcTable CRC_TABLE;
+
+uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < length; i++) c = CRC_TABLE.value[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+void putU16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+void putU32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+void putU64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint64_t getU64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+bool recordValid(const uint8_t* slot, size_t recordSize, uint64_t offset) {
+  return getU32(slot) == RECORD_MAGIC && getU64(slot + 8) == offset &&
+         getU32(slot + 4) == crc32(slot + 8, recordSize - 8);
+}
+
+std::string segmentName(uint64_t first) {
+  char name[32];
+  snprintf(name, sizeof(name), "seg-%016llx.log", (unsigned long long)first);
+  return name;
+}
+
+} // namespace
+
+Journal::Segment::~Segment() {
+  if (map) munmap(map, bytes);
+  if (fd >= 0) close(fd);
+}
+
+Journal::~Journal() {
+  if (_committer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _commitTarget = _end;
+      _stopping = true;
+    }
+    _wake.notify_one();
+    _committer.join();
+  }
+  if (_cursorFd >= 0) close(_cursorFd);
+  if (_dirFd >= 0) close(_dirFd);
+}
+
+bool Journal::open(const std::string& dir, size_t recordsPerSegment, size_t maxSegments) {
+  _dir = dir;
+  _recordsPerSegment = recordsPerSegment ? recordsPerSegment : 1;
+  _maxSegments = maxSegments;
+
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(dir.c_str());
+    return false;
+  }
+  _dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR* listing = opendir(dir.c_str());
+  if (_dirFd < 0 || !listing) {
+    perror(dir.c_str());
+    if (listing) closedir(listing);
+    return false;
+  }
+  std::vector<uint64_t> firsts;
+  while (struct dirent* entry = readdir(listing)) {
+    unsigned long long first;
+    char tail[8];
+    if (sscanf(entry->d_name, "seg-%16llx.%3s", &first, tail) == 2 && strcmp(tail, "log") == 0) {
+      firsts.push_back(first);
+    }
+  }
+  closedir(listing);
+  std::sort(firsts.begin(), firsts.end());
+
+  for (size_t i = 0; i < firsts.size(); i++) {
+    SegmentPtr segment = openSegment(dir + "/" + segmentName(firsts[i]), firsts[i], false);
+    if (!segment) return false;
+    if (i > 0 && segment->first != _segments.back()->first + _recordsPerSegment) {
+      fprintf(stderr, "journal: gap before %s\n", segment->path.c_str());
+      return false;
+    }
+    _segments.push_back(segment);
+  }
+
+  // Rebuild the device index; the last segment ends at its first bad record
+  _begin = _end = _segments.empty() ? 0 : _segments.front()->first;
+  for (size_t i = 0; i < _segments.size(); i++) {
+    Segment& segment = *_segments[i];
+    uint64_t offset = segment.first;
+    for (; offset < segment.first + _recordsPerSegment; offset++) {
+      const uint8_t* record = slot(offset);
+      if (!recordValid(record, segment.recordSize, offset)) break;
+      indexRecord(record + PACKET_AT, offset);
+    }
+    _end = offset;
+    if (i + 1 == _segments.size()) recover(segment);
+  }
+  _durable = _end;
+  _stats.segments = _segments.size();
+
+  if (!loadCursors()) return false;
+  _committer = std::thread([this] { commitLoop(); });
+  return true;
+}
+
+Journal::SegmentPtr Journal::openSegment(const std::string& path, uint64_t first, bool create) {
+  SegmentPtr segment = std::make_shared<Segment>();
+  segment->path = path;
+  segment->first = first;
+  segment->bytes = HEADER_SIZE + _recordsPerSegment * RECORD_SIZE;
+
+  segment->fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+  if (segment->fd < 0) {
+    perror(path.c_str());
+    return nullptr;
+  }
+
+  if (create) {
+    // Allocate up front: a write into a hole on a full disk would be SIGBUS
+    int err = posix_fallocate(segment->fd, 0, (off_t)segment->bytes);
+    if (err != 0) {
+      fprintf(stderr, "%s: %s\n", path.c_str(), strerror(err));
+      unlink(path.c_str());
+      return nullptr;
+    }
+  } else {
+    uint8_t header[24];
+    if (pread(segment->fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header, SEGMENT_MAGIC, 8) != 0 || getU64(header + 8) != first ||
+        (getU32(header + 16) != RECORD_SIZE && getU32(header + 16) != LEGACY_RECORD_SIZE)) {
+      fprintf(stderr, "%s: not a journal segment\n", path.c_str());
+      return nullptr;
+    }
+    // The capacity chosen when the journal was created wins
+    _recordsPerSegment = getU32(header + 20);
+    segment->recordSize = getU32(header + 16);
+    segment->bytes = HEADER_SIZE + _recordsPerSegment * segment->recordSize;
+  }
+
+  void* map = mmap(nullptr, segment->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+  if (map == MAP_FAILED) {
+    perror(path.c_str());
+    return nullptr;
+  }
+  segment->map = (uint8_t*)map;
+
+  if (create) {
+    memcpy(segment->map, SEGMENT_MAGIC, 8);
+    putU64(segment->map + 8, first);
+    putU32(segment->map + 16, RECORD_SIZE);
+    putU32(segment->map + 20, (uint32_t)_recordsPerSegment);
+    msync(segment->map, HEADER_SIZE, MS_SYNC);
+  }
+  return segment;
+}
+
+void Journal::recover(Segment& segment) {
+  if (_end >= segment.first + _recordsPerSegment) return;
+  uint8_t* record = slot(_end);
+  // Anything here is a record cut short by a crash
+  if (getU32(record) != 0 || getU64(record + 8) != 0) {
+    memset(record, 0, segment.recordSize);
+    msync((uint8_t*)((uintptr_t)record & ~(uintptr_t)4095), 4096 + segment.recordSize, MS_SYNC);
+    _stats.torn++;
+    fprintf(stderr, "journal: dropped torn record at %llu\n", (unsigned long long)_end);
+  }
+}
+
+bool Journal::addSegment() {
+  SegmentPtr segment = openSegment(_dir + "/" + segmentName(_end), _end, true);
+  if (!segment) return false;
+  fsync(_dirFd);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _segments.push_back(segment);
+    _stats.segments = _segments.size();
+  }
+  if (_maxSegments > 0 && _segments.size() > _maxSegments) compact();
+  return true;
+}
+
+uint8_t* Journal::slot(uint64_t offset) const {
+  uint64_t base = _segments.front()->first;
+  size_t index = (size_t)((offset - base) / _recordsPerSegment);
+  const Segment& segment = *_segments[index];
+  return segment.map + HEADER_SIZE + (offset - segment.first) * segment.recordSize;
+}
+
+bool Journal::append(JournalRecord& record) {
+  if (_segments.empty() || _end == _segments.back()->first + _recordsPerSegment) {
+    if (!addSegment()) return false;
+  }
+
+  record.offset = _end;
+  size_t recordSize = _segments.back()->recordSize;
+  // The tail of a legacy segment has no room for probes
+  if (recordSize < RECORD_SIZE) {
+    record.flags &= (uint8_t)~JOURNAL_PROBES;
+    record.extraLength = 0;
+  }
+  uint8_t* p = slot(_end);
+  putU64(p + 8, record.offset);
+  putU64(p + 16, record.receivedMs);
+  putU16(p + 24, record.address);
+  putU16(p + 26, record.seq);
+  putU16(p + 28, (uint16_t)record.rssi);
+  p[30] = (uint8_t)record.snr;
+  p[31] = record.port;
+  p[32] = record.flags;
+  p[33] = record.extraLength;
+  memcpy(p + PACKET_AT, record.packet, wire::DATA_PACKET_SIZE);
+  memcpy(p + ANALYTICS_AT, record.analytics, analytics::REPORT_SIZE);
+  if (recordSize >= RECORD_SIZE) {
+    memcpy(p + PROBES_AT, record.probes, probe::ITEM_MAX);
+    memcpy(p + EXTRA_AT, record.extra, schema::Extra::SIZE);
+  }
+  putU32(p + 4, crc32(p + 8, recordSize - 8));
+  putU32(p, RECORD_MAGIC);   // Last: a record without it never existed
+
+  indexRecord(record.packet, _end);
+  _end++;
+  _stats.appended++;
+  return true;
+}
+
+bool Journal::read(uint64_t offset, JournalRecord* record) const {
+  if (offset < _begin || offset >= _end) return false;
+  const uint8_t* p = slot(offset);
+  size_t recordSize = _segments[(size_t)((offset - _segments.front()->first) / _recordsPerSegment)]
+                          ->recordSize;
+  if (!recordValid(p, recordSize, offset)) return false;
+
+  record->offset = offset;
+  record->receivedMs = getU64(p + 16);
+  record->address = getU16(p + 24);
+  record->seq = getU16(p + 26);
+  record->rssi = (int16_t)getU16(p + 28);
+  record->snr = (int8_t)p[30];
+  record->port = p[31];
+  record->flags = p[32];
+  record->extraLength = p[33] < schema::Extra::SIZE ? p[33] : (uint8_t)schema::Extra::SIZE;
+  memcpy(record->packet, p + PACKET_AT, wire::DATA_PACKET_SIZE);
+  memcpy(record->analytics, p + ANALYTICS_AT, analytics::REPORT_SIZE);
+  if (record->flags & JOURNAL_PROBES) memcpy(record->probes, p + PROBES_AT, probe::ITEM_MAX);
+  memcpy(record->extra, p + EXTRA_AT, record->extraLength);
+  return true;
+}
+
+void Journal::commit() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _commitTarget = _end;
+  }
+  _wake.notify_one();
+}
+
+uint64_t Journal::cursor(const std::string& name) const {
+  auto it = _cursors.find(name);
+  uint64_t offset = it == _cursors.end() ? _begin : it->second;
+  return std::min(std::max(offset, _begin), _end);
+}
+
+void Journal::setCursor(const std::string& name, uint64_t offset) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _cursors.find(name);
+  if (it == _cursors.end()) {
+    if (_cursors.size() >= CURSOR_MAX || name.size() >= CURSOR_NAME_MAX) return;
+    _cursors[name] = offset;
+  } else if (offset > it->second) {
+    it->second = offset;
+  } else {
+    return;
+  }
+  _cursorsDirty = true;
+}
+
+size_t Journal::compact() {
+  uint64_t minCursor = UINT64_MAX;
+  for (const auto& c : _cursors) minCursor = std::min(minCursor, c.second);
+  if (_cursors.empty()) minCursor = 0;
+
+  size_t removed = 0;
+  while (_segments.size() > 1) {
+    uint64_t segmentEnd = _segments.front()->first + _recordsPerSegment;
+    bool acknowledged = segmentEnd <= minCursor;
+    bool overLimit = _maxSegments > 0 && _segments.size() > _maxSegments;
+    if (!acknowledged && !overLimit) break;
+    if (!acknowledged) {
+      uint64_t from = std::max(_segments.front()->first, minCursor);
+      _stats.lost += segmentEnd - from;
+      fprintf(stderr, "journal: retention limit, dropping %llu unconsumed records\n",
+              (unsigned long long)(segmentEnd - from));
+    }
+    dropSegment();
+    removed++;
+  }
+  return removed;
+}
+
+void Journal::dropSegment() {
+  SegmentPtr segment;
+  {
+    // The committer may still hold its own reference for an msync
+    std::lock_guard<std::mutex> lock(_mutex);
+    segment = _segments.front();
+    _segments.erase(_segments.begin());
+    _stats.segments = _segments.size();
+  }
+  unlink(segment->path.c_str());
+  fsync(_dirFd);
+  _begin = _segments.front()->first;
+
+  for (auto it = _index.begin(); it != _index.end();) {
+    std::vector<uint64_t>& offsets = it->second;
+    offsets.erase(offsets.begin(), std::lower_bound(offsets.begin(), offsets.end(), _begin));
+    it = offsets.empty() ? _index.erase(it) : std::next(it);
+  }
+}
+
+void Journal::indexRecord(const uint8_t* commitment, uint64_t offset) {
+  Commitment c;
+  memcpy(c.data(), commitment, 32);
+  _index[c].push_back(offset);
+}
+
+size_t Journal::deviceOffsets(const uint8_t commitment[32], uint64_t from, uint64_t* out,
+                              size_t max) const {
+  Commitment c;
+  memcpy(c.data(), commitment, 32);
+  auto it = _index.find(c);
+  if (it == _index.end()) return 0;
+  const std::vector<uint64_t>& offsets = it->second;
+  size_t n = 0;
+  for (auto o = std::lower_bound(offsets.begin(), offsets.end(), from);
+       o != offsets.end() && n < max; ++o) {
+    out[n++] = *o;
+  }
+  return n;
+}
+
+JournalStats Journal::stats() const {
+  std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(_mutex));
+  return _stats;
+}
+
+bool Journal::loadCursors() {
+  std::string path = _dir + "/cursors";
+  _cursorFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (_cursorFd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  uint8_t table[CURSOR_MAX * CURSOR_SLOT];
+  ssize_t n = pread(_cursorFd, table, sizeof(table), 0);
+  for (size_t i = 0; n == (ssize_t)sizeof(table) && i < CURSOR_MAX; i++) {
+    const uint8_t* entry = table + i * CURSOR_SLOT;
+    if (entry[0] == 0) continue;
+    std::string name((const char*)entry, strnlen((const char*)entry, CURSOR_NAME_MAX));
+    _cursors[name] = getU64(entry + CURSOR_NAME_MAX);
+  }
+  return true;
+}
+
+void Journal::commitLoop() {
+  for (;;) {
+    std::vector<SegmentPtr> segments;
+    uint8_t table[CURSOR_MAX * CURSOR_SLOT];
+    bool writeCursors;
+    uint64_t target;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this] {
+        return _stopping || _commitTarget > _durable.load() || _cursorsDirty;
+      });
+      if (_stopping && _commitTarget <= _durable.load() && !_cursorsDirty) return;
+
+      target = _commitTarget;
+      segments = _segments;
+      writeCursors = _cursorsDirty;
+      _cursorsDirty = false;
+      memset(table, 0, sizeof(table));
+      size_t i = 0;
+      for (const auto& c : _cursors) {
+        memcpy(table + i * CURSOR_SLOT, c.first.data(), c.first.size());
+        putU64(table + i * CURSOR_SLOT + CURSOR_NAME_MAX, c.second);
+        i++;
+      }
+    }
+
+    // Flush the appended range of every segment it touches
+    uint64_t from = _durable.load();
+    for (const SegmentPtr& segment : segments) {
+      uint64_t lo = std::max(from, segment->first);
+      uint64_t hi = std::min(target, segment->first + _recordsPerSegment);
+      if (lo >= hi) continue;
+      size_t recordSize = segment->recordSize;
+      uintptr_t start = (uintptr_t)(segment->map + HEADER_SIZE + (lo - segment->first) * recordSize);
+      uintptr_t stop = (uintptr_t)(segment->map + HEADER_SIZE + (hi - segment->first) * recordSize);
+      start &= ~(uintptr_t)4095;
+      msync((void*)start, stop - start, MS_SYNC);
+    }
+    if (writeCursors) {
+      if (pwrite(_cursorFd, table, sizeof(table), 0) != (ssize_t)sizeof(table)) {
+        perror("journal: cursors");
+      }
+      fdatasync(_cursorFd);
+    }
+
+    if (target > _durable.load()) _durable = target;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.commits++;
+  }
+}
+
+} // namespace gw
@@ -0,0 +1,83 @@
+/**
+ * Key Cache Implementation
+ */
+
+#include "key_cache.h"
+#include "wire_codec.h"
+#include <stdio.h>
+
+namespace gw {
+
+bool KeyCache::load(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  std::unordered_map<Commitment, Entry, CommitmentHash> entries;
+  char line[512];
+  unsigned lineNo = 0;
+  while (fgets(line, sizeof(line), file)) {
+    lineNo++;
+    char commitmentHex[65], keyHex[129];
+    if (line[0] == '#' || sscanf(line, "%64s %128s", commitmentHex, keyHex) != 2) continue;
+
+    Commitment commitment;
+    Entry entry;
+    if (wire::hexDecode(commitmentHex, strlen(commitmentHex), commitment.data(), 32) != 32 ||
+        wire::hexDecode(keyHex, strlen(keyHex), entry.raw.data(), 64) != 64) {
+      fprintf(stderr, "%s:%u: bad entry\n", path, lineNo);
+      continue;
+    }
+    entries[commitment] = entry;
+  }
+  fclose(file);
+
+  _entries.swap(entries);
+  _lru.clear();
+  return true;
+}
+
+void KeyCache::add(const uint8_t commitment[32], const uint8_t publicKey[64]) {
+  Commitment c;
+  memcpy(c.data(), commitment, 32);
+  auto it = _entries.find(c);
+  if (it != _entries.end() && it->second.decoded) {
+    _lru.erase(it->second.lru);
+    it->second.decoded.reset();
+  }
+  memcpy(_entries[c].raw.data(), publicKey, 64);
+}
+
+std::shared_ptr<const PublicKey> KeyCache::find(const uint8_t commitment[32]) {
+  Commitment c;
+  memcpy(c.data(), commitment, 32);
+  auto it = _entries.find(c);
+  if (it == _entries.end()) return nullptr;
+
+  Entry& entry = it->second;
+  if (entry.decoded) {
+    _hits++;
+    _lru.splice(_lru.begin(), _lru, entry.lru);
+    return entry.decoded;
+  }
+
+  _misses++;
+  std::shared_ptr<const PublicKey> key = PublicKey::parse(entry.raw.data());
+  if (!key) return nullptr;
+  if (_lru.size() >= _capacity) evictOne();
+  entry.decoded = key;
+  _lru.push_front(&it->first);
+  entry.lru = _lru.begin();
+  return key;
+}
+
+void KeyCache::evictOne() {
+  // Workers still holding the key keep it alive through their shared_ptr
+  const Commitment* oldest = _lru.back();
+  _lru.pop_back();
+  _entries[*oldest].decoded.reset();
+}
+
+} // namespace gw
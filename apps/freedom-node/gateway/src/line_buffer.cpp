@@ -0,0 +1,46 @@
+/**
+ * Line Buffer Implementation
+ */
+
+#include "line_buffer.h"
+#include <string.h>
+#include <unistd.h>
+
+namespace gw {
+
+ssize_t LineBuffer::fill(int fd) {
+  // Move the partial line to the front; lines handed out before are now stale
+  if (_start > 0) {
+    memmove(_data, _data + _start, _end - _start);
+    _end -= _start;
+    _start = 0;
+  }
+  if (_end == CAPACITY) {
+    // No terminator in a full buffer: garbage or a runaway line
+    _overflows++;
+    _end = 0;
+  }
+  ssize_t n = read(fd, _data + _end, CAPACITY - _end);
+  if (n > 0) _end += (size_t)n;
+  return n;
+}
+
+bool LineBuffer::next(const char** line, size_t* length) {
+  while (_start < _end) {
+    const char* begin = _data + _start;
+    const char* newline = (const char*)memchr(begin, '\n', _end - _start);
+    if (!newline) return false;
+
+    size_t n = (size_t)(newline - begin);
+    _start += n + 1;
+    if (n > 0 && begin[n - 1] == '\r') n--;
+    if (n == 0) continue;
+
+    *line = begin;
+    *length = n;
+    return true;
+  }
+  return false;
+}
+
+} // namespace gw
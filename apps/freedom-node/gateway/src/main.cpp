@@ -0,0 +1,223 @@
+/**
+ * EdgeChain Gateway - Entry Point
+ *
+ * Reads one or more RYLR896 modules and forwards decoded uplinks to the
+ * proof server over a local Unix socket. See README.md.
+ *
+ * Usage: edgechain-gateway --port /dev/ttyUSB0 [--port /dev/ttyUSB1 ...]
+ *          [--socket PATH] [--batch N] [--flush-ms MS] [--stats-interval-s S]
+ *          [--no-configure] [--baud B] [--network-id ID] [--address A]
+ *          [--frequency HZ] [--sf SF] [--bw KHZ] [--tx-power DBM]
+ *          [--keys FILE] [--verify-threads N] [--verify-batch N]
+ *          [--journal DIR] [--journal-segment-records N] [--journal-max-segments N]
+ *          [--forward-window N] [--ota-campaign FILE] [--device-config FILE]
+ *          [--time-beacon-s S] [--registrations-per-min N]
+ *          [--downlink-duty-permille N] [--no-downlink-schedule]
+ *          [--commitment-tree FILE] [--nullifier-dir DIR] [--nullifier-epochs N]
+ *          [--nullifier-partition N]
+ *        edgechain-gateway --journal DIR --dump-device COMMITMENT
+ */
+
+#include "gateway.h"
+#include "journal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s --port DEVICE [--port DEVICE ...] [options]\n"
+          "  --socket PATH          proof-server socket (default /run/edgechain/gateway.sock),\n"
+          "                         or HOST:PORT of an edgechain-merge\n"
+          "  --batch N              records per write (default 32)\n"
+          "  --flush-ms MS          flush records older than this (default 50)\n"
+          "  --stats-interval-s S   print counters every S seconds, 0 = off (default 60)\n"
+          "  --no-configure         leave the module settings as they are\n"
+          "  --baud B               UART baud rate (default 115200)\n"
+          "  --network-id ID --address A --frequency HZ --sf SF --bw KHZ --tx-power DBM\n"
+          "                         radio settings (defaults match the firmware config)\n"
+          "  --keys FILE            bound-device keys; verify signatures, drop invalid ones\n"
+          "                         (SIGHUP reloads the file)\n"
+          "  --verify-threads N     verification workers, 0 = one per core (default 0)\n"
+          "  --verify-batch N       readings per verification batch (default 64)\n"
+          "  --journal DIR          journal readings in DIR and forward them from there\n"
+          "  --journal-segment-records N  records per segment file (default 65536)\n"
+          "  --journal-max-segments N     delete the oldest segment beyond N, 0 = never\n"
+          "                         (default 64)\n"
+          "  --forward-window N     journal records sent ahead of the last ack (default 1024)\n"
+          "  --ota-campaign FILE    offer the firmware update in FILE (edgechain-ota-pack)\n"
+          "  --device-config FILE   roll out the signed device settings in FILE, from\n"
+          "                         edgechain-config-pack (SIGHUP reloads it)\n"
+          "  --time-beacon-s S      broadcast network time every S seconds, 0 = never\n"
+          "                         (default 21600)\n"
+          "  --registrations-per-min N  forward at most N registrations a minute, ask the\n"
+          "                         rest to retry later; 0 = no limit (default 12)\n"
+          "  --downlink-duty-permille N  gateway share of the air in permille, 0 = no\n"
+          "                         limit (default 100)\n"
+          "  --no-downlink-schedule send downlinks at once instead of in the device's\n"
+          "                         receive window\n"
+          "  --commitment-tree FILE add registered commitments to the Merkle tree in FILE,\n"
+          "                         committing its root at each epoch broadcast\n"
+          "  --nullifier-dir DIR    drop readings already forwarded, keeping their\n"
+          "                         (timestamp, nullifier) keys in DIR\n"
+          "  --nullifier-epochs N   epochs of keys kept, the current one included (default 2)\n"
+          "  --nullifier-partition N  keys per sealed table (default 1048576)\n"
+          "  --dump-device HEX      print the journal records of one commitment and exit\n",
+          program);
+}
+
+// One line per journal record of a device: offset, receipt time, radio metadata, packet
+int dumpDevice(const gw::GatewayOptions& options, const char* commitmentHex) {
+  uint8_t commitment[32];
+  if (strlen(commitmentHex) != 64 || wire::hexDecode(commitmentHex, 64, commitment, 32) != 32) {
+    fprintf(stderr, "--dump-device: expected a 32-byte commitment in hex\n");
+    return 2;
+  }
+  gw::Journal journal;
+  if (!journal.open(options.journalDir, options.journalSegmentRecords, 0)) return 1;
+
+  uint64_t offsets[256];
+  uint64_t from = journal.begin();
+  size_t n;
+  while ((n = journal.deviceOffsets(commitment, from, offsets, 256)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      gw::JournalRecord record;
+      if (!journal.read(offsets[i], &record)) continue;
+      // The packet as signed: the DataPacket, then a sensor hub's probes item
+      uint8_t message[probe::PACKET_MAX];
+      size_t length = wire::DATA_PACKET_SIZE;
+      memcpy(message, record.packet, length);
+      if (record.flags & gw::JOURNAL_PROBES && record.probes[1] <= probe::ITEM_MAX - 2) {
+        size_t itemLen = wire::TRAILER_ITEM_HEADER_SIZE + record.probes[1];
+        memcpy(message + length, record.probes, itemLen);
+        length += itemLen;
+      }
+      char packet[2 * probe::PACKET_MAX + 1];
+      wire::hexEncode(message, length, packet);
+      printf("{\"offset\":%llu,\"receivedMs\":%llu,\"address\":%u,\"seq\":%u,\"port\":%u,"
+             "\"rssi\":%d,\"snr\":%d,\"flags\":%u,\"packet\":\"%s\"}\n",
+             (unsigned long long)record.offset, (unsigned long long)record.receivedMs,
+             record.address, record.seq, record.port, record.rssi, record.snr, record.flags,
+             packet);
+    }
+    from = offsets[n - 1] + 1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gw::GatewayOptions options;
+  const char* dumpCommitment = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto number = [&]() -> unsigned long {
+      i++;
+      return strtoul(value, nullptr, 10);
+    };
+
+    if (strcmp(arg, "--no-configure") == 0) {
+      options.configureRadio = false;
+    } else if (strcmp(arg, "--no-downlink-schedule") == 0) {
+      options.scheduleDownlinks = false;
+    } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      usage(argv[0]);
+      return 0;
+    } else if (!value) {
+      usage(argv[0]);
+      return 2;
+    } else if (strcmp(arg, "--port") == 0) {
+      options.ports.push_back(value);
+      i++;
+    } else if (strcmp(arg, "--socket") == 0) {
+      options.socketPath = value;
+      i++;
+    } else if (strcmp(arg, "--batch") == 0) {
+      options.batchRecords = number();
+    } else if (strcmp(arg, "--flush-ms") == 0) {
+      options.flushMs = (uint32_t)number();
+    } else if (strcmp(arg, "--stats-interval-s") == 0) {
+      options.statsIntervalS = (uint32_t)number();
+    } else if (strcmp(arg, "--baud") == 0) {
+      options.radio.baud = (uint32_t)number();
+    } else if (strcmp(arg, "--network-id") == 0) {
+      options.radio.networkId = (uint8_t)number();
+    } else if (strcmp(arg, "--address") == 0) {
+      options.radio.address = (uint16_t)number();
+    } else if (strcmp(arg, "--frequency") == 0) {
+      options.radio.frequency = (uint32_t)number();
+    } else if (strcmp(arg, "--sf") == 0) {
+      options.radio.spreadingFactor = (uint8_t)number();
+    } else if (strcmp(arg, "--bw") == 0) {
+      options.radio.bandwidthKHz = (uint16_t)number();
+    } else if (strcmp(arg, "--tx-power") == 0) {
+      options.radio.txPower = (uint8_t)number();
+    } else if (strcmp(arg, "--keys") == 0) {
+      options.keysPath = value;
+      i++;
+    } else if (strcmp(arg, "--verify-threads") == 0) {
+      options.verifyThreads = number();
+    } else if (strcmp(arg, "--verify-batch") == 0) {
+      options.verifyBatch = number();
+    } else if (strcmp(arg, "--journal") == 0) {
+      options.journalDir = value;
+      i++;
+    } else if (strcmp(arg, "--journal-segment-records") == 0) {
+      options.journalSegmentRecords = number();
+    } else if (strcmp(arg, "--journal-max-segments") == 0) {
+      options.journalMaxSegments = number();
+    } else if (strcmp(arg, "--forward-window") == 0) {
+      options.forwardWindow = number();
+    } else if (strcmp(arg, "--ota-campaign") == 0) {
+      options.otaCampaignPath = value;
+      i++;
+    } else if (strcmp(arg, "--device-config") == 0) {
+      options.deviceConfigPath = value;
+      i++;
+    } else if (strcmp(arg, "--time-beacon-s") == 0) {
+      options.timeBeaconS = (uint32_t)number();
+    } else if (strcmp(arg, "--registrations-per-min") == 0) {
+      options.registrationsPerMin = (uint32_t)number();
+    } else if (strcmp(arg, "--downlink-duty-permille") == 0) {
+      options.downlinkDutyPermille = (uint32_t)number();
+    } else if (strcmp(arg, "--commitment-tree") == 0) {
+      options.commitmentTreePath = value;
+      i++;
+    } else if (strcmp(arg, "--nullifier-dir") == 0) {
+      options.nullifierDir = value;
+      i++;
+    } else if (strcmp(arg, "--nullifier-epochs") == 0) {
+      options.nullifierEpochs = (uint32_t)number();
+    } else if (strcmp(arg, "--nullifier-partition") == 0) {
+      options.nullifierPartition = (size_t)number();
+    } else if (strcmp(arg, "--dump-device") == 0) {
+      dumpCommitment = value;
+      i++;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (dumpCommitment) {
+    if (options.journalDir.empty()) {
+      usage(argv[0]);
+      return 2;
+    }
+    return dumpDevice(options, dumpCommitment);
+  }
+
+  if (options.ports.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  gw::Gateway gateway(options);
+  if (!gateway.begin()) return 1;
+  return gateway.run();
+}
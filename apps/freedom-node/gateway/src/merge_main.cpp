@@ -0,0 +1,82 @@
+/**
+ * EdgeChain Merge - Entry Point
+ *
+ * Takes the records of several gateways that hear the same devices and
+ * forwards each uplink to the proof server once, from the gateway that
+ * heard it best. See README.md.
+ *
+ * Usage: edgechain-merge [--listen PATH] [--listen-tcp [HOST:]PORT]
+ *          [--socket PATH] [--window-ms MS] [--remember-s S]
+ *          [--batch N] [--flush-ms MS] [--stats-interval-s S]
+ */
+
+#include "merge_service.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --listen PATH          gateway socket (default /run/edgechain/merge.sock),\n"
+          "                         \"\" = none\n"
+          "  --listen-tcp [HOST:]PORT  also take gateways over TCP\n"
+          "  --socket PATH          proof-server socket (default /run/edgechain/gateway.sock)\n"
+          "  --window-ms MS         wait this long for other gateways' copies (default 300)\n"
+          "  --remember-s S         drop copies arriving up to S seconds late (default 60)\n"
+          "  --batch N              records per write (default 32)\n"
+          "  --flush-ms MS          flush records older than this (default 50)\n"
+          "  --stats-interval-s S   print counters every S seconds, 0 = off (default 60)\n",
+          program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gw::MergeOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto number = [&]() -> unsigned long {
+      i++;
+      return strtoul(value, nullptr, 10);
+    };
+
+    if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      usage(argv[0]);
+      return 0;
+    } else if (!value) {
+      usage(argv[0]);
+      return 2;
+    } else if (strcmp(arg, "--listen") == 0) {
+      options.listenPath = value;
+      i++;
+    } else if (strcmp(arg, "--listen-tcp") == 0) {
+      options.listenTcp = value;
+      i++;
+    } else if (strcmp(arg, "--socket") == 0) {
+      options.socketPath = value;
+      i++;
+    } else if (strcmp(arg, "--window-ms") == 0) {
+      options.windowMs = (uint32_t)number();
+    } else if (strcmp(arg, "--remember-s") == 0) {
+      options.rememberS = (uint32_t)number();
+    } else if (strcmp(arg, "--batch") == 0) {
+      options.batchRecords = number();
+    } else if (strcmp(arg, "--flush-ms") == 0) {
+      options.flushMs = (uint32_t)number();
+    } else if (strcmp(arg, "--stats-interval-s") == 0) {
+      options.statsIntervalS = (uint32_t)number();
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  gw::MergeService service(options);
+  if (!service.begin()) return 1;
+  return service.run();
+}
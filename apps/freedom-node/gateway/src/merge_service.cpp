@@ -0,0 +1,433 @@
+/**
+ * Merge Service Implementation
+ */
+
+#include "merge_service.h"
+#include "wire_codec.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+// epoll tags; gateway connections carry their peer id
+const uint64_t TAG_SIGNAL = UINT64_MAX;
+const uint64_t TAG_TIMER = UINT64_MAX - 1;
+const uint64_t TAG_SOCKET = UINT64_MAX - 2;
+const uint64_t TAG_UNIX = UINT64_MAX - 3;
+const uint64_t TAG_TCP = UINT64_MAX - 4;
+
+const uint32_t TICK_MS = 50;
+
+uint64_t monotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+// The server ignores offsets at or below the highest it has seen, from
+// this run or the last: start at the wall clock in microseconds
+uint64_t firstOffset() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+} // namespace
+
+MergeService::MergeService(const MergeOptions& options)
+    : _options(options),
+      _merger(options.windowMs, options.rememberS * 1000, firstOffset()),
+      _forwarder(options.socketPath, options.batchRecords, options.flushMs,
+                 options.maxPendingBytes) {}
+
+MergeService::~MergeService() {
+  for (auto& entry : _peers) close(entry.second->fd);
+  if (_unixFd >= 0) {
+    close(_unixFd);
+    unlink(_options.listenPath.c_str());
+  }
+  if (_tcpFd >= 0) close(_tcpFd);
+  if (_epoll >= 0) close(_epoll);
+  if (_signalFd >= 0) close(_signalFd);
+  if (_timerFd >= 0) close(_timerFd);
+}
+
+bool MergeService::begin() {
+  _nowMs = monotonicMs();
+
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+
+  // Signals arrive as readable events instead of interrupting the loop
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  _signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  // One tick closes merge windows, sends acks and flushes the forwarder
+  _timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct itimerspec tick;
+  tick.it_interval.tv_sec = 0;
+  tick.it_interval.tv_nsec = (long)TICK_MS * 1000000L;
+  tick.it_value = tick.it_interval;
+  if (_signalFd < 0 || _timerFd < 0 || timerfd_settime(_timerFd, 0, &tick, nullptr) != 0) {
+    perror("signalfd/timerfd");
+    return false;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = TAG_SIGNAL;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, _signalFd, &ev);
+  ev.data.u64 = TAG_TIMER;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, _timerFd, &ev);
+
+  if (!_options.listenPath.empty()) {
+    _unixFd = listenUnix();
+    if (_unixFd < 0) return false;
+    ev.data.u64 = TAG_UNIX;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _unixFd, &ev);
+  }
+  if (!_options.listenTcp.empty()) {
+    _tcpFd = listenTcp();
+    if (_tcpFd < 0) return false;
+    ev.data.u64 = TAG_TCP;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _tcpFd, &ev);
+  }
+  if (_unixFd < 0 && _tcpFd < 0) {
+    fprintf(stderr, "merge: nothing to listen on\n");
+    return false;
+  }
+
+  _merger.setEmitHandler(
+      [this](const char* record, size_t length) { _forwarder.push(record, length, _nowMs); });
+  _forwarder.setDownlinkHandler(
+      [this](uint16_t address, const uint8_t* payload, size_t length) {
+        onDownlink(address, payload, length);
+      });
+  _forwarder.setAckHandler([this](uint64_t next) {
+    _merger.acked(next);
+    sendAcks();
+  });
+  // What the server had not acked may not have reached it
+  _forwarder.setConnectHandler([this] { _sendOffset = _merger.heldBegin(); });
+  _forwarder.service(_nowMs);
+  updateSocketWatch();
+  _nextStatsMs = _nowMs + (uint64_t)_options.statsIntervalS * 1000ULL;
+  fprintf(stderr, "merge: %u ms window, forwarding to %s\n", _options.windowMs,
+          _options.socketPath.c_str());
+  return true;
+}
+
+int MergeService::listenUnix() {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (_options.listenPath.size() >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "merge: socket path too long\n");
+    return -1;
+  }
+  memcpy(addr.sun_path, _options.listenPath.c_str(), _options.listenPath.size());
+
+  // A socket file left by a previous run would make bind() fail
+  unlink(_options.listenPath.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+    perror(_options.listenPath.c_str());
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  fprintf(stderr, "merge: listening on %s\n", _options.listenPath.c_str());
+  return fd;
+}
+
+int MergeService::listenTcp() {
+  // [HOST:]PORT; no host listens on every address
+  std::string host, port = _options.listenTcp;
+  size_t colon = port.rfind(':');
+  if (colon != std::string::npos) {
+    host = port.substr(0, colon);
+    port = port.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);
+    }
+  }
+  struct addrinfo hints, *found = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+  if (rc != 0) {
+    fprintf(stderr, "merge: %s: %s\n", _options.listenTcp.c_str(), gai_strerror(rc));
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd >= 0 && (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 16) != 0)) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(found);
+  if (fd < 0) {
+    perror(_options.listenTcp.c_str());
+    return -1;
+  }
+  fprintf(stderr, "merge: listening on tcp %s\n", _options.listenTcp.c_str());
+  return fd;
+}
+
+int MergeService::run() {
+  struct epoll_event events[32];
+  for (;;) {
+    int n = epoll_wait(_epoll, events, 32, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      return 1;
+    }
+    _nowMs = monotonicMs();
+
+    for (int i = 0; i < n; i++) {
+      uint64_t tag = events[i].data.u64;
+      if (tag == TAG_SIGNAL) {
+        struct signalfd_siginfo info;
+        if (read(_signalFd, &info, sizeof(info)) != (ssize_t)sizeof(info)) continue;
+        fprintf(stderr, "merge: signal %u, stopping\n", info.ssi_signo);
+        _merger.flush();
+        pumpHeld();
+        _forwarder.service(_nowMs, true);
+        printStats();
+        return 0;
+      } else if (tag == TAG_TIMER) {
+        uint64_t expirations;
+        if (read(_timerFd, &expirations, sizeof(expirations)) > 0) onTick();
+      } else if (tag == TAG_SOCKET) {
+        if (events[i].events & EPOLLOUT) _forwarder.onWritable(_nowMs);
+        if (_forwarder.isConnected() && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+          _forwarder.onReadable(_nowMs);
+        }
+        // An ack or a drained socket makes room for more held records
+        pumpHeld();
+      } else if (tag == TAG_UNIX) {
+        accept(_unixFd, false);
+      } else if (tag == TAG_TCP) {
+        accept(_tcpFd, true);
+      } else if (_peers.count((uint32_t)tag)) {
+        onPeerReadable((uint32_t)tag);
+      }
+    }
+    updateSocketWatch();
+  }
+}
+
+void MergeService::accept(int listenFd, bool tcp) {
+  struct sockaddr_storage addr;
+  socklen_t length = sizeof(addr);
+  int fd;
+  while ((fd = accept4(listenFd, (struct sockaddr*)&addr, &length,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    if (_peers.size() >= MAX_GATEWAYS) {
+      fprintf(stderr, "merge: more than %zu gateways, refusing one\n", MAX_GATEWAYS);
+      close(fd);
+      continue;
+    }
+    std::unique_ptr<Peer> peer(new Peer());
+    peer->fd = fd;
+    char name[64];
+    if (tcp) {
+      char host[INET6_ADDRSTRLEN] = "?";
+      const void* ip = addr.ss_family == AF_INET6
+                           ? (const void*)&((struct sockaddr_in6*)&addr)->sin6_addr
+                           : (const void*)&((struct sockaddr_in*)&addr)->sin_addr;
+      inet_ntop(addr.ss_family, ip, host, sizeof(host));
+      snprintf(name, sizeof(name), "%s", host);
+    } else {
+      snprintf(name, sizeof(name), "local-%u", ++_localPeers);
+    }
+    peer->name = name;
+
+    uint32_t id = _nextPeer++;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = id;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    fprintf(stderr, "merge: gateway %s connected\n", name);
+    _peers[id] = std::move(peer);
+    _stats.connects++;
+    length = sizeof(addr);
+  }
+}
+
+void MergeService::onPeerReadable(uint32_t id) {
+  Peer& peer = *_peers[id];
+  for (;;) {
+    size_t overflows = peer.rx.overflows();
+    ssize_t n = peer.rx.fill(peer.fd);
+    _stats.overflows += peer.rx.overflows() - overflows;
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      closePeer(id);
+      return;
+    }
+    if (n < 0) return;
+
+    const char* line;
+    size_t length;
+    while (peer.rx.next(&line, &length)) {
+      peer.records++;
+      _merger.offer(id, peer.name, line, length, _nowMs);
+    }
+    // Alerts are emitted, and held, at once
+    pumpHeld();
+  }
+}
+
+void MergeService::closePeer(uint32_t id) {
+  Peer& peer = *_peers[id];
+  fprintf(stderr, "merge: gateway %s disconnected\n", peer.name.c_str());
+  close(peer.fd);
+  // Its unacked journal records come again when it reconnects
+  _merger.removePeer(id);
+  _peers.erase(id);
+}
+
+bool MergeService::sendLine(Peer& peer, const char* line, size_t length) {
+  // Requests are small and rare: one that does not fit is dropped, not queued
+  std::string text(line, length);
+  text.push_back('\n');
+  ssize_t n = send(peer.fd, text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (n == (ssize_t)text.size()) return true;
+  _stats.writeFailures++;
+  return false;
+}
+
+void MergeService::sendAcks() {
+  char ack[48];
+  for (auto& entry : _peers) {
+    Peer& peer = *entry.second;
+    uint64_t next;
+    if (!_merger.ackNext(entry.first, &next) || (peer.hasAcked && next == peer.acked)) continue;
+    int n = snprintf(ack, sizeof(ack), "{\"type\":\"ack\",\"next\":%llu}",
+                     (unsigned long long)next);
+    if (sendLine(peer, ack, (size_t)n)) {
+      peer.acked = next;
+      peer.hasAcked = true;
+    }
+  }
+}
+
+void MergeService::pumpHeld() {
+  if (!_forwarder.isConnected()) return;
+
+  // In offset order, and no faster than the socket drains
+  if (_sendOffset < _merger.heldBegin()) _sendOffset = _merger.heldBegin();
+  while (_sendOffset < _merger.heldEnd() &&
+         _forwarder.pendingBytes() < _options.maxPendingBytes / 2) {
+    const std::string* record = _merger.held(_sendOffset);
+    _forwarder.push(record->data(), record->size(), _nowMs);
+    _sendOffset++;
+  }
+}
+
+void MergeService::onDownlink(uint16_t address, const uint8_t* payload, size_t length) {
+  char hex[2 * wire::MAX_FRAME_BYTES + 1];
+  wire::hexEncode(payload, length, hex);
+  char request[2 * wire::MAX_FRAME_BYTES + 64];
+  int n = snprintf(request, sizeof(request),
+                   "{\"type\":\"downlink\",\"address\":%u,\"payload\":\"%s\"}", address, hex);
+
+  uint32_t id;
+  if (address != 0 && _merger.route(address, &id) && _peers.count(id)) {
+    _stats.downlinks++;
+    sendLine(*_peers[id], request, (size_t)n);
+    return;
+  }
+  // Broadcasts reach every gateway's coverage; so might an unknown device
+  _stats.broadcasts++;
+  for (auto& entry : _peers) {
+    _stats.downlinks++;
+    sendLine(*entry.second, request, (size_t)n);
+  }
+}
+
+void MergeService::onTick() {
+  _merger.expire(_nowMs);
+  pumpHeld();
+  _forwarder.service(_nowMs);
+  sendAcks();
+
+  if (_options.statsIntervalS > 0 && _nowMs >= _nextStatsMs) {
+    printStats();
+    _nextStatsMs = _nowMs + (uint64_t)_options.statsIntervalS * 1000ULL;
+  }
+}
+
+void MergeService::updateSocketWatch() {
+  int fd = _forwarder.fd();
+  bool wantWrite = _forwarder.wantsWrite();
+  if (fd == _watchedSocket && wantWrite == _watchingWrite) return;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | (wantWrite ? (uint32_t)EPOLLOUT : 0u);
+  ev.data.u64 = TAG_SOCKET;
+  if (fd != _watchedSocket) {
+    // A closed descriptor has already left the epoll set
+    if (_watchedSocket >= 0) epoll_ctl(_epoll, EPOLL_CTL_DEL, _watchedSocket, nullptr);
+    if (fd >= 0) epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+  } else {
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev);
+  }
+  _watchedSocket = fd;
+  _watchingWrite = wantWrite;
+}
+
+void MergeService::printStats() {
+  const FrameMergerStats& merge = _merger.stats();
+  const ForwarderStats& fwd = _forwarder.stats();
+  fprintf(stderr,
+          "stats: gateways %zu (connects %llu) | copies %llu, forwarded %llu, merged %llu, "
+          "late %llu, malformed %llu, too long %llu, waiting %zu, unacked %llu | forwarded %llu in %llu "
+          "batches, dropped %llu, pending %zu B, %s | downlinks %llu (broadcast %llu, "
+          "failed %llu)\n",
+          _peers.size(), (unsigned long long)_stats.connects, (unsigned long long)merge.copies,
+          (unsigned long long)merge.emitted, (unsigned long long)merge.merged,
+          (unsigned long long)merge.late, (unsigned long long)merge.malformed,
+          (unsigned long long)_stats.overflows, _merger.pending(),
+          (unsigned long long)(_merger.heldEnd() - _merger.heldBegin()),
+          (unsigned long long)fwd.records, (unsigned long long)fwd.batches,
+          (unsigned long long)fwd.dropped, _forwarder.pendingBytes(),
+          _forwarder.isConnected() ? "connected" : "disconnected",
+          (unsigned long long)_stats.downlinks, (unsigned long long)_stats.broadcasts,
+          (unsigned long long)_stats.writeFailures);
+  for (const auto& entry : _peers) {
+    fprintf(stderr, "stats: gateway %s records %llu, acked to %llu\n",
+            entry.second->name.c_str(), (unsigned long long)entry.second->records,
+            (unsigned long long)entry.second->acked);
+  }
+}
+
+} // namespace gw
@@ -0,0 +1,490 @@
+/**
+ * Nullifier Set Implementation
+ */
+
+#include "nullifier_set.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+const char TABLE_MAGIC[8] = {'E', 'C', 'N', 'U', 'L', '0', '0', '1'};
+const size_t NK = NullifierSet::KEY_SIZE;
+
+// Table layout (little-endian):
+//   0 magic, 8 epoch u32, 12 part u32, 16 count u64, 24 log2 Bloom blocks u32,
+//   28 log2 buckets u32, 64 Bloom blocks (64 bytes each), directory (first key
+//   of each bucket and the end, u32), padded to 8 bytes, then the keys
+//   ordered by hash
+const size_t TABLE_HEADER_SIZE = 64;
+const size_t BLOCK_SIZE = 64;
+const unsigned MAX_BITS = 32;
+
+size_t directorySize(unsigned bucketBits) { return (((size_t)4 << bucketBits) + 4 + 7) & ~(size_t)7; }
+
+void putU32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+void putU64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint64_t getU64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Two hashes for double hashing. The nullifier is already uniform but the
+// same for all of a device's readings in an epoch: the timestamp is mixed in
+void keyHashes(const uint8_t* key, uint64_t* h1, uint64_t* h2) {
+  uint64_t timestamp = getU32(key);
+  *h1 = mix(getU64(key + 4) ^ timestamp);
+  *h2 = mix(getU64(key + 12) + timestamp) | 1;
+}
+
+// Bucket or block: the top bits of the hash
+uint64_t topBits(uint64_t h, unsigned bits) { return bits ? h >> (64 - bits) : 0; }
+
+// All probes of a key fall in one block: 9 bits of h2 each
+bool blockHas(const uint8_t* block, uint64_t h2) {
+  for (size_t i = 0; i < NullifierSet::BLOOM_HASHES; i++) {
+    unsigned bit = (unsigned)(h2 >> (9 * i)) & 511;
+    if (!(block[bit >> 3] & (1 << (bit & 7)))) return false;
+  }
+  return true;
+}
+
+void blockAdd(uint8_t* block, uint64_t h2) {
+  for (size_t i = 0; i < NullifierSet::BLOOM_HASHES; i++) {
+    unsigned bit = (unsigned)(h2 >> (9 * i)) & 511;
+    block[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+  }
+}
+
+unsigned bitsFor(uint64_t count) {
+  unsigned bits = 0;
+  while (bits < MAX_BITS && (1ULL << bits) < count) bits++;
+  return bits;
+}
+
+bool parseName(const char* name, const char* suffix, uint32_t* epoch, uint32_t* part) {
+  unsigned e, p;
+  char tail[8];
+  return sscanf(name, "nul-%8x-%4x.%3s", &e, &p, tail) == 3 && strcmp(tail, suffix) == 0 &&
+         (*epoch = e, *part = p, true);
+}
+
+} // namespace
+
+size_t NullifierSet::KeyHash::operator()(const Key& key) const {
+  uint64_t h1, h2;
+  keyHashes(key.data(), &h1, &h2);
+  return (size_t)h1;
+}
+
+NullifierSet::Table::~Table() {
+  if (map) munmap(map, bytes);
+  if (fd >= 0) close(fd);
+}
+
+const uint8_t* NullifierSet::Table::block(uint64_t h1) const {
+  return bloom + topBits(h1, blockBits) * BLOCK_SIZE;
+}
+
+bool NullifierSet::Table::contains(const uint8_t* key, uint64_t h1, uint64_t h2,
+                                   NullifierSetStats& stats) const {
+  if (!blockHas(block(h1), h2)) return false;
+  stats.bloomHits++;
+  const uint8_t* bucket = directory + 4 * topBits(h1, bucketBits);
+  for (uint32_t i = getU32(bucket), end = getU32(bucket + 4); i < end; i++) {
+    if (memcmp(keys + (size_t)i * NK, key, NK) == 0) return true;
+  }
+  stats.falsePositives++;
+  return false;
+}
+
+NullifierSet::~NullifierSet() {
+  writeLog();
+  drain();
+  if (_logFd >= 0) close(_logFd);
+}
+
+bool NullifierSet::open(const std::string& dir, uint32_t retainEpochs, size_t partitionEntries) {
+  _dir = dir;
+  _retainEpochs = retainEpochs ? retainEpochs : 1;
+  _partitionEntries = partitionEntries ? partitionEntries : 1;
+
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(dir.c_str());
+    return false;
+  }
+  DIR* listing = opendir(dir.c_str());
+  if (!listing) {
+    perror(dir.c_str());
+    return false;
+  }
+  std::vector<std::pair<uint32_t, uint32_t>> tables, logs;
+  while (struct dirent* entry = readdir(listing)) {
+    uint32_t epoch, part;
+    if (parseName(entry->d_name, "tbl", &epoch, &part)) tables.emplace_back(epoch, part);
+    if (parseName(entry->d_name, "log", &epoch, &part)) logs.emplace_back(epoch, part);
+  }
+  closedir(listing);
+  std::sort(tables.begin(), tables.end());
+  std::sort(logs.begin(), logs.end());
+
+  for (const auto& t : tables) {
+    std::shared_ptr<Table> table = openTable(partitionPath(t.first, t.second, "tbl"));
+    if (!table) return false;
+    _tables.push_back(table);
+    if (t.first > _epoch) _epoch = t.first;
+  }
+
+  // Logs left by a crash: sealed now if their table is missing, the newest
+  // becomes the live partition again
+  bool resumed = false;
+  for (size_t i = 0; i < logs.size(); i++) {
+    std::string path = partitionPath(logs[i].first, logs[i].second, "log");
+    if (std::binary_search(tables.begin(), tables.end(), logs[i])) {
+      unlink(path.c_str());
+      continue;
+    }
+    if (i + 1 == logs.size() && logs[i].first >= _epoch) {
+      if (!loadLog(path, &_live)) return false;
+      _epoch = logs[i].first;
+      _part = logs[i].second;
+      resumed = true;
+      break;
+    }
+    KeySet keys;
+    std::string table = partitionPath(logs[i].first, logs[i].second, "tbl");
+    if (!loadLog(path, &keys) || !writeTable(keys, logs[i].first, logs[i].second, table)) {
+      return false;
+    }
+    std::shared_ptr<Table> opened = openTable(table);
+    if (!opened) return false;
+    _tables.push_back(opened);
+    unlink(path.c_str());
+    if (logs[i].first > _epoch) _epoch = logs[i].first;
+  }
+
+  if (!resumed) _part = nextPart(_epoch);
+  if (!openLog()) return false;
+  expire();
+  return true;
+}
+
+std::string NullifierSet::partitionPath(uint32_t epoch, uint32_t part, const char* suffix) const {
+  char name[32];
+  snprintf(name, sizeof(name), "nul-%08x-%04x.%s", epoch, part, suffix);
+  return _dir + "/" + name;
+}
+
+uint32_t NullifierSet::nextPart(uint32_t epoch) const {
+  uint32_t part = 0;
+  for (const auto& table : _tables) {
+    if (table->epoch == epoch && table->part >= part) part = table->part + 1;
+  }
+  return part;
+}
+
+std::shared_ptr<NullifierSet::Table> NullifierSet::openTable(const std::string& path) {
+  std::shared_ptr<Table> table = std::make_shared<Table>();
+  table->path = path;
+  table->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (table->fd < 0 || fstat(table->fd, &st) != 0) {
+    perror(path.c_str());
+    return nullptr;
+  }
+  table->bytes = (size_t)st.st_size;
+  void* map = table->bytes >= TABLE_HEADER_SIZE
+                  ? mmap(nullptr, table->bytes, PROT_READ, MAP_SHARED, table->fd, 0)
+                  : MAP_FAILED;
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "%s: not a nullifier table\n", path.c_str());
+    return nullptr;
+  }
+  table->map = (uint8_t*)map;
+
+  const uint8_t* h = table->map;
+  table->epoch = getU32(h + 8);
+  table->part = getU32(h + 12);
+  table->count = getU64(h + 16);
+  table->blockBits = getU32(h + 24);
+  table->bucketBits = getU32(h + 28);
+  if (memcmp(h, TABLE_MAGIC, 8) != 0 || table->blockBits > MAX_BITS ||
+      table->bucketBits > MAX_BITS ||
+      TABLE_HEADER_SIZE + (BLOCK_SIZE << table->blockBits) + directorySize(table->bucketBits) +
+              table->count * NK != table->bytes) {
+    fprintf(stderr, "%s: not a nullifier table\n", path.c_str());
+    return nullptr;
+  }
+  table->bloom = h + TABLE_HEADER_SIZE;
+  table->directory = table->bloom + (BLOCK_SIZE << table->blockBits);
+  table->keys = table->directory + directorySize(table->bucketBits);
+  // Lookups land anywhere in it
+  madvise(table->map, table->bytes, MADV_RANDOM);
+  return table;
+}
+
+bool NullifierSet::writeTable(const KeySet& keys, uint32_t epoch, uint32_t part,
+                              const std::string& path) {
+  struct Entry {
+    uint64_t h1;
+    Key key;
+    bool operator<(const Entry& other) const {
+      return h1 != other.h1 ? h1 < other.h1 : key < other.key;
+    }
+  };
+  std::vector<Entry> entries;
+  entries.reserve(keys.size());
+  for (const Key& key : keys) {
+    uint64_t h1, h2;
+    keyHashes(key.data(), &h1, &h2);
+    entries.push_back(Entry{h1, key});
+  }
+  std::sort(entries.begin(), entries.end());
+
+  size_t count = entries.size();
+  unsigned blockBits = bitsFor((count * BLOOM_BITS_PER_KEY + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8));
+  unsigned bucketBits = bitsFor(count / BUCKET_KEYS);
+  std::vector<uint8_t> head(TABLE_HEADER_SIZE + (BLOCK_SIZE << blockBits) +
+                            directorySize(bucketBits), 0);
+  memcpy(head.data(), TABLE_MAGIC, 8);
+  putU32(head.data() + 8, epoch);
+  putU32(head.data() + 12, part);
+  putU64(head.data() + 16, count);
+  putU32(head.data() + 24, blockBits);
+  putU32(head.data() + 28, bucketBits);
+  uint8_t* bloom = head.data() + TABLE_HEADER_SIZE;
+  uint8_t* directory = bloom + (BLOCK_SIZE << blockBits);
+  size_t next = 0;
+  for (uint64_t bucket = 0; bucket <= (1ULL << bucketBits); bucket++) {
+    while (next < count && topBits(entries[next].h1, bucketBits) < bucket) next++;
+    putU32(directory + 4 * bucket, (uint32_t)next);
+  }
+  std::vector<Key> sorted;
+  sorted.reserve(count);
+  for (const Entry& entry : entries) {
+    uint64_t h1, h2;
+    keyHashes(entry.key.data(), &h1, &h2);
+    blockAdd(bloom + topBits(h1, blockBits) * BLOCK_SIZE, h2);
+    sorted.push_back(entry.key);
+  }
+
+  // Written aside and renamed, so a table that exists is whole
+  std::string temp = path + ".tmp";
+  int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror(temp.c_str());
+    return false;
+  }
+  bool ok = write(fd, head.data(), head.size()) == (ssize_t)head.size();
+  // Key is a plain byte array: the vector is the key section as it is on disk
+  static_assert(sizeof(Key) == NK, "keys are packed");
+  size_t keyBytes = sorted.size() * NK;
+  const uint8_t* data = sorted.empty() ? nullptr : sorted[0].data();
+  for (size_t done = 0; ok && done < keyBytes;) {
+    ssize_t n = write(fd, data + done, keyBytes - done);
+    ok = n > 0;
+    if (ok) done += (size_t)n;
+  }
+  ok = ok && fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    perror(path.c_str());
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool NullifierSet::openLog() {
+  if (_logFd >= 0) close(_logFd);
+  std::string path = partitionPath(_epoch, _part, "log");
+  _logFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (_logFd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool NullifierSet::loadLog(const std::string& path, KeySet* keys) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  // A key cut short by a crash is ignored
+  Key key;
+  while (read(fd, key.data(), NK) == (ssize_t)NK) keys->insert(key);
+  close(fd);
+  return true;
+}
+
+void NullifierSet::writeLog() {
+  for (size_t done = 0; done < _logBuffer.size();) {
+    ssize_t n = write(_logFd, _logBuffer.data() + done, _logBuffer.size() - done);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      perror("nullifier log");
+      break;
+    }
+    done += (size_t)n;
+  }
+  _logBuffer.clear();
+}
+
+bool NullifierSet::contains(const uint8_t* key) {
+  Key k;
+  memcpy(k.data(), key, NK);
+  if (_live.count(k)) return true;
+  for (const auto& seal : _seals) {
+    if (seal->keys.count(k)) return true;
+  }
+
+  uint64_t h1, h2;
+  keyHashes(key, &h1, &h2);
+  // One cache line per table: let the misses overlap
+  for (const auto& table : _tables) __builtin_prefetch(table->block(h1));
+  // Newest first: repeats are mostly recent
+  for (auto it = _tables.rbegin(); it != _tables.rend(); ++it) {
+    if ((*it)->contains(key, h1, h2, _stats)) return true;
+  }
+  return false;
+}
+
+bool NullifierSet::insert(const uint8_t* key) {
+  if (contains(key)) {
+    _stats.repeats++;
+    return false;
+  }
+  add(key);
+  return true;
+}
+
+void NullifierSet::add(const uint8_t* key) {
+  Key k;
+  memcpy(k.data(), key, NK);
+  _live.insert(k);
+  _logBuffer.insert(_logBuffer.end(), key, key + NK);
+  _stats.inserted++;
+  if (_live.size() >= _partitionEntries) rotate(_epoch);
+}
+
+void NullifierSet::setEpoch(uint32_t epoch) {
+  if (epoch == _epoch) return;
+  rotate(epoch);
+  expire();
+}
+
+void NullifierSet::rotate(uint32_t epoch) {
+  seal();
+  // The partition just sealed may not be a table yet
+  _part = epoch == _epoch ? _part + 1 : nextPart(epoch);
+  _epoch = epoch;
+  openLog();
+}
+
+void NullifierSet::seal() {
+  writeLog();
+  std::string log = partitionPath(_epoch, _part, "log");
+  if (_live.empty()) {
+    unlink(log.c_str());
+    return;
+  }
+  // Only a sealer that cannot keep up holds the loop back
+  if (_seals.size() >= SEALS_MAX) {
+    finishSeal(*_seals.front());
+    _seals.pop_front();
+  }
+
+  std::unique_ptr<Seal> seal(new Seal());
+  seal->keys.swap(_live);
+  seal->log = log;
+  seal->path = partitionPath(_epoch, _part, "tbl");
+  Seal* s = seal.get();
+  uint32_t epoch = _epoch, part = _part;
+  s->thread = std::thread([s, epoch, part] {
+    s->ok = writeTable(s->keys, epoch, part, s->path);
+    s->done = true;
+  });
+  _seals.push_back(std::move(seal));
+}
+
+void NullifierSet::finishSeal(Seal& seal) {
+  seal.thread.join();
+  std::shared_ptr<Table> table = seal.ok ? openTable(seal.path) : nullptr;
+  if (table) {
+    _tables.push_back(table);
+    unlink(seal.log.c_str());
+    _stats.sealed++;
+  } else {
+    // The log stays and is sealed on the next open; until then its keys
+    // are not checked
+    fprintf(stderr, "nullifiers: sealing %s failed\n", seal.log.c_str());
+  }
+}
+
+void NullifierSet::finishSeals(bool wait) {
+  size_t before = _seals.size();
+  for (auto it = _seals.begin(); it != _seals.end();) {
+    if (!wait && !(*it)->done) {
+      ++it;
+      continue;
+    }
+    finishSeal(**it);
+    it = _seals.erase(it);
+  }
+  if (_seals.size() != before) expire();
+}
+
+void NullifierSet::flush() {
+  writeLog();
+  finishSeals(false);
+}
+
+void NullifierSet::drain() {
+  finishSeals(true);
+}
+
+void NullifierSet::expire() {
+  auto old = [this](const std::shared_ptr<Table>& table) {
+    return table->epoch < _epoch && _epoch - table->epoch >= _retainEpochs;
+  };
+  for (const auto& table : _tables) {
+    if (!old(table)) continue;
+    unlink(table->path.c_str());
+    _stats.expired++;
+  }
+  _tables.erase(std::remove_if(_tables.begin(), _tables.end(), old), _tables.end());
+}
+
+NullifierSetStats NullifierSet::stats() const {
+  NullifierSetStats stats = _stats;
+  stats.tables = _tables.size();
+  for (const auto& table : _tables) stats.tableKeys += table->count;
+  stats.liveKeys = _live.size();
+  for (const auto& seal : _seals) stats.liveKeys += seal->keys.size();
+  return stats;
+}
+
+} // namespace gw
@@ -0,0 +1,110 @@
+/**
+ * OTA Campaign Implementation
+ */
+
+#include "ota_campaign.h"
+#include <stdio.h>
+
+namespace gw {
+
+namespace {
+
+const char* stateName(ota::State state) {
+  switch (state) {
+    case ota::State::Idle: return "idle";
+    case ota::State::Receiving: return "receiving";
+    case ota::State::Applied: return "applied";
+    case ota::State::WrongBase: return "wrong base image";
+    case ota::State::BadSignature: return "bad signature";
+    case ota::State::Failed: return "failed";
+    case ota::State::UpToDate: return "up to date";
+  }
+  return "?";
+}
+
+} // namespace
+
+bool OtaCampaign::load(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  uint8_t buffer[65536];
+  size_t n;
+  _file.clear();
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) _file.insert(_file.end(), buffer, buffer + n);
+  fclose(f);
+
+  if (!ota::parseCampaign(_file.data(), _file.size(), &_offer, &_patch)) {
+    fprintf(stderr, "%s: not an OTA campaign file\n", path);
+    return false;
+  }
+  return true;
+}
+
+void OtaCampaign::onHeard(uint16_t address, uint64_t nowMs, const Send& send) {
+  Device& device = _devices[address];
+  switch (device.state) {
+    case ota::State::Applied:
+    case ota::State::UpToDate:
+    case ota::State::WrongBase:
+    case ota::State::BadSignature:
+      return;
+    default:
+      break;
+  }
+  if (device.offered && nowMs - device.offeredMs < OFFER_INTERVAL_MS) return;
+
+  uint8_t frame[ota::OFFER_SIZE];
+  ota::encodeOffer(_offer, frame);
+  send(address, frame, sizeof(frame));
+  device.offered = true;
+  device.offeredMs = nowMs;
+  _stats.offers++;
+}
+
+void OtaCampaign::onStatus(uint16_t address, const uint8_t* message, size_t length,
+                           uint64_t nowMs, const Send& send) {
+  ota::Status status;
+  if (!ota::parseStatus(message, length, &status) || status.session != _offer.session) return;
+  _stats.statuses++;
+
+  Device& device = _devices[address];
+  if (status.state != device.state) {
+    fprintf(stderr, "ota: device %u %s (%u/%u chunks)\n", address, stateName(status.state),
+            status.received, _offer.chunkCount);
+    if (status.state == ota::State::Applied) _stats.updated++;
+    if (status.state == ota::State::UpToDate) _stats.upToDate++;
+    if (status.state == ota::State::WrongBase || status.state == ota::State::BadSignature ||
+        status.state == ota::State::Failed) {
+      _stats.rejected++;
+    }
+  }
+  device.state = status.state;
+  if (status.state != ota::State::Receiving) return;
+
+  // The device reported, so it is listening: no offer needed for a while
+  device.offered = true;
+  device.offeredMs = nowMs;
+
+  uint8_t frame[ota::CHUNK_HEADER_SIZE + ota::CHUNK_DATA_MAX];
+  size_t sent = 0;
+  for (size_t k = 0; k < ota::STATUS_WINDOW && sent < CHUNKS_PER_STATUS; k++) {
+    size_t index = (size_t)status.windowBase + k;
+    if (index >= _offer.chunkCount) break;
+    if (status.bitmap[k / 8] & (1 << (k % 8))) continue;
+
+    size_t offset = index * ota::CHUNK_DATA_MAX;
+    size_t chunkLen = _offer.patchLength - offset < ota::CHUNK_DATA_MAX
+                          ? _offer.patchLength - offset
+                          : ota::CHUNK_DATA_MAX;
+    size_t frameLen = ota::encodeChunk(_offer.session, (uint16_t)index, _patch + offset,
+                                       chunkLen, frame);
+    send(address, frame, frameLen);
+    sent++;
+  }
+  _stats.chunks += sent;
+}
+
+} // namespace gw
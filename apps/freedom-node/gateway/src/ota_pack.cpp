@@ -0,0 +1,179 @@
+/**
+ * OTA Campaign Packer
+ *
+ * Builds the file the gateway sends with --ota-campaign: the signed offer
+ * and the compressed delta from the image the devices run to the new one.
+ * The patch is applied back with the firmware's own decoder before the
+ * file is written.
+ *
+ * Usage: edgechain-ota-pack --base OLD.bin --target NEW.bin --key RELEASE.pem
+ *          --out CAMPAIGN
+ */
+
+#include "delta_encoder.h"
+#include "ota_protocol.h"
+#include "signing_key.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <openssl/sha.h>
+
+namespace {
+
+void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s --base OLD.bin --target NEW.bin --key RELEASE.pem --out CAMPAIGN\n",
+          program);
+}
+
+bool readFile(const char* path, std::vector<uint8_t>* data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  uint8_t buffer[65536];
+  size_t n;
+  data->clear();
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data->insert(data->end(), buffer, buffer + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+class VectorImage : public ota::ImageReader {
+public:
+  explicit VectorImage(const std::vector<uint8_t>& image) : _image(image) {}
+  bool read(size_t offset, uint8_t* data, size_t length) override {
+    if (offset > _image.size() || length > _image.size() - offset) return false;
+    memcpy(data, _image.data() + offset, length);
+    return true;
+  }
+
+private:
+  const std::vector<uint8_t>& _image;
+};
+
+// Decode and apply in device-sized pieces, as OtaClient does
+bool selfCheck(const std::vector<uint8_t>& base, const std::vector<uint8_t>& target,
+               const std::vector<uint8_t>& patch) {
+  VectorImage reader(base);
+  ota::LzssDecoder decoder;
+  ota::PatchApplier applier;
+  applier.begin(&reader, base.size(), target.size());
+
+  std::vector<uint8_t> result;
+  uint8_t decoded[256];
+  uint8_t out[256];
+  for (size_t pos = 0; pos < patch.size();) {
+    size_t consumed;
+    size_t n = patch.size() - pos < ota::CHUNK_DATA_MAX ? patch.size() - pos : ota::CHUNK_DATA_MAX;
+    size_t d = decoder.decode(&patch[pos], n, &consumed, decoded, sizeof(decoded));
+    pos += consumed;
+    size_t o = applier.feed(decoded, d, out);
+    result.insert(result.end(), out, out + o);
+    if (applier.failed()) return false;
+  }
+  size_t consumed;
+  for (size_t d; (d = decoder.decode(decoded, 0, &consumed, decoded, sizeof(decoded))) > 0;) {
+    size_t o = applier.feed(decoded, d, out);
+    result.insert(result.end(), out, out + o);
+  }
+  return applier.done() && result == target;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* basePath = nullptr;
+  const char* targetPath = nullptr;
+  const char* keyPath = nullptr;
+  const char* outPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    }
+    if (strcmp(arg, "--base") == 0) {
+      basePath = value;
+    } else if (strcmp(arg, "--target") == 0) {
+      targetPath = value;
+    } else if (strcmp(arg, "--key") == 0) {
+      keyPath = value;
+    } else if (strcmp(arg, "--out") == 0) {
+      outPath = value;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+  if (!basePath || !targetPath || !outPath || !keyPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> base, target;
+  if (!readFile(basePath, &base) || !readFile(targetPath, &target)) return 1;
+  if (target.empty()) {
+    fprintf(stderr, "%s: empty image\n", targetPath);
+    return 1;
+  }
+
+  std::vector<uint8_t> delta = gw::encodeDelta(base, target);
+  std::vector<uint8_t> patch = gw::compressLzss(delta);
+  size_t chunks = ota::chunkCount(patch.size());
+  if (chunks == 0) {
+    fprintf(stderr, "patch of %zu bytes exceeds %zu chunks\n", patch.size(),
+            ota::CHUNK_COUNT_MAX);
+    return 1;
+  }
+  if (!selfCheck(base, target, patch)) {
+    fprintf(stderr, "internal error: patch does not reproduce the target\n");
+    return 1;
+  }
+
+  ota::Offer offer;
+  uint8_t baseHash[32];
+  SHA256(base.data(), base.size(), baseHash);
+  SHA256(target.data(), target.size(), offer.targetHash);
+  memcpy(offer.baseHash, baseHash, ota::HASH_PREFIX_SIZE);
+  offer.session = (uint16_t)(offer.targetHash[0] | offer.targetHash[1] << 8);
+  offer.targetLength = (uint32_t)target.size();
+  offer.patchLength = (uint32_t)patch.size();
+  offer.chunkCount = (uint16_t)chunks;
+
+  std::unique_ptr<gw::SigningKey> key = gw::SigningKey::load(keyPath);
+  if (!key) return 1;
+  uint8_t message[ota::RELEASE_SIGNED_SIZE];
+  ota::releaseMessage(offer, message);
+  if (!key->sign(message, sizeof(message), offer.signature)) {
+    fprintf(stderr, "signing failed\n");
+    return 1;
+  }
+
+  uint8_t encoded[ota::OFFER_SIZE];
+  ota::encodeOffer(offer, encoded);
+  FILE* f = fopen(outPath, "wb");
+  if (!f) {
+    perror(outPath);
+    return 1;
+  }
+  bool written = fwrite(ota::CAMPAIGN_MAGIC, sizeof(ota::CAMPAIGN_MAGIC), 1, f) == 1 &&
+                 fwrite(encoded, sizeof(encoded), 1, f) == 1 &&
+                 fwrite(patch.data(), patch.size(), 1, f) == 1;
+  if (fclose(f) != 0 || !written) {
+    perror(outPath);
+    return 1;
+  }
+
+  printf("base %zu B, target %zu B | delta %zu B, compressed %zu B (%.1f%% of target) | "
+         "%zu chunks | session %04x\n",
+         base.size(), target.size(), delta.size(), patch.size(),
+         100.0 * patch.size() / target.size(), chunks, offer.session);
+  return 0;
+}
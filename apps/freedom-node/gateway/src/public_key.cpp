@@ -0,0 +1,62 @@
+/**
+ * Public Key Implementation
+ *
+ * Same OpenSSL EC_KEY calls as the simulator's secure element
+ * (firmware/esp32-ndani/src/sim/secure_element_sim.cpp).
+ */
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "public_key.h"
+#include <string.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/sha.h>
+
+namespace gw {
+
+namespace {
+
+const EC_GROUP* p256() {
+  static EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+  return group;
+}
+
+} // namespace
+
+std::shared_ptr<const PublicKey> PublicKey::parse(const uint8_t raw[64]) {
+  uint8_t encoded[65];
+  encoded[0] = 0x04;
+  memcpy(encoded + 1, raw, 64);
+
+  EC_KEY* key = EC_KEY_new();
+  EC_KEY_set_group(key, p256());
+  EC_POINT* point = EC_POINT_new(p256());
+  bool ok = EC_POINT_oct2point(p256(), point, encoded, sizeof(encoded), nullptr) == 1 &&
+            EC_KEY_set_public_key(key, point) == 1 && EC_KEY_check_key(key) == 1;
+  EC_POINT_free(point);
+  if (!ok) {
+    EC_KEY_free(key);
+    return nullptr;
+  }
+  return std::shared_ptr<const PublicKey>(new PublicKey(key));
+}
+
+PublicKey::~PublicKey() {
+  EC_KEY_free(_key);
+}
+
+bool PublicKey::verify(const uint8_t* data, size_t length, const uint8_t signature[64]) const {
+  uint8_t hash[32];
+  SHA256(data, length, hash);
+
+  ECDSA_SIG* sig = ECDSA_SIG_new();
+  ECDSA_SIG_set0(sig, BN_bin2bn(signature, 32, nullptr), BN_bin2bn(signature + 32, 32, nullptr));
+  bool valid = ECDSA_do_verify(hash, 32, sig, _key) == 1;
+  ECDSA_SIG_free(sig);
+  return valid;
+}
+
+} // namespace gw
@@ -0,0 +1,183 @@
+/**
+ * RYLR896 Port Implementation
+ */
+
+#include "rylr_port.h"
+#include "serial_port.h"
+#include "time_sync.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+// RYLR896 bandwidth codes: 7=125kHz, 8=250kHz, 9=500kHz
+int bandwidthCode(uint16_t kHz) {
+  switch (kHz) {
+    case 250: return 8;
+    case 500: return 9;
+    default: return 7;
+  }
+}
+
+bool startsWith(const char* line, size_t length, const char* prefix) {
+  size_t n = strlen(prefix);
+  return length >= n && memcmp(line, prefix, n) == 0;
+}
+
+uint64_t wallClockMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+} // namespace
+
+RylrPort::~RylrPort() {
+  close();
+}
+
+bool RylrPort::open(uint32_t baud) {
+  _fd = openSerial(_path.c_str(), baud);
+  if (_fd < 0) {
+    fprintf(stderr, "%s: open failed: %s\n", _path.c_str(), strerror(errno));
+    return false;
+  }
+  _rx.clear();
+  return true;
+}
+
+void RylrPort::close() {
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+  _txQueue.clear();
+  _awaitingReply = false;
+}
+
+void RylrPort::configure(const RadioConfig& config, uint64_t nowMs) {
+  char command[64];
+  snprintf(command, sizeof(command), "AT+NETWORKID=%u", config.networkId);
+  enqueue({command}, nowMs);
+  snprintf(command, sizeof(command), "AT+ADDRESS=%u", config.address);
+  enqueue({command}, nowMs);
+  snprintf(command, sizeof(command), "AT+BAND=%u", config.frequency);
+  enqueue({command}, nowMs);
+  snprintf(command, sizeof(command), "AT+PARAMETER=%u,%d,1,12", config.spreadingFactor,
+           bandwidthCode(config.bandwidthKHz));
+  enqueue({command}, nowMs);
+  snprintf(command, sizeof(command), "AT+CRFOP=%u", config.txPower);
+  enqueue({command}, nowMs);
+}
+
+bool RylrPort::send(uint16_t address, const uint8_t* data, size_t length, uint64_t nowMs) {
+  if (length == 0 || length > wire::MAX_FRAME_BYTES) return false;
+  if (_fd < 0 || _txQueue.size() >= TX_QUEUE_MAX) {
+    _stats.commandsDropped++;
+    return false;
+  }
+  char command[32 + 2 * wire::MAX_FRAME_BYTES];
+  size_t n = wire::formatSend(command, sizeof(command), address, data, length);
+  if (n == 0) return false;
+  enqueue({std::string(command, n)}, nowMs);
+  return true;
+}
+
+bool RylrPort::sendTime(uint16_t address, uint64_t nowMs) {
+  if (_fd < 0 || _txQueue.size() >= TX_QUEUE_MAX) {
+    _stats.commandsDropped++;
+    return false;
+  }
+  Command command;
+  command.timeAddress = address;
+  enqueue(std::move(command), nowMs);
+  return true;
+}
+
+void RylrPort::enqueue(Command command, uint64_t nowMs) {
+  _txQueue.push_back(std::move(command));
+  if (!_awaitingReply) startNext(nowMs);
+}
+
+void RylrPort::startNext(uint64_t nowMs) {
+  _awaitingReply = false;
+  if (_txQueue.empty() || _fd < 0) return;
+
+  Command& front = _txQueue.front();
+  if (front.timeAddress >= 0) {
+    uint8_t beacon[tsync::BEACON_SIZE];
+    tsync::encodeBeacon(wallClockMs(), beacon);
+    char text[32 + 2 * tsync::BEACON_SIZE];
+    size_t n = wire::formatSend(text, sizeof(text), (uint16_t)front.timeAddress, beacon,
+                                sizeof(beacon));
+    front.text.assign(text, n);
+  }
+
+  // Commands are short; the UART FIFO takes them in one write
+  std::string& command = front.text;
+  command += "\r\n";
+  ssize_t n = write(_fd, command.data(), command.size());
+  command.resize(command.size() - 2);
+  if (n != (ssize_t)command.size() + 2) {
+    fprintf(stderr, "%s: write failed: %s\n", _path.c_str(),
+            n < 0 ? strerror(errno) : "short write");
+    _stats.commandsFailed++;
+    _txQueue.pop_front();
+    return;
+  }
+  _awaitingReply = true;
+  _replyDeadlineMs = nowMs + COMMAND_TIMEOUT_MS;
+}
+
+bool RylrPort::onReadable(uint64_t nowMs) {
+  for (;;) {
+    ssize_t n = _rx.fill(_fd);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+
+    const char* line;
+    size_t length;
+    while (_rx.next(&line, &length)) handleLine(line, length, nowMs);
+  }
+}
+
+void RylrPort::handleLine(const char* line, size_t length, uint64_t nowMs) {
+  if (startsWith(line, length, "+RCV=")) {
+    wire::RcvFrame frame;
+    if (!wire::parseRcv(line, length, &frame)) {
+      _stats.badLines++;
+      return;
+    }
+    _stats.frames++;
+    if (_handler) _handler(*this, frame);
+    return;
+  }
+
+  bool ok = startsWith(line, length, "+OK");
+  bool err = startsWith(line, length, "+ERR");
+  if (!_awaitingReply || (!ok && !err)) return;   // +READY and other chatter
+
+  if (ok) {
+    _stats.commandsOk++;
+  } else {
+    _stats.commandsFailed++;
+    fprintf(stderr, "%s: %s -> %.*s\n", _path.c_str(), _txQueue.front().text.c_str(),
+            (int)length, line);
+  }
+  _txQueue.pop_front();
+  startNext(nowMs);
+}
+
+void RylrPort::poll(uint64_t nowMs) {
+  if (!_awaitingReply || nowMs < _replyDeadlineMs) return;
+
+  fprintf(stderr, "%s: no reply to %s\n", _path.c_str(), _txQueue.front().text.c_str());
+  _stats.commandsFailed++;
+  _txQueue.pop_front();
+  startNext(nowMs);
+}
+
+} // namespace gw
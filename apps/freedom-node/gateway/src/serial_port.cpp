@@ -0,0 +1,69 @@
+/**
+ * Serial Port Implementation
+ */
+
+#include "serial_port.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace gw {
+
+namespace {
+
+speed_t baudConstant(uint32_t baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+  }
+}
+
+} // namespace
+
+int openSerial(const char* path, uint32_t baud) {
+  speed_t speed = baudConstant(baud);
+  if (speed == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) return -1;
+
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    // Not a tty (a pipe or file in testing): use as is
+    if (errno == ENOTTY || errno == EINVAL) return fd;
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+  }
+
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  // VMIN 1 so an idle non-blocking read gives EAGAIN; 0 is reserved for hangup
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+} // namespace gw
@@ -0,0 +1,51 @@
+/**
+ * Signing Key Implementation
+ */
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "signing_key.h"
+#include <stdio.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+
+namespace gw {
+
+std::unique_ptr<SigningKey> SigningKey::load(const char* pemPath) {
+  FILE* f = fopen(pemPath, "r");
+  if (!f) {
+    perror(pemPath);
+    return nullptr;
+  }
+  EC_KEY* key = PEM_read_ECPrivateKey(f, nullptr, nullptr, nullptr);
+  fclose(f);
+  if (!key || EC_GROUP_get_curve_name(EC_KEY_get0_group(key)) != NID_X9_62_prime256v1) {
+    fprintf(stderr, "%s: not a P-256 private key\n", pemPath);
+    EC_KEY_free(key);
+    return nullptr;
+  }
+  return std::unique_ptr<SigningKey>(new SigningKey(key));
+}
+
+SigningKey::~SigningKey() {
+  EC_KEY_free(_key);
+}
+
+bool SigningKey::sign(const uint8_t* data, size_t length, uint8_t signature[64]) const {
+  uint8_t hash[32];
+  SHA256(data, length, hash);
+  ECDSA_SIG* sig = ECDSA_do_sign(hash, sizeof(hash), _key);
+  if (!sig) return false;
+  const BIGNUM* r;
+  const BIGNUM* s;
+  ECDSA_SIG_get0(sig, &r, &s);
+  bool ok = BN_bn2binpad(r, signature, 32) == 32 && BN_bn2binpad(s, signature + 32, 32) == 32;
+  ECDSA_SIG_free(sig);
+  return ok;
+}
+
+} // namespace gw
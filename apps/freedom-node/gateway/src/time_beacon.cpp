@@ -0,0 +1,29 @@
+/**
+ * Time Beacon Implementation
+ */
+
+#include "time_beacon.h"
+
+namespace gw {
+
+bool TimeBeacon::onReading(uint16_t address, const uint8_t* message, size_t length,
+                           uint64_t nowMs, const Send& send) {
+  tsync::Report report;
+  bool synced = tsync::findReport(message, length, &report);
+  if (synced) {
+    _stats.synced++;
+  } else {
+    _stats.unsynced++;
+  }
+
+  // Two missed broadcasts before a device is chased individually
+  if (synced && (uint64_t)report.ageMin * 60000ULL <= 2 * _intervalMs) return true;
+  uint64_t& sentMs = _sentMs[address];
+  if (sentMs != 0 && nowMs - sentMs < RESEND_INTERVAL_MS) return synced;
+  send(address);
+  sentMs = nowMs;
+  _stats.unicasts++;
+  return synced;
+}
+
+} // namespace gw
@@ -0,0 +1,193 @@
+/**
+ * Frame Merger Tests
+ *
+ * Copies of one uplink from several gateways: held for the window, merged
+ * into one record, late ones dropped. A gateway's journal offsets are only
+ * done once the server has acked the merged record covering them.
+ */
+
+#include "frame_merger.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace gw {
+namespace {
+
+const uint32_t WINDOW_MS = 300;
+const uint32_t REMEMBER_MS = 60000;
+const uint64_t FIRST = 1000;
+
+// A gateway's record of reading (address, seq), as formatReading() writes it
+std::string reading(int offset, int address, int seq, int rssi, int snr,
+                    const char* extra = "") {
+  char record[256];
+  char offsetField[32] = "";
+  if (offset >= 0) snprintf(offsetField, sizeof(offsetField), "\"offset\":%d,", offset);
+  snprintf(record, sizeof(record),
+           "{\"type\":\"reading\",%s\"address\":%d,\"seq\":%d,\"port\":0,\"rssi\":%d,"
+           "\"snr\":%d,\"commitment\":\"ab\",\"temperature\":21.5%s,\"verified\":true}",
+           offsetField, address, seq, rssi, snr, extra);
+  return record;
+}
+
+class FrameMergerTest : public ::testing::Test {
+protected:
+  FrameMergerTest() : merger(WINDOW_MS, REMEMBER_MS, FIRST) {
+    merger.setEmitHandler(
+        [this](const char* record, size_t length) { emitted.emplace_back(record, length); });
+  }
+
+  void offer(uint32_t peer, const std::string& record, uint64_t nowMs) {
+    char name[16];
+    snprintf(name, sizeof(name), "gw-%u", peer);
+    merger.offer(peer, name, record.data(), record.size(), nowMs);
+  }
+
+  uint64_t ackNext(uint32_t peer) {
+    uint64_t next = UINT64_MAX;
+    EXPECT_TRUE(merger.ackNext(peer, &next));
+    return next;
+  }
+
+  size_t held() const { return (size_t)(merger.heldEnd() - merger.heldBegin()); }
+
+  FrameMerger merger;
+  std::vector<std::string> emitted;
+};
+
+TEST_F(FrameMergerTest, WindowCollectsCopiesIntoOneRecord) {
+  offer(1, reading(0, 7, 3, -100, 2), 0);
+  offer(2, reading(10, 7, 3, -95, 8), 100);
+  merger.expire(WINDOW_MS - 1);
+  EXPECT_EQ(held(), 0u);
+  EXPECT_EQ(merger.pending(), 1u);
+
+  merger.expire(WINDOW_MS);
+  EXPECT_EQ(merger.pending(), 0u);
+  ASSERT_EQ(held(), 1u);
+  EXPECT_TRUE(emitted.empty());
+  // The best copy (higher SNR), with the merger's offset in place of its own
+  EXPECT_EQ(*merger.held(FIRST),
+            "{\"offset\":1000,\"type\":\"reading\",\"address\":7,\"seq\":3,\"port\":0,"
+            "\"rssi\":-95,\"snr\":8,\"commitment\":\"ab\",\"temperature\":21.5,"
+            "\"verified\":true,\"gateway\":\"gw-2\",\"receptions\":["
+            "{\"gateway\":\"gw-2\",\"rssi\":-95,\"snr\":8},"
+            "{\"gateway\":\"gw-1\",\"rssi\":-100,\"snr\":2}]}");
+  EXPECT_EQ(merger.stats().copies, 2u);
+  EXPECT_EQ(merger.stats().merged, 1u);
+  EXPECT_EQ(merger.stats().emitted, 1u);
+
+  uint32_t peer = 0;
+  ASSERT_TRUE(merger.route(7, &peer));
+  EXPECT_EQ(peer, 2u);
+}
+
+TEST_F(FrameMergerTest, LateAndRepeatedCopiesAreDropped) {
+  offer(1, reading(0, 7, 3, -100, 2), 0);
+  // Same address and sequence, other content: another record
+  offer(2, reading(0, 7, 3, -95, 8, ",\"humidity\":40"), 0);
+  merger.expire(WINDOW_MS);
+  EXPECT_EQ(held(), 2u);
+
+  offer(3, reading(4, 7, 3, -90, 9), WINDOW_MS + 10);
+  merger.expire(WINDOW_MS * 3);
+  EXPECT_EQ(held(), 2u);
+  EXPECT_EQ(merger.stats().late, 1u);
+
+  // Past rememberMs the same reading is new again
+  merger.expire(REMEMBER_MS + WINDOW_MS);
+  offer(3, reading(5, 7, 3, -90, 9), REMEMBER_MS + WINDOW_MS + 1);
+  merger.expire(REMEMBER_MS + WINDOW_MS * 3);
+  EXPECT_EQ(held(), 3u);
+}
+
+TEST_F(FrameMergerTest, GatewaysAreAckedOnlyAfterTheServer) {
+  offer(1, reading(0, 7, 3, -100, 2), 0);
+  offer(1, reading(1, 8, 1, -100, 2), 0);
+  offer(2, reading(5, 7, 3, -95, 8), 0);
+  merger.expire(WINDOW_MS);
+  ASSERT_EQ(held(), 2u);
+
+  // Merged and held: nothing is done until the server says so
+  EXPECT_EQ(ackNext(1), 0u);
+  EXPECT_EQ(ackNext(2), 5u);
+
+  // A late copy of a held record waits for it too
+  offer(3, reading(9, 8, 1, -110, 1), WINDOW_MS + 1);
+  EXPECT_EQ(ackNext(3), 9u);
+
+  uint64_t first = merger.heldBegin();
+  const std::string* record = merger.held(first);
+  ASSERT_NE(record, nullptr);
+  ASSERT_NE(record->find("\"address\":7"), std::string::npos);
+
+  merger.acked(first + 1);
+  EXPECT_EQ(merger.heldBegin(), first + 1);
+  EXPECT_EQ(merger.held(first), nullptr);
+  EXPECT_EQ(ackNext(1), 1u);
+  EXPECT_EQ(ackNext(2), 6u);
+  EXPECT_EQ(ackNext(3), 9u);
+
+  merger.acked(first + 2);
+  EXPECT_EQ(held(), 0u);
+  EXPECT_EQ(ackNext(1), 2u);
+  EXPECT_EQ(ackNext(3), 10u);
+
+  // A late copy of a record already acked is done at once
+  offer(4, reading(20, 7, 3, -120, 0), WINDOW_MS + 2);
+  EXPECT_EQ(ackNext(4), 21u);
+}
+
+TEST_F(FrameMergerTest, AckOutsideTheHeldRangeIsIgnored) {
+  offer(1, reading(0, 7, 3, -100, 2), 0);
+  merger.expire(WINDOW_MS);
+  // An ack left over from an earlier run, below this one's offsets
+  merger.acked(FIRST - 10);
+  EXPECT_EQ(held(), 1u);
+  EXPECT_EQ(ackNext(1), 0u);
+
+  merger.acked(FIRST + 50);
+  EXPECT_EQ(held(), 0u);
+  EXPECT_EQ(merger.heldEnd(), FIRST + 1);
+  EXPECT_EQ(ackNext(1), 1u);
+
+  offer(1, reading(1, 8, 1, -100, 2), WINDOW_MS);
+  merger.expire(WINDOW_MS * 2);
+  ASSERT_NE(merger.held(FIRST + 1), nullptr);
+  EXPECT_EQ(merger.held(FIRST + 1)->compare(0, 17, "{\"offset\":1001,\"t"), 0);
+}
+
+TEST_F(FrameMergerTest, AlertGoesOutOnItsFirstCopy) {
+  offer(1, reading(0, 7, 3, -100, 2, ",\"alerts\":[\"frost\"]"), 0);
+  EXPECT_EQ(held(), 1u);
+  EXPECT_EQ(merger.pending(), 0u);
+  offer(2, reading(3, 7, 3, -90, 9, ",\"alerts\":[\"frost\"]"), 10);
+  EXPECT_EQ(held(), 1u);
+  EXPECT_EQ(merger.stats().late, 1u);
+  // An alert may come on another spreading factor: it is not a route
+  uint32_t peer;
+  EXPECT_FALSE(merger.route(7, &peer));
+}
+
+TEST_F(FrameMergerTest, RecordsWithoutOffsetsAreEmitted) {
+  offer(1, reading(-1, 7, 3, -100, 2), 0);
+  offer(2, reading(-1, 7, 3, -95, 8), 0);
+  merger.flush();
+  EXPECT_EQ(held(), 0u);
+  ASSERT_EQ(emitted.size(), 1u);
+  EXPECT_EQ(emitted[0].find("\"offset\""), std::string::npos);
+  EXPECT_NE(emitted[0].find("\"gateway\":\"gw-2\""), std::string::npos);
+  uint64_t next;
+  EXPECT_FALSE(merger.ackNext(1, &next));
+
+  // Not JSON: passed through as it is
+  offer(1, "not json", 0);
+  ASSERT_EQ(emitted.size(), 2u);
+  EXPECT_EQ(emitted[1], "not json");
+  EXPECT_EQ(merger.stats().malformed, 1u);
+}
+
+} // namespace
+} // namespace gw
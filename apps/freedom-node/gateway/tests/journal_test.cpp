@@ -0,0 +1,245 @@
+/**
+ * Journal Tests
+ *
+ * Reopening after a clean stop and after a crash: records and cursors come
+ * back, a record that fails its CRC is refused, a torn tail is dropped and
+ * appended over, and compaction follows the cursors and the retention
+ * bound.
+ */
+
+#include "journal.h"
+#include "temp_dir.h"
+#include <chrono>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+
+namespace gw {
+namespace {
+
+const size_t PER_SEGMENT = 4;
+
+JournalRecord makeRecord(uint16_t i) {
+  JournalRecord record;
+  record.receivedMs = 1700000000000ULL + i;
+  record.address = (uint16_t)(100 + i);
+  record.seq = i;
+  record.rssi = (int16_t)(-90 - i);
+  record.snr = (int8_t)(i % 10);
+  record.flags = JOURNAL_CHECKED | JOURNAL_VERIFIED;
+  memset(record.packet, 0, sizeof(record.packet));
+  record.packet[0] = (uint8_t)(i % 3);   // Commitment: three devices
+  record.packet[40] = (uint8_t)i;
+  return record;
+}
+
+std::string segmentPath(const TempDir& dir, uint64_t first) {
+  char name[32];
+  snprintf(name, sizeof(name), "seg-%016llx.log", (unsigned long long)first);
+  return dir.file(name);
+}
+
+// Bytes written straight into a segment file, as a crash or bad disk would
+void writeAt(const std::string& path, uint64_t recordIndex, size_t at, const void* data,
+             size_t length) {
+  int fd = ::open(path.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  off_t position = (off_t)(Journal::HEADER_SIZE + recordIndex * Journal::RECORD_SIZE + at);
+  ASSERT_EQ(pwrite(fd, data, length, position), (ssize_t)length);
+  close(fd);
+}
+
+void append(Journal& journal, uint16_t from, uint16_t to) {
+  for (uint16_t i = from; i < to; i++) {
+    JournalRecord record = makeRecord(i);
+    ASSERT_TRUE(journal.append(record));
+    EXPECT_EQ(record.offset, i);
+  }
+}
+
+void waitDurable(const Journal& journal) {
+  for (int i = 0; i < 500 && journal.durableEnd() < journal.end(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(journal.durableEnd(), journal.end());
+}
+
+TEST(JournalTest, ReopensWithEveryRecord) {
+  TempDir dir;
+  {
+    Journal journal;
+    ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+    append(journal, 0, 10);
+    journal.commit();
+    waitDurable(journal);
+    EXPECT_EQ(journal.stats().segments, 3u);
+  }
+
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  EXPECT_EQ(journal.begin(), 0u);
+  EXPECT_EQ(journal.end(), 10u);
+  EXPECT_EQ(journal.durableEnd(), 10u);
+  for (uint16_t i = 0; i < 10; i++) {
+    JournalRecord expected = makeRecord(i), record;
+    ASSERT_TRUE(journal.read(i, &record));
+    EXPECT_EQ(record.offset, i);
+    EXPECT_EQ(record.receivedMs, expected.receivedMs);
+    EXPECT_EQ(record.address, expected.address);
+    EXPECT_EQ(record.rssi, expected.rssi);
+    EXPECT_EQ(record.snr, expected.snr);
+    EXPECT_EQ(record.flags, expected.flags);
+    EXPECT_EQ(memcmp(record.packet, expected.packet, sizeof(record.packet)), 0);
+  }
+  JournalRecord record;
+  EXPECT_FALSE(journal.read(10, &record));
+
+  // The device index is rebuilt from the records
+  uint8_t commitment[32] = {1};
+  uint64_t offsets[8];
+  ASSERT_EQ(journal.deviceOffsets(commitment, 0, offsets, 8), 3u);
+  EXPECT_EQ(offsets[0], 1u);
+  EXPECT_EQ(offsets[1], 4u);
+  EXPECT_EQ(offsets[2], 7u);
+}
+
+TEST(JournalTest, RecordFailingItsCrcIsRefused) {
+  TempDir dir;
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  append(journal, 0, 3);
+
+  uint8_t flipped = 0xFF;
+  writeAt(segmentPath(dir, 0), 1, 40 + 10, &flipped, 1);
+  JournalRecord record;
+  EXPECT_TRUE(journal.read(0, &record));
+  EXPECT_FALSE(journal.read(1, &record));
+  EXPECT_TRUE(journal.read(2, &record));
+}
+
+TEST(JournalTest, TornTailIsDroppedAndAppendedOver) {
+  TempDir dir;
+  {
+    Journal journal;
+    ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+    append(journal, 0, 3);
+  }
+  // A crash in append(): the offset and part of the packet, but the magic
+  // (written last) never made it
+  uint8_t partial[48];
+  memset(partial, 0xAB, sizeof(partial));
+  memset(partial, 0, 4);
+  partial[8] = 3;
+  memset(partial + 9, 0, 7);
+  writeAt(segmentPath(dir, 0), 3, 0, partial, sizeof(partial));
+
+  {
+    Journal journal;
+    ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+    EXPECT_EQ(journal.end(), 3u);
+    EXPECT_EQ(journal.stats().torn, 1u);
+    append(journal, 3, 5);
+  }
+
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  EXPECT_EQ(journal.end(), 5u);
+  EXPECT_EQ(journal.stats().torn, 0u);
+  JournalRecord record;
+  ASSERT_TRUE(journal.read(3, &record));
+  EXPECT_EQ(record.address, makeRecord(3).address);
+}
+
+TEST(JournalTest, CrashAfterCorruptRecordEndsTheJournalThere) {
+  TempDir dir;
+  {
+    Journal journal;
+    ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+    append(journal, 0, 3);
+  }
+  uint8_t flipped = 0xFF;
+  writeAt(segmentPath(dir, 0), 1, 40 + 10, &flipped, 1);
+
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  EXPECT_EQ(journal.end(), 1u);
+  EXPECT_EQ(journal.stats().torn, 1u);
+  JournalRecord record = makeRecord(7);
+  ASSERT_TRUE(journal.append(record));
+  EXPECT_EQ(record.offset, 1u);
+}
+
+TEST(JournalTest, CursorsSurviveReopenAndNeverMoveBack) {
+  TempDir dir;
+  {
+    Journal journal;
+    ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+    append(journal, 0, 10);
+    EXPECT_EQ(journal.cursor("proof"), 0u);
+    journal.setCursor("proof", 6);
+    journal.setCursor("proof", 3);
+    EXPECT_EQ(journal.cursor("proof"), 6u);
+    journal.setCursor("backup", 2);
+    journal.commit();
+  }
+
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  EXPECT_EQ(journal.cursor("proof"), 6u);
+  EXPECT_EQ(journal.cursor("backup"), 2u);
+  EXPECT_EQ(journal.cursor("new"), journal.begin());
+  // Never past the end
+  journal.setCursor("ahead", 50);
+  EXPECT_EQ(journal.cursor("ahead"), journal.end());
+}
+
+TEST(JournalTest, CompactionFollowsTheSlowestCursor) {
+  TempDir dir;
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 0));
+  append(journal, 0, 10);
+  journal.setCursor("proof", 9);
+  journal.setCursor("backup", 5);
+
+  EXPECT_EQ(journal.compact(), 1u);
+  EXPECT_EQ(journal.begin(), 4u);
+  EXPECT_NE(access(segmentPath(dir, 0).c_str(), F_OK), 0);
+  JournalRecord record;
+  EXPECT_FALSE(journal.read(3, &record));
+  EXPECT_TRUE(journal.read(4, &record));
+
+  journal.setCursor("backup", 9);
+  EXPECT_EQ(journal.compact(), 1u);
+  EXPECT_EQ(journal.begin(), 8u);
+  // The segment being written is never deleted
+  journal.setCursor("proof", 10);
+  journal.setCursor("backup", 10);
+  EXPECT_EQ(journal.compact(), 0u);
+  EXPECT_EQ(journal.stats().lost, 0u);
+
+  uint8_t commitment[32] = {1};
+  uint64_t offsets[8];
+  ASSERT_EQ(journal.deviceOffsets(commitment, 0, offsets, 8), 0u);
+  commitment[0] = 2;
+  ASSERT_EQ(journal.deviceOffsets(commitment, 0, offsets, 8), 1u);
+  EXPECT_EQ(offsets[0], 8u);
+}
+
+TEST(JournalTest, RetentionLimitCountsWhatWasLost) {
+  TempDir dir;
+  Journal journal;
+  ASSERT_TRUE(journal.open(dir.path, PER_SEGMENT, 2));
+  journal.setCursor("proof", 1);
+  append(journal, 0, 12);
+
+  EXPECT_EQ(journal.stats().segments, 2u);
+  EXPECT_EQ(journal.begin(), 4u);
+  EXPECT_EQ(journal.stats().lost, 3u);
+  EXPECT_EQ(journal.cursor("proof"), 4u);
+}
+
+} // namespace
+} // namespace gw
@@ -0,0 +1,145 @@
+/**
+ * Nullifier Set Tests
+ *
+ * Keys stay visible across rotation, while their partition is being sealed
+ * and once it is a table; the set comes back on reopen, logs left by a
+ * crash included; old epochs expire.
+ */
+
+#include "nullifier_set.h"
+#include "temp_dir.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace gw {
+namespace {
+
+typedef NullifierSet::Key Key;
+
+Key makeKey(uint32_t i) {
+  Key key;
+  for (size_t j = 0; j < key.size(); j++) key[j] = (uint8_t)(i * 7 + j);
+  memcpy(key.data(), &i, 4);   // Timestamp
+  return key;
+}
+
+void writeLogFile(const std::string& path, uint32_t from, uint32_t to, bool torn) {
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  for (uint32_t i = from; i < to; i++) fwrite(makeKey(i).data(), 1, NullifierSet::KEY_SIZE, file);
+  // A key cut short by the crash
+  if (torn) fwrite(makeKey(to).data(), 1, NullifierSet::KEY_SIZE / 2, file);
+  fclose(file);
+}
+
+TEST(NullifierSetTest, RepeatIsRejected) {
+  TempDir dir;
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 100));
+  EXPECT_TRUE(set.insert(makeKey(1).data()));
+  EXPECT_FALSE(set.insert(makeKey(1).data()));
+  EXPECT_TRUE(set.insert(makeKey(2).data()));
+  EXPECT_FALSE(set.contains(makeKey(3).data()));
+  EXPECT_EQ(set.stats().inserted, 2u);
+  EXPECT_EQ(set.stats().repeats, 1u);
+}
+
+TEST(NullifierSetTest, KeysStayVisibleWhileSealedAndAfter) {
+  TempDir dir;
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 4));
+  for (uint32_t i = 0; i < 10; i++) ASSERT_TRUE(set.insert(makeKey(i).data()));
+
+  // Two partitions sealed; done or not, their keys are still found
+  for (uint32_t i = 0; i < 10; i++) EXPECT_FALSE(set.insert(makeKey(i).data())) << i;
+  set.drain();
+  NullifierSetStats stats = set.stats();
+  EXPECT_EQ(stats.sealed, 2u);
+  EXPECT_EQ(stats.tables, 2u);
+  EXPECT_EQ(stats.tableKeys, 8u);
+  EXPECT_EQ(stats.liveKeys, 2u);
+  for (uint32_t i = 0; i < 10; i++) EXPECT_TRUE(set.contains(makeKey(i).data())) << i;
+  for (uint32_t i = 10; i < 100; i++) EXPECT_FALSE(set.contains(makeKey(i).data())) << i;
+}
+
+TEST(NullifierSetTest, RotationWaitsOnlyPastSealsMax) {
+  TempDir dir;
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 1));
+  const uint32_t count = (uint32_t)NullifierSet::SEALS_MAX * 3;
+  for (uint32_t i = 0; i < count; i++) {
+    ASSERT_TRUE(set.insert(makeKey(i).data()));
+    // Every partition holds one key: those not yet tables are in flight
+    NullifierSetStats stats = set.stats();
+    EXPECT_LE(stats.liveKeys, (size_t)NullifierSet::SEALS_MAX);
+    EXPECT_EQ(stats.tableKeys + stats.liveKeys, i + 1);
+    set.flush();
+  }
+  set.drain();
+  EXPECT_EQ(set.stats().tables, count);
+  for (uint32_t i = 0; i < count; i++) EXPECT_TRUE(set.contains(makeKey(i).data())) << i;
+}
+
+TEST(NullifierSetTest, ReopenResumesTheLivePartition) {
+  TempDir dir;
+  {
+    NullifierSet set;
+    ASSERT_TRUE(set.open(dir.path, 2, 4));
+    set.setEpoch(5);
+    for (uint32_t i = 0; i < 6; i++) ASSERT_TRUE(set.insert(makeKey(i).data()));
+    set.flush();
+  }
+
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 4));
+  EXPECT_EQ(set.epoch(), 5u);
+  EXPECT_EQ(set.stats().tables, 1u);
+  EXPECT_EQ(set.stats().liveKeys, 2u);
+  for (uint32_t i = 0; i < 6; i++) EXPECT_FALSE(set.insert(makeKey(i).data())) << i;
+
+  // The resumed partition fills up and is sealed beside the first
+  ASSERT_TRUE(set.insert(makeKey(6).data()));
+  ASSERT_TRUE(set.insert(makeKey(7).data()));
+  set.drain();
+  EXPECT_EQ(set.stats().tables, 2u);
+  EXPECT_EQ(set.stats().tableKeys, 8u);
+  for (uint32_t i = 0; i < 8; i++) EXPECT_TRUE(set.contains(makeKey(i).data())) << i;
+}
+
+TEST(NullifierSetTest, LogsLeftByACrashAreSealedOnOpen) {
+  TempDir dir;
+  // Epoch 1 was being sealed and epoch 2 was live when the process died
+  writeLogFile(dir.file("nul-00000001-0000.log"), 0, 5, false);
+  writeLogFile(dir.file("nul-00000002-0000.log"), 5, 8, true);
+
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 100));
+  EXPECT_EQ(set.epoch(), 2u);
+  NullifierSetStats stats = set.stats();
+  EXPECT_EQ(stats.tables, 1u);
+  EXPECT_EQ(stats.tableKeys, 5u);
+  EXPECT_EQ(stats.liveKeys, 3u);
+  for (uint32_t i = 0; i < 8; i++) EXPECT_TRUE(set.contains(makeKey(i).data())) << i;
+  EXPECT_FALSE(set.contains(makeKey(8).data()));
+}
+
+TEST(NullifierSetTest, OldEpochsExpire) {
+  TempDir dir;
+  NullifierSet set;
+  ASSERT_TRUE(set.open(dir.path, 2, 100));
+  set.setEpoch(1);
+  ASSERT_TRUE(set.insert(makeKey(1).data()));
+  set.setEpoch(2);
+  ASSERT_TRUE(set.insert(makeKey(2).data()));
+  set.setEpoch(3);
+  set.drain();
+
+  EXPECT_EQ(set.stats().expired, 1u);
+  EXPECT_EQ(set.stats().tables, 1u);
+  EXPECT_FALSE(set.contains(makeKey(1).data()));
+  EXPECT_TRUE(set.contains(makeKey(2).data()));
+}
+
+} // namespace
+} // namespace gw
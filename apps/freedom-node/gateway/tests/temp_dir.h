@@ -0,0 +1,33 @@
+/**
+ * Temporary directory for a test, removed with everything in it
+ */
+
+#ifndef TEMP_DIR_H
+#define TEMP_DIR_H
+
+#include <stdlib.h>
+#include <string>
+
+namespace gw {
+
+struct TempDir {
+  std::string path;
+
+  TempDir() {
+    char name[] = "/tmp/edgechain-test-XXXXXX";
+    path = mkdtemp(name);
+  }
+
+  ~TempDir() {
+    std::string command = "rm -rf " + path;
+    if (system(command.c_str()) != 0) {
+      // Left behind in /tmp
+    }
+  }
+
+  std::string file(const std::string& name) const { return path + "/" + name; }
+};
+
+} // namespace gw
+
+#endif // TEMP_DIR_H
@@ -23,6 +23,11 @@ export class BraceVerifier {
     private autoRegCounts: Map<number, { count: number; resetAt: number }> = new Map();
     private static readonly MAX_AUTO_REGISTRATIONS_PER_HOUR = 10;
 
+    // Device clocks follow gateway time beacons; batched and duty-cycle
+    // deferred readings arrive hours after they were taken
+    private static readonly MAX_CLOCK_SKEW_S = 300;
+    private static readonly MAX_READING_AGE_S = 24 * 3600;
+
     constructor(merkleTree: MerkleTree) {
         this.merkleTree = merkleTree;
     }
@@ -100,7 +105,8 @@ export class BraceVerifier {
      * The packet contains:
      * - Commitment (used to look up device in Merkle tree)
      * - Sensor data
-     * - P-256 signature over (commitment || sensorData || timestamp)
+     * - P-256 signature over (commitment || sensorData || timestamp), and a
+     *   sensor hub's probes item after it (packet.probes)
      * 
      * Note: We can't verify the signature directly because we don't have
      * the public key. The signature is verified during ZK proof generation
@@ -129,15 +135,17 @@ export class BraceVerifier {
                 return false;
             }
 
-            // 3. Check timestamp is reasonable (within 5 minutes)
+            // 3. Check timestamp is reasonable: not ahead of us, not older
+            // than a held-back reading can be
             const now = Math.floor(Date.now() / 1000);
-            const timeDiff = Math.abs(now - packet.timestamp);
+            const age = now - packet.timestamp;
 
-            if (timeDiff > 300) {
+            if (age < -BraceVerifier.MAX_CLOCK_SKEW_S || age > BraceVerifier.MAX_READING_AGE_S) {
                 logger.warn('Packet timestamp too old/future:', {
                     packetTime: packet.timestamp,
                     serverTime: now,
-                    diff: timeDiff
+                    age,
+                    timeSynced: packet.timeSynced
                 });
                 return false;
             }
@@ -0,0 +1,342 @@
+/**
+ * Gateway Socket - Records from the C++ gateway daemon
+ *
+ * Listens on a Unix socket for apps/freedom-node/gateway, which owns the
+ * RYLR896 modules, reassembles fragmented uplinks and decodes them with the
+ * firmware's own codec. Records arrive as newline-delimited JSON:
+ *
+ *   {"type":"reading","address":N,"seq":S,"rssi":R,"snr":Q,"commitment":"..",
+ *    "temperature":T,"humidity":H,"soilMoisture":M,"timestamp":MS,
+ *    "nullifier":"..","signature":".."}
+ *   {"type":"registration","address":N,"rssi":R,"snr":Q,"commitment":".."}
+ *
+ * Readings from devices that have heard a time beacon carry
+ * "timeSynced":true; their timestamp is Unix seconds, otherwise it is
+ * milliseconds since the device booted.
+ *
+ * A reading that tripped an on-device alert rule also carries
+ * "alerts":"frost,dry_soil" and is sent without waiting for a batch.
+ *
+ * Readings also carry what the device derived from its own stream:
+ * "analytics":{"gdd":G,"vpd":V,"dewPoint":D,"anomaly":Z,"events":"wetting"}
+ * (events only when some were raised since the device's last reading).
+ *
+ * Channels the DataPacket has no field for come bit-packed from the device
+ * and decoded by name: "channels":{"pressure":1013.2}.
+ *
+ * A sensor hub's readings carry its extra probes, signed with the rest:
+ * "probes":[["soil",1,38.2],["temperature",0,21.3],["humidity",0,null],..]
+ *
+ * Answers to history queries (requestHistory()) arrive one radio frame
+ * per record, raw samples or hourly / daily min-mean-max summaries:
+ *
+ *   {"type":"history","address":N,"request":I,"tier":"hourly","index":K,
+ *    "last":true,"truncated":false,"records":[{"start":S,"count":C,
+ *    "temperature":[min,mean,max],"humidity":[..],"soilMoisture":[..]}]}
+ *
+ * Devices answer each federated-learning model (sendModel()) with their
+ * largest parameter changes, [index, change] pairs:
+ *
+ *   {"type":"fl_update","address":N,"round":R,"samples":S,"rmseBefore":B,
+ *    "rmseAfter":A,"deltas":[[I,D],..]}
+ *
+ * Emits the same 'packet' events as LoRaReceiver, plus 'registration',
+ * 'history' and 'fl-update'. Downlinks go back on the same socket as {"type":"downlink",...}.
+ *
+ * Behind edgechain-merge (several gateways hearing the same devices), each
+ * uplink arrives once, as the copy heard best, with every gateway's signal:
+ * "gateway":"10.0.0.7","receptions":[{"gateway":"10.0.0.7","rssi":R,"snr":Q},..]
+ * Its "offset" is then the merger's own, acked the same way.
+ *
+ * When the gateway runs with a journal, readings also carry "offset". The
+ * 'packet' listener gets a done() callback for those; once every reading
+ * up to an offset is done, {"type":"ack","next":N} tells the gateway it
+ * may stop replaying them. Offsets at or below the highest one already
+ * received are replays (after a reconnect) and are ignored.
+ */
+
+import { EventEmitter } from 'events';
+import { createServer, Server, Socket } from 'net';
+import { existsSync, unlinkSync } from 'fs';
+import { LoRaPacket, LoRaStats } from './lora-receiver';
+import { logger } from './utils/logger';
+
+export interface GatewayRegistration {
+    sourceAddress: number;
+    commitment: string;      // 32 bytes hex
+    rssi: number;
+    snr: number;
+}
+
+export interface GatewayHistory {
+    sourceAddress: number;
+    request: number;
+    tier: 'raw' | 'hourly' | 'daily';
+    index: number;           // Frame number within the answer
+    last: boolean;           // Query answered completely
+    truncated: boolean;      // Device stopped at its frame limit; query again from the last record
+    records: any[];
+}
+
+export interface GatewayFlUpdate {
+    sourceAddress: number;
+    round: number;
+    samples: number;         // Training samples the device saw
+    rmseBefore: number;      // Forecast RMSE of the global model, % soil moisture
+    rmseAfter: number;       // ... after local training
+    deltas: [number, number][];
+}
+
+export class GatewaySocket extends EventEmitter {
+    private server: Server | null = null;
+    private clients: Set<Socket> = new Set();
+    private socketPath: string;
+    private highestOffset = -1;          // Highest journal offset received
+    private inFlight: Set<number> = new Set();
+    private ackScheduled = false;
+    private stats: LoRaStats = {
+        packetsReceived: 0,
+        packetsDropped: 0,
+        lastPacketTime: null,
+        averageRssi: 0
+    };
+
+    constructor(socketPath: string) {
+        super();
+        this.socketPath = socketPath;
+    }
+
+    async connect(): Promise<void> {
+        // A socket file left by a previous run would make listen() fail
+        if (existsSync(this.socketPath)) {
+            unlinkSync(this.socketPath);
+        }
+
+        return new Promise((resolve, reject) => {
+            this.server = createServer((socket) => this.handleClient(socket));
+            this.server.on('error', (err) => {
+                logger.error('Gateway socket error:', err);
+                reject(err);
+            });
+            this.server.listen(this.socketPath, () => {
+                logger.info(`Gateway socket listening on ${this.socketPath}`);
+                resolve();
+            });
+        });
+    }
+
+    private handleClient(socket: Socket): void {
+        logger.info('Gateway daemon connected');
+        this.clients.add(socket);
+        // A restarted gateway may hold an older ack than this process sent
+        if (this.highestOffset >= 0) {
+            this.scheduleAck();
+        }
+
+        let buffered = '';
+        socket.setEncoding('utf8');
+        socket.on('data', (chunk: string) => {
+            buffered += chunk;
+            let newline: number;
+            while ((newline = buffered.indexOf('\n')) >= 0) {
+                const line = buffered.slice(0, newline);
+                buffered = buffered.slice(newline + 1);
+                if (line.length > 0) {
+                    this.handleRecord(line);
+                }
+            }
+        });
+
+        socket.on('close', () => {
+            logger.info('Gateway daemon disconnected');
+            this.clients.delete(socket);
+        });
+        socket.on('error', (err) => logger.warn('Gateway connection error:', err));
+    }
+
+    private handleRecord(line: string): void {
+        let record: any;
+        try {
+            record = JSON.parse(line);
+        } catch (error) {
+            logger.warn('Malformed gateway record:', line.slice(0, 80));
+            this.stats.packetsDropped++;
+            return;
+        }
+
+        if (record.type === 'reading') {
+            const offset: number | undefined = record.offset;
+            if (offset !== undefined) {
+                if (offset <= this.highestOffset) {
+                    return;
+                }
+                this.highestOffset = offset;
+                this.inFlight.add(offset);
+            }
+
+            // Hex is lowercased to match commitments registered over HTTP
+            const packet: LoRaPacket = {
+                sourceAddress: record.address,
+                commitment: String(record.commitment).toLowerCase(),
+                sensorData: {
+                    temperature: record.temperature,
+                    humidity: record.humidity,
+                    pressure: record.channels?.pressure ?? null,
+                    soilMoisture: record.soilMoisture
+                },
+                nullifier: String(record.nullifier).toLowerCase(),
+                signature: String(record.signature).toLowerCase(),
+                timestamp: record.timestamp,
+                rssi: record.rssi,
+                snr: record.snr,
+                timeSynced: record.timeSynced === true
+            };
+            if (typeof record.alerts === 'string' && record.alerts.length > 0) {
+                packet.alerts = record.alerts.split(',');
+            }
+            if (record.analytics && typeof record.analytics === 'object') {
+                const a = record.analytics;
+                packet.analytics = {
+                    gdd: a.gdd,
+                    vpd: a.vpd ?? null,
+                    dewPoint: a.dewPoint ?? null,
+                    anomaly: a.anomaly,
+                    events: typeof a.events === 'string' && a.events.length > 0 ? a.events.split(',') : []
+                };
+            }
+            if (record.channels && typeof record.channels === 'object') {
+                packet.channels = record.channels;
+            }
+            if (Array.isArray(record.probes)) {
+                packet.probes = record.probes.map(([kind, index, value]: [string, number, number | null]) => ({
+                    kind,
+                    index,
+                    value: value ?? null
+                }));
+            }
+
+            this.stats.packetsReceived++;
+            this.stats.lastPacketTime = Date.now();
+            this.updateAverageRssi(packet.rssi);
+            this.emit('packet', packet, offset === undefined ? undefined : () => this.complete(offset));
+        } else if (record.type === 'registration') {
+            const registration: GatewayRegistration = {
+                sourceAddress: record.address,
+                commitment: String(record.commitment).toLowerCase(),
+                rssi: record.rssi,
+                snr: record.snr
+            };
+            this.emit('registration', registration);
+        } else if (record.type === 'history') {
+            const history: GatewayHistory = {
+                sourceAddress: record.address,
+                request: record.request,
+                tier: record.tier,
+                index: record.index,
+                last: record.last === true,
+                truncated: record.truncated === true,
+                records: Array.isArray(record.records) ? record.records : []
+            };
+            this.emit('history', history);
+        } else if (record.type === 'fl_update') {
+            const update: GatewayFlUpdate = {
+                sourceAddress: record.address,
+                round: record.round,
+                samples: record.samples,
+                rmseBefore: record.rmseBefore,
+                rmseAfter: record.rmseAfter,
+                deltas: Array.isArray(record.deltas) ? record.deltas : []
+            };
+            this.emit('fl-update', update);
+        } else {
+            this.stats.packetsDropped++;
+        }
+    }
+
+    private complete(offset: number): void {
+        if (this.inFlight.delete(offset)) {
+            this.scheduleAck();
+        }
+    }
+
+    // One ack per event-loop turn, for everything completed so far
+    private scheduleAck(): void {
+        if (this.ackScheduled) {
+            return;
+        }
+        this.ackScheduled = true;
+        setImmediate(() => {
+            this.ackScheduled = false;
+            let next = this.highestOffset + 1;
+            this.inFlight.forEach((offset) => { next = Math.min(next, offset); });
+            const message = JSON.stringify({ type: 'ack', next }) + '\n';
+            this.clients.forEach((client) => client.write(message));
+        });
+    }
+
+    /**
+     * Queue a downlink frame for a device via the gateway daemon
+     */
+    sendDownlink(address: number, payloadHex: string): boolean {
+        if (this.clients.size === 0) {
+            return false;
+        }
+        const message = JSON.stringify({ type: 'downlink', address, payload: payloadHex }) + '\n';
+        this.clients.forEach((client) => client.write(message));
+        return true;
+    }
+
+    /**
+     * Ask a device for its stored history (history query, 0x0C). It answers
+     * from the coarsest tier that meets the resolution: daily summaries
+     * from 86400 s, hourly from 3600 s, raw samples below.
+     * @param from Unix seconds
+     * @param to Unix seconds, exclusive
+     */
+    requestHistory(address: number, request: number, from: number, to: number,
+                   resolutionS: number): boolean {
+        const frame = Buffer.alloc(14);
+        frame.writeUInt8(0x0c, 0);
+        frame.writeUInt8(request & 0xff, 1);
+        frame.writeUInt32LE(from, 2);
+        frame.writeUInt32LE(to, 6);
+        frame.writeUInt32LE(resolutionS, 10);
+        return this.sendDownlink(address, frame.toString('hex').toUpperCase());
+    }
+
+    /**
+     * Send a federated-learning global model (0x0E, 88 bytes; built by
+     * encodeDeviceModel() in @edgechain/fl). Address 0 reaches every device.
+     */
+    sendModel(address: number, frameHex: string): boolean {
+        if (!/^0E[0-9A-F]{174}$/i.test(frameHex)) {
+            return false;
+        }
+        return this.sendDownlink(address, frameHex.toUpperCase());
+    }
+
+    private updateAverageRssi(rssi: number): void {
+        const alpha = 0.1; // Exponential moving average factor
+        this.stats.averageRssi = this.stats.averageRssi === 0
+            ? rssi
+            : (alpha * rssi) + ((1 - alpha) * this.stats.averageRssi);
+    }
+
+    isConnected(): boolean {
+        return this.clients.size > 0;
+    }
+
+    getStats(): LoRaStats {
+        return { ...this.stats };
+    }
+
+    disconnect(): void {
+        this.clients.forEach((client) => client.destroy());
+        this.clients.clear();
+        if (this.server) {
+            this.server.close();
+            this.server = null;
+            logger.info('Gateway socket closed');
+        }
+    }
+}
@@ -2,14 +2,17 @@
  * EdgeChain Proof Server - Entry Point
  * 
  * Farmer-owned Freedom Node proof server (Linux, x86 or ARM)
- * Receives LoRa transmissions from ESP32-S3 devices and generates ZK proofs
+ * Receives LoRa transmissions (and Wi-Fi uplinks) from ESP32-S3 devices and
+ * generates ZK proofs
  */
 
 import express from 'express';
 import cors from 'cors';
 import { createServer } from 'http';
 import { WebSocketServer } from 'ws';
-import { LoRaReceiver } from './lora-receiver';
+import { LoRaReceiver, LoRaPacket } from './lora-receiver';
+import { GatewaySocket, GatewayRegistration, GatewayHistory, GatewayFlUpdate } from './gateway-socket';
+import { IotUplink } from './iot-uplink';
 import { MidnightProver } from './midnight-prover';
 import { BraceVerifier } from './brace-verifier';
 import { AcrHandler } from './acr-handler';
@@ -24,7 +27,11 @@ const merkleTree = new MerkleTree(config.merkleTree.depth);
 const braceVerifier = new BraceVerifier(merkleTree);
 const midnightProver = new MidnightProver(config.midnight);
 const acrHandler = new AcrHandler(midnightProver, merkleTree);
-const loraReceiver = new LoRaReceiver(config.lora);
+// With a gateway daemon the modules are read by it; otherwise read one directly
+const gatewaySocket = config.lora.gatewaySocket ? new GatewaySocket(config.lora.gatewaySocket) : null;
+const loraReceiver = gatewaySocket ?? new LoRaReceiver(config.lora);
+// Devices on Wi-Fi POST to /api/iot/uplink instead, signed with bound-device keys
+const iotUplink = new IotUplink();
 
 // Express app for status/management API
 const app = express();
@@ -52,6 +59,7 @@ app.get('/status', (_req, res) => {
     res.json({
         version: '1.0.0',
         loraStats: loraReceiver.getStats(),
+        wifiStats: iotUplink.getStats(),
         proofsGenerated: midnightProver.getProofCount(),
         deviceCount: merkleTree.getLeafCount(),
         lastProofTime: midnightProver.getLastProofTime()
@@ -102,6 +110,56 @@ app.get('/merkle-proof/:commitment', (req, res) => {
     }
 });
 
+// Pull a device's on-device history (gateway daemon only); the answer
+// arrives over the WebSocket as sensor:history events
+let historyRequest = 0;
+app.post('/history/:address', (req, res) => {
+    const address = Number(req.params.address);
+    const { from, to, resolution } = req.body;
+    if (!Number.isInteger(address) || ![from, to, resolution].every(Number.isInteger) || from >= to) {
+        return res.status(400).json({ error: 'Invalid address or range' });
+    }
+    if (!gatewaySocket) {
+        return res.status(503).json({ error: 'History needs the gateway daemon' });
+    }
+    historyRequest = (historyRequest + 1) & 0xff;
+    if (!gatewaySocket.requestHistory(address, historyRequest, from, to, resolution)) {
+        return res.status(503).json({ error: 'Gateway not connected' });
+    }
+    res.json({ request: historyRequest });
+});
+
+// Start a federated-learning round: the model frame goes out as a downlink
+// (address 0 for every device); updates arrive as fl:update events
+app.post('/fl/model', (req, res) => {
+    const { address = 0, frame } = req.body;
+    if (!Number.isInteger(address) || typeof frame !== 'string') {
+        return res.status(400).json({ error: 'Invalid address or frame' });
+    }
+    if (!gatewaySocket) {
+        return res.status(503).json({ error: 'Federated learning needs the gateway daemon' });
+    }
+    if (!gatewaySocket.sendModel(address, frame)) {
+        return res.status(gatewaySocket.isConnected() ? 400 : 503)
+            .json({ error: gatewaySocket.isConnected() ? 'Invalid model frame' : 'Gateway not connected' });
+    }
+    res.json({ queued: true });
+});
+
+// Batches from devices on Wi-Fi (u16 BE length-prefixed messages); the
+// response carries the downlinks queued for the device, once a signed
+// message in the batch has shown it is that device
+app.post('/api/iot/uplink', express.raw({ type: () => true, limit: '64kb' }), (req, res) => {
+    if (!iotUplink.hasKeys()) {
+        return res.status(503).json({ error: 'Wi-Fi uplink needs bound-device keys (IOT_KEYS)' });
+    }
+    const address = Number(req.query.address);
+    if (!Number.isInteger(address) || address <= 0 || address > 0xffff || !Buffer.isBuffer(req.body)) {
+        return res.status(400).json({ error: 'Invalid address or body' });
+    }
+    res.type('application/octet-stream').send(iotUplink.handleBatch(address, req.body));
+});
+
 // ACR claim endpoint
 app.post('/claim-reward', async (req, res) => {
     try {
@@ -144,9 +202,11 @@ function broadcast(event: string, data: any) {
     });
 }
 
-// LoRa message handler
-loraReceiver.on('packet', async (packet) => {
-    logger.info('Received LoRa packet:', {
+// Reading handler, for LoRa and Wi-Fi alike
+// done() is set for journaled readings from the gateway daemon: call it once
+// the reading is handled (or rejected) so the gateway stops replaying it
+async function handlePacket(packet: LoRaPacket, done?: () => void) {
+    logger.info('Received packet:', {
         commitment: packet.commitment.slice(0, 16) + '...',
         rssi: packet.rssi
     });
@@ -163,6 +223,25 @@ loraReceiver.on('packet', async (packet) => {
             return;
         }
 
+        // Alerts go to the dashboard now, not after the proof is on chain
+        if (packet.alerts) {
+            broadcast('sensor:alert', {
+                sourceAddress: packet.sourceAddress,
+                alerts: packet.alerts,
+                sensorData: packet.sensorData,
+                timestamp: packet.timestamp
+            });
+        }
+        if (packet.analytics && packet.analytics.events.length > 0) {
+            broadcast('sensor:event', {
+                sourceAddress: packet.sourceAddress,
+                events: packet.analytics.events,
+                analytics: packet.analytics,
+                sensorData: packet.sensorData,
+                timestamp: packet.timestamp
+            });
+        }
+
         // 2. Generate ZK proof
         const proof = await midnightProver.generateAttestationProof({
             commitment: packet.commitment,
@@ -193,7 +272,40 @@ loraReceiver.on('packet', async (packet) => {
     } catch (error: any) {
         logger.error('Packet processing failed:', error);
         broadcast('packet:error', { error: error.message });
+    } finally {
+        done?.();
+    }
+}
+
+loraReceiver.on('packet', handlePacket);
+iotUplink.on('packet', (packet: LoRaPacket) => handlePacket(packet));
+
+// Registrations over LoRa (gateway daemon only) or Wi-Fi: add to the tree,
+// then ACK (0x01) over the link the device registered on
+async function handleRegistration(registration: GatewayRegistration,
+                                  sendDownlink: (address: number, payloadHex: string) => boolean) {
+    try {
+        const result = await braceVerifier.registerCommitment(registration.commitment);
+        sendDownlink(registration.sourceAddress, '01');
+        broadcast('device:registered', { leafIndex: result.leafIndex, merkleRoot: result.newRoot });
+    } catch (error: any) {
+        logger.error('Registration over the air failed:', error);
     }
+}
+
+gatewaySocket?.on('registration', (registration: GatewayRegistration) =>
+    handleRegistration(registration, (address, payload) => gatewaySocket.sendDownlink(address, payload)));
+iotUplink.on('registration', (registration: GatewayRegistration) =>
+    handleRegistration(registration, (address, payload) => iotUplink.sendDownlink(address, payload)));
+
+gatewaySocket?.on('history', (history: GatewayHistory) => {
+    broadcast('sensor:history', history);
+});
+
+gatewaySocket?.on('fl-update', (update: GatewayFlUpdate) => {
+    logger.info(`FL update from ${update.sourceAddress}: round ${update.round}, ` +
+        `${update.samples} samples, RMSE ${update.rmseBefore} -> ${update.rmseAfter}`);
+    broadcast('fl:update', update);
 });
 
 // Start server
@@ -203,6 +315,14 @@ async function main() {
         await merkleTree.load(config.merkleTree.storagePath);
         logger.info(`Loaded Merkle tree with ${merkleTree.getLeafCount()} commitments`);
 
+        // Bound-device keys for the Wi-Fi uplink; SIGHUP reloads them
+        if (config.iot.keysPath) {
+            logger.info(`Loaded ${iotUplink.loadKeys(config.iot.keysPath)} bound-device keys`);
+            process.on('SIGHUP', () => {
+                logger.info(`Reloaded ${iotUplink.loadKeys(config.iot.keysPath)} bound-device keys`);
+            });
+        }
+
         // Connect to LoRa module (optional - for development without hardware)
         try {
             await loraReceiver.connect();
@@ -0,0 +1,291 @@
+/**
+ * IoT Uplink - Batches POSTed by devices over Wi-Fi
+ *
+ * Devices in reach of an access point send through the proof server
+ * directly (firmware wifi_transport.h): POST /api/iot/uplink?address=N,
+ * where N is the device's LoRa address. The body is a run of records, a
+ * u16 BE length then the message as it would go over LoRa. The response
+ * is a batch in the same format, carrying the downlinks queued for the
+ * device since its last POST.
+ *
+ * Messages go through the same decoder as LoRaReceiver:
+ *   - DataPackets (144 bytes, plus trailer items)       -> 'packet'
+ *   - Registrations (0x00 + commitment + signature)     -> 'registration'
+ *   - Self-test echoes (0x04)                           -> answered in the response
+ * Anything else (history, model updates, OTA status) needs the gateway
+ * daemon and is counted as dropped. Wi-Fi has no RSSI or SNR; they are
+ * reported as 0.
+ *
+ * The address in the query string proves nothing, so readings and
+ * registrations must carry a signature by a bound device's key (the
+ * gateway daemon's --keys file); others are dropped. The first device to
+ * post a signed message from an address owns it. Queued downlinks only go
+ * back in the response to a batch that carries the owner's credential: a
+ * reading newer than any seen from it, or a registration while it has sent
+ * no reading yet. Other batches get an empty response.
+ *
+ * Downlinks (sendDownlink()) wait for the device's next such POST; address
+ * 0 reaches every device that has one.
+ */
+
+import { EventEmitter } from 'events';
+import { KeyObject, createPublicKey, verify } from 'crypto';
+import { readFileSync } from 'fs';
+import { DATA_PACKET_SIZE, LoRaStats, decodeDataPacket, encodeEchoReply } from './lora-receiver';
+import { GatewayRegistration } from './gateway-socket';
+import { logger } from './utils/logger';
+
+const MSG_REGISTRATION = 0x00;
+const MSG_ECHO_REQUEST = 0x04;
+const REGISTRATION_SIZE = 97;        // Type, commitment, signature over both
+const REGISTRATION_SIGNED_SIZE = 33;
+const DATA_PACKET_SIGNED_SIZE = 80;  // The signature follows
+const TRAILER_PROBES = 0x05;         // Sensor hub channels, signed with the packet
+const PROBES_MAX_BYTES = 16 * 3;
+const RECORD_HEADER_SIZE = 2;
+const RESPONSE_MAX_BYTES = 2048;     // WIFI_BATCH_BYTES: the device's response buffer
+const QUEUE_MAX = 32;                // Downlinks held per device; the oldest go first
+
+/**
+ * Messages of a batch; stops at a truncated record
+ */
+export function decodeBatch(batch: Buffer): { messages: Buffer[]; truncated: boolean } {
+    const messages: Buffer[] = [];
+    let offset = 0;
+    while (offset + RECORD_HEADER_SIZE <= batch.length) {
+        const length = batch.readUInt16BE(offset);
+        if (offset + RECORD_HEADER_SIZE + length > batch.length) {
+            return { messages, truncated: true };
+        }
+        messages.push(batch.subarray(offset + RECORD_HEADER_SIZE, offset + RECORD_HEADER_SIZE + length));
+        offset += RECORD_HEADER_SIZE + length;
+    }
+    return { messages, truncated: offset !== batch.length };
+}
+
+export function encodeBatch(messages: Buffer[]): Buffer {
+    return Buffer.concat(messages.flatMap((message) => {
+        const header = Buffer.alloc(RECORD_HEADER_SIZE);
+        header.writeUInt16BE(message.length);
+        return [header, message];
+    }));
+}
+
+/**
+ * Bound-device keys, in the gateway daemon's --keys format: one device per
+ * line, commitment (64 hex) then public key X || Y (128 hex); '#' starts a
+ * comment
+ */
+export function loadDeviceKeys(path: string): Map<string, KeyObject> {
+    const keys = new Map<string, KeyObject>();
+    readFileSync(path, 'utf-8').split('\n').forEach((line, index) => {
+        const [commitment, key] = line.trim().split(/\s+/);
+        if (!commitment || commitment.startsWith('#')) {
+            return;
+        }
+        if (!/^[0-9a-fA-F]{64}$/.test(commitment) || !/^[0-9a-fA-F]{128}$/.test(key ?? '')) {
+            logger.warn(`${path}:${index + 1}: bad entry`);
+            return;
+        }
+        const point = Buffer.from(key, 'hex');
+        try {
+            keys.set(commitment.toLowerCase(), createPublicKey({
+                key: {
+                    kty: 'EC',
+                    crv: 'P-256',
+                    x: point.subarray(0, 32).toString('base64url'),
+                    y: point.subarray(32).toString('base64url')
+                },
+                format: 'jwk'
+            }));
+        } catch {
+            logger.warn(`${path}:${index + 1}: not a P-256 point`);
+        }
+    });
+    return keys;
+}
+
+/**
+ * The bytes a reading's signature covers: the first 80, then a sensor
+ * hub's probes item if one follows the DataPacket (firmware probe_protocol.h)
+ */
+export function signedReading(message: Buffer): Buffer {
+    const signed = message.subarray(0, DATA_PACKET_SIGNED_SIZE);
+    const item = DATA_PACKET_SIZE;
+    if (message.length < item + 2 || message[item] !== TRAILER_PROBES) {
+        return signed;
+    }
+    const length = message[item + 1];
+    if (length > PROBES_MAX_BYTES || length % 3 !== 0 || item + 2 + length > message.length) {
+        return signed;
+    }
+    return Buffer.concat([signed, message.subarray(item, item + 2 + length)]);
+}
+
+export class IotUplink extends EventEmitter {
+    private keys: Map<string, KeyObject> = new Map();
+    private queues: Map<number, Buffer[]> = new Map();
+    private owners: Map<number, string> = new Map();          // Address -> commitment
+    private lastTimestamps: Map<string, number> = new Map();  // Commitment -> newest reading
+    private stats: LoRaStats = {
+        packetsReceived: 0,
+        packetsDropped: 0,
+        lastPacketTime: null,
+        averageRssi: 0
+    };
+
+    /**
+     * Replace the bound-device keys with the contents of a key file
+     * @returns Number of keys held (those before, if the file could not be read)
+     */
+    loadKeys(path: string): number {
+        try {
+            this.keys = loadDeviceKeys(path);
+        } catch (error: any) {
+            logger.error(`Bound-device keys: ${error.message}`);
+        }
+        return this.keys.size;
+    }
+
+    hasKeys(): boolean {
+        return this.keys.size > 0;
+    }
+
+    /**
+     * Handle one POST body
+     * @param address Device address, from the query string
+     * @returns Response body: the downlinks queued for the device, if the
+     *          batch carried its credential; else empty
+     */
+    handleBatch(address: number, body: Buffer): Buffer {
+        const { messages, truncated } = decodeBatch(body);
+        if (truncated) {
+            logger.warn(`Truncated Wi-Fi batch from ${address}`);
+            this.stats.packetsDropped++;
+        }
+
+        let authorized = false;
+        const echoes: Buffer[] = [];
+        for (const message of messages) {
+            if (message.length >= DATA_PACKET_SIZE) {
+                const commitment = message.subarray(0, 32).toString('hex');
+                const packet = message.subarray(0, DATA_PACKET_SIZE);
+                if (!this.verify(commitment, signedReading(message),
+                                 packet.subarray(DATA_PACKET_SIGNED_SIZE)) ||
+                    !this.owns(address, commitment)) {
+                    this.stats.packetsDropped++;
+                    continue;
+                }
+                const decoded = decodeDataPacket(address, packet, 0, 0);
+                const last = this.lastTimestamps.get(commitment);
+                if (last === undefined || decoded.timestamp > last) {
+                    this.lastTimestamps.set(commitment, decoded.timestamp);
+                    authorized = true;
+                }
+                this.stats.packetsReceived++;
+                this.stats.lastPacketTime = Date.now();
+                this.emit('packet', decoded);
+            } else if (message.length === REGISTRATION_SIZE && message[0] === MSG_REGISTRATION) {
+                const commitment = message.subarray(1, REGISTRATION_SIGNED_SIZE).toString('hex');
+                if (!this.verify(commitment, message.subarray(0, REGISTRATION_SIGNED_SIZE),
+                                 message.subarray(REGISTRATION_SIGNED_SIZE)) ||
+                    !this.owns(address, commitment)) {
+                    this.stats.packetsDropped++;
+                    continue;
+                }
+                // A registration replayed once the device is reporting gets nothing back
+                if (!this.lastTimestamps.has(commitment)) {
+                    authorized = true;
+                }
+                const registration: GatewayRegistration = {
+                    sourceAddress: address,
+                    commitment,
+                    rssi: 0,
+                    snr: 0
+                };
+                this.emit('registration', registration);
+            } else if (message.length >= 2 && message[0] === MSG_ECHO_REQUEST) {
+                echoes.push(encodeEchoReply(message[1], 0, 0));
+            } else {
+                this.stats.packetsDropped++;
+            }
+        }
+
+        if (!authorized) {
+            return Buffer.alloc(0);
+        }
+        if (!this.queues.has(address)) {
+            this.queues.set(address, []);
+        }
+        echoes.forEach((reply) => this.queue(address, reply));
+        return this.take(address);
+    }
+
+    /**
+     * Queue a downlink frame for a device's next POST
+     * @param address Device address; 0 for every device that has posted
+     *                its credential
+     */
+    sendDownlink(address: number, payloadHex: string): boolean {
+        const payload = Buffer.from(payloadHex, 'hex');
+        if (address === 0) {
+            this.queues.forEach((_queue, device) => this.queue(device, payload));
+            return this.queues.size > 0;
+        }
+        this.queue(address, payload);
+        return true;
+    }
+
+    // Signature by the key bound to the commitment
+    private verify(commitment: string, signed: Buffer, signature: Buffer): boolean {
+        const key = this.keys.get(commitment);
+        if (!key) {
+            return false;
+        }
+        return verify('sha256', signed, { key, dsaEncoding: 'ieee-p1363' }, signature);
+    }
+
+    // The first commitment to sign from an address keeps it
+    private owns(address: number, commitment: string): boolean {
+        const owner = this.owners.get(address);
+        if (owner === undefined) {
+            this.owners.set(address, commitment);
+            return true;
+        }
+        if (owner !== commitment) {
+            logger.warn(`Wi-Fi batch for ${address} signed by another device ` +
+                `(${commitment.slice(0, 16)}...)`);
+            return false;
+        }
+        return true;
+    }
+
+    private queue(address: number, payload: Buffer): void {
+        let queue = this.queues.get(address);
+        if (!queue) {
+            queue = [];
+            this.queues.set(address, queue);
+        }
+        queue.push(payload);
+        if (queue.length > QUEUE_MAX) {
+            queue.shift();
+        }
+    }
+
+    // As many queued downlinks as the device's response buffer takes
+    private take(address: number): Buffer {
+        const queue = this.queues.get(address) ?? [];
+        let bytes = 0;
+        let count = 0;
+        while (count < queue.length &&
+               bytes + RECORD_HEADER_SIZE + queue[count].length <= RESPONSE_MAX_BYTES) {
+            bytes += RECORD_HEADER_SIZE + queue[count].length;
+            count++;
+        }
+        return encodeBatch(queue.splice(0, count));
+    }
+
+    getStats(): LoRaStats {
+        return { ...this.stats };
+    }
+}
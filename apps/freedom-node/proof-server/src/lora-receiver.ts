@@ -27,7 +27,7 @@ export interface LoRaPacket {
     sensorData: {
         temperature: number;
         humidity: number;
-        pressure: null;
+        pressure: number | null; // hPa, from the gateway's "channels"
         soilMoisture: number;
     };
     nullifier: string;       // 32 bytes hex
@@ -35,6 +35,25 @@ export interface LoRaPacket {
     timestamp: number;
     rssi: number;
     snr: number;
+    alerts?: string[];       // Alert rules the reading tripped (gateway only)
+    timeSynced?: boolean;    // Timestamp is network time, not ms since boot (gateway only)
+    analytics?: EdgeAnalytics; // Derived on the device (gateway only)
+    probes?: ProbeChannel[]; // Sensor hub channels, covered by the signature (gateway only)
+    channels?: Record<string, number | null>; // Channels beyond the DataPacket, by name (gateway only)
+}
+
+export interface ProbeChannel {
+    kind: string;            // 'soil' (%), 'temperature' (°C), 'humidity' (%)
+    index: number;           // Soil probe 1-8, or the BME280's mux channel
+    value: number | null;    // null if the probe failed to read
+}
+
+export interface EdgeAnalytics {
+    gdd: number;             // Growing degree days since provisioning (°C·day)
+    vpd: number | null;      // Vapour pressure deficit (kPa)
+    dewPoint: number | null; // Celsius
+    anomaly: number;         // Largest channel z-score
+    events: string[];        // 'wetting', 'anomaly' since the last reading sent
 }
 
 export interface LoRaStats {
@@ -175,6 +194,10 @@ export class LoRaReceiver extends EventEmitter {
     private handleData(line: string): void {
         // Check for received data: +RCV=<Address>,<Length>,<Data>,<RSSI>,<SNR>
         if (line.startsWith('+RCV=')) {
+            if (this.handleEcho(line)) {
+                return;
+            }
+
             try {
                 const packet = this.parsePacket(line);
 
@@ -192,6 +215,27 @@ export class LoRaReceiver extends EventEmitter {
         }
     }
 
+    /**
+     * Answer a device self-test echo (type 0x04) with type 0x05, the
+     * sequence number, and the RSSI/SNR this gateway measured (int8 each).
+     * DataPackets carry no type byte, so a 144-byte frame is never an echo.
+     */
+    private handleEcho(line: string): boolean {
+        const match = line.match(/\+RCV=(\d+),(\d+),04([0-9A-Fa-f]{2})[0-9A-Fa-f]*,(-?\d+),(-?\d+)/);
+        if (!match || parseInt(match[2]) === 288) {
+            return false;
+        }
+
+        const [, sourceAddr, , seq, rssi, snr] = match;
+        const reply = encodeEchoReply(parseInt(seq, 16), parseInt(rssi), parseInt(snr))
+            .toString('hex')
+            .toUpperCase();
+
+        this.sendCommand(`AT+SEND=${sourceAddr},${reply.length},${reply}`)
+            .catch((error) => logger.warn('Echo reply failed:', error));
+        return true;
+    }
+
     private parsePacket(line: string): LoRaPacket | null {
         // Format: +RCV=<Address>,<Length>,<HexData>,<RSSI>,<SNR>
         const match = line.match(/\+RCV=(\d+),(\d+),([0-9A-Fa-f]+),(-?\d+),(-?\d+)/);
@@ -201,47 +245,14 @@ export class LoRaReceiver extends EventEmitter {
             return null;
         }
 
-        const [, sourceAddr, length, hexData, rssi, snr] = match;
+        const [, sourceAddr, , hexData, rssi, snr] = match;
         const data = Buffer.from(hexData, 'hex');
-
-        // ESP32 Ndani DataPacket v1 structure (144 bytes):
-        // - Commitment: 32 bytes
-        // - Temperature, humidity, soil moisture: 12 bytes
-        // - Device timestamp: 4 bytes
-        // - Epoch nullifier: 32 bytes
-        // - Signature: 64 bytes (P-256)
-        //
-        // Pressure is read locally by the BME280 but is not transmitted by
-        // firmware DataPacket v1. It must remain unavailable downstream.
-
-        if (data.length !== 144) {
+        if (data.length !== DATA_PACKET_SIZE) {
             logger.warn(`Packet too short: ${data.length} bytes`);
             return null;
         }
 
-        const commitment = data.subarray(0, 32).toString('hex');
-
-        const sensorData = {
-            temperature: data.readFloatLE(32),
-            humidity: data.readFloatLE(36),
-            pressure: null,
-            soilMoisture: data.readFloatLE(40)
-        };
-
-        const timestamp = data.readUInt32LE(44);
-        const nullifier = data.subarray(48, 80).toString('hex');
-        const signature = data.subarray(80, 144).toString('hex');
-
-        return {
-            sourceAddress: parseInt(sourceAddr),
-            commitment,
-            sensorData,
-            nullifier,
-            signature,
-            timestamp,
-            rssi: parseInt(rssi),
-            snr: parseInt(snr)
-        };
+        return decodeDataPacket(parseInt(sourceAddr), data, parseInt(rssi), parseInt(snr));
     }
 
     private updateAverageRssi(rssi: number): void {
@@ -268,3 +279,46 @@ export class LoRaReceiver extends EventEmitter {
         }
     }
 }
+
+export const DATA_PACKET_SIZE = 144;
+
+/**
+ * Decode an ESP32 Ndani DataPacket v1 (144 bytes):
+ * - Commitment: 32 bytes
+ * - Temperature, humidity, soil moisture: 12 bytes
+ * - Device timestamp: 4 bytes
+ * - Epoch nullifier: 32 bytes
+ * - Signature: 64 bytes (P-256)
+ *
+ * Pressure is read locally by the BME280 but is not transmitted by
+ * firmware DataPacket v1. It must remain unavailable downstream.
+ * Trailer items after the packet (sensor hub probes) are left to the
+ * gateway daemon.
+ */
+export function decodeDataPacket(sourceAddress: number, data: Buffer, rssi: number,
+                                 snr: number): LoRaPacket {
+    return {
+        sourceAddress,
+        commitment: data.subarray(0, 32).toString('hex'),
+        sensorData: {
+            temperature: data.readFloatLE(32),
+            humidity: data.readFloatLE(36),
+            pressure: null,
+            soilMoisture: data.readFloatLE(40)
+        },
+        nullifier: data.subarray(48, 80).toString('hex'),
+        signature: data.subarray(80, 144).toString('hex'),
+        timestamp: data.readUInt32LE(44),
+        rssi,
+        snr
+    };
+}
+
+/**
+ * Answer to a device self-test echo (type 0x04): type 0x05, the sequence
+ * number, and the RSSI/SNR the receiver measured (int8 each)
+ */
+export function encodeEchoReply(seq: number, rssi: number, snr: number): Buffer {
+    const clamp = (v: number) => Math.max(-128, Math.min(127, v)) & 0xff;
+    return Buffer.from([0x05, seq & 0xff, clamp(rssi), clamp(snr)]);
+}
@@ -22,6 +22,10 @@ interface Config {
         spreadingFactor: number;
         bandwidth: number;
         txPower: number;
+        gatewaySocket: string;   // Unix socket of the C++ gateway daemon; '' = read serialPort directly
+    };
+    iot: {
+        keysPath: string;        // Bound-device keys (gateway --keys format); '' = no Wi-Fi uplink
     };
     midnight: {
         nodeUrl: string;
@@ -93,7 +97,11 @@ function getDefaultConfig(): Config {
             frequency: 915000000,
             spreadingFactor: 9,
             bandwidth: 125,
-            txPower: 20
+            txPower: 20,
+            gatewaySocket: ''
+        },
+        iot: {
+            keysPath: ''
         },
         midnight: {
             nodeUrl: 'https://testnet.midnight.network',
@@ -164,6 +172,15 @@ function applyEnvOverrides(config: Config): void {
     if (loraTxPower !== null) {
         config.lora.txPower = loraTxPower;
     }
+    if (env.GATEWAY_SOCKET !== undefined) {
+        config.lora.gatewaySocket = env.GATEWAY_SOCKET;
+    }
+
+    // Wi-Fi uplink
+    config.iot = config.iot ?? { keysPath: '' };
+    if (env.IOT_KEYS !== undefined) {
+        config.iot.keysPath = env.IOT_KEYS;
+    }
 
     // Midnight
     if (env.MIDNIGHT_NODE_URL) {
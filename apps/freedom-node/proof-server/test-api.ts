@@ -150,7 +150,28 @@ async function runTests() {
         return { registered: registered.length };
     });
 
-    // Test 9: Check Status After Operations
+    // Test 9: Wi-Fi Uplink (an unsigned registration and echo claiming an
+    // address get nothing back; 503 without a bound-device key file)
+    await test('Wi-Fi Uplink Refuses Unsigned Batches', async () => {
+        const batch = (...messages: Buffer[]) => Buffer.concat(messages.flatMap((message) => {
+            const header = Buffer.alloc(2);
+            header.writeUInt16BE(message.length);
+            return [header, message];
+        }));
+        const registration = Buffer.concat([Buffer.from([0x00]), Buffer.from(randomHex(96), 'hex')]);
+        const response = await fetch(`${BASE_URL}/api/iot/uplink?address=4242`, {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/octet-stream' },
+            body: batch(registration, Buffer.from([0x04, 0x2a, 0, 0]))
+        });
+        if (response.status === 503) return { keys: false };
+        if (!response.ok) throw new Error(`HTTP ${response.status}`);
+        const body = Buffer.from(await response.arrayBuffer()).toString('hex');
+        if (body !== '') throw new Error(`Downlinks released to an unsigned batch: ${body}`);
+        return { keys: true };
+    });
+
+    // Test 10: Check Status After Operations
     await test('Status After Operations', async () => {
         const res = await fetchJSON(`${BASE_URL}/status`);
         console.log(`    └─ Devices: ${res.deviceCount}, Proofs: ${res.proofsGenerated}`);
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Compare Msingi benchmark results against a stored baseline.
+
+Accepts Google Benchmark JSON (native-bench with --benchmark_format=json or
+--benchmark_out) or a serial log from esp32s3-bench / --device-json, from
+which the block between BENCH_JSON_BEGIN and BENCH_JSON_END is extracted.
+
+Exit status is 1 if any case is slower than the baseline by more than the
+threshold, or if a baseline case is missing.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+CONSOLE_PREFIX = re.compile(r"^\[[^\]]*\]\s?")
+
+
+def load(path):
+    """Return {name: benchmark dict} from a JSON file or serial log."""
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+
+    if "BENCH_JSON_BEGIN" in text:
+        lines = []
+        inside = False
+        for line in text.splitlines():
+            line = CONSOLE_PREFIX.sub("", line.strip())
+            if line == "BENCH_JSON_BEGIN":
+                inside, lines = True, []
+            elif line == "BENCH_JSON_END":
+                inside = False
+            elif inside:
+                lines.append(line)
+        text = "\n".join(lines)
+
+    doc = json.loads(text)
+    # With --benchmark_repetitions the median aggregate wins over single runs
+    results = {}
+    medians = {}
+    for bench in doc.get("benchmarks", []):
+        run_type = bench.get("run_type", "iteration")
+        if run_type == "iteration":
+            results.setdefault(bench.get("run_name", bench["name"]), bench)
+        elif run_type == "aggregate" and bench.get("aggregate_name") == "median":
+            medians[bench["run_name"]] = bench
+    results.update(medians)
+    return doc, results
+
+
+def metric_value(bench, metric):
+    value = bench.get(metric)
+    if value is None:
+        return None
+    unit = bench.get("time_unit", "ns")
+    if metric in ("real_time", "cpu_time"):
+        value *= {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}[unit]
+    return float(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("current", help="New results (JSON or serial log)")
+    parser.add_argument("baseline", help="Baseline JSON")
+    parser.add_argument("--metric", default="cpu_time",
+                        help="cpu_time, real_time, cycles_per_iteration or a counter")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="Allowed slowdown in percent (default 10)")
+    parser.add_argument("--update", action="store_true",
+                        help="Write the current results to the baseline path")
+    args = parser.parse_args()
+
+    doc, current = load(args.current)
+    if args.update:
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump(doc, f, indent=2)
+            f.write("\n")
+        print(f"Baseline {args.baseline} updated ({len(current)} cases)")
+        return 0
+
+    _, baseline = load(args.baseline)
+    failed = False
+    print(f"{'case':<22} {'baseline':>14} {'current':>14} {'change':>9}")
+    for name, base in baseline.items():
+        if name not in current:
+            print(f"{name:<22} {'':>14} {'missing':>14}")
+            failed = True
+            continue
+        old = metric_value(base, args.metric)
+        new = metric_value(current[name], args.metric)
+        if old is None or new is None:
+            print(f"{name:<22} {'':>14} {'no ' + args.metric:>14}")
+            continue
+        if old == 0:
+            change = 0.0 if new == 0 else float("inf")
+        else:
+            change = 100.0 * (new - old) / old
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            failed = True
+        elif change < -args.threshold:
+            flag = "  faster"
+        print(f"{name:<22} {old:>14.1f} {new:>14.1f} {change:>+8.1f}%{flag}")
+
+    for name in current:
+        if name not in baseline:
+            print(f"{name:<22} {'new':>14} {metric_value(current[name], args.metric) or 0:>14.1f}")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
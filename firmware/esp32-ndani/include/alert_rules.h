@@ -0,0 +1,81 @@
+/**
+ * Alert Rules Header
+ *
+ * On-device threshold rules over sensor readings (frost, heat stress, dry
+ * soil), shared by the device, the gateway and the simulators:
+ * - Thresholds and the rules enabled are remote settings (alert_* in
+ *   config_protocol.h), with defaults in config.h
+ * - A rule trips when a reading crosses its threshold and trips again only
+ *   after the reading has come back past it by the hysteresis, so a value
+ *   hovering at the threshold raises one alert, not one per check
+ * - A reading that trips a rule carries a trailer item
+ *   (wire::TRAILER_ALERT) naming the rules, outside the signature
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef ALERT_RULES_H
+#define ALERT_RULES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace rcfg { struct Settings; }
+
+namespace alert {
+
+const uint8_t FROST = 0x01;       // Temperature below alert_temperature_low
+const uint8_t HEAT = 0x02;        // Temperature above alert_temperature_high
+const uint8_t DRY_SOIL = 0x04;    // Soil moisture below alert_soil_low
+const uint8_t ALL = FROST | HEAT | DRY_SOIL;
+
+const size_t TRAILER_SIZE = 3;    // Tag, length, rules
+
+/**
+ * Which rules are in alarm, for hysteresis
+ */
+class RuleState {
+public:
+  /**
+   * Check one reading against the enabled rules. NaN channels (sensor
+   * failed or switched off) neither trip nor clear a rule.
+   * @param settings Thresholds and rules enabled
+   * @param temperature Celsius
+   * @param soilMoisture Percent
+   * @return Rules that tripped with this reading (clear before it)
+   */
+  uint8_t update(const rcfg::Settings& settings, float temperature, float soilMoisture);
+
+  /**
+   * Rules currently in alarm
+   */
+  uint8_t active() const { return _active; }
+
+private:
+  uint8_t _active = 0;
+};
+
+/**
+ * Encode the trailer item
+ * @param rules Rules that tripped
+ * @param out Output (TRAILER_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeTrailer(uint8_t rules, uint8_t* out);
+
+/**
+ * Rules named in a reading's trailer
+ * @return 0 if the reading is not an alert
+ */
+uint8_t findAlerts(const uint8_t* message, size_t length);
+
+/**
+ * Comma-separated rule names ("frost,dry_soil"), for logs and records
+ * @param out Output (at least 24 bytes for every rule)
+ * @return Characters written
+ */
+size_t formatNames(uint8_t rules, char* out, size_t size);
+
+} // namespace alert
+
+#endif // ALERT_RULES_H
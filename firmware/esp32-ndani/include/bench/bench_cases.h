@@ -0,0 +1,81 @@
+/**
+ * Benchmark Cases Header
+ *
+ * Hot paths measured by the benchmark suite, shared by both runners:
+ * - Host: Google Benchmark (src/bench/bench_native.cpp, `native-bench`)
+ * - Device: CPU cycle counter, JSON over serial (`esp32s3-bench`)
+ *
+ * Case names are identical on both so results can be compared against
+ * the baselines in bench/ with bench/compare.py.
+ */
+
+#ifndef BENCH_CASES_H
+#define BENCH_CASES_H
+
+#include "hal.h"
+#include "secure_element.h"
+#include "lora_comm.h"
+#include "sensors.h"
+#include "brace_client.h"
+#include "merkle_tree.h"
+#include "wire_codec.h"
+
+namespace bench {
+
+/**
+ * Peripherals and sample data the cases operate on
+ */
+class Fixture {
+public:
+  /**
+   * Bring up the secure element and BRACE client, build a signed sample
+   * packet and the matching +RCV line
+   * @return true if the secure element is usable
+   */
+  bool begin();
+
+  SecureElement se;
+  LoRaComm lora;        // Not started; only BraceClient holds a pointer
+  Sensors sensors;      // Not started; calibration is pure math
+  BraceClient brace;
+
+  DataPacket packet;
+  uint8_t wireBytes[wire::DATA_PACKET_SIZE];
+  uint8_t registration[wire::REGISTRATION_SIZE];
+  char hex[2 * wire::DATA_PACKET_SIZE + 1];
+  char command[560];
+  char rcvLine[wire::RCV_LINE_MAX];
+  size_t rcvLen = 0;
+  uint8_t scratch[wire::DATA_PACKET_SIZE];
+  int soilRaw = 0;
+  uint32_t epoch = 0;
+  uint8_t merklePath[merkle::DEPTH][merkle::HASH_SIZE];
+  uint8_t merkleRoot[merkle::HASH_SIZE];
+};
+
+/**
+ * One benchmark: runs a single iteration of the measured operation
+ */
+struct Case {
+  const char* name;
+  bool (*run)(Fixture& fixture);
+  uint32_t minIterations;   // Device runner: lower bound per case
+};
+
+/**
+ * @param count Output: number of cases
+ * @return All cases, cheap codec paths first
+ */
+const Case* allCases(size_t* count);
+
+/**
+ * Run every case with the CPU cycle counter and print the results as
+ * Google Benchmark-compatible JSON between BENCH_JSON_BEGIN/END markers
+ * @param fixture Initialised fixture
+ * @param minTimeMs Minimum measured time per case
+ */
+void runCycleBenchmarks(Fixture& fixture, uint32_t minTimeMs);
+
+} // namespace bench
+
+#endif // BENCH_CASES_H
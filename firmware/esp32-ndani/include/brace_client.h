@@ -4,65 +4,124 @@
  * Implements the Blind Registration via Anonymous Commitment Enrollment protocol.
  * Device generates commitment C = H(pk || r) during registration.
  * The public key pk is derived from ATECC608B slot 0.
- * The blinding factor r is stored in slot 1.
+ *
+ * Registration is a state machine driven by poll():
+ * - Pending: the next attempt is scheduled. After a reset it comes at a
+ *   random time within BOOT_JITTER_MS, or within the backoff window the
+ *   attempts before the reset had reached.
+ * - AwaitingAck: the request went out; without an ACK (0x01) within
+ *   REG_ACK_TIMEOUT_MS the client backs off to a random time in the upper
+ *   half of a window that doubles per unanswered attempt
+ *   (REG_BACKOFF_MIN_MS to REG_BACKOFF_MAX_MS). A retry-after from the
+ *   gateway (registration_protocol.h) replaces the backoff.
+ * - Registered: the ACK arrived.
+ * The blinding factor r, the attempt count and whether the ACK arrived
+ * are kept in NVS ("brace"), so every attempt, before and after a reset,
+ * sends the same commitment and a registered device never registers again.
  */
 
 #ifndef BRACE_CLIENT_H
 #define BRACE_CLIENT_H
 
-#include <Arduino.h>
+#include "hal.h"
 #include "secure_element.h"
-#include "lora_comm.h"
+#include "transport.h"
 
 class BraceClient {
 public:
+  enum class State : uint8_t {
+    Pending,
+    AwaitingAck,
+    Registered
+  };
+
   /**
-   * Initialize the BRACE client
+   * Initialize the BRACE client, restore its progress from NVS and
+   * schedule the first attempt
    * @param se Pointer to secure element
-   * @param lora Pointer to LoRa communication
+   * @param link Link to the gateway (transport.h)
    */
-  void begin(SecureElement* se, LoRaComm* lora);
+  void begin(SecureElement* se, Transport* link);
   
   /**
-   * Check if device is already registered
-   * @return true if commitment has been computed and stored
+   * Check if the proof server has acknowledged the registration
    */
-  bool isRegistered();
+  bool isRegistered() const { return _state == State::Registered; }
+  
+  State state() const { return _state; }
   
   /**
-   * Register the device using BRACE protocol
-   * Generates commitment C = H(pk || r) and sends to proof server
-   * @return true if registration request sent
+   * Registration requests sent without an ACK so far (kept across resets)
    */
-  bool registerDevice();
+  uint8_t attempts() const { return _attempts; }
+  
+  /**
+   * Send the registration request if an attempt is due, or back off if
+   * the last one went unanswered. Call from the main loop.
+   * @return true if a registration request was sent
+   */
+  bool poll();
+  
+  /**
+   * Registration ACK (0x01) received
+   */
+  void onAck();
+  
+  /**
+   * Retry-after received: wait that long (plus jitter) before trying again
+   */
+  void onRetryAfter(uint32_t seconds);
+  
+  /**
+   * Milliseconds until poll() has work (an attempt or an ACK timeout)
+   * @return UINT32_MAX once registered
+   */
+  uint32_t msUntilDue() const;
   
   /**
    * Get the device commitment
    * @param commitment Output buffer (32 bytes)
-   * @return true if commitment exists
+   * @return true once a commitment has been computed (sent or restored)
    */
   bool getCommitment(uint8_t* commitment);
   
   /**
    * Get the Merkle proof for this device
-   * In production, this is received from proof server
+   * In production, this is received from proof server; siblings are
+   * hashed as in merkle_tree.h (merkle::verifyPath() checks one)
    * @param proof Output buffer for Merkle siblings
    * @param proofLen Output: number of siblings
    * @return true if proof available
    */
   bool getMerkleProof(uint8_t proof[][32], uint8_t* proofLen);
+  
+  /**
+   * Recompute C = H(domain || pk || r) from the device key and the
+   * current blinding factor
+   * @return true if successful
+   */
+  bool computeCommitment();
 
 private:
   SecureElement* _se = nullptr;
-  LoRaComm* _lora = nullptr;
+  Transport* _link = nullptr;
   
-  bool _registered = false;
+  State _state = State::Pending;
+  uint8_t _attempts = 0;
+  uint32_t _sinceMs = 0;            // Current wait started
+  uint32_t _waitMs = 0;
+  bool _haveBlindingFactor = false;
+  bool _haveCommitment = false;
   uint8_t _commitment[32];
-  uint8_t _blindingFactor[32];
+  uint8_t _blindingFactor[32] = {0};
   
+  bool registerDevice();
   bool generateBlindingFactor();
-  bool computeCommitment();
   bool sendRegistrationRequest();
+  void schedule(uint32_t waitMs);
+  void backOff();
+  uint32_t randomMs(uint32_t below);
+  void save();
 };
 
 #endif // BRACE_CLIENT_H
@@ -20,7 +20,8 @@
 // I2C Bus (ATECC608B + BME280)
 #define I2C_SDA_PIN 21
 #define I2C_SCL_PIN 22
-#define I2C_SPEED 100000  // 100kHz for ATECC608B compatibility
+#define I2C_SPEED 100000       // 100kHz for ATECC608B compatibility (its wake pulse)
+#define I2C_FAST_SPEED 400000  // BME280 and hub mux: switched to per transaction (i2c_bus.h)
 
 // ATECC608B Secure Element
 #define ATECC608B_I2C_ADDR 0x60
@@ -35,6 +36,16 @@
 #define SOIL_SENSOR_AIR_VALUE 3500
 #define SOIL_SENSOR_WATER_VALUE 1500
 
+// Sensor hub (probe_hub.h): extra soil probes on a 74HC4051 analog mux,
+// or straight on ADC pins, and extra BME280s behind a TCA9548A I2C mux
+// (ESP32-S3: analog inputs on ADC1, GPIO 1-10, which still reads with Wi-Fi
+// up; GPIO 22-25 do not exist and 35-37 belong to the octal PSRAM)
+#define HUB_SOIL_MUX_PIN 4                        // Mux output; -1 = probes on HUB_SOIL_PINS
+#define HUB_SOIL_SELECT_PINS {11, 12, 13}         // Mux S0-S2
+#define HUB_SOIL_PINS {4, 5, 6, 7, 8}             // Without the mux, probe n on pin n-1
+#define HUB_I2C_MUX_ADDR 0x70
+#define HUB_ENV_ADDR 0x77                         // Hub BME280s (SDO high)
+
 // Status LED
 #define STATUS_LED_PIN 2
 
@@ -60,7 +71,9 @@
 
 // ============= TIMING CONFIGURATION =============
 
-// Sensor reading interval (30 minutes in production)
+// Sensor reading interval (30 minutes in production). This and the LoRa
+// parameters above are defaults: remote settings (config_protocol.h) can
+// replace them in the field.
 #define SENSOR_INTERVAL_MS (30 * 60 * 1000)
 
 // Transmission retry settings
@@ -71,6 +84,92 @@
 #define ENABLE_DEEP_SLEEP true
 #define DEEP_SLEEP_DURATION_US (SENSOR_INTERVAL_MS * 1000ULL)
 
+// ============= REGISTRATION =============
+
+// BRACE registration pacing (brace_client.h, registration_protocol.h).
+// After a reset, the first registration attempt, or a registered node's
+// first sensor cycle, comes at a random time within BOOT_JITTER_MS, so a
+// site that loses power does not come back on air all at once.
+#define BOOT_JITTER_MS 120000
+#define REG_ACK_TIMEOUT_MS 15000           // Wait for the ACK, then back off
+#define REG_BACKOFF_MIN_MS 60000           // Window after the first unanswered attempt,
+#define REG_BACKOFF_MAX_MS 3600000         // doubling per attempt up to this
+#define REG_RETRY_JITTER_MS 5000           // Added to the gateway's retry-after
+
+// ============= ALERTS =============
+
+// Threshold rules (alert_rules.h) checked between reports: a reading that
+// trips one goes out at once, ahead of routine data. Defaults for the
+// alert_* remote settings.
+#define ALERT_RULES 0x05                   // Frost and dry soil
+#define ALERT_TEMPERATURE_LOW 2.0          // Frost below (Celsius)
+#define ALERT_TEMPERATURE_HIGH 40.0        // Heat stress above (Celsius)
+#define ALERT_SOIL_LOW 15.0                // Dry soil below (percent)
+#define ALERT_CHECK_INTERVAL_S 300         // Sensor checks between reports
+
+// A rule trips again only after the reading has come back this far
+#define ALERT_HYSTERESIS_TEMPERATURE 1.0
+#define ALERT_HYSTERESIS_SOIL 5.0
+
+// ============= HISTORY =============
+
+// Readings kept on the data partition (history_store.h) and pulled with
+// range queries. A query is answered in at most this many frames, sent
+// with half the airtime budget held back for readings and alerts.
+#define HISTORY_PULL_FRAMES 32
+
+// ============= EDGE ANALYTICS =============
+
+// Growing degree days (edge_analytics.h): base and cap for the crop, in
+// Celsius (10 / 30 suits maize)
+#define ANALYTICS_GDD_BASE 10.0f
+#define ANALYTICS_GDD_CAP 30.0f
+
+// Running statistics follow about a day of readings, and score anomalies
+// once a few hours have been seen
+#define ANALYTICS_WINDOW 288
+#define ANALYTICS_WARMUP 48
+#define ANALYTICS_ANOMALY_SIGMA 4.0f
+
+// Smallest standard deviation per channel, so sensor noise on a flat
+// signal does not score as an anomaly
+#define ANALYTICS_SD_FLOOR_TEMPERATURE 0.5f
+#define ANALYTICS_SD_FLOOR_HUMIDITY 2.0f
+#define ANALYTICS_SD_FLOOR_SOIL 2.0f
+
+// A wetting event: smoothed soil moisture rising at least this fast
+// (percent per hour) by at least this much (percent)
+#define ANALYTICS_SOIL_SMOOTHING 0.3f
+#define ANALYTICS_WETTING_RATE 2.0f
+#define ANALYTICS_WETTING_RISE 5.0f
+
+// ============= FEDERATED LEARNING =============
+
+// Local training of the soil-moisture forecaster (fl_client.h) when a
+// global model arrives: SGD over the last month of hourly history, then
+// the FL_UPDATE_DELTAS largest changes go back in one frame, with half the
+// airtime budget held back for readings
+#define FL_EPOCHS 8
+#define FL_LEARNING_RATE 0.04f  // First epoch; epoch e uses rate / (1 + e)
+#define FL_UPDATE_DELTAS 24
+
+// ============= SENSOR HUB =============
+
+// Extra probes read with each sensor cycle and signed into its reading
+// (probe_hub.h). The layout and per-probe calibration are provisioned in
+// NVS from the self-test console ("probe"); until then these apply.
+#define HUB_SOIL_PROBES 0          // Extra soil probes (0-8)
+#define HUB_ENV_MASK 0x00          // TCA9548A channels with a BME280
+#define HUB_SETTLE_MS 1            // After switching a mux channel
+
+// ============= MEMORY =============
+
+// RTC slow memory set aside for arena blocks (mem_arena.h). The ESP32-S3
+// has 8 KB, shared with anything else tagged RTC_DATA_ATTR.
+#define RTC_ARENA_BYTES 4096
+// `mem` on the self-test console flags a task with less stack left
+#define STACK_HEADROOM_MIN 1024
+
 // ============= SECURITY CONFIGURATION =============
 
 // ATECC608B slot allocations
@@ -82,13 +181,40 @@
 #define NULLIFIER_DOMAIN "msingi:nullifier:v1"
 #define COMMITMENT_DOMAIN "msingi:commitment:v1"
 
-// ============= PROOF SERVER CONFIGURATION =============
+// ============= OTA UPDATES =============
+
+// Release signing key (P-256 public key, X || Y, as a brace-less
+// initializer list). Offers must be signed by it. It is never in the
+// source: scripts/release_key.py supplies it from the release key's PEM
+// file, and native builds without one get a throwaway key.
+#if !defined(OTA_RELEASE_PUBLIC_KEY) && defined(ARDUINO)
+#error "OTA_RELEASE_PUBLIC_KEY is not set (custom_release_key or EDGECHAIN_RELEASE_KEY)"
+#endif
 
-// If using LoRa (default)
-// No URL needed - communicates via AT commands
+// Status report once chunks stop arriving, and again if nothing comes back
+#define OTA_STATUS_QUIET_MS 4000
+#define OTA_STATUS_RETRY_MS 60000
 
-// If using WiFi (for development only)
+// ============= PROOF SERVER CONFIGURATION =============
+
+// Over LoRa the gateway forwards to the proof server (no URL needed). Over
+// Wi-Fi readings are POSTed here (wifi_transport.h).
 #define PROOF_SERVER_URL "http://192.168.1.100:3001"
+#define PROOF_SERVER_UPLINK_PATH "/api/iot/uplink"
+
+// ============= LINKS =============
+
+// Links besides LoRa (transport.h); each message goes over the cheapest
+// one that is up. Wi-Fi for a node in reach of an access point: leave the
+// SSID empty everywhere else.
+#define WIFI_SSID ""
+#define WIFI_PASSWORD ""
+#define WIFI_BATCH_BYTES 2048              // Messages collected per POST
+#define WIFI_POST_TIMEOUT_MS 5000
+#define WIFI_POST_RETRIES 3                // Failed POSTs before a batch is dropped
+
+// A link whose send fails is passed over for this long, while another is up
+#define LINK_RETRY_MS 60000
 
 // ============= SENSOR CALIBRATION =============
 
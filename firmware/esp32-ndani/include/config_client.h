@@ -0,0 +1,55 @@
+/**
+ * Config Client Header
+ *
+ * Device side of remote configuration (see config_protocol.h). Settings
+ * start from config.h, are replaced only by a newer, fully valid config
+ * message addressed to this device, and are kept in NVS together with
+ * the version and the outcome of the last message heard, so they survive
+ * resets and deep sleep. The version report rides on every reading once
+ * a remote config has been heard.
+ *
+ * Messages not signed by the release key, and versions not newer than the
+ * one running, are dropped before anything is checked or stored.
+ */
+
+#ifndef CONFIG_CLIENT_H
+#define CONFIG_CLIENT_H
+
+#include "hal.h"
+#include "config_protocol.h"
+#include "secure_element.h"
+
+class ConfigClient {
+public:
+  /**
+   * Restore the persisted settings (config.h defaults if there are none,
+   * or if they are not valid for this firmware)
+   * @param se Secure element, to check config signatures
+   */
+  void begin(SecureElement* se);
+
+  /**
+   * Handle a config message (MSG_CONFIG)
+   * @return true if the settings changed
+   */
+  bool onConfig(const uint8_t* message, size_t length);
+
+  const rcfg::Settings& settings() const { return _settings; }
+  uint16_t version() const { return _report.applied; }
+
+  /**
+   * Reading trailer item with the version report
+   * @param out Output (wire::TRAILER_ITEM_HEADER_SIZE + rcfg::REPORT_SIZE bytes)
+   * @return Bytes written; 0 while no remote config has been heard
+   */
+  size_t appendReport(uint8_t* out) const;
+
+private:
+  SecureElement* _se = nullptr;
+  rcfg::Settings _settings;
+  rcfg::Report _report = {0, 0, rcfg::Result::None};
+
+  bool persist(const rcfg::Settings& settings, const rcfg::Report& report);
+};
+
+#endif // CONFIG_CLIENT_H
@@ -0,0 +1,228 @@
+/**
+ * Remote Configuration Protocol Header
+ *
+ * Operational settings that used to be compile-time constants (reporting
+ * interval, radio parameters, batching, sensors sampled, deadbands, alert
+ * rules) sent
+ * over the downlink, shared by the device (ConfigClient), the gateway's
+ * rollout and the simulators:
+ * - Config message (MSG_CONFIG): type, selector, group mask (u16 LE),
+ *   version (u16 LE), items (key, length, little-endian value), then a
+ *   P-256 signature (R || S) over everything before it by the release
+ *   key. It is signed off the gateway (edgechain-config-pack), so the
+ *   gateway can relay settings but not forge them. Sent to one address,
+ *   or broadcast (address 0) to every device or to the devices in any of
+ *   the selected groups.
+ * - A set of items is applied all at once or not at all: every item is
+ *   range-checked and the result is checked as a whole (duty cycle)
+ *   before anything changes.
+ * - Devices report the version they run in a reading trailer item
+ *   (wire::TRAILER_CONFIG): applied version, last version heard, and what
+ *   became of it.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef CONFIG_PROTOCOL_H
+#define CONFIG_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace rcfg {
+
+const size_t HEADER_SIZE = 6;          // Type, selector, groups, version
+const size_t SIGNATURE_SIZE = 64;      // After the items
+const size_t ITEMS_MAX = 50;           // What one frame leaves for items
+const size_t REPORT_SIZE = 5;          // Applied version, heard version, result
+const size_t BATCH_MAX = 4;            // Readings held back per transmission
+const size_t SETTINGS_ENCODED_MAX = 96;   // encodeSettings() output
+const uint32_t DUTY_CYCLE_PERMILLE = 10;   // Reading airtime per sample interval
+
+enum class Selector : uint8_t {
+  All = 0,
+  Groups = 1,      // Devices whose group mask shares a bit with the message's
+};
+
+/**
+ * Setting keys. Values are little-endian with the width given per key;
+ * the i16 ones are two's complement.
+ */
+enum class Key : uint8_t {
+  SampleIntervalS = 1,     // u32, 60-86400
+  BatchSize = 2,           // u8, 1-BATCH_MAX readings per transmission
+  SpreadingFactor = 3,     // u8, 7-12
+  BandwidthKHz = 4,        // u16, 125 / 250 / 500
+  TxPowerDbm = 5,          // u8, 0-20
+  SensorMask = 6,          // u8, bit 0 BME280, bit 1 soil probe; not 0
+  DeadbandTemperature = 7, // u16, 0.01 °C; 0 = always report
+  DeadbandHumidity = 8,    // u16, 0.01 %
+  DeadbandSoil = 9,        // u16, 0.01 %
+  Heartbeat = 10,          // u8, most readings suppressed in a row by the deadbands
+  Groups = 11,             // u16, group membership for Selector::Groups
+  AlertRules = 12,         // u8, rules enabled (alert_rules.h)
+  AlertTemperatureLow = 13,   // i16, 0.01 °C: frost below
+  AlertTemperatureHigh = 14,  // i16, 0.01 °C: heat stress above
+  AlertSoilLow = 15,       // u16, 0.01 %: dry soil below
+  AlertCheckS = 16,        // u16, 30-3600 s between rule checks; 0 = at reports only
+  AlertSpreadingFactor = 17,  // u8, 7-12 for alerts; 0 = spreading_factor
+  AlertTxPowerDbm = 18,    // u8, 1-20 for alerts; 0 = tx_power_dbm
+};
+
+/**
+ * What a device made of the last config message it heard
+ */
+enum class Result : uint8_t {
+  None = 0,
+  Applied = 1,
+  Stale = 2,           // Version not newer than the one running (older firmware; now ignored)
+  Invalid = 3,         // A value out of range, or the whole over the duty cycle
+  Unsupported = 4,     // Unknown key (newer protocol than the firmware)
+  NotAddressed = 5,    // Group message for other groups
+  StorageFailed = 6,   // Could not be persisted; not applied
+};
+
+const uint8_t SENSOR_BME280 = 0x01;
+const uint8_t SENSOR_SOIL = 0x02;
+
+/**
+ * Device settings. Defaults are the values in config.h.
+ */
+struct Settings {
+  uint32_t sampleIntervalS;
+  uint8_t batchSize;
+  uint8_t spreadingFactor;
+  uint16_t bandwidthKHz;
+  uint8_t txPowerDbm;
+  uint8_t sensorMask;
+  uint16_t deadbandTemperature;
+  uint16_t deadbandHumidity;
+  uint16_t deadbandSoil;
+  uint8_t heartbeat;
+  uint16_t groups;
+  uint8_t alertRules;
+  int16_t alertTemperatureLow;
+  int16_t alertTemperatureHigh;
+  uint16_t alertSoilLow;
+  uint16_t alertCheckS;
+  uint8_t alertSpreadingFactor;
+  uint8_t alertTxPowerDbm;
+};
+
+/**
+ * Config message header, items and signature not yet checked
+ */
+struct Config {
+  Selector selector;
+  uint16_t groups;
+  uint16_t version;
+  const uint8_t* items;
+  size_t itemsLen;
+  const uint8_t* signature;   // Over the first HEADER_SIZE + itemsLen bytes
+};
+
+/**
+ * Version report carried in the reading trailer
+ */
+struct Report {
+  uint16_t applied;
+  uint16_t heard;
+  Result result;
+};
+
+/**
+ * Settings from config.h
+ */
+Settings defaults();
+
+/**
+ * Parse the header of a config message
+ * @param message Message (starting with MSG_CONFIG)
+ * @param length Message length
+ * @param config Output; items and signature point into message
+ * @return false if it is not a config message (or carries no signature)
+ */
+bool parseConfig(const uint8_t* message, size_t length, Config* config);
+
+/**
+ * @return true if a device in the given groups should apply the message
+ */
+bool addressed(const Config& config, uint16_t deviceGroups);
+
+/**
+ * Apply items to a copy of the settings, check the result and copy it back
+ * only if everything is valid
+ * @param items Items (key, length, value)
+ * @param length Items length
+ * @param settings In: current settings. Out: updated only on Result::Applied
+ * @return Result::Applied, Result::Invalid or Result::Unsupported
+ */
+Result applyItems(const uint8_t* items, size_t length, Settings* settings);
+
+/**
+ * Check ranges, the alert thresholds against each other and the reading
+ * airtime against the duty cycle
+ */
+bool valid(const Settings& settings);
+
+/**
+ * Encode one item
+ * @param out Output (up to 6 bytes)
+ * @return Bytes written, 0 for an unknown key
+ */
+size_t encodeItem(Key key, uint32_t value, uint8_t* out);
+
+/**
+ * Encode every setting as items (what the device persists)
+ * @param out Output (SETTINGS_ENCODED_MAX bytes)
+ * @return Bytes written
+ */
+size_t encodeSettings(const Settings& settings, uint8_t* out);
+
+/**
+ * Build a config message without its signature; the release key's
+ * signature over the bytes written goes after them
+ * @param out Output (wire::MAX_FRAME_BYTES)
+ * @return Length before the signature, 0 if the items and the signature do
+ *         not fit one frame
+ */
+size_t encodeConfig(Selector selector, uint16_t groups, uint16_t version, const uint8_t* items,
+                    size_t itemsLen, uint8_t* out);
+
+/**
+ * Compile a settings file into a config message. Lines are "name value";
+ * "version N" is required and "groups MASK" selects groups (default all).
+ * Names are the Key identifiers in snake case (sample_interval_s, ...).
+ * Each value is range-checked on its own; cross-checks need the device's
+ * full settings and happen there. The message is left unsigned, as
+ * encodeConfig() leaves it.
+ * @param text File contents (NUL-terminated)
+ * @param out Output message (wire::MAX_FRAME_BYTES)
+ * @param outLen Output: message length, without the signature
+ * @param error Output: reason on failure, with the line number
+ * @param errorSize Error buffer size
+ * @return false if the file is malformed
+ */
+bool compileText(const char* text, uint8_t* out, size_t* outLen, char* error, size_t errorSize);
+
+/**
+ * Encode the trailer item (tag, length, report)
+ * @param out Output (wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeReport(const Report& report, uint8_t* out);
+
+/**
+ * Find the report in a reading's trailer
+ * @return false if the reading carries none
+ */
+bool findReport(const uint8_t* message, size_t length, Report* report);
+
+/**
+ * Human-readable result, for logs
+ */
+const char* resultName(Result result);
+
+} // namespace rcfg
+
+#endif // CONFIG_PROTOCOL_H
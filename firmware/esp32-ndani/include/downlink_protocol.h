@@ -0,0 +1,191 @@
+/**
+ * Downlink Protocol Header
+ *
+ * Downlink timing and coalescing, shared by the device and the gateway:
+ * - Bundle (wire::MSG_BUNDLE): type, then records of a length (u8) and a
+ *   whole downlink message. The gateway packs the short messages it holds
+ *   for one device into one frame; the device handles each record as if
+ *   it had arrived on its own.
+ * - Scheduler: the gateway's per-device downlink queues. The RYLR896 is
+ *   half-duplex, and the device's LoRaComm drops what arrives while it is
+ *   sending, so a downlink is only released inside the device's predicted
+ *   receive window:
+ *   - it opens once a burst of uplinks is over (no frame for the time on
+ *     air of a full frame plus RX_DELAY_MS)
+ *   - while the device's reading period is unknown it stays open
+ *     RX_WINDOW_MS, afterwards until GUARD_MS before the next reading
+ *     burst the period predicts
+ *   Frames are also kept out of the bursts of every other device, under
+ *   way or predicted (the gateway cannot hear them while it sends), for
+ *   up to HOLD_MAX_MS, and within the gateway's own duty cycle.
+ *
+ * Epoch updates, settings, time beacons and update offers replace one of
+ * the same type still queued; other messages are kept in order. Time
+ * beacons and fragments are sent alone (a beacon is stamped as it is
+ * written to the module).
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef DOWNLINK_PROTOCOL_H
+#define DOWNLINK_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <unordered_map>
+#include "uplink_queue.h"
+#include "wire_codec.h"
+
+namespace dl {
+
+const size_t BUNDLE_HEADER_SIZE = 1;         // Type
+const size_t RECORD_HEADER_SIZE = 1;         // Length
+
+const uint32_t RX_DELAY_MS = 500;            // Quiet after a burst, beyond one frame's airtime
+const uint32_t RX_WINDOW_MS = 60000;         // Window while the period is unknown
+const uint32_t GUARD_MS = 1000;              // Kept clear around a predicted reading burst
+const uint32_t HOLD_MAX_MS = 30000;          // Longest wait for other devices' bursts
+const uint32_t EXPIRY_MS = 6 * 3600000UL;    // Queued messages given up after this
+const size_t QUEUE_MAX = 32;                 // Messages per device
+const uint32_t DUTY_PERMILLE = 100;          // Gateway share of the air (10%)
+const size_t PERIODS = 4;                    // Reading bursts the period is taken over
+
+/**
+ * Whether a message may go into a bundle
+ */
+bool canBundle(const uint8_t* message, size_t length);
+
+/**
+ * Append a message to a bundle
+ * @param frame Bundle; an empty one (length 0) gets the header first
+ * @param length Bytes already in the bundle
+ * @param message Message to add
+ * @param messageLen Its length
+ * @return New bundle length, 0 if it does not fit in one frame
+ */
+size_t appendToBundle(uint8_t* frame, size_t length, const uint8_t* message, size_t messageLen);
+
+/**
+ * Iterate over a bundle's messages
+ * @param frame Bundle
+ * @param length Bundle length
+ * @param offset In: where to read, 0 to start. Out: after the message
+ * @param message Out: the message, inside the frame
+ * @param messageLen Out: its length
+ * @return false at the end or if the bundle is truncated
+ */
+bool nextInBundle(const uint8_t* frame, size_t length, size_t* offset, const uint8_t** message,
+                  size_t* messageLen);
+
+struct SchedulerStats {
+  uint64_t queued = 0;
+  uint64_t superseded = 0;      // Replaced by a newer one of the same type
+  uint64_t dropped = 0;         // Queue full, oldest dropped
+  uint64_t expired = 0;
+  uint64_t frames = 0;          // Released, bundles counting once
+  uint64_t messages = 0;
+  uint64_t bundled = 0;         // Messages that shared a frame
+  uint64_t budgetWaits = 0;     // Ticks a frame waited for the duty cycle
+  uint64_t uplinkWaits = 0;     // Ticks a frame waited for another device's burst
+  uint64_t airtimeUs = 0;       // Everything the gateway sent, scheduled or not
+};
+
+class Scheduler {
+public:
+  /**
+   * @param spreadingFactor Gateway spreading factor
+   * @param bandwidthKHz Gateway bandwidth
+   * @param dutyPermille Share of the air the gateway may use, 0 for no limit
+   */
+  Scheduler(uint8_t spreadingFactor, uint16_t bandwidthKHz, uint32_t dutyPermille);
+
+  /**
+   * A frame from a device ended
+   * @param address Device address
+   * @param reading A routine reading, on the device's period
+   * @param nowMs Current time
+   */
+  void onUplink(uint16_t address, bool reading, uint64_t nowMs);
+
+  /**
+   * Queue a downlink
+   * @param address Device address (not 0: broadcasts have no window)
+   * @param message Message or fragment (at most wire::MAX_FRAME_BYTES)
+   * @param length Its length
+   * @param nowMs Current time
+   * @return false if it cannot be queued
+   */
+  bool enqueue(uint16_t address, const uint8_t* message, size_t length, uint64_t nowMs);
+
+  /**
+   * The next frame to send now, if any: the device with the oldest
+   * message whose window is open, its short messages bundled. Charged
+   * against the duty cycle.
+   * @param nowMs Current time
+   * @param address Out: destination
+   * @param frame Out: wire::MAX_FRAME_BYTES
+   * @return Frame length, 0 if nothing may go now
+   */
+  size_t next(uint64_t nowMs, uint16_t* address, uint8_t* frame);
+
+  /**
+   * A frame sent outside the scheduler (broadcasts, echo replies,
+   * retry-afters): charged against the duty cycle
+   */
+  void onSent(size_t length, uint64_t nowMs);
+
+  /**
+   * Whether a device is predicted to be listening
+   */
+  bool listening(uint16_t address, uint64_t nowMs) const;
+
+  /**
+   * Messages queued for all devices
+   */
+  size_t pending() const { return _pending; }
+
+  /**
+   * Devices whose reading period is known
+   */
+  size_t predicted() const;
+
+  const SchedulerStats& stats() const { return _stats; }
+
+private:
+  struct Message {
+    uint64_t queuedMs;
+    uint8_t length;
+    uint8_t data[wire::MAX_FRAME_BYTES];
+  };
+
+  struct Device {
+    uint64_t lastFrameMs = 0;
+    uint64_t frameBurstMs = 0;        // First frame of the latest burst
+    uint64_t burstStartMs = 0;        // Of the last reading burst
+    uint64_t periodsMs[PERIODS] = {}; // Between reading bursts, newest first
+    uint64_t periodMs = 0;            // Shortest of them, 0 while unknown
+    std::deque<Message> queue;
+  };
+
+  uint8_t _spreadingFactor;
+  uint16_t _bandwidthKHz;
+  uint32_t _quietMs;
+  bool _limited;
+  AirtimeBudget _budget;
+  uint64_t _txUntilMs = 0;
+  std::unordered_map<uint16_t, Device> _devices;
+  size_t _pending = 0;
+  SchedulerStats _stats;
+
+  uint32_t airtimeUs(size_t length) const;
+  uint64_t nextBurstMs(const Device& device, uint64_t nowMs) const;
+  bool windowOpen(const Device& device, uint64_t startMs, uint64_t endMs) const;
+  bool clearOfBursts(uint16_t address, uint64_t startMs, uint64_t endMs) const;
+  size_t build(const Device& device, uint8_t* frame, size_t* count) const;
+  void expire(Device& device, uint64_t nowMs);
+};
+
+} // namespace dl
+
+#endif // DOWNLINK_PROTOCOL_H
@@ -0,0 +1,181 @@
+/**
+ * Edge Analytics Header
+ *
+ * Streaming agronomy over the node's own readings, shared by the device,
+ * the gateway and the simulators. Fixed memory and O(1) per sample:
+ * - Running mean and variance per channel (exponentially weighted, so
+ *   they follow the season rather than the node's whole life)
+ * - Growing degree days: (min(T, cap) - base) integrated over time
+ * - Vapour pressure deficit and dew point from temperature and humidity
+ * - Wetting events: soil moisture rising faster than a set rate by more
+ *   than a set amount (rain or irrigation)
+ * - Anomaly score: how far each channel is from its running mean, in
+ *   standard deviations; a score past the limit is an anomaly event
+ *
+ * Every reading carries a trailer item (wire::TRAILER_ANALYTICS) with the
+ * current values and the events raised since the last reading sent:
+ *   GDD total (u16 LE, 0.1 °C·day), VPD (u16 LE, Pa), dew point (i16 LE,
+ *   0.01 °C), anomaly score (u8, 0.1 σ, saturating), events (u8)
+ * A reading with events is sent even when the deadbands would hold it.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef EDGE_ANALYTICS_H
+#define EDGE_ANALYTICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace analytics {
+
+const uint8_t EVENT_WETTING = 0x01;      // Soil moisture rose (rain, irrigation)
+const uint8_t EVENT_ANOMALY = 0x02;      // A channel left its usual range
+const uint8_t EVENTS_ALL = EVENT_WETTING | EVENT_ANOMALY;
+
+const size_t REPORT_SIZE = 8;            // GDD, VPD, dew point, anomaly, events
+const uint16_t VPD_MISSING = 0xFFFF;     // Temperature or humidity not read
+const int16_t DEW_POINT_MISSING = INT16_MIN;
+
+const uint32_t MAX_STEP_S = 3600;        // Longer gaps count as one hour of GDD
+
+/**
+ * Values carried in the reading trailer
+ */
+struct Report {
+  uint16_t gddDeci;         // Growing degree days since provisioning, 0.1 °C·day
+  uint16_t vpdPa;           // Vapour pressure deficit, VPD_MISSING if not read
+  int16_t dewPointCenti;    // Dew point, 0.01 °C, DEW_POINT_MISSING if not read
+  uint8_t anomalyDeci;      // Largest channel z-score, 0.1 σ
+  uint8_t events;           // EVENT_* raised since the last reading sent
+};
+
+/**
+ * Dew point (Magnus formula)
+ * @param temperature Celsius
+ * @param humidity Relative humidity, percent
+ * @return Celsius, NaN if either input is NaN
+ */
+float dewPoint(float temperature, float humidity);
+
+/**
+ * Vapour pressure deficit (Tetens formula)
+ * @return kPa, NaN if either input is NaN
+ */
+float vaporPressureDeficit(float temperature, float humidity);
+
+/**
+ * Exponentially weighted mean and variance. Until `window` samples have
+ * been seen each one weighs 1/n, so early values are a plain average.
+ */
+class RunningStats {
+public:
+  void add(float value, uint16_t window);
+
+  /**
+   * Distance of a value from the mean in standard deviations
+   * @param floor Smallest standard deviation used, so a flat signal does
+   *              not turn sensor noise into large scores
+   */
+  float zScore(float value, float floor) const;
+
+  uint32_t count() const { return _count; }
+  float mean() const { return _mean; }
+  float variance() const { return _variance; }
+
+private:
+  uint32_t _count = 0;
+  float _mean = 0;
+  float _variance = 0;
+};
+
+class EdgeAnalytics {
+public:
+  static const size_t CHANNELS = 3;      // Temperature, humidity, soil moisture
+
+  /**
+   * Feed one reading. NaN channels are skipped.
+   * @param elapsedS Seconds since the previous reading (0 for the first)
+   * @return Events this reading raised
+   */
+  uint8_t update(uint32_t elapsedS, float temperature, float humidity, float soilMoisture);
+
+  /**
+   * Values for the next reading sent, with the events pending since the
+   * last one
+   */
+  Report report() const;
+
+  /**
+   * Events raised since the last reading sent
+   */
+  uint8_t pending() const { return _pending; }
+
+  /**
+   * A reading carrying the pending events was queued
+   */
+  void clearPending() { _pending = 0; }
+
+  /**
+   * Growing degree days, °C·day
+   */
+  float gdd() const { return _gdd; }
+
+  /**
+   * Continue the total kept across a reset
+   */
+  void setGdd(float gdd) { _gdd = gdd; }
+
+  const RunningStats& stats(size_t channel) const { return _stats[channel]; }
+  uint32_t wettingEvents() const { return _wettingEvents; }
+  uint32_t anomalyEvents() const { return _anomalyEvents; }
+
+private:
+  RunningStats _stats[CHANNELS];
+  float _gdd = 0;
+  float _vpd = NAN;
+  float _dewPoint = NAN;
+  float _anomaly = 0;
+  uint8_t _pending = 0;
+
+  // Wetting detection on smoothed soil moisture
+  bool _haveSoil = false;
+  float _soil = 0;
+  float _rise = 0;              // Rise so far in the current wetting front
+  bool _wetting = false;        // Event raised for the current front
+
+  uint32_t _wettingEvents = 0;
+  uint32_t _anomalyEvents = 0;
+};
+
+/**
+ * Encode the trailer item
+ * @param out Output (wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeTrailer(const Report& report, uint8_t* out);
+
+/**
+ * Report value as carried on the wire and in gateway records
+ * @param out Output (REPORT_SIZE bytes)
+ */
+void encodeReport(const Report& report, uint8_t* out);
+Report decodeReport(const uint8_t* value);
+
+/**
+ * Report in a reading's trailer
+ * @return false if the reading has none
+ */
+bool findReport(const uint8_t* message, size_t length, Report* report);
+
+/**
+ * Comma-separated event names ("wetting,anomaly"), for logs and records
+ * @param out Output (at least 16 bytes for every event)
+ * @return Characters written
+ */
+size_t formatEvents(uint8_t events, char* out, size_t size);
+
+} // namespace analytics
+
+#endif // EDGE_ANALYTICS_H
@@ -0,0 +1,106 @@
+/**
+ * Federated Learning Client Header
+ *
+ * Trains the soil-moisture forecaster (fl_protocol.h) on the device's own
+ * hourly history (history_store.h) and answers each global model with a
+ * sparse update, so a round costs two frames instead of the readings.
+ *
+ * - Samples: one per stored hour with the three hours before it and the
+ *   HORIZON_H hours after it. Features are soil moisture, its change over
+ *   one and three hours, mean temperature and humidity, the temperature
+ *   range, and the hour of day (sine, cosine); the target is the soil
+ *   moisture change over the horizon. Both are kept as int8 fixed point,
+ *   so a month of hours is under 7 KB of RAM.
+ * - Training: SGD in float from the global model, FL_EPOCHS passes in a
+ *   fixed shuffled order with a decaying rate, over the last SAMPLES_MAX
+ *   hours.
+ * - Update: the FL_UPDATE_DELTAS largest changes from the global model,
+ *   quantized with one shared shift. The rest of each change, and the
+ *   rounding error of what was sent, is carried into the next round's
+ *   update, so small steady changes still reach the server.
+ */
+
+#ifndef FL_CLIENT_H
+#define FL_CLIENT_H
+
+#include "fl_protocol.h"
+#include "history_store.h"
+
+class FlClient {
+public:
+  static const size_t SAMPLES_MAX = 30 * 24;   // Hours of history trained on
+
+  /**
+   * Training window, kept outside the client so it can live in PSRAM
+   * (mem_arena.h)
+   */
+  struct Samples {
+    int8_t features[SAMPLES_MAX][fl::INPUTS];
+    int8_t targets[SAMPLES_MAX];
+  };
+
+  /**
+   * Attach the training window; without one train() has no samples
+   */
+  void begin(Samples* window) { _window = window; }
+
+  /**
+   * A global model arrived
+   * @return true if it starts a round not trained yet
+   */
+  bool onModel(const uint8_t* frame, size_t length);
+
+  /**
+   * A model is waiting for train()
+   */
+  bool trainingDue() const { return _trainingDue; }
+
+  /**
+   * Train on the hourly history before `now` and build the update
+   * @param now Unix seconds (0 if the clock is not synced: no samples)
+   */
+  void train(HistoryStore& history, uint32_t now);
+
+  /**
+   * An update is waiting for the radio
+   */
+  bool updateReady() const { return _updateReady; }
+
+  /**
+   * Encode the update
+   * @param out Output (wire::MAX_FRAME_BYTES)
+   * @return Frame length
+   */
+  size_t encodeUpdate(uint8_t* out) const { return fl::encodeUpdate(_update, out); }
+
+  void updateSent() { _updateReady = false; }
+
+  /**
+   * Last update built (for logs and the simulators)
+   */
+  const fl::Update& update() const { return _update; }
+
+private:
+  static const int FEATURE_SHIFT = 6;   // Features are q / 64, ±2
+  static const int TARGET_SHIFT = 5;    // Targets are q / 32 tens of percent, ±40 %
+
+  float _global[fl::PARAMS];
+  float _local[fl::PARAMS];
+  float _residual[fl::PARAMS] = {0};   // Change not sent yet
+  uint16_t _round = 0;
+  bool _haveModel = false;
+  bool _trainingDue = false;
+  bool _updateReady = false;
+  fl::Update _update = {};
+
+  Samples* _window = nullptr;
+  size_t _samples = 0;
+
+  void collect(HistoryStore& history, uint32_t now);
+  float predict(const float* params, const int8_t* x, float* hidden) const;
+  void step(const int8_t* x, float target, float rate);
+  float rmse(const float* params) const;
+  void sparsify();
+};
+
+#endif // FL_CLIENT_H
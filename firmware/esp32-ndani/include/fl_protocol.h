@@ -0,0 +1,109 @@
+/**
+ * Federated Learning Protocol Header
+ *
+ * A small soil-moisture forecaster trained on the devices themselves
+ * (fl_client.h), shared by the device, the gateway and the simulators.
+ * Rounds cost one frame each way instead of the device's history:
+ * - Model: INPUTS -> HIDDEN (ReLU) -> 1, predicting the change in soil
+ *   moisture over the next HORIZON_H hours from hourly features. PARAMS
+ *   values, laid out as hidden weights (row per hidden unit), hidden
+ *   biases, output weights, output bias.
+ * - Global model (MSG_FL_MODEL): type, round (u16 LE), one shift per
+ *   tensor (i8), then every parameter as i8. A value is q / 2^shift, so
+ *   each tensor gets the finest power-of-two step that still holds its
+ *   largest value.
+ * - Update (MSG_FL_UPDATE): type, round (u16 LE), training samples
+ *   (u16 LE), forecast RMSE before and after local training (u16 LE,
+ *   0.01 % soil moisture), shift (i8), delta count (u8), then that many
+ *   (parameter index u8, delta i8) pairs: the largest changes the device
+ *   made to the global model, each delta / 2^shift. What does not make
+ *   the cut is carried into the device's next update.
+ *
+ * Updates are not signed, like history frames: they tune a forecaster,
+ * they do not earn rewards.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef FL_PROTOCOL_H
+#define FL_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wire_codec.h"
+
+namespace fl {
+
+const size_t INPUTS = 8;
+const size_t HIDDEN = 8;
+const size_t TENSORS = 4;                     // Hidden weights and biases, output weights and bias
+const size_t PARAMS = HIDDEN * INPUTS + HIDDEN + HIDDEN + 1;
+const uint32_t HORIZON_H = 6;                 // Forecast this many hours ahead
+
+const size_t MODEL_HEADER_SIZE = 3 + TENSORS; // Type, round, shifts
+const size_t MODEL_SIZE = MODEL_HEADER_SIZE + PARAMS;
+const size_t UPDATE_HEADER_SIZE = 11;         // Type, round, samples, RMSE × 2, shift, count
+const size_t UPDATE_DELTAS_MAX = (wire::MAX_FRAME_BYTES - UPDATE_HEADER_SIZE) / 2;
+
+/**
+ * First parameter and size of each tensor
+ */
+size_t tensorOffset(size_t tensor);
+size_t tensorSize(size_t tensor);
+
+/**
+ * Finest power-of-two shift that keeps a value within int8
+ * @param maxAbs Largest magnitude to represent
+ */
+int8_t shiftFor(float maxAbs);
+
+/**
+ * Round and saturate value × 2^shift to int8
+ */
+int8_t quantize(float value, int8_t shift);
+float dequantize(int8_t value, int8_t shift);
+
+/**
+ * Encode a global model
+ * @param params PARAMS values
+ * @param out Output (MODEL_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeModel(uint16_t round, const float* params, uint8_t* out);
+
+/**
+ * Parse a global model
+ * @param params Output: PARAMS values
+ * @return false if malformed
+ */
+bool parseModel(const uint8_t* frame, size_t length, uint16_t* round, float* params);
+
+struct Delta {
+  uint8_t index;            // Parameter
+  int8_t value;             // Change, value / 2^shift
+};
+
+struct Update {
+  uint16_t round;
+  uint16_t samples;         // Training samples seen
+  uint16_t rmseBefore;      // Forecast RMSE of the global model, 0.01 %
+  uint16_t rmseAfter;       // ... and of the locally trained one
+  int8_t shift;
+  uint8_t count;
+  Delta deltas[UPDATE_DELTAS_MAX];
+};
+
+/**
+ * @param out Output (UPDATE_HEADER_SIZE + 2 × update.count bytes)
+ * @return Bytes written
+ */
+size_t encodeUpdate(const Update& update, uint8_t* out);
+
+/**
+ * @return false if malformed (length, parameter index out of range)
+ */
+bool parseUpdate(const uint8_t* frame, size_t length, Update* update);
+
+} // namespace fl
+
+#endif // FL_PROTOCOL_H
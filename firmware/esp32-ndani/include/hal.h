@@ -0,0 +1,443 @@
+/**
+ * Hardware Abstraction Layer Header
+ *
+ * Boundary between the Msingi firmware and the board it runs on.
+ * On the ESP32-S3 every call forwards to the Arduino core and the
+ * peripheral libraries (src/hal_esp32.cpp). In the `native` PlatformIO
+ * environment the same calls are served by the simulated board in
+ * src/sim/, which runs against a virtual clock so the whole device can
+ * execute on a Linux host.
+ *
+ * Firmware modules include this header instead of <Arduino.h> and use
+ * hal::millis(), hal::delay() etc. instead of the Arduino globals.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "hal_native.h"
+#endif
+
+class I2cBus;
+class MemArena;
+class Transport;
+
+namespace hal {
+
+// ============= TIME =============
+
+/**
+ * Milliseconds since boot (wraps after ~49 days, like Arduino millis())
+ */
+uint32_t millis();
+
+/**
+ * Microseconds since boot
+ */
+uint32_t micros();
+
+/**
+ * Block for the given number of milliseconds
+ * @param ms Delay in milliseconds
+ */
+void delay(uint32_t ms);
+
+/**
+ * CPU cycle counter (wraps; use differences only)
+ */
+uint32_t cycleCount();
+
+/**
+ * CPU clock in MHz, for converting cycleCount() differences to time
+ */
+uint32_t cpuFrequencyMhz();
+
+// ============= UART =============
+
+/**
+ * Byte-oriented serial port (RYLR896 LoRa module link)
+ */
+class Uart {
+public:
+  virtual ~Uart() = default;
+
+  /**
+   * Open the port
+   * @param baud Baud rate
+   * @param rxPin ESP32 RX pin
+   * @param txPin ESP32 TX pin
+   */
+  virtual void begin(uint32_t baud, int rxPin, int txPin) = 0;
+
+  /**
+   * @return Number of bytes waiting to be read
+   */
+  virtual int available() = 0;
+
+  /**
+   * @return Next byte, or -1 if none is waiting
+   */
+  virtual int read() = 0;
+
+  /**
+   * Write raw bytes to the port
+   * @return Number of bytes written
+   */
+  virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+  /**
+   * Write a string followed by CR LF (AT command terminator)
+   */
+  size_t println(const char* line) {
+    size_t n = write((const uint8_t*)line, strlen(line));
+    return n + write((const uint8_t*)"\r\n", 2);
+  }
+};
+
+/**
+ * UART connected to the RYLR896 LoRa module (UART2 on the Msingi board)
+ */
+Uart& loraUart();
+
+// ============= I2C / GPIO / ADC =============
+
+/**
+ * Initialize the shared I2C bus (ATECC608B + BME280)
+ * @param sdaPin SDA pin
+ * @param sclPin SCL pin
+ * @param clockHz Bus clock in Hz
+ */
+void i2cBegin(int sdaPin, int sclPin, uint32_t clockHz);
+
+/**
+ * Change the bus clock between transactions
+ */
+void i2cSetClock(uint32_t clockHz);
+
+/**
+ * Take the bus for the calling task, waiting while another task has it.
+ * Recursive: the holder may take it again, and releases it as often.
+ */
+void i2cLock();
+
+/**
+ * Take the bus only if no other task has it
+ * @return true if taken
+ */
+bool i2cTryLock();
+
+void i2cUnlock();
+
+/**
+ * The board's I2C bus manager (i2c_bus.h), through which the firmware
+ * does its I2C transactions
+ */
+I2cBus& i2cBus();
+
+/**
+ * Read consecutive registers from an I2C device
+ * @param address 7-bit device address
+ * @param reg First register
+ * @param data Output buffer
+ * @param length Number of bytes to read
+ * @return true if the device acknowledged and returned all bytes
+ */
+bool i2cRead(uint8_t address, uint8_t reg, uint8_t* data, size_t length);
+
+/**
+ * Write bytes to an I2C device without a register address (TCA9548A
+ * channel select)
+ * @return true if the device acknowledged every byte
+ */
+bool i2cWrite(uint8_t address, const uint8_t* data, size_t length);
+
+/**
+ * Configure a pin as analog/digital input
+ */
+void pinModeInput(int pin);
+
+/**
+ * Configure a pin as digital output, and drive it
+ */
+void pinModeOutput(int pin);
+void digitalWrite(int pin, bool high);
+
+/**
+ * Read a 12-bit ADC sample (0-4095)
+ */
+int analogRead(int pin);
+
+// ============= ENVIRONMENTAL SENSOR =============
+
+/**
+ * BME280 temperature / humidity / pressure sensor
+ */
+class EnvSensor {
+public:
+  virtual ~EnvSensor() = default;
+
+  /**
+   * Probe and configure the sensor for forced-mode, x1 oversampling
+   * @param address I2C address (0x76 or 0x77)
+   * @return true if the sensor responded
+   */
+  virtual bool begin(uint8_t address) = 0;
+
+  /**
+   * Trigger one forced-mode conversion and wait for it to finish
+   */
+  virtual void takeForcedMeasurement() = 0;
+
+  virtual float readTemperature() = 0;  // Celsius
+  virtual float readHumidity() = 0;     // Percentage (0-100)
+  virtual float readPressure() = 0;     // Pascal
+};
+
+/**
+ * The board's BME280
+ */
+EnvSensor& envSensor();
+
+/**
+ * BME280 on one channel of the sensor hub's I2C mux (probe_hub.h); only
+ * reachable while that channel is selected
+ * @param channel Mux channel (0-7)
+ */
+EnvSensor& hubEnvSensor(uint8_t channel);
+
+// ============= FIRMWARE SLOTS =============
+
+/**
+ * The two OTA app partitions: the running image (read-only) and the
+ * inactive one that an update is written into. Offsets are relative to
+ * the start of the partition. Flash semantics: erase sets whole sectors
+ * to 0xFF, writes can only clear bits.
+ */
+class FirmwareSlots {
+public:
+  static const size_t SECTOR_SIZE = 4096;
+
+  virtual ~FirmwareSlots() = default;
+
+  /**
+   * @return Size of the running image in bytes (0 if it cannot be determined)
+   */
+  virtual size_t runningSize() = 0;
+
+  /**
+   * Read from the running partition
+   * @return true if all bytes were read
+   */
+  virtual bool readRunning(size_t offset, uint8_t* data, size_t length) = 0;
+
+  /**
+   * @return Size of the inactive partition in bytes (0 if there is none)
+   */
+  virtual size_t updateCapacity() = 0;
+
+  /**
+   * Erase part of the inactive partition
+   * @param offset Start, a multiple of SECTOR_SIZE
+   * @param length Length, a multiple of SECTOR_SIZE
+   */
+  virtual bool eraseUpdate(size_t offset, size_t length) = 0;
+
+  virtual bool writeUpdate(size_t offset, const uint8_t* data, size_t length) = 0;
+  virtual bool readUpdate(size_t offset, uint8_t* data, size_t length) = 0;
+
+  /**
+   * Boot the inactive partition from the next restart on
+   * @param length Image size written at offset 0
+   * @return false if the bootloader rejects the image
+   */
+  virtual bool activateUpdate(size_t length) = 0;
+
+  /**
+   * Mark the running image good, so the bootloader does not roll it back
+   */
+  virtual void confirmRunning() = 0;
+};
+
+/**
+ * The board's app partitions
+ */
+FirmwareSlots& firmwareSlots();
+
+/**
+ * Reboot the device (setup() runs again)
+ */
+void restart();
+
+// ============= DATA PARTITION =============
+
+/**
+ * Raw data partition for the on-device history (the "spiffs" data
+ * partition of the 16 MB layout, which nothing else mounts). Offsets and
+ * flash semantics as for FirmwareSlots.
+ */
+class DataPartition {
+public:
+  static const size_t SECTOR_SIZE = 4096;
+
+  virtual ~DataPartition() = default;
+
+  /**
+   * @return Partition size in bytes (0 if there is none)
+   */
+  virtual size_t size() = 0;
+
+  /**
+   * Erase whole sectors
+   * @param offset Start, a multiple of SECTOR_SIZE
+   * @param length Length, a multiple of SECTOR_SIZE
+   */
+  virtual bool erase(size_t offset, size_t length) = 0;
+
+  virtual bool write(size_t offset, const uint8_t* data, size_t length) = 0;
+  virtual bool read(size_t offset, uint8_t* data, size_t length) = 0;
+};
+
+/**
+ * The board's history partition
+ */
+DataPartition& historyPartition();
+
+// ============= NON-VOLATILE STORAGE =============
+
+/**
+ * Small named records that survive resets and power loss (the NVS
+ * partition on the ESP32). A put either replaces the whole record or
+ * leaves the old one in place.
+ */
+class Nvs {
+public:
+  static const size_t KEY_MAX = 15;   // Longest key name
+
+  virtual ~Nvs() = default;
+
+  /**
+   * Read a record
+   * @param key Record name
+   * @param data Output buffer
+   * @param maxLength Output capacity
+   * @return Record length, 0 if it does not exist or does not fit
+   */
+  virtual size_t get(const char* key, void* data, size_t maxLength) = 0;
+
+  /**
+   * Write (replace) a record
+   * @return true once the record is committed
+   */
+  virtual bool put(const char* key, const void* data, size_t length) = 0;
+
+  /**
+   * Delete a record
+   */
+  virtual void remove(const char* key) = 0;
+};
+
+/**
+ * The board's NVS partition
+ */
+Nvs& nvs();
+
+// ============= WI-FI =============
+
+/**
+ * Start joining an access point; the station keeps reconnecting in the
+ * background
+ * @return false if there is no Wi-Fi (host builds)
+ */
+bool wifiBegin(const char* ssid, const char* password);
+
+/**
+ * Whether the station is associated and has an address
+ */
+bool wifiConnected();
+
+/**
+ * HTTP POST over a kept-alive connection (reopened when the server or
+ * the network dropped it)
+ * @param url Full URL
+ * @param body Request body (application/octet-stream)
+ * @param response Response body output
+ * @param maxResponse Output capacity; a longer body is cut short
+ * @param responseLength Bytes written to response
+ * @param timeoutMs Connect and read timeout
+ * @return HTTP status, or a negative value if no answer came
+ */
+int httpPost(const char* url, const uint8_t* body, size_t length, uint8_t* response,
+             size_t maxResponse, size_t* responseLength, uint32_t timeoutMs);
+
+/**
+ * A link the host attaches for testing (the simulators' loopback,
+ * sim/loopback_transport.h)
+ * @return nullptr on the device, and when none is attached
+ */
+Transport* hostLink();
+
+// ============= MEMORY =============
+
+/**
+ * Where a buffer lives: internal SRAM (fast, shared with the task stacks
+ * and the heap), the 8 MB octal PSRAM, or the RTC_ARENA_BYTES pool in RTC
+ * slow memory
+ */
+enum class MemRegion : uint8_t {
+  Internal,
+  Psram,
+  Rtc
+};
+const size_t MEM_REGIONS = 3;
+
+/**
+ * Allocate zeroed memory in a region for the rest of the boot (never freed)
+ * @return nullptr if the region is missing or has no room
+ */
+void* memAlloc(MemRegion region, size_t bytes);
+
+struct HeapInfo {
+  size_t totalBytes;
+  size_t freeBytes;
+  size_t largestFreeBlock;    // Biggest single allocation that would succeed
+  size_t minFreeBytes;        // Low-water mark since boot
+};
+
+/**
+ * Heap state of a region
+ * @return false if the region is missing or not measured (host builds)
+ */
+bool heapInfo(MemRegion region, HeapInfo* info);
+
+struct TaskStack {
+  const char* name;
+  size_t sizeBytes;           // 0 if not known
+  size_t minFreeBytes;        // High-water mark: least free stack seen
+};
+
+/**
+ * Stack high-water marks of the firmware's tasks and the system tasks
+ * next to them
+ * @param out Output
+ * @param max Output capacity
+ * @return Tasks written (0 on host builds, which have no RTOS tasks)
+ */
+size_t taskStacks(TaskStack* out, size_t max);
+
+/**
+ * The board's arena of long-lived buffers (mem_arena.h)
+ */
+MemArena& memArena();
+
+} // namespace hal
+
+#endif // HAL_H
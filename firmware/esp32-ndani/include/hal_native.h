@@ -0,0 +1,42 @@
+/**
+ * Native Host Shims
+ *
+ * Minimal stand-ins for the Arduino globals that the firmware uses for
+ * diagnostics when it is built for the `native` environment. Only the
+ * debug console lives here; all peripherals go through hal.h.
+ */
+
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#ifdef ARDUINO
+#error "hal_native.h is only used by the native host build"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Debug console compatible with the subset of Arduino's Serial API used by
+ * the firmware. Output is routed to the active simulated board, which
+ * prefixes it with the virtual time or suppresses it in quiet runs.
+ */
+class HostConsole {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  explicit operator bool() const { return true; }
+
+  // Input queued on the simulated board (Board::queueConsoleInput)
+  int available();
+  int read();
+
+  size_t print(const char* text);
+  size_t print(int value);
+  size_t println(const char* text = "");
+  size_t println(int value);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HostConsole Serial;
+
+#endif // HAL_NATIVE_H
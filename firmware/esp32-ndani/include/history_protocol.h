@@ -0,0 +1,164 @@
+/**
+ * History Protocol Header
+ *
+ * Range queries against a device's on-device history (history_store.h),
+ * shared by the device, the gateway and the simulators:
+ * - Query (MSG_HISTORY_QUERY): type, request id, from and to (Unix
+ *   seconds, u32 LE, to exclusive), resolution in seconds (u32 LE). The
+ *   device answers from the coarsest tier that still meets the
+ *   resolution: daily summaries for a day or more, hourly ones for an
+ *   hour or more, else the raw samples.
+ * - Response (MSG_HISTORY): type, request id, tier | flags, frame index,
+ *   base time (u32 LE), then fixed-size records in time order. Each
+ *   record starts with its offset from the base time (u16 LE, seconds
+ *   for raw samples, hours or days for summaries):
+ *     raw:     offset, temperature, humidity, soil moisture
+ *     summary: offset, sample count (u16 LE), then min, mean, max for
+ *              temperature, humidity and soil moisture
+ *   Values are i16 LE hundredths, INT16_MIN where the channel was not
+ *   read. One unfragmented frame per response; the last frame of a query
+ *   carries FLAG_LAST, or FLAG_TRUNCATED when the device stopped at its
+ *   frame limit (query again from the last time received).
+ *
+ * History frames are not signed: they are for agronomy dashboards, not
+ * proofs. Readings that earn rewards still go out as signed DataPackets.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef HISTORY_PROTOCOL_H
+#define HISTORY_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wire_codec.h"
+
+namespace hist {
+
+const size_t CHANNELS = 3;                   // Temperature, humidity, soil moisture
+const int16_t MISSING = INT16_MIN;           // Channel switched off or not read
+const size_t QUERY_SIZE = 14;                // Type, id, from, to, resolution
+const size_t RESPONSE_HEADER_SIZE = 8;       // Type, id, tier | flags, index, base time
+const size_t RAW_RECORD_SIZE = 8;            // Offset, three values
+const size_t SUMMARY_RECORD_SIZE = 22;       // Offset, count, three × min / mean / max
+const uint8_t FLAG_LAST = 0x80;              // Query answered completely
+const uint8_t FLAG_TRUNCATED = 0x40;         // Frame limit reached before the end
+const uint8_t TIER_MASK = 0x03;
+
+enum class Tier : uint8_t {
+  Raw = 0,
+  Hourly = 1,
+  Daily = 2,
+};
+
+const size_t TIERS = 3;
+
+/**
+ * One stored reading
+ */
+struct Sample {
+  uint32_t time;                // Unix seconds
+  int16_t value[CHANNELS];      // Hundredths of °C / % / %
+};
+
+/**
+ * Rollup of the samples in one hour or day
+ */
+struct Summary {
+  uint32_t start;               // Unix seconds, a multiple of the tier period
+  uint16_t count;               // Samples (saturates)
+  int16_t min[CHANNELS];
+  int16_t mean[CHANNELS];
+  int16_t max[CHANNELS];
+};
+
+struct Query {
+  uint8_t id;
+  uint32_t from;
+  uint32_t to;
+  uint32_t resolutionS;
+};
+
+struct ResponseHeader {
+  uint8_t id;
+  Tier tier;
+  uint8_t flags;
+  uint8_t index;                // Frame number within the response
+  uint32_t base;
+  size_t records;
+};
+
+/**
+ * @return Seconds per record of a summary tier, 0 for raw samples
+ */
+uint32_t tierSeconds(Tier tier);
+
+/**
+ * Coarsest tier whose period does not exceed the requested resolution
+ */
+Tier tierFor(uint32_t resolutionS);
+
+const char* tierName(Tier tier);
+
+/**
+ * Sensor value as stored: hundredths, saturated, MISSING for NaN
+ */
+int16_t toFixed(float value);
+
+size_t encodeQuery(const Query& query, uint8_t* out);
+
+/**
+ * @return false if malformed (wrong length, empty range)
+ */
+bool parseQuery(const uint8_t* frame, size_t length, Query* query);
+
+/**
+ * Fills one response frame. Records must be added in time order; add()
+ * refuses one that does not fit or is too far from the frame's first.
+ */
+class ResponseWriter {
+public:
+  /**
+   * @param out Output (wire::MAX_FRAME_BYTES)
+   */
+  ResponseWriter(uint8_t* out, uint8_t id, Tier tier, uint8_t index);
+
+  bool add(const Sample& sample);
+  bool add(const Summary& summary);
+
+  size_t records() const { return _records; }
+
+  /**
+   * Write the flags
+   * @return Frame length
+   */
+  size_t finish(uint8_t flags);
+
+private:
+  uint8_t* _out;
+  size_t _length = RESPONSE_HEADER_SIZE;
+  size_t _records = 0;
+  uint32_t _base = 0;
+
+  bool offset(uint32_t time, uint32_t unit, size_t recordSize);
+};
+
+/**
+ * Check a response frame and read its header
+ * @return false if malformed
+ */
+bool parseResponse(const uint8_t* frame, size_t length, ResponseHeader* header);
+
+/**
+ * Record of a raw response (index < header.records)
+ */
+Sample rawRecord(const uint8_t* frame, const ResponseHeader& header, size_t index);
+
+/**
+ * Record of an hourly or daily response (index < header.records)
+ */
+Summary summaryRecord(const uint8_t* frame, const ResponseHeader& header, size_t index);
+
+} // namespace hist
+
+#endif // HISTORY_PROTOCOL_H
@@ -0,0 +1,148 @@
+/**
+ * History Store Header
+ *
+ * Months of readings kept on the device's data partition, so a farmer
+ * or agronomist can pull past conditions over the downlink after an
+ * outage or for a season report, without the device re-sending signed
+ * DataPackets. Three tiers:
+ * - Raw: every reading the node takes once its clock is synced
+ * - Hourly and daily: sample count and min / mean / max per channel,
+ *   rolled up in RAM as samples arrive and written when the period ends
+ *
+ * Each tier is a ring of flash sectors. A sector holds a header (magic,
+ * tier, sequence number) and fixed-size records in time order; when the
+ * ring is full its oldest sector is erased for the next. The first record
+ * of each sector is the time index: a range query binary-searches the
+ * sectors, then scans one. A record's time is written after the rest of
+ * it, so one cut short by a reset reads as unwritten and is skipped.
+ */
+
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include "hal.h"
+#include "history_protocol.h"
+
+/**
+ * Running min / mean / max of one period
+ */
+class Rollup {
+public:
+  /**
+   * Start an empty period
+   */
+  void reset(uint32_t start);
+
+  void add(const hist::Sample& sample);
+
+  /**
+   * Fold in a finer period's summary, weighted by its sample count
+   */
+  void merge(const hist::Summary& summary);
+
+  bool empty() const { return _count == 0; }
+  uint32_t start() const { return _start; }
+  hist::Summary summary() const;
+
+private:
+  uint32_t _start = 0;
+  uint32_t _count = 0;
+  int64_t _sum[hist::CHANNELS] = {0};
+  uint32_t _weight[hist::CHANNELS] = {0};
+  int16_t _min[hist::CHANNELS];
+  int16_t _max[hist::CHANNELS];
+};
+
+class HistoryStore {
+public:
+  static const uint16_t MAGIC = 0x4853;          // "HS"
+  static const uint8_t FORMAT = 1;               // Record layout version
+  static const size_t SECTOR_HEADER_SIZE = 8;    // Magic, tier, format, sequence
+  static const size_t RAW_SIZE = 10;             // Time, three values
+  static const size_t SUMMARY_SIZE = 24;         // Start, count, three × min / mean / max
+  static const size_t MIN_SECTORS = 16;
+
+  /**
+   * Position in a tier: records from the oldest, then the period still
+   * being rolled up
+   */
+  struct Cursor {
+    hist::Tier tier;
+    size_t position;
+    uint32_t from;
+  };
+
+  /**
+   * Mount the partition: find each ring's newest sector and rebuild the
+   * hour and day in progress from the records below them
+   * @return false if the partition is missing or too small
+   */
+  bool begin(hal::DataPartition& flash);
+
+  /**
+   * Store a sample and roll it up
+   * @return false if not mounted, the sample is older than the newest
+   *         one stored (clock stepped back), or the flash write failed
+   */
+  bool append(const hist::Sample& sample);
+
+  /**
+   * Cursor at the first record of a tier at or after a time (summaries:
+   * the period containing it)
+   */
+  Cursor seek(hist::Tier tier, uint32_t from);
+
+  /**
+   * Record at the cursor, advancing it
+   * @return false past the newest record
+   */
+  bool next(Cursor* cursor, hist::Sample* sample);
+  bool next(Cursor* cursor, hist::Summary* summary);
+
+  bool mounted() const { return _flash != nullptr; }
+
+  /**
+   * Records stored in a tier (written or torn)
+   */
+  size_t records(hist::Tier tier) const;
+
+  /**
+   * Records a tier can hold before it overwrites its oldest
+   */
+  size_t capacity(hist::Tier tier) const;
+
+private:
+  struct Ring {
+    hist::Tier tier = hist::Tier::Raw;
+    size_t first = 0;           // Partition sector of ring index 0
+    size_t sectors = 0;
+    size_t recordSize = 0;
+    size_t perSector = 0;
+    size_t oldest = 0;          // Ring index of the oldest sector in use
+    size_t used = 0;            // Sectors in use, the newest one being filled
+    size_t headRecords = 0;     // Records in the newest sector
+    uint32_t sequence = 0;      // Sequence number of the newest sector
+  };
+
+  hal::DataPartition* _flash = nullptr;
+  Ring _rings[hist::TIERS];
+  Rollup _hour;
+  Rollup _day;
+  uint32_t _newest = 0;         // Time of the newest raw sample
+
+  void mountRing(hist::Tier tier, size_t first, size_t sectors, size_t recordSize);
+  bool readHeader(const Ring& ring, size_t index, uint32_t* sequence);
+  size_t sectorOffset(const Ring& ring, size_t index) const {
+    return (ring.first + index) * hal::DataPartition::SECTOR_SIZE;
+  }
+  size_t total(const Ring& ring) const {
+    return ring.used == 0 ? 0 : (ring.used - 1) * ring.perSector + ring.headRecords;
+  }
+  bool readRecord(const Ring& ring, size_t position, uint8_t* record);
+  bool nextStored(Cursor* cursor, uint8_t* record);
+  bool writeRecord(hist::Tier tier, const uint8_t* record);
+  bool advance(hist::Tier tier);
+  bool writeSummary(hist::Tier tier, const hist::Summary& summary);
+};
+
+#endif // HISTORY_STORE_H
@@ -0,0 +1,137 @@
+/**
+ * I2C Bus Header
+ *
+ * Manager for the shared I2C bus (ATECC608B, BME280, and the sensor hub's
+ * TCA9548A mux and BME280s):
+ * - Per-device clock profiles, switched per transaction: the ATECC608B
+ *   runs at I2C_SPEED (its wake pulse needs 100 kHz), the BME280s and the
+ *   mux at I2C_FAST_SPEED. The clock is only written when it changes, so
+ *   back-to-back transactions with one device cost nothing extra.
+ * - Exclusive access: a transaction holds the bus lock (a recursive
+ *   FreeRTOS mutex on the device) from start to end, so tasks cannot
+ *   interleave multi-step exchanges such as a mux select and the read
+ *   behind it.
+ * - Counters: per device transactions, failures, payload bytes and
+ *   latency (total and worst); for the bus its busy time, utilization,
+ *   clock switches, and transactions that had to wait for another task.
+ *
+ * Drivers that do their own I2C (SparkFun ATECCX08A, Adafruit BME280) are
+ * wrapped call by call with a Transaction; plain register reads and mux
+ * writes go through read() and write(). Each board has one bus manager,
+ * hal::i2cBus().
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "hal.h"
+
+class I2cBus {
+public:
+  enum Device : uint8_t {
+    DEVICE_ATECC,
+    DEVICE_BME280,
+    DEVICE_HUB_MUX,
+    DEVICE_HUB_BME280,
+    DEVICE_COUNT
+  };
+
+  struct DeviceStats {
+    uint32_t transactions = 0;
+    uint32_t failures = 0;
+    uint32_t bytes = 0;           // Payload of read() / write()
+    uint64_t busyUs = 0;
+    uint32_t maxUs = 0;
+  };
+
+  struct BusStats {
+    uint64_t busyUs = 0;          // Outermost transactions only
+    uint32_t clockSwitches = 0;
+    uint32_t contended = 0;       // Transactions that waited for another task
+    uint64_t waitUs = 0;
+  };
+
+  /**
+   * One device's use of the bus at its clock, under the bus lock; counted
+   * when it goes out of scope. Transactions may nest (the inner one is
+   * counted for its device but not again in the bus busy time).
+   */
+  class Transaction {
+  public:
+    Transaction(I2cBus& bus, Device device);
+    ~Transaction();
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    /**
+     * Count the transaction as failed
+     */
+    void fail() { _ok = false; }
+
+    /**
+     * Count payload bytes
+     */
+    void addBytes(size_t bytes) { _bytes += bytes; }
+
+  private:
+    I2cBus& _bus;
+    Device _device;
+    uint32_t _startUs;
+    uint32_t _outerHz;            // Clock to restore when nested, 0 if outermost
+    size_t _bytes = 0;
+    bool _ok = true;
+  };
+
+  /**
+   * "atecc", "bme280", "hub_mux", "hub_bme280"
+   */
+  static const char* deviceName(Device device);
+
+  /**
+   * Clock profile of a device
+   */
+  static uint32_t clockHz(Device device);
+
+  /**
+   * Bring up the bus at the ATECC608B's clock and clear the counters
+   */
+  void begin(int sdaPin, int sclPin);
+
+  /**
+   * Read consecutive registers in one transaction (hal::i2cRead)
+   * @return true if the device acknowledged and returned all bytes
+   */
+  bool read(Device device, uint8_t address, uint8_t reg, uint8_t* data, size_t length);
+
+  /**
+   * Write bytes without a register address in one transaction (hal::i2cWrite)
+   * @return true if the device acknowledged every byte
+   */
+  bool write(Device device, uint8_t address, const uint8_t* data, size_t length);
+
+  const DeviceStats& stats(Device device) const { return _devices[device]; }
+  const BusStats& busStats() const { return _stats; }
+
+  /**
+   * Share of the time since the counters were cleared that the bus was busy
+   * @return 0-1
+   */
+  float utilization() const;
+
+  /**
+   * Clear the counters and start a new utilization window
+   */
+  void resetStats();
+
+private:
+  uint32_t _clockHz = 0;          // As last written, 0 before begin()
+  uint8_t _depth = 0;             // Open transactions (all in the lock holder)
+  uint32_t _windowStartMs = 0;
+  DeviceStats _devices[DEVICE_COUNT];
+  BusStats _stats;
+
+  void setClock(uint32_t hz);
+};
+
+#endif // I2C_BUS_H
@@ -0,0 +1,51 @@
+/**
+ * LoRa Time-on-Air Header
+ *
+ * Semtech SX127x time-on-air formula (AN1200.13) for the RYLR896.
+ * Header-only and free of Arduino dependencies so the firmware, the
+ * native simulator and the gateway tools all use the same numbers.
+ */
+
+#ifndef LORA_AIRTIME_H
+#define LORA_AIRTIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RYLR896 limits
+#define RYLR896_MAX_PAYLOAD 240     // Max AT+SEND payload (ASCII bytes)
+#define RYLR896_PREAMBLE 12         // AT+PARAMETER preamble used by firmware
+
+/**
+ * Time on air of one LoRa frame
+ * @param payloadBytes PHY payload length in bytes
+ * @param spreadingFactor SF7-SF12
+ * @param bandwidthKHz 125, 250 or 500
+ * @param codingRate Denominator offset: 1 = 4/5 ... 4 = 4/8
+ * @param preambleSymbols Programmed preamble length
+ * @return Time on air in microseconds
+ */
+inline uint32_t loraTimeOnAirUs(size_t payloadBytes, uint8_t spreadingFactor,
+                                uint16_t bandwidthKHz, uint8_t codingRate = 1,
+                                uint16_t preambleSymbols = RYLR896_PREAMBLE) {
+  // Symbol time in microseconds: 2^SF / BW
+  const uint32_t symbolUs = ((uint32_t)1 << spreadingFactor) * 1000UL / bandwidthKHz;
+
+  // Low data rate optimisation is mandated when the symbol time exceeds 16 ms
+  const int de = symbolUs > 16000 ? 1 : 0;
+  const int ih = 0;   // Explicit header
+  const int crc = 1;  // Payload CRC on
+
+  // Payload symbols: 8 + max(ceil((8PL - 4SF + 28 + 16CRC - 20IH) / 4(SF - 2DE)) * (CR + 4), 0)
+  int32_t numerator = 8 * (int32_t)payloadBytes - 4 * spreadingFactor + 28 + 16 * crc - 20 * ih;
+  int32_t denominator = 4 * (spreadingFactor - 2 * de);
+  int32_t blocks = numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+  uint32_t payloadSymbols = 8 + (uint32_t)blocks * (codingRate + 4);
+
+  // Preamble: programmed symbols + 4.25 sync symbols
+  uint32_t preambleUs = (preambleSymbols * 4 + 17) * symbolUs / 4;
+
+  return preambleUs + payloadSymbols * symbolUs;
+}
+
+#endif // LORA_AIRTIME_H
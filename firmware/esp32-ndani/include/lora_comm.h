@@ -2,16 +2,18 @@
  * LoRa Communication Header
  * 
  * Driver for RYLR896 LoRa transceiver module.
- * Uses AT command interface over UART.
+ * Uses AT command interface over UART. The node's default link
+ * (transport.h): always ready, duty-cycled, one frame per AT+SEND.
  */
 
 #ifndef LORA_COMM_H
 #define LORA_COMM_H
 
-#include <Arduino.h>
-#include <HardwareSerial.h>
+#include "hal.h"
+#include "wire_codec.h"
+#include "transport.h"
 
-class LoRaComm {
+class LoRaComm : public Transport {
 public:
   /**
    * Initialize LoRa module on specified pins
@@ -21,13 +23,21 @@ public:
    */
   bool begin(int rxPin, int txPin);
   
+  /**
+   * Send a bare AT command and wait for the module's reply
+   * @return true if the module answered +OK
+   */
+  bool ping();
+  
   /**
    * Configure LoRa parameters
    * @param frequency Frequency in Hz (e.g., 915000000)
    * @param spreadingFactor SF7-SF12
    * @param bandwidth Bandwidth in kHz (125, 250, or 500)
+   * @param txPowerDbm Output power (0-20 dBm)
    */
-  void configure(uint32_t frequency, uint8_t spreadingFactor, uint16_t bandwidth);
+  void configure(uint32_t frequency, uint8_t spreadingFactor, uint16_t bandwidth,
+                 uint8_t txPowerDbm);
   
   /**
    * Set network ID (must match proof server)
@@ -42,18 +52,27 @@ public:
   void setAddress(uint16_t address);
   
   /**
-   * Transmit data to proof server (address 1)
+   * Transmit data to proof server (address 1). Messages longer than one
+   * frame (wire::MAX_FRAME_BYTES) are sent as numbered fragments.
    * @param data Data buffer
-   * @param length Data length (max 240 bytes)
-   * @return true if transmission acknowledged
+   * @param length Data length (max wire::MESSAGE_MAX bytes)
+   * @return true if every frame was acknowledged by the module
    */
-  bool transmit(const uint8_t* data, size_t length);
+  bool transmit(const uint8_t* data, size_t length) override;
+  
+  /**
+   * Set the next fragment sequence number. Seed it randomly at boot so the
+   * gateway's duplicate filter does not mistake a rebooted device's new
+   * messages for repeats.
+   * @param seq Sequence number
+   */
+  void setSequence(uint16_t seq) { _txSequence = seq; }
   
   /**
    * Check if data is available to receive
    * @return true if data is waiting
    */
-  bool available();
+  bool available() override;
   
   /**
    * Receive data from LoRa
@@ -61,7 +80,7 @@ public:
    * @param maxLen Maximum bytes to read
    * @return Number of bytes received
    */
-  size_t receive(uint8_t* buffer, size_t maxLen);
+  size_t receive(uint8_t* buffer, size_t maxLen) override;
   
   /**
    * Get last RSSI value
@@ -74,13 +93,28 @@ public:
    * @return SNR in dB
    */
   int getSNR();
+  
+  /**
+   * Link capabilities; the latency is a full frame's time on air at the
+   * configured spreading factor
+   */
+  const LinkCaps& caps() const override { return _caps; }
 
 private:
-  HardwareSerial* _serial = nullptr;
+  hal::Uart* _serial = nullptr;
   int _rssi = 0;
   int _snr = 0;
+  uint16_t _txSequence = 0;
+  uint8_t _spreadingFactor = 12;    // Until configure(): the slowest case
+  uint16_t _bandwidth = 125;
+  LinkCaps _caps = {LinkKind::LoRa, wire::MESSAGE_MAX, 100, 0, true, false};
+  // AT+SEND command or +RCV line, whichever is in progress: kept off the
+  // stack of the task that calls transmit() and receive()
+  char _line[wire::RCV_LINE_MAX];
   
-  bool sendCommand(const char* cmd, char* response = nullptr, size_t maxResponse = 0);
+  bool transmitFrame(const uint8_t* data, size_t length);
+  bool sendCommand(const char* cmd, char* response = nullptr, size_t maxResponse = 0,
+                   unsigned long timeout = 2000);
   bool waitForResponse(char* response, size_t maxLen, unsigned long timeout = 2000);
 };
 
@@ -0,0 +1,67 @@
+/**
+ * Memory Arena Header
+ *
+ * Placement of the firmware's large long-lived buffers. Instead of member
+ * arrays (internal .bss next to the stacks) they are taken once at setup
+ * from the region that suits them:
+ * - PSRAM: big and only touched now and then (the training window)
+ * - RTC: small enough for the RTC pool (the outbox), which internal RAM
+ *   then does not have to hold
+ * - Internal: everything else, and the fallback when a region is missing
+ *   or full (a board without PSRAM still runs, the report shows it)
+ *
+ * Blocks are named and never freed; asking for a name again returns the
+ * same block, so setup() can run more than once (restarts in the
+ * simulators, where RAM is not cleared). Each board has one arena
+ * (hal::memArena()), next to the heap and stack figures that
+ * `mem` on the self-test console prints.
+ */
+
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include "hal.h"
+
+class MemArena {
+public:
+  static const size_t BLOCKS_MAX = 16;
+
+  struct Block {
+    const char* name;
+    hal::MemRegion region;      // Where it is
+    hal::MemRegion requested;   // Where it was asked for
+    size_t bytes;
+    void* data;
+  };
+
+  /**
+   * A named buffer, zeroed on first allocation
+   * @param name Block name (a string literal: the pointer is kept)
+   * @param bytes Size
+   * @param region Preferred region; internal RAM if it has no room
+   * @return nullptr if internal RAM has no room either, the table is full,
+   *         or the name was taken with another size
+   */
+  void* alloc(const char* name, size_t bytes, hal::MemRegion region);
+
+  size_t blocks() const { return _count; }
+  const Block& block(size_t index) const { return _blocks[index]; }
+
+  /**
+   * Bytes of arena blocks in a region
+   */
+  size_t used(hal::MemRegion region) const;
+
+  /**
+   * Blocks that did not get the region they asked for
+   */
+  size_t fallbacks() const;
+
+  static const char* regionName(hal::MemRegion region);
+
+private:
+  Block _blocks[BLOCKS_MAX];
+  size_t _count = 0;
+};
+
+#endif // MEM_ARENA_H
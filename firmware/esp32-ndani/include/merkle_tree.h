@@ -0,0 +1,99 @@
+/**
+ * Merkle Tree Header
+ *
+ * Hashing of the BRACE commitment tree, shared by the device, the gateway
+ * (commitment_tree.h) and host tools. It is the proof server's tree
+ * (proof-server/src/merkle-tree.ts), so roots and paths agree byte for
+ * byte:
+ * - Leaves are commitments C = H(COMMITMENT_DOMAIN || pk || r) as the
+ *   device computes them (brace_client.h), in registration order. Empty
+ *   leaves are 32 zero bytes.
+ * - Node = SHA-256(left || right): two compressions.
+ * - Fixed DEPTH: the root always covers MAX_LEAVES leaves, the unfilled
+ *   right part as zero subtrees (zeroHash()).
+ * - Path: the DEPTH siblings from leaf to root, leaf level first. Bit l
+ *   of the leaf index says whether the node at level l is a right child.
+ * - Path delta: the siblings that changed since a path was last sent:
+ *   mask of changed levels (u32 BE), then one sibling per set bit, lowest
+ *   level first, with no message type of its own. Leaves are only
+ *   appended, so a sibling changes only while its subtree fills up.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef MERKLE_TREE_H
+#define MERKLE_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace merkle {
+
+const size_t HASH_SIZE = 32;
+const size_t DEPTH = 20;
+const uint32_t MAX_LEAVES = 1UL << DEPTH;    // About a million devices
+const size_t DELTA_HEADER_SIZE = 4;          // Changed-level mask
+const size_t DELTA_MAX_SIZE = DELTA_HEADER_SIZE + DEPTH * HASH_SIZE;
+
+/**
+ * Hash two children into their parent
+ * @param left Left child (HASH_SIZE bytes)
+ * @param right Right child (HASH_SIZE bytes)
+ * @param out Parent (HASH_SIZE bytes, may alias either child)
+ */
+void hashNode(const uint8_t* left, const uint8_t* right, uint8_t* out);
+
+/**
+ * Root of an empty subtree
+ * @param level 0 (an empty leaf) to DEPTH (the empty tree)
+ * @return HASH_SIZE bytes, valid for the life of the program
+ */
+const uint8_t* zeroHash(size_t level);
+
+/**
+ * Root a path leads to
+ * @param leaf Leaf value
+ * @param index Leaf index
+ * @param path DEPTH siblings, leaf level first
+ * @param root Output (HASH_SIZE bytes)
+ */
+void rootFromPath(const uint8_t* leaf, uint32_t index, const uint8_t path[][HASH_SIZE],
+                  uint8_t* root);
+
+/**
+ * Whether a path proves a leaf under a root
+ */
+bool verifyPath(const uint8_t* leaf, uint32_t index, const uint8_t path[][HASH_SIZE],
+                const uint8_t* root);
+
+/**
+ * Levels of a leaf's path that change when the tree grows
+ * @param index Leaf index
+ * @param fromLeaves Leaves when the path was taken (index >= fromLeaves:
+ *        the leaf is new and every level counts as changed)
+ * @param toLeaves Leaves now
+ * @return Bit l set if the sibling at level l changed
+ */
+uint32_t deltaLevels(uint32_t index, uint32_t fromLeaves, uint32_t toLeaves);
+
+/**
+ * Encode a path delta
+ * @param levels Changed levels (deltaLevels())
+ * @param path Current path
+ * @param out Output (up to DELTA_MAX_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeDelta(uint32_t levels, const uint8_t path[][HASH_SIZE], uint8_t* out);
+
+/**
+ * Bring a stored path up to date
+ * @param delta Encoded delta
+ * @param length Its length
+ * @param path Path to update in place
+ * @return false if the delta is malformed (path unchanged)
+ */
+bool applyDelta(const uint8_t* delta, size_t length, uint8_t path[][HASH_SIZE]);
+
+} // namespace merkle
+
+#endif // MERKLE_TREE_H
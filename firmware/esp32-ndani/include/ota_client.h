@@ -0,0 +1,85 @@
+/**
+ * OTA Client Header
+ *
+ * Device side of delta firmware updates over LoRa (see ota_protocol.h).
+ * An offer signed by the release key is staged at the end of the inactive
+ * app partition: one header sector (magic, the offer, a bitmap with one
+ * bit per chunk, cleared when the chunk is written) and the compressed
+ * patch just below it. Progress lives in flash, so a download survives
+ * resets and power loss and resumes where it stopped.
+ *
+ * Once every chunk is staged, the patch is decompressed and applied
+ * against the running image straight into the inactive partition while
+ * hashing the output. Only an image that hashes to the signed target is
+ * activated; then the device reboots into it.
+ */
+
+#ifndef OTA_CLIENT_H
+#define OTA_CLIENT_H
+
+#include "hal.h"
+#include "ota_protocol.h"
+#include "secure_element.h"
+#include "transport.h"
+
+class OtaClient {
+public:
+  /**
+   * Attach to the drivers, confirm the running image and resume a staged
+   * download, if any
+   * @param se Initialised secure element (release signature checks)
+   * @param link Link to the gateway (status reports)
+   */
+  void begin(SecureElement* se, Transport* link);
+
+  /**
+   * Handle an offer frame (MSG_OTA_OFFER)
+   */
+  void onOffer(const uint8_t* frame, size_t length);
+
+  /**
+   * Handle a chunk frame (MSG_OTA_CHUNK); applies the update once the
+   * last chunk is staged
+   */
+  void onChunk(const uint8_t* frame, size_t length);
+
+  /**
+   * Send a status report when one is due (chunks went quiet, or a resumed
+   * download has not been heard from)
+   */
+  void poll();
+
+  /**
+   * @return true while a download is staged but incomplete
+   */
+  bool receiving() const { return _state == ota::State::Receiving; }
+
+private:
+  SecureElement* _se = nullptr;
+  Transport* _link = nullptr;
+  hal::FirmwareSlots* _slots = nullptr;
+
+  ota::State _state = ota::State::Idle;
+  ota::Offer _offer;
+  size_t _headerOffset = 0;       // Header sector in the inactive partition
+  size_t _patchOffset = 0;        // Staged patch
+  uint16_t _received = 0;
+  uint32_t _lastChunkMs = 0;
+  uint32_t _lastStatusMs = 0;
+  bool _statusDue = false;        // Chunks arrived since the last report
+
+  ota::LzssDecoder _decoder;      // 1 KiB window, only used while applying
+  uint8_t _runningHash[32];
+  bool _runningHashed = false;
+
+  const uint8_t* runningHash();
+  bool releaseSigned(const ota::Offer& offer);
+  bool stage(const ota::Offer& offer);
+  bool resume();
+  bool chunkStaged(uint16_t index);
+  void apply();
+  void abandon();
+  void sendStatus(ota::State state, uint16_t session);
+};
+
+#endif // OTA_CLIENT_H
@@ -0,0 +1,267 @@
+/**
+ * OTA Protocol Header
+ *
+ * Delta firmware updates over LoRa, shared by the device (OtaClient), the
+ * gateway's campaign sender and the host packing tool:
+ * - Offer / chunk / status messages, each a single frame (downlinks are
+ *   never fragmented: the device does not reassemble)
+ * - Streaming LZSS decoder, bit-compatible with heatshrink (window 2^10,
+ *   lookahead 2^8), with a 1 KiB window as its only state
+ * - Streaming applier for the delta format below, which reads the running
+ *   image at random offsets and emits the new image in order
+ *
+ * Delta format (before compression), in the spirit of bsdiff:
+ *   "EDP1", then records until the new image is complete:
+ *     varint diffLen, varint extraLen, zigzag varint seek
+ *     diffLen bytes, each added (mod 256) to the next old-image byte
+ *     extraLen bytes copied as-is
+ *     then the old-image position moves by seek
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef OTA_PROTOCOL_H
+#define OTA_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ota {
+
+const size_t HASH_PREFIX_SIZE = 8;           // Base image identified by its SHA-256 prefix
+const size_t OFFER_SIZE = 117;               // Encoded offer, including the type byte
+const size_t RELEASE_SIGNED_SIZE = 44;       // targetLength || baseHash prefix || targetHash
+const size_t CHUNK_HEADER_SIZE = 5;          // Type, session, index
+const size_t CHUNK_DATA_MAX = 112;           // Patch bytes per chunk (all but the last)
+const size_t CHUNK_COUNT_MAX = 16384;        // 1.75 MiB of compressed patch
+const size_t STATUS_WINDOW = 256;            // Chunks covered by one status bitmap
+const size_t STATUS_SIZE = 8 + STATUS_WINDOW / 8;
+
+const char CAMPAIGN_MAGIC[8] = {'E', 'C', 'O', 'T', 'A', '1', 0, 0};
+const char PATCH_MAGIC[4] = {'E', 'D', 'P', '1'};
+
+/**
+ * Device update state, reported in every status message
+ */
+enum class State : uint8_t {
+  Idle = 0,
+  Receiving = 1,     // Staging chunks; the bitmap says which are missing
+  Applied = 2,       // New image verified and selected; rebooting
+  WrongBase = 3,     // Running image is not the patch's base
+  BadSignature = 4,  // Offer not signed by the release key
+  Failed = 5,        // Does not fit, or the result did not hash to the target
+  UpToDate = 6,      // Already running the target image
+};
+
+/**
+ * Update offer (MSG_OTA_OFFER). The release key signs targetLength, the
+ * base hash prefix and the target hash, so the device can check the offer
+ * before staging anything and the result once it is applied.
+ */
+struct Offer {
+  uint16_t session;          // Identifies the campaign: first two bytes of targetHash
+  uint32_t targetLength;     // New image size
+  uint32_t patchLength;      // Compressed patch size
+  uint16_t chunkCount;
+  uint8_t baseHash[HASH_PREFIX_SIZE];
+  uint8_t targetHash[32];    // SHA-256 of the new image
+  uint8_t signature[64];     // P-256 over releaseMessage() (R || S)
+};
+
+/**
+ * Progress report (MSG_OTA_STATUS). bitmap bit k is set when chunk
+ * windowBase + k is staged; windowBase is the first missing chunk.
+ */
+struct Status {
+  uint16_t session;
+  State state;
+  uint16_t received;         // Chunks staged in total
+  uint16_t windowBase;
+  uint8_t bitmap[STATUS_WINDOW / 8];
+};
+
+/**
+ * Encode an offer
+ * @param offer Offer to encode
+ * @param out Output buffer (OFFER_SIZE bytes)
+ * @return OFFER_SIZE
+ */
+size_t encodeOffer(const Offer& offer, uint8_t* out);
+
+/**
+ * Parse an offer frame
+ * @return true if the frame is a well-formed offer
+ */
+bool parseOffer(const uint8_t* in, size_t length, Offer* offer);
+
+/**
+ * The bytes the release signature covers
+ * @param offer Offer
+ * @param out Output buffer (RELEASE_SIGNED_SIZE bytes)
+ * @return RELEASE_SIGNED_SIZE
+ */
+size_t releaseMessage(const Offer& offer, uint8_t* out);
+
+/**
+ * Number of chunks a patch is sent in
+ * @return Chunk count, or 0 if the patch is empty or exceeds CHUNK_COUNT_MAX chunks
+ */
+size_t chunkCount(size_t patchLength);
+
+/**
+ * Encode one patch chunk
+ * @param session Offer session
+ * @param index Chunk index
+ * @param data Chunk bytes
+ * @param length Chunk length (at most CHUNK_DATA_MAX)
+ * @param out Output buffer (CHUNK_HEADER_SIZE + CHUNK_DATA_MAX)
+ * @return Frame length
+ */
+size_t encodeChunk(uint16_t session, uint16_t index, const uint8_t* data, size_t length,
+                   uint8_t* out);
+
+/**
+ * Parse a chunk frame
+ * @param in Frame
+ * @param length Frame length
+ * @param session Output
+ * @param index Output
+ * @param data Output: chunk bytes inside the frame
+ * @param dataLen Output
+ * @return true if the frame is a well-formed chunk
+ */
+bool parseChunk(const uint8_t* in, size_t length, uint16_t* session, uint16_t* index,
+                const uint8_t** data, size_t* dataLen);
+
+/**
+ * Encode a status report
+ * @param status Report
+ * @param out Output buffer (STATUS_SIZE bytes)
+ * @return STATUS_SIZE
+ */
+size_t encodeStatus(const Status& status, uint8_t* out);
+
+/**
+ * Parse a status frame
+ * @return true if the frame is a well-formed status report
+ */
+bool parseStatus(const uint8_t* in, size_t length, Status* status);
+
+/**
+ * Split a campaign file (CAMPAIGN_MAGIC, encoded offer, patch) as written
+ * by edgechain-ota-pack
+ * @param file File contents
+ * @param length File size
+ * @param offer Output
+ * @param patch Output: patch bytes inside file
+ * @return true if the file is well-formed and its patch matches the offer
+ */
+bool parseCampaign(const uint8_t* file, size_t length, Offer* offer, const uint8_t** patch);
+
+/**
+ * Streaming heatshrink-compatible LZSS decoder. Input may be split
+ * anywhere; a partial token is kept until the rest arrives.
+ */
+class LzssDecoder {
+public:
+  static const int WINDOW_BITS = 10;
+  static const int LOOKAHEAD_BITS = 8;
+
+  LzssDecoder() { reset(); }
+
+  void reset();
+
+  /**
+   * Decode as much as fits
+   * @param in Compressed input
+   * @param inLen Input length
+   * @param consumed Output: input bytes used (all of them unless out filled up)
+   * @param out Output buffer
+   * @param outSize Output capacity
+   * @return Bytes written to out
+   */
+  size_t decode(const uint8_t* in, size_t inLen, size_t* consumed, uint8_t* out,
+                size_t outSize);
+
+private:
+  enum class Step : uint8_t { Tag, Literal, Index, Count };
+
+  uint8_t _window[1 << WINDOW_BITS];
+  uint16_t _head;            // Next window position
+  Step _step;
+  uint8_t _byte;             // Input byte being split into bits
+  uint8_t _mask;             // Next bit of _byte, 0 = need a byte
+  uint16_t _bits;            // Bits of the current field read so far
+  uint8_t _bitCount;
+  uint16_t _distance;        // Back-reference being copied
+  uint16_t _copyRemaining;
+
+  bool readBits(uint8_t count, const uint8_t*& in, const uint8_t* end, uint16_t* value);
+  void emit(uint8_t value, uint8_t* out, size_t* produced);
+};
+
+/**
+ * Random access to the image a delta applies to
+ */
+class ImageReader {
+public:
+  virtual ~ImageReader() = default;
+  virtual bool read(size_t offset, uint8_t* data, size_t length) = 0;
+};
+
+/**
+ * Streaming delta applier. Each patch byte yields at most one output
+ * byte, so an output buffer as long as the input always suffices.
+ */
+class PatchApplier {
+public:
+  /**
+   * Start applying a patch
+   * @param base Running image
+   * @param baseLength Running image size
+   * @param targetLength Expected new image size
+   */
+  void begin(ImageReader* base, size_t baseLength, size_t targetLength);
+
+  /**
+   * Feed decompressed patch bytes
+   * @param patch Patch bytes
+   * @param length Number of bytes
+   * @param out Output buffer (at least length bytes)
+   * @return New image bytes written to out (0 after an error)
+   */
+  size_t feed(const uint8_t* patch, size_t length, uint8_t* out);
+
+  bool failed() const { return _failed; }
+  bool done() const { return !_failed && _written == _targetLength; }
+  size_t written() const { return _written; }
+
+private:
+  enum class Step : uint8_t { Magic, DiffLen, ExtraLen, Seek, Diff, Extra };
+
+  ImageReader* _base = nullptr;
+  size_t _baseLength = 0;
+  size_t _targetLength = 0;
+  size_t _written = 0;
+  int64_t _basePos = 0;
+  Step _step = Step::Magic;
+  uint64_t _varint = 0;
+  uint8_t _varintShift = 0;
+  uint32_t _diffLen = 0;
+  uint32_t _extraLen = 0;
+  int64_t _seek = 0;         // Applied once the current record's bytes are done
+  bool _failed = false;
+
+  // Base image bytes around _basePos
+  uint8_t _cache[256];
+  size_t _cacheStart = 0;
+  size_t _cacheLen = 0;
+
+  bool baseByte(size_t offset, uint8_t* value);
+  void endRecordIfEmpty();
+  void fail() { _failed = true; }
+};
+
+} // namespace ota
+
+#endif // OTA_PROTOCOL_H
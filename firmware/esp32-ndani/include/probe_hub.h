@@ -0,0 +1,93 @@
+/**
+ * Probe Hub Header
+ *
+ * Sensor-hub mode: one node reads many probes and sends them in a single
+ * signed reading (probe_protocol.h), so a dense field needs one radio,
+ * one secure element and one frame pair per cycle instead of one node per
+ * probe.
+ * - Soil probes 1-8 on a 74HC4051 analog mux (HUB_SOIL_MUX_PIN, selected
+ *   by HUB_SOIL_SELECT_PINS), or straight on HUB_SOIL_PINS
+ * - BME280s behind a TCA9548A I2C mux (HUB_I2C_MUX_ADDR), one per mux
+ *   channel, each giving a temperature and a humidity channel
+ * - Per-probe calibration: air and water ADC values for each soil probe,
+ *   temperature and humidity offsets for each BME280
+ *
+ * The layout and calibration are provisioned per device and kept in NVS
+ * ("probe_hub"), with config.h defaults. A node without hub probes reads
+ * nothing and sends no probes item.
+ */
+
+#ifndef PROBE_HUB_H
+#define PROBE_HUB_H
+
+#include "hal.h"
+#include "probe_protocol.h"
+
+class ProbeHub {
+public:
+  static const size_t SOIL_MAX = 8;
+  static const size_t ENV_MAX = 8;    // TCA9548A channels
+
+  struct Layout {
+    uint8_t soilProbes;               // Probes 1..soilProbes are fitted
+    uint8_t envMask;                  // Mux channels with a BME280
+    uint16_t soilAir[SOIL_MAX];       // Raw ADC value dry, per probe
+    uint16_t soilWater[SOIL_MAX];     // ... and in water
+    int16_t temperatureOffset[ENV_MAX];   // Added, 0.01 °C
+    int16_t humidityOffset[ENV_MAX];      // Added, 0.01 %
+  };
+
+  /**
+   * config.h layout: HUB_SOIL_PROBES, HUB_ENV_MASK, the node's own soil
+   * calibration for every probe, no offsets
+   */
+  static Layout defaultLayout();
+
+  /**
+   * Whether a layout can be read into one reading (probe counts, mux
+   * wiring, CHANNELS_MAX, calibration with air != water)
+   */
+  static bool valid(const Layout& layout);
+
+  /**
+   * Load the layout from NVS and bring up the fitted probes
+   * @return false if a BME280 in the layout did not answer (its channels
+   *         then read as missing)
+   */
+  bool begin();
+
+  /**
+   * Replace the layout and persist it
+   * @return false if it is not valid or could not be stored
+   */
+  bool setLayout(const Layout& layout);
+
+  const Layout& layout() const { return _layout; }
+
+  /**
+   * Any probes fitted
+   */
+  bool active() const { return _layout.soilProbes > 0 || _layout.envMask != 0; }
+
+  /**
+   * Read every fitted probe
+   * @param reading Output: soil probes in order, then temperature and
+   *        humidity per BME280
+   */
+  void read(probe::Reading* reading);
+
+  /**
+   * Raw ADC value of one soil probe (for calibration)
+   * @param probe 1..SOIL_MAX
+   */
+  int readSoilRaw(uint8_t probe);
+
+private:
+  Layout _layout = defaultLayout();
+  uint8_t _envReady = 0;              // BME280s that answered at begin()
+
+  bool selectEnv(uint8_t channel);
+  void deselectEnv();
+};
+
+#endif // PROBE_HUB_H
@@ -0,0 +1,80 @@
+/**
+ * Probe Protocol Header
+ *
+ * Extra sensor channels of a sensor hub (probe_hub.h) in the reading they
+ * were taken with, shared by the device, the gateway and the simulators:
+ * - A channel is a kind (soil moisture, temperature, humidity), an index
+ *   and a value in hundredths (i16 LE, INT16_MIN if the read failed).
+ *   Soil probes are numbered from 1, probe 0 being the one in the
+ *   DataPacket; temperature and humidity are numbered by the I2C mux
+ *   channel of their BME280.
+ * - Trailer item (wire::TRAILER_PROBES): kind << 4 | index, then the
+ *   value, per channel. Unlike the other trailer items it is signed: it
+ *   comes right after the DataPacket and the signature covers the first
+ *   DATA_PACKET_SIGNED_SIZE bytes followed by the whole item, so one
+ *   signature and one frame pair carry every probe.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef PROBE_PROTOCOL_H
+#define PROBE_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wire_codec.h"
+
+namespace probe {
+
+const uint8_t KIND_SOIL = 1;              // Percent
+const uint8_t KIND_TEMPERATURE = 2;       // Celsius
+const uint8_t KIND_HUMIDITY = 3;          // Percent
+
+const size_t CHANNELS_MAX = 16;           // A full hub reading still fits two frames
+const size_t CHANNEL_SIZE = 3;            // Kind | index, value
+const size_t ITEM_MAX = wire::TRAILER_ITEM_HEADER_SIZE + CHANNELS_MAX * CHANNEL_SIZE;
+const size_t PACKET_MAX = wire::DATA_PACKET_SIZE + ITEM_MAX;            // DataPacket + item
+const size_t SIGNED_MAX = wire::DATA_PACKET_SIGNED_SIZE + ITEM_MAX;     // Bytes signed
+
+struct Channel {
+  uint8_t kind;
+  uint8_t index;            // 0-15
+  float value;              // NaN if the read failed
+};
+
+struct Reading {
+  uint8_t count = 0;
+  Channel channels[CHANNELS_MAX];
+};
+
+/**
+ * Encode the trailer item
+ * @param out Output (ITEM_MAX bytes)
+ * @return Bytes written, 0 for a reading without channels
+ */
+size_t encodeTrailer(const Reading& reading, uint8_t* out);
+
+/**
+ * Channels of a reading message
+ * @return false if the message has no probes item right after the
+ *         DataPacket, or it is malformed
+ */
+bool findReading(const uint8_t* message, size_t length, Reading* reading);
+
+/**
+ * The bytes a reading's signature covers: the first DATA_PACKET_SIGNED_SIZE
+ * bytes, then the probes item if one follows the DataPacket
+ * @param message Reading message (or its first PACKET_MAX bytes)
+ * @param out Output (SIGNED_MAX bytes)
+ * @return Bytes written
+ */
+size_t signedMessage(const uint8_t* message, size_t length, uint8_t* out);
+
+/**
+ * "soil", "temperature", "humidity" (or "unknown")
+ */
+const char* kindName(uint8_t kind);
+
+} // namespace probe
+
+#endif // PROBE_PROTOCOL_H
@@ -0,0 +1,94 @@
+/**
+ * Registration Protocol Header
+ *
+ * Pacing of BRACE registrations, shared by the device (brace_client.h),
+ * the gateway and the simulators:
+ * - Retry-after (wire::MSG_REGISTRATION_RETRY): type, then seconds
+ *   (u16 BE). The gateway sends it instead of forwarding a registration
+ *   it has no room for. The device waits that long, plus up to
+ *   REG_RETRY_JITTER_MS, and sends the same registration again.
+ * - Pacer: the gateway admits PACE_PER_MIN registrations a minute,
+ *   PACE_BURST of them back to back (GCRA). A device over the rate is
+ *   given the next free slot and its retry in that slot is admitted, so a
+ *   boot storm drains at the admission rate instead of colliding again
+ *   on every retry.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef REGISTRATION_PROTOCOL_H
+#define REGISTRATION_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+
+namespace reg {
+
+const size_t RETRY_SIZE = 3;                 // Type, seconds
+const uint32_t RETRY_MAX_S = 65535;
+
+// Default gateway admission rate, a few percent of the channel at SF9
+const uint32_t PACE_PER_MIN = 12;
+const uint32_t PACE_BURST = 4;
+
+/**
+ * Encode a retry-after message
+ * @param seconds Wait, clamped to 1..RETRY_MAX_S
+ * @param out Output (RETRY_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeRetry(uint32_t seconds, uint8_t* out);
+
+/**
+ * Parse a retry-after message
+ * @return false if it is not one
+ */
+bool parseRetry(const uint8_t* message, size_t length, uint32_t* seconds);
+
+struct PacerStats {
+  uint64_t admitted = 0;
+  uint64_t deferred = 0;        // Retry-after sent
+  uint32_t longestWaitS = 0;    // Longest retry-after given
+};
+
+class Pacer {
+public:
+  // A slot nobody came back for is given up this long after its time
+  static const uint32_t SLOT_EXPIRY_MS = 600000;
+
+  /**
+   * @param perMinute Registrations admitted per minute, 0 to admit all
+   * @param burst Admitted back to back before pacing starts
+   */
+  Pacer(uint32_t perMinute, uint32_t burst);
+
+  /**
+   * A registration from a device
+   * @param address Device address
+   * @param nowMs Current time
+   * @return 0 to admit (forward) it, else the seconds the device should
+   *         wait before sending it again
+   */
+  uint32_t onRegistration(uint16_t address, uint64_t nowMs);
+
+  /**
+   * Devices holding a slot
+   */
+  size_t waiting() const { return _slots.size(); }
+
+  const PacerStats& stats() const { return _stats; }
+
+private:
+  uint64_t _intervalMs;
+  uint64_t _toleranceMs;
+  uint64_t _nextMs = 0;         // Theoretical arrival time of the next admission
+  std::unordered_map<uint16_t, uint64_t> _slots;   // Per deferred device
+  PacerStats _stats;
+
+  uint32_t defer(uint64_t slotMs, uint64_t nowMs);
+};
+
+} // namespace reg
+
+#endif // REGISTRATION_PROTOCOL_H
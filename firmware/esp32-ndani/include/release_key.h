@@ -0,0 +1,17 @@
+/**
+ * Release Key Header
+ *
+ * Public half of the release key (P-256, X || Y), from the build's
+ * OTA_RELEASE_PUBLIC_KEY (scripts/release_key.py). Firmware update offers
+ * (ota_client.h) and remote settings (config_client.h) are only taken
+ * when it signed them.
+ */
+
+#ifndef RELEASE_KEY_H
+#define RELEASE_KEY_H
+
+#include <stdint.h>
+
+extern const uint8_t RELEASE_PUBLIC_KEY[64];
+
+#endif // RELEASE_KEY_H
@@ -8,7 +8,7 @@
 #ifndef SECURE_ELEMENT_H
 #define SECURE_ELEMENT_H
 
-#include <Arduino.h>
+#include "hal.h"
 
 class SecureElement {
 public:
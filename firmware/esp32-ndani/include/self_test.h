@@ -0,0 +1,85 @@
+/**
+ * Self-Test Console Header
+ *
+ * Line-based command console on the USB CDC port for field technicians.
+ * Runs timed hardware self-tests and prints one JSON object per result:
+ * - atecc:  ATECC608B command latencies (random, SHA-256, sign, verify, nullifier)
+ * - i2c:    Bus throughput reading register blocks from both I2C devices
+ * - bme280: Forced-mode conversion time
+ * - adc:    Soil probe burst rate and noise
+ * - lora:   AT command round-trip to the RYLR896
+ * - echo:   Frames bounced off the gateway: round-trip, time on air, RSSI/SNR
+ * - i2c (command): Bus manager counters since boot or the last reset:
+ *           utilization, clock switches, contention, and per device
+ *           transactions, failures, bytes and latency
+ * - mem:    Heap per region (internal, PSRAM, RTC pool) with fragmentation,
+ *           the arena's blocks, and each task's stack high-water mark
+ * - link:   The links to the gateway (transport.h): capabilities, state and
+ *           counters, and the one messages go over now; a name pins that
+ *           link while it is up, auto goes back to the cheapest
+ * - probe:  Sensor hub layout, raw soil values and readings, and its
+ *           provisioning (fitted probes, calibration, offsets)
+ *
+ * Commands: help, info, selftest [all|atecc|i2c|bme280|adc|lora],
+ *           echo [count] [bytes], i2c [reset], mem, link [auto|lora|wifi],
+ *           probe [layout <soil> <mask> | cal <probe> <air> <water> |
+ *           offset <channel> <t> <h>]
+ */
+
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+#include "hal.h"
+#include "secure_element.h"
+#include "lora_comm.h"
+#include "sensors.h"
+#include "probe_hub.h"
+
+class SelfTestConsole {
+public:
+  /**
+   * Attach the console to the device's drivers
+   * @param se Initialised secure element
+   * @param lora Initialised LoRa module
+   * @param links Every link to the gateway, LoRa included
+   * @param sensors Initialised sensors
+   * @param hub Initialised sensor hub
+   */
+  void begin(SecureElement* se, LoRaComm* lora, TransportSet* links, Sensors* sensors,
+             ProbeHub* hub);
+  
+  /**
+   * Read pending console input and run a command once a line is complete.
+   * Does nothing unless a host has the USB CDC port open.
+   * @return true if a command ran
+   */
+  bool poll();
+
+private:
+  SecureElement* _se = nullptr;
+  LoRaComm* _lora = nullptr;
+  TransportSet* _links = nullptr;
+  Sensors* _sensors = nullptr;
+  ProbeHub* _hub = nullptr;
+  
+  char _line[64];
+  size_t _lineLen = 0;
+  uint8_t _echoSeq = 0;
+  
+  void runCommand(char* line);
+  void printHelp();
+  void printInfo();
+  void testAtecc();
+  void testI2c();
+  void testBme280();
+  void testAdc();
+  void testLoRa();
+  void testEcho(int count, size_t payloadBytes);
+  void printI2cStats();
+  void printMemory();
+  void printLinks();
+  void printProbes();
+  void provisionProbes(const char* what, char* arg1, char* arg2, char* arg3);
+};
+
+#endif // SELF_TEST_H
@@ -0,0 +1,187 @@
+/**
+ * Sensor Node Header
+ * 
+ * The Msingi device application. Owns the peripheral drivers and the
+ * device state that used to be globals in main.cpp, so the host
+ * simulators can run many independent nodes from the same code.
+ */
+
+#ifndef SENSOR_NODE_H
+#define SENSOR_NODE_H
+
+#include "hal.h"
+#include "secure_element.h"
+#include "lora_comm.h"
+#include "wifi_transport.h"
+#include "sensors.h"
+#include "brace_client.h"
+#include "self_test.h"
+#include "ota_client.h"
+#include "config_client.h"
+#include "alert_rules.h"
+#include "uplink_queue.h"
+#include "time_sync.h"
+#include "history_store.h"
+#include "edge_analytics.h"
+#include "fl_client.h"
+#include "probe_hub.h"
+
+class SensorNode {
+public:
+  /**
+   * Initialize all hardware components and restore registration state
+   */
+  void setup();
+  
+  /**
+   * One iteration of the main loop: service the USB console and downlinks,
+   * run the sensor cycle or an alert check when due, send what the uplink
+   * queue and the airtime budget allow (then a model update and history
+   * frames), train on a global model that arrived, flush batched links,
+   * then yield for 100 ms
+   */
+  void loop();
+  
+  /**
+   * Milliseconds until loop() next has scheduled work: a registration
+   * attempt, a sensor cycle, an alert check, training, or queued
+   * readings, a model update or history frames that the airtime budget
+   * will let out
+   * @return 0 if something is due now
+   */
+  uint32_t msUntilNextReading();
+  
+  /**
+   * Uplink counters (alerts sent, routine readings sent, deferred, dropped)
+   */
+  const UplinkStats& uplinkStats() const { return _uplink.stats(); }
+  
+  /**
+   * Check if the proof server has acknowledged registration
+   */
+  bool isRegistered() const { return _registered; }
+  
+  /**
+   * On-device history (records per tier, for the simulators)
+   */
+  const HistoryStore& history() const { return _history; }
+  
+  /**
+   * Streaming analytics over the readings taken (for the simulators)
+   */
+  const analytics::EdgeAnalytics& analytics() const { return _analytics; }
+  
+  /**
+   * Federated learning rounds (last update built, for the simulators)
+   */
+  const FlClient& fl() const { return _fl; }
+  
+  /**
+   * Build the signed wire form of one reading, exactly as the sensor
+   * cycle transmits it (also used by the host load generator)
+   * @param se Secure element holding the device key
+   * @param commitment Device commitment (32 bytes)
+   * @param data Sensor reading
+   * @param epoch Current epoch, for the nullifier
+   * @param timestamp Packet timestamp (Unix seconds once synced, else ms since boot)
+   * @param wireBytes Output (probe::PACKET_MAX bytes)
+   * @param probes Sensor hub channels, signed in a probes item after the
+   *        DataPacket (nullptr or none: the DataPacket alone)
+   * @return Bytes written, 0 if the nullifier or the signature could not
+   *         be computed
+   */
+  static size_t buildDataPacket(SecureElement& se, const uint8_t* commitment,
+                                const SensorData& data, uint32_t epoch, uint32_t timestamp,
+                                uint8_t* wireBytes, const probe::Reading* probes = nullptr);
+
+private:
+  SecureElement _secureElement;
+  LoRaComm _loraComm;
+  // Every uplink goes over the cheapest link that is up (transport.h):
+  // LoRa, and Wi-Fi where configured
+  WifiTransport _wifi;
+  TransportSet _links;
+  Sensors _sensors;
+  BraceClient _braceClient;
+  SelfTestConsole _console;
+  OtaClient _ota;
+  ConfigClient _config;
+  
+  // Device state
+  bool _registered = false;
+  uint32_t _currentEpoch = 0;
+  uint8_t _commitment[32] = {0};
+  unsigned long _lastReading = 0;
+  unsigned long _firstReadingMs = 0;   // First cycle after boot (jittered)
+  unsigned long _lastAlertCheck = 0;
+  
+  // Signed readings waiting for the radio: alerts at once, routine ones
+  // once a batch (remote batch_size) is full, both within the duty cycle
+  // on LoRa
+  UplinkQueue _uplink;
+  AirtimeBudget _airtime{rcfg::DUTY_CYCLE_PERMILLE, 3600000};
+  bool _releaseRoutine = false;
+  bool _deferred = false;
+  alert::RuleState _alerts;
+  
+  // Gateway time from beacons; the drift estimate survives resets in NVS
+  tsync::Clock _clock;
+  
+  // Readings kept on flash, and the range query being answered
+  HistoryStore _history;
+  struct HistoryPull {
+    bool active = false;
+    hist::Query query;
+    hist::Tier tier;
+    HistoryStore::Cursor cursor;
+    uint8_t frames = 0;
+  } _pull;
+  
+  // Derived values and events over every reading taken; the degree-day
+  // total survives resets in NVS
+  analytics::EdgeAnalytics _analytics;
+  unsigned long _lastAnalytics = 0;
+  bool _analyticsStarted = false;
+  
+  // Local training of the soil-moisture forecaster on the history above
+  FlClient _fl;
+  
+  // Sensor hub probes, read with each sensor cycle and signed into its reading
+  ProbeHub _hub;
+  probe::Reading _hubSent;
+  
+  // Last reading sent, for the remote deadbands
+  SensorData _lastSent;
+  bool _haveLastSent = false;
+  uint8_t _suppressed = 0;
+  
+  void handleIncomingMessage();
+  void handleMessage(const uint8_t* buffer, size_t len);
+  void attemptRegistration();
+  bool readingDue(unsigned long now) const;
+  void collectAndTransmitData();
+  void checkAlerts();
+  bool readSensors(SensorData* data);
+  void queueReading(Priority priority, const SensorData& data, uint8_t alerts,
+                    const probe::Reading* probes = nullptr);
+  bool withinDeadband(const SensorData& data, const probe::Reading& probes);
+  void serviceUplink();
+  bool transmitQueued(Transport* link, Priority priority, const uint8_t* message, size_t length);
+  void setupLinks();
+  uint32_t uplinkAirtimeUs(Priority priority, size_t length) const;
+  uint32_t msUntilSendable(size_t length, uint32_t airtimeUs, uint32_t reserveUs, uint32_t now);
+  void applySettings(const rcfg::Settings& previous);
+  void onTimeBeacon(uint64_t unixMs);
+  void recordHistory(const SensorData& data);
+  void updateAnalytics(const SensorData& data);
+  void onHistoryQuery(const hist::Query& query);
+  void serviceHistory();
+  bool historyWaits() const;
+  uint32_t historyFrameAirtimeUs() const;
+  void trainModel();
+  void serviceModelUpdate();
+  uint32_t intervalMs() const { return _config.settings().sampleIntervalS * 1000UL; }
+  uint32_t alertCheckMs() const;
+};
+
+#endif // SENSOR_NODE_H
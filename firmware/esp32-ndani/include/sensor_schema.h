@@ -0,0 +1,194 @@
+/**
+ * Sensor Schema Header
+ *
+ * Compile-time description of the sensor channels a reading carries
+ * beyond the DataPacket, and the bit-packed codec generated from it,
+ * shared by the device, the gateway and the simulators:
+ * - A channel is a name, a range and a resolution. Its width is the
+ *   fewest bits that hold every step of the range plus a missing code
+ *   (all ones); values outside the range and NaN are sent as missing.
+ * - Codec<CHANNELS> packs the channels LSB-first with no padding between
+ *   them. Widths, offsets and scales are template constants, so encoding
+ *   and decoding are straight-line code with no descriptor lookups at run
+ *   time, and sizes are known to static_assert.
+ * - Trailer item (wire::TRAILER_CHANNELS): the packed bytes, outside the
+ *   signature like the other trailer items.
+ *
+ * Channels are only ever appended to a schema: bit offsets of the ones
+ * before stay put, a receiver decodes the channels it knows and ignores
+ * trailing bits, and channels past the end of a shorter item are missing.
+ * Adding a sensor is one line in EXTRA_CHANNELS and one in ExtraChannel.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef SENSOR_SCHEMA_H
+#define SENSOR_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string.h>
+#include <utility>
+#include "wire_codec.h"
+
+namespace schema {
+
+struct Channel {
+  const char* name;           // Key in the gateway's JSON
+  float min;
+  float max;
+  float resolution;           // Step sent on air
+};
+
+/**
+ * Steps in a channel's range (codes 0..steps are values)
+ */
+constexpr uint32_t steps(const Channel& channel) {
+  return (uint32_t)((channel.max - channel.min) / channel.resolution + 0.5f);
+}
+
+/**
+ * Bits per value: every step plus the missing code
+ */
+constexpr uint8_t width(const Channel& channel) {
+  uint8_t bits = 1;
+  while (((uint64_t)1 << bits) < (uint64_t)steps(channel) + 2) bits++;
+  return bits;
+}
+
+/**
+ * Decimal places that show every step of a channel (for printing)
+ */
+constexpr int decimals(const Channel& channel) {
+  int places = 0;
+  for (float step = channel.resolution; step < 0.999f && places < 6; step *= 10.0f) places++;
+  return places;
+}
+
+template <const auto& CHANNELS>
+class Codec {
+public:
+  static constexpr size_t COUNT = sizeof(CHANNELS) / sizeof(CHANNELS[0]);
+
+  static constexpr size_t offset(size_t index) {
+    size_t bits = 0;
+    for (size_t i = 0; i < index; i++) bits += width(CHANNELS[i]);
+    return bits;
+  }
+
+  static constexpr size_t BITS = offset(COUNT);
+  static constexpr size_t SIZE = (BITS + 7) / 8;
+  static constexpr size_t ITEM_SIZE = wire::TRAILER_ITEM_HEADER_SIZE + SIZE;
+
+  /**
+   * Pack values in schema order
+   * @param out Output (SIZE bytes)
+   */
+  static void encode(const float (&values)[COUNT], uint8_t* out) {
+    memset(out, 0, SIZE);
+    encodeEach(values, out, std::make_index_sequence<COUNT>());
+  }
+
+  /**
+   * Unpack values; channels the bytes do not reach are NaN
+   * @param length Bytes available (a sender's SIZE may differ from ours)
+   */
+  static void decode(const uint8_t* in, size_t length, float (&values)[COUNT]) {
+    decodeEach(in, length, values, std::make_index_sequence<COUNT>());
+  }
+
+  /**
+   * Encode the trailer item
+   * @param tag Item tag
+   * @param out Output (ITEM_SIZE bytes)
+   * @return Bytes written
+   */
+  static size_t encodeTrailer(uint8_t tag, const float (&values)[COUNT], uint8_t* out) {
+    out[0] = tag;
+    out[1] = (uint8_t)SIZE;
+    encode(values, out + wire::TRAILER_ITEM_HEADER_SIZE);
+    return ITEM_SIZE;
+  }
+
+  /**
+   * Values from a reading's trailer item
+   * @return false if the reading has no such item
+   */
+  static bool findValues(const uint8_t* message, size_t length, uint8_t tag,
+                         float (&values)[COUNT]) {
+    const uint8_t* value;
+    size_t valueLen;
+    if (!wire::findTrailerItem(message, length, tag, &value, &valueLen)) return false;
+    decode(value, valueLen, values);
+    return true;
+  }
+
+private:
+  static_assert(COUNT > 0, "a schema needs channels");
+
+  template <size_t I>
+  static void put(float value, uint8_t* out) {
+    constexpr Channel C = CHANNELS[I];
+    constexpr uint8_t W = width(C);
+    constexpr uint32_t MISSING = (uint32_t)(((uint64_t)1 << W) - 1);
+    static_assert(W <= 32, "channel too fine for its range");
+    uint32_t code = MISSING;
+    if (value >= C.min && value <= C.max) {
+      code = (uint32_t)lroundf((value - C.min) / C.resolution);
+      if (code > steps(C)) code = steps(C);
+    }
+    constexpr size_t bit = offset(I);
+    for (uint8_t done = 0; done < W;) {
+      uint8_t shift = (uint8_t)((bit + done) % 8);
+      uint8_t take = (uint8_t)(8 - shift < W - done ? 8 - shift : W - done);
+      out[(bit + done) / 8] |= (uint8_t)(((code >> done) & ((1u << take) - 1)) << shift);
+      done += take;
+    }
+  }
+
+  template <size_t I>
+  static float get(const uint8_t* in, size_t length) {
+    constexpr Channel C = CHANNELS[I];
+    constexpr uint8_t W = width(C);
+    constexpr uint32_t MISSING = (uint32_t)(((uint64_t)1 << W) - 1);
+    constexpr size_t bit = offset(I);
+    if (bit + W > length * 8) return NAN;
+    uint32_t code = 0;
+    for (uint8_t done = 0; done < W;) {
+      uint8_t shift = (uint8_t)((bit + done) % 8);
+      uint8_t take = (uint8_t)(8 - shift < W - done ? 8 - shift : W - done);
+      code |= (uint32_t)((in[(bit + done) / 8] >> shift) & ((1u << take) - 1)) << done;
+      done += take;
+    }
+    return code == MISSING ? NAN : C.min + code * C.resolution;
+  }
+
+  template <size_t... I>
+  static void encodeEach(const float (&values)[COUNT], uint8_t* out, std::index_sequence<I...>) {
+    (put<I>(values[I], out), ...);
+  }
+
+  template <size_t... I>
+  static void decodeEach(const uint8_t* in, size_t length, float (&values)[COUNT],
+                         std::index_sequence<I...>) {
+    ((values[I] = get<I>(in, length)), ...);
+  }
+};
+
+// Channels a reading carries beyond the DataPacket; append only
+enum ExtraChannel : size_t {
+  EXTRA_PRESSURE,
+  EXTRA_COUNT
+};
+
+inline constexpr Channel EXTRA_CHANNELS[] = {
+  {"pressure", 300.0f, 1100.0f, 0.1f},      // hPa, the BME280's range
+};
+
+using Extra = Codec<EXTRA_CHANNELS>;
+static_assert(Extra::COUNT == EXTRA_COUNT, "ExtraChannel and EXTRA_CHANNELS differ");
+
+} // namespace schema
+
+#endif // SENSOR_SCHEMA_H
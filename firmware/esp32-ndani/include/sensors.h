@@ -9,7 +9,8 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
-#include <Arduino.h>
+#include "hal.h"
+#include "wire_codec.h"
 
 // Sensor data structure
 struct SensorData {
@@ -21,17 +22,6 @@ struct SensorData {
   bool valid;           // True if all readings valid
 };
 
-// Data packet for transmission
-struct DataPacket {
-  uint8_t commitment[32];   // Device commitment H(pk || r)
-  float temperature;
-  float humidity;
-  float soilMoisture;
-  uint32_t timestamp;
-  uint8_t nullifier[32];    // H(device_secret || epoch)
-  uint8_t signature[64];    // P-256 signature (R || S)
-};
-
 class Sensors {
 public:
   /**
@@ -70,12 +60,17 @@ public:
    * @return Bitmap of sensor status (bit 0 = BME280, bit 1 = soil)
    */
   uint8_t getStatus();
+  
+  /**
+   * Convert a raw soil probe ADC reading to moisture
+   * @param rawValue 12-bit ADC sample
+   * @return Soil moisture percentage (0-100)
+   */
+  float calibrateSoilReading(int rawValue);
 
 private:
   bool _bme280Init = false;
   bool _soilInit = false;
-  
-  float calibrateSoilReading(int rawValue);
 };
 
 #endif // SENSORS_H
@@ -0,0 +1,53 @@
+/**
+ * SHA-256 Header
+ *
+ * Portable streaming SHA-256 for data too large for the ATECC608B's SHA
+ * engine (firmware images: one I2C command per 64 bytes would take
+ * minutes). Pure C++ like wire_codec, so host tools hash the same way.
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Sha256 {
+public:
+  static const size_t DIGEST_SIZE = 32;
+
+  Sha256() { reset(); }
+
+  /**
+   * Start a new digest
+   */
+  void reset();
+
+  /**
+   * Hash more input
+   * @param data Input bytes
+   * @param length Number of bytes
+   */
+  void update(const uint8_t* data, size_t length);
+
+  /**
+   * Finish the digest; call reset() before reusing the object
+   * @param digest Output (DIGEST_SIZE bytes)
+   */
+  void finish(uint8_t* digest);
+
+  /**
+   * One-shot digest
+   */
+  static void hash(const uint8_t* data, size_t length, uint8_t* digest);
+
+private:
+  uint32_t _state[8];
+  uint64_t _length;        // Bytes hashed so far
+  uint8_t _block[64];
+  size_t _blockLen;
+
+  void compress(const uint8_t* block);
+};
+
+#endif // SHA256_H
@@ -0,0 +1,77 @@
+/**
+ * Loopback Transport Header
+ *
+ * The host build's test link (transport.h): what the firmware sends is
+ * handed to a host callback, message by message, when the batch is
+ * flushed, and what the host injects comes back from receive(). Its
+ * capabilities are those of a Wi-Fi link by default (batched, no duty
+ * cycle, far cheaper than LoRa) and can be changed to stand for any
+ * backend; setUp() takes it down, for good or while a condition holds,
+ * to exercise failover.
+ */
+
+#ifndef SIM_LOOPBACK_TRANSPORT_H
+#define SIM_LOOPBACK_TRANSPORT_H
+
+#ifdef ARDUINO
+#error "loopback_transport.h is only used by the native host build"
+#endif
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include "transport.h"
+#include "wire_codec.h"
+
+namespace sim {
+
+struct LoopbackStats {
+  uint32_t messages = 0;      // Delivered to the host
+  uint32_t batches = 0;
+  uint64_t bytes = 0;
+  uint32_t refused = 0;       // transmit() while down
+  uint32_t downlinks = 0;
+};
+
+class LoopbackTransport : public Transport {
+public:
+  typedef std::function<void(const uint8_t* message, size_t length)> Handler;
+  typedef std::function<bool()> Condition;
+
+  LinkCaps linkCaps = {LinkKind::Loopback, wire::MESSAGE_MAX, 1, 1, false, true};
+
+  void setHandler(Handler handler) { _handler = handler; }
+  void setUp(bool up) { _up = up; }
+
+  /**
+   * Up only while the condition holds (checked on every use)
+   */
+  void setUp(Condition up) { _upWhile = up; }
+
+  /**
+   * Queue a downlink message for receive()
+   */
+  void inject(const uint8_t* message, size_t length);
+
+  const LinkCaps& caps() const override { return linkCaps; }
+  bool ready() override { return _up && (!_upWhile || _upWhile()); }
+  bool transmit(const uint8_t* data, size_t length) override;
+  bool flush() override;
+  bool available() override { return !_rx.empty(); }
+  size_t receive(uint8_t* buffer, size_t maxLen) override;
+
+  const LoopbackStats& stats() const { return _stats; }
+
+private:
+  Handler _handler;
+  bool _up = true;
+  Condition _upWhile;
+  std::deque<std::string> _batch;
+  std::deque<std::string> _rx;
+  LoopbackStats _stats;
+};
+
+} // namespace sim
+
+#endif // SIM_LOOPBACK_TRANSPORT_H
@@ -0,0 +1,207 @@
+/**
+ * Shared LoRa Channel Model Header
+ *
+ * Radio medium for the fleet simulator: many simulated boards and one
+ * Freedom Node gateway on a single frequency. Covers log-distance path
+ * loss with per-node shadowing, SX127x sensitivity and SNR limits per SF,
+ * co-SF capture, inter-SF (quasi-orthogonal) rejection, a single-radio
+ * RYLR896 gateway that locks onto one frame at a time, and half-duplex
+ * downlinks (registration ACKs and retry-afters, epoch broadcasts) that
+ * occupy the channel. Registrations are paced like on the gateway
+ * (registration_protocol.h).
+ *
+ * Frames are resolved lazily: the simulator always steps the board with the
+ * smallest clock, so once every board is past a frame's end no further
+ * overlapping frame can appear and its fate is final.
+ */
+
+#ifndef SIM_LORA_CHANNEL_H
+#define SIM_LORA_CHANNEL_H
+
+#ifdef ARDUINO
+#error "lora_channel.h is only used by the native host build"
+#endif
+
+#include <stdint.h>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include "sim/sim_board.h"
+#include "registration_protocol.h"
+#include "wire_codec.h"
+
+namespace sim {
+
+/**
+ * Why a frame did or did not reach the gateway
+ */
+enum class FrameFate : uint8_t {
+  Delivered,
+  BelowSensitivity,   // RSSI/SNR under the demodulation floor for its SF
+  Collision,          // Lost to interference (co- or inter-SF)
+  GatewayBusy,        // Gateway radio already locked on another frame
+  GatewayTransmitting,// Gateway was sending a downlink (half-duplex)
+  WrongSpreadingFactor// Single-SF gateway configured for another SF
+};
+
+const char* frameFateName(FrameFate fate);
+
+/**
+ * Per-node counters collected by the channel
+ */
+struct NodeLinkStats {
+  double distanceM = 0;
+  double meanRssiDbm = 0;
+  uint8_t spreadingFactor = 0;
+  uint32_t framesSent = 0;
+  uint32_t fate[6] = {0};
+  uint32_t registrationsDelivered = 0;
+  uint32_t registrationsDeferred = 0;  // Answered with a retry-after
+  uint32_t dataDelivered = 0;
+  uint32_t downlinksSent = 0;
+  uint32_t downlinksLost = 0;
+  uint64_t airtimeUs = 0;
+  uint64_t firstAckUs = 0;            // Global time the first ACK reached the node
+  std::vector<uint64_t> dataLatencyUs;  // Sensor read -> gateway decode
+};
+
+class LoRaChannel : public RadioMedium {
+public:
+  struct Params {
+    uint16_t gatewayAddress = 1;
+    uint8_t gatewaySpreadingFactor = 9;
+    bool gatewayMultiSf = false;    // SX1301-class: any SF, 8 demodulators
+    int gatewayDemodulators = 1;
+    double gatewayTxPowerDbm = 20.0;
+    double antennaGainDb = 0.0;      // Combined TX + RX
+    double noiseFigureDb = 6.0;
+    // Log-distance model PL(d) = PL0 + 10 n log10(d / d0), defaults for open
+    // farmland at 868 MHz (LoRaSim's urban fit is PL0 127.41 dB, d0 40 m, n 2.08)
+    double pathLossD0Db = 80.0;
+    double d0M = 100.0;
+    double pathLossExponent = 3.0;
+    double shadowingSigmaDb = 3.57;  // Per-node, fixed
+    double fadingSigmaDb = 1.0;      // Per-frame
+    double captureThresholdDb = 6.0; // Co-SF capture margin
+    uint64_t ackTurnaroundUs = 250000;
+    uint32_t registrationsPerMin = reg::PACE_PER_MIN;   // 0: no pacing
+    uint32_t registrationBurst = reg::PACE_BURST;
+  };
+
+  LoRaChannel(const Params& params, uint64_t seed);
+
+  /**
+   * Attach a board at a distance from the gateway
+   * @return Node index
+   */
+  size_t addNode(Board* board, double distanceM);
+
+  /**
+   * Mean received power at the gateway for a node (dBm)
+   */
+  double meanRssiDbm(size_t node) const;
+
+  /**
+   * Smallest SF with at least marginDb of link budget for a node
+   */
+  uint8_t adrSpreadingFactor(size_t node, double marginDb) const;
+
+  void transmit(Board& from, const RadioFrame& frame) override;
+
+  /**
+   * Finalise every frame that ended at or before the given global time
+   * and run the gateway's responses to them
+   */
+  void resolveUntil(uint64_t globalUs);
+
+  /**
+   * Latest global time boards may fast-forward to without skipping a
+   * downlink that pending frames could still trigger
+   */
+  uint64_t horizonUs() const;
+
+  /**
+   * Broadcast an epoch update (type 0x02) to every node at a global time
+   */
+  void scheduleEpochBroadcast(uint32_t epoch, uint64_t atUs);
+
+  const std::vector<NodeLinkStats>& nodeStats() const { return _nodeStats; }
+  uint64_t gatewayAirtimeUs() const { return _gatewayAirtimeUs; }
+  uint64_t uplinkAirtimeUs() const { return _uplinkAirtimeUs; }
+  uint64_t deliveredPayloadBytes() const { return _deliveredBytes; }
+
+private:
+  struct PendingFrame {
+    RadioFrame frame;
+    size_t node = 0;
+    double rssiDbm = 0;
+    bool locked = false;     // Gateway demodulator assigned
+    FrameFate fate = FrameFate::Delivered;
+  };
+
+  struct Downlink {
+    uint64_t startUs;
+    uint64_t endUs;
+  };
+
+  struct Broadcast {
+    uint64_t atUs;
+    uint32_t epoch;
+  };
+
+  Params _params;
+  std::mt19937_64 _rng;
+  std::normal_distribution<double> _normal{0.0, 1.0};
+
+  std::vector<Board*> _boards;
+  std::vector<double> _shadowingDb;
+  std::vector<NodeLinkStats> _nodeStats;
+
+  std::deque<PendingFrame> _frames;   // Sorted by start time
+  size_t _resolved = 0;               // Frames [0, _resolved) are final
+  std::deque<Downlink> _downlinks;    // Gateway TX intervals, in order
+  std::deque<Broadcast> _broadcasts;
+  uint64_t _gatewayFreeUs = 0;
+  std::vector<uint64_t> _demodBusyUntil;
+
+  uint64_t _gatewayAirtimeUs = 0;
+  uint64_t _uplinkAirtimeUs = 0;
+  uint64_t _deliveredBytes = 0;
+  wire::Reassembler _reassembler;
+  reg::Pacer _pacer;
+
+  double pathLossDb(size_t node) const;
+  double noiseFloorDbm(uint16_t bandwidthKHz) const;
+  void decide(PendingFrame& pf);
+  void onDelivered(PendingFrame& pf);
+  void onMessage(PendingFrame& pf, const uint8_t* message, size_t length);
+  uint8_t downlinkSpreadingFactor(size_t node) const;
+  uint64_t sendDownlink(uint64_t earliestUs, size_t payloadChars, uint8_t spreadingFactor);
+  void sendBroadcast(const Broadcast& broadcast);
+  void deliverDownlink(size_t node, const std::string& payload, uint64_t startUs,
+                       uint64_t endUs, uint8_t spreadingFactor);
+  bool gatewayTransmittingDuring(uint64_t startUs, uint64_t endUs) const;
+  void prune(uint64_t globalUs);
+};
+
+/**
+ * SX127x demodulation floor at 125 kHz for SF7-SF12 (dBm)
+ */
+double loraSensitivityDbm(uint8_t spreadingFactor, uint16_t bandwidthKHz);
+
+/**
+ * Minimum SNR for demodulation (dB)
+ */
+double loraRequiredSnrDb(uint8_t spreadingFactor);
+
+/**
+ * Signal-to-interference ratio a frame at sfWanted needs to survive an
+ * interferer at sfInterferer (Croce et al., 2018); co-SF uses the capture
+ * threshold.
+ */
+double loraSirThresholdDb(uint8_t sfWanted, uint8_t sfInterferer, double captureDb);
+
+} // namespace sim
+
+#endif // SIM_LORA_CHANNEL_H
@@ -0,0 +1,36 @@
+/**
+ * Simulator Command-Line Helpers
+ *
+ * "--name value" and "--flag" lookup shared by the native host programs.
+ */
+
+#ifndef SIM_ARGS_H
+#define SIM_ARGS_H
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace sim {
+
+inline const char* argValue(int argc, char** argv, const char* name, const char* fallback) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], name) == 0) return argv[i + 1];
+  }
+  return fallback;
+}
+
+inline double argDouble(int argc, char** argv, const char* name, double fallback) {
+  const char* value = argValue(argc, argv, name, nullptr);
+  return value ? atof(value) : fallback;
+}
+
+inline bool argFlag(int argc, char** argv, const char* name) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+} // namespace sim
+
+#endif // SIM_ARGS_H
@@ -0,0 +1,564 @@
+/**
+ * Simulated Board Header
+ *
+ * Native-build stand-in for the Msingi hardware: a virtual clock, the
+ * RYLR896 module, the ATECC608B, the BME280, the soil probe ADC, the
+ * PSRAM and RTC memory the arena places buffers in, and a loopback link
+ * in place of Wi-Fi (loopback_transport.h).
+ * Every hal:: call made by the firmware is served by the board selected
+ * with Board::setCurrent(), so a host program can run one device or many
+ * devices side by side.
+ *
+ * Time only moves when the firmware blocks (hal::delay(), polling an empty
+ * UART, waiting for a peripheral conversion), so a month of 30-minute
+ * cycles runs in seconds.
+ */
+
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#ifdef ARDUINO
+#error "sim_board.h is only used by the native host build"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "i2c_bus.h"
+#include "mem_arena.h"
+#include "sim/loopback_transport.h"
+
+namespace sim {
+
+class Board;
+
+// ============= POWER MODEL =============
+
+/**
+ * Supply current per power state (mA). Defaults are datasheet typicals for
+ * the ESP32-S3-WROOM-1 and the RYLR896 at +20 dBm.
+ */
+struct EnergyProfile {
+  double cpuActiveMa = 45.0;     // CPU running (polling, crypto, formatting)
+  double cpuIdleMa = 22.0;       // Inside delay(): FreeRTOS idle, no light sleep
+  double deepSleepMa = 0.010;    // RTC only
+  double loraTxMa = 43.0;        // RYLR896 transmitting at +20 dBm
+  double loraRxMa = 16.5;        // RYLR896 in continuous receive
+  double batteryMah = 3000.0;    // Used for the battery-life estimate
+};
+
+enum class CpuState : uint8_t { Active, Idle, DeepSleep };
+
+/**
+ * Time spent in each power state since boot
+ */
+struct PowerStats {
+  uint64_t cpuActiveUs = 0;
+  uint64_t cpuIdleUs = 0;
+  uint64_t deepSleepUs = 0;
+  uint64_t radioTxUs = 0;
+  uint64_t radioRxUs = 0;
+
+  uint64_t awakeUs() const { return cpuActiveUs + cpuIdleUs; }
+
+  /**
+   * Charge drawn in mAh for the given profile
+   */
+  double energyMah(const EnergyProfile& profile) const;
+};
+
+// ============= RADIO =============
+
+/**
+ * One LoRa transmission as it appears on the air
+ */
+struct RadioFrame {
+  Board* origin = nullptr;
+  uint16_t srcAddress = 0;
+  uint16_t destAddress = 0;
+  uint8_t networkId = 0;
+  uint32_t frequency = 0;
+  uint8_t spreadingFactor = 9;
+  uint16_t bandwidthKHz = 125;
+  uint8_t codingRate = 1;
+  uint16_t preamble = 12;
+  int8_t txPowerDbm = 20;
+  uint64_t startUs = 0;          // Global simulation time
+  uint64_t endUs = 0;
+  std::string payload;           // AT+SEND data field (ASCII, sent verbatim)
+};
+
+/**
+ * Whatever the simulated module radiates into: a direct link to a gateway
+ * model, or a shared channel with many nodes.
+ */
+class RadioMedium {
+public:
+  virtual ~RadioMedium() = default;
+  virtual void transmit(Board& from, const RadioFrame& frame) = 0;
+};
+
+/**
+ * Counters kept by the simulated RYLR896
+ */
+struct RadioStats {
+  uint32_t sendCommands = 0;
+  uint32_t framesSent = 0;
+  uint32_t rejectedTooLong = 0;   // +ERR=13: more than 240 payload bytes
+  uint32_t rejectedOther = 0;
+  uint32_t framesReceived = 0;
+  uint64_t airtimeUs = 0;
+  uint64_t payloadBytes = 0;
+};
+
+/**
+ * RYLR896 model behind the LoRa UART: parses AT commands, answers with
+ * +OK / +ERR=n, keeps the radio busy for the frame's time on air and
+ * queues +RCV lines delivered by the medium.
+ */
+class Rylr896Model : public hal::Uart {
+public:
+  explicit Rylr896Model(Board& board) : _board(board) {}
+
+  void begin(uint32_t baud, int rxPin, int txPin) override;
+  int available() override;
+  int read() override;
+  size_t write(const uint8_t* data, size_t length) override;
+
+  /**
+   * Queue a line (including CR LF) for the host to read at the given
+   * board-local time
+   */
+  void deliver(const std::string& line, uint64_t atUs);
+
+  /**
+   * Deliver a received frame as "+RCV=<addr>,<len>,<data>,<rssi>,<snr>"
+   * at the given board-local time
+   */
+  void deliverFrame(uint16_t fromAddress, const std::string& payload,
+                    int rssi, int snr, uint64_t atUs);
+
+  void setMedium(RadioMedium* medium) { _medium = medium; }
+
+  uint16_t address() const { return _addressOverride ? _addressOverride : _address; }
+  uint8_t networkId() const { return _networkId; }
+  uint8_t spreadingFactor() const { return _sfOverride ? _sfOverride : _sf; }
+  uint16_t bandwidthKHz() const { return _bwKHz; }
+  uint8_t codingRate() const { return _cr; }
+  uint16_t preamble() const { return _preamble; }
+  int8_t txPowerDbm() const { return _txPower; }
+  bool transmitting(uint64_t atUs) const { return atUs < _txUntilUs; }
+  uint64_t txUntilUs() const { return _txUntilUs; }   // Board-local time
+
+  /**
+   * Force the spreading factor regardless of AT+PARAMETER
+   * (0 = honour the host's configuration)
+   */
+  void overrideSpreadingFactor(uint8_t sf) { _sfOverride = sf; }
+
+  /**
+   * Force the module address regardless of AT+ADDRESS, as per-unit
+   * provisioning would (0 = honour the host's configuration)
+   */
+  void overrideAddress(uint16_t address) { _addressOverride = address; }
+
+  const RadioStats& stats() const { return _stats; }
+
+  /**
+   * Board-local time of the earliest queued line (UINT64_MAX if none)
+   */
+  uint64_t nextRxUs() const { return _rx.empty() ? UINT64_MAX : _rx.begin()->first; }
+
+private:
+  Board& _board;
+  RadioMedium* _medium = nullptr;
+  std::string _command;
+  std::multimap<uint64_t, std::string> _rx;   // ready time -> line
+  size_t _rxOffset = 0;                       // bytes consumed of the head line
+
+  uint16_t _address = 0;
+  uint8_t _networkId = 0;
+  uint32_t _frequency = 915000000;
+  uint8_t _sf = 12;
+  uint16_t _bwKHz = 125;
+  uint8_t _cr = 1;
+  uint16_t _preamble = 4;
+  int8_t _txPower = 15;
+  uint8_t _sfOverride = 0;
+  uint16_t _addressOverride = 0;
+  uint64_t _txUntilUs = 0;
+
+  RadioStats _stats;
+
+  void handleCommand(const std::string& cmd);
+  void handleSend(const std::string& args);
+  void reply(const char* line, uint64_t atUs);
+};
+
+// ============= SECURE ELEMENT =============
+
+/**
+ * ATECC608B state: P-256 keys per slot and the device MAC secret.
+ * Keys are derived from the board seed so runs are reproducible.
+ */
+struct AteccModel {
+  bool present = true;
+  uint8_t serial[9] = {0};
+  bool slotProvisioned[16] = {false};
+  uint8_t slotPrivate[16][32] = {{0}};
+  uint8_t slotPublic[16][64] = {{0}};
+  uint8_t macSecret[32] = {0};
+  std::mt19937_64 rng;
+  uint32_t commands = 0;
+};
+
+/**
+ * ATECC608B command execution times in microseconds (datasheet typicals)
+ */
+namespace atecc_timing {
+constexpr uint32_t WAKE_US = 1500;
+constexpr uint32_t GENKEY_US = 85000;
+constexpr uint32_t SIGN_US = 50000;
+constexpr uint32_t VERIFY_US = 58000;
+constexpr uint32_t SHA_US = 2000;
+constexpr uint32_t MAC_US = 14000;
+constexpr uint32_t RANDOM_US = 23000;
+} // namespace atecc_timing
+
+// ============= ENVIRONMENT =============
+
+/**
+ * Synthetic field conditions: diurnal temperature and humidity, and a soil
+ * probe that dries out over a few days between irrigation events.
+ * Optionally a sensor hub's probes too (probe_hub.h): soil probes on the
+ * analog mux that each dry at their own rate, and BME280s behind the I2C
+ * mux that sit a little lower in the canopy the higher their channel.
+ */
+class EnvironmentModel : public hal::EnvSensor {
+public:
+  /**
+   * A BME280 behind one channel of the hub's I2C mux
+   */
+  class HubSensor : public hal::EnvSensor {
+  public:
+    bool begin(uint8_t address) override;
+    void takeForcedMeasurement() override;
+    float readTemperature() override { return _temperature; }
+    float readHumidity() override { return _humidity; }
+    float readPressure() override { return _pressure; }
+
+  private:
+    friend class EnvironmentModel;
+    EnvironmentModel* _env = nullptr;
+    uint8_t _channel = 0;
+    float _temperature = 0;
+    float _humidity = 0;
+    float _pressure = 0;
+  };
+
+  explicit EnvironmentModel(Board& board) : _board(board) {
+    for (uint8_t ch = 0; ch < 8; ch++) {
+      _hub[ch]._env = this;
+      _hub[ch]._channel = ch;
+    }
+  }
+
+  bool begin(uint8_t address) override;
+  void takeForcedMeasurement() override;
+  float readTemperature() override { return _temperature; }
+  float readHumidity() override { return _humidity; }
+  float readPressure() override { return _pressure; }
+
+  /**
+   * Raw 12-bit soil probe reading at the current virtual time
+   * @param probe 0 for the board's probe, 1-8 for hub probes
+   */
+  int soilAdc(int probe = 0);
+
+  HubSensor& hubSensor(uint8_t channel) { return _hub[channel & 7]; }
+
+  bool bmePresent = true;
+  double meanTemperature = 22.0;
+  double temperatureSwing = 8.0;
+  double irrigationPeriodHours = 96.0;
+
+  // Sensor hub hardware, absent unless set
+  int hubSoilProbes = 0;          // Probes on the analog mux
+  uint8_t hubEnvMask = 0;         // Mux channels with a BME280
+  uint8_t hubSelect = 0;          // Analog mux select lines
+  uint8_t hubI2cChannels = 0;     // I2C mux control register
+
+private:
+  Board& _board;
+  float _temperature = 0;
+  float _humidity = 0;
+  float _pressure = 0;
+  std::normal_distribution<double> _noise{0.0, 1.0};
+  HubSensor _hub[8];
+
+  /**
+   * One forced conversion: bus traffic and conversion time, then the
+   * conditions offsetC away from the board's
+   */
+  void convert(double offsetC, float* temperature, float* humidity, float* pressure);
+};
+
+// ============= FLASH =============
+
+/**
+ * Flash operation times (typical for the ESP32-S3's quad SPI flash)
+ */
+namespace flash_timing {
+constexpr uint32_t SECTOR_ERASE_US = 45000;
+constexpr uint32_t PAGE_PROGRAM_US = 700;    // Per 256-byte page
+} // namespace flash_timing
+
+/**
+ * The two app partitions. The running image is a synthetic 256 KiB
+ * build unless one is loaded; the inactive partition keeps only the
+ * sectors that have been erased (everything else reads as 0xFF) and
+ * takes the place of the running image on the restart after
+ * activateUpdate().
+ */
+class FlashModel : public hal::FirmwareSlots {
+public:
+  static const size_t PARTITION_SIZE = 0x640000;   // default_16MB.csv app slots
+
+  explicit FlashModel(Board& board) : _board(board) {}
+
+  void setRunningImage(const std::vector<uint8_t>& image) { _running = image; }
+  const std::vector<uint8_t>& runningImage();
+
+  /**
+   * Power cycle: switch images if an update was activated
+   */
+  void reboot();
+
+  size_t runningSize() override { return runningImage().size(); }
+  bool readRunning(size_t offset, uint8_t* data, size_t length) override;
+  size_t updateCapacity() override { return PARTITION_SIZE; }
+  bool eraseUpdate(size_t offset, size_t length) override;
+  bool writeUpdate(size_t offset, const uint8_t* data, size_t length) override;
+  bool readUpdate(size_t offset, uint8_t* data, size_t length) override;
+  bool activateUpdate(size_t length) override;
+  void confirmRunning() override {}
+
+  uint32_t sectorsErased = 0;
+  uint64_t bytesWritten = 0;
+  uint32_t imageSwaps = 0;
+
+private:
+  Board& _board;
+  std::vector<uint8_t> _running;
+  std::map<size_t, std::vector<uint8_t>> _sectors;   // Inactive partition, by sector index
+  size_t _activatedLength = 0;                        // 0 = keep the running image
+};
+
+/**
+ * The history data partition. Sparse like the inactive app partition:
+ * only sectors that have been erased are kept, the rest reads as 0xFF.
+ * Survives hal::restart().
+ */
+class DataFlashModel : public hal::DataPartition {
+public:
+  static const size_t PARTITION_SIZE = 0x360000;   // default_16MB.csv "spiffs"
+
+  explicit DataFlashModel(Board& board) : _board(board) {}
+
+  size_t size() override { return PARTITION_SIZE; }
+  bool erase(size_t offset, size_t length) override;
+  bool write(size_t offset, const uint8_t* data, size_t length) override;
+  bool read(size_t offset, uint8_t* data, size_t length) override;
+
+  uint32_t sectorsErased = 0;
+  uint64_t bytesWritten = 0;
+
+private:
+  Board& _board;
+  std::map<size_t, std::vector<uint8_t>> _sectors;
+};
+
+// ============= NVS =============
+
+/**
+ * NVS partition: named records that survive hal::restart(), like the
+ * real one survives resets and power loss
+ */
+class NvsModel : public hal::Nvs {
+public:
+  size_t get(const char* key, void* data, size_t maxLength) override;
+  bool put(const char* key, const void* data, size_t length) override;
+  void remove(const char* key) override { _records.erase(key); }
+
+  uint32_t writes = 0;
+
+private:
+  std::map<std::string, std::vector<uint8_t>> _records;
+};
+
+// ============= MEMORY =============
+
+/**
+ * PSRAM and the RTC pool at their real sizes, for hal::memAlloc(). Internal
+ * RAM is the host heap: it is not measured, and there are no task stacks.
+ */
+class MemoryModel {
+public:
+  static const size_t PSRAM_BYTES = 8 * 1024 * 1024;
+
+  bool psramPresent = true;   // N16R8 module; false for an N16 without PSRAM
+
+  void* alloc(hal::MemRegion region, size_t bytes);
+  bool info(hal::MemRegion region, hal::HeapInfo* info) const;
+
+private:
+  std::vector<std::vector<uint8_t>> _blocks;
+  size_t _used[hal::MEM_REGIONS] = {0};
+  size_t capacity(hal::MemRegion region) const;
+};
+
+// ============= BOARD =============
+
+/**
+ * Thrown out of the firmware when the board reaches its stop time
+ */
+struct StopSimulation {};
+
+/**
+ * Thrown out of the firmware by hal::restart(); the host calls setup()
+ * again. RAM is not cleared, so setup() must initialise what it uses.
+ */
+struct Restart {};
+
+class Board {
+public:
+  Board(uint32_t id, uint64_t seed);
+
+  /**
+   * Board that serves hal:: calls
+   */
+  static Board& current();
+  static void setCurrent(Board* board);
+
+  uint32_t id() const { return _id; }
+
+  // Clock
+
+  uint64_t nowUs() const { return _nowUs; }
+
+  /**
+   * Advance the virtual clock, charging the interval to a CPU power state.
+   * Throws StopSimulation once the stop time is reached.
+   */
+  void advanceUs(uint64_t us, CpuState state = CpuState::Active);
+
+  void setStopAtUs(uint64_t us) { _stopAtUs = us; }
+  uint64_t stopAtUs() const { return _stopAtUs; }
+
+  /**
+   * Global simulation time at which this board powered on. The board
+   * clock (nowUs(), millis()) counts from boot; radio frames and media
+   * use global time.
+   */
+  void setBootAtUs(uint64_t us) { _bootAtUs = us; }
+  uint64_t bootAtUs() const { return _bootAtUs; }
+  uint64_t globalUs() const { return _bootAtUs + _nowUs; }
+  uint64_t localUs(uint64_t globalUs) const {
+    return globalUs > _bootAtUs ? globalUs - _bootAtUs : 0;
+  }
+
+  /**
+   * Wall-clock time of boot, used for diurnal environment curves
+   */
+  double bootHourOfDay = 6.0;
+
+  /**
+   * Crystal error: the firmware's millis() and micros() run this many
+   * parts per million fast (negative: slow)
+   */
+  double clockDriftPpm = 0.0;
+  uint64_t firmwareUs() const { return (uint64_t)(_nowUs * (1.0 + clockDriftPpm * 1e-6)); }
+
+  // Peripherals
+
+  Rylr896Model& lora() { return _lora; }
+  AteccModel& atecc() { return _atecc; }
+  EnvironmentModel& env() { return _env; }
+  FlashModel& flash() { return _flash; }
+  NvsModel& nvs() { return _nvs; }
+  DataFlashModel& dataFlash() { return _dataFlash; }
+  std::mt19937_64& rng() { return _rng; }
+
+  void setI2cClock(uint32_t hz) { _i2cClockHz = hz; }
+  uint32_t i2cClockHz() const { return _i2cClockHz; }
+  I2cBus& i2cBus() { return _i2cBus; }
+
+  MemoryModel& memory() { return _memory; }
+  MemArena& memArena() { return _memArena; }
+
+  /**
+   * Link handed to the firmware by hal::hostLink() while attached
+   */
+  LoopbackTransport& loopback() { return _loopback; }
+  bool loopbackAttached = false;
+
+  /**
+   * Charge an I2C transfer of the given size to the clock
+   */
+  void i2cTransfer(size_t bytes);
+
+  // Power
+
+  const PowerStats& power() const { return _power; }
+
+  /**
+   * Mark the radio as transmitting until the given time
+   */
+  void radioTransmitUntil(uint64_t us) { _radioTxUntilUs = us; }
+
+  // Console
+
+  void setConsole(FILE* out) { _console = out; }
+  void consoleWrite(const char* text, size_t length);
+
+  /**
+   * Queue text as if typed into the USB console
+   */
+  void queueConsoleInput(const std::string& text) { _consoleInput += text; }
+  int consoleAvailable() const { return (int)(_consoleInput.size() - _consoleInputPos); }
+  int consoleRead() {
+    return _consoleInputPos < _consoleInput.size() ? (uint8_t)_consoleInput[_consoleInputPos++] : -1;
+  }
+
+private:
+  uint32_t _id;
+  uint64_t _nowUs = 0;
+  uint64_t _stopAtUs = UINT64_MAX;
+  uint64_t _bootAtUs = 0;
+  uint64_t _radioTxUntilUs = 0;
+  uint32_t _i2cClockHz = 100000;
+  I2cBus _i2cBus;
+  MemoryModel _memory;
+  MemArena _memArena;
+  LoopbackTransport _loopback;
+  std::mt19937_64 _rng;
+  PowerStats _power;
+  Rylr896Model _lora;
+  AteccModel _atecc;
+  EnvironmentModel _env;
+  FlashModel _flash;
+  NvsModel _nvs;
+  DataFlashModel _dataFlash;
+  FILE* _console = nullptr;
+  bool _lineStart = true;
+  std::string _consoleInput;
+  size_t _consoleInputPos = 0;
+};
+
+} // namespace sim
+
+#endif // SIM_BOARD_H
@@ -0,0 +1,138 @@
+/**
+ * Time Sync Header
+ *
+ * Network time for reading timestamps, shared by the device, the
+ * gateway's beacon and the simulators:
+ * - Time beacon (MSG_TIME): type, Unix seconds (u32 LE), milliseconds
+ *   (u16 LE), stamped by the gateway as it hands the frame to its module.
+ *   Broadcast on a fixed schedule and sent by unicast to devices whose
+ *   readings show they have no recent sync.
+ * - The receiver adds the frame's time on air and keeps the result as its
+ *   base; between beacons it extrapolates from millis(), corrected by the
+ *   crystal drift it measured over earlier beacon intervals.
+ * - A synced reading's timestamp is Unix seconds instead of milliseconds
+ *   since boot, and the reading carries a trailer item
+ *   (wire::TRAILER_TIME): sync age and drift estimate. Readings without
+ *   the item still count from boot.
+ *
+ * Pure C++ with no Arduino or HAL dependency, like wire_codec.
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace tsync {
+
+const size_t BEACON_SIZE = 7;          // Type, seconds, milliseconds
+const size_t REPORT_SIZE = 4;          // Sync age, drift
+const uint16_t AGE_MAX_MIN = 0xFFFF;   // Report saturates here
+
+const uint32_t DRIFT_MIN_INTERVAL_MS = 3600000;   // Shorter intervals are mostly jitter
+const int32_t DRIFT_MAX_PPB = 500000;             // ±500 ppm: anything more is not drift
+const uint32_t SYNC_VALID_MS = 20UL * 86400000UL; // Well inside the millis() wrap
+
+/**
+ * Sync report carried in the reading trailer
+ */
+struct Report {
+  uint16_t ageMin;          // Minutes since the last beacon
+  int16_t driftDeciPpm;     // Local clock rate error, 0.1 ppm (positive: fast)
+};
+
+/**
+ * Encode a time beacon
+ * @param unixMs Gateway time, milliseconds since 1970
+ * @param out Output (BEACON_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeBeacon(uint64_t unixMs, uint8_t* out);
+
+/**
+ * Parse a time beacon
+ * @param frame Received frame (starting with MSG_TIME)
+ * @param length Frame length
+ * @param unixMs Output: gateway time when the frame was sent
+ * @return false if malformed
+ */
+bool parseBeacon(const uint8_t* frame, size_t length, uint64_t* unixMs);
+
+/**
+ * Encode the trailer item
+ * @param out Output (wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE bytes)
+ * @return Bytes written
+ */
+size_t encodeReport(const Report& report, uint8_t* out);
+
+/**
+ * Sync report in a reading's trailer
+ * @return false if the reading's timestamp counts from boot
+ */
+bool findReport(const uint8_t* message, size_t length, Report* report);
+
+/**
+ * Local millisecond counter mapped onto gateway time
+ */
+class Clock {
+public:
+  /**
+   * A beacon arrived
+   * @param unixMs Gateway time at reception (beacon plus time on air)
+   * @param localMs millis() at reception
+   */
+  void onBeacon(uint64_t unixMs, uint32_t localMs);
+
+  /**
+   * Whether now() has a base that is not too old to extrapolate from
+   */
+  bool synced(uint32_t localMs) const {
+    return _synced && localMs - _baseLocalMs < SYNC_VALID_MS;
+  }
+
+  /**
+   * Gateway time, drift-corrected
+   * @param localMs millis()
+   * @return Milliseconds since 1970, 0 if not synced
+   */
+  uint64_t now(uint32_t localMs) const;
+
+  /**
+   * Report for a reading taken at localMs (only meaningful when synced)
+   */
+  Report report(uint32_t localMs) const;
+
+  /**
+   * Drift estimate, parts per billion (positive: the local clock runs fast)
+   */
+  int32_t driftPpb() const { return _driftPpb; }
+
+  /**
+   * Start from a drift measured before a reset; the crystal keeps its error
+   */
+  void setDrift(int32_t ppb);
+
+  /**
+   * Offset of the last beacon from what the clock predicted for it
+   * @return Milliseconds (positive: the clock was behind)
+   */
+  int32_t lastErrorMs() const { return _lastErrorMs; }
+
+  uint32_t beacons() const { return _beacons; }
+
+private:
+  bool _synced = false;
+  uint64_t _baseUnixMs = 0;
+  uint32_t _baseLocalMs = 0;
+  uint64_t _anchorUnixMs = 0;       // Start of the current drift interval
+  uint32_t _anchorLocalMs = 0;
+  int32_t _driftPpb = 0;
+  uint32_t _driftSamples = 0;
+  int32_t _lastErrorMs = 0;
+  uint32_t _beacons = 0;
+};
+
+} // namespace tsync
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,201 @@
+/**
+ * Transport Header
+ *
+ * The links a Msingi node can reach the proof server over, behind one
+ * interface:
+ * - LoRa (lora_comm.h): always fitted, slow, and sent over within the
+ *   duty-cycle airtime budget
+ * - Wi-Fi (wifi_transport.h): batched HTTP POSTs to PROOF_SERVER_URL over
+ *   a kept-alive connection, for nodes in reach of an access point (a
+ *   barn, a pump house)
+ * - Loopback (sim/loopback_transport.h): the host build's test link
+ *
+ * Every link carries the same messages (wire_codec.h) and describes
+ * itself with LinkCaps, which the sensor node's scheduler reads: a
+ * duty-cycled link waits for airtime, the others send as fast as they
+ * take messages, and a batched link collects messages until flush().
+ *
+ * TransportSet is a Transport too, so the clients that send now and then
+ * (BRACE, OTA) hold it and never see which link carried a message. It
+ * routes each message to the cheapest ready link that takes its size (or
+ * the one pinned with prefer()), and fails over: a link whose send fails
+ * is passed over for LINK_RETRY_MS while another one is ready.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum class LinkKind : uint8_t {
+  LoRa,
+  Wifi,
+  Loopback
+};
+
+struct LinkCaps {
+  LinkKind kind;
+  size_t mtu;                 // Longest message transmit() takes
+  uint16_t cost;              // Per message, relative (energy, airtime); the lowest is used
+  uint32_t latencyMs;         // Typical time for a message to reach the proof server
+  bool dutyCycled;            // Sent within the LoRa airtime budget
+  bool batched;               // transmit() collects, flush() sends
+};
+
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  virtual const LinkCaps& caps() const = 0;
+
+  /**
+   * Whether the link can carry a message now (associated, peer added)
+   */
+  virtual bool ready() { return true; }
+
+  /**
+   * Send a message, or add it to the batch on a batched link
+   * @param data Message
+   * @param length Message length (at most caps().mtu)
+   * @return true if sent, or taken into the batch
+   */
+  virtual bool transmit(const uint8_t* data, size_t length) = 0;
+
+  /**
+   * Send what a batched link has collected
+   * @return false if the batch could not be delivered
+   */
+  virtual bool flush() { return true; }
+
+  /**
+   * Check if a downlink message is waiting
+   */
+  virtual bool available() = 0;
+
+  /**
+   * Receive a downlink message
+   * @param buffer Output buffer
+   * @param maxLen Maximum bytes to read
+   * @return Message length, 0 if none
+   */
+  virtual size_t receive(uint8_t* buffer, size_t maxLen) = 0;
+};
+
+/**
+ * Short name of a link kind ("lora", "wifi", "loopback")
+ */
+const char* linkName(LinkKind kind);
+
+/**
+ * Parse a link name
+ * @return false if it is not one
+ */
+bool parseLinkName(const char* name, LinkKind* kind);
+
+struct LinkStats {
+  uint32_t messages = 0;      // Sent (or batched)
+  uint64_t bytes = 0;
+  uint32_t failures = 0;
+  uint32_t flushes = 0;       // Batches delivered
+};
+
+class TransportSet : public Transport {
+public:
+  static const size_t LINKS_MAX = 4;
+
+  /**
+   * Remove every link and the pin
+   */
+  void clear();
+
+  /**
+   * Add a link
+   * @return false if the set is full
+   */
+  bool add(Transport* link);
+
+  /**
+   * Send over this kind whenever it is ready, ahead of cheaper links
+   */
+  void prefer(LinkKind kind);
+
+  /**
+   * Go back to the cheapest ready link
+   */
+  void preferNone() { _pinned = false; }
+
+  bool pinned(LinkKind* kind) const;
+
+  /**
+   * The link a message of this length goes over now: the pinned one, else
+   * the cheapest that is ready, takes the length and has not failed in
+   * the last LINK_RETRY_MS; one that has, if nothing else is left
+   * @return nullptr if no link is ready
+   */
+  Transport* route(size_t length);
+
+  /**
+   * Send over a link route() gave, counting it; a failure has the link
+   * passed over for LINK_RETRY_MS
+   */
+  bool send(Transport* link, const uint8_t* data, size_t length);
+
+  size_t links() const { return _count; }
+  Transport& link(size_t index) { return *_links[index]; }
+  const LinkStats& stats(size_t index) const { return _stats[index]; }
+
+  /**
+   * Whether a link is being passed over after a failure
+   */
+  bool backedOff(size_t index) const;
+
+  // Transport: route(), then the next link on a failure
+
+  const LinkCaps& caps() const override;   // Of the link the last message went over
+  bool ready() override { return route(0) != nullptr; }
+  bool transmit(const uint8_t* data, size_t length) override;
+  bool flush() override;
+  bool available() override;
+  size_t receive(uint8_t* buffer, size_t maxLen) override;
+
+private:
+  Transport* _links[LINKS_MAX];
+  LinkStats _stats[LINKS_MAX];
+  uint32_t _failedMs[LINKS_MAX];
+  bool _failed[LINKS_MAX];
+  size_t _count = 0;
+  size_t _last = 0;
+  bool _pinned = false;
+  LinkKind _pin = LinkKind::LoRa;
+
+  int indexOf(const Transport* link) const;
+};
+
+namespace xport {
+
+// A batch (a Wi-Fi POST body, or the downlinks in its response) is a run of
+// records: length (u16 BE), then the message as it would go over LoRa
+const size_t RECORD_HEADER_SIZE = 2;
+
+/**
+ * Append a message to a batch
+ * @param batch Batch buffer
+ * @param used Bytes already in it
+ * @param capacity Buffer size
+ * @return New batch length, 0 if the record does not fit
+ */
+size_t appendRecord(uint8_t* batch, size_t used, size_t capacity, const uint8_t* message,
+                    size_t length);
+
+/**
+ * Next message of a batch
+ * @param offset Read position, advanced past the record
+ * @return false at the end of the batch, or on a truncated record
+ */
+bool nextRecord(const uint8_t* batch, size_t length, size_t* offset, const uint8_t** message,
+                size_t* messageLength);
+
+} // namespace xport
+
+#endif // TRANSPORT_H
@@ -0,0 +1,145 @@
+/**
+ * Uplink Queue Header
+ *
+ * Readings waiting for the radio, by priority class, and the airtime
+ * budget they are sent against:
+ * - Urgent (alerts) go first and are never held for a batch
+ * - Routine readings wait until a batch is full, and leave a reserve of
+ *   the budget untouched so an alert can still go out at once
+ * - When routine readings pile up (the budget is spent, or the radio is
+ *   failing) the oldest routine reading is dropped first
+ *
+ * The budget is a token bucket: it refills at the duty cycle and holds
+ * at most one window's worth, so bursts are allowed but the long-run
+ * share of the air never exceeds the duty cycle.
+ *
+ * The entries are passed in by begin(), so the outbox can be placed
+ * outside internal RAM (mem_arena.h).
+ *
+ * Pure C++ with no Arduino or HAL dependency: times are passed in.
+ */
+
+#ifndef UPLINK_QUEUE_H
+#define UPLINK_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wire_codec.h"
+#include "probe_protocol.h"
+
+enum class Priority : uint8_t {
+  Urgent = 0,
+  Routine = 1,
+};
+
+struct UplinkStats {
+  uint32_t urgentSent = 0;
+  uint32_t routineSent = 0;
+  uint32_t deferrals = 0;       // Times routine readings had to wait for budget
+  uint32_t dropped = 0;         // Overwritten while waiting
+};
+
+class UplinkQueue {
+public:
+  static const size_t CAPACITY = 8;
+  static const size_t ENTRY_MAX = probe::PACKET_MAX + 32;   // Reading + trailer items
+
+  struct Entry {
+    Priority priority;
+    uint32_t order;             // Arrival order, for FIFO within a class
+    size_t length;
+    uint8_t data[ENTRY_MAX];
+  };
+
+  /**
+   * Attach the storage and empty the queue; until then push() fails
+   * @param entries CAPACITY entries
+   */
+  void begin(Entry* entries);
+
+  /**
+   * Queue a message. When full, the oldest routine message makes room
+   * (the oldest urgent one if there is no routine message).
+   * @return false if the message is longer than ENTRY_MAX, or there is
+   *         no storage
+   */
+  bool push(Priority priority, const uint8_t* message, size_t length);
+
+  /**
+   * Next message to send: the oldest urgent one, else the oldest routine one
+   * @return false if the queue is empty
+   */
+  bool front(Priority* priority, const uint8_t** message, size_t* length) const;
+
+  /**
+   * Remove the message front() returned
+   */
+  void pop();
+
+  size_t count(Priority priority) const { return _count[(int)priority]; }
+  bool empty() const { return _size == 0; }
+
+  UplinkStats& stats() { return _stats; }
+  const UplinkStats& stats() const { return _stats; }
+
+  /**
+   * Time on air of a message as LoRaComm sends it (hex, fragmented past
+   * wire::MAX_FRAME_BYTES)
+   * @return Microseconds
+   */
+  static uint32_t airtimeUs(size_t length, uint8_t spreadingFactor, uint16_t bandwidthKHz);
+
+private:
+  Entry* _entries = nullptr;
+  size_t _size = 0;
+  size_t _count[2] = {0, 0};
+  uint32_t _nextOrder = 0;
+  UplinkStats _stats;
+
+  int find(Priority priority) const;
+  void remove(size_t index);
+};
+
+/**
+ * Duty-cycle token bucket
+ */
+class AirtimeBudget {
+public:
+  /**
+   * @param permille Share of the air allowed (10 = 1%)
+   * @param windowMs Longest burst, as the window the share applies over
+   */
+  AirtimeBudget(uint32_t permille, uint32_t windowMs)
+      : _permille(permille), _capacityUs(windowMs * permille), _balanceUs(windowMs * permille) {}
+
+  /**
+   * Whether a transmission fits, keeping some of the budget back
+   * @param airtimeUs Time on air
+   * @param reserveUs Budget that must remain afterwards
+   * @param nowMs Current time
+   */
+  bool allows(uint32_t airtimeUs, uint32_t reserveUs, uint32_t nowMs);
+
+  /**
+   * Charge a transmission
+   */
+  void charge(uint32_t airtimeUs) { _balanceUs -= (int64_t)airtimeUs; }
+
+  /**
+   * Milliseconds until allows() would pass
+   */
+  uint32_t msUntil(uint32_t airtimeUs, uint32_t reserveUs, uint32_t nowMs);
+
+  uint32_t capacityUs() const { return _capacityUs; }
+
+private:
+  uint32_t _permille;
+  uint32_t _capacityUs;
+  int64_t _balanceUs;
+  uint32_t _refilledMs = 0;
+  bool _started = false;
+
+  void refill(uint32_t nowMs);
+};
+
+#endif // UPLINK_QUEUE_H
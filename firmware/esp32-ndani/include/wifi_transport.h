@@ -0,0 +1,79 @@
+/**
+ * Wi-Fi Transport Header
+ *
+ * Link to the proof server over Wi-Fi, for nodes in reach of an access
+ * point. Messages are collected into a batch (transport.h records) and
+ * POSTed to PROOF_SERVER_URL PROOF_SERVER_UPLINK_PATH in one request on
+ * flush(), or when the next one would not fit, over a connection kept
+ * alive between POSTs. The response body is a batch too: the downlinks
+ * queued for the device, handed out by receive().
+ *
+ * A batch whose POST fails is kept and sent again with the next flush,
+ * WIFI_POST_RETRIES times, then dropped; while it is kept, transmit()
+ * refuses what does not fit beside it, so the messages fail over to
+ * another link.
+ *
+ * The buffers are passed in by begin() (mem_arena.h), and only nodes with
+ * WIFI_SSID set take them.
+ */
+
+#ifndef WIFI_TRANSPORT_H
+#define WIFI_TRANSPORT_H
+
+#include "hal.h"
+#include "config.h"
+#include "transport.h"
+#include "wire_codec.h"
+
+struct WifiStats {
+  uint32_t posts = 0;         // Batches delivered
+  uint32_t failedPosts = 0;
+  uint32_t dropped = 0;       // Messages in batches given up on
+  uint32_t downlinks = 0;
+};
+
+class WifiTransport : public Transport {
+public:
+  struct Buffers {
+    uint8_t batch[WIFI_BATCH_BYTES];
+    uint8_t response[WIFI_BATCH_BYTES];
+  };
+
+  /**
+   * Start joining the access point
+   * @param ssid Network name; empty leaves the link off
+   * @param password Passphrase
+   * @param address Device address, sent with each POST (the gateway's
+   *        LoRa source address)
+   * @param buffers Batch and response buffers
+   * @return false if the link stays off
+   */
+  bool begin(const char* ssid, const char* password, uint16_t address, Buffers* buffers);
+
+  const LinkCaps& caps() const override { return _caps; }
+
+  /**
+   * Associated, with buffers
+   */
+  bool ready() override;
+
+  bool transmit(const uint8_t* data, size_t length) override;
+  bool flush() override;
+  bool available() override;
+  size_t receive(uint8_t* buffer, size_t maxLen) override;
+
+  const WifiStats& stats() const { return _stats; }
+
+private:
+  LinkCaps _caps = {LinkKind::Wifi, wire::MESSAGE_MAX, 1, 300, false, true};
+  Buffers* _buffers = nullptr;
+  char _url[96];
+  size_t _batchLength = 0;
+  size_t _batchMessages = 0;
+  uint8_t _attempts = 0;      // Failed POSTs of the batch held
+  size_t _responseLength = 0;
+  size_t _responseOffset = 0;
+  WifiStats _stats;
+};
+
+#endif // WIFI_TRANSPORT_H
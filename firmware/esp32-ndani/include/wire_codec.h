@@ -0,0 +1,263 @@
+/**
+ * Wire Codec Header
+ *
+ * Byte-level formats shared by the firmware and host tools:
+ * - DataPacket layout (144 bytes, little-endian, signature over the first 80
+ *   and a sensor hub's probes item)
+ * - Hex encoding used on the RYLR896 AT interface
+ * - AT+SEND command formatting and +RCV line parsing
+ * - Fragmentation of messages longer than one RYLR896 frame
+ * - Trailer items after the DataPacket in a reading message
+ *
+ * Pure C++ with no Arduino or HAL dependency, so the gateway and the
+ * benchmarks can link it directly.
+ */
+
+#ifndef WIRE_CODEC_H
+#define WIRE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Data packet for transmission
+struct DataPacket {
+  uint8_t commitment[32];   // Device commitment H(pk || r)
+  float temperature;
+  float humidity;
+  float soilMoisture;
+  uint32_t timestamp;       // Unix seconds once synced (time_sync.h), else ms since boot
+  uint8_t nullifier[32];    // H(device_secret || epoch)
+  uint8_t signature[64];    // P-256 signature (R || S)
+};
+
+namespace wire {
+
+const size_t DATA_PACKET_SIZE = 144;         // Serialized DataPacket
+const size_t DATA_PACKET_SIGNED_SIZE = 80;   // Bytes covered by the signature
+const size_t REGISTRATION_SIZE = 97;         // Type, commitment, signature over both
+const size_t RCV_LINE_MAX = 512;             // Longest +RCV line we accept
+const size_t MAX_FRAME_BYTES = 120;          // 240 hex chars, the AT+SEND limit
+
+// Message type, first payload byte
+const uint8_t MSG_REGISTRATION = 0x00;       // Device -> server: 0x00 + commitment + signature
+const uint8_t MSG_REGISTRATION_ACK = 0x01;   // Server -> device
+const uint8_t MSG_EPOCH = 0x02;              // Server -> device: epoch, big-endian u32
+const uint8_t MSG_PROOF_CONFIRMATION = 0x03; // Server -> device
+const uint8_t MSG_ECHO_REQUEST = 0x04;       // Device -> gateway: 0x04 + seq + padding
+const uint8_t MSG_ECHO_REPLY = 0x05;         // Gateway -> device: 0x05 + seq + RSSI + SNR (int8)
+const uint8_t MSG_FRAGMENT = 0x06;           // Either way: header + chunk, see below
+const uint8_t MSG_OTA_OFFER = 0x07;          // Gateway -> device: signed update offer
+const uint8_t MSG_OTA_CHUNK = 0x08;          // Gateway -> device: one patch chunk
+const uint8_t MSG_OTA_STATUS = 0x09;         // Device -> gateway: update progress
+                                             // (OTA layouts are in ota_protocol.h)
+const uint8_t MSG_CONFIG = 0x0A;             // Gateway -> device(s): remote settings
+                                             // (layout in config_protocol.h)
+const uint8_t MSG_TIME = 0x0B;               // Gateway -> device(s): time beacon
+                                             // (layout in time_sync.h)
+const uint8_t MSG_HISTORY_QUERY = 0x0C;      // Gateway -> device: stored history range
+const uint8_t MSG_HISTORY = 0x0D;            // Device -> gateway: history records
+                                             // (layouts in history_protocol.h)
+const uint8_t MSG_FL_MODEL = 0x0E;           // Gateway -> device(s): global forecast model
+const uint8_t MSG_FL_UPDATE = 0x0F;          // Device -> gateway: sparse model delta
+                                             // (layouts in fl_protocol.h)
+const uint8_t MSG_REGISTRATION_RETRY = 0x10; // Gateway -> device: come back later
+                                             // (layout in registration_protocol.h)
+const uint8_t MSG_BUNDLE = 0x11;             // Gateway -> device: downlinks sharing a frame
+                                             // (layout in downlink_protocol.h)
+
+// A reading is the 144-byte DataPacket (no type byte), optionally followed
+// by trailer items outside the signature: tag, length, value. Receivers
+// skip tags they do not know. The one exception is a sensor hub's probes
+// item, which comes first and is signed with the DataPacket.
+const uint8_t TRAILER_CONFIG = 0x01;         // Settings version report (config_protocol.h)
+const uint8_t TRAILER_ALERT = 0x02;          // Alert rules tripped (alert_rules.h)
+const uint8_t TRAILER_TIME = 0x03;           // Timestamp is network time (time_sync.h)
+const uint8_t TRAILER_ANALYTICS = 0x04;      // Derived values and events (edge_analytics.h)
+const uint8_t TRAILER_PROBES = 0x05;         // Sensor hub channels, signed (probe_protocol.h)
+const uint8_t TRAILER_CHANNELS = 0x06;       // Channels beyond the DataPacket (sensor_schema.h)
+const size_t TRAILER_ITEM_HEADER_SIZE = 2;
+
+// Fragment frame: 0x06, sequence (u16 LE), index << 4 | count, chunk.
+// All fragments of a message share the sequence number; the reassembled
+// message is handled exactly like an unfragmented frame.
+const size_t FRAGMENT_HEADER_SIZE = 4;
+const size_t FRAGMENT_CHUNK_MAX = MAX_FRAME_BYTES - FRAGMENT_HEADER_SIZE;
+const size_t FRAGMENT_COUNT_MAX = 15;
+const size_t MESSAGE_MAX = FRAGMENT_CHUNK_MAX * FRAGMENT_COUNT_MAX;
+
+/**
+ * Encode bytes as uppercase hex
+ * @param data Input bytes
+ * @param length Number of input bytes
+ * @param out Output buffer (2 * length + 1 chars, NUL-terminated)
+ * @return Number of hex characters written
+ */
+size_t hexEncode(const uint8_t* data, size_t length, char* out);
+
+/**
+ * Decode hex (either case) to bytes
+ * @param hex Input characters
+ * @param hexLen Number of input characters (odd trailing nibble ignored)
+ * @param out Output buffer
+ * @param maxLen Output capacity
+ * @return Bytes decoded, or 0 if a non-hex character is found
+ */
+size_t hexDecode(const char* hex, size_t hexLen, uint8_t* out, size_t maxLen);
+
+/**
+ * Format "AT+SEND=<address>,<hexLen>,<hex>" without the line terminator
+ * @param out Output buffer
+ * @param outSize Output capacity including the NUL
+ * @param address Destination address
+ * @param data Payload bytes (sent hex-encoded)
+ * @param length Payload length
+ * @return Command length, or 0 if it does not fit
+ */
+size_t formatSend(char* out, size_t outSize, uint16_t address, const uint8_t* data,
+                  size_t length);
+
+/**
+ * One received frame: "+RCV=<address>,<length>,<data>,<RSSI>,<SNR>"
+ * data points into the parsed line (not copied, not NUL-terminated)
+ */
+struct RcvFrame {
+  uint16_t address;
+  const char* data;
+  size_t dataLen;
+  int rssi;
+  int snr;
+};
+
+/**
+ * Parse a +RCV line in place
+ * @param line Line as read from the module (CR/LF optional)
+ * @param lineLen Line length
+ * @param frame Output, pointing into line
+ * @return true if the line is a well-formed +RCV
+ */
+bool parseRcv(const char* line, size_t lineLen, RcvFrame* frame);
+
+/**
+ * Serialize a DataPacket to its 144-byte wire form
+ * @param packet Packet to encode
+ * @param out Output buffer (DATA_PACKET_SIZE bytes)
+ * @return DATA_PACKET_SIZE
+ */
+size_t serializeDataPacket(const DataPacket& packet, uint8_t* out);
+
+/**
+ * Parse a 144-byte DataPacket
+ * @param in Wire bytes
+ * @param length Number of bytes available
+ * @param packet Output
+ * @return true if length matches
+ */
+bool parseDataPacket(const uint8_t* in, size_t length, DataPacket* packet);
+
+/**
+ * Whether a message is a reading: a DataPacket and well-formed trailer items
+ * @param message Reassembled message
+ * @param length Message length
+ */
+bool isReading(const uint8_t* message, size_t length);
+
+/**
+ * Find a trailer item of a reading
+ * @param message Reading message (DataPacket + trailer)
+ * @param length Message length
+ * @param tag Item tag
+ * @param value Output: item value inside message
+ * @param valueLen Output: value length
+ * @return true if the item is present
+ */
+bool findTrailerItem(const uint8_t* message, size_t length, uint8_t tag,
+                     const uint8_t** value, size_t* valueLen);
+
+struct FragmentHeader {
+  uint16_t seq;
+  uint8_t index;
+  uint8_t count;
+};
+
+/**
+ * Number of fragments a message needs
+ * @param messageLen Message length
+ * @return Fragment count, or 0 if the message exceeds MESSAGE_MAX
+ */
+size_t fragmentCount(size_t messageLen);
+
+/**
+ * Build one fragment frame of a message
+ * @param message Whole message
+ * @param messageLen Message length
+ * @param seq Sequence number shared by all fragments
+ * @param index Fragment index (0-based)
+ * @param out Output buffer (MAX_FRAME_BYTES)
+ * @return Frame length, or 0 if index is out of range
+ */
+size_t buildFragment(const uint8_t* message, size_t messageLen, uint16_t seq, uint8_t index,
+                     uint8_t* out);
+
+/**
+ * Split a fragment frame into header and chunk
+ * @param frame Received frame
+ * @param frameLen Frame length
+ * @param header Output header
+ * @param chunk Output: chunk inside frame
+ * @param chunkLen Output: chunk length
+ * @return true if the frame is a well-formed fragment
+ */
+bool parseFragment(const uint8_t* frame, size_t frameLen, FragmentHeader* header,
+                   const uint8_t** chunk, size_t* chunkLen);
+
+/**
+ * Rebuilds fragmented messages from any number of senders. Fixed memory:
+ * when all slots are busy the oldest partial message is discarded.
+ */
+class Reassembler {
+public:
+  static const size_t SLOTS = 32;
+
+  /**
+   * Add a received fragment frame
+   * @param address Sender address
+   * @param frame Fragment frame (starting with MSG_FRAGMENT)
+   * @param frameLen Frame length
+   * @param nowMs Receive time, for expiry and eviction
+   * @param out Output buffer for the completed message (MESSAGE_MAX)
+   * @param seq Output: sequence number of the completed message
+   * @return Message length once the last fragment arrives, else 0
+   */
+  size_t add(uint16_t address, const uint8_t* frame, size_t frameLen, uint32_t nowMs,
+             uint8_t* out, uint16_t* seq);
+
+  /**
+   * Drop partial messages whose first fragment is older than maxAgeMs
+   */
+  void expire(uint32_t nowMs, uint32_t maxAgeMs);
+
+  uint32_t completed() const { return _completed; }
+  uint32_t discarded() const { return _discarded; }   // Expired or evicted
+  uint32_t malformed() const { return _malformed; }
+
+private:
+  struct Slot {
+    bool used = false;
+    uint16_t address = 0;
+    uint16_t seq = 0;
+    uint8_t count = 0;
+    uint16_t received = 0;       // Bitmap of fragment indexes
+    uint16_t lastChunkLen = 0;
+    uint32_t firstMs = 0;
+    uint8_t data[MESSAGE_MAX];
+  };
+
+  Slot _slots[SLOTS];
+  uint32_t _completed = 0;
+  uint32_t _discarded = 0;
+  uint32_t _malformed = 0;
+};
+
+} // namespace wire
+
+#endif // WIRE_CODEC_H
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Report the static RAM a Msingi firmware image takes, by region.
+
+Reads the symbol table of the linked ELF (objdump -t) and sums the data
+objects in each RAM region: internal SRAM (.dram0.*, .noinit; .data/.bss
+on host builds), RTC memory (.rtc*) and PSRAM (.ext_ram*). The largest
+objects are listed, so a new buffer shows up next to the ones it competes
+with. Heap and stack use at run time are on the self-test console (mem).
+
+Standalone:
+    scripts/mem_report.py .pio/build/esp32s3-msingi/firmware.elf
+        [--objdump TOOL] [--top N] [--budget-internal BYTES]
+
+As a PlatformIO post script (extra_scripts = post:scripts/mem_report.py)
+it runs after every link, with the toolchain's objdump. Set
+custom_static_ram_budget = BYTES in the environment to fail the build
+when internal static RAM grows past it.
+
+Exit status is 1 if the internal total is over the budget.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+SYMBOL = re.compile(r"^[0-9a-f]+\s(.{7})\s(\S+)\s+([0-9a-f]+)\s+(.*)$")
+
+REGIONS = ("internal", "rtc", "psram")
+
+
+def region_of(section):
+    """RAM region of an output section, or None for flash and metadata."""
+    if section.startswith(".rtc"):
+        return "rtc"
+    if section.startswith(".ext_ram"):
+        return "psram"
+    if section.startswith((".dram0.", ".noinit")) or section in (".data", ".bss", ".tbss",
+                                                                  ".tdata"):
+        return "internal"
+    return None
+
+
+def load(elf, objdump):
+    """Return [(size, region, section, name)] for the data objects in RAM."""
+    out = subprocess.run([objdump, "-t", "-C", "-w", elf], check=True, capture_output=True,
+                         text=True).stdout
+    objects = []
+    for line in out.splitlines():
+        m = SYMBOL.match(line)
+        if not m or "O" not in m.group(1):
+            continue
+        size = int(m.group(3), 16)
+        region = region_of(m.group(2))
+        if size == 0 or region is None:
+            continue
+        objects.append((size, region, m.group(2), m.group(4).strip()))
+    return objects
+
+
+def report(elf, objdump, top, budget):
+    objects = load(elf, objdump)
+    totals = {region: 0 for region in REGIONS}
+    for size, region, _, _ in objects:
+        totals[region] += size
+
+    print("Static RAM: " + ", ".join(f"{region} {totals[region]} B" for region in REGIONS))
+    for size, region, section, name in sorted(objects, reverse=True)[:top]:
+        print(f"  {size:8d}  {region:8s} {section:20s} {name}")
+
+    if budget and totals["internal"] > budget:
+        print(f"Internal static RAM {totals['internal']} B is over the budget of {budget} B")
+        return 1
+    return 0
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf")
+    parser.add_argument("--objdump", default="objdump")
+    parser.add_argument("--top", type=int, default=20, help="largest objects to list")
+    parser.add_argument("--budget-internal", type=int, default=0,
+                        help="fail above this many bytes of internal static RAM")
+    args = parser.parse_args(argv)
+    return report(args.elf, args.objdump, args.top, args.budget_internal)
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+except NameError:
+    env = None
+
+if env is not None:
+    # xtensa-esp32s3-elf-gcc -> xtensa-esp32s3-elf-objdump (gcc -> objdump natively)
+    tool = re.sub(r"gcc$", "objdump", env.subst("$CC"))
+    limit = int(env.GetProjectOption("custom_static_ram_budget", "0"))
+
+    def after_link(target, source, env):
+        if report(str(target[0]), tool, 20, limit) != 0:
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_link)
+elif __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Supply the OTA release key (OTA_RELEASE_PUBLIC_KEY) to a Msingi build.
+
+Devices install only update offers and apply only remote settings signed
+by the release key, and the key is never in the source tree. It comes from a PEM file (public, or the
+private key on a signing machine):
+    custom_release_key = PATH        in the environment, or
+    EDGECHAIN_RELEASE_KEY=PATH       in the shell environment
+An -DOTA_RELEASE_PUBLIC_KEY=... already in build_flags wins over both.
+
+Without any, a device build stops at the #error in config.h. A native
+build gets a throwaway key instead, generated once per build directory
+as $BUILD_DIR/release-dev.pem: campaigns and settings for the simulator
+are signed with it (edgechain-ota-pack / edgechain-config-pack
+--key .pio/build/native/release-dev.pem).
+
+Standalone, prints the flag for a PEM file (for builds outside
+PlatformIO):
+    scripts/release_key.py KEY.pem
+    scripts/release_key.py --generate dev.pem   (creates it if missing)
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+FLAG = "OTA_RELEASE_PUBLIC_KEY"
+
+
+def public_key(pem):
+    """X || Y of a P-256 key in a PEM file, public or private"""
+    with open(pem, "rb") as f:
+        public = b"PUBLIC KEY" in f.read()
+    command = ["openssl", "ec", "-in", pem, "-outform", "DER"]
+    command += ["-pubin"] if public else ["-pubout"]
+    der = subprocess.run(command, check=True, capture_output=True).stdout
+    # SubjectPublicKeyInfo ends with the uncompressed point 04 || X || Y
+    if len(der) < 65 or der[-65] != 0x04:
+        raise ValueError(f"{pem}: not an uncompressed P-256 key")
+    return der[-64:]
+
+
+def generate(pem):
+    """Create a P-256 private key unless the file exists"""
+    if not os.path.exists(pem):
+        os.makedirs(os.path.dirname(os.path.abspath(pem)), exist_ok=True)
+        subprocess.run(["openssl", "ecparam", "-name", "prime256v1", "-genkey", "-noout",
+                        "-out", pem], check=True, capture_output=True)
+    return pem
+
+
+def define(key):
+    """Initializer list without braces: no shell quoting needed"""
+    return ",".join(f"0x{b:02X}" for b in key)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("pem")
+    parser.add_argument("--generate", action="store_true",
+                        help="create a throwaway private key first if the file is missing")
+    args = parser.parse_args(argv)
+    pem = generate(args.pem) if args.generate else args.pem
+    print(f"-D{FLAG}={define(public_key(pem))}")
+    return 0
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+except NameError:
+    env = None
+
+if env is not None:
+    given = any(d == FLAG or (isinstance(d, (tuple, list)) and d[0] == FLAG)
+                for d in env.get("CPPDEFINES", []))
+    pem = (env.GetProjectOption("custom_release_key", "")
+           or os.environ.get("EDGECHAIN_RELEASE_KEY", ""))
+    if not given and not pem and env.PioPlatform().name == "native":
+        pem = generate(os.path.join(env.subst("$BUILD_DIR"), "release-dev.pem"))
+        print(f"OTA release key: throwaway {pem}")
+    if not given and pem:
+        env.Append(CPPDEFINES=[(FLAG, define(public_key(pem)))])
+elif __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,87 @@
+/**
+ * Alert Rules Implementation
+ */
+
+#include "alert_rules.h"
+#include "config.h"
+#include "config_protocol.h"
+#include "wire_codec.h"
+#include <math.h>
+#include <stdio.h>
+
+namespace alert {
+
+namespace {
+
+/**
+ * One rule's hysteresis: trip on crossing the threshold, clear once the
+ * value is back past it by the margin
+ * @param below Rule fires below the threshold (else above)
+ */
+void check(uint8_t rule, float value, float threshold, float margin, bool below,
+           uint8_t* active, uint8_t* tripped) {
+  if (isnan(value)) return;
+  bool alarm = below ? value < threshold : value > threshold;
+  bool clear = below ? value >= threshold + margin : value <= threshold - margin;
+  if (alarm && !(*active & rule)) {
+    *active |= rule;
+    *tripped |= rule;
+  } else if (clear) {
+    *active &= (uint8_t)~rule;
+  }
+}
+
+} // namespace
+
+uint8_t RuleState::update(const rcfg::Settings& settings, float temperature, float soilMoisture) {
+  // Rules switched off forget their state, so switching one back on can trip it
+  _active &= settings.alertRules;
+  uint8_t tripped = 0;
+  if (settings.alertRules & FROST) {
+    check(FROST, temperature, settings.alertTemperatureLow / 100.0f,
+          ALERT_HYSTERESIS_TEMPERATURE, true, &_active, &tripped);
+  }
+  if (settings.alertRules & HEAT) {
+    check(HEAT, temperature, settings.alertTemperatureHigh / 100.0f,
+          ALERT_HYSTERESIS_TEMPERATURE, false, &_active, &tripped);
+  }
+  if (settings.alertRules & DRY_SOIL) {
+    check(DRY_SOIL, soilMoisture, settings.alertSoilLow / 100.0f, ALERT_HYSTERESIS_SOIL, true,
+          &_active, &tripped);
+  }
+  return tripped;
+}
+
+size_t encodeTrailer(uint8_t rules, uint8_t* out) {
+  out[0] = wire::TRAILER_ALERT;
+  out[1] = 1;
+  out[2] = rules;
+  return TRAILER_SIZE;
+}
+
+uint8_t findAlerts(const uint8_t* message, size_t length) {
+  const uint8_t* value;
+  size_t valueLen;
+  if (!wire::findTrailerItem(message, length, wire::TRAILER_ALERT, &value, &valueLen) ||
+      valueLen < 1) {
+    return 0;
+  }
+  return value[0] & ALL;
+}
+
+size_t formatNames(uint8_t rules, char* out, size_t size) {
+  static const struct { uint8_t rule; const char* name; } NAMES[] = {
+    {FROST, "frost"}, {HEAT, "heat"}, {DRY_SOIL, "dry_soil"},
+  };
+  size_t n = 0;
+  if (size > 0) out[0] = '\0';
+  for (const auto& entry : NAMES) {
+    if (!(rules & entry.rule)) continue;
+    int written = snprintf(out + n, size - n, "%s%s", n ? "," : "", entry.name);
+    if (written < 0 || (size_t)written >= size - n) break;
+    n += (size_t)written;
+  }
+  return n;
+}
+
+} // namespace alert
@@ -0,0 +1,206 @@
+/**
+ * Benchmark Cases Implementation
+ *
+ * Each case is one call into firmware code exactly as the device uses it.
+ * Results go through a volatile sink so the compiler cannot drop the work.
+ */
+
+#include "bench/bench_cases.h"
+#include "config.h"
+#include "i2c_bus.h"
+
+namespace bench {
+
+namespace {
+
+volatile uint32_t sink = 0;
+
+const uint32_t MAX_ITERATIONS = 1000000;
+
+// ============= CODEC =============
+
+bool hexEncodePacket(Fixture& f) {
+  sink += wire::hexEncode(f.wireBytes, sizeof(f.wireBytes), f.hex);
+  return true;
+}
+
+bool hexDecodePacket(Fixture& f) {
+  size_t n = wire::hexDecode(f.hex, 2 * sizeof(f.wireBytes), f.scratch, sizeof(f.scratch));
+  sink += f.scratch[n - 1];
+  return n == sizeof(f.wireBytes);
+}
+
+// LoRaComm::transmit() builds this command for every uplink
+bool formatSendData(Fixture& f) {
+  size_t n = wire::formatSend(f.command, sizeof(f.command), PROOF_SERVER_LORA_ADDRESS,
+                              f.wireBytes, sizeof(f.wireBytes));
+  sink += n;
+  return n > 0;
+}
+
+bool formatSendRegistration(Fixture& f) {
+  size_t n = wire::formatSend(f.command, sizeof(f.command), PROOF_SERVER_LORA_ADDRESS,
+                              f.registration, sizeof(f.registration));
+  sink += n;
+  return n > 0;
+}
+
+// LoRaComm::receive() after the line has been read from the UART
+bool parseRcvPacket(Fixture& f) {
+  wire::RcvFrame frame;
+  if (!wire::parseRcv(f.rcvLine, f.rcvLen, &frame)) return false;
+  size_t n = wire::hexDecode(frame.data, frame.dataLen, f.scratch, sizeof(f.scratch));
+  sink += n + frame.rssi;
+  return n == sizeof(f.wireBytes);
+}
+
+bool serializePacket(Fixture& f) {
+  sink += wire::serializeDataPacket(f.packet, f.scratch);
+  sink += f.scratch[47];
+  return true;
+}
+
+bool parsePacket(Fixture& f) {
+  DataPacket packet;
+  bool ok = wire::parseDataPacket(f.wireBytes, sizeof(f.wireBytes), &packet);
+  sink += packet.timestamp;
+  return ok;
+}
+
+bool calibrateSoil(Fixture& f) {
+  f.soilRaw = (f.soilRaw + 37) & 0x0FFF;
+  float moisture = f.sensors.calibrateSoilReading(f.soilRaw);
+  sink += (uint32_t)moisture;
+  return true;
+}
+
+// ============= CRYPTO (ATECC608B) =============
+
+bool computeCommitment(Fixture& f) {
+  return f.brace.computeCommitment();
+}
+
+bool signPacket(Fixture& f) {
+  uint8_t signature[64];
+  bool ok = f.se.sign(f.wireBytes, wire::DATA_PACKET_SIGNED_SIZE, signature);
+  sink += signature[0];
+  return ok;
+}
+
+bool computeNullifier(Fixture& f) {
+  uint8_t nullifier[32];
+  bool ok = f.se.computeNullifier(f.epoch++, nullifier);
+  sink += nullifier[0];
+  return ok;
+}
+
+// ============= COMMITMENT TREE =============
+
+// A proof from the gateway checked against the epoch root
+bool verifyMerklePath(Fixture& f) {
+  bool ok = merkle::verifyPath(f.packet.commitment, 12345, f.merklePath, f.merkleRoot);
+  sink += ok;
+  return ok;
+}
+
+const Case CASES[] = {
+  {"hex_encode/144", hexEncodePacket, 10000},
+  {"hex_decode/144", hexDecodePacket, 10000},
+  {"format_send/144", formatSendData, 10000},
+  {"format_send/33", formatSendRegistration, 10000},
+  {"parse_rcv/144", parseRcvPacket, 10000},
+  {"serialize_packet", serializePacket, 10000},
+  {"parse_packet", parsePacket, 10000},
+  {"calibrate_soil", calibrateSoil, 10000},
+  {"compute_commitment", computeCommitment, 10},
+  {"sign/80", signPacket, 10},
+  {"compute_nullifier", computeNullifier, 10},
+  {"merkle_verify/20", verifyMerklePath, 100},
+};
+
+} // namespace
+
+bool Fixture::begin() {
+  hal::i2cBus().begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  if (!se.begin()) return false;
+  if (!se.isKeyProvisioned(SLOT_DEVICE_KEY) && !se.generateKey(SLOT_DEVICE_KEY)) {
+    return false;
+  }
+  brace.begin(&se, &lora);
+
+  // Representative packet: fixed readings, non-trivial byte patterns
+  memset(&packet, 0, sizeof(packet));
+  for (int i = 0; i < 32; i++) {
+    packet.commitment[i] = (uint8_t)(i * 7 + 3);
+    packet.nullifier[i] = (uint8_t)(0xA5 ^ (i * 13));
+  }
+  packet.temperature = 23.5f;
+  packet.humidity = 61.2f;
+  packet.soilMoisture = 37.8f;
+  packet.timestamp = 1800000;
+  wire::serializeDataPacket(packet, wireBytes);
+  if (!se.sign(wireBytes, wire::DATA_PACKET_SIGNED_SIZE, packet.signature)) return false;
+  wire::serializeDataPacket(packet, wireBytes);
+
+  for (size_t level = 0; level < merkle::DEPTH; level++) {
+    for (size_t i = 0; i < merkle::HASH_SIZE; i++) merklePath[level][i] = (uint8_t)(level * 31 + i);
+  }
+  merkle::rootFromPath(packet.commitment, 12345, merklePath, merkleRoot);
+
+  registration[0] = wire::MSG_REGISTRATION;
+  memcpy(registration + 1, packet.commitment, 32);
+  if (!se.sign(registration, 33, registration + 33)) return false;
+
+  // The line the gateway's module prints for this packet
+  wire::hexEncode(wireBytes, sizeof(wireBytes), hex);
+  rcvLen = (size_t)snprintf(rcvLine, sizeof(rcvLine), "+RCV=%d,%u,%s,-97,8\r\n",
+                            LORA_DEVICE_ADDRESS, (unsigned)(2 * sizeof(wireBytes)), hex);
+  return true;
+}
+
+const Case* allCases(size_t* count) {
+  *count = sizeof(CASES) / sizeof(CASES[0]);
+  return CASES;
+}
+
+void runCycleBenchmarks(Fixture& fixture, uint32_t minTimeMs) {
+  const uint32_t mhz = hal::cpuFrequencyMhz();
+  const uint64_t minCycles = (uint64_t)minTimeMs * 1000ULL * mhz;
+
+  Serial.println("BENCH_JSON_BEGIN");
+  Serial.printf("{\"context\":{\"executable\":\"msingi-bench\",\"firmware\":\"%s\","
+                "\"num_cpus\":1,\"mhz_per_cpu\":%lu,\"library_build_type\":\"release\"},\n"
+                "\"benchmarks\":[\n", FIRMWARE_VERSION, (unsigned long)mhz);
+
+  size_t count;
+  const Case* cases = allCases(&count);
+  for (size_t i = 0; i < count; i++) {
+    const Case& c = cases[i];
+    bool ok = c.run(fixture);   // Warm-up: caches, lazy init
+
+    // Cheap cases are timed in batches so the counter read is negligible
+    uint32_t batch = c.minIterations >= 1000 ? 100 : 1;
+    uint64_t cycles = 0;
+    uint32_t iterations = 0;
+    while ((iterations < c.minIterations || cycles < minCycles) && iterations < MAX_ITERATIONS) {
+      uint32_t start = hal::cycleCount();
+      for (uint32_t b = 0; b < batch; b++) ok &= c.run(fixture);
+      cycles += (uint32_t)(hal::cycleCount() - start);
+      iterations += batch;
+    }
+
+    double cyclesPerIteration = (double)cycles / iterations;
+    double ns = cyclesPerIteration * 1000.0 / mhz;
+    Serial.printf("{\"name\":\"%s\",\"run_name\":\"%s\",\"run_type\":\"iteration\","
+                  "\"iterations\":%lu,\"real_time\":%.1f,\"cpu_time\":%.1f,"
+                  "\"time_unit\":\"ns\",\"cycles_per_iteration\":%.1f%s}%s\n",
+                  c.name, c.name, (unsigned long)iterations, ns, ns, cyclesPerIteration,
+                  ok ? "" : ",\"error_occurred\":true",
+                  i + 1 < count ? "," : "");
+  }
+
+  Serial.println("]}");
+  Serial.println("BENCH_JSON_END");
+}
+
+} // namespace bench
@@ -0,0 +1,37 @@
+/**
+ * Benchmark Entry Point - Device
+ *
+ * Replaces main.cpp in the esp32s3-bench environment. Runs every case with
+ * the CPU cycle counter at boot and prints JSON over USB CDC; send 'r' to
+ * run again. Capture with:
+ *   pio device monitor -e esp32s3-bench | tee bench.log
+ */
+
+#ifdef ARDUINO
+
+#include "bench/bench_cases.h"
+
+static bench::Fixture fixture;
+static bool ready = false;
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial && hal::millis() < 3000);
+
+  Serial.println("Msingi benchmark suite");
+  ready = fixture.begin();
+  if (!ready) {
+    Serial.println("✗ ATECC608B initialization failed!");
+    return;
+  }
+  bench::runCycleBenchmarks(fixture, 200);
+}
+
+void loop() {
+  if (ready && Serial.available() && Serial.read() == 'r') {
+    bench::runCycleBenchmarks(fixture, 200);
+  }
+  hal::delay(10);
+}
+
+#endif // ARDUINO
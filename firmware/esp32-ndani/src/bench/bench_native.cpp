@@ -0,0 +1,62 @@
+/**
+ * Benchmark Entry Point - Host
+ *
+ * Registers every case with Google Benchmark and runs them on a simulated
+ * board. Wall-clock figures measure the portable code on the host CPU;
+ * the sim_device_us counter is the virtual time the board model charged
+ * per iteration (ATECC608B command latency and I2C transfers).
+ *
+ * Usage: program [--benchmark_filter=REGEX] [--benchmark_format=json]
+ *                [--benchmark_out=FILE] [--device-json]
+ *
+ * --device-json runs the device's cycle-counter runner instead, against
+ * the virtual clock, which shows the modelled device cost of each case.
+ */
+
+#ifndef ARDUINO
+
+#include "bench/bench_cases.h"
+#include "sim/sim_args.h"
+#include "sim/sim_board.h"
+#include <benchmark/benchmark.h>
+
+int main(int argc, char** argv) {
+  sim::Board board(0, 1);
+  sim::Board::setCurrent(&board);
+
+  bench::Fixture fixture;
+  if (!fixture.begin()) {
+    fprintf(stderr, "bench: secure element initialisation failed\n");
+    return 1;
+  }
+
+  if (sim::argFlag(argc, argv, "--device-json")) {
+    board.setConsole(stdout);
+    bench::runCycleBenchmarks(fixture, 200);
+    return 0;
+  }
+
+  size_t count;
+  const bench::Case* cases = bench::allCases(&count);
+  for (size_t i = 0; i < count; i++) {
+    const bench::Case* c = &cases[i];
+    benchmark::RegisterBenchmark(c->name, [c, &fixture, &board](benchmark::State& state) {
+      uint64_t simStart = board.nowUs();
+      for (auto _ : state) {
+        if (!c->run(fixture)) {
+          state.SkipWithError("case reported failure");
+          break;
+        }
+      }
+      state.counters["sim_device_us"] = benchmark::Counter(
+          (double)(board.nowUs() - simStart), benchmark::Counter::kAvgIterations);
+    });
+  }
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
+
+#endif // !ARDUINO
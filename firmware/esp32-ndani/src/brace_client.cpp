@@ -4,49 +4,122 @@
  * Implements anonymous device registration:
  * 1. Generate random blinding factor r
  * 2. Compute commitment C = H("commitment" || pk || r)
- * 3. Send C to proof server (pk and r stay secret)
+ * 3. Send C, signed with the device key, to proof server (pk and r stay secret)
  * 4. Proof server adds C to Merkle tree
  */
 
 #include "brace_client.h"
 #include "config.h"
+#include "wire_codec.h"
 
-void BraceClient::begin(SecureElement* se, LoRaComm* lora) {
+namespace {
+
+// NVS record "brace": format, registered, attempts, blinding factor
+const char* const NVS_KEY = "brace";
+const uint8_t RECORD_FORMAT = 1;
+const size_t RECORD_SIZE = 3 + 32;
+
+} // namespace
+
+void BraceClient::begin(SecureElement* se, Transport* link) {
   _se = se;
-  _lora = lora;
-  _registered = false;
-  
-  // Check if we have a stored blinding factor
-  // If so, reconstruct the commitment
-  // In production, store this in ATECC608B slot
-  
-  // For now, check if slot 1 has data (blinding factor)
-  uint8_t testKey[64];
-  if (_se->getPublicKey(SLOT_BLINDING_FACTOR, testKey)) {
-    // Blinding factor exists, compute commitment
-    if (computeCommitment()) {
-      _registered = true;
-    }
+  _link = link;
+  _state = State::Pending;
+  _attempts = 0;
+  _haveBlindingFactor = false;
+  _haveCommitment = false;
+  
+  // Progress from before the reset: the blinding factor of the commitment
+  // already sent, and whether the server acknowledged it
+  bool acknowledged = false;
+  uint8_t record[RECORD_SIZE];
+  if (hal::nvs().get(NVS_KEY, record, sizeof(record)) == RECORD_SIZE &&
+      record[0] == RECORD_FORMAT) {
+    acknowledged = record[1] != 0;
+    _attempts = record[2];
+    memcpy(_blindingFactor, record + 3, 32);
+    _haveBlindingFactor = true;
+    _haveCommitment = computeCommitment();
+  }
+  if (acknowledged && _haveCommitment) {
+    _state = State::Registered;
+    return;
+  }
+  
+  // Spread the first attempt: over the boot window, or over the backoff
+  // window reached before the reset if that is longer
+  uint32_t window = BOOT_JITTER_MS;
+  if (_attempts > 0) {
+    uint32_t shift = _attempts - 1 < 16 ? _attempts - 1 : 16;
+    uint64_t backoff = (uint64_t)REG_BACKOFF_MIN_MS << shift;
+    if (backoff > REG_BACKOFF_MAX_MS) backoff = REG_BACKOFF_MAX_MS;
+    if (backoff > window) window = (uint32_t)backoff;
+  }
+  schedule(randomMs(window));
+}
+
+bool BraceClient::poll() {
+  if (_state == State::Registered) return false;
+  if (hal::millis() - _sinceMs < _waitMs) return false;
+  
+  if (_state == State::AwaitingAck) {
+    Serial.printf("BRACE: No ACK for attempt %u\n", _attempts);
+    backOff();
+    return false;
+  }
+  
+  if (!registerDevice()) {
+    backOff();
+    return false;
   }
+  if (_attempts < UINT8_MAX) _attempts++;
+  save();
+  _state = State::AwaitingAck;
+  schedule(REG_ACK_TIMEOUT_MS);
+  return true;
 }
 
-bool BraceClient::isRegistered() {
-  return _registered;
+void BraceClient::onAck() {
+  // Only for a commitment this device sent; a late ACK still counts, since
+  // every attempt carries the same commitment
+  if (_state == State::Registered || !_haveCommitment) return;
+  _state = State::Registered;
+  save();
+}
+
+void BraceClient::onRetryAfter(uint32_t seconds) {
+  if (_state == State::Registered) return;
+  _state = State::Pending;
+  schedule(seconds * 1000 + randomMs(REG_RETRY_JITTER_MS));
+  Serial.printf("BRACE: Gateway busy, retrying in %lu s\n", (unsigned long)(_waitMs / 1000));
+}
+
+uint32_t BraceClient::msUntilDue() const {
+  if (_state == State::Registered) return UINT32_MAX;
+  uint32_t elapsed = hal::millis() - _sinceMs;
+  return elapsed >= _waitMs ? 0 : _waitMs - elapsed;
 }
 
 bool BraceClient::registerDevice() {
-  if (!_se || !_lora) return false;
+  if (!_se || !_link) return false;
   
-  // Step 1: Generate random blinding factor
-  if (!generateBlindingFactor()) {
-    Serial.println("BRACE: Failed to generate blinding factor");
-    return false;
+  // Step 1: Generate the blinding factor, once: retries send the same
+  // commitment, so the tree gets one leaf per device
+  if (!_haveBlindingFactor) {
+    if (!generateBlindingFactor()) {
+      Serial.println("BRACE: Failed to generate blinding factor");
+      return false;
+    }
+    _haveBlindingFactor = true;
   }
   
   // Step 2: Compute commitment C = H(domain || pk || r)
-  if (!computeCommitment()) {
-    Serial.println("BRACE: Failed to compute commitment");
-    return false;
+  if (!_haveCommitment) {
+    if (!computeCommitment()) {
+      Serial.println("BRACE: Failed to compute commitment");
+      return false;
+    }
+    _haveCommitment = true;
   }
   
   // Step 3: Send registration request to proof server
@@ -59,7 +132,7 @@ bool BraceClient::registerDevice() {
 }
 
 bool BraceClient::getCommitment(uint8_t* commitment) {
-  if (!_registered || !commitment) return false;
+  if (!_haveCommitment || !commitment) return false;
   memcpy(commitment, _commitment, 32);
   return true;
 }
@@ -67,7 +140,7 @@ bool BraceClient::getCommitment(uint8_t* commitment) {
 bool BraceClient::getMerkleProof(uint8_t proof[][32], uint8_t* proofLen) {
   // In production, this would be received from proof server
   // For now, return empty proof (proof server will provide this)
-  if (!_registered) return false;
+  if (!isRegistered()) return false;
   *proofLen = 0;
   return true;
 }
@@ -129,11 +202,55 @@ bool BraceClient::computeCommitment() {
 
 bool BraceClient::sendRegistrationRequest() {
   // Build registration message
-  // Format: 0x00 (registration type) + commitment (32 bytes)
-  uint8_t message[33];
-  message[0] = 0x00; // Registration message type
+  // Format: 0x00 (registration type) + commitment (32 bytes) + signature
+  // (64 bytes) over the first 33 with the device key, which the proof
+  // server checks before it takes a registration over Wi-Fi
+  uint8_t message[wire::REGISTRATION_SIZE];
+  message[0] = wire::MSG_REGISTRATION;
   memcpy(message + 1, _commitment, 32);
+  if (!_se->sign(message, 33, message + 33)) {
+    return false;
+  }
   
-  // Send via LoRa
-  return _lora->transmit(message, sizeof(message));
+  return _link->transmit(message, sizeof(message));
+}
+
+void BraceClient::schedule(uint32_t waitMs) {
+  _sinceMs = hal::millis();
+  _waitMs = waitMs;
+}
+
+/**
+ * Next attempt at a random time in the upper half of the backoff window,
+ * so unanswered devices drift apart instead of retrying together
+ */
+void BraceClient::backOff() {
+  uint32_t shift = _attempts > 1 ? (_attempts - 1 < 16 ? _attempts - 1 : 16) : 0;
+  uint64_t window = (uint64_t)REG_BACKOFF_MIN_MS << shift;
+  if (window > REG_BACKOFF_MAX_MS) window = REG_BACKOFF_MAX_MS;
+  _state = State::Pending;
+  schedule((uint32_t)(window / 2 + randomMs((uint32_t)(window / 2))));
+  Serial.printf("BRACE: Next registration attempt in %lu s\n", (unsigned long)(_waitMs / 1000));
+}
+
+uint32_t BraceClient::randomMs(uint32_t below) {
+  if (below == 0) return 0;
+  uint8_t bytes[4];
+  uint32_t value = hal::micros();
+  if (_se && _se->random(bytes, sizeof(bytes))) {
+    value = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 |
+            (uint32_t)bytes[3] << 24;
+  }
+  return value % below;
+}
+
+void BraceClient::save() {
+  uint8_t record[RECORD_SIZE];
+  record[0] = RECORD_FORMAT;
+  record[1] = _state == State::Registered ? 1 : 0;
+  record[2] = _attempts;
+  memcpy(record + 3, _blindingFactor, 32);
+  if (!hal::nvs().put(NVS_KEY, record, sizeof(record))) {
+    Serial.println("BRACE: Could not store registration state");
+  }
 }
@@ -0,0 +1,101 @@
+/**
+ * Config Client Implementation
+ *
+ * NVS record "rcfg": applied version (u16 LE), heard version (u16 LE),
+ * result, then every setting as config items. Items rather than a struct
+ * image, so a firmware update that adds settings still reads the record.
+ */
+
+#include "config_client.h"
+#include "release_key.h"
+
+namespace {
+
+const char* const NVS_KEY = "rcfg";
+const size_t RECORD_HEADER_SIZE = 5;
+const size_t RECORD_MAX = RECORD_HEADER_SIZE + rcfg::SETTINGS_ENCODED_MAX;
+
+} // namespace
+
+void ConfigClient::begin(SecureElement* se) {
+  _se = se;
+  _settings = rcfg::defaults();
+  _report = {0, 0, rcfg::Result::None};
+
+  uint8_t record[RECORD_MAX];
+  size_t length = hal::nvs().get(NVS_KEY, record, sizeof(record));
+  if (length < RECORD_HEADER_SIZE) return;
+
+  rcfg::Settings stored = rcfg::defaults();
+  if (rcfg::applyItems(record + RECORD_HEADER_SIZE, length - RECORD_HEADER_SIZE, &stored) !=
+      rcfg::Result::Applied) {
+    Serial.println("⚠ Stored settings not valid for this firmware, using defaults");
+    return;
+  }
+  _settings = stored;
+  _report.applied = (uint16_t)(record[0] | (record[1] << 8));
+  _report.heard = (uint16_t)(record[2] | (record[3] << 8));
+  _report.result = (rcfg::Result)record[4];
+  Serial.printf("✓ Remote settings v%u restored\n", _report.applied);
+}
+
+bool ConfigClient::onConfig(const uint8_t* message, size_t length) {
+  rcfg::Config config;
+  if (!rcfg::parseConfig(message, length, &config)) return false;
+
+  // Repeats of the version already handled change nothing, not even the report
+  if (config.version == _report.heard && _report.result != rcfg::Result::None) return false;
+
+  // Nothing unsigned or old is looked at further, let alone written to flash
+  if (!_se || !_se->verify(RELEASE_PUBLIC_KEY, message, rcfg::HEADER_SIZE + config.itemsLen,
+                           config.signature)) {
+    Serial.printf("✗ Settings v%u: not signed by the release key, ignored\n", config.version);
+    return false;
+  }
+  if (config.version <= _report.applied) {
+    Serial.printf("📨 Settings v%u: not newer than v%u, ignored\n", config.version,
+                  _report.applied);
+    return false;
+  }
+
+  rcfg::Report report = _report;
+  report.heard = config.version;
+  rcfg::Settings updated = _settings;
+  if (!rcfg::addressed(config, _settings.groups)) {
+    report.result = rcfg::Result::NotAddressed;
+  } else {
+    report.result = rcfg::applyItems(config.items, config.itemsLen, &updated);
+  }
+
+  bool applied = report.result == rcfg::Result::Applied;
+  if (applied) report.applied = config.version;
+  if (!persist(applied ? updated : _settings, report)) {
+    if (!applied) return false;
+    // Not applied either: settings must never differ from what a reset restores
+    report.applied = _report.applied;
+    report.result = rcfg::Result::StorageFailed;
+    applied = false;
+  }
+
+  _report = report;
+  Serial.printf("📨 Settings v%u: %s\n", config.version, rcfg::resultName(report.result));
+  if (!applied) return false;
+  _settings = updated;
+  return true;
+}
+
+size_t ConfigClient::appendReport(uint8_t* out) const {
+  if (_report.heard == 0) return 0;
+  return rcfg::encodeReport(_report, out);
+}
+
+bool ConfigClient::persist(const rcfg::Settings& settings, const rcfg::Report& report) {
+  uint8_t record[RECORD_MAX];
+  record[0] = (uint8_t)report.applied;
+  record[1] = (uint8_t)(report.applied >> 8);
+  record[2] = (uint8_t)report.heard;
+  record[3] = (uint8_t)(report.heard >> 8);
+  record[4] = (uint8_t)report.result;
+  size_t length = RECORD_HEADER_SIZE + rcfg::encodeSettings(settings, record + RECORD_HEADER_SIZE);
+  return hal::nvs().put(NVS_KEY, record, length);
+}
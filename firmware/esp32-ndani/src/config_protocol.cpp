@@ -0,0 +1,368 @@
+/**
+ * Remote Configuration Protocol Implementation
+ */
+
+#include "config_protocol.h"
+#include "alert_rules.h"
+#include "config.h"
+#include "edge_analytics.h"
+#include "lora_airtime.h"
+#include "time_sync.h"
+#include "wire_codec.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace rcfg {
+
+namespace {
+
+struct KeySpec {
+  Key key;
+  const char* name;
+  uint8_t width;
+  int32_t min;
+  int32_t max;
+  bool isSigned;
+};
+
+const KeySpec KEYS[] = {
+  {Key::SampleIntervalS, "sample_interval_s", 4, 60, 86400, false},
+  {Key::BatchSize, "batch_size", 1, 1, BATCH_MAX, false},
+  {Key::SpreadingFactor, "spreading_factor", 1, 7, 12, false},
+  {Key::BandwidthKHz, "bandwidth_khz", 2, 125, 500, false},
+  {Key::TxPowerDbm, "tx_power_dbm", 1, 0, 20, false},
+  {Key::SensorMask, "sensor_mask", 1, 1, SENSOR_BME280 | SENSOR_SOIL, false},
+  {Key::DeadbandTemperature, "deadband_temperature", 2, 0, 10000, false},
+  {Key::DeadbandHumidity, "deadband_humidity", 2, 0, 10000, false},
+  {Key::DeadbandSoil, "deadband_soil", 2, 0, 10000, false},
+  {Key::Heartbeat, "heartbeat", 1, 0, 255, false},
+  {Key::Groups, "groups", 2, 0, 0xFFFF, false},
+  {Key::AlertRules, "alert_rules", 1, 0, alert::ALL, false},
+  {Key::AlertTemperatureLow, "alert_temperature_low", 2, -4000, 6000, true},
+  {Key::AlertTemperatureHigh, "alert_temperature_high", 2, -4000, 6000, true},
+  {Key::AlertSoilLow, "alert_soil_low", 2, 0, 10000, false},
+  {Key::AlertCheckS, "alert_check_s", 2, 0, 3600, false},
+  {Key::AlertSpreadingFactor, "alert_spreading_factor", 1, 0, 12, false},
+  {Key::AlertTxPowerDbm, "alert_tx_power_dbm", 1, 0, 20, false},
+};
+
+const KeySpec* findKey(uint8_t key) {
+  for (const KeySpec& spec : KEYS) {
+    if ((uint8_t)spec.key == key) return &spec;
+  }
+  return nullptr;
+}
+
+// Signed values travel as their two's complement, sign-extended to 32 bits
+bool inRange(const KeySpec& spec, uint32_t value) {
+  int64_t v = spec.isSigned ? (int64_t)(int32_t)value : (int64_t)value;
+  if (v < spec.min || v > spec.max) return false;
+  switch (spec.key) {
+    case Key::BandwidthKHz: return value == 125 || value == 250 || value == 500;
+    case Key::AlertCheckS: return value == 0 || value >= 30;
+    case Key::AlertSpreadingFactor: return value == 0 || value >= 7;
+    default: return true;
+  }
+}
+
+void set(Settings* s, Key key, uint32_t v) {
+  switch (key) {
+    case Key::SampleIntervalS: s->sampleIntervalS = v; break;
+    case Key::BatchSize: s->batchSize = (uint8_t)v; break;
+    case Key::SpreadingFactor: s->spreadingFactor = (uint8_t)v; break;
+    case Key::BandwidthKHz: s->bandwidthKHz = (uint16_t)v; break;
+    case Key::TxPowerDbm: s->txPowerDbm = (uint8_t)v; break;
+    case Key::SensorMask: s->sensorMask = (uint8_t)v; break;
+    case Key::DeadbandTemperature: s->deadbandTemperature = (uint16_t)v; break;
+    case Key::DeadbandHumidity: s->deadbandHumidity = (uint16_t)v; break;
+    case Key::DeadbandSoil: s->deadbandSoil = (uint16_t)v; break;
+    case Key::Heartbeat: s->heartbeat = (uint8_t)v; break;
+    case Key::Groups: s->groups = (uint16_t)v; break;
+    case Key::AlertRules: s->alertRules = (uint8_t)v; break;
+    case Key::AlertTemperatureLow: s->alertTemperatureLow = (int16_t)v; break;
+    case Key::AlertTemperatureHigh: s->alertTemperatureHigh = (int16_t)v; break;
+    case Key::AlertSoilLow: s->alertSoilLow = (uint16_t)v; break;
+    case Key::AlertCheckS: s->alertCheckS = (uint16_t)v; break;
+    case Key::AlertSpreadingFactor: s->alertSpreadingFactor = (uint8_t)v; break;
+    case Key::AlertTxPowerDbm: s->alertTxPowerDbm = (uint8_t)v; break;
+  }
+}
+
+uint32_t get(const Settings& s, Key key) {
+  switch (key) {
+    case Key::SampleIntervalS: return s.sampleIntervalS;
+    case Key::BatchSize: return s.batchSize;
+    case Key::SpreadingFactor: return s.spreadingFactor;
+    case Key::BandwidthKHz: return s.bandwidthKHz;
+    case Key::TxPowerDbm: return s.txPowerDbm;
+    case Key::SensorMask: return s.sensorMask;
+    case Key::DeadbandTemperature: return s.deadbandTemperature;
+    case Key::DeadbandHumidity: return s.deadbandHumidity;
+    case Key::DeadbandSoil: return s.deadbandSoil;
+    case Key::Heartbeat: return s.heartbeat;
+    case Key::Groups: return s.groups;
+    case Key::AlertRules: return s.alertRules;
+    case Key::AlertTemperatureLow: return (uint32_t)(int32_t)s.alertTemperatureLow;
+    case Key::AlertTemperatureHigh: return (uint32_t)(int32_t)s.alertTemperatureHigh;
+    case Key::AlertSoilLow: return s.alertSoilLow;
+    case Key::AlertCheckS: return s.alertCheckS;
+    case Key::AlertSpreadingFactor: return s.alertSpreadingFactor;
+    case Key::AlertTxPowerDbm: return s.alertTxPowerDbm;
+  }
+  return 0;
+}
+
+uint32_t getLe(const uint8_t* p, size_t width) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < width; i++) v |= (uint32_t)p[i] << (8 * i);
+  return v;
+}
+
+uint32_t signExtend(uint32_t value, size_t width) {
+  if (width >= 4 || !(value & (1UL << (8 * width - 1)))) return value;
+  return value | ~((1UL << (8 * width)) - 1);
+}
+
+// Time on air of one reading with its reports: a full fragment and the rest
+uint32_t readingAirtimeUs(const Settings& s) {
+  size_t message = wire::DATA_PACKET_SIZE + wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE +
+                   wire::TRAILER_ITEM_HEADER_SIZE + tsync::REPORT_SIZE +
+                   wire::TRAILER_ITEM_HEADER_SIZE + analytics::REPORT_SIZE;
+  size_t last = wire::FRAGMENT_HEADER_SIZE + message - wire::FRAGMENT_CHUNK_MAX;
+  // AT+SEND puts the hex characters on the air
+  return loraTimeOnAirUs(2 * wire::MAX_FRAME_BYTES, s.spreadingFactor, s.bandwidthKHz) +
+         loraTimeOnAirUs(2 * last, s.spreadingFactor, s.bandwidthKHz);
+}
+
+} // namespace
+
+Settings defaults() {
+  Settings s;
+  s.sampleIntervalS = SENSOR_INTERVAL_MS / 1000;
+  s.batchSize = 1;
+  s.spreadingFactor = LORA_SPREADING_FACTOR;
+  s.bandwidthKHz = LORA_BANDWIDTH;
+  s.txPowerDbm = LORA_TX_POWER;
+  s.sensorMask = SENSOR_BME280 | SENSOR_SOIL;
+  s.deadbandTemperature = 0;
+  s.deadbandHumidity = 0;
+  s.deadbandSoil = 0;
+  s.heartbeat = 0;
+  s.groups = 0;
+  s.alertRules = ALERT_RULES;
+  s.alertTemperatureLow = (int16_t)(ALERT_TEMPERATURE_LOW * 100);
+  s.alertTemperatureHigh = (int16_t)(ALERT_TEMPERATURE_HIGH * 100);
+  s.alertSoilLow = (uint16_t)(ALERT_SOIL_LOW * 100);
+  s.alertCheckS = ALERT_CHECK_INTERVAL_S;
+  s.alertSpreadingFactor = 0;
+  s.alertTxPowerDbm = 0;
+  return s;
+}
+
+bool parseConfig(const uint8_t* message, size_t length, Config* config) {
+  if (length < HEADER_SIZE + SIGNATURE_SIZE || message[0] != wire::MSG_CONFIG) return false;
+  if (message[1] > (uint8_t)Selector::Groups) return false;
+  config->selector = (Selector)message[1];
+  config->groups = (uint16_t)getLe(message + 2, 2);
+  config->version = (uint16_t)getLe(message + 4, 2);
+  config->items = message + HEADER_SIZE;
+  config->itemsLen = length - HEADER_SIZE - SIGNATURE_SIZE;
+  config->signature = message + length - SIGNATURE_SIZE;
+  return true;
+}
+
+bool addressed(const Config& config, uint16_t deviceGroups) {
+  return config.selector == Selector::All || (config.groups & deviceGroups) != 0;
+}
+
+Result applyItems(const uint8_t* items, size_t length, Settings* settings) {
+  Settings candidate = *settings;
+  for (size_t pos = 0; pos < length;) {
+    if (length - pos < 2) return Result::Invalid;
+    const KeySpec* spec = findKey(items[pos]);
+    size_t width = items[pos + 1];
+    if (width > length - pos - 2) return Result::Invalid;
+    if (!spec) return Result::Unsupported;
+    if (width != spec->width) return Result::Invalid;
+    uint32_t value = getLe(items + pos + 2, width);
+    if (spec->isSigned) value = signExtend(value, width);
+    if (!inRange(*spec, value)) return Result::Invalid;
+    set(&candidate, spec->key, value);
+    pos += 2 + width;
+  }
+  if (!valid(candidate)) return Result::Invalid;
+  *settings = candidate;
+  return Result::Applied;
+}
+
+bool valid(const Settings& settings) {
+  for (const KeySpec& spec : KEYS) {
+    if (!inRange(spec, get(settings, spec.key))) return false;
+  }
+  if ((settings.alertRules & alert::FROST) && (settings.alertRules & alert::HEAT) &&
+      settings.alertTemperatureLow >= settings.alertTemperatureHigh) {
+    return false;
+  }
+  // The radio may not spend more than the duty cycle on readings
+  uint64_t budgetUs = (uint64_t)settings.sampleIntervalS * 1000000ULL * DUTY_CYCLE_PERMILLE / 1000;
+  return readingAirtimeUs(settings) <= budgetUs;
+}
+
+size_t encodeItem(Key key, uint32_t value, uint8_t* out) {
+  const KeySpec* spec = findKey((uint8_t)key);
+  if (!spec) return 0;
+  out[0] = (uint8_t)key;
+  out[1] = spec->width;
+  for (size_t i = 0; i < spec->width; i++) out[2 + i] = (uint8_t)(value >> (8 * i));
+  return 2 + spec->width;
+}
+
+size_t encodeSettings(const Settings& settings, uint8_t* out) {
+  size_t n = 0;
+  for (const KeySpec& spec : KEYS) n += encodeItem(spec.key, get(settings, spec.key), out + n);
+  return n;
+}
+
+size_t encodeConfig(Selector selector, uint16_t groups, uint16_t version, const uint8_t* items,
+                    size_t itemsLen, uint8_t* out) {
+  static_assert(HEADER_SIZE + ITEMS_MAX + SIGNATURE_SIZE <= wire::MAX_FRAME_BYTES,
+                "a config message is one frame");
+  if (itemsLen > ITEMS_MAX) return 0;
+  out[0] = wire::MSG_CONFIG;
+  out[1] = (uint8_t)selector;
+  out[2] = (uint8_t)groups;
+  out[3] = (uint8_t)(groups >> 8);
+  out[4] = (uint8_t)version;
+  out[5] = (uint8_t)(version >> 8);
+  memcpy(out + HEADER_SIZE, items, itemsLen);
+  return HEADER_SIZE + itemsLen;
+}
+
+bool compileText(const char* text, uint8_t* out, size_t* outLen, char* error, size_t errorSize) {
+  uint8_t items[ITEMS_MAX];
+  size_t itemsLen = 0;
+  long version = -1;
+  long groups = -1;
+  int lineNo = 0;
+
+  for (const char* line = text; *line;) {
+    const char* end = strchr(line, '\n');
+    size_t len = end ? (size_t)(end - line) : strlen(line);
+    lineNo++;
+
+    char buffer[128];
+    if (len >= sizeof(buffer)) {
+      snprintf(error, errorSize, "line %d: too long", lineNo);
+      return false;
+    }
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
+    line += len + (end ? 1 : 0);
+    char* hash = strchr(buffer, '#');
+    if (hash) *hash = '\0';
+
+    char name[40], valueText[40], extra[2];
+    int fields = sscanf(buffer, "%39s %39s %1s", name, valueText, extra);
+    if (fields <= 0) continue;
+    if (fields != 2) {
+      snprintf(error, errorSize, "line %d: expected \"name value\"", lineNo);
+      return false;
+    }
+    char* valueEnd;
+    long long value = strtoll(valueText, &valueEnd, 0);
+    if (*valueEnd != '\0') {
+      snprintf(error, errorSize, "line %d: bad number \"%s\"", lineNo, valueText);
+      return false;
+    }
+
+    if (strcmp(name, "version") == 0) {
+      if (value < 1 || value > 0xFFFF) {
+        snprintf(error, errorSize, "line %d: version must be 1-65535", lineNo);
+        return false;
+      }
+      version = (long)value;
+      continue;
+    }
+    if (strcmp(name, "groups") == 0) {
+      if (value < 1 || value > 0xFFFF) {
+        snprintf(error, errorSize, "line %d: groups must be a nonzero 16-bit mask", lineNo);
+        return false;
+      }
+      groups = (long)value;
+      continue;
+    }
+
+    const KeySpec* spec = nullptr;
+    for (const KeySpec& candidate : KEYS) {
+      if (strcmp(name, candidate.name) == 0) spec = &candidate;
+    }
+    if (!spec) {
+      snprintf(error, errorSize, "line %d: unknown setting \"%s\"", lineNo, name);
+      return false;
+    }
+    if (value < spec->min || value > spec->max || !inRange(*spec, (uint32_t)value)) {
+      snprintf(error, errorSize, "line %d: %s out of range (%ld-%ld)", lineNo, name,
+               (long)spec->min, (long)spec->max);
+      return false;
+    }
+    if (itemsLen + 2 + spec->width > sizeof(items)) {
+      snprintf(error, errorSize, "line %d: too many settings for one frame", lineNo);
+      return false;
+    }
+    itemsLen += encodeItem(spec->key, (uint32_t)value, items + itemsLen);
+  }
+
+  if (version < 0) {
+    snprintf(error, errorSize, "no version line");
+    return false;
+  }
+  *outLen = encodeConfig(groups < 0 ? Selector::All : Selector::Groups,
+                         groups < 0 ? 0 : (uint16_t)groups, (uint16_t)version, items, itemsLen,
+                         out);
+  if (*outLen == 0) {
+    snprintf(error, errorSize, "too many settings for one frame");
+    return false;
+  }
+  return true;
+}
+
+size_t encodeReport(const Report& report, uint8_t* out) {
+  out[0] = wire::TRAILER_CONFIG;
+  out[1] = REPORT_SIZE;
+  out[2] = (uint8_t)report.applied;
+  out[3] = (uint8_t)(report.applied >> 8);
+  out[4] = (uint8_t)report.heard;
+  out[5] = (uint8_t)(report.heard >> 8);
+  out[6] = (uint8_t)report.result;
+  return wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE;
+}
+
+bool findReport(const uint8_t* message, size_t length, Report* report) {
+  const uint8_t* value;
+  size_t valueLen;
+  if (!wire::findTrailerItem(message, length, wire::TRAILER_CONFIG, &value, &valueLen) ||
+      valueLen < REPORT_SIZE) {
+    return false;
+  }
+  report->applied = (uint16_t)getLe(value, 2);
+  report->heard = (uint16_t)getLe(value + 2, 2);
+  report->result = (Result)value[4];
+  return true;
+}
+
+const char* resultName(Result result) {
+  switch (result) {
+    case Result::None: return "none";
+    case Result::Applied: return "applied";
+    case Result::Stale: return "stale";
+    case Result::Invalid: return "invalid";
+    case Result::Unsupported: return "unsupported";
+    case Result::NotAddressed: return "not addressed";
+    case Result::StorageFailed: return "storage failed";
+  }
+  return "unknown";
+}
+
+} // namespace rcfg
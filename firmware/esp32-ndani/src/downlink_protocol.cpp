@@ -0,0 +1,241 @@
+/**
+ * Downlink Protocol Implementation
+ */
+
+#include "downlink_protocol.h"
+#include "lora_airtime.h"
+#include <string.h>
+
+namespace dl {
+
+namespace {
+
+const uint32_t BUDGET_WINDOW_MS = 3600000;
+const uint64_t PERIOD_MIN_MS = 60000;       // Shorter gaps are retries, not the period
+
+// Newer replaces older: only the latest value matters to the device
+bool supersedes(uint8_t type) {
+  return type == wire::MSG_EPOCH || type == wire::MSG_CONFIG || type == wire::MSG_TIME ||
+         type == wire::MSG_OTA_OFFER;
+}
+
+} // namespace
+
+bool canBundle(const uint8_t* message, size_t length) {
+  if (length == 0) return false;
+  uint8_t type = message[0];
+  return type != wire::MSG_FRAGMENT && type != wire::MSG_TIME && type != wire::MSG_BUNDLE &&
+         BUNDLE_HEADER_SIZE + RECORD_HEADER_SIZE + length <= wire::MAX_FRAME_BYTES;
+}
+
+size_t appendToBundle(uint8_t* frame, size_t length, const uint8_t* message, size_t messageLen) {
+  if (length == 0) frame[length++] = wire::MSG_BUNDLE;
+  if (messageLen == 0 || length + RECORD_HEADER_SIZE + messageLen > wire::MAX_FRAME_BYTES) {
+    return 0;
+  }
+  frame[length++] = (uint8_t)messageLen;
+  memcpy(frame + length, message, messageLen);
+  return length + messageLen;
+}
+
+bool nextInBundle(const uint8_t* frame, size_t length, size_t* offset, const uint8_t** message,
+                  size_t* messageLen) {
+  if (length < BUNDLE_HEADER_SIZE || frame[0] != wire::MSG_BUNDLE) return false;
+  size_t at = *offset < BUNDLE_HEADER_SIZE ? BUNDLE_HEADER_SIZE : *offset;
+  if (at + RECORD_HEADER_SIZE > length) return false;
+  size_t n = frame[at];
+  if (n == 0 || at + RECORD_HEADER_SIZE + n > length) return false;
+  *message = frame + at + RECORD_HEADER_SIZE;
+  *messageLen = n;
+  *offset = at + RECORD_HEADER_SIZE + n;
+  return true;
+}
+
+Scheduler::Scheduler(uint8_t spreadingFactor, uint16_t bandwidthKHz, uint32_t dutyPermille)
+    : _spreadingFactor(spreadingFactor),
+      _bandwidthKHz(bandwidthKHz),
+      _limited(dutyPermille > 0),
+      _budget(dutyPermille > 0 ? dutyPermille : 1, BUDGET_WINDOW_MS) {
+  // A burst is over once a full frame could have ended since the last one
+  _quietMs = airtimeUs(wire::MAX_FRAME_BYTES) / 1000 + RX_DELAY_MS;
+}
+
+uint32_t Scheduler::airtimeUs(size_t length) const {
+  // AT+SEND puts the hex text on the air
+  return loraTimeOnAirUs(2 * length, _spreadingFactor, _bandwidthKHz);
+}
+
+void Scheduler::onUplink(uint16_t address, bool reading, uint64_t nowMs) {
+  Device& device = _devices[address];
+  if (device.lastFrameMs == 0 || nowMs >= device.lastFrameMs + _quietMs) {
+    device.frameBurstMs = nowMs;
+  }
+  device.lastFrameMs = nowMs;
+  if (!reading || device.frameBurstMs == device.burstStartMs) return;
+
+  if (device.burstStartMs != 0) {
+    uint64_t periodMs = device.frameBurstMs - device.burstStartMs;
+    if (periodMs < PERIOD_MIN_MS) return;
+    memmove(device.periodsMs + 1, device.periodsMs, (PERIODS - 1) * sizeof(device.periodsMs[0]));
+    device.periodsMs[0] = periodMs;
+    // Cycles the deadband skipped show up as multiples: take the shortest
+    device.periodMs = 0;
+    for (uint64_t p : device.periodsMs) {
+      if (p != 0 && (device.periodMs == 0 || p < device.periodMs)) device.periodMs = p;
+    }
+  }
+  device.burstStartMs = device.frameBurstMs;
+}
+
+bool Scheduler::enqueue(uint16_t address, const uint8_t* message, size_t length,
+                        uint64_t nowMs) {
+  if (address == 0 || length == 0 || length > wire::MAX_FRAME_BYTES) return false;
+  Device& device = _devices[address];
+  expire(device, nowMs);
+
+  if (supersedes(message[0])) {
+    for (Message& queued : device.queue) {
+      if (queued.data[0] != message[0]) continue;
+      queued.length = (uint8_t)length;
+      memcpy(queued.data, message, length);
+      _stats.superseded++;
+      return true;
+    }
+  }
+  if (device.queue.size() >= QUEUE_MAX) {
+    device.queue.pop_front();
+    _pending--;
+    _stats.dropped++;
+  }
+
+  Message queued;
+  queued.queuedMs = nowMs;
+  queued.length = (uint8_t)length;
+  memcpy(queued.data, message, length);
+  device.queue.push_back(queued);
+  _pending++;
+  _stats.queued++;
+  return true;
+}
+
+uint64_t Scheduler::nextBurstMs(const Device& device, uint64_t nowMs) const {
+  if (device.periodMs == 0) return UINT64_MAX;
+  // The first predicted burst that is not over yet
+  uint64_t burstMs = device.burstStartMs + device.periodMs;
+  uint64_t overMs = burstMs + GUARD_MS + _quietMs;
+  if (overMs <= nowMs) burstMs += ((nowMs - overMs) / device.periodMs + 1) * device.periodMs;
+  return burstMs;
+}
+
+bool Scheduler::windowOpen(const Device& device, uint64_t startMs, uint64_t endMs) const {
+  if (device.lastFrameMs == 0 || startMs < device.lastFrameMs + _quietMs) return false;
+  if (device.periodMs == 0) return endMs < device.lastFrameMs + RX_WINDOW_MS;
+  return endMs + GUARD_MS < nextBurstMs(device, startMs);
+}
+
+bool Scheduler::listening(uint16_t address, uint64_t nowMs) const {
+  auto found = _devices.find(address);
+  return found != _devices.end() && windowOpen(found->second, nowMs, nowMs);
+}
+
+bool Scheduler::clearOfBursts(uint16_t address, uint64_t startMs, uint64_t endMs) const {
+  for (const auto& entry : _devices) {
+    const Device& device = entry.second;
+    if (entry.first == address) continue;
+    // A burst under way may have more frames to come
+    if (device.lastFrameMs != 0 && startMs < device.lastFrameMs + _quietMs) return false;
+    if (device.periodMs != 0 && nextBurstMs(device, startMs) < endMs + GUARD_MS) return false;
+  }
+  return true;
+}
+
+size_t Scheduler::predicted() const {
+  size_t count = 0;
+  for (const auto& entry : _devices) {
+    if (entry.second.periodMs != 0) count++;
+  }
+  return count;
+}
+
+void Scheduler::expire(Device& device, uint64_t nowMs) {
+  while (!device.queue.empty() && device.queue.front().queuedMs + EXPIRY_MS < nowMs) {
+    device.queue.pop_front();
+    _pending--;
+    _stats.expired++;
+  }
+}
+
+size_t Scheduler::build(const Device& device, uint8_t* frame, size_t* count) const {
+  const Message& first = device.queue.front();
+  size_t length = 0;
+  *count = 0;
+  for (const Message& queued : device.queue) {
+    if (!canBundle(queued.data, queued.length)) break;
+    size_t n = appendToBundle(frame, length, queued.data, queued.length);
+    if (n == 0) break;
+    length = n;
+    (*count)++;
+  }
+  if (*count < 2) {
+    *count = 1;
+    memcpy(frame, first.data, first.length);
+    return first.length;
+  }
+  return length;
+}
+
+size_t Scheduler::next(uint64_t nowMs, uint16_t* address, uint8_t* frame) {
+  if (_pending == 0 || nowMs < _txUntilMs) return 0;
+
+  // The device whose oldest message has waited longest, if a full frame
+  // would still end inside its window
+  uint64_t fullEndMs = nowMs + airtimeUs(wire::MAX_FRAME_BYTES) / 1000;
+  Device* chosen = nullptr;
+  uint16_t chosenAddress = 0;
+  for (auto& entry : _devices) {
+    Device& device = entry.second;
+    expire(device, nowMs);
+    if (device.queue.empty() || !windowOpen(device, nowMs, fullEndMs)) continue;
+    if (!chosen || device.queue.front().queuedMs < chosen->queue.front().queuedMs) {
+      chosen = &device;
+      chosenAddress = entry.first;
+    }
+  }
+  if (!chosen) return 0;
+
+  size_t count;
+  size_t length = build(*chosen, frame, &count);
+  uint32_t frameUs = airtimeUs(length);
+  if (nowMs - chosen->queue.front().queuedMs < HOLD_MAX_MS &&
+      !clearOfBursts(chosenAddress, nowMs, nowMs + frameUs / 1000 + 1)) {
+    _stats.uplinkWaits++;
+    return 0;
+  }
+  if (_limited && !_budget.allows(frameUs, 0, (uint32_t)nowMs)) {
+    _stats.budgetWaits++;
+    return 0;
+  }
+
+  for (size_t i = 0; i < count; i++) chosen->queue.pop_front();
+  _pending -= count;
+  _stats.frames++;
+  _stats.messages += count;
+  if (count > 1) _stats.bundled += count;
+  onSent(length, nowMs);
+  *address = chosenAddress;
+  return length;
+}
+
+void Scheduler::onSent(size_t length, uint64_t nowMs) {
+  uint32_t frameUs = airtimeUs(length);
+  if (_limited) {
+    _budget.allows(0, 0, (uint32_t)nowMs);   // Refill up to now before charging
+    _budget.charge(frameUs);
+  }
+  // Module turnaround included: the next frame starts after this one's +OK
+  uint64_t startMs = _txUntilMs > nowMs ? _txUntilMs : nowMs;
+  _txUntilMs = startMs + frameUs / 1000 + 1;
+  _stats.airtimeUs += frameUs;
+}
+
+} // namespace dl
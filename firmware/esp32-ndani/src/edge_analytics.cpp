@@ -0,0 +1,196 @@
+/**
+ * Edge Analytics Implementation
+ */
+
+#include "edge_analytics.h"
+#include "config.h"
+#include "wire_codec.h"
+#include <stdio.h>
+
+namespace analytics {
+
+namespace {
+
+const size_t SOIL = 2;
+
+// Magnus coefficients over water (Alduchov and Eskridge)
+const float MAGNUS_A = 17.62f;
+const float MAGNUS_B = 243.12f;
+
+void putU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint32_t saturate(float value, uint32_t limit) {
+  if (!(value > 0)) return 0;
+  return value >= (float)limit ? limit : (uint32_t)lroundf(value);
+}
+
+} // namespace
+
+float dewPoint(float temperature, float humidity) {
+  if (isnan(temperature) || isnan(humidity)) return NAN;
+  // ln(0) has no dew point; a reading of 0 % is the sensor's floor, not dry air
+  float rh = humidity < 1.0f ? 1.0f : humidity > 100.0f ? 100.0f : humidity;
+  float gamma = logf(rh / 100.0f) + MAGNUS_A * temperature / (MAGNUS_B + temperature);
+  return MAGNUS_B * gamma / (MAGNUS_A - gamma);
+}
+
+float vaporPressureDeficit(float temperature, float humidity) {
+  if (isnan(temperature) || isnan(humidity)) return NAN;
+  float rh = humidity < 0.0f ? 0.0f : humidity > 100.0f ? 100.0f : humidity;
+  float saturation = 0.6108f * expf(17.27f * temperature / (temperature + 237.3f));
+  return saturation * (1.0f - rh / 100.0f);
+}
+
+void RunningStats::add(float value, uint16_t window) {
+  _count++;
+  float alpha = 1.0f / (float)(_count < window ? _count : window);
+  float delta = value - _mean;
+  _mean += alpha * delta;
+  _variance = (1.0f - alpha) * (_variance + alpha * delta * delta);
+}
+
+float RunningStats::zScore(float value, float floor) const {
+  float sd = sqrtf(_variance);
+  if (sd < floor) sd = floor;
+  return fabsf(value - _mean) / sd;
+}
+
+uint8_t EdgeAnalytics::update(uint32_t elapsedS, float temperature, float humidity,
+                              float soilMoisture) {
+  uint8_t events = 0;
+
+  // Growing degree days: the hours since the last reading at this temperature
+  if (!isnan(temperature)) {
+    float capped = temperature > ANALYTICS_GDD_CAP ? ANALYTICS_GDD_CAP : temperature;
+    uint32_t stepS = elapsedS < MAX_STEP_S ? elapsedS : MAX_STEP_S;
+    if (capped > ANALYTICS_GDD_BASE) _gdd += (capped - ANALYTICS_GDD_BASE) * stepS / 86400.0f;
+  }
+  _vpd = vaporPressureDeficit(temperature, humidity);
+  _dewPoint = dewPoint(temperature, humidity);
+
+  // Wetting front: smoothed soil moisture rising at the set rate or faster.
+  // One event per front; it ends when the moisture stops rising.
+  bool rising = false;
+  if (!isnan(soilMoisture)) {
+    if (!_haveSoil) {
+      _haveSoil = true;
+      _soil = soilMoisture;
+    } else {
+      float previous = _soil;
+      _soil += ANALYTICS_SOIL_SMOOTHING * (soilMoisture - _soil);
+      float change = _soil - previous;
+      float hours = elapsedS / 3600.0f;
+      if (hours > 0 && change / hours >= ANALYTICS_WETTING_RATE) {
+        rising = true;
+        _rise += change;
+        if (!_wetting && _rise >= ANALYTICS_WETTING_RISE) {
+          _wetting = true;
+          events |= EVENT_WETTING;
+          _wettingEvents++;
+        }
+      } else if (change <= 0) {
+        _rise = 0;
+        _wetting = false;
+      }
+    }
+  }
+
+  // Anomaly score against the statistics before this reading. A wetting
+  // front explains a soil moisture jump, so it does not score.
+  const float values[CHANNELS] = {temperature, humidity, soilMoisture};
+  const float floors[CHANNELS] = {ANALYTICS_SD_FLOOR_TEMPERATURE, ANALYTICS_SD_FLOOR_HUMIDITY,
+                                  ANALYTICS_SD_FLOOR_SOIL};
+  _anomaly = 0;
+  for (size_t c = 0; c < CHANNELS; c++) {
+    if (isnan(values[c])) continue;
+    bool scored = _stats[c].count() >= ANALYTICS_WARMUP && !(c == SOIL && rising);
+    if (scored) {
+      float z = _stats[c].zScore(values[c], floors[c]);
+      if (z > _anomaly) _anomaly = z;
+    }
+    _stats[c].add(values[c], ANALYTICS_WINDOW);
+  }
+  if (_anomaly >= ANALYTICS_ANOMALY_SIGMA) {
+    events |= EVENT_ANOMALY;
+    _anomalyEvents++;
+  }
+
+  _pending |= events;
+  return events;
+}
+
+Report EdgeAnalytics::report() const {
+  Report report;
+  report.gddDeci = (uint16_t)saturate(_gdd * 10.0f, 0xFFFF);
+  report.vpdPa = isnan(_vpd) ? VPD_MISSING : (uint16_t)saturate(_vpd * 1000.0f, VPD_MISSING - 1);
+  if (isnan(_dewPoint)) {
+    report.dewPointCenti = DEW_POINT_MISSING;
+  } else {
+    float centi = roundf(_dewPoint * 100.0f);
+    report.dewPointCenti = centi > INT16_MAX ? INT16_MAX
+                           : centi <= DEW_POINT_MISSING ? DEW_POINT_MISSING + 1 : (int16_t)centi;
+  }
+  report.anomalyDeci = (uint8_t)saturate(_anomaly * 10.0f, 0xFF);
+  report.events = _pending;
+  return report;
+}
+
+size_t encodeTrailer(const Report& report, uint8_t* out) {
+  out[0] = wire::TRAILER_ANALYTICS;
+  out[1] = REPORT_SIZE;
+  encodeReport(report, out + wire::TRAILER_ITEM_HEADER_SIZE);
+  return wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE;
+}
+
+void encodeReport(const Report& report, uint8_t* out) {
+  putU16(out, report.gddDeci);
+  putU16(out + 2, report.vpdPa);
+  putU16(out + 4, (uint16_t)report.dewPointCenti);
+  out[6] = report.anomalyDeci;
+  out[7] = report.events;
+}
+
+Report decodeReport(const uint8_t* value) {
+  Report report;
+  report.gddDeci = getU16(value);
+  report.vpdPa = getU16(value + 2);
+  report.dewPointCenti = (int16_t)getU16(value + 4);
+  report.anomalyDeci = value[6];
+  report.events = value[7] & EVENTS_ALL;
+  return report;
+}
+
+bool findReport(const uint8_t* message, size_t length, Report* report) {
+  const uint8_t* value;
+  size_t valueLen;
+  if (!wire::findTrailerItem(message, length, wire::TRAILER_ANALYTICS, &value, &valueLen) ||
+      valueLen < REPORT_SIZE) {
+    return false;
+  }
+  *report = decodeReport(value);
+  return true;
+}
+
+size_t formatEvents(uint8_t events, char* out, size_t size) {
+  static const struct { uint8_t event; const char* name; } NAMES[] = {
+    {EVENT_WETTING, "wetting"}, {EVENT_ANOMALY, "anomaly"},
+  };
+  size_t n = 0;
+  if (size > 0) out[0] = '\0';
+  for (const auto& entry : NAMES) {
+    if (!(events & entry.event)) continue;
+    int written = snprintf(out + n, size - n, "%s%s", n ? "," : "", entry.name);
+    if (written < 0 || (size_t)written >= size - n) break;
+    n += (size_t)written;
+  }
+  return n;
+}
+
+} // namespace analytics
@@ -0,0 +1,209 @@
+/**
+ * Federated Learning Client Implementation
+ */
+
+#include "fl_client.h"
+#include "config.h"
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+const size_t LAGS = 3;                                    // Hours of context before a sample
+const size_t WINDOW = LAGS + 1 + fl::HORIZON_H;           // Hours a sample spans
+const uint32_t HOUR_S = 3600;
+
+// Offsets into the parameter vector
+const size_t W1 = 0;
+const size_t B1 = fl::HIDDEN * fl::INPUTS;
+const size_t W2 = B1 + fl::HIDDEN;
+const size_t B2 = W2 + fl::HIDDEN;
+
+int8_t fixed(float value, int shift) {
+  float scaled = roundf(ldexpf(value, shift));
+  return scaled > 127.0f ? 127 : scaled < -127.0f ? -127 : (int8_t)scaled;
+}
+
+bool complete(const hist::Summary& summary) {
+  for (size_t c = 0; c < hist::CHANNELS; c++) {
+    if (summary.mean[c] == hist::MISSING) return false;
+  }
+  return true;
+}
+
+size_t gcd(size_t a, size_t b) {
+  while (b) {
+    size_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+} // namespace
+
+bool FlClient::onModel(const uint8_t* frame, size_t length) {
+  uint16_t round;
+  float params[fl::PARAMS];
+  if (!fl::parseModel(frame, length, &round, params)) return false;
+  // A broadcast model is repeated for devices that missed it
+  if (_haveModel && round == _round) return false;
+  memcpy(_global, params, sizeof(_global));
+  _round = round;
+  _haveModel = true;
+  _trainingDue = true;
+  _updateReady = false;
+  return true;
+}
+
+void FlClient::train(HistoryStore& history, uint32_t now) {
+  _trainingDue = false;
+  collect(history, now);
+
+  memcpy(_local, _global, sizeof(_local));
+  _update.round = _round;
+  _update.samples = (uint16_t)_samples;
+  _update.rmseBefore = (uint16_t)fminf(rmse(_global) * 100.0f, 65535.0f);
+
+  // Visit every sample once per epoch, in an order that is not time order
+  if (_samples > 0) {
+    size_t stride = 7919 % _samples;
+    while (stride == 0 || gcd(stride, _samples) != 1) stride++;
+    for (int epoch = 0; epoch < FL_EPOCHS; epoch++) {
+      // Decaying rate, so training ends near the minimum rather than on
+      // whichever sample came last
+      float rate = FL_LEARNING_RATE / (1 + epoch);
+      size_t index = (size_t)epoch % _samples;
+      for (size_t n = 0; n < _samples; n++) {
+        step(_window->features[index], ldexpf(_window->targets[index], -TARGET_SHIFT), rate);
+        index = (index + stride) % _samples;
+      }
+    }
+  }
+  _update.rmseAfter = (uint16_t)fminf(rmse(_local) * 100.0f, 65535.0f);
+  sparsify();
+  _updateReady = true;
+}
+
+/**
+ * Samples from the hourly tier: a sliding window of consecutive complete
+ * hours, restarted at any gap
+ */
+void FlClient::collect(HistoryStore& history, uint32_t now) {
+  _samples = 0;
+  if (!_window || !history.mounted() || now < SAMPLES_MAX * HOUR_S) return;
+
+  hist::Summary window[WINDOW];
+  size_t filled = 0;
+  HistoryStore::Cursor cursor = history.seek(hist::Tier::Hourly, now - SAMPLES_MAX * HOUR_S);
+  hist::Summary summary;
+  while (_samples < SAMPLES_MAX && history.next(&cursor, &summary)) {
+    // The hour still being rolled up is not a full hour yet
+    if (summary.start + HOUR_S > now) break;
+    if (!complete(summary)) {
+      filled = 0;
+      continue;
+    }
+    if (filled > 0 && summary.start != window[filled - 1].start + HOUR_S) filled = 0;
+    if (filled == WINDOW) {
+      memmove(window, window + 1, (WINDOW - 1) * sizeof(window[0]));
+      filled--;
+    }
+    window[filled++] = summary;
+    if (filled < WINDOW) continue;
+
+    // Hundredths to percent and Celsius
+    const hist::Summary& at = window[LAGS];
+    auto soil = [](const hist::Summary& s) { return s.mean[2] / 100.0f; };
+    float hour = (float)(at.start % 86400) / HOUR_S;
+    float x[fl::INPUTS] = {
+      soil(at) / 100.0f,
+      (soil(at) - soil(window[LAGS - 1])) / 10.0f,
+      (soil(at) - soil(window[0])) / 10.0f,
+      at.mean[0] / 100.0f / 40.0f,
+      at.mean[1] / 100.0f / 100.0f,
+      (at.max[0] - at.min[0]) / 100.0f / 20.0f,
+      sinf(2.0f * (float)M_PI * hour / 24.0f),
+      cosf(2.0f * (float)M_PI * hour / 24.0f),
+    };
+    for (size_t i = 0; i < fl::INPUTS; i++) _window->features[_samples][i] = fixed(x[i], FEATURE_SHIFT);
+    _window->targets[_samples] = fixed((soil(window[WINDOW - 1]) - soil(at)) / 10.0f, TARGET_SHIFT);
+    _samples++;
+  }
+}
+
+float FlClient::predict(const float* params, const int8_t* x, float* hidden) const {
+  float y = params[B2];
+  for (size_t j = 0; j < fl::HIDDEN; j++) {
+    const float* w = params + W1 + j * fl::INPUTS;
+    float sum = 0;
+    for (size_t i = 0; i < fl::INPUTS; i++) sum += w[i] * x[i];
+    float h = ldexpf(sum, -FEATURE_SHIFT) + params[B1 + j];
+    hidden[j] = h > 0 ? h : 0;
+    y += params[W2 + j] * hidden[j];
+  }
+  return y;
+}
+
+/**
+ * One SGD step on squared error
+ */
+void FlClient::step(const int8_t* x, float target, float rate) {
+  float hidden[fl::HIDDEN];
+  float error = predict(_local, x, hidden) - target;
+  for (size_t j = 0; j < fl::HIDDEN; j++) {
+    float back = error * _local[W2 + j];
+    _local[W2 + j] -= rate * error * hidden[j];
+    if (hidden[j] <= 0) continue;
+    float* w = _local + W1 + j * fl::INPUTS;
+    for (size_t i = 0; i < fl::INPUTS; i++) w[i] -= rate * back * ldexpf(x[i], -FEATURE_SHIFT);
+    _local[B1 + j] -= rate * back;
+  }
+  _local[B2] -= rate * error;
+}
+
+/**
+ * Forecast error over the samples, in percent soil moisture
+ */
+float FlClient::rmse(const float* params) const {
+  if (_samples == 0) return 0;
+  float hidden[fl::HIDDEN];
+  float sum = 0;
+  for (size_t n = 0; n < _samples; n++) {
+    float error = predict(params, _window->features[n], hidden) - ldexpf(_window->targets[n], -TARGET_SHIFT);
+    sum += error * error;
+  }
+  return sqrtf(sum / _samples) * 10.0f;
+}
+
+/**
+ * The largest changes (with what earlier rounds left unsent) into the
+ * update; the remainder stays for the next one
+ */
+void FlClient::sparsify() {
+  float change[fl::PARAMS];
+  for (size_t i = 0; i < fl::PARAMS; i++) change[i] = _local[i] - _global[i] + _residual[i];
+
+  bool chosen[fl::PARAMS] = {false};
+  size_t count = _samples > 0 ? FL_UPDATE_DELTAS : 0;
+  if (count > fl::UPDATE_DELTAS_MAX) count = fl::UPDATE_DELTAS_MAX;
+  float maxAbs = 0;
+  for (size_t k = 0; k < count; k++) {
+    size_t best = fl::PARAMS;
+    for (size_t i = 0; i < fl::PARAMS; i++) {
+      if (!chosen[i] && (best == fl::PARAMS || fabsf(change[i]) > fabsf(change[best]))) best = i;
+    }
+    chosen[best] = true;
+    _update.deltas[k].index = (uint8_t)best;
+    if (fabsf(change[best]) > maxAbs) maxAbs = fabsf(change[best]);
+  }
+
+  _update.shift = fl::shiftFor(maxAbs);
+  _update.count = (uint8_t)count;
+  for (size_t k = 0; k < count; k++) {
+    size_t i = _update.deltas[k].index;
+    _update.deltas[k].value = fl::quantize(change[i], _update.shift);
+    change[i] -= fl::dequantize(_update.deltas[k].value, _update.shift);
+  }
+  if (count > 0) memcpy(_residual, change, sizeof(_residual));
+}
@@ -0,0 +1,120 @@
+/**
+ * Federated Learning Protocol Implementation
+ */
+
+#include "fl_protocol.h"
+#include <math.h>
+
+namespace fl {
+
+namespace {
+
+const int8_t SHIFT_MIN = -8;
+const int8_t SHIFT_MAX = 15;
+
+void putU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+} // namespace
+
+size_t tensorOffset(size_t tensor) {
+  static const size_t OFFSETS[TENSORS] = {0, HIDDEN * INPUTS, HIDDEN * INPUTS + HIDDEN,
+                                          HIDDEN * INPUTS + 2 * HIDDEN};
+  return OFFSETS[tensor];
+}
+
+size_t tensorSize(size_t tensor) {
+  return (tensor + 1 < TENSORS ? tensorOffset(tensor + 1) : PARAMS) - tensorOffset(tensor);
+}
+
+int8_t shiftFor(float maxAbs) {
+  if (!(maxAbs > 0)) return SHIFT_MAX;
+  int shift = (int)floorf(log2f(127.0f / maxAbs));
+  if (shift < SHIFT_MIN) return SHIFT_MIN;
+  if (shift > SHIFT_MAX) return SHIFT_MAX;
+  return (int8_t)shift;
+}
+
+int8_t quantize(float value, int8_t shift) {
+  float scaled = roundf(ldexpf(value, shift));
+  if (scaled > 127.0f) return 127;
+  if (scaled < -127.0f) return -127;
+  return (int8_t)scaled;
+}
+
+float dequantize(int8_t value, int8_t shift) {
+  return ldexpf((float)value, -shift);
+}
+
+size_t encodeModel(uint16_t round, const float* params, uint8_t* out) {
+  out[0] = wire::MSG_FL_MODEL;
+  putU16(out + 1, round);
+  for (size_t t = 0; t < TENSORS; t++) {
+    float maxAbs = 0;
+    for (size_t i = tensorOffset(t); i < tensorOffset(t) + tensorSize(t); i++) {
+      if (fabsf(params[i]) > maxAbs) maxAbs = fabsf(params[i]);
+    }
+    int8_t shift = shiftFor(maxAbs);
+    out[3 + t] = (uint8_t)shift;
+    for (size_t i = tensorOffset(t); i < tensorOffset(t) + tensorSize(t); i++) {
+      out[MODEL_HEADER_SIZE + i] = (uint8_t)quantize(params[i], shift);
+    }
+  }
+  return MODEL_SIZE;
+}
+
+bool parseModel(const uint8_t* frame, size_t length, uint16_t* round, float* params) {
+  if (length != MODEL_SIZE || frame[0] != wire::MSG_FL_MODEL) return false;
+  *round = getU16(frame + 1);
+  for (size_t t = 0; t < TENSORS; t++) {
+    int8_t shift = (int8_t)frame[3 + t];
+    if (shift < SHIFT_MIN || shift > SHIFT_MAX) return false;
+    for (size_t i = tensorOffset(t); i < tensorOffset(t) + tensorSize(t); i++) {
+      params[i] = dequantize((int8_t)frame[MODEL_HEADER_SIZE + i], shift);
+    }
+  }
+  return true;
+}
+
+size_t encodeUpdate(const Update& update, uint8_t* out) {
+  out[0] = wire::MSG_FL_UPDATE;
+  putU16(out + 1, update.round);
+  putU16(out + 3, update.samples);
+  putU16(out + 5, update.rmseBefore);
+  putU16(out + 7, update.rmseAfter);
+  out[9] = (uint8_t)update.shift;
+  out[10] = update.count;
+  for (size_t i = 0; i < update.count; i++) {
+    out[UPDATE_HEADER_SIZE + 2 * i] = update.deltas[i].index;
+    out[UPDATE_HEADER_SIZE + 2 * i + 1] = (uint8_t)update.deltas[i].value;
+  }
+  return UPDATE_HEADER_SIZE + 2 * update.count;
+}
+
+bool parseUpdate(const uint8_t* frame, size_t length, Update* update) {
+  if (length < UPDATE_HEADER_SIZE || frame[0] != wire::MSG_FL_UPDATE) return false;
+  update->round = getU16(frame + 1);
+  update->samples = getU16(frame + 3);
+  update->rmseBefore = getU16(frame + 5);
+  update->rmseAfter = getU16(frame + 7);
+  update->shift = (int8_t)frame[9];
+  update->count = frame[10];
+  if (update->count > UPDATE_DELTAS_MAX ||
+      length != UPDATE_HEADER_SIZE + 2 * (size_t)update->count) {
+    return false;
+  }
+  for (size_t i = 0; i < update->count; i++) {
+    update->deltas[i].index = frame[UPDATE_HEADER_SIZE + 2 * i];
+    update->deltas[i].value = (int8_t)frame[UPDATE_HEADER_SIZE + 2 * i + 1];
+    if (update->deltas[i].index >= PARAMS) return false;
+  }
+  return true;
+}
+
+} // namespace fl
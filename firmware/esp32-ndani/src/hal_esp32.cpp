@@ -0,0 +1,350 @@
+/**
+ * Hardware Abstraction Layer - ESP32-S3 Implementation
+ *
+ * Forwards the HAL to the Arduino core, HardwareSerial, Wire, the
+ * Adafruit BME280 driver, the ESP-IDF OTA partition API and Preferences
+ * (NVS) and WiFi/HTTPClient. The I2C bus lock is a FreeRTOS recursive
+ * mutex.
+ */
+
+#ifdef ARDUINO
+
+#include "hal.h"
+#include "config.h"
+#include "i2c_bus.h"
+#include "mem_arena.h"
+#include <HardwareSerial.h>
+#include <Wire.h>
+#include <Adafruit_BME280.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_image_format.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+namespace {
+
+// UART2 wired to the RYLR896
+class Esp32Uart : public hal::Uart {
+public:
+  explicit Esp32Uart(int uartNum) : _serial(uartNum) {}
+
+  void begin(uint32_t baud, int rxPin, int txPin) override {
+    _serial.begin(baud, SERIAL_8N1, rxPin, txPin);
+  }
+  int available() override { return _serial.available(); }
+  int read() override { return _serial.read(); }
+  size_t write(const uint8_t* data, size_t length) override {
+    return _serial.write(data, length);
+  }
+
+private:
+  HardwareSerial _serial;
+};
+
+class Bme280Sensor : public hal::EnvSensor {
+public:
+  bool begin(uint8_t address) override {
+    if (!_bme.begin(address)) return false;
+
+    // Configure for weather monitoring
+    _bme.setSampling(
+      Adafruit_BME280::MODE_FORCED,
+      Adafruit_BME280::SAMPLING_X1,  // Temperature
+      Adafruit_BME280::SAMPLING_X1,  // Pressure
+      Adafruit_BME280::SAMPLING_X1,  // Humidity
+      Adafruit_BME280::FILTER_OFF
+    );
+    return true;
+  }
+  void takeForcedMeasurement() override { _bme.takeForcedMeasurement(); }
+  float readTemperature() override { return _bme.readTemperature(); }
+  float readHumidity() override { return _bme.readHumidity(); }
+  float readPressure() override { return _bme.readPressure(); }
+
+private:
+  Adafruit_BME280 _bme;
+};
+
+// ota_0 / ota_1 from the partition table; the bootloader validates the
+// image (and its appended SHA-256) when the boot partition is switched
+class Esp32FirmwareSlots : public hal::FirmwareSlots {
+public:
+  size_t runningSize() override {
+    if (_runningSize == 0) {
+      const esp_partition_t* running = esp_ota_get_running_partition();
+      esp_partition_pos_t position = {running->address, running->size};
+      esp_image_metadata_t metadata;
+      if (esp_image_get_metadata(&position, &metadata) == ESP_OK) {
+        _runningSize = metadata.image_len;
+      }
+    }
+    return _runningSize;
+  }
+  bool readRunning(size_t offset, uint8_t* data, size_t length) override {
+    return esp_partition_read(esp_ota_get_running_partition(), offset, data, length) == ESP_OK;
+  }
+  size_t updateCapacity() override {
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    return update ? update->size : 0;
+  }
+  bool eraseUpdate(size_t offset, size_t length) override {
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    return update && esp_partition_erase_range(update, offset, length) == ESP_OK;
+  }
+  bool writeUpdate(size_t offset, const uint8_t* data, size_t length) override {
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    return update && esp_partition_write(update, offset, data, length) == ESP_OK;
+  }
+  bool readUpdate(size_t offset, uint8_t* data, size_t length) override {
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    return update && esp_partition_read(update, offset, data, length) == ESP_OK;
+  }
+  bool activateUpdate(size_t length) override {
+    (void)length;
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    return update && esp_ota_set_boot_partition(update) == ESP_OK;
+  }
+  void confirmRunning() override { esp_ota_mark_app_valid_cancel_rollback(); }
+
+private:
+  size_t _runningSize = 0;
+};
+
+// The "spiffs" data partition of default_16MB.csv, looked up on first use
+class Esp32DataPartition : public hal::DataPartition {
+public:
+  size_t size() override { return partition() ? _partition->size : 0; }
+  bool erase(size_t offset, size_t length) override {
+    return partition() && esp_partition_erase_range(_partition, offset, length) == ESP_OK;
+  }
+  bool write(size_t offset, const uint8_t* data, size_t length) override {
+    return partition() && esp_partition_write(_partition, offset, data, length) == ESP_OK;
+  }
+  bool read(size_t offset, uint8_t* data, size_t length) override {
+    return partition() && esp_partition_read(_partition, offset, data, length) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t* _partition = nullptr;
+
+  bool partition() {
+    if (!_partition) {
+      _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                            ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    }
+    return _partition != nullptr;
+  }
+};
+
+// One NVS namespace for all firmware records, opened on first use
+class Esp32Nvs : public hal::Nvs {
+public:
+  size_t get(const char* key, void* data, size_t maxLength) override {
+    if (!open()) return 0;
+    size_t length = _prefs.getBytesLength(key);
+    if (length == 0 || length > maxLength) return 0;
+    return _prefs.getBytes(key, data, length);
+  }
+  bool put(const char* key, const void* data, size_t length) override {
+    return open() && _prefs.putBytes(key, data, length) == length;
+  }
+  void remove(const char* key) override {
+    if (open()) _prefs.remove(key);
+  }
+
+private:
+  Preferences _prefs;
+  bool _open = false;
+
+  bool open() {
+    if (!_open) _open = _prefs.begin("msingi", false);
+    return _open;
+  }
+};
+
+Esp32Uart loraSerial(2);
+Bme280Sensor bme;
+Bme280Sensor hubBme[8];        // One driver per mux channel: each keeps its own trim values
+Esp32FirmwareSlots firmware;
+Esp32DataPartition history;
+Esp32Nvs storage;
+I2cBus i2cManager;
+SemaphoreHandle_t i2cMutex = nullptr;
+
+MemArena arena;
+RTC_NOINIT_ATTR uint8_t rtcPool[RTC_ARENA_BYTES];
+size_t rtcUsed = 0;
+
+// The Arduino loop task and the ESP-IDF system tasks beside it
+const char* const TASK_NAMES[] = {"loopTask", "IDLE0", "IDLE1", "Tmr Svc", "ipc0", "ipc1",
+                                  "esp_timer"};
+
+// One HTTP client for every POST: setReuse() keeps its connection open
+WiFiClient httpSocket;
+HTTPClient http;
+
+uint32_t heapCaps(hal::MemRegion region) {
+  return region == hal::MemRegion::Psram ? MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT
+                                         : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+}
+
+} // namespace
+
+namespace hal {
+
+uint32_t millis() { return ::millis(); }
+uint32_t micros() { return ::micros(); }
+void delay(uint32_t ms) { ::delay(ms); }
+uint32_t cycleCount() { return ESP.getCycleCount(); }
+uint32_t cpuFrequencyMhz() { return getCpuFrequencyMhz(); }
+
+Uart& loraUart() { return loraSerial; }
+
+void i2cBegin(int sdaPin, int sclPin, uint32_t clockHz) {
+  if (!i2cMutex) i2cMutex = xSemaphoreCreateRecursiveMutex();
+  Wire.begin(sdaPin, sclPin);
+  Wire.setClock(clockHz);
+}
+
+void i2cSetClock(uint32_t clockHz) { Wire.setClock(clockHz); }
+
+void i2cLock() {
+  if (i2cMutex) xSemaphoreTakeRecursive(i2cMutex, portMAX_DELAY);
+}
+
+bool i2cTryLock() {
+  return !i2cMutex || xSemaphoreTakeRecursive(i2cMutex, 0) == pdTRUE;
+}
+
+void i2cUnlock() {
+  if (i2cMutex) xSemaphoreGiveRecursive(i2cMutex);
+}
+
+I2cBus& i2cBus() { return i2cManager; }
+
+bool i2cRead(uint8_t address, uint8_t reg, uint8_t* data, size_t length) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return false;
+  // One block out of the driver's buffer, no per-byte calls
+  if (Wire.requestFrom((uint16_t)address, length, true) != length) return false;
+  return Wire.readBytes(data, length) == length;
+}
+
+bool i2cWrite(uint8_t address, const uint8_t* data, size_t length) {
+  Wire.beginTransmission(address);
+  Wire.write(data, length);
+  return Wire.endTransmission() == 0;
+}
+
+void pinModeInput(int pin) { ::pinMode(pin, INPUT); }
+void pinModeOutput(int pin) { ::pinMode(pin, OUTPUT); }
+void digitalWrite(int pin, bool high) { ::digitalWrite(pin, high ? HIGH : LOW); }
+int analogRead(int pin) { return ::analogRead(pin); }
+
+EnvSensor& envSensor() { return bme; }
+EnvSensor& hubEnvSensor(uint8_t channel) { return hubBme[channel & 7]; }
+
+FirmwareSlots& firmwareSlots() { return firmware; }
+void restart() { esp_restart(); }
+
+Nvs& nvs() { return storage; }
+
+DataPartition& historyPartition() { return history; }
+
+bool wifiBegin(const char* ssid, const char* password) {
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(ssid, password);
+  http.setReuse(true);
+  return true;
+}
+
+bool wifiConnected() { return WiFi.status() == WL_CONNECTED; }
+
+int httpPost(const char* url, const uint8_t* body, size_t length, uint8_t* response,
+             size_t maxResponse, size_t* responseLength, uint32_t timeoutMs) {
+  *responseLength = 0;
+  if (!http.begin(httpSocket, url)) return -1;
+  http.setConnectTimeout(timeoutMs);
+  http.setTimeout(timeoutMs);
+  http.addHeader("Content-Type", "application/octet-stream");
+  int status = http.POST(const_cast<uint8_t*>(body), length);
+  if (status > 0) {
+    // Binary body: read the stream, not getString()
+    int size = http.getSize();   // -1 when chunked
+    WiFiClient* stream = http.getStreamPtr();
+    uint32_t start = ::millis();
+    size_t n = 0;
+    while (n < maxResponse && (size < 0 || n < (size_t)size) && ::millis() - start < timeoutMs) {
+      size_t ready = stream->available();
+      if (ready == 0) {
+        if (!http.connected()) break;
+        ::delay(1);
+        continue;
+      }
+      n += stream->readBytes(response + n, ready < maxResponse - n ? ready : maxResponse - n);
+    }
+    *responseLength = n;
+  }
+  http.end();   // With setReuse() the connection stays open
+  return status;
+}
+
+Transport* hostLink() { return nullptr; }
+
+void* memAlloc(MemRegion region, size_t bytes) {
+  if (region != MemRegion::Rtc) return heap_caps_calloc(1, bytes, heapCaps(region));
+  // Bump allocation from the pool, word aligned
+  size_t start = (rtcUsed + 3) & ~(size_t)3;
+  if (start + bytes > sizeof(rtcPool)) return nullptr;
+  rtcUsed = start + bytes;
+  memset(rtcPool + start, 0, bytes);
+  return rtcPool + start;
+}
+
+bool heapInfo(MemRegion region, HeapInfo* info) {
+  if (region == MemRegion::Rtc) {
+    info->totalBytes = sizeof(rtcPool);
+    info->freeBytes = sizeof(rtcPool) - rtcUsed;
+    info->largestFreeBlock = info->freeBytes;
+    info->minFreeBytes = info->freeBytes;
+    return true;
+  }
+  // No PSRAM fitted (or not enabled): the capability has no heap
+  info->totalBytes = heap_caps_get_total_size(heapCaps(region));
+  if (info->totalBytes == 0) return false;
+  multi_heap_info_t heap;
+  heap_caps_get_info(&heap, heapCaps(region));
+  info->freeBytes = heap.total_free_bytes;
+  info->largestFreeBlock = heap.largest_free_block;
+  info->minFreeBytes = heap.minimum_free_bytes;
+  return true;
+}
+
+size_t taskStacks(TaskStack* out, size_t max) {
+  size_t count = 0;
+  for (const char* name : TASK_NAMES) {
+    if (count == max) break;
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (!task) continue;
+    out[count].name = name;
+    out[count].sizeBytes = strcmp(name, "loopTask") == 0 ? getArduinoLoopTaskStackSize() : 0;
+    // ESP-IDF counts stack in bytes
+    out[count].minFreeBytes = uxTaskGetStackHighWaterMark(task);
+    count++;
+  }
+  return count;
+}
+
+MemArena& memArena() { return arena; }
+
+} // namespace hal
+
+#endif // ARDUINO
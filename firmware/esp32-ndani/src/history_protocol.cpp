@@ -0,0 +1,171 @@
+/**
+ * History Protocol Implementation
+ */
+
+#include "history_protocol.h"
+#include <math.h>
+
+namespace hist {
+
+namespace {
+
+void putU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+void putU32(uint8_t* out, uint32_t value) {
+  putU16(out, (uint16_t)value);
+  putU16(out + 2, (uint16_t)(value >> 16));
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)getU16(in) | ((uint32_t)getU16(in + 2) << 16);
+}
+
+size_t recordSize(Tier tier) {
+  return tier == Tier::Raw ? RAW_RECORD_SIZE : SUMMARY_RECORD_SIZE;
+}
+
+} // namespace
+
+uint32_t tierSeconds(Tier tier) {
+  switch (tier) {
+    case Tier::Hourly: return 3600;
+    case Tier::Daily: return 86400;
+    default: return 0;
+  }
+}
+
+Tier tierFor(uint32_t resolutionS) {
+  if (resolutionS >= tierSeconds(Tier::Daily)) return Tier::Daily;
+  if (resolutionS >= tierSeconds(Tier::Hourly)) return Tier::Hourly;
+  return Tier::Raw;
+}
+
+const char* tierName(Tier tier) {
+  switch (tier) {
+    case Tier::Hourly: return "hourly";
+    case Tier::Daily: return "daily";
+    default: return "raw";
+  }
+}
+
+int16_t toFixed(float value) {
+  if (isnan(value)) return MISSING;
+  float scaled = roundf(value * 100.0f);
+  if (scaled > INT16_MAX) return INT16_MAX;
+  if (scaled <= MISSING) return MISSING + 1;
+  return (int16_t)scaled;
+}
+
+size_t encodeQuery(const Query& query, uint8_t* out) {
+  out[0] = wire::MSG_HISTORY_QUERY;
+  out[1] = query.id;
+  putU32(out + 2, query.from);
+  putU32(out + 6, query.to);
+  putU32(out + 10, query.resolutionS);
+  return QUERY_SIZE;
+}
+
+bool parseQuery(const uint8_t* frame, size_t length, Query* query) {
+  if (length != QUERY_SIZE || frame[0] != wire::MSG_HISTORY_QUERY) return false;
+  query->id = frame[1];
+  query->from = getU32(frame + 2);
+  query->to = getU32(frame + 6);
+  query->resolutionS = getU32(frame + 10);
+  return query->from < query->to;
+}
+
+ResponseWriter::ResponseWriter(uint8_t* out, uint8_t id, Tier tier, uint8_t index)
+    : _out(out) {
+  out[0] = wire::MSG_HISTORY;
+  out[1] = id;
+  out[2] = (uint8_t)tier;
+  out[3] = index;
+  putU32(out + 4, 0);
+}
+
+bool ResponseWriter::offset(uint32_t time, uint32_t unit, size_t recordSize) {
+  if (_length + recordSize > wire::MAX_FRAME_BYTES) return false;
+  if (_records == 0) {
+    _base = time;
+    putU32(_out + 4, time);
+  }
+  uint32_t delta = (time - _base) / unit;
+  if (time < _base || delta > 0xFFFF) return false;
+  putU16(_out + _length, (uint16_t)delta);
+  return true;
+}
+
+bool ResponseWriter::add(const Sample& sample) {
+  if (!offset(sample.time, 1, RAW_RECORD_SIZE)) return false;
+  uint8_t* record = _out + _length + 2;
+  for (size_t c = 0; c < CHANNELS; c++) putU16(record + 2 * c, (uint16_t)sample.value[c]);
+  _length += RAW_RECORD_SIZE;
+  _records++;
+  return true;
+}
+
+bool ResponseWriter::add(const Summary& summary) {
+  if (!offset(summary.start, tierSeconds((Tier)(_out[2] & TIER_MASK)), SUMMARY_RECORD_SIZE)) {
+    return false;
+  }
+  uint8_t* record = _out + _length + 2;
+  putU16(record, summary.count);
+  for (size_t c = 0; c < CHANNELS; c++) {
+    putU16(record + 2 + 6 * c, (uint16_t)summary.min[c]);
+    putU16(record + 4 + 6 * c, (uint16_t)summary.mean[c]);
+    putU16(record + 6 + 6 * c, (uint16_t)summary.max[c]);
+  }
+  _length += SUMMARY_RECORD_SIZE;
+  _records++;
+  return true;
+}
+
+size_t ResponseWriter::finish(uint8_t flags) {
+  _out[2] = (uint8_t)((_out[2] & TIER_MASK) | flags);
+  return _length;
+}
+
+bool parseResponse(const uint8_t* frame, size_t length, ResponseHeader* header) {
+  if (length < RESPONSE_HEADER_SIZE || frame[0] != wire::MSG_HISTORY) return false;
+  uint8_t tier = frame[2] & TIER_MASK;
+  if (tier >= TIERS) return false;
+  header->id = frame[1];
+  header->tier = (Tier)tier;
+  header->flags = frame[2] & (FLAG_LAST | FLAG_TRUNCATED);
+  header->index = frame[3];
+  header->base = getU32(frame + 4);
+  size_t size = recordSize(header->tier);
+  if ((length - RESPONSE_HEADER_SIZE) % size != 0) return false;
+  header->records = (length - RESPONSE_HEADER_SIZE) / size;
+  return true;
+}
+
+Sample rawRecord(const uint8_t* frame, const ResponseHeader& header, size_t index) {
+  const uint8_t* record = frame + RESPONSE_HEADER_SIZE + index * RAW_RECORD_SIZE;
+  Sample sample;
+  sample.time = header.base + getU16(record);
+  for (size_t c = 0; c < CHANNELS; c++) sample.value[c] = (int16_t)getU16(record + 2 + 2 * c);
+  return sample;
+}
+
+Summary summaryRecord(const uint8_t* frame, const ResponseHeader& header, size_t index) {
+  const uint8_t* record = frame + RESPONSE_HEADER_SIZE + index * SUMMARY_RECORD_SIZE;
+  Summary summary;
+  summary.start = header.base + getU16(record) * tierSeconds(header.tier);
+  summary.count = getU16(record + 2);
+  for (size_t c = 0; c < CHANNELS; c++) {
+    summary.min[c] = (int16_t)getU16(record + 4 + 6 * c);
+    summary.mean[c] = (int16_t)getU16(record + 6 + 6 * c);
+    summary.max[c] = (int16_t)getU16(record + 8 + 6 * c);
+  }
+  return summary;
+}
+
+} // namespace hist
@@ -0,0 +1,382 @@
+/**
+ * History Store Implementation
+ */
+
+#include "history_store.h"
+#include <string.h>
+
+using hist::CHANNELS;
+using hist::Tier;
+
+namespace {
+
+const uint32_t UNWRITTEN = 0xFFFFFFFF;
+const uint32_t HOUR_S = 3600;
+const uint32_t DAY_S = 86400;
+
+void putU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+void putU32(uint8_t* out, uint32_t value) {
+  putU16(out, (uint16_t)value);
+  putU16(out + 2, (uint16_t)(value >> 16));
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)getU16(in) | ((uint32_t)getU16(in + 2) << 16);
+}
+
+bool blank(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Flash records: time first (u32 LE), then the values as in the response
+// frames, i16 LE
+
+void encodeSample(const hist::Sample& sample, uint8_t* out) {
+  putU32(out, sample.time);
+  for (size_t c = 0; c < CHANNELS; c++) putU16(out + 4 + 2 * c, (uint16_t)sample.value[c]);
+}
+
+hist::Sample decodeSample(const uint8_t* in) {
+  hist::Sample sample;
+  sample.time = getU32(in);
+  for (size_t c = 0; c < CHANNELS; c++) sample.value[c] = (int16_t)getU16(in + 4 + 2 * c);
+  return sample;
+}
+
+void encodeSummary(const hist::Summary& summary, uint8_t* out) {
+  putU32(out, summary.start);
+  putU16(out + 4, summary.count);
+  for (size_t c = 0; c < CHANNELS; c++) {
+    putU16(out + 6 + 6 * c, (uint16_t)summary.min[c]);
+    putU16(out + 8 + 6 * c, (uint16_t)summary.mean[c]);
+    putU16(out + 10 + 6 * c, (uint16_t)summary.max[c]);
+  }
+}
+
+hist::Summary decodeSummary(const uint8_t* in) {
+  hist::Summary summary;
+  summary.start = getU32(in);
+  summary.count = getU16(in + 4);
+  for (size_t c = 0; c < CHANNELS; c++) {
+    summary.min[c] = (int16_t)getU16(in + 6 + 6 * c);
+    summary.mean[c] = (int16_t)getU16(in + 8 + 6 * c);
+    summary.max[c] = (int16_t)getU16(in + 10 + 6 * c);
+  }
+  return summary;
+}
+
+} // namespace
+
+// ============= ROLLUP =============
+
+void Rollup::reset(uint32_t start) {
+  *this = Rollup();
+  _start = start;
+}
+
+void Rollup::add(const hist::Sample& sample) {
+  _count++;
+  for (size_t c = 0; c < CHANNELS; c++) {
+    int16_t value = sample.value[c];
+    if (value == hist::MISSING) continue;
+    if (_weight[c] == 0 || value < _min[c]) _min[c] = value;
+    if (_weight[c] == 0 || value > _max[c]) _max[c] = value;
+    _sum[c] += value;
+    _weight[c]++;
+  }
+}
+
+void Rollup::merge(const hist::Summary& summary) {
+  _count += summary.count;
+  for (size_t c = 0; c < CHANNELS; c++) {
+    if (summary.mean[c] == hist::MISSING) continue;
+    if (_weight[c] == 0 || summary.min[c] < _min[c]) _min[c] = summary.min[c];
+    if (_weight[c] == 0 || summary.max[c] > _max[c]) _max[c] = summary.max[c];
+    _sum[c] += (int64_t)summary.mean[c] * summary.count;
+    _weight[c] += summary.count;
+  }
+}
+
+hist::Summary Rollup::summary() const {
+  hist::Summary summary;
+  summary.start = _start;
+  summary.count = (uint16_t)(_count > 0xFFFF ? 0xFFFF : _count);
+  for (size_t c = 0; c < CHANNELS; c++) {
+    if (_weight[c] == 0) {
+      summary.min[c] = summary.mean[c] = summary.max[c] = hist::MISSING;
+      continue;
+    }
+    int64_t half = _sum[c] < 0 ? -(int64_t)(_weight[c] / 2) : _weight[c] / 2;
+    summary.min[c] = _min[c];
+    summary.mean[c] = (int16_t)((_sum[c] + half) / (int64_t)_weight[c]);
+    summary.max[c] = _max[c];
+  }
+  return summary;
+}
+
+// ============= STORE =============
+
+bool HistoryStore::begin(hal::DataPartition& flash) {
+  _flash = &flash;
+  _hour.reset(0);
+  _day.reset(0);
+  _newest = 0;
+
+  // Raw samples get most of the space: a day at a 5-minute rate is 288
+  // of them against 24 hourly summaries and one daily
+  size_t sectors = flash.size() / hal::DataPartition::SECTOR_SIZE;
+  if (sectors < MIN_SECTORS) {
+    _flash = nullptr;
+    return false;
+  }
+  size_t raw = sectors * 3 / 4;
+  size_t hourly = sectors * 3 / 16;
+  mountRing(Tier::Raw, 0, raw, RAW_SIZE);
+  mountRing(Tier::Hourly, raw, hourly, SUMMARY_SIZE);
+  mountRing(Tier::Daily, raw + hourly, sectors - raw - hourly, SUMMARY_SIZE);
+
+  // Newest sample, then the hour and day it belongs to from the records
+  // already written for them
+  const Ring& rawRing = _rings[(int)Tier::Raw];
+  uint8_t record[SUMMARY_SIZE];
+  for (size_t position = total(rawRing); position-- > 0;) {
+    if (!readRecord(rawRing, position, record)) break;
+    uint32_t time = getU32(record);
+    if (time == UNWRITTEN) continue;
+    _newest = time;
+    break;
+  }
+  if (_newest == 0) return true;
+
+  _hour.reset(_newest - _newest % HOUR_S);
+  Cursor cursor = seek(Tier::Raw, _hour.start());
+  while (nextStored(&cursor, record)) _hour.add(decodeSample(record));
+  _day.reset(_newest - _newest % DAY_S);
+  cursor = seek(Tier::Hourly, _day.start());
+  while (nextStored(&cursor, record)) _day.merge(decodeSummary(record));
+  return true;
+}
+
+void HistoryStore::mountRing(Tier tier, size_t first, size_t sectors, size_t recordSize) {
+  Ring& ring = _rings[(int)tier];
+  ring = Ring();
+  ring.tier = tier;
+  ring.first = first;
+  ring.sectors = sectors;
+  ring.recordSize = recordSize;
+  ring.perSector = (hal::DataPartition::SECTOR_SIZE - SECTOR_HEADER_SIZE) / recordSize;
+
+  // Newest sector: the highest sequence number
+  size_t newest = sectors;
+  for (size_t i = 0; i < sectors; i++) {
+    uint32_t sequence;
+    if (readHeader(ring, i, &sequence) && (newest == sectors || sequence > ring.sequence)) {
+      newest = i;
+      ring.sequence = sequence;
+    }
+  }
+  if (newest == sectors) return;
+
+  // Oldest: the first one in use after it. Sectors fill in ring order, so
+  // only the one after the newest can be blank (erased, reset before its
+  // header was written).
+  ring.oldest = newest;
+  for (size_t step = 1; step < sectors; step++) {
+    size_t i = (newest + step) % sectors;
+    uint32_t sequence;
+    if (readHeader(ring, i, &sequence) && sequence < ring.sequence) {
+      ring.oldest = i;
+      break;
+    }
+  }
+  ring.used = (newest + sectors - ring.oldest) % sectors + 1;
+
+  // Records in the newest sector: slots fill in order, so the first
+  // blank one ends them
+  size_t lo = 0;
+  size_t hi = ring.perSector;
+  uint8_t record[SUMMARY_SIZE];
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    size_t offset = sectorOffset(ring, newest) + SECTOR_HEADER_SIZE + mid * recordSize;
+    if (_flash->read(offset, record, recordSize) && blank(record, recordSize)) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  ring.headRecords = lo;
+}
+
+bool HistoryStore::readHeader(const Ring& ring, size_t index, uint32_t* sequence) {
+  uint8_t header[SECTOR_HEADER_SIZE];
+  if (!_flash->read(sectorOffset(ring, index), header, sizeof(header))) return false;
+  if (getU16(header) != MAGIC || header[2] != (uint8_t)ring.tier || header[3] != FORMAT) {
+    return false;
+  }
+  *sequence = getU32(header + 4);
+  return true;
+}
+
+bool HistoryStore::append(const hist::Sample& sample) {
+  if (!_flash || sample.time < _newest) return false;
+
+  uint32_t hour = sample.time - sample.time % HOUR_S;
+  uint32_t day = sample.time - sample.time % DAY_S;
+  if (!_hour.empty() && _hour.start() != hour) {
+    hist::Summary closed = _hour.summary();
+    writeSummary(Tier::Hourly, closed);
+    if (_day.empty()) _day.reset(closed.start - closed.start % DAY_S);
+    _day.merge(closed);
+    _hour.reset(hour);
+  }
+  if (!_day.empty() && _day.start() != day) {
+    writeSummary(Tier::Daily, _day.summary());
+    _day.reset(day);
+  }
+  if (_hour.empty()) _hour.reset(hour);
+  _hour.add(sample);
+  _newest = sample.time;
+
+  uint8_t record[RAW_SIZE];
+  encodeSample(sample, record);
+  return writeRecord(Tier::Raw, record);
+}
+
+bool HistoryStore::writeSummary(Tier tier, const hist::Summary& summary) {
+  uint8_t record[SUMMARY_SIZE];
+  encodeSummary(summary, record);
+  return writeRecord(tier, record);
+}
+
+bool HistoryStore::writeRecord(Tier tier, const uint8_t* record) {
+  Ring& ring = _rings[(int)tier];
+  if ((ring.used == 0 || ring.headRecords == ring.perSector) && !advance(tier)) return false;
+  size_t head = (ring.oldest + ring.used - 1) % ring.sectors;
+  size_t offset = sectorOffset(ring, head) + SECTOR_HEADER_SIZE +
+                  ring.headRecords * ring.recordSize;
+  // The slot is used from here on even if a write fails: bits that were
+  // cleared cannot be written again
+  ring.headRecords++;
+  return _flash->write(offset + 4, record + 4, ring.recordSize - 4) &&
+         _flash->write(offset, record, 4);
+}
+
+bool HistoryStore::advance(Tier tier) {
+  Ring& ring = _rings[(int)tier];
+  size_t next = (ring.oldest + ring.used) % ring.sectors;
+  if (ring.used == ring.sectors) {
+    ring.oldest = (ring.oldest + 1) % ring.sectors;
+    ring.used--;
+  }
+  uint8_t header[SECTOR_HEADER_SIZE];
+  putU16(header, MAGIC);
+  header[2] = (uint8_t)tier;
+  header[3] = FORMAT;
+  putU32(header + 4, ring.sequence + 1);
+  if (!_flash->erase(sectorOffset(ring, next), hal::DataPartition::SECTOR_SIZE) ||
+      !_flash->write(sectorOffset(ring, next), header, sizeof(header))) {
+    return false;
+  }
+  ring.sequence++;
+  ring.used++;
+  ring.headRecords = 0;
+  return true;
+}
+
+bool HistoryStore::readRecord(const Ring& ring, size_t position, uint8_t* record) {
+  size_t index = (ring.oldest + position / ring.perSector) % ring.sectors;
+  size_t offset = sectorOffset(ring, index) + SECTOR_HEADER_SIZE +
+                  (position % ring.perSector) * ring.recordSize;
+  return _flash->read(offset, record, ring.recordSize);
+}
+
+HistoryStore::Cursor HistoryStore::seek(Tier tier, uint32_t from) {
+  uint32_t period = hist::tierSeconds(tier);
+  if (period) from -= from % period;
+  Cursor cursor = {tier, 0, from};
+  if (!_flash) return cursor;
+  const Ring& ring = _rings[(int)tier];
+  size_t count = total(ring);
+
+  // Last sector that starts at or before the time (a torn first record
+  // reads as later than anything)
+  size_t lo = 0;
+  size_t hi = ring.used;
+  uint8_t record[SUMMARY_SIZE];
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (readRecord(ring, mid * ring.perSector, record) && getU32(record) <= from) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  for (cursor.position = lo * ring.perSector; cursor.position < count; cursor.position++) {
+    if (!readRecord(ring, cursor.position, record)) continue;
+    uint32_t time = getU32(record);
+    if (time != UNWRITTEN && time >= from) break;
+  }
+  return cursor;
+}
+
+bool HistoryStore::nextStored(Cursor* cursor, uint8_t* record) {
+  const Ring& ring = _rings[(int)cursor->tier];
+  size_t count = total(ring);
+  while (cursor->position < count) {
+    if (readRecord(ring, cursor->position++, record) && getU32(record) != UNWRITTEN) return true;
+  }
+  return false;
+}
+
+bool HistoryStore::next(Cursor* cursor, hist::Sample* sample) {
+  uint8_t record[RAW_SIZE];
+  if (!_flash || cursor->tier != Tier::Raw || !nextStored(cursor, record)) return false;
+  *sample = decodeSample(record);
+  return true;
+}
+
+bool HistoryStore::next(Cursor* cursor, hist::Summary* summary) {
+  if (!_flash || cursor->tier == Tier::Raw) return false;
+  uint8_t record[SUMMARY_SIZE];
+  if (nextStored(cursor, record)) {
+    *summary = decodeSummary(record);
+    return true;
+  }
+
+  // Past the stored records: the period still being rolled up, once
+  const Ring& ring = _rings[(int)cursor->tier];
+  if (cursor->position != total(ring)) return false;
+  cursor->position++;
+  Rollup open = _hour;
+  if (cursor->tier == Tier::Daily) {
+    open = _day;
+    if (!_hour.empty()) {
+      if (open.empty()) open.reset(_hour.start() - _hour.start() % DAY_S);
+      open.merge(_hour.summary());
+    }
+  }
+  if (open.empty() || open.start() < cursor->from) return false;
+  *summary = open.summary();
+  return true;
+}
+
+size_t HistoryStore::records(Tier tier) const {
+  return total(_rings[(int)tier]);
+}
+
+size_t HistoryStore::capacity(Tier tier) const {
+  const Ring& ring = _rings[(int)tier];
+  return ring.sectors * ring.perSector;
+}
@@ -0,0 +1,99 @@
+/**
+ * I2C Bus Implementation
+ */
+
+#include "i2c_bus.h"
+#include "config.h"
+
+I2cBus::Transaction::Transaction(I2cBus& bus, Device device) : _bus(bus), _device(device) {
+  if (!hal::i2cTryLock()) {
+    uint32_t waitStart = hal::micros();
+    hal::i2cLock();
+    _bus._stats.contended++;
+    _bus._stats.waitUs += hal::micros() - waitStart;
+  }
+  _startUs = hal::micros();
+  _outerHz = _bus._depth > 0 ? _bus._clockHz : 0;
+  _bus._depth++;
+  _bus.setClock(clockHz(device));
+}
+
+I2cBus::Transaction::~Transaction() {
+  uint32_t us = hal::micros() - _startUs;
+  DeviceStats& stats = _bus._devices[_device];
+  stats.transactions++;
+  if (!_ok) stats.failures++;
+  stats.bytes += (uint32_t)_bytes;
+  stats.busyUs += us;
+  if (us > stats.maxUs) stats.maxUs = us;
+
+  if (--_bus._depth == 0) {
+    _bus._stats.busyUs += us;
+  } else {
+    _bus.setClock(_outerHz);
+  }
+  hal::i2cUnlock();
+}
+
+const char* I2cBus::deviceName(Device device) {
+  switch (device) {
+    case DEVICE_ATECC: return "atecc";
+    case DEVICE_BME280: return "bme280";
+    case DEVICE_HUB_MUX: return "hub_mux";
+    case DEVICE_HUB_BME280: return "hub_bme280";
+    default: return "unknown";
+  }
+}
+
+uint32_t I2cBus::clockHz(Device device) {
+  return device == DEVICE_ATECC ? I2C_SPEED : I2C_FAST_SPEED;
+}
+
+void I2cBus::begin(int sdaPin, int sclPin) {
+  _clockHz = clockHz(DEVICE_ATECC);
+  _depth = 0;
+  hal::i2cBegin(sdaPin, sclPin, _clockHz);
+  resetStats();
+}
+
+bool I2cBus::read(Device device, uint8_t address, uint8_t reg, uint8_t* data, size_t length) {
+  Transaction transaction(*this, device);
+  bool ok = hal::i2cRead(address, reg, data, length);
+  if (ok) {
+    transaction.addBytes(length);
+  } else {
+    transaction.fail();
+  }
+  return ok;
+}
+
+bool I2cBus::write(Device device, uint8_t address, const uint8_t* data, size_t length) {
+  Transaction transaction(*this, device);
+  bool ok = hal::i2cWrite(address, data, length);
+  if (ok) {
+    transaction.addBytes(length);
+  } else {
+    transaction.fail();
+  }
+  return ok;
+}
+
+float I2cBus::utilization() const {
+  uint64_t windowUs = (uint64_t)(hal::millis() - _windowStartMs) * 1000;
+  if (windowUs == 0) return 0;
+  float share = (float)((double)_stats.busyUs / windowUs);
+  return share < 1.0f ? share : 1.0f;
+}
+
+void I2cBus::resetStats() {
+  for (size_t i = 0; i < DEVICE_COUNT; i++) _devices[i] = DeviceStats();
+  _stats = BusStats();
+  _windowStartMs = hal::millis();
+}
+
+void I2cBus::setClock(uint32_t hz) {
+  if (hz == _clockHz) return;
+  hal::i2cSetClock(hz);
+  _clockHz = hz;
+  _stats.clockSwitches++;
+}
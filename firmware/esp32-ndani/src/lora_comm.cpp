@@ -6,15 +6,14 @@
 
 #include "lora_comm.h"
 #include "config.h"
-
-// Use UART2 for LoRa
-HardwareSerial LoRaSerial(2);
+#include "lora_airtime.h"
+#include "wire_codec.h"
 
 bool LoRaComm::begin(int rxPin, int txPin) {
-  _serial = &LoRaSerial;
-  _serial->begin(LORA_UART_BAUD, SERIAL_8N1, rxPin, txPin);
+  _serial = &hal::loraUart();
+  _serial->begin(LORA_UART_BAUD, rxPin, txPin);
   
-  delay(100); // Wait for module to initialize
+  hal::delay(100); // Wait for module to initialize
   
   // Clear any pending data
   while (_serial->available()) {
@@ -22,26 +21,27 @@ bool LoRaComm::begin(int rxPin, int txPin) {
   }
   
   // Test communication with AT command
+  return ping();
+}
+
+bool LoRaComm::ping() {
   char response[64];
   if (!sendCommand("AT", response, sizeof(response))) {
     return false;
   }
   
   // Check for "+OK" response
-  if (strstr(response, "+OK") == nullptr) {
-    return false;
-  }
-  
-  return true;
+  return strstr(response, "+OK") != nullptr;
 }
 
-void LoRaComm::configure(uint32_t frequency, uint8_t spreadingFactor, uint16_t bandwidth) {
+void LoRaComm::configure(uint32_t frequency, uint8_t spreadingFactor, uint16_t bandwidth,
+                         uint8_t txPowerDbm) {
   char cmd[64];
   
   // Set frequency (in MHz)
-  snprintf(cmd, sizeof(cmd), "AT+BAND=%lu", frequency);
+  snprintf(cmd, sizeof(cmd), "AT+BAND=%lu", (unsigned long)frequency);
   sendCommand(cmd);
-  delay(100);
+  hal::delay(100);
   
   // Set spreading factor (7-12) and bandwidth
   // RYLR896 uses combined parameter
@@ -53,10 +53,14 @@ void LoRaComm::configure(uint32_t frequency, uint8_t spreadingFactor, uint16_t b
   snprintf(cmd, sizeof(cmd), "AT+PARAMETER=%d,%d,%d,12", 
            spreadingFactor, bwCode, 1); // SF, BW, CR=4/5, Preamble=12
   sendCommand(cmd);
-  delay(100);
+  _spreadingFactor = spreadingFactor;
+  _bandwidth = bandwidth >= 500 ? 500 : bandwidth >= 250 ? 250 : 125;
+  _caps.latencyMs = loraTimeOnAirUs(2 * wire::MAX_FRAME_BYTES, _spreadingFactor, _bandwidth) / 1000;
+  hal::delay(100);
   
-  // Set output power to maximum
-  sendCommand("AT+CRFOP=20");
+  // Set output power
+  snprintf(cmd, sizeof(cmd), "AT+CRFOP=%d", txPowerDbm);
+  sendCommand(cmd);
 }
 
 void LoRaComm::setNetworkId(uint8_t networkId) {
@@ -72,21 +76,32 @@ void LoRaComm::setAddress(uint16_t address) {
 }
 
 bool LoRaComm::transmit(const uint8_t* data, size_t length) {
-  if (length > 240) return false; // RYLR896 max payload
+  if (length <= wire::MAX_FRAME_BYTES) return transmitFrame(data, length);
   
-  // Build hex string from binary data
-  char hexData[512];
-  for (size_t i = 0; i < length; i++) {
-    sprintf(&hexData[i * 2], "%02X", data[i]);
-  }
-  hexData[length * 2] = '\0';
+  // Too long for one AT+SEND (240 hex chars): split into fragments
+  size_t count = wire::fragmentCount(length);
+  if (count == 0) return false;
   
-  // Send to proof server (configured destination address)
-  char cmd[560];
-  snprintf(cmd, sizeof(cmd), "AT+SEND=%d,%zu,%s", PROOF_SERVER_LORA_ADDRESS, length * 2, hexData);
+  uint16_t seq = _txSequence++;
+  uint8_t frame[wire::MAX_FRAME_BYTES];
+  for (size_t i = 0; i < count; i++) {
+    size_t frameLen = wire::buildFragment(data, length, seq, (uint8_t)i, frame);
+    if (!transmitFrame(frame, frameLen)) return false;
+  }
+  return true;
+}
+
+bool LoRaComm::transmitFrame(const uint8_t* data, size_t length) {
+  // Send to proof server (configured destination address), hex-encoded
+  char* cmd = _line;
+  if (wire::formatSend(cmd, sizeof(_line), PROOF_SERVER_LORA_ADDRESS, data, length) == 0) {
+    return false;
+  }
   
+  // The module answers once the frame is on the air: over 8 s at SF12
+  unsigned long timeout = 2000 + loraTimeOnAirUs(2 * length, _spreadingFactor, _bandwidth) / 1000;
   char response[64];
-  if (!sendCommand(cmd, response, sizeof(response))) {
+  if (!sendCommand(cmd, response, sizeof(response), timeout)) {
     return false;
   }
   
@@ -101,11 +116,11 @@ size_t LoRaComm::receive(uint8_t* buffer, size_t maxLen) {
   if (!_serial->available()) return 0;
   
   // Read incoming message
-  char rawResponse[512];
+  char* rawResponse = _line;
   size_t idx = 0;
-  unsigned long timeout = millis() + 1000;
+  unsigned long timeout = hal::millis() + 1000;
   
-  while (millis() < timeout && idx < sizeof(rawResponse) - 1) {
+  while (hal::millis() < timeout && idx < sizeof(_line) - 1) {
     if (_serial->available()) {
       char c = _serial->read();
       rawResponse[idx++] = c;
@@ -115,34 +130,14 @@ size_t LoRaComm::receive(uint8_t* buffer, size_t maxLen) {
   rawResponse[idx] = '\0';
   
   // Parse response: +RCV=<address>,<length>,<data>,<RSSI>,<SNR>
-  if (strncmp(rawResponse, "+RCV=", 5) != 0) return 0;
-  
-  // Extract data from response
-  char* token = strtok(rawResponse + 5, ",");
-  if (!token) return 0; // address
+  wire::RcvFrame frame;
+  if (!wire::parseRcv(rawResponse, idx, &frame)) return 0;
   
-  token = strtok(nullptr, ",");
-  if (!token) return 0;
-  size_t dataLen = atoi(token);
-  
-  token = strtok(nullptr, ",");
-  if (!token) return 0; // hex data
+  _rssi = frame.rssi;
+  _snr = frame.snr;
   
   // Convert hex to binary
-  size_t outLen = 0;
-  for (size_t i = 0; i < dataLen && outLen < maxLen; i += 2) {
-    char hex[3] = { token[i], token[i + 1], '\0' };
-    buffer[outLen++] = (uint8_t)strtol(hex, nullptr, 16);
-  }
-  
-  // Extract RSSI and SNR
-  token = strtok(nullptr, ",");
-  if (token) _rssi = atoi(token);
-  
-  token = strtok(nullptr, ",");
-  if (token) _snr = atoi(token);
-  
-  return outLen;
+  return wire::hexDecode(frame.data, frame.dataLen, buffer, maxLen);
 }
 
 int LoRaComm::getRSSI() {
@@ -153,7 +148,8 @@ int LoRaComm::getSNR() {
   return _snr;
 }
 
-bool LoRaComm::sendCommand(const char* cmd, char* response, size_t maxResponse) {
+bool LoRaComm::sendCommand(const char* cmd, char* response, size_t maxResponse,
+                           unsigned long timeout) {
   // Clear buffer
   while (_serial->available()) _serial->read();
   
@@ -166,14 +162,14 @@ bool LoRaComm::sendCommand(const char* cmd, char* response, size_t maxResponse)
   }
   
   // Wait for response
-  return waitForResponse(response, maxResponse);
+  return waitForResponse(response, maxResponse, timeout);
 }
 
 bool LoRaComm::waitForResponse(char* response, size_t maxLen, unsigned long timeout) {
-  unsigned long start = millis();
+  unsigned long start = hal::millis();
   size_t idx = 0;
   
-  while (millis() - start < timeout) {
+  while (hal::millis() - start < timeout) {
     if (_serial->available()) {
       char c = _serial->read();
       if (response && idx < maxLen - 1) {
@@ -0,0 +1,60 @@
+/**
+ * Memory Arena Implementation
+ */
+
+#include "mem_arena.h"
+
+void* MemArena::alloc(const char* name, size_t bytes, hal::MemRegion region) {
+  for (size_t i = 0; i < _count; i++) {
+    if (strcmp(_blocks[i].name, name) != 0) continue;
+    return _blocks[i].bytes == bytes ? _blocks[i].data : nullptr;
+  }
+  if (_count == BLOCKS_MAX) {
+    Serial.printf("mem: no arena slot for %s\n", name);
+    return nullptr;
+  }
+
+  Block& block = _blocks[_count];
+  block.name = name;
+  block.requested = region;
+  block.region = region;
+  block.bytes = bytes;
+  block.data = hal::memAlloc(region, bytes);
+  if (!block.data && region != hal::MemRegion::Internal) {
+    block.region = hal::MemRegion::Internal;
+    block.data = hal::memAlloc(hal::MemRegion::Internal, bytes);
+    Serial.printf("mem: %s (%u B) in internal RAM, no room in %s\n", name, (unsigned)bytes,
+                  regionName(region));
+  }
+  if (!block.data) {
+    Serial.printf("mem: no room for %s (%u B)\n", name, (unsigned)bytes);
+    return nullptr;
+  }
+  _count++;
+  return block.data;
+}
+
+size_t MemArena::used(hal::MemRegion region) const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < _count; i++) {
+    if (_blocks[i].region == region) bytes += _blocks[i].bytes;
+  }
+  return bytes;
+}
+
+size_t MemArena::fallbacks() const {
+  size_t count = 0;
+  for (size_t i = 0; i < _count; i++) {
+    if (_blocks[i].region != _blocks[i].requested) count++;
+  }
+  return count;
+}
+
+const char* MemArena::regionName(hal::MemRegion region) {
+  switch (region) {
+    case hal::MemRegion::Internal: return "internal";
+    case hal::MemRegion::Psram: return "psram";
+    case hal::MemRegion::Rtc: return "rtc";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * Merkle Tree Implementation
+ */
+
+#include "merkle_tree.h"
+#include "sha256.h"
+#include <string.h>
+
+namespace merkle {
+
+namespace {
+
+struct ZeroHashes {
+  uint8_t value[DEPTH + 1][HASH_SIZE];
+  ZeroHashes() {
+    memset(value[0], 0, HASH_SIZE);
+    for (size_t level = 0; level < DEPTH; level++) {
+      hashNode(value[level], value[level], value[level + 1]);
+    }
+  }
+};
+
+} // namespace
+
+void hashNode(const uint8_t* left, const uint8_t* right, uint8_t* out) {
+  Sha256 sha;
+  sha.update(left, HASH_SIZE);
+  sha.update(right, HASH_SIZE);
+  sha.finish(out);
+}
+
+const uint8_t* zeroHash(size_t level) {
+  static const ZeroHashes zeros;
+  return zeros.value[level < DEPTH ? level : DEPTH];
+}
+
+void rootFromPath(const uint8_t* leaf, uint32_t index, const uint8_t path[][HASH_SIZE],
+                  uint8_t* root) {
+  uint8_t node[HASH_SIZE];
+  memcpy(node, leaf, HASH_SIZE);
+  for (size_t level = 0; level < DEPTH; level++) {
+    if ((index >> level) & 1) {
+      hashNode(path[level], node, node);
+    } else {
+      hashNode(node, path[level], node);
+    }
+  }
+  memcpy(root, node, HASH_SIZE);
+}
+
+bool verifyPath(const uint8_t* leaf, uint32_t index, const uint8_t path[][HASH_SIZE],
+                const uint8_t* root) {
+  if (index >= MAX_LEAVES) return false;
+  uint8_t computed[HASH_SIZE];
+  rootFromPath(leaf, index, path, computed);
+  return memcmp(computed, root, HASH_SIZE) == 0;
+}
+
+uint32_t deltaLevels(uint32_t index, uint32_t fromLeaves, uint32_t toLeaves) {
+  if (index >= fromLeaves) return (1UL << DEPTH) - 1;
+  uint32_t levels = 0;
+  for (size_t level = 0; level < DEPTH; level++) {
+    // The sibling covers [first, first + 2^level): changed if leaves arrived in it
+    uint32_t first = ((index >> level) ^ 1) << level;
+    if (first < toLeaves && first + (1UL << level) > fromLeaves) levels |= 1UL << level;
+  }
+  return levels;
+}
+
+size_t encodeDelta(uint32_t levels, const uint8_t path[][HASH_SIZE], uint8_t* out) {
+  levels &= (1UL << DEPTH) - 1;
+  out[0] = (uint8_t)(levels >> 24);
+  out[1] = (uint8_t)(levels >> 16);
+  out[2] = (uint8_t)(levels >> 8);
+  out[3] = (uint8_t)levels;
+  size_t length = DELTA_HEADER_SIZE;
+  for (size_t level = 0; level < DEPTH; level++) {
+    if (!(levels & (1UL << level))) continue;
+    memcpy(out + length, path[level], HASH_SIZE);
+    length += HASH_SIZE;
+  }
+  return length;
+}
+
+bool applyDelta(const uint8_t* delta, size_t length, uint8_t path[][HASH_SIZE]) {
+  if (length < DELTA_HEADER_SIZE) return false;
+  uint32_t levels = ((uint32_t)delta[0] << 24) | ((uint32_t)delta[1] << 16) |
+                    ((uint32_t)delta[2] << 8) | delta[3];
+  if (levels >> DEPTH) return false;
+  size_t count = 0;
+  for (uint32_t bits = levels; bits; bits &= bits - 1) count++;
+  if (length != DELTA_HEADER_SIZE + count * HASH_SIZE) return false;
+
+  const uint8_t* sibling = delta + DELTA_HEADER_SIZE;
+  for (size_t level = 0; level < DEPTH; level++) {
+    if (!(levels & (1UL << level))) continue;
+    memcpy(path[level], sibling, HASH_SIZE);
+    sibling += HASH_SIZE;
+  }
+  return true;
+}
+
+} // namespace merkle
@@ -0,0 +1,350 @@
+/**
+ * OTA Client Implementation
+ */
+
+#include "ota_client.h"
+#include "config.h"
+#include "release_key.h"
+#include "sha256.h"
+
+namespace {
+
+const char HEADER_MAGIC[8] = {'E', 'C', 'O', 'T', 'A', 'H', 'D', '1'};
+const size_t HEADER_OFFER_AT = 8;
+const size_t HEADER_BITMAP_AT = 128;
+
+size_t sectorAlign(size_t length) {
+  const size_t sector = hal::FirmwareSlots::SECTOR_SIZE;
+  return (length + sector - 1) / sector * sector;
+}
+
+// The running partition as the patch's base image
+class RunningImage : public ota::ImageReader {
+public:
+  explicit RunningImage(hal::FirmwareSlots& slots) : _slots(slots) {}
+  bool read(size_t offset, uint8_t* data, size_t length) override {
+    return _slots.readRunning(offset, data, length);
+  }
+
+private:
+  hal::FirmwareSlots& _slots;
+};
+
+} // namespace
+
+void OtaClient::begin(SecureElement* se, Transport* link) {
+  _se = se;
+  _link = link;
+  _slots = &hal::firmwareSlots();
+  _state = ota::State::Idle;
+  _runningHashed = false;
+
+  // Reaching setup() means this image boots: keep it
+  _slots->confirmRunning();
+
+  if (resume()) {
+    Serial.printf("✓ OTA download resumed: %u/%u chunks\n", _received, _offer.chunkCount);
+  }
+}
+
+void OtaClient::onOffer(const uint8_t* frame, size_t length) {
+  ota::Offer offer;
+  if (!ota::parseOffer(frame, length, &offer)) return;
+
+  if (receiving() && offer.session == _offer.session) {
+    // Gateway re-offering a download in progress: report what is missing
+    sendStatus(ota::State::Receiving, offer.session);
+    return;
+  }
+
+  Serial.printf("📨 OTA offer: %lu byte image, %u chunks\n",
+                (unsigned long)offer.targetLength, offer.chunkCount);
+  const uint8_t* running = runningHash();
+  if (memcmp(offer.targetHash, running, 32) == 0) {
+    sendStatus(ota::State::UpToDate, offer.session);
+    return;
+  }
+  if (memcmp(offer.baseHash, running, ota::HASH_PREFIX_SIZE) != 0) {
+    Serial.println("⚠ OTA offer is for a different base image");
+    sendStatus(ota::State::WrongBase, offer.session);
+    return;
+  }
+  if (!releaseSigned(offer)) {
+    Serial.println("✗ OTA offer signature invalid");
+    sendStatus(ota::State::BadSignature, offer.session);
+    return;
+  }
+
+  // A newer campaign replaces one in progress
+  if (!stage(offer)) {
+    Serial.println("✗ OTA update does not fit the inactive partition");
+    sendStatus(ota::State::Failed, offer.session);
+    return;
+  }
+  sendStatus(ota::State::Receiving, offer.session);
+}
+
+void OtaClient::onChunk(const uint8_t* frame, size_t length) {
+  uint16_t session, index;
+  const uint8_t* data;
+  size_t dataLen;
+  if (!ota::parseChunk(frame, length, &session, &index, &data, &dataLen)) return;
+  if (!receiving() || session != _offer.session || index >= _offer.chunkCount) return;
+
+  size_t expected = index + 1 < _offer.chunkCount
+                        ? ota::CHUNK_DATA_MAX
+                        : _offer.patchLength - (size_t)index * ota::CHUNK_DATA_MAX;
+  if (dataLen != expected || chunkStaged(index)) return;
+
+  // Data first, then its bit: a reset in between only costs a resend
+  uint8_t bits;
+  size_t bitmapAt = _headerOffset + HEADER_BITMAP_AT + index / 8;
+  if (!_slots->writeUpdate(_patchOffset + (size_t)index * ota::CHUNK_DATA_MAX, data, dataLen) ||
+      !_slots->readUpdate(bitmapAt, &bits, 1)) {
+    return;
+  }
+  bits &= (uint8_t)~(1u << (index % 8));
+  if (!_slots->writeUpdate(bitmapAt, &bits, 1)) return;
+
+  _received++;
+  _lastChunkMs = hal::millis();
+  _statusDue = true;
+
+  if (_received == _offer.chunkCount) apply();
+}
+
+void OtaClient::poll() {
+  if (!receiving()) return;
+
+  uint32_t now = hal::millis();
+  uint32_t lastHeard = (int32_t)(_lastChunkMs - _lastStatusMs) > 0 ? _lastChunkMs : _lastStatusMs;
+  if ((_statusDue && now - _lastChunkMs >= OTA_STATUS_QUIET_MS) ||
+      now - lastHeard >= OTA_STATUS_RETRY_MS) {
+    sendStatus(ota::State::Receiving, _offer.session);
+  }
+}
+
+/**
+ * SHA-256 of the running image, computed once per boot
+ */
+const uint8_t* OtaClient::runningHash() {
+  if (!_runningHashed) {
+    Sha256 sha;
+    uint8_t block[512];
+    size_t size = _slots->runningSize();
+    for (size_t offset = 0; offset < size; offset += sizeof(block)) {
+      size_t n = size - offset < sizeof(block) ? size - offset : sizeof(block);
+      if (!_slots->readRunning(offset, block, n)) break;
+      sha.update(block, n);
+    }
+    sha.finish(_runningHash);
+    _runningHashed = true;
+  }
+  return _runningHash;
+}
+
+bool OtaClient::releaseSigned(const ota::Offer& offer) {
+  uint8_t message[ota::RELEASE_SIGNED_SIZE];
+  ota::releaseMessage(offer, message);
+  return _se->verify(RELEASE_PUBLIC_KEY, message, sizeof(message), offer.signature);
+}
+
+/**
+ * Erase the staging area and write a fresh header for the offer
+ */
+bool OtaClient::stage(const ota::Offer& offer) {
+  size_t capacity = _slots->updateCapacity();
+  size_t patchSpan = sectorAlign(offer.patchLength);
+  if (capacity < hal::FirmwareSlots::SECTOR_SIZE + patchSpan ||
+      sectorAlign(offer.targetLength) > capacity - hal::FirmwareSlots::SECTOR_SIZE - patchSpan) {
+    return false;
+  }
+
+  _state = ota::State::Idle;
+  _offer = offer;
+  _headerOffset = capacity - hal::FirmwareSlots::SECTOR_SIZE;
+  _patchOffset = _headerOffset - patchSpan;
+  if (!_slots->eraseUpdate(_patchOffset, patchSpan + hal::FirmwareSlots::SECTOR_SIZE)) {
+    return false;
+  }
+
+  uint8_t header[HEADER_OFFER_AT + ota::OFFER_SIZE];
+  memcpy(header, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+  ota::encodeOffer(offer, header + HEADER_OFFER_AT);
+  if (!_slots->writeUpdate(_headerOffset, header, sizeof(header))) return false;
+
+  _state = ota::State::Receiving;
+  _received = 0;
+  _lastChunkMs = hal::millis();
+  _statusDue = false;
+  return true;
+}
+
+/**
+ * Pick up a download staged before the last reset
+ */
+bool OtaClient::resume() {
+  size_t capacity = _slots->updateCapacity();
+  if (capacity < hal::FirmwareSlots::SECTOR_SIZE) return false;
+
+  uint8_t header[HEADER_OFFER_AT + ota::OFFER_SIZE];
+  _headerOffset = capacity - hal::FirmwareSlots::SECTOR_SIZE;
+  if (!_slots->readUpdate(_headerOffset, header, sizeof(header)) ||
+      memcmp(header, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0 ||
+      !ota::parseOffer(header + HEADER_OFFER_AT, ota::OFFER_SIZE, &_offer)) {
+    return false;
+  }
+  _patchOffset = _headerOffset - sectorAlign(_offer.patchLength);
+
+  // Staged chunks are the cleared bits
+  _received = 0;
+  uint8_t bits[64];
+  size_t bitmapBytes = ((size_t)_offer.chunkCount + 7) / 8;
+  for (size_t at = 0; at < bitmapBytes; at += sizeof(bits)) {
+    size_t n = bitmapBytes - at < sizeof(bits) ? bitmapBytes - at : sizeof(bits);
+    if (!_slots->readUpdate(_headerOffset + HEADER_BITMAP_AT + at, bits, n)) return false;
+    for (size_t i = 0; i < n; i++) {
+      for (int bit = 0; bit < 8; bit++) {
+        size_t index = (at + i) * 8 + bit;
+        if (index < _offer.chunkCount && !(bits[i] & (1 << bit))) _received++;
+      }
+    }
+  }
+
+  _state = ota::State::Receiving;
+  _lastChunkMs = hal::millis();
+  _lastStatusMs = _lastChunkMs;
+  _statusDue = true;
+  if (_received == _offer.chunkCount) apply();
+  return receiving();
+}
+
+bool OtaClient::chunkStaged(uint16_t index) {
+  uint8_t bits;
+  if (!_slots->readUpdate(_headerOffset + HEADER_BITMAP_AT + index / 8, &bits, 1)) return false;
+  return !(bits & (1 << (index % 8)));
+}
+
+/**
+ * Decompress and apply the staged patch into the inactive partition,
+ * check the result and switch to it
+ */
+void OtaClient::apply() {
+  Serial.println("📦 OTA download complete, applying patch...");
+  uint32_t started = hal::millis();
+
+  RunningImage running(*_slots);
+  ota::PatchApplier applier;
+  applier.begin(&running, _slots->runningSize(), _offer.targetLength);
+  _decoder.reset();
+
+  Sha256 sha;
+  size_t written = 0;
+  size_t erased = 0;
+  bool ok = true;
+  uint8_t in[128];
+  uint8_t decoded[256];
+  uint8_t out[256];
+
+  // Image writes run ahead of the erase by at most one sector, and never
+  // reach the staged patch (stage() checked the sizes)
+  auto writeOut = [&](size_t n) {
+    while (ok && written + n > erased) {
+      ok = _slots->eraseUpdate(erased, hal::FirmwareSlots::SECTOR_SIZE);
+      erased += hal::FirmwareSlots::SECTOR_SIZE;
+    }
+    if (ok && n > 0) ok = _slots->writeUpdate(written, out, n);
+    sha.update(out, n);
+    written += n;
+  };
+
+  for (size_t pos = 0; ok && pos < _offer.patchLength;) {
+    size_t n = _offer.patchLength - pos < sizeof(in) ? _offer.patchLength - pos : sizeof(in);
+    if (!_slots->readUpdate(_patchOffset + pos, in, n)) {
+      ok = false;
+      break;
+    }
+    pos += n;
+    for (size_t used = 0; ok && used < n;) {
+      size_t consumed;
+      size_t d = _decoder.decode(in + used, n - used, &consumed, decoded, sizeof(decoded));
+      used += consumed;
+      writeOut(applier.feed(decoded, d, out));
+      ok = ok && !applier.failed();
+    }
+  }
+  // Back-reference still being copied when the input ran out
+  size_t none;
+  for (size_t d; ok && (d = _decoder.decode(in, 0, &none, decoded, sizeof(decoded))) > 0;) {
+    writeOut(applier.feed(decoded, d, out));
+    ok = !applier.failed();
+  }
+
+  uint8_t digest[32];
+  sha.finish(digest);
+  ok = ok && applier.done() && written == _offer.targetLength &&
+       memcmp(digest, _offer.targetHash, 32) == 0 && releaseSigned(_offer);
+
+  uint16_t session = _offer.session;
+  abandon();
+  if (!ok || !_slots->activateUpdate(written)) {
+    Serial.println("✗ OTA image failed verification, discarded");
+    sendStatus(ota::State::Failed, session);
+    return;
+  }
+
+  Serial.printf("✓ OTA image verified (%lu bytes in %lu ms), rebooting\n",
+                (unsigned long)written, (unsigned long)(hal::millis() - started));
+  sendStatus(ota::State::Applied, session);
+  hal::restart();
+}
+
+/**
+ * Forget the staged download
+ */
+void OtaClient::abandon() {
+  _slots->eraseUpdate(_headerOffset, hal::FirmwareSlots::SECTOR_SIZE);
+  _state = ota::State::Idle;
+}
+
+void OtaClient::sendStatus(ota::State state, uint16_t session) {
+  ota::Status status;
+  memset(&status, 0, sizeof(status));
+  status.session = session;
+  status.state = state;
+
+  if (state == ota::State::Receiving) {
+    status.received = _received;
+    // Window starts at the first missing chunk
+    uint8_t bits[ota::STATUS_WINDOW / 8 + 1];
+    size_t bitmapBytes = ((size_t)_offer.chunkCount + 7) / 8;
+    size_t base = 0;
+    for (size_t at = 0; at < bitmapBytes; at++) {
+      if (!_slots->readUpdate(_headerOffset + HEADER_BITMAP_AT + at, bits, 1)) return;
+      if (bits[0] != 0) {
+        base = at * 8;
+        while (!(bits[0] & (1 << (base % 8)))) base++;
+        break;
+      }
+      base = (at + 1) * 8;
+    }
+    status.windowBase = (uint16_t)base;
+
+    size_t first = base / 8;
+    size_t n = bitmapBytes > first ? bitmapBytes - first : 0;
+    if (n > sizeof(bits)) n = sizeof(bits);
+    if (n > 0 && !_slots->readUpdate(_headerOffset + HEADER_BITMAP_AT + first, bits, n)) return;
+    for (size_t k = 0; k < ota::STATUS_WINDOW; k++) {
+      size_t index = base + k;
+      size_t byte = index / 8 - first;
+      bool staged = index >= _offer.chunkCount || (byte < n && !(bits[byte] & (1 << (index % 8))));
+      if (staged) status.bitmap[k / 8] |= (uint8_t)(1 << (k % 8));
+    }
+  }
+
+  uint8_t frame[ota::STATUS_SIZE];
+  ota::encodeStatus(status, frame);
+  _link->transmit(frame, sizeof(frame));
+  _lastStatusMs = hal::millis();
+  _statusDue = false;
+}
@@ -0,0 +1,316 @@
+/**
+ * OTA Protocol Implementation
+ */
+
+#include "ota_protocol.h"
+#include "wire_codec.h"
+#include <string.h>
+
+namespace ota {
+
+namespace {
+
+void putU16(uint8_t* out, uint16_t v) {
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+}
+
+void putU32(uint8_t* out, uint32_t v) {
+  for (int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+uint16_t getU16(const uint8_t* in) {
+  return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 |
+         (uint32_t)in[3] << 24;
+}
+
+} // namespace
+
+// ============= MESSAGES =============
+
+size_t encodeOffer(const Offer& offer, uint8_t* out) {
+  out[0] = wire::MSG_OTA_OFFER;
+  putU16(out + 1, offer.session);
+  putU32(out + 3, offer.targetLength);
+  putU32(out + 7, offer.patchLength);
+  putU16(out + 11, offer.chunkCount);
+  memcpy(out + 13, offer.baseHash, HASH_PREFIX_SIZE);
+  memcpy(out + 21, offer.targetHash, 32);
+  memcpy(out + 53, offer.signature, 64);
+  return OFFER_SIZE;
+}
+
+bool parseOffer(const uint8_t* in, size_t length, Offer* offer) {
+  if (length != OFFER_SIZE || in[0] != wire::MSG_OTA_OFFER) return false;
+  offer->session = getU16(in + 1);
+  offer->targetLength = getU32(in + 3);
+  offer->patchLength = getU32(in + 7);
+  offer->chunkCount = getU16(in + 11);
+  memcpy(offer->baseHash, in + 13, HASH_PREFIX_SIZE);
+  memcpy(offer->targetHash, in + 21, 32);
+  memcpy(offer->signature, in + 53, 64);
+  return offer->chunkCount == chunkCount(offer->patchLength);
+}
+
+size_t releaseMessage(const Offer& offer, uint8_t* out) {
+  putU32(out, offer.targetLength);
+  memcpy(out + 4, offer.baseHash, HASH_PREFIX_SIZE);
+  memcpy(out + 12, offer.targetHash, 32);
+  return RELEASE_SIGNED_SIZE;
+}
+
+size_t chunkCount(size_t patchLength) {
+  size_t count = (patchLength + CHUNK_DATA_MAX - 1) / CHUNK_DATA_MAX;
+  return count <= CHUNK_COUNT_MAX ? count : 0;
+}
+
+size_t encodeChunk(uint16_t session, uint16_t index, const uint8_t* data, size_t length,
+                   uint8_t* out) {
+  out[0] = wire::MSG_OTA_CHUNK;
+  putU16(out + 1, session);
+  putU16(out + 3, index);
+  memcpy(out + CHUNK_HEADER_SIZE, data, length);
+  return CHUNK_HEADER_SIZE + length;
+}
+
+bool parseChunk(const uint8_t* in, size_t length, uint16_t* session, uint16_t* index,
+                const uint8_t** data, size_t* dataLen) {
+  if (length <= CHUNK_HEADER_SIZE || length > CHUNK_HEADER_SIZE + CHUNK_DATA_MAX ||
+      in[0] != wire::MSG_OTA_CHUNK) {
+    return false;
+  }
+  *session = getU16(in + 1);
+  *index = getU16(in + 3);
+  *data = in + CHUNK_HEADER_SIZE;
+  *dataLen = length - CHUNK_HEADER_SIZE;
+  return true;
+}
+
+size_t encodeStatus(const Status& status, uint8_t* out) {
+  out[0] = wire::MSG_OTA_STATUS;
+  putU16(out + 1, status.session);
+  out[3] = (uint8_t)status.state;
+  putU16(out + 4, status.received);
+  putU16(out + 6, status.windowBase);
+  memcpy(out + 8, status.bitmap, sizeof(status.bitmap));
+  return STATUS_SIZE;
+}
+
+bool parseStatus(const uint8_t* in, size_t length, Status* status) {
+  if (length != STATUS_SIZE || in[0] != wire::MSG_OTA_STATUS) return false;
+  if (in[3] > (uint8_t)State::UpToDate) return false;
+  status->session = getU16(in + 1);
+  status->state = (State)in[3];
+  status->received = getU16(in + 4);
+  status->windowBase = getU16(in + 6);
+  memcpy(status->bitmap, in + 8, sizeof(status->bitmap));
+  return true;
+}
+
+bool parseCampaign(const uint8_t* file, size_t length, Offer* offer, const uint8_t** patch) {
+  const size_t header = sizeof(CAMPAIGN_MAGIC) + OFFER_SIZE;
+  if (length <= header || memcmp(file, CAMPAIGN_MAGIC, sizeof(CAMPAIGN_MAGIC)) != 0) {
+    return false;
+  }
+  if (!parseOffer(file + sizeof(CAMPAIGN_MAGIC), OFFER_SIZE, offer)) return false;
+  if (offer->patchLength != length - header) return false;
+  *patch = file + header;
+  return true;
+}
+
+// ============= LZSS =============
+
+void LzssDecoder::reset() {
+  memset(_window, 0, sizeof(_window));
+  _head = 0;
+  _step = Step::Tag;
+  _mask = 0;
+  _bits = 0;
+  _bitCount = 0;
+  _distance = 0;
+  _copyRemaining = 0;
+}
+
+// MSB-first; a field cut off by the end of input resumes on the next call
+bool LzssDecoder::readBits(uint8_t count, const uint8_t*& in, const uint8_t* end,
+                           uint16_t* value) {
+  while (_bitCount < count) {
+    if (_mask == 0) {
+      if (in == end) return false;
+      _byte = *in++;
+      _mask = 0x80;
+    }
+    _bits = (uint16_t)((_bits << 1) | ((_byte & _mask) ? 1 : 0));
+    _mask >>= 1;
+    _bitCount++;
+  }
+  *value = _bits;
+  _bits = 0;
+  _bitCount = 0;
+  return true;
+}
+
+void LzssDecoder::emit(uint8_t value, uint8_t* out, size_t* produced) {
+  _window[_head] = value;
+  _head = (uint16_t)((_head + 1) & ((1 << WINDOW_BITS) - 1));
+  out[(*produced)++] = value;
+}
+
+size_t LzssDecoder::decode(const uint8_t* in, size_t inLen, size_t* consumed, uint8_t* out,
+                           size_t outSize) {
+  const uint8_t* cursor = in;
+  const uint8_t* end = in + inLen;
+  const uint16_t windowMask = (1 << WINDOW_BITS) - 1;
+  size_t produced = 0;
+  uint16_t value;
+
+  while (produced < outSize) {
+    if (_copyRemaining > 0) {
+      emit(_window[(_head - _distance) & windowMask], out, &produced);
+      _copyRemaining--;
+      continue;
+    }
+    if (_step == Step::Tag) {
+      if (!readBits(1, cursor, end, &value)) break;
+      _step = value ? Step::Literal : Step::Index;
+    } else if (_step == Step::Literal) {
+      if (!readBits(8, cursor, end, &value)) break;
+      emit((uint8_t)value, out, &produced);
+      _step = Step::Tag;
+    } else if (_step == Step::Index) {
+      if (!readBits(WINDOW_BITS, cursor, end, &value)) break;
+      _distance = (uint16_t)(value + 1);
+      _step = Step::Count;
+    } else {
+      if (!readBits(LOOKAHEAD_BITS, cursor, end, &value)) break;
+      _copyRemaining = (uint16_t)(value + 1);
+      _step = Step::Tag;
+    }
+  }
+
+  *consumed = (size_t)(cursor - in);
+  return produced;
+}
+
+// ============= DELTA =============
+
+void PatchApplier::begin(ImageReader* base, size_t baseLength, size_t targetLength) {
+  _base = base;
+  _baseLength = baseLength;
+  _targetLength = targetLength;
+  _written = 0;
+  _basePos = 0;
+  _step = Step::Magic;
+  _varint = 0;
+  _varintShift = 0;
+  _diffLen = 0;
+  _extraLen = 0;
+  _seek = 0;
+  _failed = false;
+  _cacheStart = 0;
+  _cacheLen = 0;
+}
+
+bool PatchApplier::baseByte(size_t offset, uint8_t* value) {
+  if (offset >= _baseLength) return false;
+  if (offset < _cacheStart || offset >= _cacheStart + _cacheLen) {
+    _cacheStart = offset;
+    _cacheLen = _baseLength - offset < sizeof(_cache) ? _baseLength - offset : sizeof(_cache);
+    if (!_base->read(_cacheStart, _cache, _cacheLen)) {
+      _cacheLen = 0;
+      return false;
+    }
+  }
+  *value = _cache[offset - _cacheStart];
+  return true;
+}
+
+// Move past exhausted diff/extra runs; at the end of a record apply its seek
+void PatchApplier::endRecordIfEmpty() {
+  if (_step == Step::Diff && _diffLen == 0) _step = Step::Extra;
+  if (_step == Step::Extra && _extraLen == 0) {
+    _basePos += _seek;
+    _seek = 0;
+    _step = Step::DiffLen;
+  }
+}
+
+size_t PatchApplier::feed(const uint8_t* patch, size_t length, uint8_t* out) {
+  size_t produced = 0;
+
+  for (size_t i = 0; i < length && !_failed; i++) {
+    uint8_t byte = patch[i];
+    switch (_step) {
+      case Step::Magic:
+        // _varint counts magic bytes matched
+        if (byte != (uint8_t)PATCH_MAGIC[_varint]) {
+          fail();
+        } else if (++_varint == sizeof(PATCH_MAGIC)) {
+          _varint = 0;
+          _step = Step::DiffLen;
+        }
+        break;
+
+      case Step::DiffLen:
+      case Step::ExtraLen:
+      case Step::Seek: {
+        if (_varintShift > 63) {
+          fail();
+          break;
+        }
+        _varint |= (uint64_t)(byte & 0x7F) << _varintShift;
+        _varintShift += 7;
+        if (byte & 0x80) break;
+
+        uint64_t v = _varint;
+        _varint = 0;
+        _varintShift = 0;
+        if (_step == Step::DiffLen) {
+          _diffLen = (uint32_t)v;
+          _step = Step::ExtraLen;
+        } else if (_step == Step::ExtraLen) {
+          _extraLen = (uint32_t)v;
+          _step = Step::Seek;
+        } else {
+          // Diff and extra bytes come first; the seek applies after them
+          _seek = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+          if (_written + _diffLen + _extraLen > _targetLength) {
+            fail();
+            break;
+          }
+          _step = Step::Diff;
+          endRecordIfEmpty();
+        }
+        break;
+      }
+
+      case Step::Diff: {
+        uint8_t old;
+        if (_basePos < 0 || !baseByte((size_t)_basePos, &old)) {
+          fail();
+          break;
+        }
+        out[produced++] = (uint8_t)(old + byte);
+        _written++;
+        _basePos++;
+        if (--_diffLen == 0) endRecordIfEmpty();
+        break;
+      }
+
+      case Step::Extra:
+        out[produced++] = byte;
+        _written++;
+        _extraLen--;
+        endRecordIfEmpty();
+        break;
+    }
+  }
+
+  return _failed ? 0 : produced;
+}
+
+} // namespace ota
@@ -0,0 +1,196 @@
+/**
+ * Probe Hub Implementation
+ *
+ * NVS record "probe_hub": format (1), soil probes, BME280 channel mask,
+ * then air and water (u16 LE) per soil probe and temperature and humidity
+ * offsets (i16 LE) per mux channel.
+ */
+
+#include "probe_hub.h"
+#include "config.h"
+#include "i2c_bus.h"
+#include <math.h>
+
+namespace {
+
+const char* const NVS_KEY = "probe_hub";
+const uint8_t RECORD_FORMAT = 1;
+const size_t RECORD_SIZE = 3 + ProbeHub::SOIL_MAX * 4 + ProbeHub::ENV_MAX * 4;
+
+const int SOIL_MUX_PIN = HUB_SOIL_MUX_PIN;
+const int SOIL_SELECT_PINS[] = HUB_SOIL_SELECT_PINS;
+const int SOIL_PINS[] = HUB_SOIL_PINS;
+const size_t SOIL_SELECT_COUNT = sizeof(SOIL_SELECT_PINS) / sizeof(SOIL_SELECT_PINS[0]);
+const size_t SOIL_PIN_COUNT = sizeof(SOIL_PINS) / sizeof(SOIL_PINS[0]);
+
+size_t soilCapacity() {
+  size_t capacity = SOIL_MUX_PIN >= 0 ? ((size_t)1 << SOIL_SELECT_COUNT) : SOIL_PIN_COUNT;
+  return capacity < ProbeHub::SOIL_MAX ? capacity : ProbeHub::SOIL_MAX;
+}
+
+size_t bits(uint8_t mask) {
+  size_t n = 0;
+  for (; mask; mask &= (uint8_t)(mask - 1)) n++;
+  return n;
+}
+
+void putU16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+} // namespace
+
+ProbeHub::Layout ProbeHub::defaultLayout() {
+  Layout layout = {};
+  layout.soilProbes = HUB_SOIL_PROBES;
+  layout.envMask = HUB_ENV_MASK;
+  for (size_t i = 0; i < SOIL_MAX; i++) {
+    layout.soilAir[i] = SOIL_SENSOR_AIR_VALUE;
+    layout.soilWater[i] = SOIL_SENSOR_WATER_VALUE;
+  }
+  return layout;
+}
+
+bool ProbeHub::valid(const Layout& layout) {
+  if (layout.soilProbes > soilCapacity()) return false;
+  if (layout.soilProbes + 2 * bits(layout.envMask) > probe::CHANNELS_MAX) return false;
+  for (size_t i = 0; i < layout.soilProbes; i++) {
+    if (layout.soilAir[i] == layout.soilWater[i]) return false;
+  }
+  return true;
+}
+
+bool ProbeHub::begin() {
+  _layout = defaultLayout();
+  _envReady = 0;
+
+  uint8_t record[RECORD_SIZE];
+  if (hal::nvs().get(NVS_KEY, record, sizeof(record)) == RECORD_SIZE &&
+      record[0] == RECORD_FORMAT) {
+    Layout stored = {};
+    stored.soilProbes = record[1];
+    stored.envMask = record[2];
+    const uint8_t* p = record + 3;
+    for (size_t i = 0; i < SOIL_MAX; i++, p += 4) {
+      stored.soilAir[i] = getU16(p);
+      stored.soilWater[i] = getU16(p + 2);
+    }
+    for (size_t i = 0; i < ENV_MAX; i++, p += 4) {
+      stored.temperatureOffset[i] = (int16_t)getU16(p);
+      stored.humidityOffset[i] = (int16_t)getU16(p + 2);
+    }
+    if (valid(stored)) {
+      _layout = stored;
+    } else {
+      Serial.println("⚠ Stored probe layout not valid for this board, using defaults");
+    }
+  }
+  if (!active()) return true;
+
+  if (SOIL_MUX_PIN >= 0) {
+    hal::pinModeInput(SOIL_MUX_PIN);
+    for (size_t i = 0; i < SOIL_SELECT_COUNT; i++) hal::pinModeOutput(SOIL_SELECT_PINS[i]);
+  } else {
+    for (size_t i = 0; i < _layout.soilProbes; i++) hal::pinModeInput(SOIL_PINS[i]);
+  }
+
+  for (uint8_t ch = 0; ch < ENV_MAX; ch++) {
+    if (!(_layout.envMask & (1 << ch))) continue;
+    // Select and use the channel in one transaction, so no other task
+    // switches the mux in between
+    I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_HUB_BME280);
+    if (selectEnv(ch) && hal::hubEnvSensor(ch).begin(HUB_ENV_ADDR)) {
+      _envReady |= (uint8_t)(1 << ch);
+    } else {
+      bus.fail();
+      Serial.printf("⚠ Hub BME280 on mux channel %u not found\n", ch);
+    }
+  }
+  deselectEnv();
+
+  Serial.printf("✓ Sensor hub: %u soil probes, %u of %u BME280s\n", _layout.soilProbes,
+                (unsigned)bits(_envReady), (unsigned)bits(_layout.envMask));
+  return _envReady == _layout.envMask;
+}
+
+bool ProbeHub::setLayout(const Layout& layout) {
+  if (!valid(layout)) return false;
+  uint8_t record[RECORD_SIZE];
+  record[0] = RECORD_FORMAT;
+  record[1] = layout.soilProbes;
+  record[2] = layout.envMask;
+  uint8_t* p = record + 3;
+  for (size_t i = 0; i < SOIL_MAX; i++, p += 4) {
+    putU16(p, layout.soilAir[i]);
+    putU16(p + 2, layout.soilWater[i]);
+  }
+  for (size_t i = 0; i < ENV_MAX; i++, p += 4) {
+    putU16(p, (uint16_t)layout.temperatureOffset[i]);
+    putU16(p + 2, (uint16_t)layout.humidityOffset[i]);
+  }
+  if (!hal::nvs().put(NVS_KEY, record, sizeof(record))) return false;
+  // Bring up probes that were added
+  begin();
+  return true;
+}
+
+int ProbeHub::readSoilRaw(uint8_t probe) {
+  if (SOIL_MUX_PIN < 0) return hal::analogRead(SOIL_PINS[probe - 1]);
+  for (size_t i = 0; i < SOIL_SELECT_COUNT; i++) {
+    hal::digitalWrite(SOIL_SELECT_PINS[i], ((probe - 1) >> i) & 1);
+  }
+  hal::delay(HUB_SETTLE_MS);
+  return hal::analogRead(SOIL_MUX_PIN);
+}
+
+void ProbeHub::read(probe::Reading* reading) {
+  reading->count = 0;
+  for (uint8_t n = 1; n <= _layout.soilProbes; n++) {
+    // Same mapping as Sensors::calibrateSoilReading(), with this probe's ends
+    float air = _layout.soilAir[n - 1];
+    float water = _layout.soilWater[n - 1];
+    float moisture = (air - (float)readSoilRaw(n)) * 100.0f / (air - water);
+    if (moisture < 0) moisture = 0;
+    if (moisture > 100) moisture = 100;
+    reading->channels[reading->count++] = {probe::KIND_SOIL, n, moisture};
+  }
+
+  for (uint8_t ch = 0; ch < ENV_MAX; ch++) {
+    if (!(_layout.envMask & (1 << ch))) continue;
+    float temperature = NAN;
+    float humidity = NAN;
+    I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_HUB_BME280);
+    if ((_envReady & (1 << ch)) && selectEnv(ch)) {
+      hal::EnvSensor& bme = hal::hubEnvSensor(ch);
+      bme.takeForcedMeasurement();
+      temperature = bme.readTemperature() + _layout.temperatureOffset[ch] / 100.0f;
+      humidity = bme.readHumidity() + _layout.humidityOffset[ch] / 100.0f;
+      if (!(temperature >= TEMP_MIN && temperature <= TEMP_MAX)) temperature = NAN;
+      if (!(humidity >= HUMIDITY_MIN && humidity <= HUMIDITY_MAX)) humidity = NAN;
+    }
+    reading->channels[reading->count++] = {probe::KIND_TEMPERATURE, ch, temperature};
+    reading->channels[reading->count++] = {probe::KIND_HUMIDITY, ch, humidity};
+  }
+  if (_layout.envMask) deselectEnv();
+}
+
+/**
+ * Connect one mux channel to the bus. The board BME280 and the ATECC608B
+ * stay on the main bus; hub BME280s all answer at HUB_ENV_ADDR (0x77, so
+ * they never clash with the board's at 0x76) and only while their
+ * channel is selected.
+ */
+bool ProbeHub::selectEnv(uint8_t channel) {
+  uint8_t control = (uint8_t)(1 << channel);
+  return hal::i2cBus().write(I2cBus::DEVICE_HUB_MUX, HUB_I2C_MUX_ADDR, &control, 1);
+}
+
+void ProbeHub::deselectEnv() {
+  uint8_t control = 0;
+  hal::i2cBus().write(I2cBus::DEVICE_HUB_MUX, HUB_I2C_MUX_ADDR, &control, 1);
+}
@@ -0,0 +1,87 @@
+/**
+ * Probe Protocol Implementation
+ */
+
+#include "probe_protocol.h"
+#include <math.h>
+#include <string.h>
+
+namespace probe {
+
+namespace {
+
+const int16_t MISSING = INT16_MIN;
+
+// The item, if it is the first one after the DataPacket
+bool locateItem(const uint8_t* message, size_t length, const uint8_t** item, size_t* itemLen) {
+  size_t pos = wire::DATA_PACKET_SIZE;
+  if (length < pos + wire::TRAILER_ITEM_HEADER_SIZE || message[pos] != wire::TRAILER_PROBES) {
+    return false;
+  }
+  size_t valueLen = message[pos + 1];
+  if (valueLen > CHANNELS_MAX * CHANNEL_SIZE || valueLen % CHANNEL_SIZE != 0 ||
+      valueLen > length - pos - wire::TRAILER_ITEM_HEADER_SIZE) {
+    return false;
+  }
+  *item = message + pos;
+  *itemLen = wire::TRAILER_ITEM_HEADER_SIZE + valueLen;
+  return true;
+}
+
+} // namespace
+
+size_t encodeTrailer(const Reading& reading, uint8_t* out) {
+  size_t count = reading.count < CHANNELS_MAX ? reading.count : CHANNELS_MAX;
+  if (count == 0) return 0;
+  out[0] = wire::TRAILER_PROBES;
+  out[1] = (uint8_t)(count * CHANNEL_SIZE);
+  uint8_t* p = out + wire::TRAILER_ITEM_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++, p += CHANNEL_SIZE) {
+    const Channel& c = reading.channels[i];
+    float scaled = roundf(c.value * 100.0f);
+    int16_t value = isnan(scaled) ? MISSING
+                    : scaled > 32767.0f ? 32767
+                    : scaled < -32767.0f ? -32767
+                    : (int16_t)scaled;
+    p[0] = (uint8_t)(c.kind << 4 | (c.index & 0x0F));
+    p[1] = (uint8_t)value;
+    p[2] = (uint8_t)((uint16_t)value >> 8);
+  }
+  return wire::TRAILER_ITEM_HEADER_SIZE + count * CHANNEL_SIZE;
+}
+
+bool findReading(const uint8_t* message, size_t length, Reading* reading) {
+  const uint8_t* item;
+  size_t itemLen;
+  if (!locateItem(message, length, &item, &itemLen)) return false;
+  reading->count = (uint8_t)((itemLen - wire::TRAILER_ITEM_HEADER_SIZE) / CHANNEL_SIZE);
+  const uint8_t* p = item + wire::TRAILER_ITEM_HEADER_SIZE;
+  for (size_t i = 0; i < reading->count; i++, p += CHANNEL_SIZE) {
+    Channel& c = reading->channels[i];
+    int16_t value = (int16_t)(p[1] | (p[2] << 8));
+    c.kind = p[0] >> 4;
+    c.index = p[0] & 0x0F;
+    c.value = value == MISSING ? NAN : value / 100.0f;
+  }
+  return true;
+}
+
+size_t signedMessage(const uint8_t* message, size_t length, uint8_t* out) {
+  memcpy(out, message, wire::DATA_PACKET_SIGNED_SIZE);
+  const uint8_t* item;
+  size_t itemLen;
+  if (!locateItem(message, length, &item, &itemLen)) return wire::DATA_PACKET_SIGNED_SIZE;
+  memcpy(out + wire::DATA_PACKET_SIGNED_SIZE, item, itemLen);
+  return wire::DATA_PACKET_SIGNED_SIZE + itemLen;
+}
+
+const char* kindName(uint8_t kind) {
+  switch (kind) {
+    case KIND_SOIL: return "soil";
+    case KIND_TEMPERATURE: return "temperature";
+    case KIND_HUMIDITY: return "humidity";
+    default: return "unknown";
+  }
+}
+
+} // namespace probe
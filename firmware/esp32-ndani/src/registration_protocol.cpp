@@ -0,0 +1,74 @@
+/**
+ * Registration Protocol Implementation
+ */
+
+#include "registration_protocol.h"
+#include "wire_codec.h"
+
+namespace reg {
+
+size_t encodeRetry(uint32_t seconds, uint8_t* out) {
+  if (seconds < 1) seconds = 1;
+  if (seconds > RETRY_MAX_S) seconds = RETRY_MAX_S;
+  out[0] = wire::MSG_REGISTRATION_RETRY;
+  out[1] = (uint8_t)(seconds >> 8);
+  out[2] = (uint8_t)seconds;
+  return RETRY_SIZE;
+}
+
+bool parseRetry(const uint8_t* message, size_t length, uint32_t* seconds) {
+  if (length < RETRY_SIZE || message[0] != wire::MSG_REGISTRATION_RETRY) return false;
+  *seconds = (uint32_t)(message[1] << 8 | message[2]);
+  return true;
+}
+
+Pacer::Pacer(uint32_t perMinute, uint32_t burst)
+    : _intervalMs(perMinute ? 60000 / perMinute : 0),
+      _toleranceMs(perMinute && burst > 1 ? (uint64_t)(burst - 1) * (60000 / perMinute) : 0) {}
+
+uint32_t Pacer::onRegistration(uint16_t address, uint64_t nowMs) {
+  if (_intervalMs == 0) {
+    _stats.admitted++;
+    return 0;
+  }
+
+  for (auto it = _slots.begin(); it != _slots.end();) {
+    if (it->second + SLOT_EXPIRY_MS < nowMs) {
+      it = _slots.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // A device back for its slot: the capacity is already set aside. Up to
+  // one interval early still counts, the device adds its own jitter.
+  auto slot = _slots.find(address);
+  if (slot != _slots.end()) {
+    if (nowMs + _intervalMs >= slot->second) {
+      _slots.erase(slot);
+      _stats.admitted++;
+      return 0;
+    }
+    return defer(slot->second, nowMs);
+  }
+
+  uint64_t next = _nextMs > nowMs ? _nextMs : nowMs;
+  _nextMs = next + _intervalMs;
+  if (next <= nowMs + _toleranceMs) {
+    _stats.admitted++;
+    return 0;
+  }
+  _slots[address] = next;
+  return defer(next, nowMs);
+}
+
+uint32_t Pacer::defer(uint64_t slotMs, uint64_t nowMs) {
+  uint64_t waitS = (slotMs - nowMs + 999) / 1000;
+  if (waitS < 1) waitS = 1;
+  if (waitS > RETRY_MAX_S) waitS = RETRY_MAX_S;
+  _stats.deferred++;
+  if (waitS > _stats.longestWaitS) _stats.longestWaitS = (uint32_t)waitS;
+  return (uint32_t)waitS;
+}
+
+} // namespace reg
@@ -0,0 +1,11 @@
+/**
+ * Release Key
+ */
+
+#include "release_key.h"
+#include "config.h"
+
+#ifndef OTA_RELEASE_PUBLIC_KEY
+#error "OTA_RELEASE_PUBLIC_KEY is not set: see scripts/release_key.py"
+#endif
+const uint8_t RELEASE_PUBLIC_KEY[64] = {OTA_RELEASE_PUBLIC_KEY};
@@ -3,10 +3,14 @@
  * 
  * ATECC608B driver for Msingi ESP32-S3 firmware.
  * Handles P-256 key operations and secure hashing.
+ * The native build uses the emulator in src/sim/secure_element_sim.cpp.
  */
 
+#ifdef ARDUINO
+
 #include "secure_element.h"
 #include "config.h"
+#include "i2c_bus.h"
 #include <SparkFun_ATECCX08a_Arduino_Library.h>
 
 // Static instance of the ATECC library
@@ -14,15 +18,18 @@ static ATECCX08A atecc;
 
 bool SecureElement::begin() {
   if (_initialized) return true;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Initialize the ATECC608B
   if (!atecc.begin()) {
+    bus.fail();
     Serial.println("ATECC608B: begin() failed");
     return false;
   }
   
   // Verify communication by reading serial number
   if (!atecc.wakeUp()) {
+    bus.fail();
     Serial.println("ATECC608B: wakeUp() failed");
     return false;
   }
@@ -50,6 +57,7 @@ bool SecureElement::isKeyProvisioned(uint8_t slot) {
 
 bool SecureElement::generateKey(uint8_t slot) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Generate a new P-256 private key in the slot
   // The private key is generated inside the chip and never exported
@@ -64,6 +72,7 @@ bool SecureElement::generateKey(uint8_t slot) {
 
 bool SecureElement::getPublicKey(uint8_t slot, uint8_t* publicKey) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Read the public key associated with the private key in slot
   if (!atecc.generatePublicKey(slot)) {
@@ -77,6 +86,7 @@ bool SecureElement::getPublicKey(uint8_t slot, uint8_t* publicKey) {
 
 bool SecureElement::sign(const uint8_t* data, size_t dataLen, uint8_t* signature) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // First, compute SHA256 of the data
   uint8_t hash[32];
@@ -99,6 +109,7 @@ bool SecureElement::sign(const uint8_t* data, size_t dataLen, uint8_t* signature
 bool SecureElement::verify(const uint8_t* publicKey, const uint8_t* data, 
                            size_t dataLen, const uint8_t* signature) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Compute hash of data
   uint8_t hash[32];
@@ -120,6 +131,7 @@ bool SecureElement::verify(const uint8_t* publicKey, const uint8_t* data,
 
 bool SecureElement::computeNullifier(uint32_t epoch, uint8_t* nullifier) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Nullifier = H(domain || device_nonce || epoch)
   // Use HMAC mode with the device key in slot
@@ -153,6 +165,7 @@ bool SecureElement::computeNullifier(uint32_t epoch, uint8_t* nullifier) {
 
 bool SecureElement::random(uint8_t* buffer, size_t length) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // ATECC608B generates 32 random bytes at a time
   size_t remaining = length;
@@ -175,6 +188,7 @@ bool SecureElement::random(uint8_t* buffer, size_t length) {
 
 bool SecureElement::sha256(const uint8_t* data, size_t dataLen, uint8_t* hash) {
   if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
   
   // Use the ATECC608B's SHA256 engine
   // This is faster and more secure than software implementation
@@ -212,3 +226,5 @@ bool SecureElement::sha256(const uint8_t* data, size_t dataLen, uint8_t* hash) {
   
   return true;
 }
+
+#endif // ARDUINO
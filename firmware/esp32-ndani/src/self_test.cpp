@@ -0,0 +1,530 @@
+/**
+ * Self-Test Console Implementation
+ *
+ * Every test prints a single JSON line starting with {"test":...} so a
+ * technician's laptop can log and diff units. Timings use hal::micros();
+ * each operation is repeated and reported as min/avg/max.
+ */
+
+#include "self_test.h"
+#include "config.h"
+#include "i2c_bus.h"
+#include "mem_arena.h"
+#include "lora_airtime.h"
+#include "wire_codec.h"
+#include <math.h>
+
+namespace {
+
+const uint8_t BME280_I2C_ADDR = 0x76;
+const uint8_t BME280_CALIB_REG = 0x88;   // 26-byte calibration block
+
+// Repeated-measurement summary
+struct Timing {
+  uint32_t n = 0;
+  uint32_t minUs = UINT32_MAX;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+
+  void add(uint32_t us) {
+    n++;
+    totalUs += us;
+    if (us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+  }
+  uint32_t avgUs() const { return n ? (uint32_t)(totalUs / n) : 0; }
+
+  // "name":{"n":..,"min_us":..,"avg_us":..,"max_us":..}
+  void print(const char* name, bool last = false) const {
+    Serial.printf("\"%s\":{\"n\":%lu,\"min_us\":%lu,\"avg_us\":%lu,\"max_us\":%lu}%s",
+                  name, (unsigned long)n, (unsigned long)(n ? minUs : 0),
+                  (unsigned long)avgUs(), (unsigned long)maxUs, last ? "" : ",");
+  }
+};
+
+} // namespace
+
+void SelfTestConsole::begin(SecureElement* se, LoRaComm* lora, TransportSet* links,
+                            Sensors* sensors, ProbeHub* hub) {
+  _se = se;
+  _lora = lora;
+  _links = links;
+  _sensors = sensors;
+  _hub = hub;
+  _lineLen = 0;
+}
+
+bool SelfTestConsole::poll() {
+  if (!Serial) return false;   // No host on the USB CDC port
+
+  while (Serial.available()) {
+    int c = Serial.read();
+    if (c < 0) break;
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (_lineLen < sizeof(_line) - 1) _line[_lineLen++] = (char)c;
+      continue;
+    }
+    _line[_lineLen] = '\0';
+    _lineLen = 0;
+    if (_line[0] == '\0') continue;
+    runCommand(_line);
+    return true;
+  }
+  return false;
+}
+
+void SelfTestConsole::runCommand(char* line) {
+  char* cmd = strtok(line, " ");
+  char* arg1 = strtok(nullptr, " ");
+  char* arg2 = strtok(nullptr, " ");
+  char* arg3 = strtok(nullptr, " ");
+  char* arg4 = strtok(nullptr, " ");
+
+  if (strcmp(cmd, "help") == 0) {
+    printHelp();
+  } else if (strcmp(cmd, "info") == 0) {
+    printInfo();
+  } else if (strcmp(cmd, "selftest") == 0) {
+    bool all = !arg1 || strcmp(arg1, "all") == 0;
+    bool known = all;
+    if (all || strcmp(arg1, "atecc") == 0) { testAtecc(); known = true; }
+    if (all || strcmp(arg1, "i2c") == 0) { testI2c(); known = true; }
+    if (all || strcmp(arg1, "bme280") == 0) { testBme280(); known = true; }
+    if (all || strcmp(arg1, "adc") == 0) { testAdc(); known = true; }
+    if (all || strcmp(arg1, "lora") == 0) { testLoRa(); known = true; }
+    if (!known) Serial.printf("{\"error\":\"unknown test\",\"test\":\"%s\"}\n", arg1);
+  } else if (strcmp(cmd, "echo") == 0) {
+    int count = arg1 ? atoi(arg1) : 5;
+    int bytes = arg2 ? atoi(arg2) : 16;
+    if (count < 1) count = 1;
+    if (count > 100) count = 100;
+    testEcho(count, (size_t)bytes);
+  } else if (strcmp(cmd, "i2c") == 0) {
+    printI2cStats();
+    if (arg1 && strcmp(arg1, "reset") == 0) hal::i2cBus().resetStats();
+  } else if (strcmp(cmd, "mem") == 0) {
+    printMemory();
+  } else if (strcmp(cmd, "link") == 0) {
+    LinkKind kind;
+    if (arg1 && strcmp(arg1, "auto") == 0) {
+      _links->preferNone();
+    } else if (arg1 && parseLinkName(arg1, &kind)) {
+      _links->prefer(kind);
+    } else if (arg1) {
+      Serial.printf("{\"error\":\"unknown link\",\"link\":\"%s\"}\n", arg1);
+      return;
+    }
+    printLinks();
+  } else if (strcmp(cmd, "probe") == 0) {
+    if (arg1) {
+      provisionProbes(arg1, arg2, arg3, arg4);
+    } else {
+      printProbes();
+    }
+  } else {
+    Serial.printf("{\"error\":\"unknown command\",\"command\":\"%s\"}\n", cmd);
+  }
+}
+
+void SelfTestConsole::printHelp() {
+  Serial.println("{\"commands\":[\"help\",\"info\",\"selftest [all|atecc|i2c|bme280|adc|lora]\","
+                 "\"echo [count] [bytes]\",\"i2c [reset]\",\"mem\",\"link [auto|lora|wifi]\",\"probe [layout <soil> <mask>|cal <probe> <air> <water>|"
+                 "offset <channel> <t> <h>]\"]}");
+}
+
+void SelfTestConsole::printInfo() {
+  Serial.printf("{\"firmware\":\"%s\",\"device_type\":\"%s\",\"uptime_ms\":%lu,"
+                "\"cpu_mhz\":%lu,\"lora_address\":%d,\"network_id\":%d,"
+                "\"spreading_factor\":%d,\"bandwidth_khz\":%d}\n",
+                FIRMWARE_VERSION, DEVICE_TYPE, (unsigned long)hal::millis(),
+                (unsigned long)hal::cpuFrequencyMhz(), LORA_DEVICE_ADDRESS,
+                LORA_NETWORK_ID, LORA_SPREADING_FACTOR, LORA_BANDWIDTH);
+}
+
+void SelfTestConsole::testAtecc() {
+  const int N = 5;
+  Timing tRandom, tSha, tPubKey, tSign, tVerify, tNullifier;
+  bool ok = true;
+  uint8_t buf[128];
+  uint8_t digest[32];
+  uint8_t publicKey[64];
+  uint8_t signature[64];
+
+  for (int i = 0; i < N; i++) {
+    uint32_t t = hal::micros();
+    ok &= _se->random(buf, 32);
+    tRandom.add(hal::micros() - t);
+
+    t = hal::micros();
+    ok &= _se->sha256(buf, sizeof(buf), digest);
+    tSha.add(hal::micros() - t);
+
+    t = hal::micros();
+    ok &= _se->getPublicKey(SLOT_DEVICE_KEY, publicKey);
+    tPubKey.add(hal::micros() - t);
+
+    t = hal::micros();
+    ok &= _se->sign(digest, 32, signature);
+    tSign.add(hal::micros() - t);
+
+    t = hal::micros();
+    ok &= _se->verify(publicKey, digest, 32, signature);
+    tVerify.add(hal::micros() - t);
+
+    t = hal::micros();
+    ok &= _se->computeNullifier((uint32_t)i, digest);
+    tNullifier.add(hal::micros() - t);
+  }
+
+  Serial.printf("{\"test\":\"atecc\",\"ok\":%s,", ok ? "true" : "false");
+  tRandom.print("random_32");
+  tSha.print("sha256_128");
+  tPubKey.print("get_public_key");
+  tSign.print("sign");
+  tVerify.print("verify");
+  tNullifier.print("nullifier", true);
+  Serial.println("}");
+}
+
+void SelfTestConsole::testI2c() {
+  const int N = 20;
+  uint8_t block[26];
+  Timing t;
+  bool ok = true;
+
+  I2cBus& bus = hal::i2cBus();
+  for (int i = 0; i < N; i++) {
+    uint32_t start = hal::micros();
+    ok &= bus.read(I2cBus::DEVICE_BME280, BME280_I2C_ADDR, BME280_CALIB_REG, block, sizeof(block));
+    t.add(hal::micros() - start);
+  }
+
+  // Payload throughput and how close the bus gets to the BME280's clock
+  // (9 clocks per byte, plus address/register/restart overhead)
+  uint32_t clockHz = I2cBus::clockHz(I2cBus::DEVICE_BME280);
+  double seconds = t.totalUs / 1e6;
+  double bytesPerSecond = seconds > 0 ? N * sizeof(block) / seconds : 0;
+  double efficiency = bytesPerSecond * 9.0 / clockHz;
+
+  Serial.printf("{\"test\":\"i2c\",\"ok\":%s,\"clock_hz\":%lu,\"block_bytes\":%u,",
+                ok ? "true" : "false", (unsigned long)clockHz, (unsigned)sizeof(block));
+  t.print("block_read", true);
+  Serial.printf(",\"bytes_per_s\":%.0f,\"bus_efficiency\":%.2f}\n",
+                bytesPerSecond, efficiency);
+}
+
+void SelfTestConsole::testBme280() {
+  const int N = 5;
+  hal::EnvSensor& bme = hal::envSensor();
+  Timing t;
+  float temperature = 0, humidity = 0, pressure = 0;
+
+  {
+    I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_BME280);
+    for (int i = 0; i < N; i++) {
+      uint32_t start = hal::micros();
+      bme.takeForcedMeasurement();
+      t.add(hal::micros() - start);
+    }
+    temperature = bme.readTemperature();
+    humidity = bme.readHumidity();
+    pressure = bme.readPressure() / 100.0f;
+  }
+
+  bool ok = (_sensors->getStatus() & 0x01) &&
+            temperature >= TEMP_MIN && temperature <= TEMP_MAX &&
+            humidity >= HUMIDITY_MIN && humidity <= HUMIDITY_MAX;
+
+  Serial.printf("{\"test\":\"bme280\",\"ok\":%s,", ok ? "true" : "false");
+  t.print("conversion", true);
+  Serial.printf(",\"temperature_c\":%.2f,\"humidity_pct\":%.1f,\"pressure_hpa\":%.1f}\n",
+                temperature, humidity, pressure);
+}
+
+void SelfTestConsole::testAdc() {
+  const int N = 256;
+  int minRaw = 4095, maxRaw = 0;
+  double sum = 0, sumSq = 0;
+
+  uint32_t start = hal::micros();
+  for (int i = 0; i < N; i++) {
+    int raw = hal::analogRead(SOIL_SENSOR_PIN);
+    sum += raw;
+    sumSq += (double)raw * raw;
+    if (raw < minRaw) minRaw = raw;
+    if (raw > maxRaw) maxRaw = raw;
+  }
+  uint32_t elapsed = hal::micros() - start;
+
+  double mean = sum / N;
+  double stddev = sqrt(sumSq / N - mean * mean > 0 ? sumSq / N - mean * mean : 0);
+  double rate = elapsed ? N * 1e6 / elapsed : 0;
+
+  // A rail reading means an open or shorted probe; large spread means noise
+  bool ok = minRaw > 0 && maxRaw < 4095 && stddev < 50.0;
+
+  Serial.printf("{\"test\":\"adc\",\"ok\":%s,\"samples\":%d,\"elapsed_us\":%lu,"
+                "\"samples_per_s\":%.0f,\"mean\":%.1f,\"stddev\":%.2f,\"min\":%d,\"max\":%d,"
+                "\"moisture_pct\":%.1f}\n",
+                ok ? "true" : "false", N, (unsigned long)elapsed, rate, mean, stddev,
+                minRaw, maxRaw, _sensors->calibrateSoilReading((int)lround(mean)));
+}
+
+void SelfTestConsole::testLoRa() {
+  const int N = 10;
+  Timing t;
+  int failures = 0;
+
+  for (int i = 0; i < N; i++) {
+    uint32_t start = hal::micros();
+    bool ok = _lora->ping();
+    uint32_t elapsed = hal::micros() - start;
+    if (ok) t.add(elapsed);
+    else failures++;
+  }
+
+  Serial.printf("{\"test\":\"lora\",\"ok\":%s,\"failures\":%d,\"baud\":%d,",
+                failures == 0 ? "true" : "false", failures, LORA_UART_BAUD);
+  t.print("at_round_trip", true);
+  Serial.println("}");
+}
+
+void SelfTestConsole::testEcho(int count, size_t payloadBytes) {
+  // Hex-encoded on air: at most 120 bytes fit the module's 240-char limit
+  if (payloadBytes < 2) payloadBytes = 2;
+  if (payloadBytes > RYLR896_MAX_PAYLOAD / 2) payloadBytes = RYLR896_MAX_PAYLOAD / 2;
+
+  const uint32_t toaUpUs = loraTimeOnAirUs(2 * payloadBytes, LORA_SPREADING_FACTOR,
+                                           LORA_BANDWIDTH);
+  const uint32_t toaDownUs = loraTimeOnAirUs(8, LORA_SPREADING_FACTOR, LORA_BANDWIDTH);
+  const uint32_t timeoutMs = (toaUpUs + toaDownUs) / 1000 + 3000;
+
+  Timing rtt;
+  int received = 0;
+  long gwRssiSum = 0, gwSnrSum = 0, rssiSum = 0, snrSum = 0;
+
+  for (int i = 0; i < count; i++) {
+    uint8_t frame[RYLR896_MAX_PAYLOAD / 2];
+    uint8_t seq = ++_echoSeq;
+    frame[0] = wire::MSG_ECHO_REQUEST;
+    frame[1] = seq;
+    for (size_t b = 2; b < payloadBytes; b++) frame[b] = (uint8_t)(b * 31 + seq);
+
+    uint32_t start = hal::micros();
+    bool sent = _lora->transmit(frame, payloadBytes);
+    uint32_t sentUs = hal::micros() - start;
+
+    // Wait for the matching reply; other downlinks are dropped while testing
+    bool gotReply = false;
+    int8_t gwRssi = 0, gwSnr = 0;
+    uint32_t deadline = hal::millis() + timeoutMs;
+    while (sent && !gotReply && (int32_t)(deadline - hal::millis()) > 0) {
+      if (!_lora->available()) {
+        hal::delay(1);
+        continue;
+      }
+      uint8_t reply[64];
+      size_t n = _lora->receive(reply, sizeof(reply));
+      if (n >= 4 && reply[0] == wire::MSG_ECHO_REPLY && reply[1] == seq) {
+        gotReply = true;
+        gwRssi = (int8_t)reply[2];
+        gwSnr = (int8_t)reply[3];
+      }
+    }
+    uint32_t rttUs = hal::micros() - start;
+
+    if (gotReply) {
+      received++;
+      rtt.add(rttUs);
+      gwRssiSum += gwRssi;
+      gwSnrSum += gwSnr;
+      rssiSum += _lora->getRSSI();
+      snrSum += _lora->getSNR();
+      Serial.printf("{\"test\":\"echo_frame\",\"seq\":%u,\"ok\":true,\"send_us\":%lu,"
+                    "\"rtt_us\":%lu,\"uplink_rssi\":%d,\"uplink_snr\":%d,"
+                    "\"downlink_rssi\":%d,\"downlink_snr\":%d}\n",
+                    seq, (unsigned long)sentUs, (unsigned long)rttUs, gwRssi, gwSnr,
+                    _lora->getRSSI(), _lora->getSNR());
+    } else {
+      Serial.printf("{\"test\":\"echo_frame\",\"seq\":%u,\"ok\":false,\"sent\":%s}\n",
+                    seq, sent ? "true" : "false");
+    }
+  }
+
+  // Round trip minus both frames on air is the gateway and module overhead
+  uint32_t overheadUs = rtt.n && rtt.minUs > toaUpUs + toaDownUs
+                            ? rtt.minUs - toaUpUs - toaDownUs : 0;
+  Serial.printf("{\"test\":\"echo\",\"ok\":%s,\"sent\":%d,\"received\":%d,"
+                "\"payload_bytes\":%u,\"toa_up_us\":%lu,\"toa_down_us\":%lu,"
+                "\"overhead_us\":%lu,",
+                received == count ? "true" : "false", count, received,
+                (unsigned)payloadBytes, (unsigned long)toaUpUs, (unsigned long)toaDownUs,
+                (unsigned long)overheadUs);
+  rtt.print("rtt", true);
+  if (received > 0) {
+    Serial.printf(",\"uplink_rssi_avg\":%.1f,\"uplink_snr_avg\":%.1f,"
+                  "\"downlink_rssi_avg\":%.1f,\"downlink_snr_avg\":%.1f}\n",
+                  (double)gwRssiSum / received, (double)gwSnrSum / received,
+                  (double)rssiSum / received, (double)snrSum / received);
+  } else {
+    Serial.println("}");
+  }
+}
+
+void SelfTestConsole::printI2cStats() {
+  const I2cBus& bus = hal::i2cBus();
+  const I2cBus::BusStats& stats = bus.busStats();
+  Serial.printf("{\"test\":\"i2c_bus\",\"utilization\":%.4f,\"busy_us\":%llu,"
+                "\"clock_switches\":%lu,\"contended\":%lu,\"wait_us\":%llu,\"devices\":{",
+                bus.utilization(), (unsigned long long)stats.busyUs,
+                (unsigned long)stats.clockSwitches, (unsigned long)stats.contended,
+                (unsigned long long)stats.waitUs);
+  for (uint8_t d = 0; d < I2cBus::DEVICE_COUNT; d++) {
+    I2cBus::Device device = (I2cBus::Device)d;
+    const I2cBus::DeviceStats& s = bus.stats(device);
+    Serial.printf("%s\"%s\":{\"clock_hz\":%lu,\"n\":%lu,\"failures\":%lu,\"bytes\":%lu,"
+                  "\"avg_us\":%lu,\"max_us\":%lu}", d ? "," : "", I2cBus::deviceName(device),
+                  (unsigned long)I2cBus::clockHz(device), (unsigned long)s.transactions,
+                  (unsigned long)s.failures, (unsigned long)s.bytes,
+                  (unsigned long)(s.transactions ? s.busyUs / s.transactions : 0),
+                  (unsigned long)s.maxUs);
+  }
+  Serial.println("}}");
+}
+
+/**
+ * Headroom: each region's heap (fragmentation is the share of free memory
+ * outside the largest block), the arena blocks, and each task's stack
+ * high-water mark, flagged below STACK_HEADROOM_MIN
+ */
+void SelfTestConsole::printMemory() {
+  Serial.print("{\"test\":\"mem\",\"heaps\":{");
+  bool first = true;
+  for (size_t r = 0; r < hal::MEM_REGIONS; r++) {
+    hal::MemRegion region = (hal::MemRegion)r;
+    hal::HeapInfo heap;
+    if (!hal::heapInfo(region, &heap)) continue;
+    float fragmentation = heap.freeBytes ? 1.0f - (float)heap.largestFreeBlock / heap.freeBytes : 0;
+    Serial.printf("%s\"%s\":{\"total\":%u,\"free\":%u,\"min_free\":%u,\"largest\":%u,"
+                  "\"fragmentation\":%.3f,\"arena\":%u}", first ? "" : ",",
+                  MemArena::regionName(region), (unsigned)heap.totalBytes,
+                  (unsigned)heap.freeBytes, (unsigned)heap.minFreeBytes,
+                  (unsigned)heap.largestFreeBlock, fragmentation,
+                  (unsigned)hal::memArena().used(region));
+    first = false;
+  }
+  
+  const MemArena& arena = hal::memArena();
+  Serial.print("},\"blocks\":[");
+  for (size_t i = 0; i < arena.blocks(); i++) {
+    const MemArena::Block& block = arena.block(i);
+    Serial.printf("%s{\"name\":\"%s\",\"bytes\":%u,\"region\":\"%s\",\"requested\":\"%s\"}",
+                  i ? "," : "", block.name, (unsigned)block.bytes,
+                  MemArena::regionName(block.region), MemArena::regionName(block.requested));
+  }
+  
+  hal::TaskStack tasks[8];
+  size_t count = hal::taskStacks(tasks, 8);
+  Serial.print("],\"stacks\":[");
+  for (size_t i = 0; i < count; i++) {
+    Serial.printf("%s{\"task\":\"%s\",\"size\":%u,\"min_free\":%u,\"low\":%s}",
+                  i ? "," : "", tasks[i].name, (unsigned)tasks[i].sizeBytes,
+                  (unsigned)tasks[i].minFreeBytes,
+                  tasks[i].minFreeBytes < STACK_HEADROOM_MIN ? "true" : "false");
+  }
+  Serial.println("]}");
+}
+
+/**
+ * Every link with its capabilities and counters, and the one a message
+ * would go over now
+ */
+void SelfTestConsole::printLinks() {
+  LinkKind pin;
+  bool pinned = _links->pinned(&pin);
+  Transport* route = _links->route(0);
+  Serial.printf("{\"test\":\"link\",\"pinned\":\"%s\",\"route\":\"%s\",\"links\":[",
+                pinned ? linkName(pin) : "auto", route ? linkName(route->caps().kind) : "none");
+  for (size_t i = 0; i < _links->links(); i++) {
+    Transport& link = _links->link(i);
+    const LinkCaps& caps = link.caps();
+    const LinkStats& stats = _links->stats(i);
+    Serial.printf("%s{\"link\":\"%s\",\"ready\":%s,\"backed_off\":%s,\"mtu\":%u,\"cost\":%u,"
+                  "\"latency_ms\":%lu,\"duty_cycled\":%s,\"batched\":%s,\"messages\":%lu,"
+                  "\"bytes\":%llu,\"failures\":%lu,\"flushes\":%lu}",
+                  i ? "," : "", linkName(caps.kind), link.ready() ? "true" : "false",
+                  _links->backedOff(i) ? "true" : "false", (unsigned)caps.mtu, caps.cost,
+                  (unsigned long)caps.latencyMs, caps.dutyCycled ? "true" : "false",
+                  caps.batched ? "true" : "false", (unsigned long)stats.messages,
+                  (unsigned long long)stats.bytes, (unsigned long)stats.failures,
+                  (unsigned long)stats.flushes);
+  }
+  Serial.println("]}");
+}
+
+/**
+ * Hub layout with each soil probe's raw ADC value (what calibration needs)
+ * and one reading of every channel
+ */
+void SelfTestConsole::printProbes() {
+  const ProbeHub::Layout& layout = _hub->layout();
+  Serial.printf("{\"test\":\"probe\",\"soil_probes\":%u,\"env_mask\":%u,\"soil\":[",
+                layout.soilProbes, layout.envMask);
+  for (uint8_t n = 1; n <= layout.soilProbes; n++) {
+    Serial.printf("%s{\"probe\":%u,\"raw\":%d,\"air\":%u,\"water\":%u}", n > 1 ? "," : "",
+                  n, _hub->readSoilRaw(n), layout.soilAir[n - 1], layout.soilWater[n - 1]);
+  }
+  Serial.print("],\"channels\":[");
+  probe::Reading reading;
+  _hub->read(&reading);
+  for (size_t i = 0; i < reading.count; i++) {
+    const probe::Channel& c = reading.channels[i];
+    if (isnan(c.value)) {
+      Serial.printf("%s[\"%s\",%u,null]", i ? "," : "", probe::kindName(c.kind), c.index);
+    } else {
+      Serial.printf("%s[\"%s\",%u,%.2f]", i ? "," : "", probe::kindName(c.kind), c.index,
+                    c.value);
+    }
+  }
+  Serial.println("]}");
+}
+
+/**
+ * Change one part of the hub layout and persist it:
+ * - layout <soil probes> <BME280 channel mask>
+ * - cal <probe> <air> <water>: raw ADC ends of one soil probe
+ * - offset <channel> <t> <h>: corrections of one BME280, 0.01 °C and 0.01 %
+ */
+void SelfTestConsole::provisionProbes(const char* what, char* arg1, char* arg2, char* arg3) {
+  ProbeHub::Layout layout = _hub->layout();
+  bool parsed = false;
+  if (strcmp(what, "layout") == 0 && arg1 && arg2) {
+    layout.soilProbes = (uint8_t)atoi(arg1);
+    layout.envMask = (uint8_t)strtol(arg2, nullptr, 0);
+    parsed = true;
+  } else if (strcmp(what, "cal") == 0 && arg1 && arg2 && arg3) {
+    int n = atoi(arg1);
+    if (n >= 1 && n <= (int)ProbeHub::SOIL_MAX) {
+      layout.soilAir[n - 1] = (uint16_t)atoi(arg2);
+      layout.soilWater[n - 1] = (uint16_t)atoi(arg3);
+      parsed = true;
+    }
+  } else if (strcmp(what, "offset") == 0 && arg1 && arg2 && arg3) {
+    int ch = atoi(arg1);
+    if (ch >= 0 && ch < (int)ProbeHub::ENV_MAX) {
+      layout.temperatureOffset[ch] = (int16_t)atoi(arg2);
+      layout.humidityOffset[ch] = (int16_t)atoi(arg3);
+      parsed = true;
+    }
+  }
+  if (!parsed) {
+    Serial.printf("{\"error\":\"bad probe command\",\"command\":\"%s\"}\n", what);
+    return;
+  }
+  if (!_hub->setLayout(layout)) {
+    Serial.println("{\"error\":\"probe layout rejected\"}");
+    return;
+  }
+  printProbes();
+}
@@ -0,0 +1,928 @@
+/**
+ * Sensor Node Implementation
+ * 
+ * Device application: hardware bring-up, BRACE registration, the
+ * periodic sense-sign-transmit cycle and the alert checks between
+ * cycles. Driven by setup()/loop() in main.cpp
+ * on the device and by the simulators in src/sim/ on the host.
+ */
+
+#include "sensor_node.h"
+#include "config.h"
+#include "i2c_bus.h"
+#include "mem_arena.h"
+#include "lora_airtime.h"
+#include "registration_protocol.h"
+#include "downlink_protocol.h"
+#include "sensor_schema.h"
+#include <math.h>
+
+namespace {
+
+const char* const NVS_CLOCK_DRIFT = "clock_drift";
+const char* const NVS_GDD_TOTAL = "gdd_total";
+
+// The longest reading: hub probes and every trailer item
+const size_t READING_MAX = probe::PACKET_MAX + alert::TRAILER_SIZE +
+                           wire::TRAILER_ITEM_HEADER_SIZE + tsync::REPORT_SIZE +
+                           wire::TRAILER_ITEM_HEADER_SIZE + analytics::REPORT_SIZE +
+                           schema::Extra::ITEM_SIZE;
+static_assert(READING_MAX <= UplinkQueue::ENTRY_MAX, "reading does not fit the uplink queue");
+static_assert(READING_MAX <= 2 * wire::FRAGMENT_CHUNK_MAX, "reading needs a third frame");
+
+// A queued reading as sent, with the settings report in its trailer
+const size_t REPORT_ITEM_SIZE = wire::TRAILER_ITEM_HEADER_SIZE + rcfg::REPORT_SIZE;
+
+} // namespace
+
+/**
+ * Setup - Initialize all hardware components
+ */
+void SensorNode::setup() {
+  // Initialize serial for debugging
+  Serial.begin(115200);
+  while (!Serial && hal::millis() < 3000); // Wait up to 3s for serial
+  
+  Serial.println("\n═══════════════════════════════════════");
+  Serial.println("  Msingi IoT Device - EdgeChain");
+  Serial.print("  Firmware: ");
+  Serial.println(FIRMWARE_VERSION);
+  Serial.println("═══════════════════════════════════════\n");
+  
+  // Initialize I2C bus
+  hal::i2cBus().begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  Serial.println("✓ I2C bus initialized");
+  
+  // Initialize secure element
+  if (!_secureElement.begin()) {
+    Serial.println("✗ ATECC608B initialization failed!");
+    Serial.println("  Device cannot operate without secure element.");
+    while (1) { hal::delay(1000); } // Halt
+  }
+  Serial.println("✓ ATECC608B secure element ready");
+  
+  // Check if device key is provisioned
+  if (!_secureElement.isKeyProvisioned(SLOT_DEVICE_KEY)) {
+    Serial.println("⚠ Device key not provisioned, generating...");
+    if (!_secureElement.generateKey(SLOT_DEVICE_KEY)) {
+      Serial.println("✗ Key generation failed!");
+      while (1) { hal::delay(1000); }
+    }
+    Serial.println("✓ Device key provisioned (P-256)");
+  } else {
+    Serial.println("✓ Device key already provisioned");
+  }
+  
+  // Get device public key for display
+  uint8_t publicKey[64];
+  if (_secureElement.getPublicKey(SLOT_DEVICE_KEY, publicKey)) {
+    Serial.print("  Public Key: ");
+    for (int i = 0; i < 8; i++) {
+      Serial.printf("%02X", publicKey[i]);
+    }
+    Serial.println("...");
+  }
+  
+  // Remote settings from NVS (config.h values until a config message arrives)
+  _config.begin(&_secureElement);
+  
+  // Time is lost with the reset, the crystal's drift is not
+  _clock = tsync::Clock();
+  int32_t driftPpb;
+  if (hal::nvs().get(NVS_CLOCK_DRIFT, &driftPpb, sizeof(driftPpb)) == sizeof(driftPpb)) {
+    _clock.setDrift(driftPpb);
+    Serial.printf("✓ Clock drift %+.1f ppm (waiting for a time beacon)\n", driftPpb / 1000.0);
+  }
+  const rcfg::Settings& settings = _config.settings();
+  
+  // Degree days count from provisioning, not from the last reset
+  _analytics = analytics::EdgeAnalytics();
+  _analyticsStarted = false;
+  float gdd;
+  if (hal::nvs().get(NVS_GDD_TOTAL, &gdd, sizeof(gdd)) == sizeof(gdd) && gdd >= 0) {
+    _analytics.setGdd(gdd);
+    Serial.printf("✓ Growing degree days: %.1f\n", gdd);
+  }
+  
+  // Readings kept on flash survive resets; a model round in progress does not
+  _pull = HistoryPull();
+  _fl = FlClient();
+  
+  // Large buffers out of internal RAM (mem_arena.h): the outbox in the
+  // RTC pool, the training window in PSRAM
+  MemArena& arena = hal::memArena();
+  _uplink.begin(static_cast<UplinkQueue::Entry*>(arena.alloc(
+      "outbox", UplinkQueue::CAPACITY * sizeof(UplinkQueue::Entry), hal::MemRegion::Rtc)));
+  _fl.begin(static_cast<FlClient::Samples*>(
+      arena.alloc("fl_window", sizeof(FlClient::Samples), hal::MemRegion::Psram)));
+  if (_history.begin(hal::historyPartition())) {
+    Serial.printf("✓ History: %u samples, %u hourly, %u daily\n",
+                  (unsigned)_history.records(hist::Tier::Raw),
+                  (unsigned)_history.records(hist::Tier::Hourly),
+                  (unsigned)_history.records(hist::Tier::Daily));
+  } else {
+    Serial.println("⚠ No history partition, readings are not kept");
+  }
+  
+  // Initialize LoRa communication
+  if (!_loraComm.begin(LORA_RX_PIN, LORA_TX_PIN)) {
+    Serial.println("✗ LoRa module initialization failed!");
+    while (1) { hal::delay(1000); }
+  }
+  // Random fragment sequence start so the gateway does not treat
+  // messages after a reboot as repeats
+  uint8_t seqSeed[2];
+  if (_secureElement.random(seqSeed, sizeof(seqSeed))) {
+    _loraComm.setSequence((uint16_t)(seqSeed[0] | (seqSeed[1] << 8)));
+  }
+  _loraComm.setNetworkId(LORA_NETWORK_ID);
+  _loraComm.setAddress(LORA_DEVICE_ADDRESS);
+  _loraComm.configure(LORA_FREQUENCY, settings.spreadingFactor, settings.bandwidthKHz,
+                      settings.txPowerDbm);
+  Serial.println("✓ LoRa RYLR896 ready");
+  Serial.printf("  Frequency: %d MHz, SF: %d, BW: %u kHz, TX power: %u dBm\n", 
+                LORA_FREQUENCY / 1000000, settings.spreadingFactor, settings.bandwidthKHz,
+                settings.txPowerDbm);
+  Serial.printf("  Network ID: %d, Device Address: %d, Proof Server Address: %d\n",
+                LORA_NETWORK_ID, LORA_DEVICE_ADDRESS, PROOF_SERVER_LORA_ADDRESS);
+  setupLinks();
+  
+  // Initialize sensors
+  if (!_sensors.begin()) {
+    Serial.println("⚠ Some sensors failed to initialize");
+    // Continue anyway - will report zeros for failed sensors
+  } else {
+    Serial.println("✓ Environmental sensors ready");
+  }
+  _hub.begin();
+  _hubSent = probe::Reading();
+  
+  // Initialize BRACE protocol client
+  _braceClient.begin(&_secureElement, &_links);
+  Serial.println("✓ BRACE protocol client ready");
+  
+  // Check registration status
+  _registered = _braceClient.isRegistered();
+  if (_registered) {
+    _braceClient.getCommitment(_commitment);
+    Serial.println("✓ Device already registered");
+    Serial.print("  Commitment: ");
+    for (int i = 0; i < 8; i++) {
+      Serial.printf("%02X", _commitment[i]);
+    }
+    Serial.println("...");
+    // A site-wide power cut restarts every node at once: spread the
+    // first readings the way the registrations are spread
+    uint32_t jitter = hal::micros();
+    _secureElement.random((uint8_t*)&jitter, sizeof(jitter));
+    _firstReadingMs = hal::millis() + jitter % BOOT_JITTER_MS;
+  } else {
+    Serial.printf("⚠ Device not registered - first attempt in %lu s\n",
+                  (unsigned long)(_braceClient.msUntilDue() / 1000));
+  }
+  
+  // Self-test console on USB CDC
+  _console.begin(&_secureElement, &_loraComm, &_links, &_sensors, &_hub);
+  
+  // Firmware updates: resumes a download interrupted by a reset
+  _ota.begin(&_secureElement, &_links);
+  
+  // Headroom before the first cycle (details: `mem` on the console)
+  hal::HeapInfo heap;
+  if (hal::heapInfo(hal::MemRegion::Internal, &heap)) {
+    Serial.printf("✓ Internal heap %u KB free (largest block %u KB)\n",
+                  (unsigned)(heap.freeBytes / 1024), (unsigned)(heap.largestFreeBlock / 1024));
+  }
+  if (hal::heapInfo(hal::MemRegion::Psram, &heap)) {
+    Serial.printf("✓ PSRAM %u KB free\n", (unsigned)(heap.freeBytes / 1024));
+  }
+  Serial.printf("✓ Arena: %u blocks, %u B internal, %u B PSRAM, %u B RTC\n",
+                (unsigned)arena.blocks(), (unsigned)arena.used(hal::MemRegion::Internal),
+                (unsigned)arena.used(hal::MemRegion::Psram),
+                (unsigned)arena.used(hal::MemRegion::Rtc));
+  
+  Serial.println("\n═══════════════════════════════════════");
+  Serial.println("  Initialization complete!");
+  Serial.println("═══════════════════════════════════════\n");
+}
+
+/**
+ * Links besides LoRa, where this node is configured for them, and the
+ * host's test link
+ */
+void SensorNode::setupLinks() {
+  _links.clear();
+  _links.add(&_loraComm);
+  if (WIFI_SSID[0]) {
+    WifiTransport::Buffers* buffers = static_cast<WifiTransport::Buffers*>(hal::memArena().alloc(
+        "wifi_batch", sizeof(WifiTransport::Buffers), hal::MemRegion::Psram));
+    if (_wifi.begin(WIFI_SSID, WIFI_PASSWORD, LORA_DEVICE_ADDRESS, buffers)) {
+      _links.add(&_wifi);
+      Serial.printf("✓ Wi-Fi link: %s, batches to %s%s\n", WIFI_SSID, PROOF_SERVER_URL,
+                    PROOF_SERVER_UPLINK_PATH);
+    } else {
+      Serial.println("⚠ Wi-Fi link unavailable");
+    }
+  }
+  Transport* host = hal::hostLink();
+  if (host && _links.add(host)) {
+    Serial.printf("✓ Host link: %s\n", linkName(host->caps().kind));
+  }
+}
+
+/**
+ * Main loop - Collect data and transmit to proof server
+ */
+void SensorNode::loop() {
+  // Technician commands over USB (self-tests run inline)
+  _console.poll();
+  
+  unsigned long now = hal::millis();
+  
+  // Check for incoming messages (commands from proof server) on any link
+  if (_links.available()) {
+    handleIncomingMessage();
+  }
+  _ota.poll();
+  
+  // Registration runs on its own schedule (backoff, retry-after)
+  if (!_registered) {
+    attemptRegistration();
+  } else if (readingDue(now)) {
+    _lastReading = now;
+    _lastAlertCheck = now;
+    collectAndTransmitData();
+  } else if (_lastReading != 0 && alertCheckMs() > 0 && now - _lastAlertCheck >= alertCheckMs()) {
+    // Between reports only the alert rules look at the sensors
+    _lastAlertCheck = now;
+    checkAlerts();
+  }
+  
+  // Alerts at once, routine readings once batched, both within the duty cycle
+  if (!_uplink.empty()) serviceUplink();
+  
+  // A model update, then history answers, use what airtime the readings leave
+  if (_fl.trainingDue()) trainModel();
+  if (_fl.updateReady() && !historyWaits()) serviceModelUpdate();
+  if (_pull.active && !historyWaits()) serviceHistory();
+  
+  // What batched links collected goes out in one request
+  _links.flush();
+  
+  // Small delay to prevent busy-waiting
+  hal::delay(100);
+}
+
+/**
+ * Handle incoming LoRa messages from proof server
+ */
+void SensorNode::handleIncomingMessage() {
+  uint8_t buffer[256];
+  size_t len = _links.receive(buffer, sizeof(buffer));
+  if (len == 0) return;
+  
+  if (buffer[0] != wire::MSG_BUNDLE) {
+    handleMessage(buffer, len);
+    return;
+  }
+  
+  // Downlinks the gateway held for this device, one frame for all
+  size_t offset = 0;
+  const uint8_t* message;
+  size_t messageLen;
+  while (dl::nextInBundle(buffer, len, &offset, &message, &messageLen)) {
+    if (message[0] != wire::MSG_BUNDLE) handleMessage(message, messageLen);
+  }
+}
+
+/**
+ * Act on one downlink message
+ */
+void SensorNode::handleMessage(const uint8_t* buffer, size_t len) {
+  if (len > 0) {
+    // Parse message type
+    uint8_t msgType = buffer[0];
+    
+    switch (msgType) {
+      case 0x01: // Registration acknowledgment
+        Serial.println("📨 Received registration ACK");
+        _braceClient.onAck();
+        _registered = _braceClient.isRegistered();
+        break;
+        
+      case 0x02: // Epoch update
+        if (len >= 5) {
+          _currentEpoch = (buffer[1] << 24) | (buffer[2] << 16) | 
+                         (buffer[3] << 8) | buffer[4];
+          Serial.printf("📨 Epoch updated: %lu\n", (unsigned long)_currentEpoch);
+        }
+        break;
+        
+      case 0x03: // Proof submitted confirmation
+        Serial.println("📨 Proof confirmation received");
+        break;
+        
+      case 0x05: // Echo reply that arrived after the self-test gave up
+        break;
+        
+      case 0x07: // Firmware update offer
+        _ota.onOffer(buffer, len);
+        break;
+        
+      case 0x08: // Firmware update chunk
+        _ota.onChunk(buffer, len);
+        break;
+        
+      case 0x0A: { // Remote settings (unicast or multicast)
+        rcfg::Settings previous = _config.settings();
+        if (_config.onConfig(buffer, len)) applySettings(previous);
+        break;
+      }
+        
+      case 0x0B: { // Time beacon (unicast or broadcast)
+        uint64_t unixMs;
+        if (tsync::parseBeacon(buffer, len, &unixMs)) onTimeBeacon(unixMs);
+        break;
+      }
+        
+      case 0x0C: { // History range query
+        hist::Query query;
+        if (hist::parseQuery(buffer, len, &query)) onHistoryQuery(query);
+        break;
+      }
+        
+      case 0x0E: // Global forecast model (unicast or broadcast)
+        if (_fl.onModel(buffer, len)) Serial.println("📨 Global model received, training");
+        break;
+        
+      case 0x10: { // Registration retry-after (gateway busy)
+        uint32_t seconds;
+        if (reg::parseRetry(buffer, len, &seconds)) _braceClient.onRetryAfter(seconds);
+        break;
+      }
+        
+      default:
+        Serial.printf("📨 Unknown message type: 0x%02X\n", msgType);
+    }
+  }
+}
+
+/**
+ * Advance BRACE registration: send the request when an attempt is due,
+ * back off when the last one went unanswered
+ */
+void SensorNode::attemptRegistration() {
+  if (!_braceClient.poll()) return;
+  
+  _braceClient.getCommitment(_commitment);
+  Serial.printf("\n📤 BRACE registration request sent (attempt %u)\n", _braceClient.attempts());
+  Serial.print("  Commitment: ");
+  for (int i = 0; i < 8; i++) {
+    Serial.printf("%02X", _commitment[i]);
+  }
+  Serial.println("...");
+  // Will be marked registered when ACK received
+}
+
+/**
+ * Sensor cycle due: the first one at its jittered boot time, then every
+ * sample interval
+ */
+bool SensorNode::readingDue(unsigned long now) const {
+  if (_lastReading == 0) return (long)(now - _firstReadingMs) >= 0;
+  return now - _lastReading >= intervalMs();
+}
+
+/**
+ * Collect sensor data and transmit to proof server
+ */
+void SensorNode::collectAndTransmitData() {
+  const rcfg::Settings& settings = _config.settings();
+  Serial.println("\n📊 Collecting sensor data...");
+  
+  SensorData data;
+  if (!readSensors(&data)) {
+    Serial.println("⚠ Sensor read error, using partial data");
+  }
+  
+  Serial.printf("  Temperature: %.1f°C\n", data.temperature);
+  Serial.printf("  Humidity: %.1f%%\n", data.humidity);
+  Serial.printf("  Soil Moisture: %.1f%%\n", data.soilMoisture);
+  Serial.printf("  Pressure: %.1f hPa\n", data.pressure);
+  
+  // Hub probes go into this cycle's reading, whichever way it is sent
+  probe::Reading probes;
+  if (_hub.active()) {
+    _hub.read(&probes);
+    Serial.printf("  Hub probes: %u channels\n", probes.count);
+  }
+  
+  // A reading that trips a rule is this cycle's reading, sent as an alert
+  uint8_t tripped = _alerts.update(settings, data.temperature, data.soilMoisture);
+  if (tripped) {
+    queueReading(Priority::Urgent, data, tripped, &probes);
+    return;
+  }
+  
+  // Readings that raised events are sent whatever the deadbands say
+  if (!_analytics.pending() && withinDeadband(data, probes)) {
+    _suppressed++;
+    Serial.printf("  Within deadband, not sent (%u in a row)\n", _suppressed);
+    return;
+  }
+  queueReading(Priority::Routine, data, 0, &probes);
+  
+  size_t waiting = _uplink.count(Priority::Routine);
+  if (waiting >= settings.batchSize) {
+    _releaseRoutine = true;
+  } else {
+    Serial.printf("  Held for batch (%u/%u)\n", (unsigned)waiting, settings.batchSize);
+  }
+}
+
+/**
+ * Read the sensors between cycles and raise an alert if a rule trips
+ */
+void SensorNode::checkAlerts() {
+  SensorData data;
+  readSensors(&data);
+  uint8_t tripped = _alerts.update(_config.settings(), data.temperature, data.soilMoisture);
+  if (tripped) queueReading(Priority::Urgent, data, tripped);
+}
+
+/**
+ * Read all sensors; channels switched off remotely come back as NaN
+ * (null downstream)
+ */
+bool SensorNode::readSensors(SensorData* data) {
+  const rcfg::Settings& settings = _config.settings();
+  bool ok = _sensors.readAll(data);
+  if (!(settings.sensorMask & rcfg::SENSOR_BME280)) {
+    data->temperature = NAN;
+    data->humidity = NAN;
+    data->pressure = NAN;
+  }
+  if (!(settings.sensorMask & rcfg::SENSOR_SOIL)) data->soilMoisture = NAN;
+  recordHistory(*data);
+  updateAnalytics(*data);
+  return ok;
+}
+
+/**
+ * Feed a reading to the analytics and keep the degree-day total in NVS
+ */
+void SensorNode::updateAnalytics(const SensorData& data) {
+  unsigned long now = hal::millis();
+  uint32_t elapsedS = _analyticsStarted ? (uint32_t)((now - _lastAnalytics) / 1000) : 0;
+  _lastAnalytics = now;
+  _analyticsStarted = true;
+  
+  float previousGdd = _analytics.gdd();
+  uint8_t events = _analytics.update(elapsedS, data.temperature, data.humidity,
+                                     data.soilMoisture);
+  if (events) {
+    char names[16];
+    analytics::formatEvents(events, names, sizeof(names));
+    Serial.printf("🌱 Event: %s (soil %.1f%%, anomaly %.1f σ)\n", names, data.soilMoisture,
+                  _analytics.report().anomalyDeci / 10.0);
+  }
+  // A flash write per whole degree day
+  float gdd = _analytics.gdd();
+  if (floorf(gdd) > floorf(previousGdd)) hal::nvs().put(NVS_GDD_TOTAL, &gdd, sizeof(gdd));
+}
+
+/**
+ * Sign a reading and queue it; alerts carry the rules that tripped, and a
+ * sensor cycle's reading its hub probes
+ */
+void SensorNode::queueReading(Priority priority, const SensorData& data, uint8_t alerts,
+                              const probe::Reading* probes) {
+  if (alerts) {
+    char names[24];
+    alert::formatNames(alerts, names, sizeof(names));
+    Serial.printf("🚨 Alert: %s (%.1f°C, soil %.1f%%)\n", names, data.temperature,
+                  data.soilMoisture);
+  }
+  _suppressed = 0;
+  _lastSent = data;
+  _haveLastSent = true;
+  if (probes) _hubSent = *probes;
+  
+  // Network time once a beacon has been heard; the report says which it is
+  uint32_t now = hal::millis();
+  bool synced = _clock.synced(now);
+  uint32_t timestamp = synced ? (uint32_t)(_clock.now(now) / 1000) : now;
+  
+  uint8_t message[UplinkQueue::ENTRY_MAX];
+  size_t length = buildDataPacket(_secureElement, _commitment, data, _currentEpoch, timestamp,
+                                  message, probes);
+  if (length == 0) return;
+  if (alerts) length += alert::encodeTrailer(alerts, message + length);
+  if (synced) length += tsync::encodeReport(_clock.report(now), message + length);
+  length += analytics::encodeTrailer(_analytics.report(), message + length);
+  float extra[schema::Extra::COUNT];
+  extra[schema::EXTRA_PRESSURE] = data.pressure;
+  length += schema::Extra::encodeTrailer(wire::TRAILER_CHANNELS, extra, message + length);
+  _analytics.clearPending();
+  _uplink.push(priority, message, length);
+}
+
+/**
+ * Whether every reported channel, hub probes included, moved less than
+ * its deadband since the last reading sent, and the heartbeat still
+ * allows skipping one
+ */
+bool SensorNode::withinDeadband(const SensorData& data, const probe::Reading& probes) {
+  const rcfg::Settings& settings = _config.settings();
+  if (!_haveLastSent || _suppressed >= settings.heartbeat) return false;
+  if (probes.count != _hubSent.count) return false;
+  
+  // Deadbands are in hundredths; 0 reports every change
+  auto moved = [](float now, float sent, uint16_t deadband) {
+    if (isnan(now) && isnan(sent)) return false;
+    return !(fabsf(now - sent) * 100.0f < deadband);
+  };
+  if (moved(data.temperature, _lastSent.temperature, settings.deadbandTemperature) ||
+      moved(data.humidity, _lastSent.humidity, settings.deadbandHumidity) ||
+      moved(data.soilMoisture, _lastSent.soilMoisture, settings.deadbandSoil)) {
+    return false;
+  }
+  for (size_t i = 0; i < probes.count; i++) {
+    const probe::Channel& c = probes.channels[i];
+    uint16_t deadband = c.kind == probe::KIND_SOIL ? settings.deadbandSoil
+                        : c.kind == probe::KIND_TEMPERATURE ? settings.deadbandTemperature
+                        : settings.deadbandHumidity;
+    if (moved(c.value, _hubSent.channels[i].value, deadband)) return false;
+  }
+  return true;
+}
+
+/**
+ * Send queued readings, most urgent first, while the airtime budget lasts.
+ * Routine readings leave a quarter of the budget for alerts. Over a link
+ * without a duty cycle the budget does not apply: the queue drains.
+ */
+void SensorNode::serviceUplink() {
+  Priority priority;
+  const uint8_t* message;
+  size_t length;
+  while (_uplink.front(&priority, &message, &length)) {
+    bool urgent = priority == Priority::Urgent;
+    if (!urgent && !_releaseRoutine) return;
+    
+    Transport* link = _links.route(length + REPORT_ITEM_SIZE);
+    if (!link) return;
+    bool metered = link->caps().dutyCycled;
+    uint32_t airtimeUs = uplinkAirtimeUs(priority, length);
+    uint32_t reserveUs = urgent ? 0 : _airtime.capacityUs() / 4;
+    if (metered && !_airtime.allows(airtimeUs, reserveUs, hal::millis())) {
+      if (!urgent && !_deferred) {
+        _deferred = true;
+        _uplink.stats().deferrals++;
+        Serial.printf("⏳ Duty cycle: %u readings wait for airtime\n",
+                      (unsigned)_uplink.count(Priority::Routine));
+      }
+      return;
+    }
+    if (metered) _airtime.charge(airtimeUs);
+    bool sent = transmitQueued(link, priority, message, length);
+    // A reading another link failed on stays for the next one (the failed
+    // link is passed over now); one LoRa failed on is gone
+    if (!sent && !metered && _links.route(length + REPORT_ITEM_SIZE) != link) continue;
+    _uplink.pop();
+    if (!urgent) _deferred = false;
+  }
+  _releaseRoutine = false;
+}
+
+/**
+ * Transmit one queued reading with the settings report in its trailer
+ */
+bool SensorNode::transmitQueued(Transport* link, Priority priority, const uint8_t* message,
+                                size_t length) {
+  const rcfg::Settings& settings = _config.settings();
+  uint8_t out[UplinkQueue::ENTRY_MAX + REPORT_ITEM_SIZE];
+  memcpy(out, message, length);
+  size_t total = length + _config.appendReport(out + length);
+  
+  // Alerts over LoRa may have their own spreading factor and power
+  uint8_t sf = settings.spreadingFactor;
+  uint8_t power = settings.txPowerDbm;
+  if (priority == Priority::Urgent) {
+    if (settings.alertSpreadingFactor) sf = settings.alertSpreadingFactor;
+    if (settings.alertTxPowerDbm) power = settings.alertTxPowerDbm;
+  }
+  bool alertRadio = link == &_loraComm &&
+                    (sf != settings.spreadingFactor || power != settings.txPowerDbm);
+  if (alertRadio) _loraComm.configure(LORA_FREQUENCY, sf, settings.bandwidthKHz, power);
+  
+  const char* via = linkName(link->caps().kind);
+  Serial.printf(priority == Priority::Urgent ? "📤 Transmitting alert (%s)...\n"
+                                             : "📤 Transmitting to proof server (%s)...\n", via);
+  bool sent = _links.send(link, out, total);
+  Serial.println(!sent ? "✗ Transmission failed"
+                 : link->caps().batched ? "✓ Data batched" : "✓ Data transmitted");
+  
+  if (alertRadio) {
+    _loraComm.configure(LORA_FREQUENCY, settings.spreadingFactor, settings.bandwidthKHz,
+                        settings.txPowerDbm);
+  }
+  return sent;
+}
+
+/**
+ * Time on air of a queued reading, with the largest trailer it may gain
+ */
+uint32_t SensorNode::uplinkAirtimeUs(Priority priority, size_t length) const {
+  const rcfg::Settings& settings = _config.settings();
+  uint8_t sf = priority == Priority::Urgent && settings.alertSpreadingFactor
+                   ? settings.alertSpreadingFactor : settings.spreadingFactor;
+  return UplinkQueue::airtimeUs(length + REPORT_ITEM_SIZE, sf, settings.bandwidthKHz);
+}
+
+/**
+ * Alert check interval, 0 when no rule is enabled or checks are off
+ */
+uint32_t SensorNode::alertCheckMs() const {
+  const rcfg::Settings& settings = _config.settings();
+  return settings.alertRules ? settings.alertCheckS * 1000UL : 0;
+}
+
+/**
+ * Put new remote settings into effect
+ */
+void SensorNode::applySettings(const rcfg::Settings& previous) {
+  const rcfg::Settings& settings = _config.settings();
+  if (settings.spreadingFactor != previous.spreadingFactor ||
+      settings.bandwidthKHz != previous.bandwidthKHz ||
+      settings.txPowerDbm != previous.txPowerDbm) {
+    _loraComm.configure(LORA_FREQUENCY, settings.spreadingFactor, settings.bandwidthKHz,
+                        settings.txPowerDbm);
+    Serial.printf("  Radio: SF%u, %u kHz, %u dBm\n", settings.spreadingFactor,
+                  settings.bandwidthKHz, settings.txPowerDbm);
+  }
+  // Held readings go out now rather than wait for a larger batch
+  size_t waiting = _uplink.count(Priority::Routine);
+  if (waiting > 0 && waiting >= settings.batchSize) _releaseRoutine = true;
+  Serial.printf("  Every %lu s, batch %u, sensors 0x%02X, alerts 0x%02X\n",
+                (unsigned long)settings.sampleIntervalS, settings.batchSize, settings.sensorMask,
+                settings.alertRules);
+}
+
+/**
+ * Take gateway time from a beacon and keep the drift estimate in NVS
+ */
+void SensorNode::onTimeBeacon(uint64_t unixMs) {
+  // Stamped as the gateway handed it to its module; heard a time on air later
+  const rcfg::Settings& settings = _config.settings();
+  unixMs += loraTimeOnAirUs(2 * tsync::BEACON_SIZE, settings.spreadingFactor,
+                            settings.bandwidthKHz) / 1000;
+  int32_t previousDrift = _clock.driftPpb();
+  bool wasSynced = _clock.synced(hal::millis());
+  _clock.onBeacon(unixMs, hal::millis());
+  
+  if (wasSynced) {
+    Serial.printf("📨 Time beacon: clock was %+ld ms off, drift %+.1f ppm\n",
+                  (long)_clock.lastErrorMs(), _clock.driftPpb() / 1000.0);
+  } else {
+    Serial.printf("📨 Time synced: %lu\n", (unsigned long)(unixMs / 1000));
+  }
+  // A flash write only when the estimate has moved by a ppm or more
+  int32_t driftPpb = _clock.driftPpb();
+  if (abs(driftPpb - previousDrift) >= 1000) {
+    hal::nvs().put(NVS_CLOCK_DRIFT, &driftPpb, sizeof(driftPpb));
+  }
+}
+
+/**
+ * Keep a reading on flash. Only network time orders the history, so
+ * nothing is kept before the first time beacon.
+ */
+void SensorNode::recordHistory(const SensorData& data) {
+  uint32_t now = hal::millis();
+  if (!_history.mounted() || !_clock.synced(now)) return;
+  hist::Sample sample;
+  sample.time = (uint32_t)(_clock.now(now) / 1000);
+  sample.value[0] = hist::toFixed(data.temperature);
+  sample.value[1] = hist::toFixed(data.humidity);
+  sample.value[2] = hist::toFixed(data.soilMoisture);
+  _history.append(sample);
+}
+
+/**
+ * Start answering a range query; a new one replaces any still running
+ */
+void SensorNode::onHistoryQuery(const hist::Query& query) {
+  _pull.active = true;
+  _pull.query = query;
+  _pull.tier = hist::tierFor(query.resolutionS);
+  _pull.cursor = _history.seek(_pull.tier, query.from);
+  _pull.frames = 0;
+  Serial.printf("📨 History query %u: %lu to %lu, %s\n", query.id, (unsigned long)query.from,
+                (unsigned long)query.to, hist::tierName(_pull.tier));
+}
+
+/**
+ * Send frames of the range query while the airtime budget holds more
+ * than half its capacity (or all of them, over a link without a duty cycle)
+ */
+void SensorNode::serviceHistory() {
+  const rcfg::Settings& settings = _config.settings();
+  while (_pull.active) {
+    Transport* link = _links.route(wire::MAX_FRAME_BYTES);
+    if (!link) return;
+    bool metered = link->caps().dutyCycled;
+    if (metered &&
+        !_airtime.allows(historyFrameAirtimeUs(), _airtime.capacityUs() / 2, hal::millis())) {
+      return;
+    }
+    
+    // As many records as fit; one that does not starts the next frame
+    uint8_t frame[wire::MAX_FRAME_BYTES];
+    hist::ResponseWriter writer(frame, _pull.query.id, _pull.tier, _pull.frames);
+    bool done = false;
+    for (;;) {
+      HistoryStore::Cursor before = _pull.cursor;
+      bool added;
+      if (_pull.tier == hist::Tier::Raw) {
+        hist::Sample sample;
+        done = !_history.next(&_pull.cursor, &sample) || sample.time >= _pull.query.to;
+        added = !done && writer.add(sample);
+      } else {
+        hist::Summary summary;
+        done = !_history.next(&_pull.cursor, &summary) || summary.start >= _pull.query.to;
+        added = !done && writer.add(summary);
+      }
+      if (!added) {
+        if (!done) _pull.cursor = before;
+        break;
+      }
+    }
+    
+    _pull.frames++;
+    uint8_t flags = done ? hist::FLAG_LAST
+                  : _pull.frames >= HISTORY_PULL_FRAMES ? hist::FLAG_TRUNCATED : 0;
+    size_t length = writer.finish(flags);
+    if (metered) {
+      _airtime.charge(UplinkQueue::airtimeUs(length, settings.spreadingFactor,
+                                             settings.bandwidthKHz));
+    }
+    _links.send(link, frame, length);
+    if (flags) {
+      _pull.active = false;
+      Serial.printf("📤 History %u sent in %u frames%s\n", _pull.query.id, _pull.frames,
+                    done ? "" : " (truncated)");
+    }
+  }
+}
+
+/**
+ * Whether readings are ready to go ahead of history frames
+ */
+bool SensorNode::historyWaits() const {
+  return _uplink.count(Priority::Urgent) > 0 || (_releaseRoutine && !_uplink.empty());
+}
+
+/**
+ * Time on air of a full history frame
+ */
+uint32_t SensorNode::historyFrameAirtimeUs() const {
+  const rcfg::Settings& settings = _config.settings();
+  return UplinkQueue::airtimeUs(wire::MAX_FRAME_BYTES, settings.spreadingFactor,
+                                settings.bandwidthKHz);
+}
+
+/**
+ * Train on the stored hourly history; readings since boot count from
+ * the network time, so without it there is nothing to train on
+ */
+void SensorNode::trainModel() {
+  uint32_t now = hal::millis();
+  uint32_t unixNow = _clock.synced(now) ? (uint32_t)(_clock.now(now) / 1000) : 0;
+  _fl.train(_history, unixNow);
+  const fl::Update& update = _fl.update();
+  Serial.printf("🧠 Round %u: %u samples, forecast RMSE %.2f%% -> %.2f%%, %u deltas\n",
+                update.round, update.samples, update.rmseBefore / 100.0,
+                update.rmseAfter / 100.0, update.count);
+}
+
+/**
+ * Send the model update once the budget holds more than half its capacity
+ * (at once, over a link without a duty cycle)
+ */
+void SensorNode::serviceModelUpdate() {
+  const rcfg::Settings& settings = _config.settings();
+  uint8_t frame[wire::MAX_FRAME_BYTES];
+  size_t length = _fl.encodeUpdate(frame);
+  Transport* link = _links.route(length);
+  if (!link) return;
+  uint32_t airtimeUs = UplinkQueue::airtimeUs(length, settings.spreadingFactor,
+                                              settings.bandwidthKHz);
+  if (link->caps().dutyCycled) {
+    if (!_airtime.allows(airtimeUs, _airtime.capacityUs() / 2, hal::millis())) return;
+    _airtime.charge(airtimeUs);
+  }
+  _links.send(link, frame, length);
+  _fl.updateSent();
+  Serial.printf("📤 Model update for round %u sent (%u bytes)\n", _fl.update().round,
+                (unsigned)length);
+}
+
+/**
+ * Nullifier, serialization and signature of one reading
+ */
+size_t SensorNode::buildDataPacket(SecureElement& se, const uint8_t* commitment,
+                                   const SensorData& data, uint32_t epoch, uint32_t timestamp,
+                                   uint8_t* wireBytes, const probe::Reading* probes) {
+  // Create nullifier for this epoch
+  uint8_t nullifier[32];
+  if (!se.computeNullifier(epoch, nullifier)) {
+    Serial.println("✗ Nullifier computation failed");
+    return 0;
+  }
+  
+  // Create data packet
+  DataPacket packet;
+  memcpy(packet.commitment, commitment, 32);
+  packet.temperature = data.temperature;
+  packet.humidity = data.humidity;
+  packet.soilMoisture = data.soilMoisture;
+  packet.timestamp = timestamp;
+  memcpy(packet.nullifier, nullifier, 32);
+  
+  // Sign the serialized packet (everything before the signature) and the
+  // hub probes after it
+  memset(packet.signature, 0, 64);
+  wire::serializeDataPacket(packet, wireBytes);
+  size_t length = wire::DATA_PACKET_SIZE;
+  if (probes) length += probe::encodeTrailer(*probes, wireBytes + length);
+  uint8_t message[probe::SIGNED_MAX];
+  size_t signedLen = probe::signedMessage(wireBytes, length, message);
+  if (!se.sign(message, signedLen, packet.signature)) {
+    Serial.println("✗ Packet signing failed");
+    return 0;
+  }
+  memcpy(wireBytes + wire::DATA_PACKET_SIGNED_SIZE, packet.signature, 64);
+  return length;
+}
+
+/**
+ * Time until loop() next has scheduled work
+ */
+uint32_t SensorNode::msUntilNextReading() {
+  unsigned long now = hal::millis();
+  uint32_t wait;
+  if (!_registered) {
+    wait = _braceClient.msUntilDue();
+  } else if (_lastReading == 0) {
+    wait = readingDue(now) ? 0 : _firstReadingMs - now;
+  } else {
+    unsigned long elapsed = now - _lastReading;
+    wait = elapsed >= intervalMs() ? 0 : intervalMs() - elapsed;
+  }
+  
+  uint32_t checkMs = alertCheckMs();
+  if (_registered && _lastReading != 0 && checkMs > 0) {
+    unsigned long elapsed = now - _lastAlertCheck;
+    uint32_t untilCheck = elapsed >= checkMs ? 0 : checkMs - elapsed;
+    if (untilCheck < wait) wait = untilCheck;
+  }
+  
+  // Queued readings go out as soon as the budget has refilled enough
+  Priority priority;
+  const uint8_t* message;
+  size_t length;
+  if (_uplink.front(&priority, &message, &length) &&
+      (priority == Priority::Urgent || _releaseRoutine)) {
+    uint32_t reserveUs = priority == Priority::Urgent ? 0 : _airtime.capacityUs() / 4;
+    uint32_t untilSend = msUntilSendable(length + REPORT_ITEM_SIZE,
+                                         uplinkAirtimeUs(priority, length), reserveUs, now);
+    if (untilSend < wait) wait = untilSend;
+  }
+  
+  // Training at once; the update and history frames once the budget is
+  // above the reserve they leave
+  if (_fl.trainingDue()) return 0;
+  if (_fl.updateReady() && !historyWaits()) {
+    uint32_t untilSend = msUntilSendable(wire::MAX_FRAME_BYTES, historyFrameAirtimeUs(),
+                                         _airtime.capacityUs() / 2, now);
+    if (untilSend < wait) wait = untilSend;
+  }
+  if (_pull.active && !historyWaits()) {
+    uint32_t untilSend = msUntilSendable(wire::MAX_FRAME_BYTES, historyFrameAirtimeUs(),
+                                         _airtime.capacityUs() / 2, now);
+    if (untilSend < wait) wait = untilSend;
+  }
+  return wait;
+}
+
+/**
+ * Milliseconds until a message can go: at once over a link without a duty
+ * cycle, else once the airtime budget allows it
+ */
+uint32_t SensorNode::msUntilSendable(size_t length, uint32_t airtimeUs, uint32_t reserveUs,
+                                     uint32_t now) {
+  Transport* link = _links.route(length);
+  if (link && !link->caps().dutyCycled) return 0;
+  return _airtime.msUntil(airtimeUs, reserveUs, now);
+}
@@ -6,28 +6,25 @@
 
 #include "sensors.h"
 #include "config.h"
-#include <Adafruit_BME280.h>
+#include "i2c_bus.h"
 
-// BME280 instance
-static Adafruit_BME280 bme;
+// BME280 instance (board peripheral)
+static hal::EnvSensor& bme() { return hal::envSensor(); }
 
 bool Sensors::begin() {
   _bme280Init = false;
   _soilInit = false;
   
-  // Initialize BME280
-  if (bme.begin(0x76) || bme.begin(0x77)) {
+  // Initialize BME280 (forced mode, x1 oversampling, filter off)
+  bool found;
+  {
+    I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_BME280);
+    found = bme().begin(0x76) || bme().begin(0x77);
+    if (!found) bus.fail();
+  }
+  if (found) {
     _bme280Init = true;
     
-    // Configure for weather monitoring
-    bme.setSampling(
-      Adafruit_BME280::MODE_FORCED,
-      Adafruit_BME280::SAMPLING_X1,  // Temperature
-      Adafruit_BME280::SAMPLING_X1,  // Pressure
-      Adafruit_BME280::SAMPLING_X1,  // Humidity
-      Adafruit_BME280::FILTER_OFF
-    );
-    
     if (DEBUG_SENSORS) {
       Serial.println("BME280: Initialized at 0x76/0x77");
     }
@@ -36,7 +33,7 @@ bool Sensors::begin() {
   }
   
   // Initialize soil moisture sensor (ADC)
-  pinMode(SOIL_SENSOR_PIN, INPUT);
+  hal::pinModeInput(SOIL_SENSOR_PIN);
   _soilInit = true;
   
   if (DEBUG_SENSORS) {
@@ -51,15 +48,16 @@ bool Sensors::readAll(SensorData* data) {
   if (!data) return false;
   
   data->valid = false;
-  data->timestamp = millis();
+  data->timestamp = hal::millis();
   
   // Read BME280
   if (_bme280Init) {
-    bme.takeForcedMeasurement();
+    I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_BME280);
+    bme().takeForcedMeasurement();
     
-    data->temperature = bme.readTemperature();
-    data->humidity = bme.readHumidity();
-    data->pressure = bme.readPressure() / 100.0F; // Convert to hPa
+    data->temperature = bme().readTemperature();
+    data->humidity = bme().readHumidity();
+    data->pressure = bme().readPressure() / 100.0F; // Convert to hPa
     
     // Validate readings
     if (data->temperature >= TEMP_MIN && data->temperature <= TEMP_MAX &&
@@ -74,7 +72,7 @@ bool Sensors::readAll(SensorData* data) {
   
   // Read soil moisture
   if (_soilInit) {
-    int rawValue = analogRead(SOIL_SENSOR_PIN);
+    int rawValue = hal::analogRead(SOIL_SENSOR_PIN);
     data->soilMoisture = calibrateSoilReading(rawValue);
   } else {
     data->soilMoisture = 0;
@@ -85,19 +83,21 @@ bool Sensors::readAll(SensorData* data) {
 
 float Sensors::readTemperature() {
   if (!_bme280Init) return 0;
-  bme.takeForcedMeasurement();
-  return bme.readTemperature();
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_BME280);
+  bme().takeForcedMeasurement();
+  return bme().readTemperature();
 }
 
 float Sensors::readHumidity() {
   if (!_bme280Init) return 0;
-  bme.takeForcedMeasurement();
-  return bme.readHumidity();
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_BME280);
+  bme().takeForcedMeasurement();
+  return bme().readHumidity();
 }
 
 float Sensors::readSoilMoisture() {
   if (!_soilInit) return 0;
-  int rawValue = analogRead(SOIL_SENSOR_PIN);
+  int rawValue = hal::analogRead(SOIL_SENSOR_PIN);
   return calibrateSoilReading(rawValue);
 }
 
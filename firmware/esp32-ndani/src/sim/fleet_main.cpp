@@ -0,0 +1,294 @@
+/**
+ * Fleet Simulator Entry Point
+ *
+ * Discrete-event simulation of many Msingi nodes sharing one LoRa channel
+ * and one Freedom Node gateway. Each node is a full SensorNode (LoRaComm,
+ * BraceClient, the main-loop schedule) running on its own simulated board;
+ * the simulator always steps the node with the smallest clock and lets the
+ * channel model decide each frame's fate once every node has passed it.
+ *
+ * Idle loop iterations (nothing in the UART, no cycle due) are skipped in
+ * one jump and charged exactly as the 100 ms polling loop would be, which
+ * keeps hundreds of nodes over days of simulated time tractable.
+ *
+ * Usage: program [--nodes 20,50,100,200,500] [--days D] [--radius-m R]
+ *                [--boot-spread-s S] [--sf-policy fixed|adr] [--seed S]
+ *                [--epoch-hours H] [--path-loss-exp N] [--shared-address]
+ *                [--registrations-per-min N] [--csv FILE]
+ *
+ * --boot-spread-s 0 is a site-wide power cut: every node boots at once.
+ * --registrations-per-min 0 turns the gateway's registration pacing off.
+ */
+
+#ifndef ARDUINO
+
+#include "sim/lora_channel.h"
+#include "sim/sim_args.h"
+#include "sim/sim_board.h"
+#include "config.h"
+#include "sensor_node.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint64_t US_PER_S = 1000000ULL;
+const uint64_t LOOP_PERIOD_US = 100000;   // SensorNode::loop() delay
+const uint64_t LOOP_POLL_US = 87;         // One empty UART poll per iteration
+
+struct FleetNode {
+  FleetNode(uint32_t id, uint64_t seed) : board(id, seed) {}
+  sim::Board board;
+  SensorNode app;
+  bool booted = false;
+  bool stopped = false;
+};
+
+struct Scenario {
+  size_t nodes = 20;
+  double days = 1.0;
+  double radiusM = 3000.0;
+  double bootSpreadS = 1800.0;
+  bool adr = false;
+  bool sharedAddress = false;
+  double epochHours = 24.0;
+  double pathLossExponent = 3.0;
+  uint32_t registrationsPerMin = reg::PACE_PER_MIN;
+  uint64_t seed = 1;
+};
+
+struct Result {
+  size_t nodes = 0;
+  uint32_t sent = 0;
+  uint32_t fate[6] = {0};
+  uint32_t rejected = 0;
+  uint32_t registered = 0;
+  uint32_t registrationsDeferred = 0;
+  uint32_t dataDelivered = 0;
+  double channelUtilisation = 0;
+  double goodputBps = 0;
+  double regLatencyP50 = 0, regLatencyP95 = 0;
+  double dataLatencyP50 = 0, dataLatencyP95 = 0;
+  double mahPerDayP50 = 0, mahPerDayMax = 0;
+  double pdrP5 = 0;   // Worst 5% of nodes
+  double wallSeconds = 0;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t idx = (size_t)llround(p * (values.size() - 1));
+  return values[idx];
+}
+
+/**
+ * Skip idle loop iterations up to a board-local time, charging the same
+ * CPU and radio time the polling loop would have
+ */
+void fastForward(sim::Board& board, uint64_t untilLocalUs) {
+  uint64_t now = board.nowUs();
+  if (untilLocalUs <= now + LOOP_PERIOD_US) return;
+  uint64_t iterations = (untilLocalUs - now) / (LOOP_PERIOD_US + LOOP_POLL_US);
+  if (iterations == 0) return;
+  board.advanceUs(iterations * LOOP_POLL_US, sim::CpuState::Active);
+  board.advanceUs(iterations * LOOP_PERIOD_US, sim::CpuState::Idle);
+}
+
+Result runScenario(const Scenario& sc, FILE* csv) {
+  auto wallStart = std::chrono::steady_clock::now();
+  std::mt19937_64 rng(sc.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  sim::LoRaChannel::Params params;
+  params.gatewayAddress = PROOF_SERVER_LORA_ADDRESS;
+  params.gatewaySpreadingFactor = LORA_SPREADING_FACTOR;
+  params.pathLossExponent = sc.pathLossExponent;
+  params.registrationsPerMin = sc.registrationsPerMin;
+  if (sc.adr) {
+    // Mixed SFs need a gateway that demodulates all of them
+    params.gatewayMultiSf = true;
+    params.gatewayDemodulators = 8;
+  }
+  sim::LoRaChannel channel(params, sc.seed * 7919);
+
+  const uint64_t stopUs = (uint64_t)(sc.days * 86400.0 * US_PER_S);
+  std::vector<std::unique_ptr<FleetNode>> fleet;
+  for (size_t i = 0; i < sc.nodes; i++) {
+    fleet.emplace_back(new FleetNode((uint32_t)i, sc.seed * 1000003ULL + i));
+    sim::Board& board = fleet.back()->board;
+    uint64_t bootAt = (uint64_t)(uniform(rng) * sc.bootSpreadS * US_PER_S);
+    board.setBootAtUs(bootAt);
+    board.setStopAtUs(stopUs > bootAt ? stopUs - bootAt : 0);
+    board.bootHourOfDay = 6.0 + bootAt / 3.6e9;
+    if (!sc.sharedAddress) board.lora().overrideAddress((uint16_t)(LORA_DEVICE_ADDRESS + i));
+
+    // Uniform over the disc, not closer than 50 m
+    double distance = std::max(50.0, sc.radiusM * sqrt(uniform(rng)));
+    size_t node = channel.addNode(&board, distance);
+    if (sc.adr) board.lora().overrideSpreadingFactor(channel.adrSpreadingFactor(node, 10.0));
+  }
+
+  if (sc.epochHours > 0) {
+    uint64_t period = (uint64_t)(sc.epochHours * 3600.0 * US_PER_S);
+    uint32_t epoch = 1;
+    for (uint64_t t = period; t < stopUs; t += period) {
+      channel.scheduleEpochBroadcast(epoch++, t);
+    }
+  }
+
+  // Min-heap on global time
+  typedef std::pair<uint64_t, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+  for (size_t i = 0; i < fleet.size(); i++) ready.push({fleet[i]->board.bootAtUs(), i});
+
+  while (!ready.empty()) {
+    Entry next = ready.top();
+    ready.pop();
+    channel.resolveUntil(next.first);
+
+    FleetNode& fn = *fleet[next.second];
+    sim::Board& board = fn.board;
+    sim::Board::setCurrent(&board);
+    try {
+      if (!fn.booted) {
+        fn.booted = true;
+        fn.app.setup();
+      } else {
+        uint64_t nextRx = board.lora().nextRxUs();
+        if (nextRx > board.nowUs()) {
+          uint64_t target = board.nowUs() + (uint64_t)fn.app.msUntilNextReading() * 1000ULL;
+          target = std::min(target, nextRx);
+          target = std::min(target, board.localUs(channel.horizonUs()));
+          fastForward(board, target);
+        }
+        fn.app.loop();
+      }
+    } catch (const sim::StopSimulation&) {
+      fn.stopped = true;
+    }
+    if (!fn.stopped) ready.push({board.globalUs(), next.second});
+  }
+  channel.resolveUntil(UINT64_MAX);
+
+  // Aggregate
+  Result r;
+  r.nodes = sc.nodes;
+  sim::EnergyProfile profile;
+  std::vector<double> regLatency, dataLatency, mahPerDay, pdr;
+  for (size_t i = 0; i < fleet.size(); i++) {
+    const sim::NodeLinkStats& ls = channel.nodeStats()[i];
+    sim::Board& board = fleet[i]->board;
+    r.sent += ls.framesSent;
+    for (int f = 0; f < 6; f++) r.fate[f] += ls.fate[f];
+    r.rejected += board.lora().stats().rejectedTooLong + board.lora().stats().rejectedOther;
+    r.dataDelivered += ls.dataDelivered;
+    r.registrationsDeferred += ls.registrationsDeferred;
+    if (ls.firstAckUs) {
+      r.registered++;
+      regLatency.push_back((ls.firstAckUs - board.bootAtUs()) / 1e6);
+    }
+    for (uint64_t l : ls.dataLatencyUs) dataLatency.push_back(l / 1e6);
+    double days = board.nowUs() / (86400.0 * US_PER_S);
+    double mah = board.power().energyMah(profile);
+    mahPerDay.push_back(days > 0 ? mah / days : 0);
+    double nodePdr = ls.framesSent ? (double)ls.fate[(int)sim::FrameFate::Delivered] / ls.framesSent : 0;
+    pdr.push_back(nodePdr);
+
+    if (csv) {
+      fprintf(csv, "%zu,%zu,%.0f,%.1f,%u,%u,%u,%u,%u,%u,%u,%u,%.3f,%.2f,%.2f\n",
+              sc.nodes, i, ls.distanceM, ls.meanRssiDbm, ls.spreadingFactor,
+              ls.framesSent, ls.fate[0], ls.fate[1], ls.fate[2],
+              ls.fate[3] + ls.fate[4], ls.downlinksSent, ls.downlinksLost,
+              ls.airtimeUs / 1e6,
+              ls.firstAckUs ? (ls.firstAckUs - board.bootAtUs()) / 1e6 : -1.0,
+              days > 0 ? mah / days : 0);
+    }
+  }
+
+  r.channelUtilisation = (double)(channel.uplinkAirtimeUs() + channel.gatewayAirtimeUs()) / stopUs;
+  r.goodputBps = channel.deliveredPayloadBytes() / (stopUs / 1e6);
+  r.regLatencyP50 = percentile(regLatency, 0.50);
+  r.regLatencyP95 = percentile(regLatency, 0.95);
+  r.dataLatencyP50 = percentile(dataLatency, 0.50);
+  r.dataLatencyP95 = percentile(dataLatency, 0.95);
+  r.mahPerDayP50 = percentile(mahPerDay, 0.50);
+  r.mahPerDayMax = percentile(mahPerDay, 1.0);
+  r.pdrP5 = percentile(pdr, 0.05);
+  r.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  return r;
+}
+
+std::vector<size_t> parseCounts(const char* list) {
+  std::vector<size_t> counts;
+  std::string s(list);
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) comma = s.size();
+    counts.push_back((size_t)atol(s.substr(pos, comma - pos).c_str()));
+    pos = comma + 1;
+  }
+  return counts;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Scenario base;
+  base.days = sim::argDouble(argc, argv, "--days", 1.0);
+  base.radiusM = sim::argDouble(argc, argv, "--radius-m", 3000.0);
+  base.bootSpreadS = sim::argDouble(argc, argv, "--boot-spread-s", SENSOR_INTERVAL_MS / 1000.0);
+  base.adr = strcmp(sim::argValue(argc, argv, "--sf-policy", "fixed"), "adr") == 0;
+  base.sharedAddress = sim::argFlag(argc, argv, "--shared-address");
+  base.epochHours = sim::argDouble(argc, argv, "--epoch-hours", 24.0);
+  base.pathLossExponent = sim::argDouble(argc, argv, "--path-loss-exp", 3.0);
+  base.registrationsPerMin =
+      (uint32_t)sim::argDouble(argc, argv, "--registrations-per-min", reg::PACE_PER_MIN);
+  base.seed = (uint64_t)sim::argDouble(argc, argv, "--seed", 1.0);
+  std::vector<size_t> counts = parseCounts(sim::argValue(argc, argv, "--nodes", "20,50,100,200,500"));
+
+  FILE* csv = nullptr;
+  const char* csvPath = sim::argValue(argc, argv, "--csv", nullptr);
+  if (csvPath) {
+    csv = fopen(csvPath, "w");
+    if (csv) {
+      fprintf(csv, "nodes,node,distance_m,mean_rssi_dbm,sf,frames_sent,delivered,"
+                   "below_sensitivity,collision,gateway_busy_or_tx,downlinks,downlinks_lost,"
+                   "airtime_s,registration_latency_s,mah_per_day\n");
+    }
+  }
+
+  printf("Msingi fleet simulation: %.2f days, radius %.0f m, SF policy %s, %s addresses\n",
+         base.days, base.radiusM, base.adr ? "adr" : "fixed",
+         base.sharedAddress ? "shared" : "per-node");
+  printf("%6s %7s %6s %6s %6s %6s %6s %6s %6s %6s %6s %7s %8s %13s %13s %11s %7s\n",
+         "nodes", "frames", "PDR", "pdr5%", "coll", "sens", "busy", "gw_tx", "rej",
+         "reg", "retry", "util%", "goodput", "reg_lat_p50/95", "data_lat_p50/95", "mAh/d_p50", "wall_s");
+
+  for (size_t n : counts) {
+    Scenario sc = base;
+    sc.nodes = n;
+    Result r = runScenario(sc, csv);
+    double delivered = r.fate[(int)sim::FrameFate::Delivered];
+    printf("%6zu %7u %6.3f %6.3f %6u %6u %6u %6u %6u %6u %6u %7.3f %7.1fB %6.1f/%6.1f %6.2f/%6.2f %11.2f %7.1f\n",
+           r.nodes, r.sent, r.sent ? delivered / r.sent : 0.0, r.pdrP5,
+           r.fate[(int)sim::FrameFate::Collision],
+           r.fate[(int)sim::FrameFate::BelowSensitivity],
+           r.fate[(int)sim::FrameFate::GatewayBusy] + r.fate[(int)sim::FrameFate::WrongSpreadingFactor],
+           r.fate[(int)sim::FrameFate::GatewayTransmitting],
+           r.rejected, r.registered, r.registrationsDeferred, 100.0 * r.channelUtilisation, r.goodputBps,
+           r.regLatencyP50, r.regLatencyP95, r.dataLatencyP50, r.dataLatencyP95,
+           r.mahPerDayP50, r.wallSeconds);
+    fflush(stdout);
+  }
+
+  if (csv) fclose(csv);
+  return 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,621 @@
+/**
+ * Load Generator Entry Point
+ *
+ * Drives the gateway ingest path with traffic from thousands of device
+ * identities. Each identity is a simulated board: its ATECC608B emulator
+ * generates the device key, and its BME280 and soil probe models produce
+ * readings that SensorNode::buildDataPacket() signs, exactly as
+ * the firmware does, before the run starts. During the run, readings are
+ * fragmented (wire::buildFragment) and written as +RCV lines to
+ * pseudo-terminals standing in for RYLR896 modules.
+ *
+ * The program listens on the proof-server socket itself. Every record the
+ * gateway forwards is matched to its reading by (address, seq), which gives
+ * the acceptance latency from the last byte written to the port until the
+ * record arrives. Readings never forwarded are counted as dropped.
+ *
+ * Usage: program [--devices N] [--rate R] [--duration-s S] [--ports P]
+ *                [--uniform] [--burst-every-s S] [--burst-size N] [--baud B]
+ *                [--corrupt P] [--pool N] [--drain-s S] [--seed S]
+ *                [--socket PATH] [--keys-out FILE] [--json]
+ *                [--gateway PROGRAM [--gateway-args "..."]]
+ *
+ * Without --gateway, the PTY paths and socket are printed and the run
+ * starts once a gateway connects.
+ */
+
+#ifndef ARDUINO
+
+#include "sim/sim_args.h"
+#include "sim/sim_board.h"
+#include "config.h"
+#include "sensor_node.h"
+#include "wire_codec.h"
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pty.h>
+#include <random>
+#include <signal.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const uint16_t FIRST_ADDRESS = 100;
+const size_t PORT_READ_MAX = 4096;
+
+// Ways a reading is damaged on its way through a module
+enum class Corruption : uint8_t { None, BitFlip, BadHex, LostFragment, TruncatedLine, Count };
+const char* const CORRUPTION_NAMES[] = {"none", "bit_flip", "bad_hex", "lost_fragment",
+                                        "truncated_line"};
+
+struct Options {
+  size_t devices = 1000;
+  double rate = 500.0;            // Readings per second, all devices together
+  double durationS = 10.0;
+  size_t ports = 1;
+  bool uniform = false;           // Fixed spacing instead of Poisson arrivals
+  double burstEveryS = 0;
+  size_t burstSize = 0;
+  uint32_t baud = 0;              // Pace each port like a UART; 0 = as fast as it drains
+  double corrupt = 0;
+  size_t pool = 4;                // Signed readings prepared per device
+  double drainS = 2.0;
+  uint64_t seed = 1;
+  std::string socketPath;
+  const char* keysOut = nullptr;
+  const char* gateway = nullptr;
+  const char* gatewayArgs = "";
+  bool json = false;
+};
+
+struct Device {
+  uint16_t address;
+  uint16_t seq;
+  size_t port;
+  size_t next = 0;                          // Next pooled reading
+  std::vector<std::array<uint8_t, wire::DATA_PACKET_SIZE>> readings;
+};
+
+// One emulated RYLR896: the master side of a pseudo-terminal
+struct Port {
+  int master = -1;
+  int slave = -1;                           // Held open so the gateway can reopen it
+  std::string path;
+  std::string out;                          // +RCV lines not yet written
+  size_t written = 0;
+  uint64_t totalWritten = 0;                // Bytes ever written
+  uint64_t totalQueued = 0;
+  std::vector<std::pair<uint64_t, uint32_t>> marks;   // (end byte, reading key)
+  size_t markHead = 0;
+  double credit = 0;                        // Bytes the baud rate allows now
+  std::string in;                           // AT commands from the gateway
+};
+
+struct Pending {
+  uint64_t writtenUs = 0;                   // 0 until the last byte is written
+  Corruption corruption = Corruption::None;
+};
+
+struct Report {
+  uint64_t offered = 0;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  uint64_t accepted = 0;
+  uint64_t corrupted[(int)Corruption::Count] = {0};
+  uint64_t corruptAccepted = 0;
+  uint64_t duplicates = 0;
+  uint64_t unmatched = 0;
+  uint64_t atCommands = 0;
+  double sendSeconds = 0;
+  std::vector<double> latencyMs;
+};
+
+uint64_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  return sorted[(size_t)llround(p * (sorted.size() - 1))];
+}
+
+uint32_t readingKey(uint16_t address, uint16_t seq) {
+  return ((uint32_t)address << 16) | seq;
+}
+
+/**
+ * Provision every identity on a simulated board and sign its readings.
+ * Writes "commitment public-key" lines for the gateway's --keys when asked.
+ */
+bool prepareDevices(const Options& opt, std::vector<Device>& devices) {
+  FILE* keys = nullptr;
+  if (opt.keysOut) {
+    keys = fopen(opt.keysOut, "w");
+    if (!keys) {
+      perror(opt.keysOut);
+      return false;
+    }
+    fprintf(keys, "# edgechain load generator, %zu devices, seed %llu\n", opt.devices,
+            (unsigned long long)opt.seed);
+  }
+
+  devices.resize(opt.devices);
+  for (size_t i = 0; i < opt.devices; i++) {
+    sim::Board board((uint32_t)i + 1, opt.seed * 1000003ULL + i);
+    sim::Board::setCurrent(&board);
+    board.bootHourOfDay = (double)(board.rng()() % 24);
+
+    SecureElement se;
+    Sensors sensors;
+    uint8_t publicKey[64], blinding[32], seqSeed[2], commitment[32];
+    if (!se.begin() || !se.generateKey(SLOT_DEVICE_KEY) ||
+        !se.getPublicKey(SLOT_DEVICE_KEY, publicKey) || !se.random(blinding, 32) ||
+        !se.random(seqSeed, 2)) {
+      fprintf(stderr, "loadgen: device %zu: secure element failed\n", i);
+      return false;
+    }
+    // C = H(domain || pk || r), as BraceClient::computeCommitment()
+    uint8_t preimage[128] = {0};
+    memcpy(preimage, COMMITMENT_DOMAIN, strlen(COMMITMENT_DOMAIN));
+    memcpy(preimage + 32, publicKey, 64);
+    memcpy(preimage + 96, blinding, 32);
+    se.sha256(preimage, sizeof(preimage), commitment);
+    sensors.begin();
+
+    Device& device = devices[i];
+    device.address = (uint16_t)(FIRST_ADDRESS + i);
+    device.seq = (uint16_t)(seqSeed[0] | (seqSeed[1] << 8));
+    device.port = i % opt.ports;
+    device.readings.resize(opt.pool);
+    for (size_t k = 0; k < opt.pool; k++) {
+      board.advanceUs((uint64_t)SENSOR_INTERVAL_MS * 1000ULL, sim::CpuState::DeepSleep);
+      SensorData data;
+      sensors.readAll(&data);
+      if (!SensorNode::buildDataPacket(se, commitment, data, 1, hal::millis(),
+                                       device.readings[k].data())) {
+        fprintf(stderr, "loadgen: device %zu: signing failed\n", i);
+        return false;
+      }
+    }
+
+    if (keys) {
+      char commitmentHex[65], keyHex[129];
+      wire::hexEncode(commitment, 32, commitmentHex);
+      wire::hexEncode(publicKey, 64, keyHex);
+      fprintf(keys, "%s %s\n", commitmentHex, keyHex);
+    }
+  }
+  sim::Board::setCurrent(nullptr);
+  if (keys) fclose(keys);
+  return true;
+}
+
+bool openPort(Port& port) {
+  if (openpty(&port.master, &port.slave, nullptr, nullptr, nullptr) != 0) {
+    perror("openpty");
+    return false;
+  }
+  // No echo or CR/LF translation on the device side until the gateway sets it
+  struct termios tio;
+  tcgetattr(port.slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(port.slave, TCSANOW, &tio);
+  fcntl(port.master, F_SETFL, fcntl(port.master, F_GETFL) | O_NONBLOCK);
+  port.path = ttyname(port.slave);
+  return true;
+}
+
+void appendRcv(std::string& out, uint16_t address, const uint8_t* frame, size_t length,
+               int rssi, int snr) {
+  char line[wire::RCV_LINE_MAX];
+  int n = snprintf(line, sizeof(line), "+RCV=%u,%zu,", address, 2 * length);
+  n += (int)wire::hexEncode(frame, length, line + n);
+  n += snprintf(line + n, sizeof(line) - (size_t)n, ",%d,%d\r\n", rssi, snr);
+  out.append(line, (size_t)n);
+}
+
+/**
+ * Queue one reading from a device on its port, damaged as requested
+ */
+void queueReading(Device& device, Port& port, Corruption corruption, std::mt19937_64& rng,
+                  std::unordered_map<uint32_t, Pending>& pending, Report& report) {
+  uint8_t packet[wire::DATA_PACKET_SIZE];
+  memcpy(packet, device.readings[device.next].data(), sizeof(packet));
+  device.next = (device.next + 1) % device.readings.size();
+  uint16_t seq = device.seq++;
+  if (corruption == Corruption::BitFlip) packet[rng() % sizeof(packet)] ^= (uint8_t)(1u << (rng() % 8));
+
+  int rssi = -70 - (int)(rng() % 50);
+  int snr = 10 - (int)(rng() % 20);
+  size_t count = wire::fragmentCount(sizeof(packet));
+  size_t victim = rng() % count;
+  for (size_t i = 0; i < count; i++) {
+    if (corruption == Corruption::LostFragment && i == victim) continue;
+    uint8_t frame[wire::MAX_FRAME_BYTES];
+    size_t length = wire::buildFragment(packet, sizeof(packet), seq, (uint8_t)i, frame);
+    size_t start = port.out.size();
+    appendRcv(port.out, device.address, frame, length, rssi, snr);
+    size_t lineLen = port.out.size() - start;
+    if (i == victim && corruption == Corruption::BadHex) {
+      // A character inside the data field that is not hex
+      port.out[port.out.find(',', port.out.find(',', start) + 1) + 1 + rng() % (2 * length)] = 'G';
+    } else if (i == victim && corruption == Corruption::TruncatedLine) {
+      port.out.erase(start + lineLen / 2, lineLen - lineLen / 2 - 2);
+    }
+    report.frames++;
+  }
+
+  uint32_t key = readingKey(device.address, seq);
+  pending[key].corruption = corruption;
+  pending[key].writtenUs = 0;
+  port.totalQueued = port.totalWritten + (port.out.size() - port.written);
+  port.marks.push_back(std::make_pair(port.totalQueued, key));
+  report.offered++;
+  if (corruption != Corruption::None) report.corrupted[(int)corruption]++;
+}
+
+/**
+ * Write what the port's pacing allows; stamp readings whose last byte went out
+ */
+void writePort(Port& port, double elapsedS, uint32_t baud,
+               std::unordered_map<uint32_t, Pending>& pending, Report& report) {
+  size_t waiting = port.out.size() - port.written;
+  if (baud) {
+    // 10 bits per byte on the wire; at most one second of credit
+    port.credit = std::min(port.credit + elapsedS * baud / 10.0, baud / 10.0);
+    waiting = std::min(waiting, (size_t)port.credit);
+  }
+  while (waiting > 0) {
+    ssize_t n = write(port.master, port.out.data() + port.written, waiting);
+    if (n <= 0) break;
+    port.written += (size_t)n;
+    port.totalWritten += (uint64_t)n;
+    report.bytes += (uint64_t)n;
+    if (baud) port.credit -= (double)n;
+    waiting -= (size_t)n;
+  }
+  if (port.written == port.out.size()) {
+    port.out.clear();
+    port.written = 0;
+  } else if (port.written > (1u << 20)) {
+    port.out.erase(0, port.written);
+    port.written = 0;
+  }
+
+  uint64_t now = nowUs();
+  while (port.markHead < port.marks.size() && port.marks[port.markHead].first <= port.totalWritten) {
+    auto it = pending.find(port.marks[port.markHead].second);
+    if (it != pending.end()) it->second.writtenUs = now;
+    port.markHead++;
+  }
+  if (port.markHead == port.marks.size()) {
+    port.marks.clear();
+    port.markHead = 0;
+  }
+}
+
+/**
+ * Answer AT commands (configuration, downlinks) the way the module does
+ */
+void servicePortInput(Port& port, Report& report) {
+  char buffer[PORT_READ_MAX];
+  ssize_t n;
+  while ((n = read(port.master, buffer, sizeof(buffer))) > 0) port.in.append(buffer, (size_t)n);
+  size_t newline;
+  while ((newline = port.in.find('\n')) != std::string::npos) {
+    if (port.in.compare(0, 2, "AT") == 0) {
+      report.atCommands++;
+      port.out.append("+OK\r\n");
+    }
+    port.in.erase(0, newline + 1);
+  }
+}
+
+// Integer value after "key": in a flat JSON record
+bool jsonNumber(const std::string& line, const char* key, unsigned long long* value) {
+  std::string pattern = std::string("\"") + key + "\":";
+  size_t at = line.find(pattern);
+  if (at == std::string::npos) return false;
+  *value = strtoull(line.c_str() + at + pattern.size(), nullptr, 10);
+  return true;
+}
+
+/**
+ * Match forwarded records to readings. Journal offsets are acked at once.
+ */
+bool serviceSocket(int conn, std::string& in, std::unordered_map<uint32_t, Pending>& pending,
+                   Report& report) {
+  char buffer[65536];
+  ssize_t n;
+  while ((n = read(conn, buffer, sizeof(buffer))) > 0) in.append(buffer, (size_t)n);
+  if (n == 0) return false;
+
+  uint64_t now = nowUs();
+  long long ackNext = -1;
+  size_t start = 0, newline;
+  while ((newline = in.find('\n', start)) != std::string::npos) {
+    std::string line = in.substr(start, newline - start);
+    start = newline + 1;
+    if (line.find("\"type\":\"reading\"") == std::string::npos) continue;
+
+    unsigned long long address, seq, offset;
+    if (jsonNumber(line, "offset", &offset)) ackNext = (long long)offset + 1;
+    if (!jsonNumber(line, "address", &address) || !jsonNumber(line, "seq", &seq)) {
+      report.unmatched++;
+      continue;
+    }
+    auto it = pending.find(readingKey((uint16_t)address, (uint16_t)seq));
+    if (it == pending.end()) {
+      // Already matched (a replay) or not ours
+      report.duplicates++;
+      continue;
+    }
+    if (it->second.corruption != Corruption::None) {
+      report.corruptAccepted++;
+    } else {
+      report.accepted++;
+      uint64_t written = it->second.writtenUs ? it->second.writtenUs : now;
+      report.latencyMs.push_back((now - written) / 1000.0);
+    }
+    pending.erase(it);
+  }
+  in.erase(0, start);
+
+  if (ackNext >= 0) {
+    char ack[64];
+    int len = snprintf(ack, sizeof(ack), "{\"type\":\"ack\",\"next\":%lld}\n", ackNext);
+    if (write(conn, ack, (size_t)len) < 0) return false;
+  }
+  return true;
+}
+
+pid_t spawnGateway(const Options& opt, const std::vector<Port>& ports) {
+  std::vector<std::string> args = {opt.gateway, "--no-configure", "--socket", opt.socketPath,
+                                   "--stats-interval-s", "0"};
+  for (const Port& port : ports) {
+    args.push_back("--port");
+    args.push_back(port.path);
+  }
+  std::string extra = opt.gatewayArgs;
+  for (size_t pos = 0; pos < extra.size();) {
+    size_t space = extra.find(' ', pos);
+    if (space == std::string::npos) space = extra.size();
+    if (space > pos) args.push_back(extra.substr(pos, space - pos));
+    pos = space + 1;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    std::vector<char*> argv;
+    for (std::string& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    perror(opt.gateway);
+    _exit(127);
+  }
+  return pid;
+}
+
+void printReport(const Options& opt, Report& r, size_t dropped) {
+  std::sort(r.latencyMs.begin(), r.latencyMs.end());
+  uint64_t corrupted = 0;
+  for (int k = 1; k < (int)Corruption::Count; k++) corrupted += r.corrupted[k];
+  uint64_t clean = r.offered - corrupted;
+  double achieved = r.sendSeconds > 0 ? r.offered / r.sendSeconds : 0;
+
+  if (opt.json) {
+    printf("{\"devices\":%zu,\"ports\":%zu,\"target_rate\":%.1f,\"offered\":%llu,"
+           "\"achieved_rate\":%.1f,\"frames\":%llu,\"bytes\":%llu,\"accepted\":%llu,"
+           "\"dropped\":%zu,\"corrupted\":%llu,\"corrupt_accepted\":%llu,\"duplicates\":%llu,"
+           "\"latency_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}}\n",
+           opt.devices, opt.ports, opt.rate, (unsigned long long)r.offered, achieved,
+           (unsigned long long)r.frames, (unsigned long long)r.bytes,
+           (unsigned long long)r.accepted, dropped, (unsigned long long)corrupted,
+           (unsigned long long)r.corruptAccepted, (unsigned long long)r.duplicates,
+           percentile(r.latencyMs, 0.50), percentile(r.latencyMs, 0.90),
+           percentile(r.latencyMs, 0.99), percentile(r.latencyMs, 0.999),
+           percentile(r.latencyMs, 1.0));
+    return;
+  }
+
+  printf("Offered %llu readings (%llu frames, %.1f MB) in %.2f s: %.0f/s (target %.0f/s",
+         (unsigned long long)r.offered, (unsigned long long)r.frames, r.bytes / 1e6,
+         r.sendSeconds, achieved, opt.rate);
+  if (opt.burstSize > 0 && opt.burstEveryS > 0) {
+    printf(" plus %zu every %.1f s", opt.burstSize, opt.burstEveryS);
+  }
+  printf(")\n");
+  printf("Accepted %llu of %llu clean readings, dropped %zu (%.3f%%)\n",
+         (unsigned long long)r.accepted, (unsigned long long)clean, dropped,
+         clean ? 100.0 * dropped / clean : 0.0);
+  printf("Latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+         percentile(r.latencyMs, 0.50), percentile(r.latencyMs, 0.90),
+         percentile(r.latencyMs, 0.99), percentile(r.latencyMs, 0.999),
+         percentile(r.latencyMs, 1.0));
+  if (corrupted) {
+    printf("Corrupted %llu:", (unsigned long long)corrupted);
+    for (int k = 1; k < (int)Corruption::Count; k++) {
+      printf(" %s %llu", CORRUPTION_NAMES[k], (unsigned long long)r.corrupted[k]);
+    }
+    printf(" | forwarded anyway %llu\n", (unsigned long long)r.corruptAccepted);
+  }
+  if (r.duplicates || r.unmatched) {
+    printf("Duplicate records %llu, unmatched %llu\n", (unsigned long long)r.duplicates,
+           (unsigned long long)r.unmatched);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  opt.devices = (size_t)sim::argDouble(argc, argv, "--devices", 1000);
+  opt.rate = sim::argDouble(argc, argv, "--rate", 500);
+  opt.durationS = sim::argDouble(argc, argv, "--duration-s", 10);
+  opt.ports = std::max((size_t)1, (size_t)sim::argDouble(argc, argv, "--ports", 1));
+  opt.uniform = sim::argFlag(argc, argv, "--uniform");
+  opt.burstEveryS = sim::argDouble(argc, argv, "--burst-every-s", 0);
+  opt.burstSize = (size_t)sim::argDouble(argc, argv, "--burst-size", 0);
+  opt.baud = (uint32_t)sim::argDouble(argc, argv, "--baud", 0);
+  opt.corrupt = sim::argDouble(argc, argv, "--corrupt", 0);
+  opt.pool = std::max((size_t)1, (size_t)sim::argDouble(argc, argv, "--pool", 4));
+  opt.drainS = sim::argDouble(argc, argv, "--drain-s", 2);
+  opt.seed = (uint64_t)sim::argDouble(argc, argv, "--seed", 1);
+  opt.keysOut = sim::argValue(argc, argv, "--keys-out", nullptr);
+  opt.gateway = sim::argValue(argc, argv, "--gateway", nullptr);
+  opt.gatewayArgs = sim::argValue(argc, argv, "--gateway-args", "");
+  opt.json = sim::argFlag(argc, argv, "--json");
+  opt.socketPath = sim::argValue(argc, argv, "--socket", "");
+  if (opt.socketPath.empty()) {
+    opt.socketPath = "/tmp/edgechain-loadgen-" + std::to_string(getpid()) + ".sock";
+  }
+  if (opt.devices == 0 || opt.devices > 65535u - FIRST_ADDRESS) {
+    fprintf(stderr, "loadgen: --devices must be 1..%u\n", 65535u - FIRST_ADDRESS);
+    return 2;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  uint64_t prepStart = nowUs();
+  std::vector<Device> devices;
+  if (!prepareDevices(opt, devices)) return 1;
+  fprintf(stderr, "loadgen: %zu devices, %zu signed readings in %.1f s\n", opt.devices,
+          opt.devices * opt.pool, (nowUs() - prepStart) / 1e6);
+
+  std::vector<Port> ports(opt.ports);
+  for (Port& port : ports) {
+    if (!openPort(port)) return 1;
+  }
+
+  // Stand in for the proof server
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (opt.socketPath.size() >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "loadgen: socket path too long\n");
+    return 2;
+  }
+  memcpy(addr.sun_path, opt.socketPath.c_str(), opt.socketPath.size());
+  unlink(opt.socketPath.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0) {
+    perror(opt.socketPath.c_str());
+    return 1;
+  }
+
+  pid_t gatewayPid = -1;
+  if (opt.gateway) {
+    gatewayPid = spawnGateway(opt, ports);
+  } else {
+    fprintf(stderr, "loadgen: waiting for a gateway on %s, ports:", opt.socketPath.c_str());
+    for (const Port& port : ports) fprintf(stderr, " %s", port.path.c_str());
+    fprintf(stderr, "\n");
+  }
+  int conn = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (conn < 0) {
+    perror("accept");
+    return 1;
+  }
+
+  std::mt19937_64 rng(opt.seed);
+  std::exponential_distribution<double> interArrival(opt.rate > 0 ? opt.rate : 1.0);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::unordered_map<uint32_t, Pending> pending;
+  Report report;
+  std::string socketIn;
+
+  uint64_t startUs = nowUs();
+  uint64_t endUs = startUs + (uint64_t)(opt.durationS * 1e6);
+  double nextArrivalS = 0;
+  double nextBurstS = opt.burstEveryS > 0 ? opt.burstEveryS : INFINITY;
+  uint64_t lastUs = startUs;
+  uint64_t drainUntilUs = 0;
+  bool connected = true;
+
+  auto pickCorruption = [&]() {
+    if (opt.corrupt <= 0 || unit(rng) >= opt.corrupt) return Corruption::None;
+    return (Corruption)(1 + rng() % ((int)Corruption::Count - 1));
+  };
+  auto queue = [&](Device& device) {
+    queueReading(device, ports[device.port], pickCorruption(), rng, pending, report);
+  };
+
+  while (connected) {
+    uint64_t now = nowUs();
+    double t = (now - startUs) / 1e6;
+    bool sending = now < endUs && opt.rate > 0;
+
+    if (sending) {
+      while (nextArrivalS <= t) {
+        queue(devices[rng() % devices.size()]);
+        nextArrivalS += opt.uniform ? 1.0 / opt.rate : interArrival(rng);
+      }
+      while (nextBurstS <= t) {
+        // Backfill: a batch of stored readings arriving back to back
+        for (size_t i = 0; i < opt.burstSize; i++) queue(devices[rng() % devices.size()]);
+        nextBurstS += opt.burstEveryS;
+      }
+    }
+
+    bool unsent = false;
+    for (Port& port : ports) {
+      writePort(port, (now - lastUs) / 1e6, opt.baud, pending, report);
+      unsent |= port.written < port.out.size();
+    }
+    lastUs = now;
+
+    if (!sending && drainUntilUs == 0 && !unsent) {
+      report.sendSeconds = (now - startUs) / 1e6;
+      drainUntilUs = now + (uint64_t)(opt.drainS * 1e6);
+    }
+    if (drainUntilUs && (now >= drainUntilUs || pending.empty())) break;
+
+    std::vector<struct pollfd> fds;
+    fds.push_back({conn, POLLIN, 0});
+    for (Port& port : ports) {
+      short events = POLLIN;
+      if (port.written < port.out.size() && !opt.baud) events |= POLLOUT;
+      fds.push_back({port.master, events, 0});
+    }
+    int timeoutMs = 1;
+    if (!sending && !unsent) timeoutMs = 10;
+    if (poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR) break;
+
+    if (fds[0].revents) connected = serviceSocket(conn, socketIn, pending, report);
+    for (size_t i = 0; i < ports.size(); i++) {
+      if (fds[i + 1].revents & POLLIN) servicePortInput(ports[i], report);
+    }
+  }
+
+  if (!connected) fprintf(stderr, "loadgen: gateway disconnected\n");
+  size_t dropped = 0;
+  for (const auto& p : pending) {
+    if (p.second.corruption == Corruption::None) dropped++;
+  }
+  printReport(opt, report, dropped);
+
+  if (gatewayPid > 0) {
+    kill(gatewayPid, SIGTERM);
+    waitpid(gatewayPid, nullptr, 0);
+  }
+  close(conn);
+  close(listener);
+  unlink(opt.socketPath.c_str());
+  return 0;
+}
+
+#endif // !ARDUINO
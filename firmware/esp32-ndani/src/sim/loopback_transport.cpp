@@ -0,0 +1,50 @@
+/**
+ * Loopback Transport Implementation
+ */
+
+#ifndef ARDUINO
+
+#include "sim/loopback_transport.h"
+#include <string.h>
+
+namespace sim {
+
+void LoopbackTransport::inject(const uint8_t* message, size_t length) {
+  _rx.emplace_back((const char*)message, length);
+}
+
+bool LoopbackTransport::transmit(const uint8_t* data, size_t length) {
+  if (!ready() || length > linkCaps.mtu) {
+    _stats.refused++;
+    return false;
+  }
+  _batch.emplace_back((const char*)data, length);
+  return linkCaps.batched || flush();
+}
+
+bool LoopbackTransport::flush() {
+  if (_batch.empty()) return true;
+  if (!ready()) return false;
+  _stats.batches++;
+  while (!_batch.empty()) {
+    std::string message = std::move(_batch.front());
+    _batch.pop_front();
+    _stats.messages++;
+    _stats.bytes += message.size();
+    if (_handler) _handler((const uint8_t*)message.data(), message.size());
+  }
+  return true;
+}
+
+size_t LoopbackTransport::receive(uint8_t* buffer, size_t maxLen) {
+  if (_rx.empty()) return 0;
+  size_t length = _rx.front().size() < maxLen ? _rx.front().size() : maxLen;
+  memcpy(buffer, _rx.front().data(), length);
+  _rx.pop_front();
+  _stats.downlinks++;
+  return length;
+}
+
+} // namespace sim
+
+#endif // !ARDUINO
@@ -0,0 +1,374 @@
+/**
+ * Shared LoRa Channel Model Implementation
+ */
+
+#ifndef ARDUINO
+
+#include "sim/lora_channel.h"
+#include "lora_airtime.h"
+#include <algorithm>
+#include <math.h>
+
+namespace sim {
+
+// Frames are kept this long after they end so later frames can still be
+// checked for overlap against them
+static const uint64_t FRAME_RETENTION_US = 30ULL * 1000000ULL;
+static const uint64_t ECHO_TURNAROUND_US = 20000;
+
+const char* frameFateName(FrameFate fate) {
+  switch (fate) {
+    case FrameFate::Delivered: return "delivered";
+    case FrameFate::BelowSensitivity: return "below_sensitivity";
+    case FrameFate::Collision: return "collision";
+    case FrameFate::GatewayBusy: return "gateway_busy";
+    case FrameFate::GatewayTransmitting: return "gateway_tx";
+    case FrameFate::WrongSpreadingFactor: return "wrong_sf";
+  }
+  return "unknown";
+}
+
+double loraSensitivityDbm(uint8_t sf, uint16_t bandwidthKHz) {
+  // SX1276 datasheet, 125 kHz
+  static const double table[6] = {-123.0, -126.0, -129.0, -132.0, -134.5, -137.0};
+  double s = table[std::min<int>(std::max<int>(sf, 7), 12) - 7];
+  return s + 10.0 * log10(bandwidthKHz / 125.0);
+}
+
+double loraRequiredSnrDb(uint8_t sf) {
+  return -7.5 - 2.5 * (std::min<int>(std::max<int>(sf, 7), 12) - 7);
+}
+
+double loraSirThresholdDb(uint8_t sfWanted, uint8_t sfInterferer, double captureDb) {
+  if (sfWanted == sfInterferer) return captureDb;
+  static const double table[6][6] = {
+    //  7     8     9    10    11    12   (interferer)
+    {   0,   -8,   -9,   -9,   -9,   -9 },  // SF7 wanted
+    { -11,    0,  -11,  -12,  -13,  -13 },  // SF8
+    { -15,  -13,    0,  -13,  -14,  -15 },  // SF9
+    { -19,  -18,  -17,    0,  -17,  -18 },  // SF10
+    { -22,  -22,  -21,  -20,    0,  -20 },  // SF11
+    { -25,  -25,  -25,  -24,  -23,    0 },  // SF12
+  };
+  int w = std::min<int>(std::max<int>(sfWanted, 7), 12) - 7;
+  int i = std::min<int>(std::max<int>(sfInterferer, 7), 12) - 7;
+  return table[w][i];
+}
+
+LoRaChannel::LoRaChannel(const Params& params, uint64_t seed)
+    : _params(params), _rng(seed),
+      _pacer(params.registrationsPerMin, params.registrationBurst) {
+  int demods = params.gatewayMultiSf ? std::max(params.gatewayDemodulators, 1) : 1;
+  _demodBusyUntil.assign((size_t)demods, 0);
+}
+
+size_t LoRaChannel::addNode(Board* board, double distanceM) {
+  _boards.push_back(board);
+  _shadowingDb.push_back(_params.shadowingSigmaDb * _normal(_rng));
+  NodeLinkStats stats;
+  stats.distanceM = distanceM;
+  _nodeStats.push_back(stats);
+  size_t node = _boards.size() - 1;
+  _nodeStats[node].meanRssiDbm = meanRssiDbm(node);
+  board->lora().setMedium(this);
+  return node;
+}
+
+double LoRaChannel::pathLossDb(size_t node) const {
+  double d = std::max(_nodeStats[node].distanceM, 1.0);
+  return _params.pathLossD0Db +
+         10.0 * _params.pathLossExponent * log10(d / _params.d0M) +
+         _shadowingDb[node];
+}
+
+double LoRaChannel::meanRssiDbm(size_t node) const {
+  return 20.0 + _params.antennaGainDb - pathLossDb(node);
+}
+
+double LoRaChannel::noiseFloorDbm(uint16_t bandwidthKHz) const {
+  return -174.0 + 10.0 * log10(bandwidthKHz * 1000.0) + _params.noiseFigureDb;
+}
+
+uint8_t LoRaChannel::adrSpreadingFactor(size_t node, double marginDb) const {
+  double rssi = meanRssiDbm(node);
+  for (uint8_t sf = 7; sf <= 12; sf++) {
+    if (rssi - loraSensitivityDbm(sf, 125) >= marginDb) return sf;
+  }
+  return 12;
+}
+
+void LoRaChannel::transmit(Board& from, const RadioFrame& frame) {
+  size_t node = from.id();
+
+  PendingFrame pf;
+  pf.frame = frame;
+  pf.node = node;
+  pf.rssiDbm = frame.txPowerDbm + _params.antennaGainDb - pathLossDb(node) +
+               _params.fadingSigmaDb * _normal(_rng);
+
+  NodeLinkStats& stats = _nodeStats[node];
+  stats.framesSent++;
+  stats.spreadingFactor = frame.spreadingFactor;
+  stats.airtimeUs += frame.endUs - frame.startUs;
+  _uplinkAirtimeUs += frame.endUs - frame.startUs;
+
+  // Unresolved frames stay sorted by start time
+  auto first = _frames.begin() + (long)_resolved;
+  auto pos = std::upper_bound(first, _frames.end(), frame.startUs,
+      [](uint64_t t, const PendingFrame& f) { return t < f.frame.startUs; });
+  _frames.insert(pos, pf);
+}
+
+bool LoRaChannel::gatewayTransmittingDuring(uint64_t startUs, uint64_t endUs) const {
+  for (auto it = _downlinks.rbegin(); it != _downlinks.rend(); ++it) {
+    if (it->endUs <= startUs) break;
+    if (it->startUs < endUs) return true;
+  }
+  return false;
+}
+
+void LoRaChannel::decide(PendingFrame& pf) {
+  const RadioFrame& f = pf.frame;
+
+  if (!_params.gatewayMultiSf && f.spreadingFactor != _params.gatewaySpreadingFactor) {
+    pf.fate = FrameFate::WrongSpreadingFactor;
+    return;
+  }
+
+  double snr = pf.rssiDbm - noiseFloorDbm(f.bandwidthKHz);
+  if (pf.rssiDbm < loraSensitivityDbm(f.spreadingFactor, f.bandwidthKHz) ||
+      snr < loraRequiredSnrDb(f.spreadingFactor)) {
+    pf.fate = FrameFate::BelowSensitivity;
+    return;
+  }
+
+  if (gatewayTransmittingDuring(f.startUs, f.endUs)) {
+    pf.fate = FrameFate::GatewayTransmitting;
+    return;
+  }
+
+  // A demodulator stays locked for the whole frame, even if it is
+  // corrupted later
+  auto demod = std::find_if(_demodBusyUntil.begin(), _demodBusyUntil.end(),
+                            [&](uint64_t busy) { return busy <= f.startUs; });
+  if (demod == _demodBusyUntil.end()) {
+    pf.fate = FrameFate::GatewayBusy;
+    return;
+  }
+  *demod = f.endUs;
+  pf.locked = true;
+
+  for (const PendingFrame& other : _frames) {
+    if (&other == &pf) continue;
+    if (other.frame.startUs >= f.endUs) break;
+    if (other.frame.endUs <= f.startUs) continue;
+    double sir = pf.rssiDbm - other.rssiDbm;
+    if (sir < loraSirThresholdDb(f.spreadingFactor, other.frame.spreadingFactor,
+                                 _params.captureThresholdDb)) {
+      pf.fate = FrameFate::Collision;
+      return;
+    }
+  }
+
+  pf.fate = FrameFate::Delivered;
+}
+
+void LoRaChannel::resolveUntil(uint64_t globalUs) {
+  for (;;) {
+    bool frameDue = _resolved < _frames.size() && _frames[_resolved].frame.endUs <= globalUs;
+    bool broadcastDue = !_broadcasts.empty() && _broadcasts.front().atUs <= globalUs;
+    if (!frameDue && !broadcastDue) break;
+
+    // Keep gateway activity in time order
+    if (broadcastDue &&
+        (!frameDue || _broadcasts.front().atUs <= _frames[_resolved].frame.startUs)) {
+      sendBroadcast(_broadcasts.front());
+      _broadcasts.pop_front();
+      continue;
+    }
+
+    PendingFrame& pf = _frames[_resolved];
+    decide(pf);
+    _nodeStats[pf.node].fate[(int)pf.fate]++;
+    if (pf.fate == FrameFate::Delivered) onDelivered(pf);
+    _resolved++;
+  }
+
+  prune(globalUs);
+}
+
+void LoRaChannel::sendBroadcast(const Broadcast& broadcast) {
+  char hex[11];
+  snprintf(hex, sizeof(hex), "02%08X", broadcast.epoch);
+
+  // A multi-SF gateway repeats the broadcast once per SF in use
+  std::vector<uint8_t> sfs;
+  for (size_t n = 0; n < _boards.size(); n++) {
+    uint8_t sf = downlinkSpreadingFactor(n);
+    if (std::find(sfs.begin(), sfs.end(), sf) == sfs.end()) sfs.push_back(sf);
+  }
+  std::sort(sfs.begin(), sfs.end());
+
+  for (uint8_t sf : sfs) {
+    uint64_t start = sendDownlink(broadcast.atUs, 10, sf);
+    uint64_t end = start + loraTimeOnAirUs(10, sf, 125);
+    for (size_t n = 0; n < _boards.size(); n++) {
+      if (downlinkSpreadingFactor(n) == sf) deliverDownlink(n, hex, start, end, sf);
+    }
+  }
+}
+
+uint8_t LoRaChannel::downlinkSpreadingFactor(size_t node) const {
+  if (!_params.gatewayMultiSf) return _params.gatewaySpreadingFactor;
+  return _boards[node]->lora().spreadingFactor();
+}
+
+void LoRaChannel::onDelivered(PendingFrame& pf) {
+  const RadioFrame& f = pf.frame;
+  uint8_t frame[wire::MAX_FRAME_BYTES];
+  size_t bytes = wire::hexDecode(f.payload.data(), f.payload.size(), frame, sizeof(frame));
+  _deliveredBytes += bytes;
+
+  if (bytes > 0 && frame[0] == wire::MSG_FRAGMENT) {
+    uint8_t message[wire::MESSAGE_MAX];
+    uint16_t seq;
+    size_t length = _reassembler.add(f.srcAddress, frame, bytes, (uint32_t)(f.endUs / 1000),
+                                     message, &seq);
+    if (length > 0) onMessage(pf, message, length);
+    return;
+  }
+  onMessage(pf, frame, bytes);
+}
+
+void LoRaChannel::onMessage(PendingFrame& pf, const uint8_t* message, size_t length) {
+  const RadioFrame& f = pf.frame;
+  NodeLinkStats& stats = _nodeStats[pf.node];
+  uint8_t type = length > 0 ? message[0] : 0xFF;
+
+  if (type == wire::MSG_REGISTRATION && length == wire::REGISTRATION_SIZE) {
+    stats.registrationsDelivered++;
+    uint8_t sf = downlinkSpreadingFactor(pf.node);
+    uint32_t retryS = _pacer.onRegistration(f.srcAddress, f.endUs / 1000);
+    if (retryS > 0) {
+      // Over the admission rate: the gateway answers at once with a slot
+      stats.registrationsDeferred++;
+      uint8_t reply[reg::RETRY_SIZE];
+      char hex[2 * reg::RETRY_SIZE + 1];
+      wire::hexEncode(reply, reg::encodeRetry(retryS, reply), hex);
+      uint64_t start = sendDownlink(f.endUs + ECHO_TURNAROUND_US, 2 * reg::RETRY_SIZE, sf);
+      uint64_t end = start + loraTimeOnAirUs(2 * reg::RETRY_SIZE, sf, 125);
+      deliverDownlink(pf.node, hex, start, end, sf);
+      return;
+    }
+    // ACK to the sender's address after the server turnaround, on its SF
+    uint64_t start = sendDownlink(f.endUs + _params.ackTurnaroundUs, 2, sf);
+    uint64_t end = start + loraTimeOnAirUs(2, sf, 125);
+    for (size_t n = 0; n < _boards.size(); n++) {
+      if (_boards[n]->lora().address() == f.srcAddress) {
+        deliverDownlink(n, "01", start, end, sf);
+      }
+    }
+  } else if (type == wire::MSG_ECHO_REQUEST && length >= 2 && !wire::isReading(message, length)) {
+    // Echo: the gateway answers at once with the RSSI/SNR it measured
+    int rssi = (int)lround(pf.rssiDbm);
+    int snr = (int)lround(pf.rssiDbm - noiseFloorDbm(f.bandwidthKHz));
+    uint8_t reply[4] = {wire::MSG_ECHO_REPLY, message[1],
+                        (uint8_t)(int8_t)std::max(-128, rssi),
+                        (uint8_t)(int8_t)std::min(127, snr)};
+    char hex[9];
+    wire::hexEncode(reply, sizeof(reply), hex);
+    uint8_t sf = downlinkSpreadingFactor(pf.node);
+    uint64_t start = sendDownlink(f.endUs + ECHO_TURNAROUND_US, 8, sf);
+    uint64_t end = start + loraTimeOnAirUs(8, sf, 125);
+    deliverDownlink(pf.node, hex, start, end, sf);
+  } else if (wire::isReading(message, length)) {
+    stats.dataDelivered++;
+    DataPacket packet;
+    wire::parseDataPacket(message, wire::DATA_PACKET_SIZE, &packet);
+    uint64_t createdUs = _boards[pf.node]->bootAtUs() + (uint64_t)packet.timestamp * 1000ULL;
+    if (f.endUs > createdUs) stats.dataLatencyUs.push_back(f.endUs - createdUs);
+  }
+}
+
+uint64_t LoRaChannel::sendDownlink(uint64_t earliestUs, size_t payloadChars,
+                                   uint8_t spreadingFactor) {
+  uint64_t start = std::max(earliestUs, _gatewayFreeUs);
+  // Never schedule into the past of frames that are already final
+  if (_resolved > 0) start = std::max(start, _frames[_resolved - 1].frame.endUs);
+  uint64_t end = start + loraTimeOnAirUs(payloadChars, spreadingFactor, 125);
+  _downlinks.push_back({start, end});
+  _gatewayFreeUs = end;
+  _gatewayAirtimeUs += end - start;
+  return start;
+}
+
+void LoRaChannel::deliverDownlink(size_t node, const std::string& payload,
+                                  uint64_t startUs, uint64_t endUs,
+                                  uint8_t spreadingFactor) {
+  Board* board = _boards[node];
+  NodeLinkStats& stats = _nodeStats[node];
+  stats.downlinksSent++;
+
+  double rssi = _params.gatewayTxPowerDbm + _params.antennaGainDb - pathLossDb(node) +
+                _params.fadingSigmaDb * _normal(_rng);
+  double snr = rssi - noiseFloorDbm(125);
+  uint8_t nodeSf = stats.spreadingFactor ? stats.spreadingFactor : board->lora().spreadingFactor();
+
+  bool lost = nodeSf != spreadingFactor ||
+              rssi < loraSensitivityDbm(nodeSf, 125) ||
+              snr < loraRequiredSnrDb(nodeSf) ||
+              endUs < board->bootAtUs();
+
+  // Half-duplex: the node cannot hear the gateway while it transmits
+  for (const PendingFrame& f : _frames) {
+    if (lost) break;
+    if (f.node == node && f.frame.startUs < endUs && f.frame.endUs > startUs) lost = true;
+  }
+
+  if (lost) {
+    stats.downlinksLost++;
+    return;
+  }
+
+  if (payload == "01" && stats.firstAckUs == 0) stats.firstAckUs = endUs;
+  board->lora().deliverFrame(_params.gatewayAddress, payload, (int)lround(rssi),
+                             (int)lround(snr), board->localUs(endUs));
+}
+
+void LoRaChannel::scheduleEpochBroadcast(uint32_t epoch, uint64_t atUs) {
+  Broadcast b = {atUs, epoch};
+  auto pos = std::upper_bound(_broadcasts.begin(), _broadcasts.end(), atUs,
+      [](uint64_t t, const Broadcast& x) { return t < x.atUs; });
+  _broadcasts.insert(pos, b);
+}
+
+uint64_t LoRaChannel::horizonUs() const {
+  uint64_t horizon = UINT64_MAX;
+  if (_resolved < _frames.size()) {
+    uint64_t earliestEnd = UINT64_MAX;
+    for (size_t i = _resolved; i < _frames.size(); i++) {
+      earliestEnd = std::min(earliestEnd, _frames[i].frame.endUs);
+    }
+    // Room for the turnaround and a short downlink
+    horizon = earliestEnd + _params.ackTurnaroundUs;
+  }
+  if (!_broadcasts.empty()) horizon = std::min(horizon, _broadcasts.front().atUs);
+  return horizon;
+}
+
+void LoRaChannel::prune(uint64_t globalUs) {
+  if (globalUs < FRAME_RETENTION_US) return;
+  uint64_t cutoff = globalUs - FRAME_RETENTION_US;
+  while (_resolved > 0 && _frames.front().frame.endUs < cutoff) {
+    _frames.pop_front();
+    _resolved--;
+  }
+  while (!_downlinks.empty() && _downlinks.front().endUs < cutoff) {
+    _downlinks.pop_front();
+  }
+  _reassembler.expire((uint32_t)(globalUs / 1000), (uint32_t)(FRAME_RETENTION_US / 1000));
+}
+
+} // namespace sim
+
+#endif // !ARDUINO
@@ -0,0 +1,272 @@
+/**
+ * Secure Element Emulator
+ *
+ * Native-build implementation of SecureElement backed by OpenSSL.
+ * Key material lives in the active board's AteccModel and every command
+ * charges the ATECC608B execution time plus its I2C transfer to the
+ * virtual clock, so awake-time and energy figures stay realistic.
+ */
+
+#ifndef ARDUINO
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "secure_element.h"
+#include "config.h"
+#include "i2c_bus.h"
+#include "sim/sim_board.h"
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/obj_mac.h>
+#include <openssl/sha.h>
+
+namespace {
+
+sim::AteccModel& chip() {
+  return sim::Board::current().atecc();
+}
+
+// Charge one ATECC command: request, execution, response
+void command(size_t bytesIn, uint32_t execUs, size_t bytesOut) {
+  sim::Board& board = sim::Board::current();
+  board.i2cTransfer(bytesIn + 7);
+  board.advanceUs(execUs);
+  board.i2cTransfer(bytesOut + 3);
+  board.atecc().commands++;
+}
+
+const EC_GROUP* p256() {
+  static EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+  return group;
+}
+
+EC_KEY* keyFromPrivate(const uint8_t priv[32]) {
+  EC_KEY* key = EC_KEY_new();
+  EC_KEY_set_group(key, p256());
+  BIGNUM* d = BN_bin2bn(priv, 32, nullptr);
+  EC_POINT* pub = EC_POINT_new(p256());
+  EC_POINT_mul(p256(), pub, d, nullptr, nullptr, nullptr);
+  EC_KEY_set_private_key(key, d);
+  EC_KEY_set_public_key(key, pub);
+  EC_POINT_free(pub);
+  BN_free(d);
+  return key;
+}
+
+EC_KEY* keyFromPublic(const uint8_t pub[64]) {
+  uint8_t encoded[65];
+  encoded[0] = 0x04;
+  memcpy(encoded + 1, pub, 64);
+  EC_KEY* key = EC_KEY_new();
+  EC_KEY_set_group(key, p256());
+  EC_POINT* point = EC_POINT_new(p256());
+  bool ok = EC_POINT_oct2point(p256(), point, encoded, sizeof(encoded), nullptr) == 1 &&
+            EC_KEY_set_public_key(key, point) == 1;
+  EC_POINT_free(point);
+  if (!ok) {
+    EC_KEY_free(key);
+    return nullptr;
+  }
+  return key;
+}
+
+void exportPublic(EC_KEY* key, uint8_t pub[64]) {
+  uint8_t encoded[65];
+  EC_POINT_point2oct(p256(), EC_KEY_get0_public_key(key),
+                     POINT_CONVERSION_UNCOMPRESSED, encoded, sizeof(encoded), nullptr);
+  memcpy(pub, encoded + 1, 64);
+}
+
+} // namespace
+
+bool SecureElement::begin() {
+  if (_initialized) return true;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  sim::AteccModel& atecc = chip();
+  command(0, sim::atecc_timing::WAKE_US, 4);
+  if (!atecc.present) {
+    bus.fail();
+    Serial.println("ATECC608B: begin() failed");
+    return false;
+  }
+
+  Serial.print("ATECC608B Serial: ");
+  for (int i = 0; i < 9; i++) {
+    Serial.printf("%02X", atecc.serial[i]);
+  }
+  Serial.println();
+
+  _initialized = true;
+  return true;
+}
+
+bool SecureElement::isKeyProvisioned(uint8_t slot) {
+  if (!_initialized) return false;
+
+  uint8_t pubKey[64];
+  return getPublicKey(slot, pubKey);
+}
+
+bool SecureElement::generateKey(uint8_t slot) {
+  if (!_initialized || slot >= 16) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  sim::AteccModel& atecc = chip();
+  command(3, sim::atecc_timing::GENKEY_US, 64);
+
+  // Private scalar drawn from the chip RNG, reduced into [1, n-1]
+  uint8_t seed[32];
+  for (int i = 0; i < 32; i++) seed[i] = (uint8_t)(atecc.rng() & 0xFF);
+  BIGNUM* d = BN_bin2bn(seed, 32, nullptr);
+  BIGNUM* nMinusOne = BN_dup(EC_GROUP_get0_order(p256()));
+  BN_sub_word(nMinusOne, 1);
+  BN_CTX* ctx = BN_CTX_new();
+  BN_nnmod(d, d, nMinusOne, ctx);
+  BN_add_word(d, 1);
+  BN_bn2binpad(d, atecc.slotPrivate[slot], 32);
+  BN_CTX_free(ctx);
+  BN_free(nMinusOne);
+  BN_free(d);
+
+  EC_KEY* key = keyFromPrivate(atecc.slotPrivate[slot]);
+  exportPublic(key, atecc.slotPublic[slot]);
+  EC_KEY_free(key);
+  atecc.slotProvisioned[slot] = true;
+
+  Serial.printf("ATECC608B: Key generated in slot %d\n", slot);
+  return true;
+}
+
+bool SecureElement::getPublicKey(uint8_t slot, uint8_t* publicKey) {
+  if (!_initialized || slot >= 16) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  sim::AteccModel& atecc = chip();
+  command(3, sim::atecc_timing::GENKEY_US, 64);
+  if (!atecc.slotProvisioned[slot]) return false;
+
+  memcpy(publicKey, atecc.slotPublic[slot], 64);
+  return true;
+}
+
+bool SecureElement::sign(const uint8_t* data, size_t dataLen, uint8_t* signature) {
+  if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  uint8_t hash[32];
+  if (!sha256(data, dataLen, hash)) {
+    return false;
+  }
+
+  sim::AteccModel& atecc = chip();
+  command(32, sim::atecc_timing::SIGN_US, 64);
+  if (!atecc.slotProvisioned[SLOT_DEVICE_KEY]) {
+    Serial.println("ATECC608B: createSignature() failed");
+    return false;
+  }
+
+  EC_KEY* key = keyFromPrivate(atecc.slotPrivate[SLOT_DEVICE_KEY]);
+  ECDSA_SIG* sig = ECDSA_do_sign(hash, 32, key);
+  EC_KEY_free(key);
+  if (!sig) return false;
+
+  const BIGNUM* r = nullptr;
+  const BIGNUM* s = nullptr;
+  ECDSA_SIG_get0(sig, &r, &s);
+  BN_bn2binpad(r, signature, 32);
+  BN_bn2binpad(s, signature + 32, 32);
+  ECDSA_SIG_free(sig);
+  return true;
+}
+
+bool SecureElement::verify(const uint8_t* publicKey, const uint8_t* data,
+                           size_t dataLen, const uint8_t* signature) {
+  if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  uint8_t hash[32];
+  if (!sha256(data, dataLen, hash)) {
+    return false;
+  }
+
+  command(64 + 64 + 32, sim::atecc_timing::VERIFY_US, 1);
+
+  EC_KEY* key = keyFromPublic(publicKey);
+  if (!key) return false;
+
+  ECDSA_SIG* sig = ECDSA_SIG_new();
+  ECDSA_SIG_set0(sig, BN_bin2bn(signature, 32, nullptr),
+                 BN_bin2bn(signature + 32, 32, nullptr));
+  bool valid = ECDSA_do_verify(hash, 32, sig, key) == 1;
+  ECDSA_SIG_free(sig);
+  EC_KEY_free(key);
+  return valid;
+}
+
+bool SecureElement::computeNullifier(uint32_t epoch, uint8_t* nullifier) {
+  if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  // Same message layout as the ATECC implementation: domain || epoch (BE)
+  uint8_t message[64];
+  memset(message, 0, sizeof(message));
+  const char* domain = NULLIFIER_DOMAIN;
+  size_t domainLen = strlen(domain);
+  memcpy(message, domain, domainLen);
+  message[domainLen + 0] = (epoch >> 24) & 0xFF;
+  message[domainLen + 1] = (epoch >> 16) & 0xFF;
+  message[domainLen + 2] = (epoch >> 8) & 0xFF;
+  message[domainLen + 3] = (epoch >> 0) & 0xFF;
+
+  sim::AteccModel& atecc = chip();
+  command(domainLen + 4, sim::atecc_timing::MAC_US, 32);
+
+  unsigned int macLen = 0;
+  HMAC(EVP_sha256(), atecc.macSecret, sizeof(atecc.macSecret),
+       message, domainLen + 4, nullifier, &macLen);
+  return macLen == 32;
+}
+
+bool SecureElement::random(uint8_t* buffer, size_t length) {
+  if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  sim::AteccModel& atecc = chip();
+  size_t remaining = length;
+  uint8_t* ptr = buffer;
+
+  // 32 random bytes per command
+  while (remaining > 0) {
+    command(20, sim::atecc_timing::RANDOM_US, 32);
+    size_t toCopy = (remaining < 32) ? remaining : 32;
+    for (size_t i = 0; i < toCopy; i++) {
+      ptr[i] = (uint8_t)(atecc.rng() & 0xFF);
+    }
+    ptr += toCopy;
+    remaining -= toCopy;
+  }
+
+  return true;
+}
+
+bool SecureElement::sha256(const uint8_t* data, size_t dataLen, uint8_t* hash) {
+  if (!_initialized) return false;
+  I2cBus::Transaction bus(hal::i2cBus(), I2cBus::DEVICE_ATECC);
+
+  // Start, one update per 64-byte block, end
+  command(0, sim::atecc_timing::SHA_US, 1);
+  for (size_t off = 0; off < dataLen; off += 64) {
+    size_t chunk = dataLen - off < 64 ? dataLen - off : 64;
+    command(chunk, sim::atecc_timing::SHA_US, 1);
+  }
+  command(0, sim::atecc_timing::SHA_US, 32);
+
+  SHA256(data, dataLen, hash);
+  return true;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,692 @@
+/**
+ * Simulated Board Implementation
+ *
+ * Virtual clock, power accounting, peripheral models and the native
+ * implementation of the hal:: functions.
+ */
+
+#ifndef ARDUINO
+
+#include "sim/sim_board.h"
+#include "config.h"
+#include "lora_airtime.h"
+#include <math.h>
+#include <stdarg.h>
+
+namespace sim {
+
+static Board* activeBoard = nullptr;
+
+// UART poll cost: one character time at 115200 baud
+static const uint64_t UART_POLL_US = 87;
+
+// ============= POWER =============
+
+double PowerStats::energyMah(const EnergyProfile& p) const {
+  // mA * us -> mAh
+  const double usPerHour = 3600.0 * 1e6;
+  double mAus = cpuActiveUs * p.cpuActiveMa + cpuIdleUs * p.cpuIdleMa +
+                deepSleepUs * p.deepSleepMa + radioTxUs * p.loraTxMa +
+                radioRxUs * p.loraRxMa;
+  return mAus / usPerHour;
+}
+
+// ============= MEMORY =============
+
+size_t MemoryModel::capacity(hal::MemRegion region) const {
+  switch (region) {
+    case hal::MemRegion::Psram: return psramPresent ? PSRAM_BYTES : 0;
+    case hal::MemRegion::Rtc: return RTC_ARENA_BYTES;
+    default: return SIZE_MAX;
+  }
+}
+
+void* MemoryModel::alloc(hal::MemRegion region, size_t bytes) {
+  size_t& used = _used[(size_t)region];
+  if (bytes > capacity(region) - used) return nullptr;
+  used += bytes;
+  _blocks.emplace_back(bytes, 0);
+  return _blocks.back().data();
+}
+
+bool MemoryModel::info(hal::MemRegion region, hal::HeapInfo* info) const {
+  if (region == hal::MemRegion::Internal || capacity(region) == 0) return false;
+  info->totalBytes = capacity(region);
+  info->freeBytes = capacity(region) - _used[(size_t)region];
+  info->largestFreeBlock = info->freeBytes;
+  info->minFreeBytes = info->freeBytes;
+  return true;
+}
+
+// ============= BOARD =============
+
+Board::Board(uint32_t id, uint64_t seed)
+    : _id(id), _rng(seed), _lora(*this), _env(*this), _flash(*this), _dataFlash(*this) {
+  _atecc.rng.seed(seed ^ 0xA7ECC608ULL);
+  _atecc.serial[0] = 0x01;
+  _atecc.serial[1] = 0x23;
+  for (int i = 2; i < 9; i++) {
+    _atecc.serial[i] = (uint8_t)(_atecc.rng() & 0xFF);
+  }
+  for (int i = 0; i < 32; i++) {
+    _atecc.macSecret[i] = (uint8_t)(_atecc.rng() & 0xFF);
+  }
+}
+
+Board& Board::current() {
+  return *activeBoard;
+}
+
+void Board::setCurrent(Board* board) {
+  activeBoard = board;
+}
+
+void Board::advanceUs(uint64_t us, CpuState state) {
+  if (_nowUs >= _stopAtUs) throw StopSimulation();
+
+  uint64_t start = _nowUs;
+  uint64_t end = start + us;
+  if (end > _stopAtUs) end = _stopAtUs;
+  uint64_t span = end - start;
+
+  switch (state) {
+    case CpuState::Active: _power.cpuActiveUs += span; break;
+    case CpuState::Idle: _power.cpuIdleUs += span; break;
+    case CpuState::DeepSleep: _power.deepSleepUs += span; break;
+  }
+
+  // The RYLR896 is receiving whenever it is not transmitting
+  uint64_t tx = 0;
+  if (_radioTxUntilUs > start) {
+    tx = (_radioTxUntilUs < end ? _radioTxUntilUs : end) - start;
+  }
+  _power.radioTxUs += tx;
+  _power.radioRxUs += span - tx;
+
+  _nowUs = end;
+}
+
+void Board::i2cTransfer(size_t bytes) {
+  // Address + payload + stop, 9 clocks per byte
+  uint64_t bits = (uint64_t)(bytes + 2) * 9;
+  advanceUs(bits * 1000000ULL / _i2cClockHz);
+}
+
+void Board::consoleWrite(const char* text, size_t length) {
+  if (!_console) return;
+  for (size_t i = 0; i < length; i++) {
+    if (_lineStart) {
+      uint64_t ms = _nowUs / 1000;
+      fprintf(_console, "[n%03u d%02llu %02llu:%02llu:%02llu.%03llu] ", _id,
+              (unsigned long long)(ms / 86400000ULL),
+              (unsigned long long)(ms / 3600000ULL % 24),
+              (unsigned long long)(ms / 60000ULL % 60),
+              (unsigned long long)(ms / 1000ULL % 60),
+              (unsigned long long)(ms % 1000ULL));
+      _lineStart = false;
+    }
+    fputc(text[i], _console);
+    if (text[i] == '\n') _lineStart = true;
+  }
+}
+
+// ============= FLASH =============
+
+const std::vector<uint8_t>& FlashModel::runningImage() {
+  if (_running.empty()) {
+    // Same synthetic build on every board: words from a fixed generator
+    std::mt19937 words(0x4D53494EU);
+    _running.resize(256 * 1024);
+    for (size_t i = 0; i < _running.size(); i += 4) {
+      uint32_t w = words();
+      memcpy(&_running[i], &w, 4);
+    }
+  }
+  return _running;
+}
+
+bool FlashModel::readRunning(size_t offset, uint8_t* data, size_t length) {
+  const std::vector<uint8_t>& image = runningImage();
+  if (offset > image.size() || length > image.size() - offset) return false;
+  memcpy(data, image.data() + offset, length);
+  return true;
+}
+
+bool FlashModel::eraseUpdate(size_t offset, size_t length) {
+  if (offset % SECTOR_SIZE || length % SECTOR_SIZE || offset + length > PARTITION_SIZE) {
+    return false;
+  }
+  for (size_t sector = offset / SECTOR_SIZE; sector < (offset + length) / SECTOR_SIZE; sector++) {
+    _sectors[sector].assign(SECTOR_SIZE, 0xFF);
+    sectorsErased++;
+    _board.advanceUs(flash_timing::SECTOR_ERASE_US);
+  }
+  return true;
+}
+
+bool FlashModel::writeUpdate(size_t offset, const uint8_t* data, size_t length) {
+  if (offset + length > PARTITION_SIZE) return false;
+  for (size_t i = 0; i < length; i++) {
+    std::vector<uint8_t>& sector = _sectors[(offset + i) / SECTOR_SIZE];
+    if (sector.empty()) sector.assign(SECTOR_SIZE, 0xFF);
+    sector[(offset + i) % SECTOR_SIZE] &= data[i];   // NOR flash: bits only clear
+  }
+  bytesWritten += length;
+  _board.advanceUs((length + 255) / 256 * flash_timing::PAGE_PROGRAM_US);
+  return true;
+}
+
+bool FlashModel::readUpdate(size_t offset, uint8_t* data, size_t length) {
+  if (offset + length > PARTITION_SIZE) return false;
+  for (size_t i = 0; i < length; i++) {
+    auto sector = _sectors.find((offset + i) / SECTOR_SIZE);
+    data[i] = sector == _sectors.end() ? 0xFF : sector->second[(offset + i) % SECTOR_SIZE];
+  }
+  return true;
+}
+
+bool FlashModel::activateUpdate(size_t length) {
+  if (length == 0 || length > PARTITION_SIZE) return false;
+  _activatedLength = length;
+  return true;
+}
+
+void FlashModel::reboot() {
+  if (_activatedLength == 0) return;
+  std::vector<uint8_t> image(_activatedLength);
+  readUpdate(0, image.data(), image.size());
+  // The old image becomes the inactive partition
+  std::vector<uint8_t> old = runningImage();
+  _sectors.clear();
+  for (size_t offset = 0; offset < old.size(); offset += SECTOR_SIZE) {
+    size_t n = old.size() - offset < SECTOR_SIZE ? old.size() - offset : SECTOR_SIZE;
+    std::vector<uint8_t>& sector = _sectors[offset / SECTOR_SIZE];
+    sector.assign(SECTOR_SIZE, 0xFF);
+    memcpy(sector.data(), old.data() + offset, n);
+  }
+  _running.swap(image);
+  _activatedLength = 0;
+  imageSwaps++;
+}
+
+bool DataFlashModel::erase(size_t offset, size_t length) {
+  if (offset % SECTOR_SIZE || length % SECTOR_SIZE || offset + length > PARTITION_SIZE) {
+    return false;
+  }
+  for (size_t sector = offset / SECTOR_SIZE; sector < (offset + length) / SECTOR_SIZE; sector++) {
+    _sectors[sector].assign(SECTOR_SIZE, 0xFF);
+    sectorsErased++;
+    _board.advanceUs(flash_timing::SECTOR_ERASE_US);
+  }
+  return true;
+}
+
+bool DataFlashModel::write(size_t offset, const uint8_t* data, size_t length) {
+  if (offset + length > PARTITION_SIZE) return false;
+  for (size_t i = 0; i < length; i++) {
+    std::vector<uint8_t>& sector = _sectors[(offset + i) / SECTOR_SIZE];
+    if (sector.empty()) sector.assign(SECTOR_SIZE, 0xFF);
+    sector[(offset + i) % SECTOR_SIZE] &= data[i];   // NOR flash: bits only clear
+  }
+  bytesWritten += length;
+  _board.advanceUs((length + 255) / 256 * flash_timing::PAGE_PROGRAM_US);
+  return true;
+}
+
+bool DataFlashModel::read(size_t offset, uint8_t* data, size_t length) {
+  if (offset + length > PARTITION_SIZE) return false;
+  // Sector at a time: queries read many small records
+  while (length > 0) {
+    size_t within = offset % SECTOR_SIZE;
+    size_t n = SECTOR_SIZE - within < length ? SECTOR_SIZE - within : length;
+    auto sector = _sectors.find(offset / SECTOR_SIZE);
+    if (sector == _sectors.end()) {
+      memset(data, 0xFF, n);
+    } else {
+      memcpy(data, sector->second.data() + within, n);
+    }
+    offset += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+// ============= NVS =============
+
+size_t NvsModel::get(const char* key, void* data, size_t maxLength) {
+  auto record = _records.find(key);
+  if (record == _records.end() || record->second.size() > maxLength) return 0;
+  memcpy(data, record->second.data(), record->second.size());
+  return record->second.size();
+}
+
+bool NvsModel::put(const char* key, const void* data, size_t length) {
+  if (strlen(key) > KEY_MAX) return false;
+  const uint8_t* bytes = (const uint8_t*)data;
+  _records[key].assign(bytes, bytes + length);
+  writes++;
+  return true;
+}
+
+// ============= RYLR896 =============
+
+void Rylr896Model::begin(uint32_t baud, int rxPin, int txPin) {
+  (void)baud; (void)rxPin; (void)txPin;
+  _command.clear();
+}
+
+int Rylr896Model::available() {
+  int ready = 0;
+  uint64_t now = _board.nowUs();
+  bool head = true;
+  for (const auto& entry : _rx) {
+    if (entry.first > now) break;
+    ready += (int)entry.second.size() - (head ? (int)_rxOffset : 0);
+    head = false;
+  }
+  if (ready == 0) {
+    // Polling an empty UART still costs CPU time; this is also what lets
+    // time move inside the firmware's busy-wait loops.
+    _board.advanceUs(UART_POLL_US);
+  }
+  return ready;
+}
+
+int Rylr896Model::read() {
+  if (_rx.empty() || _rx.begin()->first > _board.nowUs()) return -1;
+  auto head = _rx.begin();
+  int c = (uint8_t)head->second[_rxOffset++];
+  if (_rxOffset >= head->second.size()) {
+    _rx.erase(head);
+    _rxOffset = 0;
+  }
+  return c;
+}
+
+size_t Rylr896Model::write(const uint8_t* data, size_t length) {
+  // 10 bits per byte on the wire at 115200 baud
+  _board.advanceUs(length * 87);
+  for (size_t i = 0; i < length; i++) {
+    char c = (char)data[i];
+    if (c == '\n') {
+      if (!_command.empty() && _command.back() == '\r') _command.pop_back();
+      handleCommand(_command);
+      _command.clear();
+    } else {
+      _command.push_back(c);
+    }
+  }
+  return length;
+}
+
+void Rylr896Model::deliver(const std::string& line, uint64_t atUs) {
+  _rx.emplace(atUs, line);
+}
+
+void Rylr896Model::deliverFrame(uint16_t fromAddress, const std::string& payload,
+                                int rssi, int snr, uint64_t atUs) {
+  char header[32];
+  snprintf(header, sizeof(header), "+RCV=%u,%zu,", fromAddress, payload.size());
+  char trailer[24];
+  snprintf(trailer, sizeof(trailer), ",%d,%d\r\n", rssi, snr);
+  _stats.framesReceived++;
+  deliver(std::string(header) + payload + trailer, atUs);
+}
+
+void Rylr896Model::reply(const char* line, uint64_t atUs) {
+  deliver(std::string(line) + "\r\n", atUs);
+}
+
+void Rylr896Model::handleCommand(const std::string& cmd) {
+  uint64_t now = _board.nowUs();
+  // Command processing inside the module
+  uint64_t readyAt = now + 2000;
+
+  if (cmd.compare(0, 2, "AT") != 0) {
+    reply("+ERR=2", readyAt);
+    return;
+  }
+  if (cmd == "AT") {
+    reply("+OK", readyAt);
+    return;
+  }
+  if (cmd.compare(0, 8, "AT+SEND=") == 0) {
+    handleSend(cmd.substr(8));
+    return;
+  }
+
+  size_t eq = cmd.find('=');
+  std::string name = cmd.substr(0, eq);
+  std::string value = eq == std::string::npos ? "" : cmd.substr(eq + 1);
+
+  if (name == "AT+BAND") {
+    _frequency = (uint32_t)strtoul(value.c_str(), nullptr, 10);
+  } else if (name == "AT+PARAMETER") {
+    int sf = 0, bw = 0, cr = 0, pre = 0;
+    if (sscanf(value.c_str(), "%d,%d,%d,%d", &sf, &bw, &cr, &pre) != 4 ||
+        sf < 7 || sf > 12 || bw < 7 || bw > 9 || cr < 1 || cr > 4) {
+      reply("+ERR=4", readyAt);
+      return;
+    }
+    _sf = (uint8_t)sf;
+    _bwKHz = bw == 9 ? 500 : (bw == 8 ? 250 : 125);
+    _cr = (uint8_t)cr;
+    _preamble = (uint16_t)pre;
+  } else if (name == "AT+CRFOP") {
+    _txPower = (int8_t)atoi(value.c_str());
+  } else if (name == "AT+NETWORKID") {
+    _networkId = (uint8_t)atoi(value.c_str());
+  } else if (name == "AT+ADDRESS") {
+    _address = (uint16_t)atoi(value.c_str());
+  } else {
+    reply("+ERR=4", readyAt);
+    return;
+  }
+  reply("+OK", readyAt);
+}
+
+void Rylr896Model::handleSend(const std::string& args) {
+  uint64_t now = _board.nowUs();
+  _stats.sendCommands++;
+
+  // <address>,<length>,<data>
+  size_t c1 = args.find(',');
+  size_t c2 = c1 == std::string::npos ? c1 : args.find(',', c1 + 1);
+  if (c2 == std::string::npos) {
+    _stats.rejectedOther++;
+    reply("+ERR=4", now + 2000);
+    return;
+  }
+  uint16_t dest = (uint16_t)atoi(args.substr(0, c1).c_str());
+  size_t declared = (size_t)atoi(args.substr(c1 + 1, c2 - c1 - 1).c_str());
+  std::string data = args.substr(c2 + 1);
+
+  if (data.size() > RYLR896_MAX_PAYLOAD) {
+    _stats.rejectedTooLong++;
+    reply("+ERR=13", now + 2000);
+    return;
+  }
+  if (declared != data.size()) {
+    _stats.rejectedOther++;
+    reply("+ERR=5", now + 2000);
+    return;
+  }
+  if (transmitting(now)) {
+    _stats.rejectedOther++;
+    reply("+ERR=17", now + 2000);
+    return;
+  }
+
+  RadioFrame frame;
+  frame.origin = &_board;
+  frame.srcAddress = address();
+  frame.destAddress = dest;
+  frame.networkId = _networkId;
+  frame.frequency = _frequency;
+  frame.spreadingFactor = _sfOverride ? _sfOverride : _sf;
+  frame.bandwidthKHz = _bwKHz;
+  frame.codingRate = _cr;
+  frame.preamble = _preamble;
+  frame.txPowerDbm = _txPower;
+  uint32_t airtimeUs = loraTimeOnAirUs(data.size(), frame.spreadingFactor,
+                                       _bwKHz, _cr, _preamble);
+  frame.startUs = _board.globalUs();
+  frame.endUs = frame.startUs + airtimeUs;
+  frame.payload = data;
+
+  _txUntilUs = now + airtimeUs;
+  _board.radioTransmitUntil(_txUntilUs);
+  _stats.framesSent++;
+  _stats.airtimeUs += airtimeUs;
+  _stats.payloadBytes += data.size();
+
+  // +OK is reported once the frame has left the antenna
+  reply("+OK", _txUntilUs);
+
+  if (_medium) _medium->transmit(_board, frame);
+}
+
+// ============= ENVIRONMENT =============
+
+bool EnvironmentModel::begin(uint8_t address) {
+  _board.i2cTransfer(2);
+  return bmePresent && address == 0x76;
+}
+
+void EnvironmentModel::takeForcedMeasurement() {
+  convert(0.0, &_temperature, &_humidity, &_pressure);
+}
+
+void EnvironmentModel::convert(double offsetC, float* temperature, float* humidity,
+                               float* pressure) {
+  // Write ctrl_meas, wait for the x1/x1/x1 conversion (~8 ms), burst-read
+  // the 8 data registers
+  _board.i2cTransfer(2);
+  _board.advanceUs(8000, CpuState::Active);
+  _board.i2cTransfer(9);
+
+  double hours = _board.bootHourOfDay + _board.nowUs() / 3.6e9;
+  double phase = 2.0 * M_PI * (hours - 9.0) / 24.0;
+  double t = meanTemperature + offsetC + temperatureSwing * sin(phase) +
+             0.3 * _noise(_board.rng());
+  double rh = 60.0 - 2.5 * (t - meanTemperature) + 1.5 * _noise(_board.rng());
+  if (rh < 5) rh = 5;
+  if (rh > 100) rh = 100;
+
+  *temperature = (float)t;
+  *humidity = (float)rh;
+  *pressure = (float)(91500.0 + 120.0 * sin(phase / 2) + 10.0 * _noise(_board.rng()));
+}
+
+int EnvironmentModel::soilAdc(int probe) {
+  // One ADC conversion
+  _board.advanceUs(10);
+
+  // Moisture decays exponentially after each irrigation event. Hub probes
+  // see the water a little later and keep it for longer or shorter,
+  // depending on where they sit in the field.
+  double hours = _board.nowUs() / 3.6e9;
+  double sinceIrrigation = fmod(hours, irrigationPeriodHours);
+  double decayHours = irrigationPeriodHours / 2.5;
+  if (probe > 0) {
+    sinceIrrigation = fmod(hours - 0.25 * probe + irrigationPeriodHours, irrigationPeriodHours);
+    decayHours *= 1.0 + 0.15 * ((probe * 3) % 5 - 2);
+  }
+  double wetness = exp(-sinceIrrigation / decayHours);
+  double raw = SOIL_SENSOR_WATER_VALUE +
+               (SOIL_SENSOR_AIR_VALUE - SOIL_SENSOR_WATER_VALUE) * (1.0 - wetness) +
+               15.0 * _noise(_board.rng());
+  if (raw < 0) raw = 0;
+  if (raw > 4095) raw = 4095;
+  return (int)raw;
+}
+
+bool EnvironmentModel::HubSensor::begin(uint8_t address) {
+  _env->_board.i2cTransfer(2);
+  return address == HUB_ENV_ADDR && (_env->hubEnvMask & (1 << _channel)) &&
+         _env->hubI2cChannels == (1 << _channel);
+}
+
+void EnvironmentModel::HubSensor::takeForcedMeasurement() {
+  _env->convert(-0.4 * (_channel + 1), &_temperature, &_humidity, &_pressure);
+}
+
+} // namespace sim
+
+// ============= HAL (native) =============
+
+namespace hal {
+
+uint32_t millis() { return (uint32_t)(sim::Board::current().firmwareUs() / 1000); }
+uint32_t micros() { return (uint32_t)sim::Board::current().firmwareUs(); }
+
+void delay(uint32_t ms) {
+  sim::Board& board = sim::Board::current();
+  board.advanceUs((uint64_t)(ms * 1000.0 / (1.0 + board.clockDriftPpm * 1e-6)),
+                  sim::CpuState::Idle);
+}
+
+// Virtual cycles at the ESP32-S3's 240 MHz
+uint32_t cycleCount() { return (uint32_t)(sim::Board::current().nowUs() * 240); }
+uint32_t cpuFrequencyMhz() { return 240; }
+
+Uart& loraUart() { return sim::Board::current().lora(); }
+
+void i2cBegin(int sdaPin, int sclPin, uint32_t clockHz) {
+  (void)sdaPin; (void)sclPin;
+  sim::Board::current().setI2cClock(clockHz);
+}
+
+void i2cSetClock(uint32_t clockHz) { sim::Board::current().setI2cClock(clockHz); }
+
+// One firmware task per board: the bus is never held by anyone else
+void i2cLock() {}
+bool i2cTryLock() { return true; }
+void i2cUnlock() {}
+
+I2cBus& i2cBus() { return sim::Board::current().i2cBus(); }
+
+bool i2cRead(uint8_t address, uint8_t reg, uint8_t* data, size_t length) {
+  sim::Board& board = sim::Board::current();
+  // Register write, repeated start, then the read
+  board.i2cTransfer(1);
+  bool present = address == ATECC608B_I2C_ADDR ||
+                 (address == 0x76 && board.env().bmePresent) ||
+                 (address == HUB_I2C_MUX_ADDR && board.env().hubEnvMask);
+  if (!present) return false;
+  board.i2cTransfer(length);
+  for (size_t i = 0; i < length; i++) data[i] = (uint8_t)(reg + i);
+  return true;
+}
+
+bool i2cWrite(uint8_t address, const uint8_t* data, size_t length) {
+  sim::Board& board = sim::Board::current();
+  board.i2cTransfer(1 + length);
+  sim::EnvironmentModel& env = board.env();
+  if (address != HUB_I2C_MUX_ADDR || !env.hubEnvMask || length == 0) return false;
+  env.hubI2cChannels = data[length - 1];
+  return true;
+}
+
+void pinModeInput(int pin) { (void)pin; }
+void pinModeOutput(int pin) { (void)pin; }
+
+void digitalWrite(int pin, bool high) {
+  static const int SELECT_PINS[] = HUB_SOIL_SELECT_PINS;
+  sim::EnvironmentModel& env = sim::Board::current().env();
+  for (size_t i = 0; i < sizeof(SELECT_PINS) / sizeof(SELECT_PINS[0]); i++) {
+    if (SELECT_PINS[i] != pin) continue;
+    env.hubSelect = (uint8_t)(high ? env.hubSelect | (1 << i) : env.hubSelect & ~(1 << i));
+  }
+}
+
+int analogRead(int pin) {
+  static const int SOIL_PINS[] = HUB_SOIL_PINS;
+  sim::EnvironmentModel& env = sim::Board::current().env();
+  int probe = 0;
+  if (HUB_SOIL_MUX_PIN >= 0) {
+    if (pin == HUB_SOIL_MUX_PIN) probe = 1 + env.hubSelect;
+  } else {
+    for (size_t i = 0; i < sizeof(SOIL_PINS) / sizeof(SOIL_PINS[0]); i++) {
+      if (SOIL_PINS[i] == pin) probe = 1 + (int)i;
+    }
+  }
+  // A mux input with nothing on it floats to the rail
+  if (probe > env.hubSoilProbes) return 4095;
+  return env.soilAdc(probe);
+}
+
+EnvSensor& envSensor() { return sim::Board::current().env(); }
+EnvSensor& hubEnvSensor(uint8_t channel) { return sim::Board::current().env().hubSensor(channel); }
+
+FirmwareSlots& firmwareSlots() { return sim::Board::current().flash(); }
+
+Nvs& nvs() { return sim::Board::current().nvs(); }
+
+DataPartition& historyPartition() { return sim::Board::current().dataFlash(); }
+
+// No 2.4 GHz radio on the simulated board: the loopback stands in for it
+
+bool wifiBegin(const char* ssid, const char* password) {
+  (void)ssid; (void)password;
+  return false;
+}
+
+bool wifiConnected() { return false; }
+
+int httpPost(const char* url, const uint8_t* body, size_t length, uint8_t* response,
+             size_t maxResponse, size_t* responseLength, uint32_t timeoutMs) {
+  (void)url; (void)body; (void)length; (void)response; (void)maxResponse; (void)timeoutMs;
+  *responseLength = 0;
+  return -1;
+}
+
+Transport* hostLink() {
+  sim::Board& board = sim::Board::current();
+  return board.loopbackAttached ? &board.loopback() : nullptr;
+}
+
+void* memAlloc(MemRegion region, size_t bytes) {
+  return sim::Board::current().memory().alloc(region, bytes);
+}
+
+bool heapInfo(MemRegion region, HeapInfo* info) {
+  return sim::Board::current().memory().info(region, info);
+}
+
+size_t taskStacks(TaskStack* out, size_t max) {
+  (void)out; (void)max;
+  return 0;
+}
+
+MemArena& memArena() { return sim::Board::current().memArena(); }
+
+void restart() {
+  sim::Board& board = sim::Board::current();
+  board.flash().reboot();
+  // ROM bootloader and image check before setup() runs again
+  board.advanceUs(300000);
+  throw sim::Restart();
+}
+
+} // namespace hal
+
+// ============= CONSOLE =============
+
+HostConsole Serial;
+
+int HostConsole::available() { return sim::Board::current().consoleAvailable(); }
+int HostConsole::read() { return sim::Board::current().consoleRead(); }
+
+size_t HostConsole::print(const char* text) {
+  size_t n = strlen(text);
+  sim::Board::current().consoleWrite(text, n);
+  return n;
+}
+
+size_t HostConsole::print(int value) {
+  return printf("%d", value);
+}
+
+size_t HostConsole::println(const char* text) {
+  return print(text) + print("\n");
+}
+
+size_t HostConsole::println(int value) {
+  return printf("%d\n", value);
+}
+
+size_t HostConsole::printf(const char* format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (n < 0) return 0;
+  size_t len = (size_t)n < sizeof(buffer) ? (size_t)n : sizeof(buffer) - 1;
+  sim::Board::current().consoleWrite(buffer, len);
+  return len;
+}
+
+#endif // !ARDUINO
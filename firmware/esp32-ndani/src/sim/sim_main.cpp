@@ -0,0 +1,822 @@
+/**
+ * Native Simulation Entry Point
+ *
+ * Runs the unmodified firmware (setup() / loop() from main.cpp) on one
+ * simulated board against a virtual clock, with a direct radio link to a
+ * minimal proof-server model that acknowledges registrations, pushes
+ * epoch updates and time beacons. At the end it reports airtime, awake
+ * time and energy.
+ *
+ * Usage: program [--days N] [--seed S] [--epoch-hours H] [--rssi dBm]
+ *                [--verbose] [--json] [--console "cmd;cmd"]
+ *                [--ota CAMPAIGN [--ota-base IMAGE] [--ota-loss P]]
+ *                [--config SETTINGS [--config-at-hours H]]
+ *                [--mean-temperature C] [--drift-ppm P] [--time-beacon-hours H]
+ *                [--history-query S [--history-at-hours H]]
+ *                [--fl-rounds N [--fl-round-hours H]]
+ *                [--hub-probes N] [--hub-env MASK] [--no-psram]
+ *                [--loopback [--loopback-down-at-hours H [--loopback-down-hours D]]]
+ *
+ * --console types the given self-test console commands at boot and shows
+ * the firmware console.
+ *
+ * --no-psram simulates a module without PSRAM: arena blocks asked for in
+ * PSRAM fall back to internal RAM.
+ *
+ * --loopback gives the device a second link to the gateway model beside
+ * LoRa, standing in for barn Wi-Fi (transport.h): batched, no duty cycle,
+ * and cheaper, so it carries the uplink while it is up. Downlinks still
+ * come over LoRa. --loopback-down-at-hours takes it down for D hours (6
+ * by default) to show the failover to LoRa and back.
+ *
+ * --ota has the gateway model run an edgechain-ota-pack campaign against
+ * the device; --ota-base loads the image the device is running (the
+ * campaign's base), otherwise the board's synthetic image is used;
+ * --ota-loss drops that fraction of the chunk downlinks.
+ *
+ * --config broadcasts a signed settings file (edgechain-config-pack, as
+ * the gateway's --device-config takes it) at the given hour, 1 by
+ * default, and sends it again to the device while its readings report an
+ * older version.
+ *
+ * --mean-temperature sets the field's daily mean (22 °C by default, with
+ * an 8 °C swing); around 6 °C the nights bring frost alerts.
+ *
+ * --drift-ppm makes the board's crystal run fast (or slow, negative);
+ * --time-beacon-hours sets the beacon period (6 by default, 0 = only the
+ * unicast a reading without network time gets, like the gateway's).
+ *
+ * --history-query asks the device for its stored history from the start
+ * of the run at a resolution of S seconds (3600 for hourly summaries,
+ * 86400 for daily ones, less for raw samples), an hour before the end
+ * unless --history-at-hours says when, and compares the airtime of the
+ * answer with sending the same readings again as DataPackets.
+ *
+ * --fl-rounds runs that many federated learning rounds with the device as
+ * the only client: a randomly initialised forecaster goes out after H
+ * hours (72 by default), and each update is applied to the global model
+ * that goes out H hours after it arrives.
+ *
+ * --hub-probes and --hub-env fit the board with N extra soil probes on the
+ * analog mux and BME280s on the I2C mux channels in MASK, and provision
+ * the device as a sensor hub for them. The report compares its readings
+ * with one node per probe sending its own.
+ *
+ * The report also shows what the device's edge analytics derived: degree
+ * days, and the wetting events it detected against the model's irrigation
+ * period, and the range of each channel sent beyond the DataPacket
+ * (sensor_schema.h).
+ */
+
+#ifndef ARDUINO
+
+#include "sim/sim_args.h"
+#include "sim/sim_board.h"
+#include "alert_rules.h"
+#include "edge_analytics.h"
+#include "fl_protocol.h"
+#include "config.h"
+#include "config_protocol.h"
+#include "history_protocol.h"
+#include "lora_airtime.h"
+#include "ota_protocol.h"
+#include "probe_hub.h"
+#include "sensor_schema.h"
+#include "time_sync.h"
+#include "uplink_queue.h"
+#include "wire_codec.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+namespace {
+
+const uint64_t US_PER_HOUR = 3600ULL * 1000000ULL;
+const uint64_t SIM_UNIX_MS = 1767225600000ULL;   // Simulation starts 2026-01-01 00:00 UTC
+
+bool readFile(const char* path, std::vector<uint8_t>* data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data->insert(data->end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+/**
+ * Proof-server side of a clean point-to-point link: every frame arrives,
+ * fragmented messages are reassembled, registrations are ACKed (0x01) and
+ * epoch updates (0x02) and time beacons (0x0B) are pushed on a fixed
+ * schedule, and a history query (0x0C) when asked for. With a campaign it
+ * also offers a firmware update and answers status reports with chunks,
+ * the way the gateway daemon's OtaCampaign does.
+ */
+class DirectLinkGateway : public sim::RadioMedium {
+public:
+  int rssi = -95;
+  int snr = 8;
+  uint32_t registrations = 0;
+  uint32_t dataPackets = 0;
+  uint32_t echoes = 0;
+  uint32_t otherFrames = 0;
+  uint32_t linkMessages = 0;            // Over the loopback link
+  uint32_t otaOffers = 0;
+  uint32_t otaChunks = 0;
+  uint32_t otaStatuses = 0;
+  ota::State otaState = ota::State::Idle;
+  double otaLoss = 0.0;
+  uint32_t configSends = 0;
+  uint32_t configReports = 0;           // Readings that carried a report
+  rcfg::Report configReport = {0, 0, rcfg::Result::None};
+  uint32_t readingsBeforeConfig = 0;    // Data packets before the device applied it
+  uint32_t alertReadings = 0;
+  uint32_t alertsByRule[3] = {0, 0, 0};   // Frost, heat, dry soil
+  uint64_t alertLeadUs = 0;             // Summed: alert arrival to the next routine reading
+  uint32_t alertLeads = 0;
+  uint32_t timeBeacons = 0;
+  uint32_t timeUnicasts = 0;
+  uint32_t syncedReadings = 0;          // Readings stamped with network time
+  int64_t timestampErrorMs = 0;         // Summed: arrival time minus timestamp
+  int64_t timestampErrorMaxMs = 0;
+  tsync::Report timeReport = {0, 0};
+  uint32_t historyFrames = 0;
+  uint32_t historyRecords = 0;
+  uint32_t historySamples = 0;          // Readings the records stand for
+  uint64_t historyAirtimeUs = 0;
+  hist::Tier historyTier = hist::Tier::Raw;
+  uint8_t historyFlags = 0;             // Of the last frame
+  uint32_t analyticsReadings = 0;       // Readings that carried a report
+  uint32_t wettingReadings = 0;
+  uint32_t anomalyReadings = 0;
+  analytics::Report analyticsReport = {0, 0, 0, 0, 0};
+  uint32_t flModels = 0;
+  uint32_t flUpdates = 0;
+  uint32_t flUpdateBytes = 0;
+  uint32_t flDeltas = 0;
+  uint64_t flAirtimeUs = 0;             // Models and updates
+  fl::Update flFirst = {};
+  fl::Update flLast = {};
+  uint32_t hubReadings = 0;             // Readings that carried probes
+  uint32_t hubChannels = 0;
+  uint32_t hubMissing = 0;              // Channels whose read failed
+  uint32_t hubNodes = 0;                // Separate nodes the probes stand for (last reading)
+  uint64_t hubAirtimeUs = 0;            // Hub readings
+  uint64_t hubSeparateAirtimeUs = 0;    // ... sent as one reading per node
+  uint32_t extraReadings = 0;           // Readings with the channels item
+  uint32_t extraValues[schema::Extra::COUNT] = {};
+  float extraMin[schema::Extra::COUNT];
+  float extraMax[schema::Extra::COUNT];
+
+  bool loadCampaign(const char* path) {
+    if (!readFile(path, &_campaign)) return false;
+    const uint8_t* patch;
+    if (!ota::parseCampaign(_campaign.data(), _campaign.size(), &_offer, &patch)) {
+      fprintf(stderr, "%s: not an OTA campaign file\n", path);
+      return false;
+    }
+    _patch = patch;
+    return true;
+  }
+
+  bool loadConfig(const char* path) {
+    std::vector<uint8_t> message;
+    if (!readFile(path, &message)) return false;
+    rcfg::Config config;
+    if (message.size() > sizeof(_config) ||
+        !rcfg::parseConfig(message.data(), message.size(), &config)) {
+      fprintf(stderr, "%s: not a signed config file (edgechain-config-pack)\n", path);
+      return false;
+    }
+    memcpy(_config, message.data(), message.size());
+    _configLen = message.size();
+    return true;
+  }
+
+  // Broadcast, as the gateway does on start-up and reload
+  void scheduleConfig(sim::Board& board, uint64_t atUs) {
+    if (_configLen == 0) return;
+    char hex[2 * wire::MAX_FRAME_BYTES + 1];
+    wire::hexEncode(_config, _configLen, hex);
+    board.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr, atUs);
+    _configSentUs = atUs;
+    configSends++;
+  }
+
+  void transmit(sim::Board& from, const sim::RadioFrame& frame) override {
+    uint8_t bytes[wire::MAX_FRAME_BYTES];
+    size_t length = wire::hexDecode(frame.payload.data(), frame.payload.size(), bytes,
+                                    sizeof(bytes));
+    if (length > 0 && bytes[0] == wire::MSG_FRAGMENT) {
+      uint8_t message[wire::MESSAGE_MAX];
+      uint16_t seq;
+      size_t messageLen = _reassembler.add(frame.srcAddress, bytes, length,
+                                           (uint32_t)(frame.endUs / 1000), message, &seq);
+      if (messageLen > 0) onMessage(from, frame, message, messageLen);
+      return;
+    }
+    onMessage(from, frame, bytes, length);
+  }
+
+  // Beacons stamped as they start, heard once their time on air has passed
+  void scheduleTimeBeacons(sim::Board& board, uint64_t untilUs, uint64_t periodUs) {
+    for (uint64_t t = periodUs; t < untilUs; t += periodUs) {
+      sendTime(board, t, LORA_SPREADING_FACTOR);
+      timeBeacons++;
+    }
+  }
+
+  // Everything since the start of the run, at the given resolution
+  void scheduleHistoryQuery(sim::Board& board, uint64_t atUs, uint32_t resolutionS) {
+    hist::Query query = {1, (uint32_t)(SIM_UNIX_MS / 1000),
+                         (uint32_t)((SIM_UNIX_MS + atUs / 1000) / 1000), resolutionS};
+    uint8_t frame[hist::QUERY_SIZE];
+    char hex[2 * hist::QUERY_SIZE + 1];
+    wire::hexEncode(frame, hist::encodeQuery(query, frame), hex);
+    board.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr, atUs);
+  }
+
+  // Federated rounds with one client: FedAvg is the device's own update
+  void startFlRounds(sim::Board& board, uint64_t atUs, uint64_t periodUs, uint32_t rounds,
+                     uint64_t seed) {
+    std::mt19937 rng((uint32_t)seed);
+    std::normal_distribution<float> init(0.0f, 0.3f);
+    for (size_t t = 0; t < fl::TENSORS; t++) {
+      for (size_t i = fl::tensorOffset(t); i < fl::tensorOffset(t) + fl::tensorSize(t); i++) {
+        // Weights random, hidden biases slightly positive so every unit starts alive
+        _flModel[i] = t == 0 || t == 2 ? init(rng) : t == 1 ? 0.1f : 0.0f;
+      }
+    }
+    _flPeriodUs = periodUs;
+    _flRoundsLeft = rounds;
+    sendFlModel(board, atUs);
+  }
+
+  void sendFlModel(sim::Board& board, uint64_t atUs) {
+    uint8_t frame[fl::MODEL_SIZE];
+    char hex[2 * fl::MODEL_SIZE + 1];
+    wire::hexEncode(frame, fl::encodeModel((uint16_t)++_flRound, _flModel, frame), hex);
+    board.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr, atUs);
+    flAirtimeUs += loraTimeOnAirUs(2 * fl::MODEL_SIZE, LORA_SPREADING_FACTOR, 125);
+    flModels++;
+    _flRoundsLeft--;
+  }
+
+  void onFlUpdate(sim::Board& from, const sim::RadioFrame& frame, const uint8_t* message,
+                  size_t length) {
+    fl::Update update;
+    if (!fl::parseUpdate(message, length, &update) || update.round != _flRound) {
+      otherFrames++;
+      return;
+    }
+    if (flUpdates++ == 0) flFirst = update;
+    flLast = update;
+    flUpdateBytes += (uint32_t)length;
+    flDeltas += update.count;
+    flAirtimeUs += loraTimeOnAirUs(2 * length, frame.spreadingFactor, 125);
+    for (size_t i = 0; i < update.count; i++) {
+      _flModel[update.deltas[i].index] += fl::dequantize(update.deltas[i].value, update.shift);
+    }
+    if (_flRoundsLeft > 0) sendFlModel(from, from.localUs(frame.endUs + _flPeriodUs));
+  }
+
+  // A message over the loopback link: nothing on the air, handled like a
+  // frame that ended now
+  void onLinkMessage(sim::Board& from, const uint8_t* message, size_t length) {
+    sim::RadioFrame frame;
+    frame.origin = &from;
+    frame.srcAddress = from.lora().address();
+    frame.networkId = from.lora().networkId();
+    frame.spreadingFactor = from.lora().spreadingFactor();
+    frame.startUs = from.globalUs();
+    frame.endUs = frame.startUs;
+    linkMessages++;
+    onMessage(from, frame, message, length);
+  }
+
+  void scheduleEpochs(sim::Board& board, uint64_t untilUs, uint64_t periodUs) {
+    uint32_t epoch = 1;
+    for (uint64_t t = periodUs; t < untilUs; t += periodUs, epoch++) {
+      char hex[11];
+      snprintf(hex, sizeof(hex), "02%08X", epoch);
+      board.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr, t);
+    }
+  }
+
+private:
+  wire::Reassembler _reassembler;
+  std::vector<uint8_t> _campaign;
+  ota::Offer _offer;
+  const uint8_t* _patch = nullptr;
+  uint64_t _offeredUs = 0;
+  std::mt19937 _lossRng{7};
+  float _flModel[fl::PARAMS];
+  uint32_t _flRound = 0;
+  uint32_t _flRoundsLeft = 0;
+  uint64_t _flPeriodUs = 0;
+  uint8_t _config[wire::MAX_FRAME_BYTES];
+  size_t _configLen = 0;
+  uint64_t _configSentUs = 0;
+  uint64_t _timeSentUs = 0;
+  std::vector<uint64_t> _alertsAwaitingRoutineUs;
+
+  void sendTime(sim::Board& to, uint64_t startUs, uint8_t spreadingFactor) {
+    uint8_t beacon[tsync::BEACON_SIZE];
+    tsync::encodeBeacon(SIM_UNIX_MS + startUs / 1000, beacon);
+    char hex[2 * tsync::BEACON_SIZE + 1];
+    wire::hexEncode(beacon, sizeof(beacon), hex);
+    to.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr,
+                           to.localUs(startUs + loraTimeOnAirUs(2 * sizeof(beacon),
+                                                                spreadingFactor, 125)));
+  }
+
+  // Network time in readings; one without it gets a beacon, at most every 10 min
+  void onTime(sim::Board& from, const sim::RadioFrame& frame, const uint8_t* message,
+              size_t length) {
+    DataPacket packet;
+    wire::parseDataPacket(message, wire::DATA_PACKET_SIZE, &packet);
+    tsync::Report report;
+    if (tsync::findReport(message, length, &report)) {
+      syncedReadings++;
+      timeReport = report;
+      int64_t errorMs = (int64_t)(SIM_UNIX_MS + frame.endUs / 1000) -
+                        (int64_t)packet.timestamp * 1000;
+      timestampErrorMs += errorMs;
+      if (llabs(errorMs) > llabs(timestampErrorMaxMs)) timestampErrorMaxMs = errorMs;
+      return;
+    }
+    if (_timeSentUs != 0 && frame.endUs < _timeSentUs + 600000000ULL) return;
+    sendTime(from, frame.endUs + 250000, frame.spreadingFactor);
+    _timeSentUs = frame.endUs;
+    timeUnicasts++;
+  }
+
+  void onHistory(const sim::RadioFrame& frame, const uint8_t* message, size_t length) {
+    hist::ResponseHeader header;
+    if (!hist::parseResponse(message, length, &header)) {
+      otherFrames++;
+      return;
+    }
+    historyFrames++;
+    historyRecords += header.records;
+    historyAirtimeUs += loraTimeOnAirUs(2 * length, frame.spreadingFactor, 125);
+    historyTier = header.tier;
+    historyFlags = header.flags;
+    for (size_t i = 0; i < header.records; i++) {
+      historySamples += header.tier == hist::Tier::Raw
+                            ? 1 : hist::summaryRecord(message, header, i).count;
+    }
+  }
+
+  void onAnalytics(const uint8_t* message, size_t length) {
+    analytics::Report report;
+    if (!analytics::findReport(message, length, &report)) return;
+    analyticsReadings++;
+    if (report.events & analytics::EVENT_WETTING) wettingReadings++;
+    if (report.events & analytics::EVENT_ANOMALY) anomalyReadings++;
+    analyticsReport = report;
+  }
+
+  // How much sooner an alert arrives than the routine reading after it
+  void onAlerts(const sim::RadioFrame& frame, const uint8_t* message, size_t length) {
+    uint8_t rules = alert::findAlerts(message, length);
+    if (rules) {
+      alertReadings++;
+      if (rules & alert::FROST) alertsByRule[0]++;
+      if (rules & alert::HEAT) alertsByRule[1]++;
+      if (rules & alert::DRY_SOIL) alertsByRule[2]++;
+      _alertsAwaitingRoutineUs.push_back(frame.endUs);
+      return;
+    }
+    for (uint64_t atUs : _alertsAwaitingRoutineUs) {
+      alertLeadUs += frame.endUs - atUs;
+      alertLeads++;
+    }
+    _alertsAwaitingRoutineUs.clear();
+  }
+
+  // Readings report the device's settings version; resend while it is behind
+  void onReading(sim::Board& from, const sim::RadioFrame& frame, const uint8_t* message,
+                 size_t length) {
+    if (_configLen == 0) return;
+    uint16_t version = (uint16_t)(_config[4] | (_config[5] << 8));
+    rcfg::Report report;
+    if (rcfg::findReport(message, length, &report)) {
+      configReports++;
+      configReport = report;
+    }
+    if (configReport.applied != version) readingsBeforeConfig++;
+    if (configReport.heard >= version || _configSentUs == 0) return;
+    if (frame.endUs < _configSentUs + 600000000ULL) return;
+    uint64_t atUs = frame.endUs + 250000;
+    downlink(from, frame, _config, _configLen, &atUs);
+    _configSentUs = frame.endUs;
+    configSends++;
+  }
+
+  // Frames sent back-to-back from atUs (global time), each after the last's airtime
+  void downlink(sim::Board& to, const sim::RadioFrame& after, const uint8_t* frame,
+                size_t length, uint64_t* atUs) {
+    char hex[2 * wire::MAX_FRAME_BYTES + 1];
+    wire::hexEncode(frame, length, hex);
+    to.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr, to.localUs(*atUs));
+    *atUs += loraTimeOnAirUs(2 * length, after.spreadingFactor, 125) + 30000;
+  }
+
+  void onOta(sim::Board& from, const sim::RadioFrame& frame, const uint8_t* message,
+             size_t length) {
+    uint64_t atUs = frame.endUs + 250000;
+    ota::Status status;
+    if (ota::parseStatus(message, length, &status) && status.session == _offer.session) {
+      otaStatuses++;
+      otaState = status.state;
+      if (status.state != ota::State::Receiving) return;
+      _offeredUs = frame.endUs;
+      uint8_t chunk[ota::CHUNK_HEADER_SIZE + ota::CHUNK_DATA_MAX];
+      size_t sent = 0;
+      for (size_t k = 0; k < ota::STATUS_WINDOW && sent < 16; k++) {
+        size_t index = (size_t)status.windowBase + k;
+        if (index >= _offer.chunkCount) break;
+        if (status.bitmap[k / 8] & (1 << (k % 8))) continue;
+        size_t offset = index * ota::CHUNK_DATA_MAX;
+        size_t n = _offer.patchLength - offset < ota::CHUNK_DATA_MAX
+                       ? _offer.patchLength - offset : ota::CHUNK_DATA_MAX;
+        size_t chunkLen = ota::encodeChunk(_offer.session, (uint16_t)index, _patch + offset, n,
+                                           chunk);
+        if (std::uniform_real_distribution<double>(0, 1)(_lossRng) < otaLoss) {
+          atUs += loraTimeOnAirUs(2 * chunkLen, frame.spreadingFactor, 125) + 30000;
+        } else {
+          downlink(from, frame, chunk, chunkLen, &atUs);
+        }
+        otaChunks++;
+        sent++;
+      }
+      return;
+    }
+
+    bool finished = otaState != ota::State::Idle && otaState != ota::State::Receiving &&
+                    otaState != ota::State::Failed;
+    if (finished || (_offeredUs && frame.endUs - _offeredUs < 60000000ULL)) return;
+    uint8_t offer[ota::OFFER_SIZE];
+    downlink(from, frame, offer, ota::encodeOffer(_offer, offer), &atUs);
+    _offeredUs = frame.endUs;
+    otaOffers++;
+  }
+
+  void onProbes(const sim::RadioFrame& frame, const uint8_t* message, size_t length) {
+    probe::Reading reading;
+    if (!probe::findReading(message, length, &reading)) return;
+    // One node per soil probe and per BME280 (temperature and humidity)
+    uint32_t nodes = 0;
+    for (size_t i = 0; i < reading.count; i++) {
+      const probe::Channel& c = reading.channels[i];
+      if (c.kind != probe::KIND_HUMIDITY) nodes++;
+      if (isnan(c.value)) hubMissing++;
+    }
+    uint32_t itemLen = (uint32_t)(wire::TRAILER_ITEM_HEADER_SIZE + reading.count * probe::CHANNEL_SIZE);
+    hubReadings++;
+    hubChannels += reading.count;
+    hubNodes = nodes;
+    hubAirtimeUs += UplinkQueue::airtimeUs(length, frame.spreadingFactor, LORA_BANDWIDTH);
+    hubSeparateAirtimeUs +=
+        UplinkQueue::airtimeUs(length - itemLen, frame.spreadingFactor, LORA_BANDWIDTH) +
+        nodes * UplinkQueue::airtimeUs(wire::DATA_PACKET_SIZE, frame.spreadingFactor,
+                                       LORA_BANDWIDTH);
+  }
+
+  void onChannels(const uint8_t* message, size_t length) {
+    float values[schema::Extra::COUNT];
+    if (!schema::Extra::findValues(message, length, wire::TRAILER_CHANNELS, values)) return;
+    extraReadings++;
+    for (size_t i = 0; i < schema::Extra::COUNT; i++) {
+      if (isnan(values[i])) continue;
+      if (extraValues[i] == 0 || values[i] < extraMin[i]) extraMin[i] = values[i];
+      if (extraValues[i] == 0 || values[i] > extraMax[i]) extraMax[i] = values[i];
+      extraValues[i]++;
+    }
+  }
+
+  void onMessage(sim::Board& from, const sim::RadioFrame& frame, const uint8_t* message,
+                 size_t length) {
+    uint8_t first = length > 0 ? message[0] : 0xFF;
+    if (_patch) onOta(from, frame, message, length);
+
+    if (first == wire::MSG_REGISTRATION && length == wire::REGISTRATION_SIZE) {
+      registrations++;
+      // Server turnaround before the ACK goes out
+      from.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, "01", rssi, snr,
+                               from.localUs(frame.endUs + 250000));
+    } else if (first == wire::MSG_ECHO_REQUEST && length >= 2 &&
+               !wire::isReading(message, length)) {
+      // Self-test echo: reply with the uplink RSSI/SNR
+      echoes++;
+      uint8_t reply[4] = {wire::MSG_ECHO_REPLY, message[1], (uint8_t)(int8_t)rssi,
+                          (uint8_t)(int8_t)snr};
+      char hex[9];
+      wire::hexEncode(reply, sizeof(reply), hex);
+      from.lora().deliverFrame(PROOF_SERVER_LORA_ADDRESS, hex, rssi, snr,
+                               from.localUs(frame.endUs + 20000 +
+                                            loraTimeOnAirUs(8, frame.spreadingFactor, 125)));
+    } else if (wire::isReading(message, length)) {
+      dataPackets++;
+      onAlerts(frame, message, length);
+      onReading(from, frame, message, length);
+      onTime(from, frame, message, length);
+      onAnalytics(message, length);
+      onProbes(frame, message, length);
+      onChannels(message, length);
+    } else if (first == wire::MSG_HISTORY) {
+      onHistory(frame, message, length);
+    } else if (first == wire::MSG_FL_UPDATE) {
+      onFlUpdate(from, frame, message, length);
+    } else if (first == wire::MSG_OTA_STATUS && length == ota::STATUS_SIZE) {
+      // Counted in onOta()
+    } else {
+      otherFrames++;
+    }
+  }
+};
+
+} // namespace
+
+using sim::argDouble;
+using sim::argFlag;
+
+int main(int argc, char** argv) {
+  double days = argDouble(argc, argv, "--days", 30.0);
+  uint64_t seed = (uint64_t)argDouble(argc, argv, "--seed", 1.0);
+  double epochHours = argDouble(argc, argv, "--epoch-hours", 24.0);
+  bool verbose = argFlag(argc, argv, "--verbose");
+  bool json = argFlag(argc, argv, "--json");
+  const char* console = sim::argValue(argc, argv, "--console", nullptr);
+  const char* otaCampaign = sim::argValue(argc, argv, "--ota", nullptr);
+  const char* otaBase = sim::argValue(argc, argv, "--ota-base", nullptr);
+  const char* configPath = sim::argValue(argc, argv, "--config", nullptr);
+
+  sim::Board board(0, seed);
+  sim::Board::setCurrent(&board);
+  board.env().meanTemperature = argDouble(argc, argv, "--mean-temperature", 22.0);
+  board.clockDriftPpm = argDouble(argc, argv, "--drift-ppm", 0.0);
+  board.memory().psramPresent = !argFlag(argc, argv, "--no-psram");
+  board.env().hubSoilProbes = (int)argDouble(argc, argv, "--hub-probes", 0.0);
+  board.env().hubEnvMask = (uint8_t)strtol(sim::argValue(argc, argv, "--hub-env", "0"), nullptr, 0);
+  if (board.env().hubSoilProbes > 0 || board.env().hubEnvMask) {
+    // Provisioned before boot, as the console's "probe layout" would
+    ProbeHub::Layout layout = ProbeHub::defaultLayout();
+    layout.soilProbes = (uint8_t)board.env().hubSoilProbes;
+    layout.envMask = board.env().hubEnvMask;
+    ProbeHub hub;
+    if (!hub.setLayout(layout)) {
+      fprintf(stderr, "--hub-probes/--hub-env: layout does not fit this board\n");
+      return 1;
+    }
+  }
+  board.setConsole(verbose || console ? stdout : nullptr);
+  if (console) {
+    std::string input(console);
+    for (char& c : input) if (c == ';') c = '\n';
+    board.queueConsoleInput(input + "\n");
+  }
+
+  uint64_t stopUs = (uint64_t)(days * 24.0 * US_PER_HOUR);
+  board.setStopAtUs(stopUs);
+
+  DirectLinkGateway gateway;
+  gateway.rssi = (int)argDouble(argc, argv, "--rssi", -95.0);
+  if (otaBase) {
+    std::vector<uint8_t> image;
+    if (!readFile(otaBase, &image)) return 1;
+    board.flash().setRunningImage(image);
+  }
+  if (otaCampaign && !gateway.loadCampaign(otaCampaign)) return 1;
+  bool loopback = argFlag(argc, argv, "--loopback");
+  if (loopback) {
+    board.loopbackAttached = true;
+    board.loopback().setHandler([&](const uint8_t* message, size_t length) {
+      gateway.onLinkMessage(board, message, length);
+    });
+    double downAtHours = argDouble(argc, argv, "--loopback-down-at-hours", -1.0);
+    if (downAtHours >= 0) {
+      uint64_t downUs = (uint64_t)(downAtHours * US_PER_HOUR);
+      uint64_t upUs = downUs + (uint64_t)(argDouble(argc, argv, "--loopback-down-hours", 6.0) *
+                                          US_PER_HOUR);
+      board.loopback().setUp([&board, downUs, upUs]() {
+        return board.nowUs() < downUs || board.nowUs() >= upUs;
+      });
+    }
+  }
+  gateway.otaLoss = argDouble(argc, argv, "--ota-loss", 0.0);
+  if (configPath) {
+    if (!gateway.loadConfig(configPath)) return 1;
+    gateway.scheduleConfig(board, (uint64_t)(argDouble(argc, argv, "--config-at-hours", 1.0) *
+                                             US_PER_HOUR));
+  }
+  board.lora().setMedium(&gateway);
+  if (epochHours > 0) {
+    gateway.scheduleEpochs(board, stopUs, (uint64_t)(epochHours * US_PER_HOUR));
+  }
+  double beaconHours = argDouble(argc, argv, "--time-beacon-hours", 6.0);
+  if (beaconHours > 0) {
+    gateway.scheduleTimeBeacons(board, stopUs, (uint64_t)(beaconHours * US_PER_HOUR));
+  }
+  bool historyQuery = sim::argValue(argc, argv, "--history-query", nullptr) != nullptr;
+  if (historyQuery) {
+    double atHours = argDouble(argc, argv, "--history-at-hours", days * 24.0 - 1.0);
+    gateway.scheduleHistoryQuery(board, (uint64_t)(atHours * US_PER_HOUR),
+                                 (uint32_t)argDouble(argc, argv, "--history-query", 0.0));
+  }
+  uint32_t flRounds = (uint32_t)argDouble(argc, argv, "--fl-rounds", 0.0);
+  if (flRounds > 0) {
+    uint64_t periodUs = (uint64_t)(argDouble(argc, argv, "--fl-round-hours", 72.0) * US_PER_HOUR);
+    gateway.startFlRounds(board, periodUs, periodUs, flRounds, seed);
+  }
+
+  auto wallStart = std::chrono::steady_clock::now();
+  uint32_t restarts = 0;
+  try {
+    for (;;) {
+      try {
+        setup();
+        for (;;) loop();
+      } catch (const sim::Restart&) {
+        restarts++;
+      }
+    }
+  } catch (const sim::StopSimulation&) {
+  }
+  double wallSeconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wallStart).count();
+
+  sim::EnergyProfile profile;
+  const sim::PowerStats& power = board.power();
+  const sim::RadioStats& radio = board.lora().stats();
+  double simSeconds = board.nowUs() / 1e6;
+  double energyMah = power.energyMah(profile);
+  double avgCurrentMa = energyMah * 3600.0 / simSeconds;
+  double batteryDays = profile.batteryMah / avgCurrentMa / 24.0;
+
+  if (json) {
+    printf("{\"sim_days\":%.3f,\"wall_s\":%.3f,\"send_commands\":%u,\"frames_sent\":%u,"
+           "\"rejected_too_long\":%u,\"rejected_other\":%u,\"registrations\":%u,"
+           "\"data_packets\":%u,\"airtime_s\":%.3f,\"awake_s\":%.3f,\"cpu_active_s\":%.3f,"
+           "\"deep_sleep_s\":%.3f,\"energy_mah\":%.3f,\"avg_current_ma\":%.4f,"
+           "\"battery_days\":%.2f}\n",
+           simSeconds / 86400.0, wallSeconds, radio.sendCommands, radio.framesSent,
+           radio.rejectedTooLong, radio.rejectedOther, gateway.registrations,
+           gateway.dataPackets, radio.airtimeUs / 1e6, power.awakeUs() / 1e6,
+           power.cpuActiveUs / 1e6, power.deepSleepUs / 1e6, energyMah,
+           avgCurrentMa, batteryDays);
+    return 0;
+  }
+
+  printf("\n═══════════════════════════════════════\n");
+  printf("  Msingi native simulation\n");
+  printf("═══════════════════════════════════════\n");
+  printf("  Simulated time:   %.2f days (wall %.2f s)\n", simSeconds / 86400.0, wallSeconds);
+  printf("  AT+SEND commands: %u (sent %u, too long %u, other errors %u)\n",
+         radio.sendCommands, radio.framesSent, radio.rejectedTooLong, radio.rejectedOther);
+  printf("  Gateway received: %u registrations, %u data packets, %u echoes, %u other\n",
+         gateway.registrations, gateway.dataPackets, gateway.echoes, gateway.otherFrames);
+  printf("  Airtime:          %.2f s (%.4f%% duty cycle, %llu payload bytes)\n",
+         radio.airtimeUs / 1e6, 100.0 * radio.airtimeUs / board.nowUs(),
+         (unsigned long long)radio.payloadBytes);
+  if (loopback) {
+    const sim::LoopbackStats& link = board.loopback().stats();
+    printf("  Loopback link:    %u messages in %u batches (%llu bytes), %u refused while down | "
+           "LoRa %u frames\n",
+           link.messages, link.batches, (unsigned long long)link.bytes, link.refused,
+           radio.framesSent);
+  }
+  printf("  Awake time:       %.1f h (CPU active %.1f s, idle %.1f h, deep sleep %.1f h)\n",
+         power.awakeUs() / 3.6e9, power.cpuActiveUs / 1e6, power.cpuIdleUs / 3.6e9,
+         power.deepSleepUs / 3.6e9);
+  printf("  Radio:            TX %.2f s, RX %.1f h\n",
+         power.radioTxUs / 1e6, power.radioRxUs / 3.6e9);
+  printf("  Energy:           %.1f mAh (avg %.2f mA)\n", energyMah, avgCurrentMa);
+  printf("  Battery life:     %.1f days on %.0f mAh\n", batteryDays, profile.batteryMah);
+  printf("  ATECC commands:   %u\n", board.atecc().commands);
+  {
+    I2cBus& bus = board.i2cBus();
+    printf("  I2C bus:          busy %.2f s (%.2f%% of awake time), %u clock switches |",
+           bus.busStats().busyUs / 1e6, 100.0 * bus.busStats().busyUs / power.awakeUs(),
+           bus.busStats().clockSwitches);
+    for (uint8_t d = 0; d < I2cBus::DEVICE_COUNT; d++) {
+      I2cBus::Device device = (I2cBus::Device)d;
+      const I2cBus::DeviceStats& s = bus.stats(device);
+      if (s.transactions == 0) continue;
+      printf(" %s %u at %lu kHz, avg %.2f ms, max %.2f ms;", I2cBus::deviceName(device),
+             s.transactions, (unsigned long)(I2cBus::clockHz(device) / 1000),
+             s.busyUs / 1e3 / s.transactions, s.maxUs / 1e3);
+    }
+    printf("\n");
+  }
+  {
+    const MemArena& arena = board.memArena();
+    printf("  Memory:           arena %u B internal, %u B PSRAM, %u B RTC |",
+           (unsigned)arena.used(hal::MemRegion::Internal),
+           (unsigned)arena.used(hal::MemRegion::Psram), (unsigned)arena.used(hal::MemRegion::Rtc));
+    for (size_t i = 0; i < arena.blocks(); i++) {
+      const MemArena::Block& block = arena.block(i);
+      printf(" %s %u B %s%s;", block.name, (unsigned)block.bytes,
+             MemArena::regionName(block.region),
+             block.region != block.requested ? " (fallback)" : "");
+    }
+    printf("\n");
+  }
+  if (gateway.alertReadings > 0) {
+    printf("  Alerts:           %u (frost %u, heat %u, dry soil %u), on average %.1f min "
+           "ahead of the next routine reading\n",
+           gateway.alertReadings, gateway.alertsByRule[0], gateway.alertsByRule[1],
+           gateway.alertsByRule[2],
+           gateway.alertLeads ? gateway.alertLeadUs / 6e7 / gateway.alertLeads : 0.0);
+  }
+  if (gateway.syncedReadings > 0) {
+    printf("  Time sync:        %u of %u readings in network time | %u beacons, %u unicast | "
+           "arrival - timestamp avg %.2f s, max %.2f s | drift estimate %+.1f ppm "
+           "(crystal %+.1f ppm)\n",
+           gateway.syncedReadings, gateway.dataPackets, gateway.timeBeacons,
+           gateway.timeUnicasts, gateway.timestampErrorMs / 1e3 / gateway.syncedReadings,
+           gateway.timestampErrorMaxMs / 1e3, gateway.timeReport.driftDeciPpm / 10.0,
+           board.clockDriftPpm);
+  }
+  if (gateway.analyticsReadings > 0) {
+    const analytics::Report& report = gateway.analyticsReport;
+    printf("  Analytics:        %.1f degree days | %u readings with wetting events "
+           "(irrigated every %.0f h), %u with anomalies | last VPD %.2f kPa, dew point %.1f °C\n",
+           report.gddDeci / 10.0, gateway.wettingReadings, board.env().irrigationPeriodHours,
+           gateway.anomalyReadings,
+           report.vpdPa == analytics::VPD_MISSING ? 0.0 : report.vpdPa / 1000.0,
+           report.dewPointCenti == analytics::DEW_POINT_MISSING ? 0.0
+                                                                : report.dewPointCenti / 100.0);
+  }
+  if (flRounds > 0) {
+    const fl::Update& first = gateway.flFirst;
+    const fl::Update& last = gateway.flLast;
+    printf("  Federated:        %u of %u rounds answered | forecast RMSE %.2f%% -> %.2f%% in "
+           "round 1, %.2f%% -> %.2f%% in round %u (%u samples) | %.1f deltas, %.1f bytes per "
+           "update, %u B models + updates, airtime %.2f s (hourly history instead: %u B)\n",
+           gateway.flUpdates, gateway.flModels, first.rmseBefore / 100.0, first.rmseAfter / 100.0,
+           last.rmseBefore / 100.0, last.rmseAfter / 100.0, last.round, last.samples,
+           gateway.flUpdates ? (double)gateway.flDeltas / gateway.flUpdates : 0.0,
+           gateway.flUpdates ? (double)gateway.flUpdateBytes / gateway.flUpdates : 0.0,
+           (unsigned)(gateway.flModels * fl::MODEL_SIZE + gateway.flUpdateBytes),
+           gateway.flAirtimeUs / 1e6,
+           (unsigned)(simSeconds / 3600.0 * hist::SUMMARY_RECORD_SIZE));
+  }
+  if (gateway.extraReadings > 0) {
+    printf("  Channels:         %u readings, %zu B each (as floats %zu B) |", gateway.extraReadings,
+           schema::Extra::SIZE, schema::Extra::COUNT * sizeof(float));
+    for (size_t i = 0; i < schema::Extra::COUNT; i++) {
+      printf(" %s %.1f-%.1f (%u values)", schema::EXTRA_CHANNELS[i].name,
+             gateway.extraValues[i] ? gateway.extraMin[i] : 0.0,
+             gateway.extraValues[i] ? gateway.extraMax[i] : 0.0, gateway.extraValues[i]);
+    }
+    printf("\n");
+  }
+  if (gateway.hubReadings > 0) {
+    printf("  Sensor hub:       %u readings, %.1f channels each (%u missing) | %u signatures, "
+           "airtime %.2f s (as %u separate nodes: %u signatures, %.2f s)\n",
+           gateway.hubReadings, (double)gateway.hubChannels / gateway.hubReadings,
+           gateway.hubMissing, gateway.hubReadings, gateway.hubAirtimeUs / 1e6,
+           1 + gateway.hubNodes, gateway.hubReadings * (1 + gateway.hubNodes),
+           gateway.hubSeparateAirtimeUs / 1e6);
+  }
+  if (historyQuery) {
+    uint32_t resendUs = UplinkQueue::airtimeUs(wire::DATA_PACKET_SIZE, LORA_SPREADING_FACTOR,
+                                               LORA_BANDWIDTH);
+    printf("  History:          %s, %u frames, %u records for %u readings%s | airtime %.2f s "
+           "(as DataPackets %.2f s) | store: %u sectors erased, %llu bytes written\n",
+           hist::tierName(gateway.historyTier), gateway.historyFrames, gateway.historyRecords,
+           gateway.historySamples,
+           gateway.historyFlags & hist::FLAG_LAST ? ""
+           : gateway.historyFlags & hist::FLAG_TRUNCATED ? " (truncated)" : " (incomplete)",
+           gateway.historyAirtimeUs / 1e6, (double)gateway.historySamples * resendUs / 1e6,
+           board.dataFlash().sectorsErased, (unsigned long long)board.dataFlash().bytesWritten);
+  }
+  if (otaCampaign) {
+    static const char* const STATES[] = {"idle", "receiving", "applied", "wrong base",
+                                         "bad signature", "failed", "up to date"};
+    const sim::FlashModel& flash = board.flash();
+    printf("  OTA:              %s after %u offers, %u chunks, %u status reports; "
+           "%u restarts, %u image swaps, %u sectors erased, %llu bytes written\n",
+           STATES[(int)gateway.otaState], gateway.otaOffers, gateway.otaChunks,
+           gateway.otaStatuses, restarts, flash.imageSwaps, flash.sectorsErased,
+           (unsigned long long)flash.bytesWritten);
+  }
+  if (configPath) {
+    printf("  Settings:         device runs v%u (last heard v%u: %s) | %u config frames sent, "
+           "%u readings before it applied, %u readings with a report | %u NVS writes\n",
+           gateway.configReport.applied, gateway.configReport.heard,
+           rcfg::resultName(gateway.configReport.result), gateway.configSends,
+           gateway.readingsBeforeConfig, gateway.configReports, board.nvs().writes);
+  }
+  return 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,109 @@
+/**
+ * Time Sync Implementation
+ */
+
+#include "time_sync.h"
+#include "wire_codec.h"
+
+namespace tsync {
+
+namespace {
+
+int32_t clamp(int64_t value, int32_t limit) {
+  return (int32_t)(value < -limit ? -limit : value > limit ? limit : value);
+}
+
+} // namespace
+
+size_t encodeBeacon(uint64_t unixMs, uint8_t* out) {
+  uint32_t seconds = (uint32_t)(unixMs / 1000);
+  uint16_t millis = (uint16_t)(unixMs % 1000);
+  out[0] = wire::MSG_TIME;
+  out[1] = (uint8_t)seconds;
+  out[2] = (uint8_t)(seconds >> 8);
+  out[3] = (uint8_t)(seconds >> 16);
+  out[4] = (uint8_t)(seconds >> 24);
+  out[5] = (uint8_t)millis;
+  out[6] = (uint8_t)(millis >> 8);
+  return BEACON_SIZE;
+}
+
+bool parseBeacon(const uint8_t* frame, size_t length, uint64_t* unixMs) {
+  if (length != BEACON_SIZE || frame[0] != wire::MSG_TIME) return false;
+  uint32_t seconds = (uint32_t)frame[1] | ((uint32_t)frame[2] << 8) |
+                     ((uint32_t)frame[3] << 16) | ((uint32_t)frame[4] << 24);
+  uint16_t millis = (uint16_t)(frame[5] | (frame[6] << 8));
+  if (millis >= 1000) return false;
+  *unixMs = (uint64_t)seconds * 1000 + millis;
+  return true;
+}
+
+size_t encodeReport(const Report& report, uint8_t* out) {
+  out[0] = wire::TRAILER_TIME;
+  out[1] = REPORT_SIZE;
+  out[2] = (uint8_t)report.ageMin;
+  out[3] = (uint8_t)(report.ageMin >> 8);
+  out[4] = (uint8_t)report.driftDeciPpm;
+  out[5] = (uint8_t)((uint16_t)report.driftDeciPpm >> 8);
+  return wire::TRAILER_ITEM_HEADER_SIZE + REPORT_SIZE;
+}
+
+bool findReport(const uint8_t* message, size_t length, Report* report) {
+  const uint8_t* value;
+  size_t valueLen;
+  if (!wire::findTrailerItem(message, length, wire::TRAILER_TIME, &value, &valueLen) ||
+      valueLen < REPORT_SIZE) {
+    return false;
+  }
+  report->ageMin = (uint16_t)(value[0] | (value[1] << 8));
+  report->driftDeciPpm = (int16_t)(uint16_t)(value[2] | (value[3] << 8));
+  return true;
+}
+
+void Clock::onBeacon(uint64_t unixMs, uint32_t localMs) {
+  _beacons++;
+  if (!synced(localMs)) {
+    _synced = true;
+    _anchorUnixMs = unixMs;
+    _anchorLocalMs = localMs;
+    _lastErrorMs = 0;
+  } else {
+    _lastErrorMs = clamp((int64_t)unixMs - (int64_t)now(localMs), INT32_MAX);
+
+    // Rate over a long interval; the offset is corrected below either way
+    uint32_t localElapsed = localMs - _anchorLocalMs;
+    if (localElapsed >= DRIFT_MIN_INTERVAL_MS && unixMs > _anchorUnixMs) {
+      int64_t trueElapsed = (int64_t)(unixMs - _anchorUnixMs);
+      int64_t sample = ((int64_t)localElapsed - trueElapsed) * 1000000000LL / trueElapsed;
+      // The first sample replaces the estimate, later ones are averaged in
+      int64_t drift = _driftSamples == 0 ? sample : (_driftPpb + sample) / 2;
+      _driftPpb = clamp(drift, DRIFT_MAX_PPB);
+      _driftSamples++;
+      _anchorUnixMs = unixMs;
+      _anchorLocalMs = localMs;
+    }
+  }
+  _baseUnixMs = unixMs;
+  _baseLocalMs = localMs;
+}
+
+uint64_t Clock::now(uint32_t localMs) const {
+  if (!synced(localMs)) return 0;
+  int64_t elapsed = (int64_t)(uint32_t)(localMs - _baseLocalMs);
+  return _baseUnixMs + (uint64_t)(elapsed - elapsed * _driftPpb / 1000000000LL);
+}
+
+Report Clock::report(uint32_t localMs) const {
+  Report report;
+  uint32_t ageMin = (localMs - _baseLocalMs) / 60000;
+  report.ageMin = (uint16_t)(ageMin > AGE_MAX_MIN ? AGE_MAX_MIN : ageMin);
+  report.driftDeciPpm = (int16_t)clamp(_driftPpb / 100, INT16_MAX);
+  return report;
+}
+
+void Clock::setDrift(int32_t ppb) {
+  _driftPpb = clamp(ppb, DRIFT_MAX_PPB);
+  _driftSamples = 1;
+}
+
+} // namespace tsync
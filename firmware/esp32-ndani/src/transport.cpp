@@ -0,0 +1,166 @@
+/**
+ * Transport Implementation
+ */
+
+#include "transport.h"
+#include "config.h"
+#include "hal.h"
+
+const char* linkName(LinkKind kind) {
+  switch (kind) {
+    case LinkKind::LoRa: return "lora";
+    case LinkKind::Wifi: return "wifi";
+    case LinkKind::Loopback: return "loopback";
+    default: return "unknown";
+  }
+}
+
+bool parseLinkName(const char* name, LinkKind* kind) {
+  const LinkKind kinds[] = {LinkKind::LoRa, LinkKind::Wifi, LinkKind::Loopback};
+  for (LinkKind k : kinds) {
+    if (strcmp(name, linkName(k)) == 0) {
+      *kind = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TransportSet::clear() {
+  _count = 0;
+  _last = 0;
+  _pinned = false;
+}
+
+bool TransportSet::add(Transport* link) {
+  if (_count == LINKS_MAX) return false;
+  _links[_count] = link;
+  _stats[_count] = LinkStats();
+  _failed[_count] = false;
+  _count++;
+  return true;
+}
+
+void TransportSet::prefer(LinkKind kind) {
+  _pinned = true;
+  _pin = kind;
+}
+
+bool TransportSet::pinned(LinkKind* kind) const {
+  if (_pinned) *kind = _pin;
+  return _pinned;
+}
+
+bool TransportSet::backedOff(size_t index) const {
+  return _failed[index] && hal::millis() - _failedMs[index] < LINK_RETRY_MS;
+}
+
+Transport* TransportSet::route(size_t length) {
+  int best = -1;
+  int fallback = -1;
+  for (size_t i = 0; i < _count; i++) {
+    const LinkCaps& caps = _links[i]->caps();
+    if (length > caps.mtu || !_links[i]->ready()) continue;
+    if (backedOff(i)) {
+      if (fallback < 0 || caps.cost < _links[fallback]->caps().cost) fallback = (int)i;
+      continue;
+    }
+    if (_pinned && caps.kind == _pin) return _links[i];
+    if (best < 0 || caps.cost < _links[best]->caps().cost) best = (int)i;
+  }
+  if (best < 0) best = fallback;
+  return best < 0 ? nullptr : _links[best];
+}
+
+bool TransportSet::send(Transport* link, const uint8_t* data, size_t length) {
+  int index = indexOf(link);
+  if (index < 0) return false;
+  _last = (size_t)index;
+  if (!link->transmit(data, length)) {
+    _stats[index].failures++;
+    _failed[index] = true;
+    _failedMs[index] = hal::millis();
+    return false;
+  }
+  _failed[index] = false;
+  _stats[index].messages++;
+  _stats[index].bytes += length;
+  return true;
+}
+
+const LinkCaps& TransportSet::caps() const {
+  static const LinkCaps NONE = {LinkKind::LoRa, 0, 0, 0, true, false};
+  return _count ? _links[_last]->caps() : NONE;
+}
+
+bool TransportSet::transmit(const uint8_t* data, size_t length) {
+  // A failed link is passed over by the next route(), so each link is tried once
+  for (size_t attempt = 0; attempt < _count; attempt++) {
+    Transport* link = route(length);
+    if (!link) return false;
+    if (send(link, data, length)) return true;
+    if (route(length) == link) return false;   // Nothing else to fail over to
+  }
+  return false;
+}
+
+bool TransportSet::flush() {
+  bool ok = true;
+  for (size_t i = 0; i < _count; i++) {
+    if (!_links[i]->caps().batched) continue;
+    if (_links[i]->flush()) {
+      _stats[i].flushes++;
+    } else {
+      _stats[i].failures++;
+      _failed[i] = true;
+      _failedMs[i] = hal::millis();
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool TransportSet::available() {
+  for (size_t i = 0; i < _count; i++) {
+    if (_links[i]->available()) return true;
+  }
+  return false;
+}
+
+size_t TransportSet::receive(uint8_t* buffer, size_t maxLen) {
+  for (size_t i = 0; i < _count; i++) {
+    if (_links[i]->available()) return _links[i]->receive(buffer, maxLen);
+  }
+  return 0;
+}
+
+int TransportSet::indexOf(const Transport* link) const {
+  for (size_t i = 0; i < _count; i++) {
+    if (_links[i] == link) return (int)i;
+  }
+  return -1;
+}
+
+namespace xport {
+
+size_t appendRecord(uint8_t* batch, size_t used, size_t capacity, const uint8_t* message,
+                    size_t length) {
+  if (length > 0xFFFF || used + RECORD_HEADER_SIZE + length > capacity) return 0;
+  batch[used] = (uint8_t)(length >> 8);
+  batch[used + 1] = (uint8_t)length;
+  memcpy(batch + used + RECORD_HEADER_SIZE, message, length);
+  return used + RECORD_HEADER_SIZE + length;
+}
+
+bool nextRecord(const uint8_t* batch, size_t length, size_t* offset, const uint8_t** message,
+                size_t* messageLength) {
+  if (*offset + RECORD_HEADER_SIZE > length) return false;
+  size_t n = (size_t)(batch[*offset] << 8 | batch[*offset + 1]);
+  if (*offset + RECORD_HEADER_SIZE + n > length) return false;
+  *message = batch + *offset + RECORD_HEADER_SIZE;
+  *messageLength = n;
+  *offset += RECORD_HEADER_SIZE + n;
+  return true;
+}
+
+} // namespace xport
@@ -0,0 +1,109 @@
+/**
+ * Uplink Queue Implementation
+ */
+
+#include "uplink_queue.h"
+#include "lora_airtime.h"
+#include <string.h>
+
+void UplinkQueue::begin(Entry* entries) {
+  _entries = entries;
+  _size = 0;
+  _count[0] = _count[1] = 0;
+}
+
+bool UplinkQueue::push(Priority priority, const uint8_t* message, size_t length) {
+  if (length > ENTRY_MAX || !_entries) return false;
+  if (_size == CAPACITY) {
+    int victim = find(Priority::Routine);
+    if (victim < 0) victim = find(Priority::Urgent);
+    remove((size_t)victim);
+    _stats.dropped++;
+  }
+  Entry& entry = _entries[_size++];
+  entry.priority = priority;
+  entry.order = _nextOrder++;
+  entry.length = length;
+  memcpy(entry.data, message, length);
+  _count[(int)priority]++;
+  return true;
+}
+
+bool UplinkQueue::front(Priority* priority, const uint8_t** message, size_t* length) const {
+  int index = find(Priority::Urgent);
+  if (index < 0) index = find(Priority::Routine);
+  if (index < 0) return false;
+  const Entry& entry = _entries[index];
+  *priority = entry.priority;
+  *message = entry.data;
+  *length = entry.length;
+  return true;
+}
+
+void UplinkQueue::pop() {
+  int index = find(Priority::Urgent);
+  if (index < 0) index = find(Priority::Routine);
+  if (index < 0) return;
+  if (_entries[index].priority == Priority::Urgent) {
+    _stats.urgentSent++;
+  } else {
+    _stats.routineSent++;
+  }
+  remove((size_t)index);
+}
+
+int UplinkQueue::find(Priority priority) const {
+  // Oldest of the class; eight entries do not warrant an index
+  int best = -1;
+  for (size_t i = 0; i < _size; i++) {
+    if (_entries[i].priority != priority) continue;
+    if (best < 0 || (int32_t)(_entries[i].order - _entries[best].order) < 0) best = (int)i;
+  }
+  return best;
+}
+
+void UplinkQueue::remove(size_t index) {
+  _count[(int)_entries[index].priority]--;
+  // Order is kept in the entries, so the last one can fill the hole
+  if (index != _size - 1) _entries[index] = _entries[_size - 1];
+  _size--;
+}
+
+uint32_t UplinkQueue::airtimeUs(size_t length, uint8_t spreadingFactor, uint16_t bandwidthKHz) {
+  // AT+SEND puts the hex characters on the air
+  if (length <= wire::MAX_FRAME_BYTES) {
+    return loraTimeOnAirUs(2 * length, spreadingFactor, bandwidthKHz);
+  }
+  size_t count = wire::fragmentCount(length);
+  size_t last = wire::FRAGMENT_HEADER_SIZE + length - (count - 1) * wire::FRAGMENT_CHUNK_MAX;
+  return (uint32_t)(count - 1) *
+             loraTimeOnAirUs(2 * wire::MAX_FRAME_BYTES, spreadingFactor, bandwidthKHz) +
+         loraTimeOnAirUs(2 * last, spreadingFactor, bandwidthKHz);
+}
+
+bool AirtimeBudget::allows(uint32_t airtimeUs, uint32_t reserveUs, uint32_t nowMs) {
+  refill(nowMs);
+  return _balanceUs >= (int64_t)airtimeUs + reserveUs;
+}
+
+uint32_t AirtimeBudget::msUntil(uint32_t airtimeUs, uint32_t reserveUs, uint32_t nowMs) {
+  refill(nowMs);
+  int64_t missingUs = (int64_t)airtimeUs + reserveUs - _balanceUs;
+  if (missingUs <= 0) return 0;
+  // More than the bucket holds never fits; report when it is full
+  if (missingUs > (int64_t)_capacityUs - _balanceUs) missingUs = (int64_t)_capacityUs - _balanceUs;
+  return (uint32_t)((missingUs + _permille - 1) / _permille);
+}
+
+void AirtimeBudget::refill(uint32_t nowMs) {
+  if (!_started) {
+    _started = true;
+    _refilledMs = nowMs;
+    return;
+  }
+  // The air earns permille microseconds per millisecond
+  uint32_t elapsedMs = nowMs - _refilledMs;
+  _refilledMs = nowMs;
+  _balanceUs += (int64_t)elapsedMs * _permille;
+  if (_balanceUs > (int64_t)_capacityUs) _balanceUs = _capacityUs;
+}
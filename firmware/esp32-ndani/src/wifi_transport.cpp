@@ -0,0 +1,88 @@
+/**
+ * Wi-Fi Transport Implementation
+ */
+
+#include "wifi_transport.h"
+
+bool WifiTransport::begin(const char* ssid, const char* password, uint16_t address,
+                          Buffers* buffers) {
+  _buffers = nullptr;
+  _batchLength = 0;
+  _batchMessages = 0;
+  _attempts = 0;
+  _responseLength = 0;
+  _responseOffset = 0;
+  if (!ssid[0] || !buffers) return false;
+  if (!hal::wifiBegin(ssid, password)) return false;
+  snprintf(_url, sizeof(_url), "%s%s?address=%u", PROOF_SERVER_URL, PROOF_SERVER_UPLINK_PATH,
+           address);
+  _buffers = buffers;
+  return true;
+}
+
+bool WifiTransport::ready() {
+  return _buffers && hal::wifiConnected();
+}
+
+bool WifiTransport::transmit(const uint8_t* data, size_t length) {
+  if (!ready()) return false;
+  size_t used = xport::appendRecord(_buffers->batch, _batchLength, sizeof(_buffers->batch), data,
+                                    length);
+  if (used == 0) {
+    // Full: send what is there and start a new batch
+    if (!flush()) return false;
+    used = xport::appendRecord(_buffers->batch, 0, sizeof(_buffers->batch), data, length);
+    if (used == 0) return false;
+  }
+  _batchLength = used;
+  _batchMessages++;
+  return true;
+}
+
+bool WifiTransport::flush() {
+  if (_batchLength == 0) return true;
+  if (!ready()) return false;
+
+  // Downlinks not yet read are replaced by this POST's
+  size_t responseLength;
+  int status = hal::httpPost(_url, _buffers->batch, _batchLength, _buffers->response,
+                             sizeof(_buffers->response), &responseLength, WIFI_POST_TIMEOUT_MS);
+  if (status < 200 || status >= 300) {
+    _stats.failedPosts++;
+    if (++_attempts >= WIFI_POST_RETRIES) {
+      Serial.printf("✗ Wi-Fi: batch of %u messages dropped (HTTP %d)\n",
+                    (unsigned)_batchMessages, status);
+      _stats.dropped += _batchMessages;
+      _batchLength = 0;
+      _batchMessages = 0;
+      _attempts = 0;
+    }
+    return false;
+  }
+  _stats.posts++;
+  _batchLength = 0;
+  _batchMessages = 0;
+  _attempts = 0;
+  _responseLength = responseLength;
+  _responseOffset = 0;
+  return true;
+}
+
+bool WifiTransport::available() {
+  return _buffers && _responseOffset < _responseLength;
+}
+
+size_t WifiTransport::receive(uint8_t* buffer, size_t maxLen) {
+  if (!available()) return 0;
+  const uint8_t* message;
+  size_t length;
+  if (!xport::nextRecord(_buffers->response, _responseLength, &_responseOffset, &message,
+                         &length)) {
+    _responseOffset = _responseLength;   // Truncated: the rest is lost
+    return 0;
+  }
+  if (length > maxLen) length = maxLen;
+  memcpy(buffer, message, length);
+  _stats.downlinks++;
+  return length;
+}
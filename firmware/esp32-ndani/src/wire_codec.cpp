@@ -0,0 +1,308 @@
+/**
+ * Wire Codec Implementation
+ *
+ * Table-driven hex and hand-rolled integer formatting: these run for every
+ * frame on the device and for every line on the gateway, so they avoid
+ * sprintf/strtol/strtok and never copy the payload.
+ */
+
+#include "wire_codec.h"
+#include <string.h>
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// 0-15 for hex digits, 0xFF otherwise
+struct HexTable {
+  uint8_t value[256];
+  HexTable() {
+    memset(value, 0xFF, sizeof(value));
+    for (int i = 0; i < 10; i++) value['0' + i] = (uint8_t)i;
+    for (int i = 0; i < 6; i++) {
+      value['A' + i] = (uint8_t)(10 + i);
+      value['a' + i] = (uint8_t)(10 + i);
+    }
+  }
+};
+const HexTable HEX_VALUES;
+
+// Decimal, no terminator; returns characters written
+size_t formatUnsigned(char* out, uint32_t value) {
+  char digits[10];
+  size_t n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  for (size_t i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+  return n;
+}
+
+// Parse [-]digits up to the end or a comma; advances *pos
+bool parseInt(const char* s, size_t len, size_t* pos, long* value) {
+  size_t i = *pos;
+  bool negative = false;
+  if (i < len && s[i] == '-') { negative = true; i++; }
+  size_t start = i;
+  long v = 0;
+  while (i < len && s[i] >= '0' && s[i] <= '9') {
+    v = v * 10 + (s[i] - '0');
+    if (v > 1000000) return false;
+    i++;
+  }
+  if (i == start) return false;
+  *value = negative ? -v : v;
+  *pos = i;
+  return true;
+}
+
+void putU32(uint8_t* out, uint32_t v) {
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+  out[2] = (uint8_t)(v >> 16);
+  out[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) |
+         ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void putFloat(uint8_t* out, float f) {
+  uint32_t v;
+  memcpy(&v, &f, 4);
+  putU32(out, v);
+}
+
+float getFloat(const uint8_t* in) {
+  uint32_t v = getU32(in);
+  float f;
+  memcpy(&f, &v, 4);
+  return f;
+}
+
+} // namespace
+
+namespace wire {
+
+size_t hexEncode(const uint8_t* data, size_t length, char* out) {
+  for (size_t i = 0; i < length; i++) {
+    out[2 * i] = HEX_DIGITS[data[i] >> 4];
+    out[2 * i + 1] = HEX_DIGITS[data[i] & 0x0F];
+  }
+  out[2 * length] = '\0';
+  return 2 * length;
+}
+
+size_t hexDecode(const char* hex, size_t hexLen, uint8_t* out, size_t maxLen) {
+  size_t n = hexLen / 2;
+  if (n > maxLen) n = maxLen;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t hi = HEX_VALUES.value[(uint8_t)hex[2 * i]];
+    uint8_t lo = HEX_VALUES.value[(uint8_t)hex[2 * i + 1]];
+    if ((hi | lo) & 0xF0) return 0;
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return n;
+}
+
+size_t formatSend(char* out, size_t outSize, uint16_t address, const uint8_t* data,
+                  size_t length) {
+  // "AT+SEND=" + 5 + "," + 3 + "," + hex + NUL
+  if (outSize < 8 + 5 + 1 + 3 + 1 + 2 * length + 1) return 0;
+  memcpy(out, "AT+SEND=", 8);
+  size_t n = 8;
+  n += formatUnsigned(out + n, address);
+  out[n++] = ',';
+  n += formatUnsigned(out + n, (uint32_t)(2 * length));
+  out[n++] = ',';
+  n += hexEncode(data, length, out + n);
+  return n;
+}
+
+bool parseRcv(const char* line, size_t lineLen, RcvFrame* frame) {
+  while (lineLen > 0 && (line[lineLen - 1] == '\n' || line[lineLen - 1] == '\r')) lineLen--;
+  if (lineLen < 5 || memcmp(line, "+RCV=", 5) != 0) return false;
+
+  size_t pos = 5;
+  long address, dataLen, rssi, snr;
+  if (!parseInt(line, lineLen, &pos, &address) || address < 0 || address > 65535) return false;
+  if (pos >= lineLen || line[pos++] != ',') return false;
+  if (!parseInt(line, lineLen, &pos, &dataLen) || dataLen < 0) return false;
+  if (pos >= lineLen || line[pos++] != ',') return false;
+
+  // The length field delimits the data, which may itself contain commas
+  if ((size_t)dataLen > lineLen - pos) return false;
+  const char* data = line + pos;
+  pos += (size_t)dataLen;
+
+  if (pos >= lineLen || line[pos++] != ',') return false;
+  if (!parseInt(line, lineLen, &pos, &rssi)) return false;
+  if (pos >= lineLen || line[pos++] != ',') return false;
+  if (!parseInt(line, lineLen, &pos, &snr)) return false;
+  if (pos != lineLen) return false;
+
+  frame->address = (uint16_t)address;
+  frame->data = data;
+  frame->dataLen = (size_t)dataLen;
+  frame->rssi = (int)rssi;
+  frame->snr = (int)snr;
+  return true;
+}
+
+size_t serializeDataPacket(const DataPacket& packet, uint8_t* out) {
+  memcpy(out, packet.commitment, 32);
+  putFloat(out + 32, packet.temperature);
+  putFloat(out + 36, packet.humidity);
+  putFloat(out + 40, packet.soilMoisture);
+  putU32(out + 44, packet.timestamp);
+  memcpy(out + 48, packet.nullifier, 32);
+  memcpy(out + 80, packet.signature, 64);
+  return DATA_PACKET_SIZE;
+}
+
+bool parseDataPacket(const uint8_t* in, size_t length, DataPacket* packet) {
+  if (length != DATA_PACKET_SIZE) return false;
+  memcpy(packet->commitment, in, 32);
+  packet->temperature = getFloat(in + 32);
+  packet->humidity = getFloat(in + 36);
+  packet->soilMoisture = getFloat(in + 40);
+  packet->timestamp = getU32(in + 44);
+  memcpy(packet->nullifier, in + 48, 32);
+  memcpy(packet->signature, in + 80, 64);
+  return true;
+}
+
+bool isReading(const uint8_t* message, size_t length) {
+  if (length < DATA_PACKET_SIZE) return false;
+  size_t pos = DATA_PACKET_SIZE;
+  while (pos < length) {
+    if (length - pos < TRAILER_ITEM_HEADER_SIZE) return false;
+    pos += TRAILER_ITEM_HEADER_SIZE + message[pos + 1];
+  }
+  return pos == length;
+}
+
+bool findTrailerItem(const uint8_t* message, size_t length, uint8_t tag,
+                     const uint8_t** value, size_t* valueLen) {
+  size_t pos = DATA_PACKET_SIZE;
+  while (pos + TRAILER_ITEM_HEADER_SIZE <= length) {
+    size_t itemLen = message[pos + 1];
+    if (itemLen > length - pos - TRAILER_ITEM_HEADER_SIZE) return false;
+    if (message[pos] == tag) {
+      *value = message + pos + TRAILER_ITEM_HEADER_SIZE;
+      *valueLen = itemLen;
+      return true;
+    }
+    pos += TRAILER_ITEM_HEADER_SIZE + itemLen;
+  }
+  return false;
+}
+
+size_t fragmentCount(size_t messageLen) {
+  if (messageLen == 0 || messageLen > MESSAGE_MAX) return 0;
+  return (messageLen + FRAGMENT_CHUNK_MAX - 1) / FRAGMENT_CHUNK_MAX;
+}
+
+size_t buildFragment(const uint8_t* message, size_t messageLen, uint16_t seq, uint8_t index,
+                     uint8_t* out) {
+  size_t count = fragmentCount(messageLen);
+  if (index >= count) return 0;
+  size_t offset = (size_t)index * FRAGMENT_CHUNK_MAX;
+  size_t chunkLen = messageLen - offset < FRAGMENT_CHUNK_MAX ? messageLen - offset
+                                                             : FRAGMENT_CHUNK_MAX;
+  out[0] = MSG_FRAGMENT;
+  out[1] = (uint8_t)seq;
+  out[2] = (uint8_t)(seq >> 8);
+  out[3] = (uint8_t)((index << 4) | count);
+  memcpy(out + FRAGMENT_HEADER_SIZE, message + offset, chunkLen);
+  return FRAGMENT_HEADER_SIZE + chunkLen;
+}
+
+bool parseFragment(const uint8_t* frame, size_t frameLen, FragmentHeader* header,
+                   const uint8_t** chunk, size_t* chunkLen) {
+  if (frameLen <= FRAGMENT_HEADER_SIZE || frame[0] != MSG_FRAGMENT) return false;
+  header->seq = (uint16_t)(frame[1] | (frame[2] << 8));
+  header->index = frame[3] >> 4;
+  header->count = frame[3] & 0x0F;
+  if (header->count == 0 || header->index >= header->count) return false;
+
+  *chunk = frame + FRAGMENT_HEADER_SIZE;
+  *chunkLen = frameLen - FRAGMENT_HEADER_SIZE;
+  // Every fragment but the last carries a full chunk
+  if (header->index + 1 < header->count && *chunkLen != FRAGMENT_CHUNK_MAX) return false;
+  return *chunkLen <= FRAGMENT_CHUNK_MAX;
+}
+
+size_t Reassembler::add(uint16_t address, const uint8_t* frame, size_t frameLen, uint32_t nowMs,
+                        uint8_t* out, uint16_t* seq) {
+  FragmentHeader header;
+  const uint8_t* chunk;
+  size_t chunkLen;
+  if (!parseFragment(frame, frameLen, &header, &chunk, &chunkLen)) {
+    _malformed++;
+    return 0;
+  }
+
+  // Find the message in progress, else a free slot, else evict the oldest
+  Slot* slot = nullptr;
+  Slot* freeSlot = nullptr;
+  Slot* oldest = nullptr;
+  for (size_t i = 0; i < SLOTS; i++) {
+    Slot& s = _slots[i];
+    if (!s.used) {
+      if (!freeSlot) freeSlot = &s;
+      continue;
+    }
+    if (s.address == address && s.seq == header.seq) {
+      slot = &s;
+      break;
+    }
+    if (!oldest || (int32_t)(s.firstMs - oldest->firstMs) < 0) oldest = &s;
+  }
+
+  if (slot && slot->count != header.count) {
+    // Same sequence reused for a different message: start over
+    _discarded++;
+    slot->used = false;
+  }
+  if (!slot || !slot->used) {
+    if (!slot) slot = freeSlot;
+    if (!slot) {
+      slot = oldest;
+      _discarded++;
+    }
+    slot->used = true;
+    slot->address = address;
+    slot->seq = header.seq;
+    slot->count = header.count;
+    slot->received = 0;
+    slot->lastChunkLen = 0;
+    slot->firstMs = nowMs;
+  }
+
+  memcpy(slot->data + (size_t)header.index * FRAGMENT_CHUNK_MAX, chunk, chunkLen);
+  slot->received |= (uint16_t)(1u << header.index);
+  if (header.index + 1 == header.count) slot->lastChunkLen = (uint16_t)chunkLen;
+
+  if (slot->received != (uint16_t)((1u << slot->count) - 1)) return 0;
+
+  size_t length = (size_t)(slot->count - 1) * FRAGMENT_CHUNK_MAX + slot->lastChunkLen;
+  memcpy(out, slot->data, length);
+  *seq = slot->seq;
+  slot->used = false;
+  _completed++;
+  return length;
+}
+
+void Reassembler::expire(uint32_t nowMs, uint32_t maxAgeMs) {
+  for (size_t i = 0; i < SLOTS; i++) {
+    if (_slots[i].used && nowMs - _slots[i].firstMs > maxAgeMs) {
+      _slots[i].used = false;
+      _discarded++;
+    }
+  }
+}
+
+} // namespace wire
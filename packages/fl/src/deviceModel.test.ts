@@ -0,0 +1,97 @@
+/**
+ * Device model tests.
+ *
+ * These protect the weight layout shared with the Msingi firmware: the
+ * MSG_FL_MODEL frame must be byte for byte what fl::encodeModel()
+ * (firmware/esp32-ndani/src/fl_protocol.cpp) produces, and must parse back
+ * as fl::parseModel() reads it.
+ */
+
+import assert from 'node:assert/strict';
+import {
+  DEVICE_MODEL_HIDDEN,
+  DEVICE_MODEL_INPUTS,
+  DEVICE_MODEL_PARAMS,
+  aggregateDeviceUpdates,
+  deviceParamsToWeights,
+  deviceWeightsToParams,
+  encodeDeviceModel,
+} from './deviceModel';
+
+// fl::encodeModel(258, params) for the parameters below, from the firmware
+const FIRMWARE_FRAME =
+  '0E0201070B060F13363F2B03D9C1C7E814363F2A02D8C1C8E915373F2A01D7C1C8EA16383F29FFD6C1C9EB' +
+  '17383F28FED6C1CAEC18393F27FDD5C1CAED19393E26FCD4C0CBEE1A5C633CF8B89AACE51B3A3E25FAD2C0' +
+  'CCD8';
+
+// One scale per tensor so each gets its own shift
+function sampleParams(): number[] {
+  return Array.from({ length: DEVICE_MODEL_PARAMS }, (_, i) => {
+    const scale = i < 64 ? 1 : i < 72 ? 0.1 : i < 80 ? 2 : 0.01;
+    return Math.fround(0.5 * Math.sin(0.7 * i + 0.3) * scale);
+  });
+}
+
+// fl::parseModel(): round (u16 LE), one shift per tensor, then q / 2^shift
+function parseModel(hex: string): { round: number; params: number[] } {
+  const frame = Uint8Array.from(hex.match(/../g)!.map((byte) => parseInt(byte, 16)));
+  assert.equal(frame[0], 0x0e, 'frame type should be MSG_FL_MODEL');
+  const tensors = [
+    DEVICE_MODEL_HIDDEN * DEVICE_MODEL_INPUTS,
+    DEVICE_MODEL_HIDDEN,
+    DEVICE_MODEL_HIDDEN,
+    1,
+  ];
+  assert.equal(frame.length, 3 + tensors.length + DEVICE_MODEL_PARAMS);
+  const int8 = (byte: number) => (byte << 24) >> 24;
+  const params: number[] = [];
+  tensors.forEach((size, tensor) => {
+    const shift = int8(frame[3 + tensor]);
+    for (let i = 0; i < size; i++) {
+      params.push(int8(frame[3 + tensors.length + params.length]) / 2 ** shift);
+    }
+  });
+  return { round: frame[1] | (frame[2] << 8), params };
+}
+
+function testMatchesFirmwareFrame() {
+  assert.equal(encodeDeviceModel(sampleParams(), 258), FIRMWARE_FRAME);
+}
+
+function testFrameRoundTrip() {
+  const params = sampleParams();
+  const { round, params: decoded } = parseModel(encodeDeviceModel(params, 0x1234));
+  assert.equal(round, 0x1234);
+  decoded.forEach((value, i) => {
+    // Half a quantization step of the coarsest tensor (output weights, shift 5)
+    assert.ok(Math.abs(value - params[i]) <= 2 ** -6, `parameter ${i}: ${value} vs ${params[i]}`);
+  });
+}
+
+function testWeightsRoundTrip() {
+  const params = sampleParams();
+  const weights = deviceParamsToWeights(params);
+  assert.equal(weights.layers[0].weights[0].length, DEVICE_MODEL_HIDDEN);
+  assert.equal(weights.layers[0].weights[0][0].length, DEVICE_MODEL_INPUTS);
+  // Row j of the hidden layer is unit j's weights, as the firmware lays them out
+  assert.equal(weights.layers[0].weights[0][1][0], params[DEVICE_MODEL_INPUTS]);
+  assert.equal(weights.layers[1].biases[0][0], params[DEVICE_MODEL_PARAMS - 1]);
+  assert.deepEqual(deviceWeightsToParams(weights), params);
+}
+
+function testAggregateWeightsBySamples() {
+  const params = new Array(DEVICE_MODEL_PARAMS).fill(0);
+  const next = aggregateDeviceUpdates(params, [
+    { sourceAddress: 1, round: 1, samples: 30, rmseBefore: 5, rmseAfter: 4, deltas: [[3, 1]] },
+    { sourceAddress: 2, round: 1, samples: 10, rmseBefore: 5, rmseAfter: 4, deltas: [[3, -1], [80, 2]] },
+  ]);
+  assert.equal(next[3], 0.5);
+  assert.equal(next[80], 0.5);
+  assert.equal(next[0], 0);
+}
+
+testMatchesFirmwareFrame();
+testFrameRoundTrip();
+testWeightsRoundTrip();
+testAggregateWeightsBySamples();
+console.log('deviceModel tests passed');
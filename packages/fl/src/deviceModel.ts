@@ -0,0 +1,124 @@
+import type { ModelArchitecture, ModelWeights } from './types';
+
+/**
+ * The soil-moisture forecaster that Msingi devices train on their own
+ * hourly history (firmware/esp32-ndani/include/fl_protocol.h). Rounds go
+ * over LoRa: the global model as one int8 frame, each device's answer as
+ * its largest parameter changes.
+ */
+
+export const DEVICE_MODEL_INPUTS = 8;
+export const DEVICE_MODEL_HIDDEN = 8;
+export const DEVICE_MODEL_PARAMS =
+  DEVICE_MODEL_HIDDEN * DEVICE_MODEL_INPUTS + DEVICE_MODEL_HIDDEN + DEVICE_MODEL_HIDDEN + 1;
+
+export const DEVICE_MODEL_ARCHITECTURE: ModelArchitecture = {
+  inputDim: DEVICE_MODEL_INPUTS,
+  hiddenLayers: [DEVICE_MODEL_HIDDEN],
+  outputDim: 1,
+  activation: 'relu',
+  optimizer: 'sgd',
+  loss: 'mse',
+  metrics: ['rmse'],
+};
+
+const MSG_FL_MODEL = 0x0e;
+const SHIFT_MIN = -8;
+const SHIFT_MAX = 15;
+
+// Parameter vector layout: hidden weights (row per unit), hidden biases,
+// output weights, output bias
+const TENSORS: [number, number][] = [
+  [0, DEVICE_MODEL_HIDDEN * DEVICE_MODEL_INPUTS],
+  [DEVICE_MODEL_HIDDEN * DEVICE_MODEL_INPUTS, DEVICE_MODEL_HIDDEN],
+  [DEVICE_MODEL_HIDDEN * DEVICE_MODEL_INPUTS + DEVICE_MODEL_HIDDEN, DEVICE_MODEL_HIDDEN],
+  [DEVICE_MODEL_PARAMS - 1, 1],
+];
+
+/** An fl_update record from the gateway */
+export interface DeviceModelUpdate {
+  sourceAddress: number;
+  round: number;
+  samples: number;
+  rmseBefore: number;      // Forecast RMSE of the global model, % soil moisture
+  rmseAfter: number;       // ... after local training
+  deltas: [number, number][]; // [parameter index, change]
+}
+
+function shiftFor(maxAbs: number): number {
+  if (!(maxAbs > 0)) return SHIFT_MAX;
+  const shift = Math.floor(Math.log2(127 / maxAbs));
+  return Math.min(SHIFT_MAX, Math.max(SHIFT_MIN, shift));
+}
+
+/**
+ * Global model as the MSG_FL_MODEL downlink (hex), one power-of-two scale
+ * per tensor
+ */
+export function encodeDeviceModel(params: number[], round: number): string {
+  if (params.length !== DEVICE_MODEL_PARAMS) {
+    throw new Error(`Expected ${DEVICE_MODEL_PARAMS} parameters, got ${params.length}`);
+  }
+  const frame = new Uint8Array(3 + TENSORS.length + DEVICE_MODEL_PARAMS);
+  frame[0] = MSG_FL_MODEL;
+  frame[1] = round & 0xff;
+  frame[2] = (round >> 8) & 0xff;
+  TENSORS.forEach(([offset, size], tensor) => {
+    const values = params.slice(offset, offset + size);
+    const shift = shiftFor(Math.max(...values.map(Math.abs)));
+    frame[3 + tensor] = shift & 0xff;
+    values.forEach((value, i) => {
+      const q = Math.max(-127, Math.min(127, Math.round(value * 2 ** shift)));
+      frame[3 + TENSORS.length + offset + i] = q & 0xff;
+    });
+  });
+  return Array.from(frame, (byte) => byte.toString(16).padStart(2, '0')).join('').toUpperCase();
+}
+
+/**
+ * FedAvg over sparse updates: each device's changes weighted by its
+ * training samples, parameters a device did not send counting as unchanged
+ */
+export function aggregateDeviceUpdates(params: number[], updates: DeviceModelUpdate[]): number[] {
+  const totalSamples = updates.reduce((sum, update) => sum + update.samples, 0);
+  if (totalSamples === 0) return [...params];
+
+  const next = [...params];
+  for (const update of updates) {
+    const weight = update.samples / totalSamples;
+    for (const [index, change] of update.deltas) {
+      if (index >= 0 && index < DEVICE_MODEL_PARAMS) next[index] += change * weight;
+    }
+  }
+  return next;
+}
+
+/**
+ * Parameter vector as ModelWeights, for the aggregation and submission types
+ */
+export function deviceParamsToWeights(params: number[]): ModelWeights {
+  const hidden: number[][] = [];
+  for (let j = 0; j < DEVICE_MODEL_HIDDEN; j++) {
+    hidden.push(params.slice(j * DEVICE_MODEL_INPUTS, (j + 1) * DEVICE_MODEL_INPUTS));
+  }
+  const [, [b1, b1Size]] = TENSORS;
+  const [, , [w2, w2Size], [b2]] = TENSORS;
+  return {
+    layers: [
+      { name: 'hidden', weights: [hidden], biases: [params.slice(b1, b1 + b1Size)] },
+      { name: 'output', weights: [[params.slice(w2, w2 + w2Size)]], biases: [[params[b2]]] },
+    ],
+    totalParameters: DEVICE_MODEL_PARAMS,
+    architecture: DEVICE_MODEL_ARCHITECTURE,
+  };
+}
+
+export function deviceWeightsToParams(weights: ModelWeights): number[] {
+  const [hidden, output] = weights.layers;
+  return [
+    ...hidden.weights[0].flat(),
+    ...hidden.biases[0],
+    ...output.weights[0][0],
+    output.biases[0][0],
+  ];
+}
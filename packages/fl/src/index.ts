@@ -4,3 +4,4 @@ export * from './data';
 export * from './iotData';
 export * from './prediction';
 export * from './sensorNodeData';
+export * from './deviceModel';